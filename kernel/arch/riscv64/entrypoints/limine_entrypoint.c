@@ -16,9 +16,11 @@
 #include "kprintf.h"
 #include "machine.h"
 #include "pmm/pagealloc.h"
+#include "pmm/pfndb.h"
 #include "vmm/vmconfig.h"
 
 #include "platform/bootloaders/limine.h"
+#include "platform/fdt/fdt.h"
 
 #include "riscv64/interrupts.h"
 #include "riscv64/kdrivers/cpu.h"
@@ -77,6 +79,12 @@ static volatile Limine_ModuleRequest limine_module_request __attribute__((__alig
         .internal_module_count = 0,
 };
 
+static volatile Limine_DeviceTreeRequest limine_dtb_request __attribute__((__aligned__(8))) = {
+        .id = LIMINE_DTB_REQUEST,
+        .revision = 3,
+        .response = nullptr,
+};
+
 /* Defined by the linker */
 extern uint64_t _kernel_vma_start;
 extern uint64_t _kernel_vma_end;
@@ -98,6 +106,20 @@ static Limine_MemMap static_memmap;
 static Limine_MemMapEntry *static_memmap_pointers[MAX_MEMMAP_ENTRIES];
 static Limine_MemMapEntry static_memmap_entries[MAX_MEMMAP_ENTRIES];
 
+bool arch_pmm_map_metadata_page(const uintptr_t vaddr, const uintptr_t phys) {
+    const uintptr_t index = (vaddr - (uintptr_t)STATIC_PMM_VREGION) >> VM_PAGE_LINEAR_SHIFT;
+
+    // Page 0 is the bootstrap page, and we only have the one table
+    if (vaddr < (uintptr_t)STATIC_PMM_VREGION || index == 0 || index >= 512) {
+        return false;
+    }
+
+    pmm_pt[index] = (phys >> 2) | PG_PRESENT | PG_READ | PG_WRITE;
+    cpu_invalidate_tlb_addr(vaddr);
+
+    return true;
+}
+
 /* Static initial pagetables */
 static uint64_t new_pml4[512] __attribute__((aligned(4096)));
 static uint64_t new_pdpt[512] __attribute__((aligned(4096)));
@@ -116,6 +138,9 @@ static uint64_t pmm_bootstrap_page[512] __attribute__((aligned(4096)));
 
 static uintptr_t g_fb_phys;
 
+// Read from the DTB while the bootloader's mappings are still around, zero if we couldn't
+static uint64_t g_timebase_hz;
+
 /* Globals */
 extern MemoryRegion *physical_region;
 
@@ -376,6 +401,12 @@ noreturn void bsp_kernel_entrypoint_limine() {
         static_memmap_entries[i].type = limine_memmap_request.memmap->entries[i]->type;
     }
 
+    // The DTB lives in bootloader memory we won't have mapped after the trampoline,
+    // so grab what we need from it now...
+    if (limine_dtb_request.response) {
+        fdt_read_u64(limine_dtb_request.response->dtb_ptr, "/cpus", "timebase-frequency", &g_timebase_hz);
+    }
+
     // Now, we need to set up our initial pagetables.
     //
     // On x86_64, we copy the kernel to suit our expected physical layout, and then
@@ -559,6 +590,8 @@ static noreturn void bootstrap_continue(const uint16_t fb_width, const uint16_t
 
     sbi_debug_info();
 
+    cpu_init_timebase(g_timebase_hz);
+
     debug_memmap_limine(&static_memmap);
 
     physical_region = page_alloc_init_limine(&static_memmap, 0, STATIC_PMM_VREGION, false);
@@ -585,5 +618,10 @@ static noreturn void bootstrap_continue(const uint16_t fb_width, const uint16_t
             vmm_direct_mapping_gigapages_used, vmm_direct_mapping_megapages_used, vmm_direct_mapping_pages_used);
 #endif
 
+    if (!pfndb_init(new_pml4, PFNDB_BEGIN, &static_memmap)) {
+        debugstr("Failed to initialise physical frame database. Halting\n");
+        halt_and_catch_fire();
+    }
+
     bsp_kernel_entrypoint(0);
 }
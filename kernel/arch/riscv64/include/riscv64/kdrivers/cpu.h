@@ -135,4 +135,13 @@ static inline uint64_t cpu_read_rdtime(void) {
     return val;
 }
 
+/*
+ * Set the frequency of the time CSR, as given by the device tree's
+ * timebase-frequency. Pass zero if that wasn't available, and a
+ * (QEMU-appropriate) default will be used instead.
+ *
+ * Must be called before the timer is started.
+ */
+void cpu_init_timebase(uint64_t hz);
+
 #endif // __ANOS_KERNEL_ARCH_RISCV64_KDRIVERS_CPU_H
\ No newline at end of file
@@ -112,7 +112,7 @@ static inline PageTable *vmm_find_pml4() {
 /*
  *  Find the per-CPU temporary page base for the given CPU.
  */
-static inline uintptr_t vmm_per_cpu_temp_page_addr(uint8_t cpu) { return PER_CPU_TEMP_PAGE_BASE + (cpu << 12); }
+static inline uintptr_t vmm_per_cpu_temp_page_addr(uint16_t cpu) { return PER_CPU_TEMP_PAGE_BASE + (cpu << 12); }
 
 // Initialize the direct mapping for physical memory
 // This must be called during early boot, before SMP
@@ -10,6 +10,24 @@
 #include <riscv64/kdrivers/cpu.h>
 #include <riscv64/kdrivers/sbi.h>
 
+#include "config.h"
+#include "kprintf.h"
+
+// QEMU virt's timebase, used if the device tree doesn't tell us otherwise
+#define DEFAULT_TIMEBASE_HZ ((10000000ULL))
+#define NANOS_PER_SEC ((1000000000ULL))
+
+static uint64_t timebase_hz = DEFAULT_TIMEBASE_HZ;
+
+void cpu_init_timebase(const uint64_t hz) {
+    if (hz == 0) {
+        timebase_hz = DEFAULT_TIMEBASE_HZ;
+        kprintf("WARN: No timebase-frequency in device tree; assuming %ldHz\n", timebase_hz);
+    } else {
+        timebase_hz = hz;
+    }
+}
+
 void wait_for_interrupt(void) { __asm__ volatile("wfi"); }
 
 #ifndef UNIT_TESTS
@@ -48,11 +66,26 @@ uint64_t save_disable_interrupts() {
 void restore_saved_interrupts(uint64_t sstatus) { __asm__ volatile("csrw sstatus, %0" : : "r"(sstatus) : "memory"); }
 
 void kernel_timer_eoe(void) {
-    // TODO calibrate / calculate this interval (E.G. THIS IS FAR TOO LONG ON QEMU/AARCH64)!
-    sbi_set_timer(cpu_read_rdtime() + 100000);
+#ifdef EXPERIMENTAL_TICKLESS
+    // Disarm - the timer ISR will program the next one-shot
+    sbi_set_timer(UINT64_MAX);
+#else
+    sbi_set_timer(cpu_read_rdtime() + timebase_hz / KERNEL_HZ);
+#endif
     __asm__ volatile("li t0, 32\n\t"
                      "csrc sip, t0\n\t"
                      :
                      :
                      : "t0");
-}
\ No newline at end of file
+}
+
+uint64_t get_kernel_nanos(void) {
+    const uint64_t time = cpu_read_rdtime();
+    return (time / timebase_hz) * NANOS_PER_SEC + ((time % timebase_hz) * NANOS_PER_SEC) / timebase_hz;
+}
+
+void kernel_timer_oneshot(const uint64_t nanos) {
+    const uint64_t ticks =
+            (nanos / NANOS_PER_SEC) * timebase_hz + ((nanos % NANOS_PER_SEC) * timebase_hz) / NANOS_PER_SEC;
+    sbi_set_timer(cpu_read_rdtime() + ticks);
+}
@@ -11,6 +11,7 @@
 #include "fba/alloc.h"
 #include "smp/state.h"
 #include "std/string.h"
+#include "vmm/asid.h"
 
 #include "panic.h"
 
@@ -56,7 +57,11 @@ static bool init_this_cpu(uint64_t hart_id) {
     cpu_set_sscratch(0);
     cpu_set_tp((uint64_t)cpu_state);
 
-    state_register_cpu(0, cpu_state);
+    if (!state_register_cpu(0, cpu_state)) {
+        return false;
+    }
+
+    asid_init_this_cpu();
 
     sbi_set_timer(cpu_read_rdtime());
     enable_timer_interrupts();
@@ -66,6 +71,12 @@ static bool init_this_cpu(uint64_t hart_id) {
 
 bool platform_init(const uintptr_t platform_data) {
     ap_startup_wait = true;
+
+    // Only the boot hart is started for now
+    if (!state_init(1)) {
+        return false;
+    }
+
     return init_this_cpu(0);
 }
 
@@ -5,6 +5,16 @@
  * Copyright (c) 2025 Ross Bamford
  */
 
+#include "smp/state.h"
+
 void arch_ipwi_notify_all_except_current(void) {
     // TODO noop for now...
 }
+
+void arch_ipwi_notify(PerCPUState *target_state) {
+    // TODO noop for now...
+}
+
+void arch_ipwi_notify_reschedule(PerCPUState *target_state) {
+    // TODO noop for now, remote CPUs pick up wakeups at their next timer interrupt
+}
@@ -1,6 +1,17 @@
 #include <stddef.h>
 #include <stdint.h>
 
+#include "vmm/vmconfig.h"
+
+#ifdef RISCV_ZICBOZ
+#ifndef RISCV_CBOZ_BLOCK_SIZE
+#define RISCV_CBOZ_BLOCK_SIZE ((64))
+#endif
+
+// cbo.zero, spelled out so it doesn't need Zicboz in the toolchain's -march
+static inline void cbo_zero(void *block) { __asm__ volatile(".insn i 0x0f, 2, x0, %0, 4" : : "r"(block) : "memory"); }
+#endif
+
 __attribute__((no_sanitize("alignment"))) // Can't align both src and dest in the general case..
 #ifdef UNIT_TESTS
 void *anos_std_memcpy(void *restrict dest, const void *restrict src, size_t count)
@@ -63,8 +74,9 @@ void *memcpy(void *restrict dest, const void *restrict src, size_t count)
     size_t blocks = count >> 3;
     count &= 7;
 
-    // For large copies, use RISC-V optimized approach
-    if (blocks >= 32) { // 256 bytes or more
+    // For larger copies, use RISC-V optimized approach (the Duff's
+    // device below only covers up to 15 blocks)
+    if (blocks >= 16) { // 128 bytes or more
 // Use RISC-V vector extension if available
 #ifdef __riscv_v
 // Vectorized copy for large blocks
@@ -328,4 +340,65 @@ void *memclr(void *dest, size_t count) {
 #else
     return memset(dest, 0, count);
 #endif
-}
\ No newline at end of file
+}
+
+void *memcpy_page(void *restrict dest, const void *restrict src) {
+    uint64_t *d64 = (uint64_t *)dest;
+    const uint64_t *s64 = (const uint64_t *)src;
+    const uint64_t *end = s64 + (VM_PAGE_SIZE >> 3);
+
+    // Both aligned, so no head or tail to worry about
+    while (s64 < end) {
+        const uint64_t t0 = s64[0];
+        const uint64_t t1 = s64[1];
+        const uint64_t t2 = s64[2];
+        const uint64_t t3 = s64[3];
+        const uint64_t t4 = s64[4];
+        const uint64_t t5 = s64[5];
+        const uint64_t t6 = s64[6];
+        const uint64_t t7 = s64[7];
+
+        d64[0] = t0;
+        d64[1] = t1;
+        d64[2] = t2;
+        d64[3] = t3;
+        d64[4] = t4;
+        d64[5] = t5;
+        d64[6] = t6;
+        d64[7] = t7;
+
+        d64 += 8;
+        s64 += 8;
+    }
+
+    return dest;
+}
+
+void *memclr_page(void *dest) {
+#ifdef RISCV_ZICBOZ
+    for (uint8_t *block = dest; block < (uint8_t *)dest + VM_PAGE_SIZE; block += RISCV_CBOZ_BLOCK_SIZE) {
+        cbo_zero(block);
+    }
+#else
+    uint64_t *d64 = (uint64_t *)dest;
+    const uint64_t *end = d64 + (VM_PAGE_SIZE >> 3);
+
+    while (d64 < end) {
+        d64[0] = 0;
+        d64[1] = 0;
+        d64[2] = 0;
+        d64[3] = 0;
+        d64[4] = 0;
+        d64[5] = 0;
+        d64[6] = 0;
+        d64[7] = 0;
+
+        d64 += 8;
+    }
+#endif
+
+    return dest;
+}
+
+// No non-temporal stores here, so same thing
+void *memclr_page_nt(void *dest) { return memclr_page(dest); }
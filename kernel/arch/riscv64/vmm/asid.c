@@ -0,0 +1,56 @@
+/*
+ * stage3 - RISC-V address space IDs
+ * anos - An Operating System
+ *
+ * Copyright (c) 2025 Ross Bamford
+ *
+ * ASIDs go in satp alongside the root table, and how many bits of it
+ * there are (ASIDLEN, anywhere from none to 16) is only found out by
+ * writing ones there and seeing which stick. Global pages are just a
+ * bit in the PTE, there's nothing to switch on.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "riscv64/kdrivers/cpu.h"
+
+#define SATP_ASID_SHIFT ((44))
+#define SATP_ASID_MASK ((0xffffULL << SATP_ASID_SHIFT))
+
+uint16_t arch_asid_init_this_cpu(const bool want_asids) {
+    if (!want_asids) {
+        return 0;
+    }
+
+    const uint64_t satp = cpu_read_satp();
+
+    __asm__ volatile("csrw satp, %0" : : "r"(satp | SATP_ASID_MASK) : "memory");
+    const uint64_t probe = cpu_read_satp();
+    __asm__ volatile("csrw satp, %0\n\t"
+                     "sfence.vma"
+                     :
+                     : "r"(satp)
+                     : "memory");
+
+    // ASID 0 is ours, the rest can be handed out
+    return (uint16_t)((probe & SATP_ASID_MASK) >> SATP_ASID_SHIFT);
+}
+
+void arch_asid_switch(const uintptr_t pagetable_root, const uint16_t asid, const bool flush) {
+    const uint64_t satp = pagetable_root | ((uint64_t)asid << SATP_ASID_SHIFT);
+
+    __asm__ volatile("csrw satp, %0" : : "r"(satp) : "memory");
+
+    if (flush) {
+        // Just this ASID's entries - global (kernel) ones stay
+        __asm__ volatile("sfence.vma x0, %0" : : "r"((uint64_t)asid) : "memory");
+    }
+}
+
+bool arch_asid_invalidate_page(const uint16_t asid, const uintptr_t virt_addr) {
+    __asm__ volatile("sfence.vma %0, %1" : : "r"(virt_addr), "r"((uint64_t)asid) : "memory");
+    return true;
+}
+
+void arch_asid_flush_all(void) { __asm__ volatile("sfence.vma" : : : "memory"); }
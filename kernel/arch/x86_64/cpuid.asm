@@ -35,6 +35,7 @@ cpuid:
     mov r10,rcx                     ; stash pointer for rcx in r10
     mov r11,r8                      ; stash pointer for rdx in r11
 
+    xor ecx,ecx                     ; Always sub-leaf 0 (e.g. for leaf 7)
     cpuid
 
     mov [rsi],eax                   ; rax into rax pointer
@@ -16,6 +16,7 @@
 #include "debugprint.h"
 #include "framebuffer.h"
 #include "machine.h"
+#include "pmm/pfndb.h"
 #include "std/string.h"
 #include "vmm/vmmapper.h"
 
@@ -277,5 +278,10 @@ static noreturn void bootstrap_continue(const size_t system_size, const uint16_t
         halt_and_catch_fire();
     }
 
+    if (!pfndb_init(pml4_virt, PFNDB_BEGIN, &static_memmap)) {
+        debugstr("Failed to initialise physical frame database. Halting\n");
+        halt_and_catch_fire();
+    }
+
     bsp_kernel_entrypoint(((uintptr_t)&static_rsdp) - STATIC_KERNEL_SPACE);
 }
@@ -35,14 +35,8 @@ extern bsp_kernel_entrypoint_limine
 extern _bss_start, _bss_end               ; Linker defined symbols
 extern _kernel_vma_start, _kernel_vma_end ; .. ditto ...
 
-%macro init_tss 1
-  mov   rax,TSS%1
-  mov   word [TSS%1_BASE_LOW],ax          ; Addresses here are already high,
-  shr   rax,0x10                          ; in case you're wondering why I'm
-  mov   byte [TSS%1_BASE_MID],al          ; not or'ing in the kernel base here...
-  shr   rax,0x08
-  mov   byte [TSS%1_BASE_HIGH],al
-%endmacro
+%define TSS_COUNT 256                     ; One per supported CPU (MAX_CPU_COUNT in cpu.h)
+%define TSS_STRIDE 0x70                   ; 104 bytes for a TSS, aligned to 16
 
 _start_limine:
   mov   rcx,_bss_end                      ; Get end of .bss section (VMA)
@@ -64,22 +58,20 @@ _start_limine:
   lgdt  [GDT_DESC]                        ; We don't like Limine's GDT, let's use
                                           ; one that fits our needs...
 
-  init_tss 0                              ; Init 16 TSS segments
-  init_tss 1                              ; Note: this totally isn't scalable, it will change
-  init_tss 2                              ; eventually to (probably) having the whole GDT in 
-  init_tss 3                              ; managed memory rather than statically defined here...
-  init_tss 4
-  init_tss 5
-  init_tss 6
-  init_tss 7
-  init_tss 8
-  init_tss 9
-  init_tss 10
-  init_tss 11
-  init_tss 12
-  init_tss 13
-  init_tss 14
-  init_tss 15
+  mov   rbx,GDT_TSSES                     ; Init TSS segments, pointing each at its TSS.
+  mov   rax,TSSES                         ; Addresses here are already high, in case
+  mov   rcx,TSS_COUNT                     ; you're wondering why I'm not or'ing in the
+.init_tss_loop:                           ; kernel base here...
+  mov   rdx,rax
+  mov   word [rbx+2],dx                   ; Base (bits 0-15)
+  shr   rdx,0x10
+  mov   byte [rbx+4],dl                   ; Base (bits 16-23)
+  shr   rdx,0x08
+  mov   byte [rbx+7],dl                   ; Base (bits 24-31)
+  add   rbx,0x10                          ; Next (16-byte) system segment...
+  add   rax,TSS_STRIDE                    ; ... and next TSS
+  dec   rcx
+  jnz   .init_tss_loop
 
   mov   ax,0x28                           ; Load the TSS (GDT selector 5 for the BSP)
   ltr   ax
@@ -135,39 +127,6 @@ bootstrap_trampoline:                     ; (... except this bit, we'll pop back
 
 align 16
 
-%macro tss_segment 1
-  dw 0x0067               ; 104 bytes for a TSS
-TSS%1_BASE_LOW:
-  dw 0                    ; Base (bits 0-15) - 0 (calculated at runtime)
-TSS%1_BASE_MID:
-  db 0                    ; Base (bits 16-23) - 0 (calculated at runtime)
-  db 0b10001001           ; Access: 1 = Present, 00 = Ring 0, 0 = Type (system), 1001 = Long mode TSS (Available)
-  db 0b00010000           ; Flags + Limit: 0 = byte granularity, 0 = 16-bit, 0 = Long mode, 1 = Available
-TSS%1_BASE_HIGH:
-  db 0                    ; Base (bits 23-31) - 0 (calculated at runtime)
-  dd 0xFFFFFFFF           ; Base (bits 32-63) - 0xFFFFFFFF (in the identity-mapped kernel mem)
-  dd 0                    ; Reserved
-%endmacro
-
-%macro define_tss 1
-TSS%1:
-  dd  0                   ; Reserved
-  dq  0                   ; RSP0
-  dq  0                   ; RSP1
-  dq  0                   ; RSP2
-  dq  0                   ; Reserved
-  dq  0                   ; IST1
-  dq  0                   ; IST2
-  dq  0                   ; IST3
-  dq  0                   ; IST4
-  dq  0                   ; IST5
-  dq  0                   ; IST6
-  dq  df_stack+0x1000     ; IST7 - double fault
-  dq  0                   ; Reserved
-  dw  0                   ; Reserved
-  dw  0                   ; IOPB
-%endmacro
-
 GDT:
   ; segment 0 - null
   dq 0
@@ -204,24 +163,19 @@ GDT:
   db 0b11001111           ; Flags + Limit: 1 = 4k granularity, 1 = 32-bit, 0 = Non-long mode, 0 = reserved (for our use)
   db 0                    ; Base (bits 23-31) - 0
 
-  ; segments 5 to 20 - TSSn (one per supported CPU)
-  ; Values within these are calculated in code...
-  tss_segment 0
-  tss_segment 1
-  tss_segment 2
-  tss_segment 3
-  tss_segment 4
-  tss_segment 5
-  tss_segment 6
-  tss_segment 7
-  tss_segment 8
-  tss_segment 9
-  tss_segment 10
-  tss_segment 11
-  tss_segment 12
-  tss_segment 13
-  tss_segment 14
-  tss_segment 15
+  ; segments 5 onwards - TSSn (one per supported CPU, 16 bytes each)
+  ; Base addresses within these are calculated in code...
+GDT_TSSES:
+%rep TSS_COUNT
+  dw 0x0067               ; 104 bytes for a TSS
+  dw 0                    ; Base (bits 0-15) - 0 (calculated at runtime)
+  db 0                    ; Base (bits 16-23) - 0 (calculated at runtime)
+  db 0b10001001           ; Access: 1 = Present, 00 = Ring 0, 0 = Type (system), 1001 = Long mode TSS (Available)
+  db 0b00010000           ; Flags + Limit: 0 = byte granularity, 0 = 16-bit, 0 = Long mode, 1 = Available
+  db 0                    ; Base (bits 23-31) - 0 (calculated at runtime)
+  dd 0xFFFFFFFF           ; Base (bits 32-63) - 0xFFFFFFFF (in the identity-mapped kernel mem)
+  dd 0                    ; Reserved
+%endrep
 
 align 16
 
@@ -235,37 +189,25 @@ GDT_DESC:
 ; task switching...
 ;
 align 16
-define_tss 0
-align 16
-define_tss 1
-align 16
-define_tss 2
-align 16
-define_tss 3
-align 16
-define_tss 4
-align 16
-define_tss 5
-align 16
-define_tss 6
-align 16
-define_tss 7
-align 16
-define_tss 8
-align 16
-define_tss 9
-align 16
-define_tss 10
-align 16
-define_tss 11
-align 16
-define_tss 12
-align 16
-define_tss 13
-align 16
-define_tss 14
-align 16
-define_tss 15
+TSSES:
+%rep TSS_COUNT
+  dd  0                   ; Reserved
+  dq  0                   ; RSP0
+  dq  0                   ; RSP1
+  dq  0                   ; RSP2
+  dq  0                   ; Reserved
+  dq  0                   ; IST1
+  dq  0                   ; IST2
+  dq  0                   ; IST3
+  dq  0                   ; IST4
+  dq  0                   ; IST5
+  dq  0                   ; IST6
+  dq  df_stack+0x1000     ; IST7 - double fault
+  dq  0                   ; Reserved
+  dw  0                   ; Reserved
+  dw  0                   ; IOPB
+  times TSS_STRIDE-104 db 0
+%endrep
 
 df_stack:
   resb 0x1000
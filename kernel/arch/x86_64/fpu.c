@@ -0,0 +1,173 @@
+/*
+ * stage3 - x86_64 FPU / SIMD state management
+ * anos - An Operating System
+ *
+ * Copyright (c) 2025 Ross Bamford
+ *
+ * Works out how task_do_switch should save FPU / SIMD state, and
+ * sets each CPU up to match. Where the CPU has it, that's XSAVES
+ * (or XSAVEOPT) - both skip components that are still in their init
+ * state, or haven't changed since the last restore, so tasks that
+ * never touch SSE / AVX (most drivers) cost next to nothing.
+ *
+ * XCR0 gets x87, SSE, AVX and AVX-512 if they're there and the
+ * state fits in the task data area. Anything bigger (AMX tiles, say)
+ * is left disabled.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "std/string.h"
+#include "task.h"
+#include "x86_64/fpu.h"
+#include "x86_64/kdrivers/cpu.h"
+
+#define CR4_OSXSAVE ((1ULL << 18))
+#define MSR_IA32_XSS ((0xDA0))
+
+#define CPUID_1_ECX_XSAVE ((1 << 26))
+#define CPUID_D_1_EAX_XSAVEOPT ((1 << 0))
+#define CPUID_D_1_EAX_XSAVES ((1 << 3))
+#define CPUID_D_N_ECX_ALIGNED ((1 << 1))
+
+#define FPU_XCR0_WANTED ((FPU_XCR0_X87 | FPU_XCR0_SSE | FPU_XCR0_AVX | FPU_XCR0_AVX512))
+
+// Legacy (FXSAVE) region plus the XSAVE header
+#define FPU_LEGACY_SIZE ((512))
+#define FPU_XSAVE_BASE_SIZE ((576))
+
+#define FPU_MXCSR_DEFAULT ((0x1F80))
+
+// task_switch.asm uses this directly
+FpuSaveMode fpu_save_mode;
+
+static bool fpu_initialized;
+static uint64_t fpu_xcr0;
+static uint64_t fpu_state_size = FPU_LEGACY_SIZE;
+static uint8_t fpu_initial_state[TASK_DATA_SIZE] __attribute__((aligned(64)));
+
+static inline void cpuid_sub(const uint32_t leaf, const uint32_t sub, uint32_t *eax, uint32_t *ebx, uint32_t *ecx,
+                             uint32_t *edx) {
+    __asm__ volatile("cpuid" : "=a"(*eax), "=b"(*ebx), "=c"(*ecx), "=d"(*edx) : "a"(leaf), "c"(sub));
+}
+
+// Size of the save area for the given components, standard or compacted format
+static uint64_t xsave_size(const uint64_t xcr0, const bool compacted) {
+    uint64_t size = FPU_XSAVE_BASE_SIZE;
+
+    for (int i = 2; i < 64; i++) {
+        if (!(xcr0 & (1ULL << i))) {
+            continue;
+        }
+
+        uint32_t comp_size, comp_offset, flags, edx;
+        cpuid_sub(0xd, i, &comp_size, &comp_offset, &flags, &edx);
+
+        if (compacted) {
+            if (flags & CPUID_D_N_ECX_ALIGNED) {
+                size = (size + 63) & ~63ULL;
+            }
+            size += comp_size;
+        } else if (comp_offset + comp_size > size) {
+            size = comp_offset + comp_size;
+        }
+    }
+
+    return size;
+}
+
+static void choose_save_mode(void) {
+    uint32_t eax, ebx, ecx, edx;
+
+    cpuid_sub(1, 0, &eax, &ebx, &ecx, &edx);
+
+    if (!(ecx & CPUID_1_ECX_XSAVE)) {
+        fpu_save_mode = FPU_SAVE_FXSAVE;
+        return;
+    }
+
+    cpuid_sub(0xd, 0, &eax, &ebx, &ecx, &edx);
+    uint64_t xcr0 = (((uint64_t)edx << 32) | eax) & FPU_XCR0_WANTED;
+
+    // AVX-512 is all or nothing
+    if ((xcr0 & FPU_XCR0_AVX512) != FPU_XCR0_AVX512) {
+        xcr0 &= ~FPU_XCR0_AVX512;
+    }
+
+    cpuid_sub(0xd, 1, &eax, &ebx, &ecx, &edx);
+
+    if (eax & CPUID_D_1_EAX_XSAVES) {
+        fpu_save_mode = FPU_SAVE_XSAVES;
+    } else if (eax & CPUID_D_1_EAX_XSAVEOPT) {
+        fpu_save_mode = FPU_SAVE_XSAVEOPT;
+    } else {
+        fpu_save_mode = FPU_SAVE_XSAVE;
+    }
+
+    const bool compacted = fpu_save_mode == FPU_SAVE_XSAVES;
+
+    if (xsave_size(xcr0, compacted) > TASK_DATA_SIZE) {
+        xcr0 &= ~FPU_XCR0_AVX512;
+    }
+
+    fpu_xcr0 = xcr0;
+    fpu_state_size = xsave_size(xcr0, compacted);
+}
+
+static void capture_initial_state(void) {
+    const uint32_t mxcsr = FPU_MXCSR_DEFAULT;
+
+    memclr(fpu_initial_state, sizeof(fpu_initial_state));
+
+    __asm__ volatile("fninit\n\t"
+                     "ldmxcsr %0\n\t"
+                     :
+                     : "m"(mxcsr));
+
+    // Plain xsave even for XSAVEOPT - we want the whole legacy area
+    // written, not skipped because it's in the init state...
+    switch (fpu_save_mode) {
+    case FPU_SAVE_XSAVES:
+        __asm__ volatile("xsaves64 (%0)" : : "r"(fpu_initial_state), "a"(~0U), "d"(~0U) : "memory");
+        break;
+    case FPU_SAVE_XSAVEOPT:
+    case FPU_SAVE_XSAVE:
+        __asm__ volatile("xsave64 (%0)" : : "r"(fpu_initial_state), "a"(~0U), "d"(~0U) : "memory");
+        break;
+    default:
+        __asm__ volatile("fxsave64 (%0)" : : "r"(fpu_initial_state) : "memory");
+    }
+}
+
+void fpu_init_this(void) {
+    if (!fpu_initialized) {
+        choose_save_mode();
+    }
+
+    if (fpu_save_mode != FPU_SAVE_FXSAVE) {
+        uint64_t cr4;
+        __asm__ volatile("mov %%cr4, %0" : "=r"(cr4));
+        __asm__ volatile("mov %0, %%cr4" : : "r"(cr4 | CR4_OSXSAVE));
+
+        __asm__ volatile("xsetbv" : : "c"(0), "a"((uint32_t)fpu_xcr0), "d"((uint32_t)(fpu_xcr0 >> 32)));
+
+        if (fpu_save_mode == FPU_SAVE_XSAVES) {
+            // No supervisor state components
+            cpu_write_msr(MSR_IA32_XSS, 0);
+        }
+    }
+
+    if (!fpu_initialized) {
+        capture_initial_state();
+        fpu_initialized = true;
+    }
+}
+
+void fpu_init_task_state(void *area) { memcpy(area, fpu_initial_state, fpu_state_size); }
+
+FpuSaveMode fpu_get_save_mode(void) { return fpu_save_mode; }
+
+uint64_t fpu_get_state_size(void) { return fpu_state_size; }
+
+uint64_t fpu_get_xcr0(void) { return fpu_xcr0; }
@@ -37,8 +37,8 @@ inline void *gdt_entry_to_tss(const GDTSystemEntry *tss_entry) {
                      ((uint64_t)tss_entry->base_middle << 16) | (uint64_t)tss_entry->base_low));
 }
 
-void *gdt_per_cpu_tss(const uint8_t cpu_id) {
-    if (cpu_id > MAX_CPU_COUNT) {
+void *gdt_per_cpu_tss(const uint16_t cpu_id) {
+    if (cpu_id >= MAX_CPU_COUNT) {
         return 0;
     }
 
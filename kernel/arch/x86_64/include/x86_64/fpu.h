@@ -0,0 +1,55 @@
+/*
+ * stage3 - x86_64 FPU / SIMD state management
+ * anos - An Operating System
+ *
+ * Copyright (c) 2025 Ross Bamford
+ */
+
+// clang-format Language: C
+
+#ifndef __ANOS_KERNEL_ARCH_X86_64_FPU_H
+#define __ANOS_KERNEL_ARCH_X86_64_FPU_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ * How task_do_switch saves and restores FPU state, best available
+ * first. This is shared with task_switch.asm, keep them in sync!
+ */
+typedef enum {
+    FPU_SAVE_FXSAVE = 0, // Legacy x87 / SSE only
+    FPU_SAVE_XSAVE,      // Everything enabled in XCR0
+    FPU_SAVE_XSAVEOPT,   // ... skipping unmodified / init components
+    FPU_SAVE_XSAVES,     // ... compacted, as well
+} __attribute__((packed)) FpuSaveMode;
+
+// XCR0 state components
+#define FPU_XCR0_X87 ((1ULL << 0))
+#define FPU_XCR0_SSE ((1ULL << 1))
+#define FPU_XCR0_AVX ((1ULL << 2))
+#define FPU_XCR0_AVX512 (((1ULL << 5) | (1ULL << 6) | (1ULL << 7))) // opmask, ZMM_Hi256, Hi16_ZMM
+
+/*
+ * Set up this CPU's FPU state handling (CR4.OSXSAVE, XCR0 etc).
+ *
+ * The first call decides the save mode and state size (from CPUID)
+ * for every CPU, and captures the initial state new tasks start
+ * with - all CPUs are assumed to be the same.
+ */
+void fpu_init_this(void);
+
+/*
+ * Give a new task the initial FPU state (default control words,
+ * everything else in its init state). `area` must be 64-byte
+ * aligned, with room for TASK_DATA_SIZE bytes.
+ */
+void fpu_init_task_state(void *area);
+
+FpuSaveMode fpu_get_save_mode(void);
+
+uint64_t fpu_get_state_size(void);
+
+uint64_t fpu_get_xcr0(void);
+
+#endif //__ANOS_KERNEL_ARCH_X86_64_FPU_H
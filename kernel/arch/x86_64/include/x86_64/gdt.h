@@ -75,6 +75,6 @@ void init_gdt_entry(GDTEntry *entry, uint32_t base, uint32_t limit, uint8_t acce
 void *gdt_entry_to_tss(const GDTSystemEntry *tss_entry);
 
 // Get a per-CPU TSS pointer
-void *gdt_per_cpu_tss(uint8_t cpu_id);
+void *gdt_per_cpu_tss(uint16_t cpu_id);
 
 #endif //__ANOS_KERNEL_ARCH_X86_64_GDT_H
@@ -33,7 +33,7 @@
 
 #ifndef MAX_CPU_COUNT
 #ifndef NO_SMP
-#define MAX_CPU_COUNT ((16))
+#define MAX_CPU_COUNT ((256))
 #else
 #define MAX_CPU_COUNT ((1))
 #endif
@@ -41,10 +41,18 @@
 
 static_assert(MAX_CPU_COUNT > 0, "Cannot build a kernel for zero CPUs!");
 
+// There's a static TSS for each (TSS_COUNT in limine_init.asm), and a per-CPU
+// temp page for each in the 1MiB at PER_CPU_TEMP_PAGE_BASE.
+static_assert(MAX_CPU_COUNT <= 256, "Cannot build a kernel for more than 256 CPUs!");
+
 #define CPU_TSS_ENTRY_SIZE_MULT ((2))
 
 bool cpu_init_this(void);
 
+/*
+ * This CPU's (x2)APIC ID, from CPUID - so cpu_init_this must have
+ * been called on this CPU first.
+ */
 uint64_t cpu_read_local_apic_id(void);
 
 void cpu_tsc_delay(uint64_t cycles);
@@ -54,7 +62,7 @@ void cpu_tsc_udelay(int n);
 // Buffer must have space for 49 characters!
 void cpu_get_brand_str(char *buffer);
 
-void cpu_debug_info(uint8_t cpu_num);
+void cpu_debug_info(uint16_t cpu_num);
 
 uint64_t cpu_read_msr(uint32_t msr);
 
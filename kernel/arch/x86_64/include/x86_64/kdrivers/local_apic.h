@@ -15,9 +15,6 @@
 
 #include "platform/acpi/acpitables.h"
 
-// This doesn't belong here, it'll go away when we go tickless...
-#define KERNEL_HZ ((100))
-
 #define REG_LAPIC_ID_O 0x08
 #define REG_LAPIC_VERSION_O 0x0c
 #define REG_LAPIC_EOI_O 0x2c
@@ -31,6 +28,14 @@
 
 #define LAPIC_REG(lapic, reg) ((lapic + REG_LAPIC##_##reg##_##O))
 
+// In x2APIC mode, the same registers are MSRs (and ICR is one 64-bit one)
+#define MSR_IA32_APIC_BASE ((0x1b))
+#define IA32_APIC_BASE_X2APIC ((1 << 10))
+#define IA32_APIC_BASE_ENABLE ((1 << 11))
+
+#define MSR_X2APIC_BASE ((0x800))
+#define MSR_X2APIC_REG(reg_o) ((MSR_X2APIC_BASE + ((reg_o) >> 2)))
+
 #define REG_LAPIC_ID(lapic) (LAPIC_REG(lapic, ID))
 #define REG_LAPIC_VERSION(lapic) (LAPIC_REG(lapic, VERSION))
 #define REG_LAPIC_EOI(lapic) (LAPIC_REG(lapic, EOI))
@@ -50,6 +55,7 @@
 #define LAPIC_ICR_LEVEL_ASSERT ((1 << 14))            // Level assert
 #define LAPIC_ICR_DEST_ALL_EXCLUDING_SELF ((3 << 18)) // Destination shorthand for all except self
 #define LAPIC_ICR_DELIVERY_MODE_NMI ((4 << 8))        // Delivery mode for NMI
+#define LAPIC_ICR_DELIVERY_MODE_FIXED ((0 << 8))      // Delivery mode for a fixed vector
 
 typedef struct {
     uint64_t base_address;
@@ -59,10 +65,44 @@ typedef struct {
     uint16_t reserved;
 } LocalAPIC;
 
-uint32_t volatile *init_local_apic(ACPI_MADT *madt, bool bsp);
+/*
+ * Set up this CPU's local APIC (and timer).
+ *
+ * The BSP picks x2APIC mode if the CPU has it (unless built with
+ * NO_X2APIC, or firmware already switched it on) - APs just follow.
+ * Likewise, only the BSP calibrates the timer, APs reuse its counts.
+ */
+void init_local_apic(ACPI_MADT *madt, bool bsp);
+
+bool local_apic_is_x2apic(void);
+
+/*
+ * Registers are given by their REG_LAPIC_xxx_O offset, and go to
+ * MMIO or MSRs depending on the mode.
+ */
+uint32_t local_apic_read(uint16_t reg);
+
+void local_apic_write(uint16_t reg, uint32_t value);
+
+/*
+ * Send an IPI - `command` is the low half of the ICR (vector, delivery
+ * mode etc) and goes to the given APIC ID, unless it has a shorthand.
+ *
+ * Caller must have interrupts disabled, so nothing else on this CPU
+ * touches the ICR in between.
+ */
+void local_apic_send_ipi(uint32_t apic_id, uint32_t command);
 
 uint64_t local_apic_get_count(void);
 
+/*
+ * Arm this CPU's LAPIC timer to fire once, on the given
+ * vector, after (approximately) the given nanoseconds.
+ *
+ * Very long delays are clamped to what the timer can count.
+ */
+void local_apic_timer_oneshot(uint8_t vector, uint64_t nanos);
+
 void local_apic_eoe(void);
 
 #endif //__ANOS_KERNEL_ARCH_X86_64_DRIVERS_LOCAL_APIC_H
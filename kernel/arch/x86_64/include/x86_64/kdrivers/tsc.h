@@ -0,0 +1,37 @@
+/*
+ * stage3 - TSC clock source
+ * anos - An Operating System
+ *
+ * Copyright (c) 2025 Ross Bamford
+ */
+
+// clang-format Language: C
+
+#ifndef __ANOS_KERNEL_ARCH_X86_64_DRIVERS_TSC_H
+#define __ANOS_KERNEL_ARCH_X86_64_DRIVERS_TSC_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define CPUID_80000007_EDX_INVARIANT_TSC ((1 << 8))
+
+/*
+ * Set up the TSC as a clock source, given the number of
+ * cycles measured over a known interval (in nanoseconds).
+ * The clock carries on from `now_nanos`, so switching over
+ * from another clock source doesn't make time jump.
+ *
+ * This only takes effect if the CPU has an invariant TSC,
+ * returns false (and leaves the TSC unused) otherwise.
+ */
+bool tsc_clock_init(uint64_t cycles, uint64_t interval_nanos, uint64_t now_nanos);
+
+bool tsc_clock_usable(void);
+
+/*
+ * Current nanoseconds, only meaningful if
+ * tsc_clock_usable returns true.
+ */
+uint64_t tsc_clock_nanos(void);
+
+#endif //__ANOS_KERNEL_ARCH_X86_64_DRIVERS_TSC_H
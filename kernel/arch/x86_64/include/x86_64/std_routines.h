@@ -0,0 +1,23 @@
+/*
+ * stage3 - x86_64 std routine CPU features
+ * anos - An Operating System
+ *
+ * Copyright (c) 2025 Ross Bamford
+ */
+
+// clang-format Language: C
+
+#ifndef __ANOS_KERNEL_ARCH_X86_64_STD_ROUTINES_H
+#define __ANOS_KERNEL_ARCH_X86_64_STD_ROUTINES_H
+
+#include <stdint.h>
+
+#define STD_ROUTINES_FEATURE_ERMS ((1 << 0)) // Enhanced REP MOVSB / STOSB
+#define STD_ROUTINES_FEATURE_FSRM ((1 << 1)) // Fast short REP MOVSB
+
+// Until this is called, only the plain (non-rep) routines are used
+void std_routines_set_features(uint32_t features);
+
+uint32_t std_routines_get_features(void);
+
+#endif //__ANOS_KERNEL_ARCH_X86_64_STD_ROUTINES_H
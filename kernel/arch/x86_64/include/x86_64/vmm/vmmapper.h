@@ -124,7 +124,7 @@ typedef struct {
 /*
  *  Find the per-CPU temporary page base for the given CPU.
  */
-uintptr_t vmm_per_cpu_temp_page_addr(const uint8_t cpu);
+uintptr_t vmm_per_cpu_temp_page_addr(const uint16_t cpu);
 
 uintptr_t vmm_phys_to_virt(const uintptr_t phys_addr);
 
@@ -33,6 +33,7 @@ extern void ap_timer_interrupt_handler(void);
 extern void unknown_interrupt_handler(void);
 extern void syscall_69_handler(void);
 extern void ipwi_ipi_dispatcher(void);
+extern void ipwi_reschedule_dispatcher(void);
 extern void double_fault_dispatcher(void);
 
 extern void pic_init(void);
@@ -113,6 +114,7 @@ void idt_install(uint16_t kernel_cs) {
 
     // Set up the handlers for kernel IPIs
     idt_entry(idt + IPWI_IPI_VECTOR, ipwi_ipi_dispatcher, kernel_cs, 0, idt_attr(1, 0, IDT_TYPE_IRQ));
+    idt_entry(idt + IPWI_RESCHEDULE_VECTOR, ipwi_reschedule_dispatcher, kernel_cs, 0, idt_attr(1, 0, IDT_TYPE_IRQ));
 
     // Setup the IDTR
     idt_r(&idtr, (uint64_t)idt, (uint16_t)sizeof(IdtEntry) * 256 - 1);
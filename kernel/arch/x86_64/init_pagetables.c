@@ -37,9 +37,15 @@
  * Copyright (c) 2023 Ross Bamford
  */
 
+#include <stdbool.h>
 #include <stdint.h>
 
 #include "vmm/vmmapper.h"
+#include "x86_64/kdrivers/cpu.h"
+#include "x86_64/pmm/config.h"
+
+// The PMM page table set up below, it maps the first 2MiB of STATIC_PMM_VREGION
+#define PMM_PT ((uint64_t *)(STATIC_KERNEL_SPACE + 0x9b000))
 
 uint64_t *pagetables_init() {
     // These are the static pagetables that were set up during init.
@@ -75,7 +81,7 @@ uint64_t *pagetables_init() {
     // room to start - once it's running additional mapping will be
     // done by the page fault handler as needed...
     uint64_t *pmm_pd = (uint64_t *)(STATIC_KERNEL_SPACE + 0x9a000);
-    uint64_t *pmm_pt = (uint64_t *)(STATIC_KERNEL_SPACE + 0x9b000);
+    uint64_t *pmm_pt = PMM_PT;
 
     // Zero them out
     for (int i = 0; i < 0x400; i++) {
@@ -101,4 +107,18 @@ uint64_t *pagetables_init() {
                      : "rax", "memory");
 
     return pml4;
-}
\ No newline at end of file
+}
+
+bool arch_pmm_map_metadata_page(const uintptr_t vaddr, const uintptr_t phys) {
+    const uintptr_t index = (vaddr - (uintptr_t)STATIC_PMM_VREGION) >> VM_PAGE_LINEAR_SHIFT;
+
+    // Page 0 is the bootstrap page, and we only have the one table
+    if (vaddr < (uintptr_t)STATIC_PMM_VREGION || index == 0 || index >= 512) {
+        return false;
+    }
+
+    PMM_PT[index] = phys | PG_PRESENT | PG_WRITE;
+    cpu_invalidate_tlb_addr(vaddr);
+
+    return true;
+}
@@ -11,6 +11,7 @@
 #include "platform/acpi/acpitables.h"
 #include "x86_64/cpuid.h"
 #include "x86_64/kdrivers/cpu.h"
+#include "x86_64/std_routines.h"
 
 #ifdef DEBUG_CPU
 #include "kprintf.h"
@@ -19,21 +20,46 @@
 // 0 = not checked, -1 = don't have, 1 = have
 static int __have__cpu__rdseed;
 
+// Let memcpy & friends use rep movsb / stosb where they're fast
+static void init_std_routines(void) {
+    uint32_t eax, ebx, ecx, edx;
+    uint32_t features = 0;
+
+    if (cpuid(0x7, &eax, &ebx, &ecx, &edx)) {
+        if (ebx & (1 << 9)) {
+            features |= STD_ROUTINES_FEATURE_ERMS;
+        }
+        if (edx & (1 << 4)) {
+            features |= STD_ROUTINES_FEATURE_FSRM;
+        }
+    }
+
+    std_routines_set_features(features);
+}
+
 bool cpu_init_this(void) {
     init_cpuid();
+    init_std_routines();
 
     return true;
 }
 
 uint64_t cpu_read_local_apic_id(void) {
-    uint8_t bsp_apic_id;
-    __asm__ __volatile__("mov $1, %%eax\n\t"
-                         "cpuid\n\t"
-                         "shrl $24, %%ebx\n\t"
-                         : "=b"(bsp_apic_id)
-                         :
-                         :);
-    return bsp_apic_id;
+    uint32_t eax, ebx, ecx, edx;
+
+    // Leaf 0xB has the full 32-bit (x2APIC) ID where there is one,
+    // which is the same as the 8-bit one where that fits...
+    if (cpuid(0xb, &eax, &ebx, &ecx, &edx) && ebx) {
+        return edx;
+    }
+
+    if (!cpuid(0x1, &eax, &ebx, &ecx, &edx)) {
+        // Every x86_64 has leaf 1, so this means init_cpuid hasn't run yet - 0
+        // is at least an ID that exists, which is more than ebx could say...
+        return 0;
+    }
+
+    return ebx >> 24;
 }
 
 inline void cpu_tsc_delay(uint64_t cycles) {
@@ -72,7 +98,7 @@ void cpu_get_brand_str(char *buffer) {
 }
 
 #ifdef DEBUG_CPU
-static void debug_cpu_brand(uint8_t cpu_num) {
+static void debug_cpu_brand(uint16_t cpu_num) {
     char brand[49];
     cpu_get_brand_str(brand);
     kprintf("CPU #%2d: %s\n", cpu_num, brand);
@@ -110,7 +136,7 @@ static void debug_tsc_frequency_msr(void) {
 #define debug_tsc_frequency_msr()
 #endif
 
-void cpu_debug_info(uint8_t cpu_num) {
+void cpu_debug_info(uint16_t cpu_num) {
     debug_cpu_brand(cpu_num);
     debug_tsc_frequency_cpuid();
     debug_tsc_frequency_msr();
@@ -162,11 +188,13 @@ void cpu_invalidate_tlb_all(void) {
  */
 void cpu_swapgs(void) { __asm__ volatile("swapgs" : : : "memory"); }
 
+// Without the PCID (if any) in the low bits, just the PML4
 uintptr_t cpu_read_cr3(void) {
     uintptr_t value;
     __asm__ volatile("mov %%cr3, %0" : "=r"(value));
-    return value;
+    return value & ~0xfffULL;
 }
+
 // 0 = not checked, -1 = don't have, 1 = have
 static int __have__cpu__rdseed;
 
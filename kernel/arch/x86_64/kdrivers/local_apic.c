@@ -8,44 +8,113 @@
 #include <stdbool.h>
 #include <stdint.h>
 
+#include "config.h"
 #include "kdrivers/drivers.h"
 #include "kdrivers/timer.h"
 #include "kprintf.h"
 #include "machine.h"
 #include "platform/acpi/acpitables.h"
-#include "spinlock.h"
 #include "vmm/vmmapper.h"
+#include "x86_64/cpuid.h"
+#include "x86_64/kdrivers/cpu.h"
 #include "x86_64/kdrivers/hpet.h"
 #include "x86_64/kdrivers/local_apic.h"
+#include "x86_64/kdrivers/tsc.h"
 
 #define NANOS_IN_20MS (((uint64_t)20000000))
 
-static void start_timer(uint32_t volatile *lapic, uint8_t mode, uint32_t init_count, uint8_t vector) {
-    // Set up timer
-    *REG_LAPIC_DIVIDE(lapic) = mode;
-    *REG_LAPIC_INITIAL_COUNT(lapic) = init_count;
-    *REG_LAPIC_LVT_TIMER(lapic) = 0x20000 | vector;
+#define CPUID_1_ECX_X2APIC ((1 << 21))
+
+// LAPIC ticks (at divide-by-16) in 20ms, for one-shot mode
+static uint64_t lapic_ticks_20ms;
+
+// Initial count (at divide-by-16) for KERNEL_HZ periodic ticks
+static uint64_t lapic_hz_ticks;
+
+// Chosen by the BSP, every CPU uses the same mode
+static bool x2apic;
+
+bool local_apic_is_x2apic(void) { return x2apic; }
+
+uint32_t local_apic_read(const uint16_t reg) {
+    if (x2apic) {
+        return cpu_read_msr(MSR_X2APIC_REG(reg));
+    }
+
+    uint32_t volatile *lapic = (uint32_t *)(KERNEL_HARDWARE_VADDR_LAPIC);
+    return *(lapic + reg);
 }
 
-static uint64_t local_apic_calibrate_count(const KernelTimer *calibrated_timer, const uint32_t desired_hz) {
+void local_apic_write(const uint16_t reg, const uint32_t value) {
+    if (x2apic) {
+        cpu_write_msr(MSR_X2APIC_REG(reg), value);
+        return;
+    }
+
     uint32_t volatile *lapic = (uint32_t *)(KERNEL_HARDWARE_VADDR_LAPIC);
+    *(lapic + reg) = value;
+}
 
+void local_apic_send_ipi(const uint32_t apic_id, const uint32_t command) {
+    if (x2apic) {
+        // One write, and no delivery status to wait on
+        cpu_write_msr(MSR_X2APIC_REG(REG_LAPIC_ICR_LOW_O), ((uint64_t)apic_id << 32) | command);
+        return;
+    }
+
+    uint32_t volatile *lapic = (uint32_t *)(KERNEL_HARDWARE_VADDR_LAPIC);
+
+    while (*(REG_LAPIC_ICR_LOW(lapic)) & LAPIC_ICR_DELIVERY_STATUS)
+        ;
+
+    *(REG_LAPIC_ICR_HIGH(lapic)) = apic_id << 24;
+    *(REG_LAPIC_ICR_LOW(lapic)) = command;
+}
+
+// Firmware may have switched it on already (it has to, with IDs over 255), in
+// which case there's no going back. Otherwise it's up to us if we can have it.
+static bool choose_x2apic(void) {
+    if (cpu_read_msr(MSR_IA32_APIC_BASE) & IA32_APIC_BASE_X2APIC) {
+        return true;
+    }
+
+#ifdef NO_X2APIC
+    return false;
+#else
+    uint32_t eax, ebx, ecx, edx;
+    return cpuid(0x1, &eax, &ebx, &ecx, &edx) && (ecx & CPUID_1_ECX_X2APIC);
+#endif
+}
+
+static void start_timer(uint8_t mode, uint32_t init_count, uint8_t vector) {
+    // Set up timer
+    local_apic_write(REG_LAPIC_DIVIDE_O, mode);
+    local_apic_write(REG_LAPIC_INITIAL_COUNT_O, init_count);
+    local_apic_write(REG_LAPIC_LVT_TIMER_O, 0x20000 | vector);
+}
+
+static uint64_t local_apic_calibrate_count(const KernelTimer *calibrated_timer, const uint32_t desired_hz,
+                                           uint64_t *tsc_cycles_20ms) {
     const uint64_t calibrated_ticks_20ms = NANOS_IN_20MS / calibrated_timer->nanos_per_tick();
 
     volatile uint64_t calib_start = calibrated_timer->current_ticks();
     const uint64_t calib_end = calib_start + calibrated_ticks_20ms;
 
-    *REG_LAPIC_DIVIDE(lapic) = 0x03;
-    *REG_LAPIC_INITIAL_COUNT(lapic) = 0xffffffff;
-    *REG_LAPIC_LVT_TIMER(lapic) = 0x20000 | LAPIC_TIMER_BSP_VECTOR;
+    local_apic_write(REG_LAPIC_DIVIDE_O, 0x03);
+    local_apic_write(REG_LAPIC_INITIAL_COUNT_O, 0xffffffff);
+    local_apic_write(REG_LAPIC_LVT_TIMER_O, 0x20000 | LAPIC_TIMER_BSP_VECTOR);
+
+    const uint64_t tsc_start = cpu_read_tsc();
 
     while (calib_start < calib_end) {
         calib_start = calibrated_timer->current_ticks();
     }
 
-    *REG_LAPIC_LVT_TIMER(lapic) = 0x10000 | LAPIC_TIMER_BSP_VECTOR;
+    local_apic_write(REG_LAPIC_LVT_TIMER_O, 0x10000 | LAPIC_TIMER_BSP_VECTOR);
 
-    uint64_t ticks_in_20ms = 0xffffffff - *REG_LAPIC_CURRENT_COUNT(lapic);
+    uint64_t ticks_in_20ms = 0xffffffff - local_apic_read(REG_LAPIC_CURRENT_COUNT_O);
+    *tsc_cycles_20ms = cpu_read_tsc() - tsc_start;
+    lapic_ticks_20ms = ticks_in_20ms;
 
 #ifdef DEBUG_CPU
 #ifdef DEBUG_CPU_FREQ
@@ -56,9 +125,7 @@ static uint64_t local_apic_calibrate_count(const KernelTimer *calibrated_timer,
     return ticks_in_20ms * 50 / desired_hz;
 }
 
-static SpinLock init_timers_spinlock;
-
-uint32_t volatile *init_local_apic(ACPI_MADT *madt, bool bsp) {
+void init_local_apic(ACPI_MADT *madt, bool bsp) {
     uint32_t lapic_addr = madt->lapic_address;
 #ifdef DEBUG_LAPIC_INIT
     uint32_t *flags = (uint32_t *)((uintptr_t)lapic_addr) + 1;
@@ -67,43 +134,80 @@ uint32_t volatile *init_local_apic(ACPI_MADT *madt, bool bsp) {
 
     if (bsp) {
         vmm_map_page(KERNEL_HARDWARE_VADDR_LAPIC, lapic_addr, PG_PRESENT | PG_WRITE);
+        x2apic = choose_x2apic();
+
+        kprintf("LAPIC: Using %s mode\n", x2apic ? "x2APIC" : "xAPIC");
     }
 
-    uint32_t volatile *lapic = (uint32_t *)(KERNEL_HARDWARE_VADDR_LAPIC);
+    if (x2apic) {
+        // Has to be enabled in xAPIC mode first (if it isn't already), both bits go at once...
+        const uint64_t apic_base = cpu_read_msr(MSR_IA32_APIC_BASE);
+        cpu_write_msr(MSR_IA32_APIC_BASE, apic_base | IA32_APIC_BASE_ENABLE | IA32_APIC_BASE_X2APIC);
+    }
 
 #ifdef DEBUG_LAPIC_INIT
-    kprintf("LAPIC ID: 0x%08x; Version: 0x%08x\n", *REG_LAPIC_ID(lapic), *REG_LAPIC_VERSION(lapic));
+    kprintf("LAPIC ID: 0x%08x; Version: 0x%08x\n", local_apic_read(REG_LAPIC_ID_O),
+            local_apic_read(REG_LAPIC_VERSION_O));
 #endif
 
     // Set spurious interrupt and enable
-    *(REG_LAPIC_SPURIOUS(lapic)) = 0x1FF;
+    local_apic_write(REG_LAPIC_SPURIOUS_O, 0x1FF);
+
+    // Every LAPIC timer runs off the same clock, so only the BSP calibrates - APs
+    // just reuse its counts, rather than taking 20ms each (one at a time, since
+    // there's only one HPET) while the BSP waits for them to come up.
+    if (bsp) {
+        const uint64_t intr_flags = save_disable_interrupts();
+        KernelTimer *timer = hpet_as_timer();
 
-    // if (bsp) {
-    uint64_t lock_flags = spinlock_lock_irqsave(&init_timers_spinlock);
-    KernelTimer *timer = hpet_as_timer();
+        uint64_t tsc_cycles;
+        lapic_hz_ticks = local_apic_calibrate_count(timer, KERNEL_HZ, &tsc_cycles);
+
+        // We calibrated against the HPET anyway, so take the TSC along for the ride...
+        tsc_clock_init(tsc_cycles, NANOS_IN_20MS, timer->current_ticks() * timer->nanos_per_tick());
+
+        restore_saved_interrupts(intr_flags);
+    }
 
-    uint64_t hz_ticks;
-    hz_ticks = local_apic_calibrate_count(timer, KERNEL_HZ);
-    spinlock_unlock_irqrestore(&init_timers_spinlock, lock_flags);
+    const uint64_t hz_ticks = lapic_hz_ticks;
 
+#ifdef EXPERIMENTAL_TICKLESS
+    // Just the first tick, the timer ISR programs the next
+    // one-shot from then on...
+    local_apic_timer_oneshot(bsp ? LAPIC_TIMER_BSP_VECTOR : LAPIC_TIMER_AP_VECTOR, NANOS_PER_TICK);
+#else
     // /16 mode, init count based on caibrated kernel Hz.
     if (bsp) {
         // Can't start AP timer ticks yet, we don't have everything set up
         // to handle them...
-        start_timer(lapic, 0x03, hz_ticks, LAPIC_TIMER_BSP_VECTOR);
+        start_timer(0x03, hz_ticks, LAPIC_TIMER_BSP_VECTOR);
     } else {
-        start_timer(lapic, 0x03, hz_ticks, LAPIC_TIMER_AP_VECTOR);
+        start_timer(0x03, hz_ticks, LAPIC_TIMER_AP_VECTOR);
     }
-
-    return lapic;
+#endif
 }
 
-uint64_t local_apic_get_count(void) {
-    uint32_t volatile *lapic = (uint32_t *)(KERNEL_HARDWARE_VADDR_LAPIC);
-    return *REG_LAPIC_CURRENT_COUNT(lapic);
-}
+void local_apic_timer_oneshot(const uint8_t vector, uint64_t nanos) {
+    // Longest we can wait before the (32-bit) count runs out
+    const uint64_t max_nanos = (0xffffffff / lapic_ticks_20ms) * NANOS_IN_20MS;
 
-void local_apic_eoe(void) {
-    uint32_t volatile *lapic = (uint32_t *)(KERNEL_HARDWARE_VADDR_LAPIC);
-    *(REG_LAPIC_EOI(lapic)) = 0;
+    if (nanos > max_nanos) {
+        nanos = max_nanos;
+    }
+
+    uint64_t count = nanos * lapic_ticks_20ms / NANOS_IN_20MS;
+
+    if (count == 0) {
+        // Zero would stop the timer, rather than fire it right away
+        count = 1;
+    }
+
+    // /16 mode, one-shot (mode bits clear)
+    local_apic_write(REG_LAPIC_DIVIDE_O, 0x03);
+    local_apic_write(REG_LAPIC_LVT_TIMER_O, vector);
+    local_apic_write(REG_LAPIC_INITIAL_COUNT_O, count);
 }
+
+uint64_t local_apic_get_count(void) { return local_apic_read(REG_LAPIC_CURRENT_COUNT_O); }
+
+void local_apic_eoe(void) { local_apic_write(REG_LAPIC_EOI_O, 0); }
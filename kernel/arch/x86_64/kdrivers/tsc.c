@@ -0,0 +1,72 @@
+/*
+ * stage3 - TSC clock source
+ * anos - An Operating System
+ *
+ * Copyright (c) 2025 Ross Bamford
+ *
+ * Reading the TSC is a lot cheaper than going out to the
+ * HPET, so when it's invariant (i.e. it ticks at a constant
+ * rate regardless of P/C-states) we use it for the kernel's
+ * nanosecond clock.
+ *
+ * This assumes the TSCs are synchronised across CPUs, which
+ * is generally true of anything with an invariant TSC...
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "x86_64/cpuid.h"
+#include "x86_64/kdrivers/cpu.h"
+#include "x86_64/kdrivers/tsc.h"
+
+#ifdef DEBUG_CPU
+#ifdef DEBUG_CPU_FREQ
+#include "kprintf.h"
+#endif
+#endif
+
+static uint64_t tsc_base;
+static uint64_t tsc_base_nanos;
+static uint64_t tsc_nanos_mult; // Nanos per cycle, 32.32 fixed-point
+static bool tsc_usable;
+
+static bool tsc_is_invariant(void) {
+    uint32_t eax, ebx, ecx, edx;
+
+    if (!cpuid(0x80000000, &eax, &ebx, &ecx, &edx) || eax < 0x80000007) {
+        return false;
+    }
+
+    if (!cpuid(0x80000007, &eax, &ebx, &ecx, &edx)) {
+        return false;
+    }
+
+    return (edx & CPUID_80000007_EDX_INVARIANT_TSC) != 0;
+}
+
+bool tsc_clock_init(const uint64_t cycles, const uint64_t interval_nanos, const uint64_t now_nanos) {
+    if (cycles == 0 || !tsc_is_invariant()) {
+        return false;
+    }
+
+    tsc_nanos_mult = (interval_nanos << 32) / cycles;
+    tsc_base = cpu_read_tsc();
+    tsc_base_nanos = now_nanos;
+    tsc_usable = tsc_nanos_mult != 0;
+
+#ifdef DEBUG_CPU
+#ifdef DEBUG_CPU_FREQ
+    kprintf("TSC frequency (calibrated): %ldHz\n", cycles * 1000000000 / interval_nanos);
+#endif
+#endif
+
+    return tsc_usable;
+}
+
+bool tsc_clock_usable(void) { return tsc_usable; }
+
+uint64_t tsc_clock_nanos(void) {
+    const uint64_t cycles = cpu_read_tsc() - tsc_base;
+    return tsc_base_nanos + (uint64_t)(((unsigned __int128)cycles * tsc_nanos_mult) >> 32);
+}
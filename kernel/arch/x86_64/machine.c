@@ -11,7 +11,12 @@
 #include <stdint.h>
 #include <stdnoreturn.h>
 
+#include "kdrivers/timer.h"
+#include "smp/state.h"
+
+#include <x86_64/kdrivers/hpet.h>
 #include <x86_64/kdrivers/local_apic.h>
+#include <x86_64/kdrivers/tsc.h>
 
 void wait_for_interrupt(void) { __asm__ volatile("hlt"); }
 
@@ -71,4 +76,18 @@ void restore_saved_interrupts(uint64_t flags) {
     );
 }
 
-void kernel_timer_eoe(void) { local_apic_eoe(); }
\ No newline at end of file
+void kernel_timer_eoe(void) { local_apic_eoe(); }
+
+uint64_t get_kernel_nanos(void) {
+    if (tsc_clock_usable()) {
+        return tsc_clock_nanos();
+    }
+
+    const KernelTimer *hpet = hpet_as_timer();
+    return hpet->current_ticks() * hpet->nanos_per_tick();
+}
+
+void kernel_timer_oneshot(const uint64_t nanos) {
+    const uint8_t vector = state_get_for_this_cpu()->cpu_id == 0 ? LAPIC_TIMER_BSP_VECTOR : LAPIC_TIMER_AP_VECTOR;
+    local_apic_timer_oneshot(vector, nanos);
+}
\ No newline at end of file
@@ -128,6 +128,12 @@ uint8_t msi_allocate_vector(const uint32_t bus_device_func, const uint64_t owner
             PerCPUState *target_state = state_get_for_any_cpu(target_cpu);
             if (!target_state)
                 target_state = state_get_for_this_cpu();
+
+            // The MSI destination is only 8 bits (without interrupt remapping), so
+            // CPUs with bigger x2APIC IDs can't take them - use the BSP instead.
+            if (target_state && target_state->lapic_id > 0xff)
+                target_state = state_get_for_any_cpu(0);
+
             const uint8_t apic_id = target_state ? target_state->lapic_id : 0;
 
             // MSI address (physical dest mode, no redirection hint).
@@ -21,9 +21,11 @@
 #include "syscalls.h"
 #include "system.h"
 #include "task.h"
+#include "vmm/asid.h"
 
 #include "platform/acpi/acpitables.h"
 
+#include "x86_64/fpu.h"
 #include "x86_64/kdrivers/cpu.h"
 #include "x86_64/kdrivers/hpet.h"
 #include "x86_64/kdrivers/local_apic.h"
@@ -34,7 +36,8 @@
 #include "printhex.h"
 #endif
 
-#define AP_CPUINIT_TIMEOUT 100000000 // 100ms
+#define AP_CPUINIT_TIMEOUT 100000000      // 100ms
+#define AP_CPUINIT_TIMEOUT_PER_AP 2000000 // 2ms, on top of that for each AP
 
 #ifdef DEBUG_MADT
 void debug_madt(ACPI_RSDT *rsdt);
@@ -45,8 +48,9 @@ void debug_madt(ACPI_RSDT *rsdt);
 static ACPI_RSDT *acpi_root_table;
 static ACPI_RSDP *acpi_rsdp_pointer;
 
-static uint32_t volatile *init_this_cpu(ACPI_RSDT *rsdt, const uint8_t cpu_num) {
+static void init_this_cpu(ACPI_RSDT *rsdt, const uint16_t cpu_num) {
     cpu_init_this();
+    fpu_init_this();
     cpu_debug_info(cpu_num);
 
     // Allocate our per-CPU data
@@ -69,7 +73,11 @@ static uint32_t volatile *init_this_cpu(ACPI_RSDT *rsdt, const uint8_t cpu_num)
     cpu_write_msr(MSR_GSBase, 0);
     cpu_swapgs();
 
-    state_register_cpu(cpu_num, cpu_state);
+    if (!state_register_cpu(cpu_num, cpu_state)) {
+        panic("Too many CPUs for per-CPU state");
+    }
+
+    asid_init_this_cpu();
 
     // Init local APIC on this CPU
     ACPI_MADT *madt = acpi_tables_find_madt(rsdt);
@@ -79,7 +87,7 @@ static uint32_t volatile *init_this_cpu(ACPI_RSDT *rsdt, const uint8_t cpu_num)
         halt_and_catch_fire();
     }
 
-    return init_local_apic(madt, cpu_num == 0);
+    init_local_apic(madt, cpu_num == 0);
 }
 
 static inline void *get_this_cpu_tss(void) {
@@ -102,6 +110,10 @@ volatile bool ap_startup_wait;
 // CPUs before proceeding.
 static volatile int ap_waiting_count;
 
+// This is the number of APs that made it through the trampoline - the
+// others (if any) are never coming, so there's no point waiting for them.
+static uint16_t ap_started_count;
+
 noreturn void ap_kernel_entrypoint(uint64_t ap_num) {
 #ifdef DEBUG_SMP_STARTUP
 #ifdef VERY_NOISY_SMP_STARTUP
@@ -111,13 +123,13 @@ noreturn void ap_kernel_entrypoint(uint64_t ap_num) {
 
     syscall_init();
 
-    uint32_t volatile *lapic = init_this_cpu(acpi_root_table, ap_num);
+    init_this_cpu(acpi_root_table, ap_num);
 
     if (!ipwi_init()) {
         panic("Failed to initialise IPWI subsystem for one or more APs");
     }
 
-    ap_waiting_count += 1;
+    __atomic_add_fetch(&ap_waiting_count, 1, __ATOMIC_RELEASE);
 
     while (ap_startup_wait) {
         // just busy right now, but should hlt and wait for an IPI or something...?
@@ -150,12 +162,14 @@ noreturn void ap_kernel_entrypoint(uint64_t ap_num) {
 static bool wait_for_ap_basic_init_to_complete(void) {
     KernelTimer volatile *hpet = hpet_as_timer();
 
-    uint64_t end = hpet->current_ticks() + (AP_CPUINIT_TIMEOUT / hpet->nanos_per_tick());
+    // More APs take longer to get through the shared parts (e.g. FBA, kprintf)
+    const uint64_t timeout = AP_CPUINIT_TIMEOUT + ap_started_count * AP_CPUINIT_TIMEOUT_PER_AP;
+    uint64_t end = hpet->current_ticks() + (timeout / hpet->nanos_per_tick());
 
     while (hpet->current_ticks() < end) {
         __asm__ __volatile__("pause" : : : "memory");
 
-        if (ap_waiting_count == state_get_cpu_count() - 1) {
+        if (ap_waiting_count >= ap_started_count) {
 #ifdef DEBUG_SMP_STARTUP
             kprintf("INFO: All APs report as started\n");
 #endif
@@ -218,13 +232,26 @@ bool platform_init(const uintptr_t platform_data) {
     debug_madt(acpi_root_table);
     kernel_drivers_init(acpi_root_table);
 
-    uint32_t volatile *lapic = init_this_cpu(acpi_root_table, 0);
+#if MAX_CPU_COUNT > 1
+    // Counting needs our own APIC ID (to skip us) from CPUID, so that has to be
+    // set up first - init_this_cpu does it again, but that doesn't matter
+    cpu_init_this();
+    const uint16_t cpu_count = smp_count_cpus(acpi_root_table);
+#else
+    const uint16_t cpu_count = 1;
+#endif
+
+    if (!state_init(cpu_count)) {
+        panic("Failed to allocate per-CPU state");
+    }
+
+    init_this_cpu(acpi_root_table, 0);
 
     msi_init();
 
 #if MAX_CPU_COUNT > 1
     ap_startup_wait = true;
-    smp_bsp_start_aps(acpi_root_table, lapic);
+    ap_started_count = smp_bsp_start_aps(acpi_root_table);
 #endif
 
     syscall_init();
@@ -2,20 +2,21 @@ bits 16
 
 section .text.init
 global _start
-extern KERNEL_BASE, STACKS_BASE, STACK_SHIFT, STACK_START_OFS
+extern STACK_SHIFT, STACK_START_OFS
 
 ; This is the AP trampoline.
 ;
 ; This code is at 0x0100:0000 (0x1000 linear), and we enter in real mode.
-; BSS is at 0x1000, and each AP has its own 2KiB stack in the region starting
-; from 0x6000. The real-mode code is responsible for setting that up 
-; (keep reading).
+; BSS is at 0x5000, and each AP has its own 2KiB stack in a block the BSP
+; allocated for them (at k_stacks). The real-mode code is responsible for
+; setting that up (keep reading).
 ;
 ; The BSS will have a few things already set up by the SMP startup code:
 ;
 ;   * ap_count  - A counter tracking starting APs (starts at 1)
 ;   * k_pml4    - The physical address of the kernel page-tables
-;   * ap_flag   - A flag the AP should set if it makes it to long mode
+;   * ap_flag   - A count of APs that have made it to long mode (starts at 0)
+;   * k_stacks  - The (virtual) base of the AP stacks
 ;
 ; The basic idea here is to get the AP from real mode to long with as
 ; little fuss as possible, then set up the bare-minimum of what needs
@@ -26,18 +27,21 @@ extern KERNEL_BASE, STACKS_BASE, STACK_SHIFT, STACK_START_OFS
 ; AP should "return to" once it's finished setting things up.
 ;
 ; The AP will atomically grab the next available number from the `ap_count`
-; and then select its stack at a suitable offset from 0x9000 based on that
+; and then select its stack at a suitable offset from k_stacks based on that
 ; number. This unique id is passed to the main kernel AP startup code
 ; as the first parameter.
 ;
-; The `ap_flag` is holding the BSP, which will wait 10ms for the AP to
-; set the flag before it's marked as ignored. Currently this doesn't 
-; mean much - it's possible for a "slow" AP to continue the boot and end
-; up in the scheduler, but nothing will ever get scheduled on it because
-; the kernel thinks it's failed so it'll just run its idle thread.
+; All the APs are started at once, and come through here together - nothing
+; in here touches the stack before the AP has picked its own, and nothing
+; else is written by the APs except those two counters, both atomically.
 ;
-; Bear in mind the `ap_flag` is shared between APs, so we can (currently)
-; only boot one at a time, which probably doesn't much matter...
+; The `ap_flag` is holding the BSP, which waits for it to count all the
+; APs it started (or for a timeout) before it unmaps the low memory this
+; is all running from. A "slow" AP that misses that can still continue
+; the boot and end up in the scheduler, but nothing will ever get scheduled
+; on it because the kernel thinks it's failed so it'll just run its idle
+; thread. For that reason, bumping it is the last thing we do here before
+; leaving for the kernel proper.
 ;
 ; The job really then boils down to:
 ;
@@ -45,8 +49,8 @@ extern KERNEL_BASE, STACKS_BASE, STACK_SHIFT, STACK_START_OFS
 ;   * Set up paging & go to long mode
 ;   * Get unique ID
 ;   * Set up stack
-;   * Set flag to unlock the BSP
-;   * Clear regs, housekeeping, then "return"
+;   * Clear regs, housekeeping
+;   * Bump count to unlock the BSP, then "return"
 ;
 ; Once those things are done, the regular kernel code takes over
 ; (see `ap_kernel_entrypoint` in `smp/startup.c`).
@@ -113,9 +117,8 @@ main64:
 
   mov rax,rdi                             ; Set up a stack for protected mode based on unique id...
   shl rax,STACK_SHIFT                     ; ... which we'll shift left by 4
-  add rax,STACKS_BASE                     ; ... and add in the physical stack base
+  add rax,[k_stacks]                      ; ... and add in the (virtual) stack base
   add rax,STACK_START_OFS                 ; ... then point to stack top, minus the return address already stacked...
-  or  rax,KERNEL_BASE                     ; ... make it a virtual kernel address
   mov rsp,rax                             ; ... and we're good!
 
   mov rcx,rdi                             ; Set up the TSS for this specific core,
@@ -125,8 +128,6 @@ main64:
 
   lidt  [k_idtr]                          ; Load the kernel IDT we were given
 
-  mov qword [ap_flag], 1                  ; We made it to long mode, let the bsp know
-
   xor rax, rax                            ; Zero out the rest of the GP registers...
   xor rbx, rbx
   xor rcx, rcx
@@ -152,8 +153,10 @@ main64:
   mov   rax, cr4         ; set CR4.OSFXSR and CR4.OSXMMEXCPT
   or    ax, 3 << 9
   mov   cr4, rax
+  xor   rax, rax
 
-  ret                    ; And "return" to the AP entrypoint
+  lock inc qword [ap_flag]                ; We made it to long mode, let the bsp know
+  ret                                     ; And "return" to the AP entrypoint
 
 align 16
 
@@ -205,8 +208,9 @@ section .bss
 
 ap_count  resq  1         ; Unique ID flag
 k_pml4    resq  1         ; Kernel PML4 (physical)
-ap_flag   resq  1         ; AP booted flag
+ap_flag   resq  1         ; APs booted count
 k_gdtr    resd  3         ; Kernel GDT
 reserved2 resd  1
 k_idtr    resd  3         ; Kernel IDT
 reserved3 resd  1
+k_stacks  resq  1         ; AP stacks base (virtual)
@@ -5,19 +5,29 @@
  * Copyright (c) 2025 Ross Bamford
  */
 
-#include "kdrivers/drivers.h"
+#include "smp/ipwi.h"
+#include "smp/state.h"
 #include "x86_64/kdrivers/local_apic.h"
 
 void arch_ipwi_notify_all_except_current(void) {
     // TODO using ALL_EXCLUDING_SELF is probably a bad idea here,
     //      what if we didn't spin up all APs properly?
     //
-    uint32_t volatile *lapic = (uint32_t *)(KERNEL_HARDWARE_VADDR_LAPIC);
+    local_apic_send_ipi(0, LAPIC_ICR_LEVEL_ASSERT | LAPIC_ICR_DELIVERY_MODE_NMI | LAPIC_ICR_DEST_ALL_EXCLUDING_SELF);
+}
+
+// Caller must have interrupts disabled, so nothing else on this CPU touches the ICR in between...
+void arch_ipwi_notify(PerCPUState *target_state) {
+    local_apic_send_ipi(target_state->lapic_id, LAPIC_ICR_LEVEL_ASSERT | LAPIC_ICR_DELIVERY_MODE_NMI);
+}
 
-    while (*(REG_LAPIC_ICR_LOW(lapic)) & LAPIC_ICR_DELIVERY_STATUS)
-        ;
+// Caller must have interrupts disabled, so nothing else on this CPU touches the ICR in between...
+void arch_ipwi_notify_reschedule(PerCPUState *target_state) {
+    local_apic_send_ipi(target_state->lapic_id,
+                        LAPIC_ICR_LEVEL_ASSERT | LAPIC_ICR_DELIVERY_MODE_FIXED | IPWI_RESCHEDULE_VECTOR);
+}
 
-    *(REG_LAPIC_ICR_HIGH(lapic)) = 0;
-    *(REG_LAPIC_ICR_LOW(lapic)) =
-            LAPIC_ICR_LEVEL_ASSERT | LAPIC_ICR_DELIVERY_MODE_NMI | LAPIC_ICR_DEST_ALL_EXCLUDING_SELF;
+void handle_ipwi_reschedule_interrupt(void) {
+    local_apic_eoe();
+    ipwi_reschedule_handler();
 }
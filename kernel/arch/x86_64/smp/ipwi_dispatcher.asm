@@ -8,8 +8,8 @@ bits 64
 
 %include "kernel/arch/x86_64/isr_common.asm"
 
-global ipwi_ipi_dispatcher
-extern ipwi_ipi_handler
+global ipwi_ipi_dispatcher, ipwi_reschedule_dispatcher
+extern ipwi_ipi_handler, handle_ipwi_reschedule_interrupt
 
 ; Register this with IRQ_TYPE_IRQ to disable interrupts (may not
 ; matter now we use NMI...)
@@ -23,4 +23,18 @@ ipwi_ipi_dispatcher:
 
     popa_sysv                               ; Restore all caller-saved registers
     irq_conditional_swapgs
-    iretq
\ No newline at end of file
+    iretq
+
+; Reschedule requests are a normal, maskable interrupt (unlike the
+; NMI above) since the handler needs to take the scheduler lock.
+;
+ipwi_reschedule_dispatcher:
+    cld
+    irq_conditional_swapgs
+    pusha_sysv                              ; Push all caller-saved registers
+
+    call handle_ipwi_reschedule_interrupt
+
+    popa_sysv                               ; Restore all caller-saved registers
+    irq_conditional_swapgs
+    iretq
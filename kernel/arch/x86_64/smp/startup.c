@@ -5,12 +5,13 @@
  * Copyright (c) 2023 Ross Bamford
  */
 
+#include <stdbool.h>
 #include <stdint.h>
 #include <stdnoreturn.h>
 
-#include "debugprint.h"
+#include "fba/alloc.h"
+#include "kprintf.h"
 #include "platform/acpi/acpitables.h"
-#include "printdec.h"
 #include "std/string.h"
 #include "vmm/vmmapper.h"
 #include "x86_64/cpuid.h"
@@ -20,10 +21,6 @@
 #include "x86_64/kdrivers/hpet.h"
 #include "x86_64/kdrivers/local_apic.h"
 
-#ifdef DEBUG_SMP_STARTUP
-#include "kprintf.h"
-#endif
-
 extern void *_binary_kernel_arch_x86_64_realmode_bin_start, *_binary_kernel_arch_x86_64_realmode_bin_end;
 
 // If you're changing any of these, you'll need to change the real-mode
@@ -31,9 +28,8 @@ extern void *_binary_kernel_arch_x86_64_realmode_bin_start, *_binary_kernel_arch
 //
 #define AP_TRAMPOLINE_RUN_PADDR ((0x1000))
 #define AP_TRAMPOLINE_BSS_PADDR ((0x5000))
-#define AP_TRAMPOLINE_STK_PADDR ((0x6000))
+#define AP_TRAMPOLINE_END_PADDR ((0x6000))
 #define AP_TRAMPOLINE_CPU_STK_SIZE ((0x800))
-#define AP_TRAMPOLINE_STK_TOTAL_SIZE ((0x8000))
 
 // All these are derived from the addresses above :)
 //
@@ -63,93 +59,260 @@ extern void *_binary_kernel_arch_x86_64_realmode_bin_start, *_binary_kernel_arch
 #define AP_TRAMPOLINE_BSS_IDT_VADDR ((AP_TRAMPOLINE_BSS_VADDR + 0x28))
 #define AP_TRAMPOLINE_BSS_IDT (((IDTR *)(AP_TRAMPOLINE_BSS_IDT_VADDR)))
 
+#define AP_TRAMPOLINE_BSS_STACKS_VADDR ((AP_TRAMPOLINE_BSS_VADDR + 0x38))
+#define AP_TRAMPOLINE_BSS_STACKS (((uint64_t volatile *)(AP_TRAMPOLINE_BSS_STACKS_VADDR)))
+
+// Highest APIC ID we can send to without x2APIC (0xff is broadcast)
+#define XAPIC_MAX_ID ((0xfe))
+
 #define POST_INIT_DELAY 10000000    // 10ms
 #define FIRST_SIPI_TIMEOUT 10000000 // 10ms
 
 #ifdef SMP_TWO_SIPI_ATTEMPTS
+#define POST_SIPI_DELAY 200000         // 200us
 #define SECOND_SIPI_TIMEOUT 1000000000 // 1000ms
 #endif
 
 noreturn void ap_kernel_entrypoint(uint64_t ap_num);
 
+// BSP only, and only at boot - so it can live here, rather than on the stack
+static uint32_t ap_ids[MAX_CPU_COUNT];
+
+static inline uint64_t smp_now_nanos(KernelTimer volatile *hpet) {
+    return hpet->current_ticks() * hpet->nanos_per_tick();
+}
+
+static void smp_send_sipis(const int ap_count) {
+    for (int i = 0; i < ap_count; i++) {
+        local_apic_send_ipi(ap_ids[i], 0x4600 | (AP_TRAMPOLINE_RUN_PADDR >> 12));
+    }
+}
+
+static bool smp_have_ap(const int ap_count, const uint32_t apic_id) {
+    for (int i = 0; i < ap_count; i++) {
+        if (ap_ids[i] == apic_id) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
 /*
- * Must only be called by the BSP for now!
+ * Collect the APIC IDs of all the APs we can start (at most MAX_CPU_COUNT - 1)
+ * into ap_ids, from both the xAPIC (type 0) and x2APIC (type 9) entries - the
+ * latter are only there for IDs that don't fit in a byte, but firmware is
+ * allowed to list them twice so we skip any we've already seen.
+ *
+ * IDs over XAPIC_MAX_ID only count if `x2apic_only_ok` - we can't send IPIs to
+ * them without x2APIC, but we don't know which mode we'll use when counting.
  */
-static void smp_bsp_start_ap(uint8_t ap_id, uint32_t volatile *lapic) {
-    KernelTimer volatile *hpet = hpet_as_timer();
+__attribute__((no_sanitize("alignment"))) // we have to go byte-wise through the ACPI tables...
+static int smp_find_aps(ACPI_RSDT *rsdt, const bool x2apic_only_ok) {
+    ACPI_MADT *madt = acpi_tables_find_madt(rsdt);
+    int ap_count = 0;
 
-    // Clear the "alive" flag
-    *(AP_TRAMPOLINE_BSS_FLAG) = 0;
+    if (!madt) {
+        return 0;
+    }
 
-    __asm__ volatile("" ::: "memory");
+    uint16_t remain = madt->header.length - sizeof(ACPI_MADT);
+    uint8_t *ptr = ((uint8_t *)madt) + sizeof(ACPI_MADT);
+    const uint32_t bsp_local_apic_id = cpu_read_local_apic_id();
 
-    // Send INIT
-    *(REG_LAPIC_ICR_HIGH(lapic)) = ap_id << 24;
-    *(REG_LAPIC_ICR_LOW(lapic)) = 0x4500;
+    while (remain > 0) {
+        const uint8_t type = ptr[0];
+        const uint8_t len = ptr[1];
+        uint32_t cpu_id, lapic_id, flags;
 
-    hpet->delay_nanos(POST_INIT_DELAY);
+        switch (type) {
+        case 0: // Processor local APIC
+            cpu_id = ptr[2];
+            lapic_id = ptr[3];
+            flags = *(uint32_t *)(ptr + 4);
+            break;
+        case 9: // Processor local x2APIC
+            lapic_id = *(uint32_t *)(ptr + 4);
+            flags = *(uint32_t *)(ptr + 8);
+            cpu_id = *(uint32_t *)(ptr + 12);
+            break;
+        default:
+            ptr += len;
+            remain -= len;
+            continue;
+        }
 
-    // Send SIPI
-    *(REG_LAPIC_ICR_HIGH(lapic)) = ap_id << 24;
-    *(REG_LAPIC_ICR_LOW(lapic)) = 0x4600 | (AP_TRAMPOLINE_RUN_PADDR >> 12);
+        ptr += len;
+        remain -= len;
 
-    hpet->delay_nanos(POST_INIT_DELAY);
+#ifdef DEBUG_SMP_STARTUP
+        kprintf("ACPI : CPU ID 0x%02x\n", cpu_id);
+#endif
 
-    // Wait for the "alive" flag
-    uint64_t end = hpet->current_ticks() + (FIRST_SIPI_TIMEOUT / hpet->nanos_per_tick());
+        if (lapic_id == bsp_local_apic_id || !((flags & 1) ^ ((flags >> 1) & 1)) ||
+            (lapic_id > XAPIC_MAX_ID && !x2apic_only_ok) || smp_have_ap(ap_count, lapic_id)) {
+#ifdef DEBUG_SMP_STARTUP
+#ifdef VERY_NOISY_SMP_STARTUP
+            if (lapic_id == bsp_local_apic_id) {
+                kprintf("Skipping CPU ID 0x%02x - it is the BSP\n", cpu_id);
+            } else {
+                kprintf("Cannot enable CPU ID 0x%02x [LAPIC 0x%02x; "
+                        "Flags: 0x%08x]\n",
+                        cpu_id, lapic_id, flags);
+            }
+#endif
+#endif
+            continue;
+        }
 
-    while (hpet->current_ticks() < end) {
-        if (*AP_TRAMPOLINE_BSS_FLAG) {
-            break;
+        // can enable!
+#ifdef DEBUG_SMP_STARTUP
+#ifdef VERY_NOISY_SMP_STARTUP
+        kprintf("Will enable CPU ID 0x%02x [LAPIC 0x%02x; Flags: "
+                "0x%08x]\n",
+                cpu_id, lapic_id, flags);
+#endif
+#endif
+
+        if (ap_count < MAX_CPU_COUNT - 1) {
+            ap_ids[ap_count++] = lapic_id;
+        } else {
+#ifdef DEBUG_SMP_STARTUP
+            kprintf("CPU 0x%02x skipped; MAX_CPU_COUNT "
+                    "exhausted...\n",
+                    cpu_id);
+#endif
         }
     }
 
-#ifdef SMP_TWO_SIPI_ATTEMPTS
-    if (!*AP_TRAMPOLINE_BSS_FLAG) {
-        // One more try... Send another SIPI
-        *(REG_LAPIC_ICR_HIGH(lapic)) = ap_id << 24;
-        *(REG_LAPIC_ICR_LOW(lapic)) = 0x4600 | (AP_TRAMPOLINE_RUN_PADDR >> 12);
+    return ap_count;
+}
 
-        uint64_t end = hpet->current_ticks() + (SECOND_SIPI_TIMEOUT / hpet->nanos_per_tick());
+uint16_t smp_count_cpus(ACPI_RSDT *rsdt) { return smp_find_aps(rsdt, true) + 1; }
 
-        while (hpet->current_ticks() < end) {
-            if (*AP_TRAMPOLINE_BSS_FLAG) {
-                break;
-            }
+static bool smp_wait_for_aps(KernelTimer volatile *hpet, const int ap_count, const uint64_t timeout_nanos) {
+    const uint64_t end = hpet->current_ticks() + (timeout_nanos / hpet->nanos_per_tick());
+
+    while (*AP_TRAMPOLINE_BSS_FLAG < ap_count) {
+        if (hpet->current_ticks() >= end) {
+            return false;
         }
+
+        __asm__ volatile("pause" : : : "memory");
+    }
+
+    return true;
+}
+
+/*
+ * Must only be called by the BSP for now!
+ *
+ * Starts all the given APs together - INIT goes to all of them, then
+ * (once the one delay is over) SIPI goes to all of them, and then we
+ * wait for them all to count themselves in at once, instead of taking
+ * the whole INIT-SIPI-wait round trip for each in turn.
+ *
+ * A SIPI is ignored by a CPU that isn't waiting for one, so re-sending
+ * to all of them is safe if some are already on their way.
+ */
+static uint16_t smp_bsp_start_ap_batch(const int ap_count) {
+    KernelTimer volatile *hpet = hpet_as_timer();
+
+    const uint64_t start = smp_now_nanos(hpet);
+
+    // Send INIT to everyone
+    for (int i = 0; i < ap_count; i++) {
+        local_apic_send_ipi(ap_ids[i], 0x4500);
     }
+
+    hpet->delay_nanos(POST_INIT_DELAY);
+
+    const uint64_t init_done = smp_now_nanos(hpet);
+
+    // Send SIPI to everyone
+    smp_send_sipis(ap_count);
+
+    const uint64_t sipi_done = smp_now_nanos(hpet);
+
+    // Wait for them all to come alive
+#ifdef SMP_TWO_SIPI_ATTEMPTS
+    if (!smp_wait_for_aps(hpet, ap_count, FIRST_SIPI_TIMEOUT)) {
+        // One more try... Send another SIPI to everyone
+        hpet->delay_nanos(POST_SIPI_DELAY);
+        smp_send_sipis(ap_count);
+
+        smp_wait_for_aps(hpet, ap_count, SECOND_SIPI_TIMEOUT);
+    }
+#else
+    smp_wait_for_aps(hpet, ap_count, FIRST_SIPI_TIMEOUT);
 #endif
 
+    const uint64_t end = smp_now_nanos(hpet);
+    const uint64_t alive = *AP_TRAMPOLINE_BSS_FLAG;
+
+    kprintf("SMP: %ld of %d APs up in %ldus [INIT %ldus; SIPI %ldus; wait %ldus]\n", alive, ap_count,
+            (end - start) / 1000, (init_done - start) / 1000, (sipi_done - init_done) / 1000,
+            (end - sipi_done) / 1000);
+
 #ifdef DEBUG_SMP_STARTUP
-    if (!*AP_TRAMPOLINE_BSS_FLAG) {
-        kprintf("WARN: CPU #%d failed to respond - will disable it\n", ap_id);
-    } else {
-        kprintf("AP #%d is up...\n", ap_id);
+    if (alive < ap_count) {
+        kprintf("WARN: %ld CPU(s) failed to respond - will disable them\n", ap_count - alive);
     }
 #endif
+
+    return alive;
 }
 
-__attribute__((no_sanitize("alignment"))) // we have to go byte-wise through the ACPI tables...
-void smp_bsp_start_aps(ACPI_RSDT *rsdt, uint32_t volatile *lapic) {
+/*
+ * Each AP's trampoline stack is picked by the unique ID it gets there
+ * (from 1 - the BSP is 0, so never uses the first). They're only used
+ * until the AP starts its idle task, but that's forever as far as
+ * we're concerned here.
+ */
+static bool smp_alloc_ap_stacks(const int ap_count) {
+    const uint32_t bytes = (ap_count + 1) * AP_TRAMPOLINE_CPU_STK_SIZE;
+    uint8_t *stacks = fba_alloc_blocks((bytes + KERNEL_FBA_BLOCK_SIZE - 1) / KERNEL_FBA_BLOCK_SIZE);
+
+    if (!stacks) {
+        return false;
+    }
+
+    // Place return address to ap_kernel_entrypoint on each stack
+    for (int i = 1; i <= ap_count; i++) {
+        *((uintptr_t *)(stacks + (i + 1) * AP_TRAMPOLINE_CPU_STK_SIZE - 8)) = (uintptr_t)&ap_kernel_entrypoint;
+    }
+
+    *(AP_TRAMPOLINE_BSS_STACKS) = (uintptr_t)stacks;
+
+    return true;
+}
+
+uint16_t smp_bsp_start_aps(ACPI_RSDT *rsdt) {
+    const int ap_count = smp_find_aps(rsdt, local_apic_is_x2apic());
+
+    if (!ap_count) {
+        return 0;
+    }
+
     // copy the AP trampoline code to a fixed address in low conventional memory
     memcpy(AP_TRAMPOLINE_BASE_VADDR, AP_TRAMPOLINE_BIN_START, AP_TRAMPOLINE_BIN_LENGTH);
 
     // Clear the AP code BSS
     memclr(AP_TRAMPOLINE_BSS_VADDR, AP_TRAMPOLINE_BSS_LENGTH);
 
-    // Temp identity map the low memory pages so APs can enable paging
-    for (int i = AP_TRAMPOLINE_RUN_PADDR; i < 0x10000; i += 0x1000) {
-        vmm_map_page(i, i, PG_PRESENT | PG_WRITE);
+    if (!smp_alloc_ap_stacks(ap_count)) {
+        kprintf("WARN: No memory for AP stacks - APs will not be started\n");
+        return 0;
     }
 
-    // Placed return address to ap_kernel_entrypoint on each stack
-    for (uintptr_t i = AP_TRAMPOLINE_STK_PADDR + AP_TRAMPOLINE_CPU_STK_SIZE - 8;
-         i < (AP_TRAMPOLINE_STK_PADDR + AP_TRAMPOLINE_STK_TOTAL_SIZE); i += AP_TRAMPOLINE_CPU_STK_SIZE) {
-        *((uintptr_t *)i) = (uintptr_t)&ap_kernel_entrypoint;
+    // Temp identity map the low memory pages so APs can enable paging
+    for (int i = AP_TRAMPOLINE_RUN_PADDR; i < AP_TRAMPOLINE_END_PADDR; i += 0x1000) {
+        vmm_map_page(i, i, PG_PRESENT | PG_WRITE);
     }
 
-    // Start AP unique ID's at 1 (since BSP is logically 0)
+    // Start AP unique ID's at 1 (since BSP is logically 0), none alive yet
     *(AP_TRAMPOLINE_BSS_UID) = 1;
+    *(AP_TRAMPOLINE_BSS_FLAG) = 0;
 
     // Give APs the same pagetables we have to start with
     *(AP_TRAMPOLINE_BSS_PML4) = vmm_virt_to_phys((uintptr_t)vmm_find_pml4());
@@ -158,72 +321,12 @@ void smp_bsp_start_aps(ACPI_RSDT *rsdt, uint32_t volatile *lapic) {
     cpu_store_gdtr(AP_TRAMPOLINE_BSS_GDT);
     cpu_store_idtr(AP_TRAMPOLINE_BSS_IDT);
 
-    ACPI_MADT *madt = acpi_tables_find_madt(rsdt);
-
-    if (madt) {
-        uint16_t remain = madt->header.length - sizeof(ACPI_MADT);
-        uint8_t *ptr = ((uint8_t *)madt) + sizeof(ACPI_MADT);
-        uint8_t bsp_local_apic_id = cpu_read_local_apic_id();
-
-        while (remain > 0) {
-            uint8_t *type = ptr++;
-            uint8_t *len = ptr++;
-
-            switch (*type) {
-            case 0: // Processor local APIC
-                uint8_t cpu_id = *ptr++;
-                uint8_t lapic_id = *ptr++;
-                uint32_t *flags32 = (uint32_t *)ptr;
-                uint32_t flags = *flags32;
-
-#ifdef DEBUG_SMP_STARTUP
-                kprintf("ACPI : CPU ID 0x%02x\n", cpu_id);
-#endif
-
-                if (lapic_id != bsp_local_apic_id && (flags & 1) ^ ((flags >> 1) & 1)) {
-                    // can enable!
-#ifdef DEBUG_SMP_STARTUP
-#ifdef VERY_NOISY_SMP_STARTUP
-                    kprintf("Will enable CPU ID 0x%02x [LAPIC 0x%02x; Flags: "
-                            "0x%08x]\n",
-                            cpu_id, lapic_id, flags);
-#endif
-#endif
-                    if (cpu_id < MAX_CPU_COUNT) {
-                        smp_bsp_start_ap(lapic_id, lapic);
-                    } else {
-#ifdef DEBUG_SMP_STARTUP
-                        kprintf("CPU 0x%02x skipped; MAX_CPU_COUNT "
-                                "exhausted...\n",
-                                cpu_id);
-#endif
-                    }
-                } else {
-#ifdef DEBUG_SMP_STARTUP
-#ifdef VERY_NOISY_SMP_STARTUP
-                    if (lapic_id == bsp_local_apic_id) {
-                        kprintf("Skipping CPU ID 0x%02x - it is the BSP\n", cpu_id);
-                    } else {
-                        kprintf("Cannot enable CPU ID 0x%02x [LAPIC 0x%02x; "
-                                "Flags: 0x%08x]\n",
-                                cpu_id, lapic_id, flags);
-                    }
-#endif
-#endif
-                }
-
-                ptr += 4;
-                break;
-            default:
-                ptr += *len - 2;
-            }
-
-            remain -= *len;
-        }
-    }
+    const uint16_t alive = smp_bsp_start_ap_batch(ap_count);
 
     // Unmap the low pages, they aren't needed any more...
-    for (int i = AP_TRAMPOLINE_RUN_PADDR; i < 0x10000; i += 0x1000) {
+    for (int i = AP_TRAMPOLINE_RUN_PADDR; i < AP_TRAMPOLINE_END_PADDR; i += 0x1000) {
         vmm_unmap_page(i);
     }
+
+    return alive;
 }
@@ -11,7 +11,7 @@
 %endif
 
 global FUNC(spinlock_init)
-global FUNC(spinlock_lock), FUNC(spinlock_unlock)
+global FUNC(spinlock_lock), FUNC(spinlock_unlock), FUNC(spinlock_try_lock)
 global FUNC(spinlock_lock_irqsave), FUNC(spinlock_unlock_irqrestore)
 
 global FUNC(spinlock_reentrant_init)
@@ -41,6 +41,23 @@ FUNC(spinlock_lock):
     jmp .wait
 
 
+; args:
+;   rdi - *lock
+;
+; ret:
+;   rax - 1 if lock taken, 0 if already held
+;
+FUNC(spinlock_try_lock):
+    xor     rax, rax
+    test    qword [rdi], 1                  ; Don't bother bouncing the line if it's held
+    jnz     .busy
+    lock bts qword [rdi], 0         ; No elision hint, we might not unlock
+    setnc   al
+
+.busy:
+    ret
+
+
 ; args:
 ;   rdi - *lock
 ;
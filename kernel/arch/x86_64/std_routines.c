@@ -1,6 +1,40 @@
+#include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
 
+#include "vmm/vmconfig.h"
+#include "x86_64/std_routines.h"
+
+// Below these, the plain loops beat the startup cost of the rep forms
+#define REP_MOVSB_THRESHOLD ((128))
+#define REP_MOVSB_THRESHOLD_FSRM ((16))
+#define REP_STOSB_THRESHOLD ((128))
+
+// Non-temporal stores only pay off once it's more than the cache would hold anyway
+#define NON_TEMPORAL_THRESHOLD ((256 * 1024))
+
+static uint32_t std_features;
+
+void std_routines_set_features(const uint32_t features) { std_features = features; }
+
+uint32_t std_routines_get_features(void) { return std_features; }
+
+static inline bool use_rep_movsb(const size_t count) {
+    if (!(std_features & STD_ROUTINES_FEATURE_ERMS)) {
+        return false;
+    }
+
+    return count >= (std_features & STD_ROUTINES_FEATURE_FSRM ? REP_MOVSB_THRESHOLD_FSRM : REP_MOVSB_THRESHOLD);
+}
+
+static inline void rep_movsb(void *dest, const void *src, size_t count) {
+    __asm__ volatile("rep movsb" : "+D"(dest), "+S"(src), "+c"(count) : : "memory");
+}
+
+static inline void rep_stosb(void *dest, const uint8_t val, size_t count) {
+    __asm__ volatile("rep stosb" : "+D"(dest), "+c"(count) : "a"(val) : "memory");
+}
+
 __attribute__((no_sanitize("alignment"))) // Can't align both src and dest in the general case..
 #ifdef UNIT_TESTS
 void *anos_std_memcpy(void *restrict dest, const void *restrict src, size_t count)
@@ -32,6 +66,11 @@ void *memcpy(void *restrict dest, const void *restrict src, size_t count)
         return dest;
     }
 
+    if (use_rep_movsb(count)) {
+        rep_movsb(dest, src, count);
+        return dest;
+    }
+
     // Align destination to 8 bytes
     size_t align = (8 - ((uintptr_t)d & 7)) & 7;
     if (align) {
@@ -64,7 +103,7 @@ void *memcpy(void *restrict dest, const void *restrict src, size_t count)
     count &= 7;
 
     // For large copies, use non-temporal stores
-    if (blocks >= 32) {        // 256 bytes or more
+    if (blocks >= (NON_TEMPORAL_THRESHOLD >> 3)) {
         while (blocks >= 16) { // Process 128 bytes at a time
             // TODO prefetch...
 
@@ -112,6 +151,22 @@ void *memcpy(void *restrict dest, const void *restrict src, size_t count)
         __asm__ volatile("sfence" : : : "memory");
     }
 
+    // Anything from 128 bytes up that's left goes 64 at a time, the
+    // Duff's device below only covers up to 15 blocks...
+    while (blocks >= 8) {
+        d64[0] = s64[0];
+        d64[1] = s64[1];
+        d64[2] = s64[2];
+        d64[3] = s64[3];
+        d64[4] = s64[4];
+        d64[5] = s64[5];
+        d64[6] = s64[6];
+        d64[7] = s64[7];
+        d64 += 8;
+        s64 += 8;
+        blocks -= 8;
+    }
+
     // Handle remaining blocks with regular stores
     switch (blocks) {
     case 15:
@@ -186,6 +241,12 @@ void *memmove(void *dest, const void *src, size_t count)
     }
 
     if (d < s || d >= s + count) {
+        // Forward rep movsb is fine with overlap, it's defined bytewise
+        if (use_rep_movsb(count)) {
+            rep_movsb(d, s, count);
+            return dest;
+        }
+
         while (((uintptr_t)d & 7) && count) {
             *d++ = *s++;
             count--;
@@ -193,7 +254,7 @@ void *memmove(void *dest, const void *src, size_t count)
 
         uint64_t *d64 = (uint64_t *)d;
         const uint64_t *s64 = (const uint64_t *)s;
-        while (count >= 64) {
+        while (count >= NON_TEMPORAL_THRESHOLD && count >= 64) {
             __asm__ volatile("movq (%1), %%r8;\n"
                              "movq 8(%1), %%r9;\n"
                              "movq 16(%1), %%r10;\n"
@@ -219,6 +280,16 @@ void *memmove(void *dest, const void *src, size_t count)
         }
         __asm__ volatile("sfence" ::: "memory");
 
+        while (count >= 64) {
+            for (int i = 0; i < 8; i++) {
+                d64[i] = s64[i];
+            }
+
+            d64 += 8;
+            s64 += 8;
+            count -= 64;
+        }
+
         d = (unsigned char *)d64;
         s = (const unsigned char *)s64;
         while (count--) {
@@ -282,13 +353,18 @@ void *memset(void *dest, int val, size_t count)
     fill |= fill << 16;
     fill |= fill << 32;
 
+    if ((std_features & STD_ROUTINES_FEATURE_ERMS) && count >= REP_STOSB_THRESHOLD) {
+        rep_stosb(d, (uint8_t)val, count);
+        return dest;
+    }
+
     while (((uintptr_t)d & 7) && count) {
         *d++ = (unsigned char)val;
         count--;
     }
 
     uint64_t *d64 = (uint64_t *)d;
-    while (count >= 64) {
+    while (count >= NON_TEMPORAL_THRESHOLD && count >= 64) {
         __asm__ volatile("movnti %1, (%0);\n"
                          "movnti %1, 8(%0);\n"
                          "movnti %1, 16(%0);\n"
@@ -305,6 +381,20 @@ void *memset(void *dest, int val, size_t count)
     }
     __asm__ volatile("sfence" ::: "memory");
 
+    while (count >= 64) {
+        d64[0] = fill;
+        d64[1] = fill;
+        d64[2] = fill;
+        d64[3] = fill;
+        d64[4] = fill;
+        d64[5] = fill;
+        d64[6] = fill;
+        d64[7] = fill;
+
+        d64 += 8;
+        count -= 64;
+    }
+
     d = (unsigned char *)d64;
     while (count--) {
         *d++ = (unsigned char)val;
@@ -319,3 +409,50 @@ void *memclr(void *dest, size_t count) {
     return memset(dest, 0, count);
 #endif
 }
+
+void *memcpy_page(void *restrict dest, const void *restrict src) {
+    if (std_features & STD_ROUTINES_FEATURE_ERMS) {
+        rep_movsb(dest, src, VM_PAGE_SIZE);
+    } else {
+        void *d = dest;
+        size_t count = VM_PAGE_SIZE >> 3;
+        __asm__ volatile("rep movsq" : "+D"(d), "+S"(src), "+c"(count) : : "memory");
+    }
+
+    return dest;
+}
+
+void *memclr_page(void *dest) {
+    if (std_features & STD_ROUTINES_FEATURE_ERMS) {
+        rep_stosb(dest, 0, VM_PAGE_SIZE);
+    } else {
+        void *d = dest;
+        size_t count = VM_PAGE_SIZE >> 3;
+        __asm__ volatile("rep stosq" : "+D"(d), "+c"(count) : "a"(0ULL) : "memory");
+    }
+
+    return dest;
+}
+
+void *memclr_page_nt(void *dest) {
+    uint64_t *d64 = (uint64_t *)dest;
+    const uint64_t *end = d64 + (VM_PAGE_SIZE >> 3);
+
+    while (d64 < end) {
+        __asm__ volatile("movnti %1, (%0);\n"
+                         "movnti %1, 8(%0);\n"
+                         "movnti %1, 16(%0);\n"
+                         "movnti %1, 24(%0);\n"
+                         "movnti %1, 32(%0);\n"
+                         "movnti %1, 40(%0);\n"
+                         "movnti %1, 48(%0);\n"
+                         "movnti %1, 56(%0);\n"
+                         :
+                         : "r"(d64), "r"(0ULL)
+                         : "memory");
+        d64 += 8;
+    }
+    __asm__ volatile("sfence" ::: "memory");
+
+    return dest;
+}
@@ -8,40 +8,39 @@ bits 64
 global task_do_switch
 extern task_current_ptr, task_tss_ptr   ; TODO tss_ptr not used here now...
                                         ;      but needs setting up properly!
+extern fpu_save_mode
 
 %define TASK_DATA   8                   ; Task struct offsets
 %define TASK_RSP0   24
 %define TASK_SSP    32
-%define TASK_PML4   48
 
 %define TSS_RSP0    4                   ; Offset of RSP0 in a TSS
 
+%define FPU_SAVE_FXSAVE     0           ; FpuSaveMode values (see x86_64/fpu.h)
+%define FPU_SAVE_XSAVE      1
+%define FPU_SAVE_XSAVEOPT   2
+%define FPU_SAVE_XSAVES     3
+
 %include "smp/state.inc"
 
 ; **Must** be called with scheduler locked!
 ;
-; TODO this could be optimized (e.g. always fxsave/fxrstor, etc)
+; The new task's page tables are already loaded by now (see asid_switch_to),
+; the kernel half is the same everywhere so this doesn't care either way.
+;
+; This is only ever called from C, so only the callee-saved registers
+; need to survive - anything else the caller has already dealt with.
+; rsi / rdi come along too so a new task gets its entrypoint args.
+;
 task_do_switch:
-    mov     [temp_rsi],rsi
+    mov     rax,[gs:0]                      ; Load per-CPU data pointer
+    mov     rax,[rax+CPU_TASK_CURRENT]      ; ... and current task from it
 
-    mov     rsi,[gs:0]                      ; Load per-CPU data pointer
-    add     rsi,CPU_TASK_CURRENT            ; Advance pointer to current task
-    mov     rsi,[rsi]                       ; ... and load it
-
-    test    rsi,rsi
+    test    rax,rax
     jz      .next                           ; If it's NULL, don't save anything...
-    mov     rsi,[temp_rsi]
 
-    ; TODO don't need to save all these, caller saved some of them...
-    push    rax                             ; Push all GP registers
-    push    rbx
-    push    rcx
-    push    rdx
+    push    rbx                             ; Push callee-saved registers
     push    rbp
-    push    r8
-    push    r9
-    push    r10
-    push    r11
     push    r12
     push    r13
     push    r14
@@ -49,14 +48,33 @@ task_do_switch:
     push    rsi                             ; Order matters! task_user_entrypoint relies
     push    rdi                             ; on rsi/rdi order for arguments here!
 
-    mov     rsi,[gs:0]                      ; Load per-CPU data pointer
-    add     rsi,CPU_TASK_CURRENT            ; Advance pointer to current task
-    mov     rsi,[rsi]                       ; ... and load it
+    mov     [rax+TASK_SSP],rsp              ; Save stack pointer
+
+    mov     rsi,[rax+TASK_DATA]             ; Find task data pointer for FPU state
+    mov     eax,0xffffffff                  ; Everything XCR0 has enabled
+    mov     edx,eax
+    movzx   ecx,byte [fpu_save_mode]
 
-    mov     [rsi+TASK_SSP],rsp              ; Save stack pointer
+    cmp     ecx,FPU_SAVE_XSAVES
+    je      .save_xsaves
+    cmp     ecx,FPU_SAVE_XSAVEOPT
+    je      .save_xsaveopt
+    cmp     ecx,FPU_SAVE_XSAVE
+    je      .save_xsave
 
-    mov     rsi,[rsi+TASK_DATA]             ; Find task data pointer
-    fxsave  [rsi]                           ; ... and just store fp state there.
+    fxsave64 [rsi]
+    jmp     .next
+
+.save_xsaves:
+    xsaves64 [rsi]                          ; Skips init / unmodified state, compacted
+    jmp     .next
+
+.save_xsaveopt:
+    xsaveopt64 [rsi]                        ; Skips init / unmodified state
+    jmp     .next
+
+.save_xsave:
+    xsave64 [rsi]
 
 .next:
     mov     rsi,[gs:0]                      ; Load per-CPU data pointer
@@ -77,33 +95,34 @@ task_do_switch:
     mov     rsi,[rsi]                       ; get TSS pointer into rsi
     mov     [rsi+TSS_RSP0],rax              ; ... and store kernel stack into TSS RSP0
 
-    mov     rax, cr3                        ; Is CR3 different for the new task?
-    mov     rcx, [rdi+TASK_PML4]
-    cmp     rax,rcx
-    je      .page_tables_done               ; If not, skip changing (so no TLB flush)...
-    mov     cr3,rcx                         ; ... else, switch out cr3 with the new tables.
-
-.page_tables_done:
     mov     rdi,[rdi+TASK_DATA]             ; Find new task data pointer
-    fxrstor [rdi]                           ; ... and restore fp state from it
+    mov     eax,0xffffffff                  ; ... and restore FPU state from it
+    mov     edx,eax
+    movzx   ecx,byte [fpu_save_mode]
+
+    cmp     ecx,FPU_SAVE_XSAVES
+    je      .restore_xrstors
+    cmp     ecx,FPU_SAVE_FXSAVE
+    je      .restore_fxrstor
 
-    pop     rdi                             ; Pop all GP registers
+    xrstor64 [rdi]                          ; XSAVE and XSAVEOPT areas are the same format
+    jmp     .restore_regs
+
+.restore_xrstors:
+    xrstors64 [rdi]
+    jmp     .restore_regs
+
+.restore_fxrstor:
+    fxrstor64 [rdi]
+
+.restore_regs:
+    pop     rdi                             ; Pop callee-saved registers
     pop     rsi
     pop     r15
     pop     r14
     pop     r13
     pop     r12
-    pop     r11
-    pop     r10
-    pop     r9
-    pop     r8
     pop     rbp
-    pop     rdx
-    pop     rcx
     pop     rbx
-    pop     rax
 
     ret
-
-    section .bss
-temp_rsi    resq  1
\ No newline at end of file
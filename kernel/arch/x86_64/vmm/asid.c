@@ -0,0 +1,85 @@
+/*
+ * stage3 - x86_64 address space IDs (PCIDs)
+ * anos - An Operating System
+ *
+ * Copyright (c) 2025 Ross Bamford
+ *
+ * PCIDs go in the low 12 bits of CR3, and loading CR3 only flushes
+ * the PCID being loaded - and not even that, if bit 63 is set. Global
+ * pages (CR4.PGE) survive either way, so the kernel half stays put
+ * whatever we switch to.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "x86_64/cpuid.h"
+
+#define CR4_PGE ((1ULL << 7))
+#define CR4_PCIDE ((1ULL << 17))
+#define CR3_NOFLUSH ((1ULL << 63))
+#define CR3_PCID_MASK ((0xfffULL))
+
+#define CPUID_1_ECX_PCID ((1 << 17))
+#define CPUID_7_EBX_INVPCID ((1 << 10))
+
+#define INVPCID_ADDRESS ((0))
+
+static bool has_invpcid;
+
+static inline uint64_t read_cr4(void) {
+    uint64_t cr4;
+    __asm__ volatile("mov %%cr4, %0" : "=r"(cr4));
+    return cr4;
+}
+
+static inline void write_cr4(const uint64_t cr4) { __asm__ volatile("mov %0, %%cr4" : : "r"(cr4) : "memory"); }
+
+uint16_t arch_asid_init_this_cpu(const bool want_asids) {
+    uint32_t eax, ebx, ecx, edx;
+    uint64_t cr4 = read_cr4() | CR4_PGE;
+
+    write_cr4(cr4);
+
+    if (!want_asids || !cpuid(1, &eax, &ebx, &ecx, &edx) || !(ecx & CPUID_1_ECX_PCID)) {
+        return 0;
+    }
+
+    has_invpcid = cpuid(7, &eax, &ebx, &ecx, &edx) && (ebx & CPUID_7_EBX_INVPCID);
+
+    // PCIDE can only be set while we're on PCID 0
+    uint64_t cr3;
+    __asm__ volatile("mov %%cr3, %0" : "=r"(cr3));
+    __asm__ volatile("mov %0, %%cr3" : : "r"(cr3 & ~CR3_PCID_MASK) : "memory");
+
+    write_cr4(cr4 | CR4_PCIDE);
+
+    return CR3_PCID_MASK;
+}
+
+void arch_asid_switch(const uintptr_t pagetable_root, const uint16_t asid, const bool flush) {
+    const uint64_t cr3 = pagetable_root | asid | (flush ? 0 : CR3_NOFLUSH);
+    __asm__ volatile("mov %0, %%cr3" : : "r"(cr3) : "memory");
+}
+
+bool arch_asid_invalidate_page(const uint16_t asid, const uintptr_t virt_addr) {
+    if (!has_invpcid) {
+        return false;
+    }
+
+    const struct {
+        uint64_t pcid;
+        uint64_t addr;
+    } descriptor = {asid, virt_addr};
+
+    __asm__ volatile("invpcid %0, %1" : : "m"(descriptor), "r"((uint64_t)INVPCID_ADDRESS) : "memory");
+    return true;
+}
+
+// Toggling PGE drops everything - global pages and every PCID
+void arch_asid_flush_all(void) {
+    const uint64_t cr4 = read_cr4();
+
+    write_cr4(cr4 & ~CR4_PGE);
+    write_cr4(cr4);
+}
@@ -6,10 +6,14 @@
  */
 
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 
+#include "machine.h"
 #include "pmm/pagealloc.h"
 #include "std/string.h"
+#include "vmm/asid.h"
+#include "vmm/shootdown.h"
 #include "vmm/vmmapper.h"
 #include "x86_64/kdrivers/cpu.h"
 
@@ -66,11 +70,51 @@
 #endif
 
 extern MemoryRegion *physical_region;
-static SpinLock vmm_map_lock;
+// Locks for user address spaces, chosen by root table - so unrelated
+// processes (almost always) don't contend, but there's nothing to set
+// up or tear down along with an address space.
+#define USER_TABLE_LOCK_SHIFT ((5))
+#define USER_TABLE_LOCK_COUNT ((1 << USER_TABLE_LOCK_SHIFT))
 
-// TODO locking in here is very coarse-grained - it could be done based
-//      on the top-level table instead, for example...
-//
+static SpinLock user_table_locks[USER_TABLE_LOCK_COUNT];
+
+// Kernel space tables below the root are shared by every address space
+static SpinLock kernel_table_lock;
+
+/*
+ * Find the lock that covers the tables for the given address in the
+ * given address space. Ranges never cross from user to kernel space,
+ * so one address is enough to decide for a whole range.
+ */
+static inline SpinLock *table_lock_for(const uint64_t *pml4, const uintptr_t virt_addr) {
+    if (virt_addr >= VM_KERNEL_SPACE_START) {
+        return &kernel_table_lock;
+    }
+
+    const uint64_t hash = ((uintptr_t)pml4 >> VM_PAGE_LINEAR_SHIFT) * 0x9e3779b97f4a7c15ULL;
+    return &user_table_locks[hash >> (64 - USER_TABLE_LOCK_SHIFT)];
+}
+
+/*
+ * Let go of tables locked with spinlock_lock_irqsave. Kernel pages that
+ * changed are global, so they get shot down on every other CPU - after
+ * the lock's gone (so nobody's spinning on it while we wait for them)
+ * but before interrupts are back on.
+ */
+static inline void unlock_tables(SpinLock *lock, const uint64_t lock_flags) {
+    uintptr_t virt_addr;
+    size_t num_pages;
+
+    const bool shootdown = lock == &kernel_table_lock && asid_take_kernel_pages(&virt_addr, &num_pages);
+
+    spinlock_unlock(lock);
+
+    if (shootdown) {
+        vmm_shootdown_kernel_pages(virt_addr, num_pages);
+    }
+
+    restore_saved_interrupts(lock_flags);
+}
 
 /*
  * Returns true if the given entry is a large-sized leaf, i.e.
@@ -78,6 +122,62 @@ static SpinLock vmm_map_lock;
  */
 STATIC_EXCEPT_TESTS bool is_pagesize_leaf(const uint64_t table_entry) { return table_entry & (PG_PAGESIZE); }
 
+/*
+ * Convert page flags (as passed to the map functions) to those for a large
+ * leaf - PAGESIZE goes where the PAT bit is for a PTE, so that moves.
+ */
+static inline uint64_t page_flags_to_large_flags(const uint64_t flags) {
+    return (flags & ~PG_PAT_PTE) | PG_PAGESIZE | (flags & PG_PAT_PTE ? PG_PAT_LARGE : 0);
+}
+
+/*
+ * Get the 4KiB PTE equivalent to the page within the large leaf (at the
+ * given level) that contains the given virtual address.
+ */
+static inline uint64_t large_leaf_to_pte(const uint64_t entry, const uintptr_t virt_addr, const PagetableLevel level) {
+    const uintptr_t base = vmm_table_entry_to_phys(entry) & ~PG_PAT_LARGE;
+    const uintptr_t offset = virt_addr & (vmm_level_page_size(level) - 1) & PAGE_ALIGN_MASK;
+    const uint64_t flags = entry & (PAGE_FLAGS_MASK | PG_NOEXEC) & ~PG_PAGESIZE;
+
+    return (base + offset) | flags | (entry & PG_PAT_LARGE ? PG_PAT_PTE : 0);
+}
+
+/*
+ * Replace the large leaf at the given index in the table (at the given
+ * level) with a new table of leaves one level down, covering the same
+ * memory with the same flags, so part of it can be changed.
+ *
+ * Must be called with tables locked (see table_lock_for)!
+ */
+static bool split_large_leaf(uint64_t *table, const uint16_t index, const uintptr_t virt_addr,
+                             const PagetableLevel level) {
+    const uintptr_t new_table = page_alloc(physical_region);
+
+    if (new_table & 0xfff) {
+        return false;
+    }
+
+    uint64_t *new_ptr = vmm_phys_to_virt_ptr(new_table);
+    const uint64_t leaf = table[index];
+    const size_t child_size = vmm_level_page_size(level - 1);
+
+    for (int i = 0; i < PAGE_TABLE_ENTRIES; i++) {
+        if (level - 1 == PT_LEVEL_PT) {
+            new_ptr[i] = large_leaf_to_pte(leaf, i * child_size, level);
+        } else {
+            new_ptr[i] = leaf + i * child_size;
+        }
+    }
+
+    table[index] = vmm_phys_and_flags_to_table_entry(new_table, PG_PRESENT | (leaf & (PG_WRITE | PG_USER)));
+
+    // Nothing translates differently yet, but don't leave the old large
+    // entry in the TLB alongside the new small ones...
+    vmm_invalidate_page(virt_addr);
+
+    return true;
+}
+
 /*
  * Ensure tables are mapped to the specified level.
  *
@@ -91,7 +191,10 @@ STATIC_EXCEPT_TESTS bool is_pagesize_leaf(const uint64_t table_entry) { return t
  * Returns a virtual pointer to the table of the specified
  * level, which may be newly created.
  *
- * Must be called with VMM locked!
+ * If a large page is in the way, it's split so the new
+ * table only replaces the part of it being mapped over.
+ *
+ * Must be called with tables locked (see table_lock_for)!
  */
 STATIC_EXCEPT_TESTS uint64_t *ensure_tables(const uint64_t *root_table, const uintptr_t virt_addr,
                                             const PagetableLevel to_level, const uint16_t flags) {
@@ -104,11 +207,18 @@ STATIC_EXCEPT_TESTS uint64_t *ensure_tables(const uint64_t *root_table, const ui
     uint64_t *current_table = (uint64_t *)root_table;
 
     while (levels_remain) {
-        const uint16_t current_index = vmm_virt_to_table_index(virt_addr, levels_remain + 1);
-        const uint64_t current_entry = current_table[current_index];
+        const uint8_t current_level = to_level + levels_remain;
+        const uint16_t current_index = vmm_virt_to_table_index(virt_addr, current_level);
+        uint64_t current_entry = current_table[current_index];
 
         if ((current_entry & PG_PRESENT) == 0) {
-            const uintptr_t new_table = page_alloc(physical_region);
+            // Take one that's already zeroed if we can
+            uintptr_t new_table = page_alloc_zeroed(physical_region);
+            const bool zeroed = (new_table & 0xfff) == 0;
+
+            if (!zeroed) {
+                new_table = page_alloc(physical_region);
+            }
 
             if (new_table & 0xfff) {
                 // TODO unmap what we mapped so far? Is it worth it?
@@ -117,17 +227,21 @@ STATIC_EXCEPT_TESTS uint64_t *ensure_tables(const uint64_t *root_table, const ui
 
             uint64_t *new_ptr = vmm_phys_to_virt_ptr(new_table);
 
-            memclr(new_ptr, VM_PAGE_SIZE);
+            if (!zeroed) {
+                memclr_page(new_ptr);
+            }
 
             current_table[current_index] = vmm_phys_and_flags_to_table_entry(
                     new_table, PG_PRESENT | (flags & PG_WRITE ? PG_WRITE : 0) | (flags & PG_USER ? PG_USER : 0));
 
             current_table = new_ptr;
         } else {
-            // special case - if this is a leaf, but we wanted a lower level,
-            // we'll just fail...
-            if (levels_remain > 1 && is_pagesize_leaf(current_entry)) {
-                return nullptr;
+            if (is_pagesize_leaf(current_entry)) {
+                if (!split_large_leaf(current_table, current_index, virt_addr, current_level)) {
+                    return nullptr;
+                }
+
+                current_entry = current_table[current_index];
             }
 
             // x86_64 requires writeable leaf pages have write set on
@@ -146,8 +260,15 @@ STATIC_EXCEPT_TESTS uint64_t *ensure_tables(const uint64_t *root_table, const ui
     return current_table;
 }
 
+// Kernel mappings are the same in every address space, so they can live through a switch
+static inline uint16_t global_flag(const uintptr_t virt_addr) {
+    return virt_addr >= VM_KERNEL_SPACE_START ? PG_GLOBAL : 0;
+}
+
 inline void vmm_invalidate_page(const uintptr_t virt_addr) { cpu_invalidate_tlb_addr(virt_addr); }
 
+inline void vmm_invalidate_all(void) { cpu_invalidate_tlb_all(); }
+
 static bool nolock_vmm_map_page_containing_in(uint64_t *pml4, const uintptr_t virt_addr, const uint64_t phys_addr,
                                               const uint16_t flags) {
     const uintptr_t aligned_virt_addr = virt_addr & PAGE_ALIGN_MASK;
@@ -158,18 +279,26 @@ static bool nolock_vmm_map_page_containing_in(uint64_t *pml4, const uintptr_t vi
         return false;
     }
 
-    pt[vmm_virt_to_pt_index(virt_addr)] = vmm_phys_and_flags_to_table_entry(phys_addr, flags);
+    const uint16_t index = vmm_virt_to_pt_index(virt_addr);
+    const uint64_t old_entry = pt[index];
+
+    pt[index] = vmm_phys_and_flags_to_table_entry(phys_addr, flags | global_flag(virt_addr));
 
     vmm_invalidate_page(virt_addr);
 
+    if (old_entry & PG_PRESENT) {
+        asid_invalidate_mapping(virt_addr);
+    }
+
     return true;
 }
 
 inline bool vmm_map_page_containing_in(uint64_t *pml4, uintptr_t virt_addr, const uint64_t phys_addr,
                                        const uint16_t flags) {
-    const uint64_t lock_flags = spinlock_lock_irqsave(&vmm_map_lock);
+    SpinLock *lock = table_lock_for(pml4, virt_addr);
+    const uint64_t lock_flags = spinlock_lock_irqsave(lock);
     const bool result = nolock_vmm_map_page_containing_in(pml4, virt_addr, phys_addr, flags);
-    spinlock_unlock_irqrestore(&vmm_map_lock, lock_flags);
+    unlock_tables(lock, lock_flags);
     return result;
 }
 
@@ -185,18 +314,136 @@ inline bool vmm_map_page(const uintptr_t virt_addr, const uint64_t page, const u
     return vmm_map_page_containing(virt_addr, page, flags);
 }
 
+static bool nolock_vmm_map_large_page_in(uint64_t *pml4, const uintptr_t virt_addr, const uint64_t phys_addr,
+                                         const uint16_t flags, const PagetableLevel level) {
+    if ((level != PT_LEVEL_PD && level != PT_LEVEL_PDPT) || ((virt_addr | phys_addr) & (vmm_level_page_size(level) - 1))) {
+        return false;
+    }
+
+    uint64_t *table = ensure_tables(pml4, virt_addr, level, flags);
+
+    if (!table) {
+        return false;
+    }
+
+    const uint16_t index = vmm_virt_to_table_index(virt_addr, level);
+
+    if ((table[index] & PG_PRESENT) && !is_pagesize_leaf(table[index])) {
+        // Already smaller pages here, leave them be
+        return false;
+    }
+
+    const uint64_t old_entry = table[index];
+    const uint64_t leaf_flags = page_flags_to_large_flags(flags | global_flag(virt_addr));
+
+    table[index] = vmm_phys_and_flags_to_table_entry(phys_addr, leaf_flags);
+
+    vmm_invalidate_page(virt_addr);
+
+    if (old_entry & PG_PRESENT) {
+        asid_invalidate_mapping(virt_addr);
+    }
+
+    return true;
+}
+
+bool vmm_map_large_page_in(uint64_t *pml4, const uintptr_t virt_addr, const uint64_t phys_addr, const uint16_t flags,
+                           const PagetableLevel level) {
+    SpinLock *lock = table_lock_for(pml4, virt_addr);
+    const uint64_t lock_flags = spinlock_lock_irqsave(lock);
+    const bool result = nolock_vmm_map_large_page_in(pml4, virt_addr, phys_addr, flags, level);
+    unlock_tables(lock, lock_flags);
+    return result;
+}
+
+bool vmm_can_map_large_page_in(const uint64_t *pml4, const uintptr_t virt_addr, const PagetableLevel level) {
+    const uint64_t *table = pml4;
+
+    for (int current = PT_LEVEL_PML4; current > level; current--) {
+        const uint64_t entry = table[vmm_virt_to_table_index(virt_addr, current)];
+
+        if ((entry & PG_PRESENT) == 0) {
+            return true;
+        }
+
+        if (is_pagesize_leaf(entry)) {
+            return false;
+        }
+
+        table = vmm_phys_to_virt_ptr(vmm_table_entry_to_phys(entry));
+    }
+
+    return (table[vmm_virt_to_table_index(virt_addr, level)] & PG_PRESENT) == 0;
+}
+
+size_t vmm_fill_pages_in(uint64_t *pml4, const uintptr_t virt_addr, uintptr_t *pages, const uint16_t flags,
+                         const size_t num_pages) {
+    const uintptr_t virt_base = virt_addr & PAGE_ALIGN_MASK;
+    size_t mapped = 0;
+
+    SpinLock *lock = table_lock_for(pml4, virt_addr);
+
+    const uint64_t lock_flags = spinlock_lock_irqsave(lock);
+    for (size_t i = 0; i < num_pages; i++) {
+        const uintptr_t virt = virt_base + (i << VM_PAGE_LINEAR_SHIFT);
+
+        if (!vmm_can_map_large_page_in(pml4, virt, PT_LEVEL_PT)) {
+            // Something's already here (maybe a large page) - leave it be
+            continue;
+        }
+
+        if (!nolock_vmm_map_page_containing_in(pml4, virt, pages[i], flags)) {
+            break;
+        }
+
+        pages[i] = 0;
+        mapped++;
+    }
+    unlock_tables(lock, lock_flags);
+
+    return mapped;
+}
+
+// Largest level we can map a leaf at for the given addresses and remaining size
+static inline PagetableLevel largest_leaf_level(const uintptr_t virt_addr, const uint64_t phys_addr,
+                                                const size_t num_pages) {
+    for (PagetableLevel level = PT_LEVEL_PDPT; level > PT_LEVEL_PT; level--) {
+        const size_t size = vmm_level_page_size(level);
+
+        if (((virt_addr | phys_addr) & (size - 1)) == 0 && num_pages >= size >> VM_PAGE_LINEAR_SHIFT) {
+            return level;
+        }
+    }
+
+    return PT_LEVEL_PT;
+}
+
 inline bool vmm_map_pages_containing_in(uint64_t *pml4, uintptr_t virt_addr, const uint64_t phys_addr,
                                         const uint16_t flags, const size_t num_pages) {
 
-    uint64_t lock_flags = spinlock_lock_irqsave(&vmm_map_lock);
-    for (int i = 0; i < num_pages; i++) {
-        if (!nolock_vmm_map_page_containing_in(pml4, virt_addr + (i << VM_PAGE_LINEAR_SHIFT),
-                                               phys_addr + (i << VM_PAGE_LINEAR_SHIFT), flags)) {
-            return false;
+    const uintptr_t virt_base = virt_addr & PAGE_ALIGN_MASK;
+    const uintptr_t phys_base = phys_addr & PAGE_ALIGN_MASK;
+    bool result = true;
+
+    SpinLock *lock = table_lock_for(pml4, virt_addr);
+
+    uint64_t lock_flags = spinlock_lock_irqsave(lock);
+    for (size_t i = 0; i < num_pages;) {
+        const uintptr_t virt = virt_base + (i << VM_PAGE_LINEAR_SHIFT);
+        const uintptr_t phys = phys_base + (i << VM_PAGE_LINEAR_SHIFT);
+        const PagetableLevel level = largest_leaf_level(virt, phys, num_pages - i);
+
+        if (level != PT_LEVEL_PT && nolock_vmm_map_large_page_in(pml4, virt, phys, flags, level)) {
+            i += vmm_level_page_size(level) >> VM_PAGE_LINEAR_SHIFT;
+        } else if (nolock_vmm_map_page_containing_in(pml4, virt, phys, flags)) {
+            i++;
+        } else {
+            result = false;
+            break;
         }
     }
-    spinlock_unlock_irqrestore(&vmm_map_lock, lock_flags);
-    return true;
+    unlock_tables(lock, lock_flags);
+    return result;
 }
 
 inline bool vmm_map_pages_containing(const uintptr_t virt_addr, const uint64_t phys_addr, const uint16_t flags,
@@ -214,70 +461,79 @@ bool vmm_map_pages(const uintptr_t virt_addr, const uint64_t page, const uint16_
     return vmm_map_pages_containing(virt_addr, page, flags, num_pages);
 }
 
-static uintptr_t nolock_vmm_unmap_page_in(uint64_t *pml4, const uintptr_t virt_addr) {
-    const uint16_t pml4_index = vmm_virt_to_pml4_index(virt_addr);
-    const uint64_t pml4e = pml4[pml4_index];
-
-    if (pml4e & PG_PRESENT) {
-        if (is_pagesize_leaf(pml4e)) {
-            // unmapping a terapage
-            pml4[pml4_index] = 0;
+/*
+ * Unmap the page at the given address. If it's in a large page that
+ * starts there and fits in max_pages, the whole large page goes - otherwise
+ * it's split first, so only the one page does.
+ *
+ * Sets `pages` to how many pages were dealt with (including ones that weren't
+ * mapped, if a whole table is missing).
+ *
+ * Returns the physical address that was mapped at virt_addr, or 0 for none.
+ *
+ * Must be called with tables locked (see table_lock_for)!
+ */
+static uintptr_t nolock_vmm_unmap_pages_step(uint64_t *pml4, const uintptr_t virt_addr, const size_t max_pages,
+                                             size_t *pages) {
+    uint64_t *table = pml4;
+
+    for (int level = PT_LEVEL_PML4; level >= PT_LEVEL_PT; level--) {
+        const uint16_t index = vmm_virt_to_table_index(virt_addr, level);
+        const uint64_t entry = table[index];
+        const size_t level_pages = vmm_level_page_size(level) >> VM_PAGE_LINEAR_SHIFT;
+        const size_t pages_to_end = level_pages - ((virt_addr >> VM_PAGE_LINEAR_SHIFT) & (level_pages - 1));
+
+        if ((entry & PG_PRESENT) == 0) {
+            // nothing mapped from here to the end of this entry
+            *pages = pages_to_end < max_pages ? pages_to_end : max_pages;
+            return 0;
+        }
 
+        if (level == PT_LEVEL_PT) {
+            // unmapping a page
+            table[index] = 0;
             vmm_invalidate_page(virt_addr);
+            asid_invalidate_mapping(virt_addr);
 
-            return vmm_table_entry_to_phys(pml4e);
+            *pages = 1;
+            return vmm_table_entry_to_phys(entry);
         }
 
-        uint64_t *pdpt = vmm_phys_to_virt_ptr(vmm_table_entry_to_phys(pml4e));
-        const uint16_t pdpt_index = vmm_virt_to_pdpt_index(virt_addr);
-        const uint64_t pdpte = pdpt[pdpt_index];
-
-        if (pdpte & PG_PRESENT) {
-            if (is_pagesize_leaf(pdpte)) {
-                // unmapping a gigapage
-                pdpt[pdpt_index] = 0;
-
+        if (is_pagesize_leaf(entry)) {
+            if (pages_to_end == level_pages && max_pages >= level_pages) {
+                // unmapping a whole large page
+                table[index] = 0;
                 vmm_invalidate_page(virt_addr);
+                asid_invalidate_mapping(virt_addr);
 
-                return vmm_table_entry_to_phys(pdpte);
+                *pages = level_pages;
+                return vmm_table_entry_to_phys(large_leaf_to_pte(entry, virt_addr, level));
             }
 
-            uint64_t *pd = vmm_phys_to_virt_ptr(vmm_table_entry_to_phys(pdpte));
-            const uint16_t pd_index = vmm_virt_to_pd_index(virt_addr);
-            const uint64_t pde = pd[pd_index];
-
-            if (pde & PG_PRESENT) {
-                if (is_pagesize_leaf(pde)) {
-                    // unmapping a megapage
-                    pd[pd_index] = 0;
-                    vmm_invalidate_page(virt_addr);
-
-                    return vmm_table_entry_to_phys(pde);
-                }
-
-                uint64_t *pt = vmm_phys_to_virt_ptr(vmm_table_entry_to_phys(pde));
-                const uint16_t pt_index = vmm_virt_to_pt_index(virt_addr);
-                const uint64_t pte = pt[pt_index];
-
-                if (pte & PG_PRESENT) {
-                    // unmapping a page
-                    pt[pt_index] = 0;
-
-                    vmm_invalidate_page(virt_addr);
-
-                    return vmm_table_entry_to_phys(pte);
-                }
+            // only part of it, so split and carry on down
+            if (!split_large_leaf(table, index, virt_addr, level)) {
+                *pages = 1;
+                return 0;
             }
         }
+
+        table = vmm_phys_to_virt_ptr(vmm_table_entry_to_phys(table[index]));
     }
 
+    *pages = 1;
     return 0;
 }
 
+static uintptr_t nolock_vmm_unmap_page_in(uint64_t *pml4, const uintptr_t virt_addr) {
+    size_t pages;
+    return nolock_vmm_unmap_pages_step(pml4, virt_addr, 1, &pages);
+}
+
 inline uintptr_t vmm_unmap_page_in(uint64_t *pml4, const uintptr_t virt_addr) {
-    const uint64_t lock_flags = spinlock_lock_irqsave(&vmm_map_lock);
+    SpinLock *lock = table_lock_for(pml4, virt_addr);
+    const uint64_t lock_flags = spinlock_lock_irqsave(lock);
     const uintptr_t result = nolock_vmm_unmap_page_in(pml4, virt_addr);
-    spinlock_unlock_irqrestore(&vmm_map_lock, lock_flags);
+    unlock_tables(lock, lock_flags);
     return result;
 }
 
@@ -286,14 +542,25 @@ inline uintptr_t vmm_unmap_page(const uintptr_t virt_addr) {
 }
 
 inline uintptr_t vmm_unmap_pages_in(uint64_t *pml4, const uintptr_t virt_addr, const size_t num_pages) {
-    const uint64_t lock_flags = spinlock_lock_irqsave(&vmm_map_lock);
-    const uintptr_t result = nolock_vmm_unmap_page_in(pml4, virt_addr);
+    uintptr_t result = 0;
+
+    SpinLock *lock = table_lock_for(pml4, virt_addr);
+
+    const uint64_t lock_flags = spinlock_lock_irqsave(lock);
 
-    for (int i = 1; i < num_pages; i++) {
-        nolock_vmm_unmap_page_in(pml4, virt_addr + (i << VM_PAGE_LINEAR_SHIFT));
+    for (size_t i = 0; i < num_pages;) {
+        size_t pages;
+        const uintptr_t phys =
+                nolock_vmm_unmap_pages_step(pml4, virt_addr + (i << VM_PAGE_LINEAR_SHIFT), num_pages - i, &pages);
+
+        if (i == 0) {
+            result = phys;
+        }
+
+        i += pages;
     }
 
-    spinlock_unlock_irqrestore(&vmm_map_lock, lock_flags);
+    unlock_tables(lock, lock_flags);
     return result;
 }
 
@@ -304,7 +571,7 @@ uintptr_t vmm_unmap_pages(const uintptr_t virt_addr, const size_t num_pages) {
 /*
  *  Find the per-CPU temporary page base for the given CPU.
  */
-inline uintptr_t vmm_per_cpu_temp_page_addr(const uint8_t cpu) { return PER_CPU_TEMP_PAGE_BASE + (cpu << 12); }
+inline uintptr_t vmm_per_cpu_temp_page_addr(const uint16_t cpu) { return PER_CPU_TEMP_PAGE_BASE + (cpu << 12); }
 
 // Convert physical address to direct-mapped virtual address
 inline uintptr_t vmm_phys_to_virt(const uintptr_t phys_addr) { return DIRECT_MAP_BASE + phys_addr; }
@@ -339,34 +606,37 @@ inline uint64_t vmm_phys_and_flags_to_table_entry(const uintptr_t phys, const ui
     return ((phys & ~0xfff)) | flags;
 }
 
-/*
- * Get the PT entry (including flags) for the given virtual address,
- * or 0 if not mapped in the _current process_ direct mapping.
- *
- * This **only** works for 4KiB pages - large pages will not work
- * with this (and that's by design!)
- */
-uint64_t vmm_virt_to_pt_entry(const uintptr_t virt_addr) {
-    const uint64_t pml4e = vmm_find_pml4()->entries[vmm_virt_to_pml4_index(virt_addr)];
-    if (pml4e & PG_PRESENT) {
-        const uint64_t pdpte = ((PageTable *)vmm_phys_to_virt(vmm_table_entry_to_phys(pml4e)))
-                                       ->entries[vmm_virt_to_pdpt_index(virt_addr)];
-        if (pdpte & PG_PRESENT) {
-            const uint64_t pde = ((PageTable *)vmm_phys_to_virt(vmm_table_entry_to_phys(pdpte)))
-                                         ->entries[vmm_virt_to_pd_index(virt_addr)];
-            if (pde & PG_PRESENT) {
-                const uint64_t pte = ((PageTable *)vmm_phys_to_virt(vmm_table_entry_to_phys(pde)))
-                                             ->entries[vmm_virt_to_pt_index(virt_addr)];
-                if (pte & PG_PRESENT) {
-                    return pte;
-                }
-            }
+uint64_t vmm_virt_to_pt_entry_and_level(const uintptr_t virt_addr, PagetableLevel *level) {
+    const uint64_t *table = vmm_find_pml4()->entries;
+
+    for (int current = PT_LEVEL_PML4; current >= PT_LEVEL_PT; current--) {
+        const uint64_t entry = table[vmm_virt_to_table_index(virt_addr, current)];
+
+        if ((entry & PG_PRESENT) == 0) {
+            return 0;
+        }
+
+        if (current == PT_LEVEL_PT) {
+            *level = PT_LEVEL_PT;
+            return entry;
+        }
+
+        if (is_pagesize_leaf(entry)) {
+            *level = current;
+            return large_leaf_to_pte(entry, virt_addr, current);
         }
+
+        table = vmm_phys_to_virt_ptr(vmm_table_entry_to_phys(entry));
     }
 
     return 0;
 }
 
+uint64_t vmm_virt_to_pt_entry(const uintptr_t virt_addr) {
+    PagetableLevel level;
+    return vmm_virt_to_pt_entry_and_level(virt_addr, &level);
+}
+
 size_t vmm_level_page_size(const uint8_t level) { return (VM_PAGE_SIZE << (9 * (level - 1))); }
 
 uintptr_t vmm_get_pagetable_root_phys() { return cpu_read_cr3(); }
@@ -135,7 +135,7 @@ static uint64_t *ensure_direct_table_map(uint64_t *table, const uint16_t table_i
 }
 
 static void vmm_init_map_gigapage(uint64_t *pml4, uint64_t *temp_mapping_pt, const uintptr_t base,
-                                  const uint8_t flags) {
+                                  const uint16_t flags) {
     vdebugf("vmm_init_map_gigapage: Mapping phys 0x%016lx with length %ld into "
             "PML4 @ 0x%016lx\n",
             base, GIGA_PAGE_SIZE, (uintptr_t)pml4);
@@ -171,7 +171,7 @@ static void vmm_init_map_gigapage(uint64_t *pml4, uint64_t *temp_mapping_pt, con
 }
 
 static void vmm_init_map_megapage(uint64_t *pml4, uint64_t *temp_mapping_pt, const uintptr_t base,
-                                  const uint8_t flags) {
+                                  const uint16_t flags) {
     vdebugf("vmm_init_map_megapage: Mapping phys 0x%016lx with length %ld into "
             "PML4 @ 0x%016lx\n",
             base, MEGA_PAGE_SIZE, (uintptr_t)pml4);
@@ -211,7 +211,7 @@ static void vmm_init_map_megapage(uint64_t *pml4, uint64_t *temp_mapping_pt, con
     vdebugf("vmm_init_map_megapage: Region mapped successfully\n");
 }
 
-static void vmm_init_map_page(uint64_t *pml4, uint64_t *temp_mapping_pt, const uintptr_t base, const uint8_t flags) {
+static void vmm_init_map_page(uint64_t *pml4, uint64_t *temp_mapping_pt, const uintptr_t base, const uint16_t flags) {
     vdebugf("vmm_init_map_page: Mapping phys 0x%016lx with length %ld into "
             "PML4 @ 0x%016lx\n",
             base, PAGE_SIZE, (uintptr_t)pml4);
@@ -261,7 +261,7 @@ static void vmm_init_map_region(uint64_t *pml4, uint64_t *temp_mapping_pt, Limin
     vdebugf("vmm_init_map_region: Mapping phys 0x%016lx with length %ld into "
             "PML4 @ 0x%016lx\n",
             entry->base, entry->length, (uintptr_t)pml4);
-    const uint8_t flags = PG_PRESENT | PG_GLOBAL | PG_READ | (writeable ? PG_WRITE : 0);
+    const uint16_t flags = PG_PRESENT | PG_GLOBAL | PG_READ | (writeable ? PG_WRITE : 0);
     uintptr_t base = entry->base;
     uintptr_t length = entry->length;
 
@@ -16,6 +16,7 @@
 #include "fba/alloc.h"
 #include "ipc/channel.h"
 #include "ipc/named.h"
+#include "ipc/ring.h"
 #include "klog.h"
 #include "pagefault.h"
 #include "panic.h"
@@ -27,7 +28,6 @@
 #include "sleep.h"
 #include "smp/ipwi.h"
 #include "std/string.h"
-#include "structs/ref_count_map.h"
 #include "system.h"
 #include "vmm/vmmapper.h"
 
@@ -38,6 +38,7 @@
 /* Globals */
 MemoryRegion *physical_region;
 uintptr_t kernel_zero_page;
+uintptr_t kernel_zero_large_page;
 
 static bool zeropage_init() {
     // If you're a retrocomputing fan, zeropage doesn't mean what
@@ -61,6 +62,31 @@ static bool zeropage_init() {
     return true;
 }
 
+#ifndef NO_LARGE_PAGES
+// Same again, but a large page of them. Lazily-allocated memory maps this
+// until it's written, where it can. It's fine if we don't get one (it needs
+// to be aligned), we'll just use small pages everywhere instead.
+static void zero_large_page_init() {
+    const uint64_t count = MEGA_PAGE_SIZE >> VM_PAGE_LINEAR_SHIFT;
+    const uintptr_t page = page_alloc_m(physical_region, count);
+
+    if (page & 0xff) {
+        return;
+    }
+
+    if (page & (MEGA_PAGE_SIZE - 1)) {
+        for (uint64_t i = 0; i < count; i++) {
+            page_free(physical_region, page + (i << VM_PAGE_LINEAR_SHIFT));
+        }
+
+        return;
+    }
+
+    memclr(vmm_phys_to_virt_ptr(page), MEGA_PAGE_SIZE);
+    kernel_zero_large_page = page;
+}
+#endif
+
 // Common entrypoint once bootloader-specific stuff is handled
 noreturn void bsp_kernel_entrypoint(const uintptr_t platform_data) {
     if (!fba_init((uint64_t *)vmm_find_pml4(), KERNEL_FBA_BEGIN, KERNEL_FBA_SIZE_BLOCKS)) {
@@ -77,14 +103,14 @@ noreturn void bsp_kernel_entrypoint(const uintptr_t platform_data) {
         // This is not fatal since debugchar_np will still work
     }
 
-    if (!refcount_map_init()) {
-        panic("Refcount map init failed");
-    }
-
     if (!zeropage_init()) {
         panic("Zeropage init failed");
     }
 
+#ifndef NO_LARGE_PAGES
+    zero_large_page_init();
+#endif
+
     if (!platform_init(platform_data)) {
         panic("Platform init failed");
     }
@@ -111,6 +137,7 @@ noreturn void bsp_kernel_entrypoint(const uintptr_t platform_data) {
 
     ipc_channel_init();
     named_channel_init();
+    ipc_ring_init();
 
     if (!address_space_init()) {
         panic("Address space initialisation failed");
@@ -124,6 +151,8 @@ noreturn void bsp_kernel_entrypoint(const uintptr_t platform_data) {
     // that IPWI etc can be used.
     panic_notify_smp_started();
     pagefault_notify_smp_started();
+    page_alloc_notify_smp_started(physical_region);
+    slab_notify_smp_started();
 
     // And finally, start the system!
     prepare_system();
@@ -32,11 +32,35 @@ static uint64_t _fba_bitmap_size_bits;
 static uint64_t *_fba_bitmap, *_fba_bitmap_end;
 static SpinLock fba_lock;
 
+// Summary levels over the bitmap, one set per order - a set bit means "there's
+// at least one free run of 2^order blocks, aligned to its size, down there",
+// so quads (and whole runs of them) without one can be skipped unread.
+//
+//   _fba_summary      - one bit per bitmap quad (64 blocks)
+//   _fba_summary_top  - one bit per summary quad (4096 blocks)
+//
+// Two levels cover the whole 1GiB FBA space, the top level is a single quad.
+//
+#define FBA_MAX_BITMAP_QUADS ((KERNEL_FBA_SIZE_BLOCKS >> 6))
+#define FBA_SUMMARY_QUADS ((FBA_MAX_BITMAP_QUADS >> 6))
+#define FBA_SUMMARY_ORDERS ((7)) // 1 - 64 blocks
+
+static uint64_t _fba_summary[FBA_SUMMARY_ORDERS][FBA_SUMMARY_QUADS];
+static uint64_t _fba_summary_top[FBA_SUMMARY_ORDERS];
+
+// Bits that can start a size-aligned run of each order
+static const uint64_t chunk_starts[FBA_SUMMARY_ORDERS] = {
+        0xffffffffffffffff, 0x5555555555555555, 0x1111111111111111, 0x0101010101010101,
+        0x0001000100010001, 0x0000000100000001, 0x0000000000000001,
+};
+
 #ifdef UNIT_TESTS
 uintptr_t test_fba_check_begin() { return _fba_begin; }
 uint64_t test_fba_check_size() { return _fba_size_blocks; }
 uint64_t *test_fba_bitmap() { return _fba_bitmap; }
 uint64_t *test_fba_bitmap_end() { return _fba_bitmap_end; }
+uint64_t *test_fba_summary(uint8_t order) { return _fba_summary[order]; }
+uint64_t test_fba_summary_top(uint8_t order) { return _fba_summary_top[order]; }
 
 #ifdef DEBUG_UNIT_TESTS
 #include <stdio.h>
@@ -47,6 +71,95 @@ uint64_t *test_fba_bitmap_end() { return _fba_bitmap_end; }
 
 extern MemoryRegion *physical_region;
 
+static inline uint8_t first_set_bit_64(uint64_t nonzero_uint64) {
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+    // GCC & Clang have a nice intrinsic for this, as long as value is never
+    // zero...
+    return __builtin_ctzll(nonzero_uint64);
+#else
+    // Otherwise, fallback to De Bruijn sequence...
+    static const int DeBruijnTable[64] = {0,  1,  48, 2,  57, 49, 28, 3,  61, 58, 50, 42, 38, 29, 17, 4,
+                                          62, 55, 59, 36, 53, 51, 43, 22, 45, 39, 33, 30, 24, 18, 12, 5,
+                                          63, 47, 56, 27, 60, 41, 37, 16, 54, 35, 52, 21, 44, 32, 23, 11,
+                                          46, 26, 40, 15, 34, 20, 31, 10, 25, 14, 19, 9,  13, 8,  7,  6};
+
+    // Isolate least significant set bit and multiply by De Bruijn constant
+    return DeBruijnTable[((nonzero_uint64 & -nonzero_uint64) * ((uint64_t)(0x03f79d71b4cb0a89))) >> 58];
+#endif
+}
+
+// Bit n set where blocks n .. n + 2^order - 1 of the quad are all free, n aligned
+static inline uint64_t free_chunks(const uint64_t quad_bits, const uint8_t order) {
+    uint64_t free = ~quad_bits;
+
+    for (int i = 0; i < order; i++) {
+        free &= free >> (1 << i);
+    }
+
+    return free & chunk_starts[order];
+}
+
+// Keep the summaries in step with bitmap quad `quad`. Lock must be held.
+static inline void summary_update(const uint64_t quad) {
+    const uint64_t summary_quad = quad >> 6;
+    uint64_t free = ~_fba_bitmap[quad];
+
+    for (int order = 0; order < FBA_SUMMARY_ORDERS; order++) {
+        if (order) {
+            // Same as free_chunks, a step at a time
+            free &= free >> (1 << (order - 1));
+        }
+
+        if (free & chunk_starts[order]) {
+            bitmap_set(_fba_summary[order], quad);
+            bitmap_set(&_fba_summary_top[order], summary_quad);
+        } else {
+            bitmap_clear(_fba_summary[order], quad);
+
+            if (_fba_summary[order][summary_quad] == 0) {
+                bitmap_clear(&_fba_summary_top[order], summary_quad);
+            }
+        }
+    }
+}
+
+// Same, for all quads holding blocks first_bit .. first_bit + count - 1
+static inline void summary_update_range(const uint64_t first_bit, const uint64_t count) {
+    for (uint64_t quad = first_bit >> 6; quad <= (first_bit + count - 1) >> 6; quad++) {
+        summary_update(quad);
+    }
+}
+
+// First bitmap quad at or after `from` with a free, aligned run of 2^order
+// blocks in it, or the bitmap size in quads if there isn't one. Lock must be held.
+static inline uint64_t summary_next_free(const uint8_t order, const uint64_t from) {
+    const uint64_t *summary = _fba_summary[order];
+    uint64_t summary_quad = from >> 6;
+
+    if (summary_quad >= FBA_SUMMARY_QUADS) {
+        return _fba_bitmap_size_quads;
+    }
+
+    const uint64_t here = summary[summary_quad] & (0xffffffffffffffff << (from & 0x3f));
+
+    if (here) {
+        return (summary_quad << 6) + first_set_bit_64(here);
+    }
+
+    if (summary_quad == FBA_SUMMARY_QUADS - 1) {
+        return _fba_bitmap_size_quads;
+    }
+
+    const uint64_t later = _fba_summary_top[order] & (0xffffffffffffffff << (summary_quad + 1));
+
+    if (!later) {
+        return _fba_bitmap_size_quads;
+    }
+
+    summary_quad = first_set_bit_64(later);
+    return (summary_quad << 6) + first_set_bit_64(summary[summary_quad]);
+}
+
 bool fba_init(uint64_t *pml4, const uintptr_t fba_begin, const uint64_t fba_size_blocks) {
     if ((fba_begin & 0xfff) != 0) { // begin must be page aligned
         return false;
@@ -62,6 +175,11 @@ bool fba_init(uint64_t *pml4, const uintptr_t fba_begin, const uint64_t fba_size
         return true;
     }
 
+    if (fba_size_blocks > KERNEL_FBA_SIZE_BLOCKS) {
+        // summary only covers this much
+        return false;
+    }
+
     const uint64_t bitmap_page_count = fba_size_blocks >> 15;
     const uint64_t bitmap_page_end = fba_begin + (bitmap_page_count << 12);
 
@@ -102,6 +220,18 @@ bool fba_init(uint64_t *pml4, const uintptr_t fba_begin, const uint64_t fba_size
     _fba_bitmap = (uint64_t *)_fba_begin;
     _fba_bitmap_end = _fba_bitmap + (bitmap_page_count << 9);
 
+    for (int order = 0; order < FBA_SUMMARY_ORDERS; order++) {
+        for (int i = 0; i < FBA_SUMMARY_QUADS; i++) {
+            _fba_summary[order][i] = 0;
+        }
+
+        _fba_summary_top[order] = 0;
+    }
+
+    for (uint64_t quad = 0; quad < _fba_bitmap_size_quads; quad++) {
+        summary_update(quad);
+    }
+
     _pml4 = pml4;
 
     return true;
@@ -120,114 +250,83 @@ static inline void *do_alloc(const uintptr_t block_address) {
     return (void *)block_address;
 }
 
-// This is kinda messy, but should be _reasonably_ performant.
-// TODO Now SIMD etc is supported it could probably be optimised much more...
+// First-fit search for `n` free blocks starting on a multiple of
+// align_page_count, which must be a power of 2 and <= 64.
 //
-// align_page_count must be a power of 2 and <= 64
+// Full quads are skipped via the summary whenever we're not partway
+// through a run, and runs of free bits within a quad are measured with
+// ctz rather than bit-by-bit. Lock must be held.
 //
 static inline uint64_t find_unset_run(const uint64_t *bitmap, const uint64_t num_quads, const uint8_t align_page_count,
                                       const uint64_t n) {
     if (n == 0 || num_quads == 0)
         return 0;
 
-    // Create alignment mask (align_page_count is power of 2)
-    const uint64_t align_mask = align_page_count - 1;
+    if (n == align_page_count) {
+        // Exactly one size-aligned run (e.g. a slab), the summary for that order has it
+        const uint8_t order = first_set_bit_64(n);
+        const uint64_t quad = summary_next_free(order, 0);
+
+        if (quad >= num_quads) {
+            return num_quads << 6;
+        }
+
+        return (quad << 6) + first_set_bit_64(free_chunks(bitmap[quad], order));
+    }
+
+    // Bits that are allowed to start a run
+    uint64_t align_starts = 0;
+    for (int i = 0; i < 64; i += align_page_count) {
+        align_starts |= (1ULL << i);
+    }
 
     uint64_t consec_zeroes = 0;
     uint64_t start_bit = 0;
 
-    // Handle special case where n <= 64 more efficiently
-    if (n <= 64) {
-        for (uint64_t word_idx = 0; word_idx < num_quads; word_idx++) {
-            const uint64_t word = bitmap[word_idx];
-            if (word == 0) {
-                // Whole word is zero
-                if (consec_zeroes == 0) {
-                    // Check alignment of potential start
-                    const uint64_t current_bit = word_idx * 64;
-                    const uint64_t aligned_start = (current_bit + align_mask) & ~align_mask;
-                    if (aligned_start != current_bit) {
-                        // Skip to next aligned position
-                        consec_zeroes = 0;
-                        continue;
-                    }
-                    start_bit = current_bit;
-                }
-                consec_zeroes += 64;
-                if (consec_zeroes >= n) {
-                    return start_bit;
-                }
-            } else if (word == (uint64_t)(0xffffffffffffffff)) {
-                consec_zeroes = 0;
-            } else {
-                // Mixed word - check each bit
-                for (int bit_idx = 0; bit_idx < 64; bit_idx++) {
-                    const uint64_t current_bit = word_idx * 64 + bit_idx;
-                    if (!(word & ((uint64_t)(1) << bit_idx))) {
-                        if (consec_zeroes == 0) {
-                            // Check alignment
-                            const uint64_t aligned_start = (current_bit + align_mask) & ~align_mask;
-                            if (aligned_start != current_bit) {
-                                // Skip to next aligned position
-                                continue;
-                            }
-                            start_bit = current_bit;
-                        }
-                        consec_zeroes++;
-                        if (consec_zeroes == n) {
-                            return start_bit;
-                        }
-                    } else {
-                        consec_zeroes = 0;
-                    }
-                }
+    for (uint64_t word_idx = 0; word_idx < num_quads; word_idx++) {
+        if (consec_zeroes == 0) {
+            word_idx = summary_next_free(0, word_idx);
+
+            if (word_idx >= num_quads) {
+                break;
             }
         }
-        return num_quads << 6;
-    }
 
-    // For n > 64
-    for (uint64_t word_idx = 0; word_idx < num_quads; word_idx++) {
         const uint64_t word = bitmap[word_idx];
-        if (word == 0) {
+        uint64_t bit_idx = 0;
+
+        while (bit_idx < 64) {
             if (consec_zeroes == 0) {
-                // Check alignment of potential start
-                const uint64_t current_bit = word_idx * 64;
-                const uint64_t aligned_start = (current_bit + align_mask) & ~align_mask;
-                if (aligned_start != current_bit) {
-                    // Skip to next aligned position
-                    continue;
+                const uint64_t candidates = ~word & align_starts & (0xffffffffffffffff << bit_idx);
+
+                if (!candidates) {
+                    break;
                 }
-                start_bit = current_bit;
+
+                bit_idx = first_set_bit_64(candidates);
+                start_bit = (word_idx << 6) + bit_idx;
             }
-            consec_zeroes += 64;
+
+            const uint64_t rest = word >> bit_idx;
+            const uint64_t run = rest ? first_set_bit_64(rest) : 64 - bit_idx;
+
+            consec_zeroes += run;
+
             if (consec_zeroes >= n) {
                 return start_bit;
             }
-        } else if (word == (uint64_t)(0xffffffffffffffff)) {
-            consec_zeroes = 0;
-        } else {
-            for (int bit_idx = 0; bit_idx < 64; bit_idx++) {
-                const uint64_t current_bit = word_idx * 64 + bit_idx;
-                if (!(word & ((uint64_t)(1) << bit_idx))) {
-                    if (consec_zeroes == 0) {
-                        // Check alignment
-                        const uint64_t aligned_start = (current_bit + align_mask) & ~align_mask;
-                        if (aligned_start != current_bit) {
-                            continue;
-                        }
-                        start_bit = current_bit;
-                    }
-                    consec_zeroes++;
-                    if (consec_zeroes == n) {
-                        return start_bit;
-                    }
-                } else {
-                    consec_zeroes = 0;
-                }
+
+            if (bit_idx + run < 64) {
+                // Hit a used block, start again after it
+                consec_zeroes = 0;
+                bit_idx += run;
+            } else {
+                // Free to the end, carry on into the next quad
+                break;
             }
         }
     }
+
     return num_quads << 6;
 }
 
@@ -265,6 +364,8 @@ void *fba_alloc_blocks_aligned(uint32_t count, const uint8_t page_align) {
         const uintptr_t block_address = first_block_address + (i * VM_PAGE_SIZE);
 
         if (!do_alloc(block_address)) {
+            summary_update_range(bit, i + 1);
+
             // TODO we leak memory here if one fails - we should free whatever
             // we've allocated in that case...
 #ifdef UNIT_TESTS
@@ -281,50 +382,34 @@ void *fba_alloc_blocks_aligned(uint32_t count, const uint8_t page_align) {
         }
     }
 
+    summary_update_range(bit, count);
+
     spinlock_unlock_irqrestore(&fba_lock, lock_flags);
     return (void *)first_block_address;
 }
 
-static inline uint8_t first_set_bit_64(uint64_t nonzero_uint64) {
-#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
-    // GCC & Clang have a nice intrinsic for this, as long as value is never
-    // zero...
-    return __builtin_ctzll(nonzero_uint64);
-#else
-    // Otherwise, fallback to De Bruijn sequence...
-    static const int DeBruijnTable[64] = {0,  1,  48, 2,  57, 49, 28, 3,  61, 58, 50, 42, 38, 29, 17, 4,
-                                          62, 55, 59, 36, 53, 51, 43, 22, 45, 39, 33, 30, 24, 18, 12, 5,
-                                          63, 47, 56, 27, 60, 41, 37, 16, 54, 35, 52, 21, 44, 32, 23, 11,
-                                          46, 26, 40, 15, 34, 20, 31, 10, 25, 14, 19, 9,  13, 8,  7,  6};
-
-    // Isolate least significant set bit and multiply by De Bruijn constant
-    return DeBruijnTable[((nonzero_uint64 & -nonzero_uint64) * ((uint64_t)(0x03f79d71b4cb0a89))) >> 58];
-#endif
-}
-
 void *fba_alloc_block() {
     tprintf("bmp     = %p\n", _fba_bitmap);
     tprintf("bmp_end = %p\n", _fba_bitmap_end);
 
     const uint64_t lock_flags = spinlock_lock_irqsave(&fba_lock);
 
-    uint64_t *bmp;
-    for (bmp = _fba_bitmap; bmp < _fba_bitmap_end; bmp++) {
-        if (*bmp != 0xffffffffffffffff) {
-            tprintf("Block %p has space [0x%016lx]!\n", bmp, *bmp);
-            break;
-        }
-    }
+    const uint64_t quad = summary_next_free(0, 0);
 
-    if (bmp == _fba_bitmap_end) {
+    if (quad >= _fba_bitmap_size_quads) {
         tprintf("All blocks are full\n");
         spinlock_unlock_irqrestore(&fba_lock, lock_flags);
         return NULL;
     }
 
+    uint64_t *bmp = _fba_bitmap + quad;
+    tprintf("Block %p has space [0x%016lx]!\n", bmp, *bmp);
+
     const int bit = first_set_bit_64(~(*bmp));
     bitmap_set(bmp, bit);
-    const uintptr_t block_address = _fba_begin + ((bmp - _fba_bitmap) * 64 + bit) * VM_PAGE_SIZE;
+    summary_update(quad);
+
+    const uintptr_t block_address = _fba_begin + (quad * 64 + bit) * VM_PAGE_SIZE;
     spinlock_unlock_irqrestore(&fba_lock, lock_flags);
     return do_alloc(block_address);
 }
@@ -348,6 +433,7 @@ void fba_free(void *block) {
 
     if (bitmap_check(_fba_bitmap + quad_index, bit_index)) {
         bitmap_clear(_fba_bitmap + quad_index, bit_index);
+        summary_update(quad_index);
         const uintptr_t phys = vmm_unmap_page_in(_pml4, block_address);
 
         if (!phys) {
@@ -20,6 +20,12 @@
 // the timer that's selected to drive it.
 #define KERNEL_HZ 100
 
+// With EXPERIMENTAL_TICKLESS, the longest an otherwise-idle CPU
+// will go without a timer interrupt. Remote wakeups kick the CPU
+// with a reschedule IPI, so this is mostly a backstop (e.g. for
+// RISC-V, which doesn't send those yet).
+#define TICKLESS_MAX_IDLE_NANOS 100000000
+
 /* ********************************************************** */
 /* 
  * Derived configuration - values that are derived from the
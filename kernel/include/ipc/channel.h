@@ -10,6 +10,7 @@
 #ifndef __ANOS_KERNEL_IPC_CHANNEL_H
 #define __ANOS_KERNEL_IPC_CHANNEL_H
 
+#include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
 
@@ -25,4 +26,14 @@ uint64_t ipc_channel_recv(uint64_t cookie, uint64_t *tag, size_t *buffer_size, v
 uint64_t ipc_channel_send(uint64_t cookie, uint64_t tag, size_t buffer_size, void *buffer);
 uint64_t ipc_channel_reply(uint64_t message_cookie, uint64_t result);
 
+// Queue a message without waiting for the reply. Returns the message
+// cookie to collect the reply with, or 0 on failure.
+uint64_t ipc_channel_send_async(uint64_t cookie, uint64_t tag, size_t buffer_size, void *buffer);
+
+// Collect the reply to an async send by this process (or any, if
+// message_cookie is 0), blocking until there is one. Returns the
+// collected message cookie, or 0 if there's nothing to wait for.
+// `handled` is set false if the channel was destroyed first.
+uint64_t ipc_channel_wait_reply(uint64_t message_cookie, uint64_t *reply, bool *handled);
+
 #endif //__ANOS_KERNEL_IPC_CHANNEL_H
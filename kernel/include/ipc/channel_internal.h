@@ -19,18 +19,61 @@
 #include "spinlock.h"
 #include "structs/list.h"
 #include "task.h"
+#include "vmm/vmconfig.h"
+
+// Largest buffer a message can carry (1MiB)
+#define IPC_BUFFER_MAX_PAGES ((256))
+
+typedef struct IpcCompletions IpcCompletions;
+
+/*
+ * Physical pages behind a multi-page message buffer, in buffer order.
+ * They needn't be contiguous - the receiver gets them mapped at one
+ * contiguous address, a run of contiguous pages at a time.
+ *
+ * Lives in a single FBA block.
+ */
+typedef struct {
+    Process *receiver;     // Where the buffer got mapped (if it did)
+    uintptr_t recv_vaddr;
+    uint64_t mapped_pages; // All but the first are unmapped again on reply
+    uint64_t page_count;
+    uintptr_t pages[];
+} IpcBufferPages;
 
 typedef struct {
     ListNode this;
     uint64_t cookie;
     uint64_t tag;
     size_t arg_buf_size;
-    uintptr_t arg_buf_phys;
-    Task *waiter;
+    uintptr_t arg_buf_phys; // Or IpcBufferPages*, for multi-page buffers
+    union {
+        Task *waiter;                // Blocked sender (synchronous send)
+        IpcCompletions *completions; // Where the reply goes (async send)
+    };
     uint64_t reply;
     bool handled;
+    bool async;
+    bool multi_page;
+    bool owns_pages; // Buffer pages are a copy, freed with the message (async)
 } IpcMessage;
 
+/*
+ * Per-process queue of async sends that have been replied to (or
+ * abandoned because their channel was destroyed) but not yet
+ * collected with ipc_channel_wait_reply.
+ */
+typedef struct IpcCompletions {
+    SpinLock *lock;
+    IpcMessage *head;     // Completed messages, oldest first
+    IpcMessage *tail;
+    Task *waiters;        // Tasks blocked in ipc_channel_wait_reply
+    uint32_t outstanding; // Sent and not yet collected, completed or not
+    bool orphaned;        // Owning process is gone, free messages as they complete
+    uint8_t reserved0[3];
+    uint64_t reserved[3];
+} IpcCompletions;
+
 typedef struct {
     uint64_t cookie;
     Task *receivers;
@@ -42,5 +85,7 @@ typedef struct {
 
 static_assert_sizeof(IpcMessage, ==, SLAB_BLOCK_SIZE);
 static_assert_sizeof(IpcChannel, ==, SLAB_BLOCK_SIZE);
+static_assert_sizeof(IpcCompletions, ==, SLAB_BLOCK_SIZE);
+static_assert_sizeof(IpcBufferPages, <=, VM_PAGE_SIZE - IPC_BUFFER_MAX_PAGES * sizeof(uintptr_t));
 
 #endif //__ANOS_KERNEL_IPC_CHANNEL_INTERNAL_H
@@ -0,0 +1,40 @@
+/*
+ * stage3 - Shared-memory IPC rings
+ * anos - An Operating System
+ *
+ * Copyright (c) 2025 Ross Bamford
+ *
+ * A ring is a pair of SPSC rings (see ipc/ring_shared.h) in memory
+ * shared between two processes, plus a doorbell for each end. The
+ * kernel isn't involved in moving data, only in setting up the
+ * memory and waking a consumer when its ring stops being empty.
+ */
+
+// clang-format Language: C
+
+#ifndef __ANOS_KERNEL_IPC_RING_H
+#define __ANOS_KERNEL_IPC_RING_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+void ipc_ring_init(void);
+
+// Create a ring with `ring_pages` of slots each way, and map it at
+// `vaddr` in the current process. Returns the ring cookie, or 0.
+uint64_t ipc_ring_create(uint32_t ring_pages, uintptr_t vaddr);
+
+// Map an existing ring at `vaddr` in the current process, as the
+// other end. Returns the size of the mapping, or 0.
+size_t ipc_ring_attach(uint64_t cookie, uintptr_t vaddr);
+
+// Wait for this process' doorbell on the ring. Returns immediately
+// if it's been rung since the last wait. False if the other end has
+// gone away (or this process isn't an end of the ring).
+bool ipc_ring_wait(uint64_t cookie);
+
+// Ring the other end's doorbell.
+bool ipc_ring_notify(uint64_t cookie);
+
+#endif //__ANOS_KERNEL_IPC_RING_H
@@ -0,0 +1,44 @@
+/*
+ * stage3 - Internal types for shared-memory IPC rings
+ * anos - An Operating System
+ *
+ * Copyright (c) 2025 Ross Bamford
+ *
+ * This shouldn't be included anywhere other than ipc/ring.c,
+ * and in tests.
+ */
+
+// clang-format Language: C
+
+#ifndef __ANOS_KERNEL_IPC_RING_INTERNAL_H
+#define __ANOS_KERNEL_IPC_RING_INTERNAL_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "ipc/ring_shared.h"
+#include "spinlock.h"
+#include "task.h"
+
+#define IPC_RING_MAX_TOTAL_PAGES ((1 + 2 * IPC_RING_MAX_PAGES))
+
+/*
+ * End 0 is the creating process, end 1 the one that attached. Each
+ * end consumes the other's ring, so `waiters[n]` / `pending[n]` are
+ * the doorbell for end n's consumer.
+ *
+ * Lives in a single FBA block.
+ */
+typedef struct {
+    uint64_t cookie;
+    SpinLock lock;
+    Process *ends[2];
+    Task *waiters[2];
+    bool pending[2];
+    bool closed;    // One end has gone, nobody will ring again
+    uint8_t refs;   // Ends still holding the ring
+    uint32_t total_pages;
+    uintptr_t pages[IPC_RING_MAX_TOTAL_PAGES];
+} IpcRing;
+
+#endif //__ANOS_KERNEL_IPC_RING_INTERNAL_H
@@ -0,0 +1,113 @@
+/*
+ * stage3 - Shared-memory IPC ring layout
+ * anos - An Operating System
+ *
+ * Copyright (c) 2025 Ross Bamford
+ *
+ * This is the layout of the memory shared by the two ends of an
+ * IPC ring, and the (lock-free, single-producer single-consumer)
+ * operations on it. The kernel only sets this up - everything else
+ * happens in userspace, which needs its own copy of this header.
+ *
+ * Page 0 holds the indices, followed by the slots for ring 0
+ * (written by the process that created the ring) and then those
+ * for ring 1 (written by the process that attached to it).
+ *
+ * Producers should ring the doorbell (anos_ring_notify) when
+ * ipc_ring_produce says to, and consumers should only wait on it
+ * (anos_ring_wait) once ipc_ring_is_empty says they've drained it.
+ */
+
+// clang-format Language: C
+
+#ifndef __ANOS_KERNEL_IPC_RING_SHARED_H
+#define __ANOS_KERNEL_IPC_RING_SHARED_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define IPC_RING_PAGE_SIZE ((0x1000))
+#define IPC_RING_MAX_PAGES ((16)) // Per ring, so up to 1024 slots each
+
+typedef struct {
+    uint64_t tag;
+    uint8_t data[56];
+} IpcRingSlot;
+
+// Head and tail are on their own cache lines, so producer and consumer aren't fighting over them
+typedef struct {
+    uint32_t head; // Next slot to fill - only written by the producer
+    uint8_t reserved0[60];
+    uint32_t tail; // Next slot to drain - only written by the consumer
+    uint8_t reserved1[60];
+} IpcRingIndices;
+
+typedef struct {
+    IpcRingIndices rings[2];
+    uint32_t slot_count; // Per ring, always a power of two
+    uint32_t ring_pages; // Per ring
+    uint8_t reserved[56];
+} IpcRingShared;
+
+static inline IpcRingSlot *ipc_ring_slots(IpcRingShared *shared, const uint8_t ring) {
+    return (IpcRingSlot *)((uint8_t *)shared + IPC_RING_PAGE_SIZE * (1 + ring * shared->ring_pages));
+}
+
+/*
+ * Put a slot on the ring. Returns false if it's full.
+ *
+ * `notify` is set if the consumer had drained the ring before this
+ * went on, in which case it may be waiting and needs a doorbell.
+ */
+static inline bool ipc_ring_produce(IpcRingShared *shared, const uint8_t ring, const IpcRingSlot *slot,
+                                    bool *notify) {
+    IpcRingIndices *indices = &shared->rings[ring];
+
+    const uint32_t head = __atomic_load_n(&indices->head, __ATOMIC_RELAXED);
+    const uint32_t tail = __atomic_load_n(&indices->tail, __ATOMIC_ACQUIRE);
+
+    if (head - tail >= shared->slot_count) {
+        return false;
+    }
+
+    ipc_ring_slots(shared, ring)[head & (shared->slot_count - 1)] = *slot;
+    __atomic_store_n(&indices->head, head + 1, __ATOMIC_RELEASE);
+
+    // Pairs with the fence in ipc_ring_is_empty - one of us will see the other
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    *notify = __atomic_load_n(&indices->tail, __ATOMIC_RELAXED) == head;
+
+    return true;
+}
+
+/*
+ * Take a slot off the ring. Returns false if it's empty.
+ */
+static inline bool ipc_ring_consume(IpcRingShared *shared, const uint8_t ring, IpcRingSlot *slot) {
+    IpcRingIndices *indices = &shared->rings[ring];
+
+    const uint32_t tail = __atomic_load_n(&indices->tail, __ATOMIC_RELAXED);
+    const uint32_t head = __atomic_load_n(&indices->head, __ATOMIC_ACQUIRE);
+
+    if (head == tail) {
+        return false;
+    }
+
+    *slot = ipc_ring_slots(shared, ring)[tail & (shared->slot_count - 1)];
+    __atomic_store_n(&indices->tail, tail + 1, __ATOMIC_RELEASE);
+
+    return true;
+}
+
+/*
+ * Consumer-side check before waiting on the doorbell. If this says
+ * empty, any later produce is guaranteed to ask for a notify.
+ */
+static inline bool ipc_ring_is_empty(IpcRingShared *shared, const uint8_t ring) {
+    IpcRingIndices *indices = &shared->rings[ring];
+
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    return __atomic_load_n(&indices->head, __ATOMIC_ACQUIRE) == __atomic_load_n(&indices->tail, __ATOMIC_RELAXED);
+}
+
+#endif //__ANOS_KERNEL_IPC_RING_SHARED_H
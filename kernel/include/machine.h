@@ -68,4 +68,10 @@ void restore_saved_interrupts(uint64_t flags);
 uint64_t get_kernel_upticks(void);
 void kernel_timer_eoe(void);
 
+// Monotonic nanoseconds, from the best clock the platform has
+uint64_t get_kernel_nanos(void);
+
+// Arm this CPU's timer to fire once, after (roughly) the given nanoseconds
+void kernel_timer_oneshot(uint64_t nanos);
+
 #endif //__ANOS_KERNEL_MACHINE_H
\ No newline at end of file
@@ -88,6 +88,17 @@ typedef struct {
     Limine_HHDM *response;
 } __attribute__((packed)) Limine_HHDMRequest;
 
+typedef struct {
+    uint64_t revision;
+    void *dtb_ptr;
+} __attribute__((packed)) Limine_DeviceTree;
+
+typedef struct {
+    uint64_t id[4];
+    uint64_t revision;
+    Limine_DeviceTree *response;
+} __attribute__((packed)) Limine_DeviceTreeRequest;
+
 typedef struct {
     const char *path;
     const char *string;
@@ -143,6 +154,7 @@ typedef struct {
 #define LIMINE_FRAMEBUFFER_REQUEST {LIMINE_COMMON_MAGIC, 0x9d5827dcd881dd75, 0xa3148604f6fab11b}
 #define LIMINE_HHDM_REQUEST {LIMINE_COMMON_MAGIC, 0x48dcf1cb8ad2b852, 0x63984e959a98244b}
 #define LIMINE_MODULE_REQUEST {LIMINE_COMMON_MAGIC, 0x3e7e279702be32af, 0xca1c4f3bd1280cee}
+#define LIMINE_DTB_REQUEST {LIMINE_COMMON_MAGIC, 0xb40ddb48fb54bac7, 0x545081493f81ffb7}
 
 #define LIMINE_MEDIA_TYPE_GENERIC 0
 #define LIMINE_MEDIA_TYPE_OPTICAL 1
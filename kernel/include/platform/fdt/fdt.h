@@ -0,0 +1,60 @@
+/*
+ * stage3 - Flattened Device Tree (FDT) routines
+ * anos - An Operating System
+ *
+ * Copyright (c) 2025 Ross Bamford
+ */
+
+// clang-format Language: C
+
+#ifndef __ANOS_KERNEL_PLATFORM_FDT_FDT_H
+#define __ANOS_KERNEL_PLATFORM_FDT_FDT_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define FDT_MAGIC 0xd00dfeed
+
+#define FDT_BEGIN_NODE 0x00000001
+#define FDT_END_NODE 0x00000002
+#define FDT_PROP 0x00000003
+#define FDT_NOP 0x00000004
+#define FDT_END 0x00000009
+
+/*
+ * FDT header - all fields are big-endian
+ */
+typedef struct {
+    uint32_t magic;
+    uint32_t totalsize;
+    uint32_t off_dt_struct;
+    uint32_t off_dt_strings;
+    uint32_t off_mem_rsvmap;
+    uint32_t version;
+    uint32_t last_comp_version;
+    uint32_t boot_cpuid_phys;
+    uint32_t size_dt_strings;
+    uint32_t size_dt_struct;
+} __attribute__((packed)) FDT_Header;
+
+/*
+ * Find a property on the node at the given absolute path (e.g. "/cpus").
+ *
+ * Path components without a unit address match nodes with one, so
+ * "/cpus/cpu" will find "/cpus/cpu@0".
+ *
+ * Returns a pointer to the (big-endian) property value, and stores its
+ * length in `len` if that's non-NULL. Returns NULL if the blob is invalid,
+ * or the node or property don't exist.
+ */
+const void *fdt_find_property(const void *fdt, const char *path, const char *name, uint32_t *len);
+
+/*
+ * Read a numeric property, which may be either one or two cells.
+ *
+ * Returns false (and leaves `value` alone) if the property doesn't exist
+ * or isn't a size we understand.
+ */
+bool fdt_read_u64(const void *fdt, const char *path, const char *name, uint64_t *value);
+
+#endif //__ANOS_KERNEL_PLATFORM_FDT_FDT_H
@@ -0,0 +1,71 @@
+/*
+ * stage3 - Buddy allocator for physical pages
+ * anos - An Operating System
+ *
+ * Copyright (c) 2025 Ross Bamford
+ *
+ * Tracks free blocks of 2^order pages (up to BUDDY_MAX_ORDER) over a
+ * span of physical memory, with one bitmap per order (a set bit is a
+ * free block) plus a summary bitmap over each, so finding a free block
+ * doesn't mean scanning the whole span.
+ *
+ * This doesn't do any locking, or touch the memory it manages. The
+ * metadata lives in a separate buffer supplied by the caller.
+ */
+
+// clang-format Language: C
+
+#ifndef __ANOS_KERNEL_PMM_BUDDY_H
+#define __ANOS_KERNEL_PMM_BUDDY_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define BUDDY_MAX_ORDER ((10)) // 4MiB blocks
+#define BUDDY_ORDER_COUNT ((BUDDY_MAX_ORDER + 1))
+
+typedef struct {
+    uintptr_t base;      // Aligned to the largest block size
+    uint64_t span_pages; // Multiple of the largest block size
+    uint64_t free_blocks[BUDDY_ORDER_COUNT];
+    uint64_t hints[BUDDY_ORDER_COUNT]; // No free blocks in summary words below these
+    uint64_t *bitmaps[BUDDY_ORDER_COUNT];
+    uint64_t *summaries[BUDDY_ORDER_COUNT];
+} BuddyAllocator;
+
+/*
+ * Bytes of metadata needed to manage [start, end), which will be
+ * widened to whole maximum-order blocks.
+ */
+size_t buddy_metadata_size(uintptr_t start, uintptr_t end);
+
+/*
+ * Set up to manage [start, end), with everything initially allocated.
+ * `metadata` must be buddy_metadata_size bytes, and zeroed.
+ */
+void buddy_init(BuddyAllocator *buddy, uintptr_t start, uintptr_t end, void *metadata);
+
+// The smallest order with at least `count` pages.
+uint8_t buddy_order_for(uint64_t count);
+
+/*
+ * Allocate a block of 2^order pages, aligned to its size.
+ *
+ * Returns the address, or 0xFF if nothing big enough is free.
+ */
+uintptr_t buddy_alloc(BuddyAllocator *buddy, uint8_t order);
+
+/*
+ * Free a block of 2^order pages allocated with buddy_alloc (or any
+ * aligned part of one), merging with its buddies as far as possible.
+ */
+void buddy_free(BuddyAllocator *buddy, uintptr_t addr, uint8_t order);
+
+/*
+ * Free `count` pages from `addr`, which needn't be aligned. Used when
+ * adding memory at startup, and to give back the tail of a block that
+ * was bigger than needed.
+ */
+void buddy_free_range(BuddyAllocator *buddy, uintptr_t addr, uint64_t count);
+
+#endif //__ANOS_KERNEL_PMM_BUDDY_H
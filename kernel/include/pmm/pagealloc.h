@@ -15,6 +15,14 @@
 #include "machine.h"
 #include "spinlock.h"
 
+#ifdef PMM_BUDDY
+#include "pmm/buddy.h"
+
+// The region struct is on the first page of the buffer, the buddy
+// bitmaps follow it (so this is 511 pages, enough for ~32GiB).
+#define PMM_BUDDY_MAX_METADATA ((0x1ff000))
+#endif
+
 typedef struct {
     uintptr_t phys_addr;
 } PhysPage;
@@ -24,14 +32,57 @@ typedef struct {
     uint64_t size;
 } MemoryBlock;
 
+#define PMM_REGION_FLAG_CPU_CACHES ((1 << 0))
+
+// Pages per CPU (short of 64 to leave room for the lock), and how many move to / from the region at once
+#define PMM_CPU_CACHE_SIZE ((56))
+#define PMM_CPU_CACHE_BATCH ((32))
+
+// Pages in each CPU's pool of pre-zeroed pages
+#define PMM_ZERO_POOL_SIZE ((48))
+
 typedef struct {
     SpinLock lock;
     uint64_t flags;
     uint64_t size;
-    uint64_t free;
+    uint64_t free; // Doesn't include pages sitting in per-CPU caches
+#ifdef PMM_BUDDY
+    BuddyAllocator buddy;
+#else
     MemoryBlock *sp;
+#endif
 } MemoryRegion;
 
+/*
+ * Per-CPU magazine of free pages, lives in the PerCPUState. Touched
+ * with interrupts disabled and the lock held - usually only by its own
+ * CPU, but others take from it once everything else is out of memory.
+ */
+typedef struct {
+    SpinLock lock;
+    uint64_t alloc_hits;
+    uint64_t alloc_misses; // Had to refill from the region
+    uint64_t free_hits;
+    uint64_t free_misses; // Had to drain to the region
+    uint64_t count;
+    uintptr_t pages[PMM_CPU_CACHE_SIZE];
+} PerCPUPageCache;
+
+/*
+ * Per-CPU pool of free pages that are known to be zeroed, filled in
+ * the background by the idle thread. Lives in the PerCPUState, and
+ * is touched with interrupts disabled and the lock held - other CPUs
+ * take from it too once everything else is out of memory.
+ */
+typedef struct {
+    SpinLock lock;
+    uint64_t hits;   // Wanted a zeroed page, and got one
+    uint64_t misses; // Wanted a zeroed page, had to zero one instead
+    uint64_t zeroed; // Pages zeroed in the background
+    uint64_t count;
+    uintptr_t pages[PMM_ZERO_POOL_SIZE];
+} PerCPUZeroPool;
+
 /*
  * Initialize the allocator.
  *
@@ -49,6 +100,10 @@ typedef struct {
  * region. Growing upward means, if the buffer is in a virtual
  * alloc area, physical memory will only be allocated as it grows.
  *
+ * With PMM_BUDDY, the buddy allocator's bitmaps go in the buffer
+ * after the first page instead. Pages for them are taken from the
+ * memory map and mapped with arch_pmm_map_metadata_page.
+ *
  * Any memory found in the memory map that falls below the supplied
  * managed base address will be ignored by the allocator.
  *
@@ -62,7 +117,9 @@ MemoryRegion *page_alloc_init_limine(Limine_MemMap *memmap, uint64_t managed_bas
  *
  * Currently, only 4KiB pages are supported.
  *
- * Returns a page aligned start address on success.
+ * Returns a page aligned start address on success. With PMM_BUDDY,
+ * it's also aligned to `count` rounded up to a power of two (up to
+ * 4MiB), and the pages can be freed individually.
  *
  * If unsuccessful, an unaligned number (with 0xFF in the least-significant
  * byte) will be returned.
@@ -78,6 +135,9 @@ uintptr_t page_alloc_m(MemoryRegion *region, uint64_t count);
  *
  * Currently, only 4KiB pages are supported.
  *
+ * Once this CPU's cache and the region are empty, this falls back
+ * to zeroed pages from this CPU's pool, then from other CPUs' pools.
+ *
  * Returns a page aligned start address on success.
  *
  * If unsuccessful, an unaligned number (with 0xFF in the least-significant
@@ -85,6 +145,28 @@ uintptr_t page_alloc_m(MemoryRegion *region, uint64_t count);
  */
 uintptr_t page_alloc(MemoryRegion *region);
 
+/*
+ * Allocate a single physical page, for the idle thread to zero and
+ * give back with page_free_zeroed.
+ *
+ * Like page_alloc, but never falls back to zeroed pages from any
+ * CPU's pool, so fails once there's nothing else left.
+ */
+uintptr_t page_alloc_for_zeroing(MemoryRegion *region);
+
+/*
+ * Allocate up to `count` single physical pages in one go, into
+ * the `pages` array. They aren't necessarily contiguous.
+ *
+ * Takes what it can from this CPU's cache, and the rest from the
+ * region under a single lock hold. If that runs out, zeroed pages
+ * are taken from this CPU's pool, then from other CPUs' pools.
+ *
+ * Returns the number of pages allocated, which is only less than
+ * `count` if memory ran out.
+ */
+uint64_t page_alloc_batch(MemoryRegion *region, uintptr_t *pages, uint64_t count);
+
 /*
  * Free a physical page.
  *
@@ -92,4 +174,58 @@ uintptr_t page_alloc(MemoryRegion *region);
  */
 void page_free(MemoryRegion *region, uintptr_t page);
 
+/*
+ * Take up to `count` pages that are known to be zeroed from this
+ * CPU's pool, into the `pages` array.
+ *
+ * This never goes to the region - returns the number of pages taken,
+ * and the caller should allocate (and zero) the rest as usual.
+ */
+uint64_t page_alloc_zeroed_batch(MemoryRegion *region, uintptr_t *pages, uint64_t count);
+
+/*
+ * Take a single page that's known to be zeroed from this CPU's pool.
+ *
+ * If there isn't one, an unaligned number (with 0xFF in the
+ * least-significant byte) will be returned.
+ */
+uintptr_t page_alloc_zeroed(MemoryRegion *region);
+
+/*
+ * Give a free page that the caller has zeroed to this CPU's pool.
+ *
+ * Returns false (and the page still belongs to the caller) if
+ * the pool is full.
+ */
+bool page_free_zeroed(MemoryRegion *region, uintptr_t page);
+
+/*
+ * Returns true if this CPU's zero pool has no room for more pages
+ * (or there are no pools yet, before SMP is started).
+ */
+bool page_zero_pool_full(MemoryRegion *region);
+
+/*
+ * Start serving single-page allocations and frees for this region
+ * from per-CPU caches (and zero pools). Every CPU's per-CPU state
+ * must be set up before calling this.
+ *
+ * Only one region can be cached.
+ */
+void page_alloc_notify_smp_started(MemoryRegion *region);
+
+/*
+ * Free memory (in bytes) in the region, including pages that
+ * are sitting in per-CPU caches and zero pools.
+ */
+uint64_t page_alloc_free_bytes(MemoryRegion *region);
+
+#ifdef PMM_BUDDY
+/*
+ * Map a page of allocator metadata during init, before anything else
+ * can allocate page tables. Provided by the arch.
+ */
+bool arch_pmm_map_metadata_page(uintptr_t vaddr, uintptr_t phys);
+#endif
+
 #endif //__ANOS_KERNEL_PMM_PAGEALLOC_H
@@ -0,0 +1,76 @@
+/*
+ * stage3 - Physical frame database
+ * anos - An Operating System
+ *
+ * Copyright (c) 2025 Ross Bamford
+ *
+ * A flat array with one PageFrame for every physical page from
+ * zero up to the top of RAM (as reported by the memmap), indexed
+ * by PFN (i.e. physical address >> VM_PAGE_LINEAR_SHIFT).
+ *
+ * It's sized and mapped once at boot and never changes after that,
+ * so lookups are O(1) and need no locking - the fields are only ever
+ * accessed with atomics.
+ */
+
+// clang-format Language: C
+
+#ifndef __ANOS_KERNEL_PMM_PFNDB_H
+#define __ANOS_KERNEL_PMM_PFNDB_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "anos_assert.h"
+#include "machine.h"
+
+// 512GiB of virtual space, enough for frames covering 128TiB of physical
+#define PFNDB_BEGIN ((0xffffff0000000000))
+#define PFNDB_SIZE ((0x8000000000))
+
+#define PAGE_FRAME_FLAG_RAM ((1 << 0)) // Memmap says this is RAM the kernel could use
+
+typedef struct {
+    uint32_t refcount; // Shared mappings, 0 if not shared
+    uint16_t flags;
+    uint16_t reserved;
+    uint64_t owner; // PID of the owning process, or 0
+} PageFrame;
+
+static_assert_sizeof(PageFrame, ==, 16);
+
+/*
+ * Size the database from the memmap, then allocate and map its pages
+ * at `begin` in the given PML4 (normally PFNDB_BEGIN - tests can point
+ * this elsewhere).
+ *
+ * Must be called once, after the PMM and VMM are ready, before any of
+ * the other routines are used (the limine entrypoints handle that...)
+ */
+bool pfndb_init(uint64_t *pml4, uintptr_t begin, const Limine_MemMap *memmap);
+
+// Number of frames covered, i.e. the highest PFN + 1.
+uint64_t pfndb_frame_count(void);
+
+// The frame for this physical address, or NULL if it's not covered.
+PageFrame *pfndb_lookup(uintptr_t phys);
+
+/*
+ * Increment the reference count for the given address.
+ *
+ * Returns the new reference count for that address, or 0 on error.
+ */
+uint32_t pfndb_ref_increment(uintptr_t phys);
+
+/*
+ * Decrement the reference count for the given address.
+ *
+ * Returns the **previous** reference count for that address,
+ * or 0 if no reference count (or error).
+ */
+uint32_t pfndb_ref_decrement(uintptr_t phys);
+
+// Record which process owns the frame (0 for none).
+void pfndb_set_owner(uintptr_t phys, uint64_t pid);
+
+#endif //__ANOS_KERNEL_PMM_PFNDB_H
@@ -20,6 +20,7 @@
 typedef struct Task Task;
 
 #include "process/memory.h"
+#include "smp/cpumask.h"
 #include "spinlock.h"
 
 typedef struct {
@@ -37,18 +38,26 @@ typedef struct {
     uint64_t reserved[3];      // 64
 } ProcessMemoryInfo;
 
+typedef struct {
+    CpuMask cpu_mask;       // CPUs with our PML4 loaded, for TLB shootdowns
+    CpuMask tlb_stale_mask; // CPUs that must flush our ASID before using it again
+} ProcessCpus;
+
 typedef struct Process {
-    uint64_t cap_failures;      // 8 bytes
-    uint64_t pid;               // 16
-    uintptr_t pml4;             // 24
-    ProcessTask *tasks;         // 32
-    ProcessMemoryInfo *meminfo; // 40
-    uint64_t reserved[3];       // 64
+    uint64_t cap_failures;                  // 8 bytes
+    uint64_t pid;                           // 16
+    uintptr_t pml4;                         // 24
+    ProcessTask *tasks;                     // 32
+    ProcessMemoryInfo *meminfo;             // 40
+    struct IpcCompletions *ipc_completions; // 48 - async IPC replies, created on first use
+    ProcessCpus *cpus;                      // 56 - CPU masks, too big to live in here with many CPUs
+    uint64_t reserved;                      // 64
 } Process;
 
 static_assert_sizeof(ProcessTask, ==, SLAB_BLOCK_SIZE);
 static_assert_sizeof(ProcessMemoryInfo, ==, SLAB_BLOCK_SIZE);
 static_assert_sizeof(Process, ==, SLAB_BLOCK_SIZE);
+static_assert_sizeof(ProcessCpus, <=, SLAB_BLOCK_SIZE);
 
 void process_init(void);
 
@@ -43,8 +43,12 @@ bool address_space_init(void);
  * * Allocate a new address space
  * * Copy all kernel PDPTs into it
  * * Map the space covered by `regions` as COW shared
- * * Allocate pages to cover `init_stack_len` bytes and map it at `init_stack_vaddr`
+ * * Allocate and map enough pages at the top of the stack (`init_stack_len`
+ *   bytes at `init_stack_vaddr`) for the initial values, and at least one
  * * Set up initial values at the bottom of the stack
+ *
+ * The rest of the stack isn't mapped - once there's a process for this
+ * address space, give it the region from address_space_init_stack_region.
  * 
  * Currently, on failure, this will leak some memory - that'll be fixed once
  * I put a proper address space destroy function in.
@@ -54,4 +58,14 @@ bool address_space_init(void);
 uintptr_t address_space_create(uintptr_t init_stack_vaddr, size_t init_stack_len, int region_count,
                                AddressSpaceRegion regions[], int stack_value_count, const uint64_t *stack_values);
 
+/*
+ * Find the part of a stack set up by address_space_create (with the same
+ * arguments) that it didn't map, less a guard page at the bottom. That's
+ * meant to be an automap region, so it's faulted in as it's used.
+ *
+ * Returns false if there's none, i.e. the whole stack is mapped already.
+ */
+bool address_space_init_stack_region(uintptr_t init_stack_vaddr, size_t init_stack_len, int stack_value_count,
+                                     uintptr_t *region_start, uintptr_t *region_end);
+
 #endif //__ANOS_KERNEL_ARCH_X86_64_PROCESS_ADDRESS_SPACE_H
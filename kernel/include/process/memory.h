@@ -75,6 +75,34 @@ void process_release_owned_pages(Process *proc);
  */
 uintptr_t process_page_alloc(Process *proc, MemoryRegion *region);
 
+/*
+ * Allocate up to `count` pages of process-owned memory for
+ * the given process in one go, into the `pages` array. They
+ * aren't necessarily contiguous.
+ *
+ * If `zeroed` isn't NULL, pages from this CPU's pool of
+ * pre-zeroed ones are used first, and it's set to how many
+ * of those there are (at the start of the array).
+ *
+ * Returns the number of pages allocated (and owned), which
+ * is only less than `count` if memory ran out.
+ */
+uint64_t process_pages_alloc(Process *proc, MemoryRegion *region, uintptr_t *pages, uint64_t count,
+                             uint64_t *zeroed);
+
+/*
+ * Allocate a large (MEGA_PAGE_SIZE) naturally-aligned block of
+ * process-owned memory for the given process. Each page in it
+ * is owned (and can be freed) individually.
+ *
+ * Only the buddy allocator can guarantee the alignment, so
+ * without PMM_BUDDY this always fails.
+ *
+ * Returns an aligned address on success, or non-aligned
+ * (at least 0xff) on failure.
+ */
+uintptr_t process_page_alloc_large(Process *proc, MemoryRegion *region);
+
 /*
  * Free the given process-owned memory page.
  */
@@ -16,6 +16,21 @@
 #include "smp/state.h"
 #include "task.h"
 
+/*
+ * Load balancing counters for a single CPU. These are only
+ * ever updated by the owning CPU, and are read racily, so
+ * they're good for tuning but not much else...
+ */
+typedef struct {
+    uint64_t load;       // Fixed-point average of queued non-idle tasks (see SCHED_LOAD_SHIFT)
+    uint64_t steals;     // Tasks pulled while this CPU had nothing else to run
+    uint64_t migrations; // Tasks pulled by periodic balancing while busy
+    uint64_t contended;  // Pulls abandoned because the victim's queues were locked
+    uint64_t hot_skips;  // Candidates left in place because they ran too recently
+} SchedBalanceStats;
+
+#define SCHED_LOAD_SHIFT ((8))
+
 // This **must** only be called on the BSP
 bool sched_init(uintptr_t sys_sp, uintptr_t sys_ssp, uintptr_t start_func, uintptr_t bootstrap_func,
                 TaskClass task_class);
@@ -36,8 +51,27 @@ void sched_unblock(Task *task);
 // This **must** be called with the target CPU's scheduler locked and interrupts disabled!
 void sched_unblock_on(Task *task, PerCPUState *state);
 
+// Unblock on another CPU while holding this one's lock. Their lock is only
+// tried - if it's held, the wakeup is left for them to pick up when they next
+// schedule (which they're kicked to do), rather than risk them waiting on ours.
+//
+// This **must** be called with this CPU's scheduler locked and interrupts disabled!
+void sched_unblock_remote(Task *task, PerCPUState *target);
+
+// Switch straight to `next` (which must be blocked, and not queued anywhere),
+// donating what's left of the current task's timeslice. The current task is
+// requeued if it's still running. If `next` isn't what this CPU would pick
+// anyway (something of a higher class is queued) or there's no slice left to
+// give, this is just sched_unblock followed by sched_schedule.
+//
+// This **must** be called with this CPU's scheduler locked and interrupts disabled!
+void sched_handoff(Task *next);
+
 PerCPUState *sched_find_target_cpu(void);
 
+// Returns false if the CPU doesn't exist or has no scheduler state yet
+bool sched_get_balance_stats(uint16_t cpu_num, SchedBalanceStats *stats);
+
 uint64_t sched_lock_this_cpu(void);
 uint64_t sched_lock_any_cpu(PerCPUState *cpu);
 
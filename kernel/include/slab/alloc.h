@@ -6,11 +6,15 @@
  *
  * The slab allocator sits on top of the fixed block
  * allocator and allocates 16KiB slabs carved up into
- * blocks of 64 bytes (256 blocks per slab).
+ * blocks of one size class (32, 64, 128, 256 or 512 bytes).
  *
- * The top block in each slab is reserved for metadata,
- * and slabs form a linked list within the kernel's slab
- * space.
+ * The top block(s) in each slab are reserved for metadata,
+ * and slabs form doubly-linked lists (partial and full) per
+ * size class within the kernel's slab space.
+ *
+ * Once SMP is up, each CPU also keeps a small magazine of
+ * free blocks per size class, refilled from and drained to
+ * the slabs in batches, so most calls never take a lock.
  */
 
 // clang-format Language: C
@@ -31,19 +35,28 @@
 #define SLAB_BASE_MASK ((~(BYTES_PER_SLAB - 1)))
 #define SLAB_BLOCK_SIZE ((64)) // 64-byte blocks
 #define BLOCKS_PER_SLAB ((BYTES_PER_SLAB / SLAB_BLOCK_SIZE))
+#define SLAB_MAX_BLOCK_SIZE ((512))
 #else
 static constexpr uint64_t BYTES_PER_SLAB = 16384; // 16KiB Slabs
 static constexpr uint64_t SLAB_BASE_MASK = ~(BYTES_PER_SLAB - 1);
 static constexpr uint8_t SLAB_BLOCK_SIZE = 64; // 64-byte blocks
 static constexpr uint64_t BLOCKS_PER_SLAB = BYTES_PER_SLAB / SLAB_BLOCK_SIZE;
+static constexpr uint64_t SLAB_MAX_BLOCK_SIZE = 512;
 #endif
 
+#define SLAB_CLASS_COUNT ((5)) // 32, 64, 128, 256, 512
+#define SLAB_MAGAZINE_SIZE ((16))
+#define SLAB_MAGAZINE_BATCH ((8))
+
 typedef struct Slab {
     ListNode this;
-    uint64_t reserved0;
+    struct Slab *prev;
+    uint16_t block_size;
+    uint16_t free_blocks;
+    uint8_t size_class;
+    uint8_t reserved0[3];
     uint64_t reserved1;
-    uint64_t reserved2;
-    uint64_t bitmap0;
+    uint64_t bitmap0; // 32-byte class carries on into the next 32 bytes
     uint64_t bitmap1;
     uint64_t bitmap2;
     uint64_t bitmap3;
@@ -51,6 +64,20 @@ typedef struct Slab {
 
 static_assert_sizeof(Slab, ==, SLAB_BLOCK_SIZE);
 
+/*
+ * Per-CPU magazines of free blocks, one per size class, live in
+ * the PerCPUState. Only touched by their own CPU, with interrupts
+ * disabled.
+ */
+typedef struct {
+    uint64_t count;
+    void *blocks[SLAB_MAGAZINE_SIZE];
+} SlabMagazine;
+
+typedef struct {
+    SlabMagazine magazines[SLAB_CLASS_COUNT];
+} PerCPUSlabCache;
+
 static inline Slab *slab_base(void *block_ptr) {
     const uintptr_t block_addr = (uintptr_t)block_ptr;
 
@@ -63,8 +90,16 @@ static inline Slab *slab_base(void *block_ptr) {
 
 bool slab_alloc_init();
 
+// Allocate a 64-byte block
 void *slab_alloc_block();
 
+// Allocate a block from the smallest class that fits, or NULL if size is 0 or too big
+void *slab_alloc(uint64_t size);
+
+// Free a block from any size class
 void slab_free(void *block);
 
+// Called once all CPUs are up, switches on the per-CPU magazines
+void slab_notify_smp_started(void);
+
 #endif //__ANOS_KERNEL_SLAB_ALLOC_H
\ No newline at end of file
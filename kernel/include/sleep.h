@@ -21,7 +21,7 @@
 void sleep_init(void);
 
 /* Caller MUST lock the scheduler! */
-void sleep_task(Task *task, uint64_t ticks);
+void sleep_task(Task *task, uint64_t nanos);
 
 /* Caller MUST lock the scheduler! */
 void check_sleepers();
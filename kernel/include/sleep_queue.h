@@ -73,4 +73,10 @@ bool sleep_queue_enqueue(SleepQueue *queue, Task *task, uint64_t deadline);
  */
 Task *sleep_queue_dequeue(SleepQueue *queue, uint64_t deadline);
 
+/*
+ * Deadline of the earliest sleeper, or UINT64_MAX if
+ * nobody is sleeping.
+ */
+uint64_t sleep_queue_next_deadline(SleepQueue *queue);
+
 #endif //__ANOS_KERNEL_SLEEP_QUEUE_H
\ No newline at end of file
@@ -0,0 +1,121 @@
+/*
+ * stage3 - Sets of CPUs
+ * anos - An Operating System
+ *
+ * Copyright (c) 2025 Ross Bamford
+ *
+ * A bit per CPU, for as many CPUs as MAX_CPU_COUNT allows - so
+ * anything that used to be a uint64_t "one bit per CPU" mask still
+ * works past 64 of them.
+ *
+ * The single-bit operations are atomic, since these are generally
+ * shared between CPUs that each only change their own bit. Anything
+ * looking at the whole set only sees each word atomically, so must
+ * not rely on it being consistent across words.
+ */
+
+// clang-format Language: C
+
+#ifndef __ANOS_KERNEL_SMP_CPUMASK_H
+#define __ANOS_KERNEL_SMP_CPUMASK_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "cpu.h"
+
+#define CPU_MASK_WORDS (((MAX_CPU_COUNT + 63) / 64))
+
+typedef struct {
+    uint64_t words[CPU_MASK_WORDS];
+} CpuMask;
+
+static inline uint64_t cpu_mask_bit(const uint16_t cpu) { return 1ULL << (cpu & 63); }
+
+static inline uint64_t *cpu_mask_word(CpuMask *mask, const uint16_t cpu) { return &mask->words[cpu >> 6]; }
+
+static inline void cpu_mask_clear_all(CpuMask *mask) {
+    for (int i = 0; i < CPU_MASK_WORDS; i++) {
+        mask->words[i] = 0;
+    }
+}
+
+// Just CPUs [0, count) - not atomic, for building masks locally
+static inline void cpu_mask_set_first(CpuMask *mask, const uint16_t count) {
+    for (int i = 0; i < CPU_MASK_WORDS; i++) {
+        const int first = i * 64;
+
+        if (count >= first + 64) {
+            mask->words[i] = ~0ULL;
+        } else if (count > first) {
+            mask->words[i] = (1ULL << (count - first)) - 1;
+        } else {
+            mask->words[i] = 0;
+        }
+    }
+}
+
+static inline bool cpu_mask_test(const CpuMask *mask, const uint16_t cpu, const int memorder) {
+    return __atomic_load_n(&mask->words[cpu >> 6], memorder) & cpu_mask_bit(cpu);
+}
+
+static inline void cpu_mask_set(CpuMask *mask, const uint16_t cpu, const int memorder) {
+    __atomic_fetch_or(cpu_mask_word(mask, cpu), cpu_mask_bit(cpu), memorder);
+}
+
+static inline void cpu_mask_clear(CpuMask *mask, const uint16_t cpu, const int memorder) {
+    __atomic_fetch_and(cpu_mask_word(mask, cpu), ~cpu_mask_bit(cpu), memorder);
+}
+
+// Every CPU but the given one (including any that don't exist, which never look)
+static inline void cpu_mask_set_all_except(CpuMask *mask, const uint16_t cpu, const int memorder) {
+    for (int i = 0; i < CPU_MASK_WORDS; i++) {
+        __atomic_fetch_or(&mask->words[i], i == (cpu >> 6) ? ~cpu_mask_bit(cpu) : ~0ULL, memorder);
+    }
+}
+
+static inline int cpu_mask_count(const CpuMask *mask) {
+    int count = 0;
+
+    for (int i = 0; i < CPU_MASK_WORDS; i++) {
+        count += __builtin_popcountll(mask->words[i]);
+    }
+
+    return count;
+}
+
+// Lowest CPU in the set, or -1 if it's empty
+static inline int cpu_mask_first(const CpuMask *mask) {
+    for (int i = 0; i < CPU_MASK_WORDS; i++) {
+        if (mask->words[i]) {
+            return i * 64 + __builtin_ctzll(mask->words[i]);
+        }
+    }
+
+    return -1;
+}
+
+// Lowest CPU in the set after the given one, or -1 if there isn't one
+static inline int cpu_mask_next(const CpuMask *mask, const uint16_t cpu) {
+    int i = (cpu + 1) >> 6;
+
+    if (i >= CPU_MASK_WORDS) {
+        return -1;
+    }
+
+    uint64_t word = mask->words[i] & (~0ULL << ((cpu + 1) & 63));
+
+    while (!word) {
+        if (++i == CPU_MASK_WORDS) {
+            return -1;
+        }
+
+        word = mask->words[i];
+    }
+
+    return i * 64 + __builtin_ctzll(word);
+}
+
+#define cpu_mask_for_each(cpu, mask) for (int cpu = cpu_mask_first(mask); cpu >= 0; cpu = cpu_mask_next(mask, cpu))
+
+#endif //__ANOS_KERNEL_SMP_CPUMASK_H
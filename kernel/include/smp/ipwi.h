@@ -13,6 +13,12 @@
  * the design is generic enough that it can be extended to support
  * other arbitrary task types.
  *
+ * Each CPU has a fixed-size mailbox, a bounded MPSC ring in its
+ * per-CPU state - any number of CPUs can post to it without locks,
+ * and only that CPU (from its IPI handler) ever takes items out.
+ * Nothing is allocated, so a full mailbox just means the enqueue
+ * fails - TLB shootdowns fall back to asking for a full flush then.
+ *
  * Architecture-specific notes for x86_64:
  *
  * It should be noted that very modern (i.e. Alder Lake and later)
@@ -48,6 +54,9 @@ static constexpr uint8_t IPWI_WORKITEM_PAYLOAD_SIZE = IPWI_WORKITEM_SIZE - sizeo
 #endif
 
 #define IPWI_IPI_VECTOR ((0x02)) // Use NMI for Panic IPI
+#define IPWI_MAILBOX_SIZE ((16))  // Per-CPU, must be a power of two
+#define IPWI_MAILBOX_MASK ((IPWI_MAILBOX_SIZE - 1))
+#define IPWI_RESCHEDULE_VECTOR ((0x32))
 
 typedef enum {
     IPWI_TYPE_REMOTE_EXEC = 1,
@@ -67,8 +76,11 @@ typedef struct {
     uint64_t args[6];
 } IpwiPayloadRemoteExec;
 
+// Above this many pages, targets just flush their whole TLB instead
+#define IPWI_TLB_SHOOTDOWN_FULL_FLUSH_PAGES ((32))
+
 typedef struct {
-    uint64_t reserved0;
+    uint64_t *ack_count; // Decremented by each target when done, if not NULL
     uintptr_t start_vaddr;
     size_t page_count;
     uint64_t target_pid;   // Only PID, **or** PML4,
@@ -95,9 +107,11 @@ bool ipwi_init(void);
 
 /*
  * Enqueue the given work item for the given CPU. The item will be copied
- * into the target CPU's queue so can be changed after this returns.
+ * into the target CPU's mailbox so can be changed after this returns.
+ *
+ * Returns false if the CPU doesn't exist, or its mailbox is full.
  */
-bool ipwi_enqueue(const IpwiWorkItem *item, uint8_t cpu_num);
+bool ipwi_enqueue(const IpwiWorkItem *item, uint16_t cpu_num);
 
 /*
  * Enqueue the given work item for all CPUs except the current one.
@@ -115,12 +129,52 @@ bool ipwi_enqueue_all_except_current(IpwiWorkItem *item);
 void ipwi_notify_all_except_current(void);
 
 /*
- * Dequeue the next item from this CPU's queue, if available.
+ * Send an interprocessor notification to the given CPU only.
+ *
+ * Returns false if the CPU doesn't exist.
+ */
+bool ipwi_notify(uint16_t cpu_num);
+
+/*
+ * Dequeue the next item from this CPU's mailbox, if available.
  *
  * Returns true if an item was dequeued (into `out_item`) and false otherwise.
  *
- * The item is copied into the provided structure.
+ * The item is copied into the provided structure. Only one consumer is
+ * allowed, so this must only be called from the IPI handler.
  */
 bool ipwi_dequeue_this_cpu(IpwiWorkItem *out_item);
 
+/*
+ * Ask the given CPU to flush its whole TLB the next time it handles an
+ * IPI - for when a shootdown can't be queued because the mailbox is full.
+ * The caller still needs to notify it.
+ *
+ * Returns a ticket for ipwi_tlb_flush_done, or 0 if the CPU doesn't exist.
+ */
+uint64_t ipwi_request_tlb_flush(uint16_t cpu_num);
+
+// Whether the flush with the given ticket has been done.
+bool ipwi_tlb_flush_done(uint16_t cpu_num, uint64_t ticket);
+
+/*
+ * Ask the given CPU to run its scheduler as soon as possible.
+ *
+ * This doesn't go through the work-item queue - that's drained
+ * from NMI, where taking the scheduler lock isn't safe. Instead
+ * it's a separate (maskable) interrupt, and a per-CPU pending
+ * flag, so any number of requests made before the target gets
+ * around to scheduling only cost a single IPI.
+ *
+ * Returns true if an IPI was sent, false if one was already
+ * pending (or the CPU doesn't exist).
+ */
+bool ipwi_notify_reschedule(uint16_t cpu_num);
+
+/*
+ * Handle a reschedule IPI on this CPU. Arch code calls this
+ * once the interrupt has been acknowledged.
+ */
+void ipwi_reschedule_handler(void);
+
 #endif //__ANOS_KERNEL_SMP_REMOTE_EXEC_H__
\ No newline at end of file
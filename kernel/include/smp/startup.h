@@ -14,6 +14,16 @@
 
 #include "platform/acpi/acpitables.h"
 
-void smp_bsp_start_aps(ACPI_RSDT *rsdt, uint32_t volatile *lapic);
+/*
+ * Count the CPUs (BSP included) in the MADT that we'll try to start,
+ * capped at MAX_CPU_COUNT.
+ */
+uint16_t smp_count_cpus(ACPI_RSDT *rsdt);
+
+/*
+ * Start the APs, returning how many of them checked in from the
+ * trampoline (any that didn't are given up on).
+ */
+uint16_t smp_bsp_start_aps(ACPI_RSDT *rsdt);
 
 #endif //__ANOS_SMP_STARTUP_H
@@ -12,12 +12,16 @@
 #ifndef __ANOS_SMP_STATE_H
 #define __ANOS_SMP_STATE_H
 
+#include <stdbool.h>
 #include <stdint.h>
 
 #include "anos_assert.h"
+#include "pmm/pagealloc.h"
+#include "slab/alloc.h"
 #include "sleep_queue.h"
+#include "smp/ipwi.h"
 #include "spinlock.h"
-#include "structs/shift_array.h"
+#include "vmm/asid.h"
 #include "vmm/vmconfig.h"
 
 #define STATE_SCHED_DATA_MAX ((672))
@@ -45,13 +49,32 @@ typedef struct PerCPUState {
     uint8_t sched_data[STATE_SCHED_DATA_MAX]; // takes us to 928 bytes
     uint8_t task_data[STATE_TASK_DATA_MAX];   // takes us to 960 bytes
 
-    uint64_t reserved3[8]; // takes us to 1024 bytes
+    PerCPUAsidState asids; // takes us to 1024 bytes
 
-    SleepQueue sleep_queue;            // 1088 (locked by sched lock)
-    SpinLock ipwi_queue_lock_this_cpu; // 1152
-    ShiftToMiddleArray ipwi_queue;     // 1216
+    SleepQueue sleep_queue; // 1088 (locked by sched lock)
 
-    uint8_t reserved4[2880]; // takes us to 4096 bytes
+    uint64_t ipwi_tail;    // 1096 - claimed by senders, so on its own line
+    uint8_t reserved4[56]; // 1152
+
+    uint64_t ipwi_head;               // 1160 - only ever touched by this CPU
+    uint64_t ipwi_reschedule_pending; // 1168
+    uint64_t ipwi_flush_requested;    // 1176
+    uint64_t ipwi_flush_done;         // 1184
+    uint8_t reserved5[32];            // 1216
+
+    uint32_t ipwi_seq[IPWI_MAILBOX_SIZE]; // 1280
+
+    PerCPUPageCache page_cache; // 1832
+
+    PerCPUSlabCache slab_cache; // 2512
+
+    uint8_t reserved6[48]; // 2560
+
+    IpwiWorkItem ipwi_mailbox[IPWI_MAILBOX_SIZE]; // 3584
+
+    PerCPUZeroPool zero_pool; // 4064
+
+    uint8_t reserved7[32]; // takes us to 4096 bytes
 } PerCPUState;
 
 static_assert_sizeof(PerCPUState, ==, VM_PAGE_SIZE);
@@ -59,13 +82,15 @@ static_assert_sizeof(PerCPUState, ==, VM_PAGE_SIZE);
 #ifdef UNIT_TESTS
 #ifdef MUNIT_H
 PerCPUState __test_cpu_state[4];
-uint8_t __test_cpu_count = 4;
+uint16_t __test_cpu_count = 4;
+_Thread_local uint8_t __test_this_cpu;
 #else
 extern PerCPUState __test_cpu_state[4];
-extern uint8_t __test_cpu_count;
-static inline PerCPUState *state_get_for_this_cpu(void) { return &__test_cpu_state[0]; }
-static inline uint8_t state_get_cpu_count(void) { return __test_cpu_count; }
-static inline PerCPUState *state_get_for_any_cpu(uint8_t cpu_num) { return &__test_cpu_state[cpu_num]; }
+extern uint16_t __test_cpu_count;
+extern _Thread_local uint8_t __test_this_cpu; // Lets threaded benchmarks be "different CPUs"
+static inline PerCPUState *state_get_for_this_cpu(void) { return &__test_cpu_state[__test_this_cpu]; }
+static inline uint16_t state_get_cpu_count(void) { return __test_cpu_count; }
+static inline PerCPUState *state_get_for_any_cpu(uint16_t cpu_num) { return &__test_cpu_state[cpu_num]; }
 #endif
 #else
 
@@ -79,9 +104,21 @@ static inline PerCPUState *state_get_for_any_cpu(uint8_t cpu_num) { return &__te
 
 #endif
 
-void state_register_cpu(uint8_t cpu_num, PerCPUState *state);
+/*
+ * Size the per-CPU state table for (at most) the given number of CPUs,
+ * as found at boot - capped at MAX_CPU_COUNT.
+ *
+ * Must be called once, before any CPU registers.
+ */
+bool state_init(uint16_t max_cpus);
+
+/*
+ * Returns false if the CPU number doesn't fit in the table.
+ */
+bool state_register_cpu(uint16_t cpu_num, PerCPUState *state);
 
-uint8_t state_get_cpu_count(void);
-PerCPUState *state_get_for_any_cpu(uint8_t cpu_num);
+uint16_t state_get_cpu_capacity(void);
+uint16_t state_get_cpu_count(void);
+PerCPUState *state_get_for_any_cpu(uint16_t cpu_num);
 
 #endif //__ANOS_SMP_STATE_H
@@ -53,6 +53,15 @@ void spinlock_init(SpinLock *lock);
  */
 void spinlock_lock(SpinLock *lock);
 
+/*
+ * Try to lock a spinlock, without waiting and without
+ * touching interrupts.
+ *
+ * Returns `true` if the lock was taken, `false` if it
+ * was already held.
+ */
+bool spinlock_try_lock(SpinLock *lock);
+
 /*
  * Lock a spinlock and disable interrupts.
  *
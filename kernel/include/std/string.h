@@ -17,4 +17,12 @@ void *memmove(void *dest, const void *src, size_t count);
 void *memset(void *dest, int val, size_t count);
 void *memclr(void *dest, size_t count);
 
+// Whole, page-aligned pages only
+void *memcpy_page(void *restrict dest, const void *restrict src);
+void *memclr_page(void *dest);
+
+// As memclr_page, but keeps the page out of the cache where the arch
+// can - for pages that won't be touched again soon (e.g. the zero pool)
+void *memclr_page_nt(void *dest);
+
 #endif //__ANOS_KERNEL_STD_STRING_H
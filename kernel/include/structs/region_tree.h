@@ -40,7 +40,8 @@ typedef struct Region {
     struct Region *right; // Right child (higher addresses)
     uint64_t height;      // AVL tree node height
 
-    uint64_t reserved[2];
+    uintptr_t fault_lo; // Last fault-around window (inclusive)
+    uintptr_t fault_hi; // Last fault-around window (exclusive)
 } Region;
 
 static_assert_sizeof(Region, ==, SLAB_BLOCK_SIZE);
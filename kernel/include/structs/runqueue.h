@@ -0,0 +1,54 @@
+/*
+ * stage3 - Constant-time run queue for tasks (in scheduler)
+ * anos - An Operating System
+ *
+ * Copyright (c) 2025 Ross Bamford
+ *
+ * One FIFO list per 8-bit priority level, with a 256-bit
+ * occupancy bitmap to find the first non-empty level, so
+ * push, pop and peek are all O(1).
+ *
+ * As with the TaskPriorityQueue, none of these routines
+ * allocate any memory or copy anything - the caller
+ * supplies the (page-sized) array of level lists.
+ */
+
+// clang-format Language: C
+
+#ifndef __ANOS_KERNEL_TASK_RUNQUEUE_H
+#define __ANOS_KERNEL_TASK_RUNQUEUE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "task.h"
+
+#define TASK_RQ_LEVELS ((256))
+#define TASK_RQ_BITMAP_WORDS ((TASK_RQ_LEVELS / 64))
+
+typedef struct {
+    Task *head;
+    Task *tail;
+} TaskRunList;
+
+#define TASK_RQ_LEVELS_BYTES ((TASK_RQ_LEVELS * sizeof(TaskRunList)))
+
+typedef struct {
+    uint64_t occupied[TASK_RQ_BITMAP_WORDS];
+    TaskRunList *levels; // TASK_RQ_LEVELS entries, caller-owned
+} TaskRunQueue;
+
+// levels must point to TASK_RQ_LEVELS_BYTES of storage (need not be zeroed)
+void task_rq_init(TaskRunQueue *rq, TaskRunList *levels);
+
+// Add to the back of the task's priority level
+void task_rq_push(TaskRunQueue *rq, Task *task);
+
+// Add to the front of the task's priority level
+void task_rq_push_front(TaskRunQueue *rq, Task *task);
+
+Task *task_rq_pop(TaskRunQueue *rq);
+Task *task_rq_peek(TaskRunQueue *rq);
+bool task_rq_empty(TaskRunQueue *rq);
+
+#endif //__ANOS_KERNEL_TASK_RUNQUEUE_H
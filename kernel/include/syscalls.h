@@ -49,6 +49,26 @@ typedef struct {
     uint64_t physical_avail;
 } AnosMemInfo;
 
+typedef struct {
+    uint64_t page_cache_alloc_hits;
+    uint64_t page_cache_alloc_misses;
+    uint64_t page_cache_free_hits;
+    uint64_t page_cache_free_misses;
+    uint64_t page_cache_pages;
+    uint64_t zero_pool_hits;
+    uint64_t zero_pool_misses;
+    uint64_t zero_pool_zeroed;
+    uint64_t zero_pool_pages;
+} AnosCpuMemStats;
+
+typedef struct {
+    uint64_t load; // Fixed-point, 1 << 8 is one queued task
+    uint64_t steals;
+    uint64_t migrations;
+    uint64_t contended;
+    uint64_t hot_skips;
+} AnosCpuSchedStats;
+
 typedef struct {
     uintptr_t physical_address;
     uint32_t width;
@@ -111,6 +131,13 @@ typedef enum {
     SYSCALL_ID_WAIT_INTERRUPT,
     SYSCALL_ID_READ_KERNEL_LOG,
     SYSCALL_ID_GET_FRAMEBUFFER_PHYS,
+    SYSCALL_ID_SEND_MESSAGE_ASYNC,
+    SYSCALL_ID_WAIT_REPLY,
+    SYSCALL_ID_CREATE_RING,
+    SYSCALL_ID_ATTACH_RING,
+    SYSCALL_ID_RING_WAIT,
+    SYSCALL_ID_RING_NOTIFY,
+    SYSCALL_ID_SCHED_STATS,
 
     // sentinel
     SYSCALL_ID_END,
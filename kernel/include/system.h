@@ -16,6 +16,6 @@
 void prepare_system(void);
 
 noreturn void start_system(void);
-noreturn void start_system_ap(uint8_t cpu_id);
+noreturn void start_system_ap(uint16_t cpu_id);
 
 #endif //__ANOS_KERNEL_SYSTEM_H
\ No newline at end of file
@@ -25,11 +25,11 @@
  * return address.
  */
 #if defined ARCH_X86_64
-#define TASK_SAVED_REGISTER_COUNT ((15))
+#define TASK_SAVED_REGISTER_COUNT ((8))
 #elif defined ARCH_RISCV64
 #define TASK_SAVED_REGISTER_COUNT ((54))
 #elif defined UNIT_TESTS
-#define TASK_SAVED_REGISTER_COUNT ((15))
+#define TASK_SAVED_REGISTER_COUNT ((8))
 #else
 #error TASK_SAVED_REGISTER_COUNT not defined for this architecture in task.h!
 #endif
@@ -59,21 +59,25 @@ typedef enum {
 #define TASK_SCHED_FLAG_DYING ((1 << 1))   // Task is actively dying, or is dead (see TaskState for confirmation)
 // clang-format on
 
-#define TASK_DATA_SIZE 2048
+// Arch-specific data - on x86_64, the FPU / SIMD save area (which
+// must be 64-byte aligned, so mind the offset if moving it...)
+#define TASK_DATA_SIZE 3072
 
 /**
  * Task scheduler data - Stuff not needed in best-case fast
  * path (e.g. syscalls).
  */
 typedef struct {
-    uintptr_t tid;         // 8
-    uint16_t ts_remain;    // 10
-    TaskState state;       // 11
-    TaskClass class;       // 12
-    uint8_t prio;          // 13
-    uint16_t status_flags; // 15
-    uint8_t res2;          // 16
-    uint64_t reserved[6];
+    uintptr_t tid;              // 8
+    uint16_t ts_remain;         // 10
+    TaskState state;            // 11
+    TaskClass class;            // 12
+    uint8_t prio;               // 13
+    uint16_t status_flags;      // 15
+    uint8_t res2;               // 16
+    uint64_t last_run;          // 24 - upticks when last switched out
+    struct Task *deferred_next; // 32 - next in a CPU's deferred wakeups (see sched_unblock_remote)
+    uint64_t reserved[4];
 } __attribute__((packed)) TaskSched;
 
 /*
@@ -95,8 +99,7 @@ typedef struct Task {
 
     TaskSched ssched;              // 128
     uint64_t reserved0[112];       // 1024
-    uint8_t sdata[TASK_DATA_SIZE]; // 3072
-    uint64_t reserved1[128];       // 4096
+    uint8_t sdata[TASK_DATA_SIZE]; // 4096
 } __attribute__((packed)) Task;
 
 static_assert_sizeof(Task, ==, 4096);
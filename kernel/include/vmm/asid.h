@@ -0,0 +1,157 @@
+/*
+ * stage3 - Address space IDs
+ * anos - An Operating System
+ *
+ * Copyright (c) 2025 Ross Bamford
+ *
+ * Tags each CPU's TLB entries with the address space they came from
+ * (PCIDs on x86_64, ASIDs in satp on RISC-V) so switching between
+ * processes doesn't have to throw them all away.
+ *
+ * Each CPU hands out ASIDs in order, one per process that runs there,
+ * and doesn't give any out twice - so a process getting a new one never
+ * has anything to flush. When they run out that's a new generation:
+ * everything is flushed once and they start again from the bottom.
+ * Which process has which is kept in a small hash table per CPU, out
+ * of line in its own FBA block. A process that drops out of that just
+ * gets a fresh ASID next time.
+ *
+ * Entries survive while a process isn't loaded, so shootdowns can't
+ * just go to the CPUs that have it loaded any more. Instead, anything
+ * that changes a process' mappings marks it stale everywhere else, and
+ * each CPU flushes its ASID the next time it switches to it.
+ *
+ * Kernel pages are global (in every address space, whatever the ASID)
+ * so they're never flushed by a switch at all - changes to those are
+ * shot down on every other CPU instead, once the mapper has let go of
+ * the kernel tables. Invalidating a global page by address takes it
+ * out whatever's loaded, so that's just the pages that changed.
+ */
+
+// clang-format Language: C
+
+#ifndef __ANOS_KERNEL_VMM_ASID_H
+#define __ANOS_KERNEL_VMM_ASID_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "anos_assert.h"
+#include "vmm/vmconfig.h"
+
+typedef struct Process Process;
+
+// Most ASIDs a CPU will use (the most x86_64 has) - ASID 0 is never handed out, it's for "none"
+#define ASID_MAX ((4095))
+
+// How far along the table a process is looked for, from where its PID hashes to
+#define ASID_TABLE_PROBE ((8))
+
+typedef struct {
+    uint64_t pid;    // 8 - 0 for none
+    uint16_t asid;   // 10
+    uint8_t res0[6]; // 16
+} AsidTableEntry;
+
+static_assert_sizeof(AsidTableEntry, ==, 16);
+
+#define ASID_TABLE_ENTRIES ((VM_PAGE_SIZE / sizeof(AsidTableEntry)))
+
+// Which process has which ASID this generation - one FBA block
+typedef struct {
+    AsidTableEntry entries[ASID_TABLE_ENTRIES];
+} PerCPUAsidTable;
+
+static_assert_sizeof(PerCPUAsidTable, ==, VM_PAGE_SIZE);
+
+typedef struct {
+    PerCPUAsidTable *table; // 8 - NULL if this CPU has no ASIDs
+    uintptr_t loaded_root;  // 16 - page table register value (without ASID) loaded right now
+    uint16_t max_asid;      // 18 - highest ASID this CPU can use, 0 if it has none
+    uint16_t next_asid;     // 20 - next one never handed out this generation
+    uint16_t loaded_asid;   // 22 - ASID loaded right now, 0 for none
+    uint16_t reserved0;     // 24
+    uint32_t generation;    // 28 - times this CPU has run out of ASIDs and flushed everything
+    uint32_t reserved1;     // 32
+    uint64_t reserved2[4];  // 64
+} PerCPUAsidState;
+
+static_assert_sizeof(PerCPUAsidState, ==, 64);
+
+/*
+ * Set up ASIDs (and global kernel pages) on this CPU.
+ *
+ * Per-CPU state must be registered already, and the FBA up. If the
+ * table can't be allocated, this CPU does without ASIDs.
+ */
+void asid_init_this_cpu(void);
+
+/*
+ * Load the given process' page tables on this CPU, with its ASID if
+ * it has (or can get) one. It's only flushed if it has to be.
+ *
+ * `pagetable_root` is the value for the page table register, as in
+ * the Process (or Task) - `process` may be NULL if there isn't one,
+ * in which case that's loaded without an ASID.
+ *
+ * Must be called with interrupts disabled, after this CPU's bit is set
+ * in the process' `cpu_mask`.
+ */
+void asid_switch_to(const Process *process, uintptr_t pagetable_root);
+
+/*
+ * The given process' mappings have changed in [virt_addr, virt_addr +
+ * num_pages) - other CPUs that might still have the old ones cached must
+ * drop them before next using its ASID.
+ *
+ * If it's loaded on this CPU, the caller has already invalidated them
+ * here. Otherwise, this takes care of that as well.
+ *
+ * Shootdowns call this *before* looking at `cpu_mask`, it pairs with
+ * asid_switch_to.
+ */
+void asid_invalidate_process(const Process *process, uintptr_t virt_addr, size_t num_pages);
+
+/*
+ * A present mapping at the given address in the current address space
+ * has changed or gone away, and has been invalidated on this CPU.
+ *
+ * User addresses mark the current process (if there is one) stale
+ * everywhere else, just as above. Kernel addresses are global, so they're
+ * kept for asid_take_kernel_pages to hand back to the mapper (other than
+ * the per-CPU temp pages, which only their own CPU ever uses).
+ *
+ * Must be called with the tables for the address locked.
+ */
+void asid_invalidate_mapping(uintptr_t virt_addr);
+
+/*
+ * Take the range of kernel pages asid_invalidate_mapping has kept since
+ * last time, if there are any. The caller shoots those down on every other
+ * CPU (see vmm/shootdown.h) - once it's let go of the kernel tables, so
+ * nothing's waiting on it while it waits for them.
+ *
+ * Must be called with the kernel tables locked.
+ */
+bool asid_take_kernel_pages(uintptr_t *virt_addr, size_t *num_pages);
+
+/*
+ * Some address space other than the one loaded here has changed, but we
+ * don't know which process it belongs to - forget every ASID this CPU has
+ * handed out (except the loaded one). They won't be handed out again
+ * until the next generation, so whatever's left under them never gets used.
+ *
+ * Must be called with interrupts disabled.
+ */
+void asid_forget_this_cpu(void);
+
+/*
+ * Flush everything cached on this CPU - global kernel pages, and every
+ * ASID's entries (so none of them need forgetting).
+ *
+ * Must be called with interrupts disabled.
+ */
+void asid_flush_all_this_cpu(void);
+
+#endif //__ANOS_KERNEL_VMM_ASID_H
@@ -63,4 +63,16 @@ uintptr_t vmm_shootdown_unmap_pages_in_pml4(uint64_t *pml4_virt, uintptr_t virt_
 
 uintptr_t vmm_shootdown_unmap_pages(uintptr_t virt_addr, size_t num_pages);
 
+/*
+ * Kernel pages in [virt_addr, virt_addr + num_pages) have already changed
+ * (and been invalidated on this CPU) - drop them on every other CPU too.
+ *
+ * They're global, so this works whatever each CPU has loaded. The mapper
+ * calls this itself (see asid_take_kernel_pages), so there are no map/unmap
+ * wrappers for these.
+ *
+ * Must be called with interrupts disabled.
+ */
+void vmm_shootdown_kernel_pages(uintptr_t virt_addr, size_t num_pages);
+
 #endif //__ANOS_KERNEL_VM_SHOOTDOWN_H
@@ -107,6 +107,9 @@ bool vmm_map_page_containing_in(uint64_t *pml4, uintptr_t virt_addr, uint64_t ph
  * which means it needs to allocate physical pages - it uses the PMM
  * (obviously) and thus it **can** pagefault.
  *
+ * Wherever both addresses are suitably aligned, large pages are used
+ * rather than filling in whole tables of small ones.
+ *
  * This function invalidates the local TLB automatically.
  */
 bool vmm_map_pages_containing_in(uint64_t *pml4, uintptr_t virt_addr, uint64_t phys_addr, uint16_t flags,
@@ -147,6 +150,42 @@ bool vmm_map_pages_in(uint64_t *pml4, uintptr_t virt_addr, uint64_t page, uint16
  */
 bool vmm_map_pages(uintptr_t virt_addr, uint64_t page, uint16_t flags, size_t num_pages);
 
+/*
+ * Map the given physical pages (which needn't be contiguous) into
+ * consecutive virtual pages starting at the page containing the given
+ * virtual address, with the specified page tables, all under a single
+ * lock hold.
+ *
+ * Virtual pages that already have something mapped are skipped. Each
+ * entry in `pages` that gets used is set to zero, so whatever is left
+ * afterwards still belongs to the caller.
+ *
+ * Returns the number of pages mapped.
+ *
+ * This function invalidates the local TLB automatically.
+ */
+size_t vmm_fill_pages_in(uint64_t *pml4, uintptr_t virt_addr, uintptr_t *pages, uint16_t flags, size_t num_pages);
+
+/*
+ * Map a single large page (2MiB at PT_LEVEL_PD, or 1GiB at PT_LEVEL_PDPT)
+ * at the given virtual address, with the specified page tables.
+ *
+ * Both addresses must be aligned to the size of the page. A large page
+ * that's already there is replaced, but if smaller pages are mapped
+ * anywhere in the range this fails and leaves them alone.
+ *
+ * This function invalidates the local TLB automatically.
+ */
+bool vmm_map_large_page_in(uint64_t *pml4, uintptr_t virt_addr, uint64_t phys_addr, uint16_t flags,
+                           PagetableLevel level);
+
+/*
+ * Returns true if nothing at all is mapped in the large page (at the
+ * given level) containing the given virtual address, in the specified
+ * page tables.
+ */
+bool vmm_can_map_large_page_in(const uint64_t *pml4, uintptr_t virt_addr, PagetableLevel level);
+
 /*
  * Unmap the given virtual page from virtual memory with the current
  * page tables.
@@ -203,6 +242,10 @@ uintptr_t vmm_unmap_page_in(uint64_t *pml4, uintptr_t virt_addr);
  * This is a "hard" unmap - it will zero out the PTE (rather than, say,
  * setting the page not present) and invalidate the TLB automatically.
  *
+ * Large pages wholly inside the area are removed in one go. Ones that
+ * are only partly covered (here and in the other unmap functions) are
+ * split first, so the rest of them stays mapped.
+ *
  * This function does **not** free any physical memory or otherwise
  * compact the page tables, as doing this on every unmap would be
  * expensive and unnecessary.
@@ -220,6 +263,13 @@ uintptr_t vmm_unmap_pages_in(uint64_t *pml4, uintptr_t virt_addr, size_t num_pag
  */
 void vmm_invalidate_page(uintptr_t virt_addr);
 
+/*
+ * Invalidate the whole (non-global) TLB on this CPU.
+ *
+ * Cheaper than invalidating a large range one page at a time.
+ */
+void vmm_invalidate_all(void);
+
 /*
  * Get the physical address of the current root pagetable.
  */
@@ -229,9 +279,15 @@ uintptr_t vmm_get_pagetable_root_phys();
  * Get the PT entry (including flags) for the given virtual address,
  * or 0 if not mapped in the _current process_ direct mapping.
  *
- * This **only** works for 4KiB pages (and only with SV48) -
- * large pages will not work with this (and that's by design!)
+ * If it's in a large page, this is the 4KiB entry that would map
+ * the same page (and only with SV48 on RISC-V).
  */
 uint64_t vmm_virt_to_pt_entry(uintptr_t virt_addr);
 
+/*
+ * As vmm_virt_to_pt_entry, but also sets `level` to the level the leaf
+ * was found at (PT_LEVEL_PT unless it's in a large page).
+ */
+uint64_t vmm_virt_to_pt_entry_and_level(uintptr_t virt_addr, PagetableLevel *level);
+
 #endif //__ANOS_KERNEL_VM_MAPPER_H
@@ -16,6 +16,18 @@
 
 // Region flags
 #define VM_REGION_AUTOMAP ((0x01))
+#define VM_REGION_POPULATE ((0x02)) // Fault in the whole region up front (automap only)
+
+// Fault-around policy, also in the flags. Automap write faults that carry on
+// sequentially (up or down) from the last one map a window twice the size of
+// the last, up to 1 << n pages. The default is used when it isn't set.
+#define VM_REGION_FAULT_AROUND_SHIFT ((8))
+#define VM_REGION_FAULT_AROUND_MASK ((0xf00))
+#define VM_REGION_FAULT_AROUND(log2_pages) ((((log2_pages) + 1) << VM_REGION_FAULT_AROUND_SHIFT))
+#define VM_REGION_FAULT_AROUND_OFF VM_REGION_FAULT_AROUND(0)
+
+#define VM_REGION_FAULT_AROUND_DEFAULT ((4)) // 16 pages
+#define VM_REGION_FAULT_AROUND_LIMIT ((9))   // A whole page table
 
 static inline Region *vm_region_find_in_process(const Process *process, const uintptr_t vaddr) {
     return region_tree_lookup(process->meminfo->regions, vaddr);
@@ -25,4 +37,36 @@ static inline Region *vm_region_find_in_current_process(const uintptr_t vaddr) {
     return region_tree_lookup(task_current()->owner->meminfo->regions, vaddr);
 }
 
+/*
+ * Back every page in [start, end) of the region that isn't already
+ * mapped with fresh zeroed memory, in the current process' page tables.
+ * Uses large pages where they fit.
+ *
+ * Returns false if memory ran out part-way.
+ */
+bool vm_region_populate(Process *process, const Region *region, uintptr_t start, uintptr_t end);
+
+/*
+ * Handle a write fault on an unmapped page in an automap region, by
+ * backing it (and, per the region's fault-around policy, some of the
+ * pages after or before it) with fresh zeroed memory.
+ *
+ * Returns true if the faulting page is now mapped.
+ */
+bool vm_region_fault_around(Process *process, Region *region, uintptr_t fault_page);
+
+#ifndef NO_LARGE_PAGES
+/*
+ * Returns true if the (aligned) large page is all inside the region,
+ * with nothing in it mapped yet.
+ */
+bool vm_region_large_page_fits(const Region *region, uintptr_t large_base);
+
+/*
+ * Back the (aligned) large page with fresh zeroed memory, if we can get
+ * a block for it. If not, the caller should fall back to small pages.
+ */
+bool vm_region_map_new_large_page(Process *process, uintptr_t large_base, uint16_t flags);
+#endif
+
 #endif //__ANOS_KERNEL_VM_REGION_H
\ No newline at end of file
@@ -11,15 +11,21 @@
 
 #include "anos_assert.h"
 #include "capabilities/cookies.h"
+#include "fba/alloc.h"
+#include "managed_resources/resources.h"
 #include "once.h"
 #include "panic.h"
+#include "pmm/pagealloc.h"
+#include "process.h"
 #include "sched.h"
 #include "slab/alloc.h"
 #include "std/string.h"
 #include "structs/hash.h"
 #include "structs/list.h"
 #include "task.h"
+#include "vmm/shootdown.h"
 #include "vmm/vmmapper.h"
+#include "vmm/vmregion.h"
 
 #include "ipc/channel_internal.h"
 
@@ -33,7 +39,9 @@
 
 #define INITIAL_CHANNEL_HASH_PAGE_COUNT ((4))
 #define INITIAL_IN_FLIGHT_MESSAGE_HASH_PAGE_COUNT ((1))
-#define ARG_BUF_MAX ((0x1000))
+#define ARG_BUF_MAX ((IPC_BUFFER_MAX_PAGES * VM_PAGE_SIZE))
+#define ARG_BUF_PAGE_FLAGS ((PG_USER | PG_READ | PG_WRITE | PG_PRESENT))
+#define ASYNC_MAX_OUTSTANDING ((64))
 
 #ifdef UNIT_TESTS
 #define STATIC_EXCEPT_TESTS
@@ -42,6 +50,8 @@
 #define STATIC_EXCEPT_TESTS static
 #endif
 
+extern MemoryRegion *physical_region;
+
 STATIC_EXCEPT_TESTS HashTable *channel_hash;
 STATIC_EXCEPT_TESTS HashTable *in_flight_message_hash;
 
@@ -101,6 +111,155 @@ uint64_t ipc_channel_create(void) {
     return cookie;
 }
 
+static void free_message(IpcMessage *msg) {
+    if (msg->multi_page) {
+        IpcBufferPages *buf_pages = (IpcBufferPages *)msg->arg_buf_phys;
+
+        if (msg->owns_pages) {
+            for (uint64_t i = 0; i < buf_pages->page_count; i++) {
+                page_free(physical_region, buf_pages->pages[i]);
+            }
+        }
+
+        fba_free(buf_pages);
+    }
+
+    slab_free(msg);
+}
+
+static inline void free_completions(IpcCompletions *completions) {
+    slab_free(completions->lock);
+    slab_free(completions);
+}
+
+/*
+ * Called when the owning process is destroyed. Anything that's still
+ * queued or in flight will complete at some point, so if there is any
+ * the completions are just orphaned, and the last one frees them.
+ */
+static void free_completions_resource(ManagedResource *resource) {
+    IpcCompletions *completions = resource->resource_ptr;
+    slab_free(resource);
+
+    spinlock_lock(completions->lock);
+
+    IpcMessage *msg = completions->head;
+    while (msg) {
+        IpcMessage *next = (IpcMessage *)msg->this.next;
+        free_message(msg);
+        completions->outstanding--;
+        msg = next;
+    }
+
+    completions->head = completions->tail = NULL;
+    completions->orphaned = true;
+
+    const bool done = completions->outstanding == 0;
+    spinlock_unlock(completions->lock);
+
+    if (done) {
+        free_completions(completions);
+    }
+}
+
+static IpcCompletions *get_completions(Process *process) {
+    IpcCompletions *completions = __atomic_load_n(&process->ipc_completions, __ATOMIC_ACQUIRE);
+
+    if (completions) {
+        return completions;
+    }
+
+    completions = slab_alloc_block();
+    SpinLock *lock = slab_alloc_block();
+    ManagedResource *resource = slab_alloc_block();
+
+    if (!completions || !lock || !resource) {
+        goto fail;
+    }
+
+    spinlock_init(lock);
+    completions->lock = lock;
+    completions->head = completions->tail = NULL;
+    completions->waiters = NULL;
+    completions->outstanding = 0;
+    completions->orphaned = false;
+
+    IpcCompletions *expected = NULL;
+    if (!__atomic_compare_exchange_n(&process->ipc_completions, &expected, completions, false, __ATOMIC_ACQ_REL,
+                                     __ATOMIC_ACQUIRE)) {
+        // Another thread beat us to it
+        slab_free(resource);
+        free_completions(completions);
+        return expected;
+    }
+
+    resource->free_func = free_completions_resource;
+    resource->resource_ptr = completions;
+    process_add_managed_resource(process, resource);
+
+    return completions;
+
+fail:
+    if (resource) {
+        slab_free(resource);
+    }
+    if (lock) {
+        slab_free(lock);
+    }
+    if (completions) {
+        slab_free(completions);
+    }
+    return NULL;
+}
+
+/*
+ * Hand a replied-to (or abandoned) async message back to the sending
+ * process, and wake anyone waiting there so they can look for it.
+ */
+static void complete_async_message(IpcMessage *msg) {
+    IpcCompletions *completions = msg->completions;
+
+    spinlock_lock(completions->lock);
+
+    if (completions->orphaned) {
+        const bool done = --completions->outstanding == 0;
+        spinlock_unlock(completions->lock);
+
+        free_message(msg);
+        if (done) {
+            free_completions(completions);
+        }
+        return;
+    }
+
+    msg->this.next = NULL;
+
+    if (completions->tail) {
+        completions->tail->this.next = (ListNode *)msg;
+    } else {
+        completions->head = msg;
+    }
+
+    completions->tail = msg;
+
+    Task *waiter = completions->waiters;
+    completions->waiters = NULL;
+
+    spinlock_unlock(completions->lock);
+
+    if (waiter) {
+        const uint64_t lock_flags = sched_lock_this_cpu();
+
+        while (waiter) {
+            Task *next = (Task *)waiter->this.next;
+            sched_unblock(waiter);
+            waiter = next;
+        }
+
+        sched_unlock_this_cpu(lock_flags);
+    }
+}
+
 void ipc_channel_destroy(uint64_t cookie) {
     // I know this _feels_ like it needs a lock, but the hash locks,
     // so this remove is atomic from the POV of users of the channel...
@@ -116,25 +275,28 @@ void ipc_channel_destroy(uint64_t cookie) {
         // be unblocking multiple at once here and don't want them all
         // fighting for this CPU...
         //
-        // But that does mean they won't get a chance at scheduling
-        // until the next sched on their target CPUs - because we
-        // don't yet have a mechanism in place to signal other CPUs
-        // they should run a schedule ASAP...
+        // sched_unblock_on will kick the target CPU with a reschedule
+        // IPI if the waiter should preempt whatever it's running, so
+        // they don't have to wait for its next tick...
         //
-        // TODO don't forget to come back and fix this comment when
-        // we **do** have such a mechanism in place :D
+        // Async senders aren't blocked, their messages just complete
+        // unhandled (and may be freed as soon as they do, so we grab
+        // next first).
         //
         IpcMessage *queued = channel->queue;
         while (queued) {
-            if (!queued->waiter) {
-                continue;
+            IpcMessage *next = (IpcMessage *)queued->this.next;
+
+            if (queued->async) {
+                complete_async_message(queued);
+            } else if (queued->waiter) {
+                PerCPUState *target_cpu = sched_find_target_cpu();
+                uint64_t lock_flags = sched_lock_any_cpu(target_cpu);
+                sched_unblock_on(queued->waiter, target_cpu);
+                sched_unlock_any_cpu(target_cpu, lock_flags);
             }
 
-            PerCPUState *target_cpu = sched_find_target_cpu();
-            uint64_t lock_flags = sched_lock_any_cpu(target_cpu);
-            sched_unblock_on(queued->waiter, target_cpu);
-            sched_unlock_any_cpu(target_cpu, lock_flags);
-            queued = (IpcMessage *)queued->this.next;
+            queued = next;
         }
 
         // Now, same deal for receivers, they'll need a wakeup
@@ -142,13 +304,19 @@ void ipc_channel_destroy(uint64_t cookie) {
         // rather than because there's a message, because the first
         // thing they do on wake is check if the channel still exists...
         //
+        // Unblocking puts them on a run queue, which reuses their
+        // list node - so again, grab next first.
+        //
         Task *blocked_receiver = channel->receivers;
         while (blocked_receiver) {
+            Task *next = (Task *)blocked_receiver->this.next;
+
             PerCPUState *target_cpu = sched_find_target_cpu();
             uint64_t lock_flags = sched_lock_any_cpu(target_cpu);
             sched_unblock_on(blocked_receiver, target_cpu);
             sched_unlock_any_cpu(target_cpu, lock_flags);
-            blocked_receiver = (Task *)blocked_receiver->this.next;
+
+            blocked_receiver = next;
         }
 
         // Okay, we're done, we should be good to free the channel now.
@@ -163,10 +331,104 @@ void ipc_channel_destroy(uint64_t cookie) {
     }
 }
 
+/*
+ * Wake `task` and give it this CPU. Synchronous IPC always has
+ * the other side of the conversation waiting for us, so the fast
+ * path is to switch straight to it (see sched_handoff).
+ *
+ * Must be called with this CPU's scheduler locked.
+ */
+static inline void wake_and_switch_to(Task *task) {
+#ifdef NO_IPC_HANDOFF
+    sched_unblock(task);
+    sched_schedule();
+#else
+    sched_handoff(task);
+#endif
+}
+
 static inline unsigned int round_up_to_page_size(size_t size) {
     return (size + VM_PAGE_SIZE - 1) & ~(VM_PAGE_SIZE - 1);
 }
 
+/*
+ * Map a multi-page buffer into the current process at `base`, a
+ * physically-contiguous run at a time.
+ *
+ * The first page is treated just like a single-page buffer - it's
+ * mapped over whatever is there. The rest only go as far as the
+ * receiver said it has room for (`capacity` bytes), and only into
+ * pages that are neither mapped nor part of one of its regions. The
+ * buffer is truncated to fit.
+ */
+static size_t map_buffer_pages(IpcMessage *msg, const uintptr_t base, const size_t capacity) {
+    IpcBufferPages *buf_pages = (IpcBufferPages *)msg->arg_buf_phys;
+    Process *receiver = task_current()->owner;
+
+    const uint64_t room = (capacity > ARG_BUF_MAX ? ARG_BUF_MAX : round_up_to_page_size(capacity)) >>
+                          VM_PAGE_LINEAR_SHIFT;
+    const uint64_t limit = room < buf_pages->page_count ? room : buf_pages->page_count;
+
+    uint64_t available = 1;
+    while (available < limit) {
+        const uintptr_t target = base + available * VM_PAGE_SIZE;
+
+        if (!IS_USER_ADDRESS(target) || vmm_virt_to_phys_page(target) || vm_region_find_in_process(receiver, target)) {
+            break;
+        }
+
+        available++;
+    }
+
+    uint64_t mapped = 0;
+    while (mapped < available) {
+        const uintptr_t run_start = buf_pages->pages[mapped];
+        uint64_t run_length = 1;
+
+        while (mapped + run_length < available &&
+               buf_pages->pages[mapped + run_length] == run_start + run_length * VM_PAGE_SIZE) {
+            run_length++;
+        }
+
+        vmm_map_pages(base + mapped * VM_PAGE_SIZE, run_start, ARG_BUF_PAGE_FLAGS, run_length);
+        mapped += run_length;
+    }
+
+    buf_pages->receiver = receiver;
+    buf_pages->recv_vaddr = base;
+    buf_pages->mapped_pages = mapped;
+
+    return mapped * VM_PAGE_SIZE;
+}
+
+/*
+ * Map the message buffer (if any) at `buffer` in the receiver, and
+ * return the size the receiver should see. `capacity` is how much
+ * room the receiver says it has there - whole pages are mapped, but
+ * the size never goes past it.
+ */
+static size_t map_message_buffer(IpcMessage *msg, void *buffer, const size_t capacity) {
+    size_t size = msg->arg_buf_size;
+
+    if (msg->multi_page) {
+        if (!buffer) {
+            return size;
+        }
+
+        const size_t mapped_size = map_buffer_pages(msg, (uintptr_t)buffer, capacity);
+
+        if (mapped_size < size) {
+            size = mapped_size;
+        }
+    } else if (buffer && msg->arg_buf_phys && msg->arg_buf_size) {
+        vmm_map_page((uintptr_t)buffer, msg->arg_buf_phys, ARG_BUF_PAGE_FLAGS);
+    } else {
+        msg->arg_buf_phys = 0;
+    }
+
+    return capacity && capacity < size ? capacity : size;
+}
+
 uint64_t ipc_channel_recv(uint64_t cookie, uint64_t *tag, size_t *buffer_size, void *buffer) {
     if ((uintptr_t)buffer & PAGE_RELATIVE_MASK) {
         // buffer must be page aligned
@@ -199,14 +461,10 @@ uint64_t ipc_channel_recv(uint64_t cookie, uint64_t *tag, size_t *buffer_size, v
                 *tag = msg->tag;
             }
 
-            if (buffer && msg->arg_buf_phys && msg->arg_buf_size) {
-                vmm_map_page((uintptr_t)buffer, (uint64_t)msg->arg_buf_phys, PG_USER | PG_READ | PG_WRITE | PG_PRESENT);
-            } else {
-                msg->arg_buf_phys = 0;
-            }
+            const size_t mapped_size = map_message_buffer(msg, buffer, buffer_size ? *buffer_size : 0);
 
             if (buffer_size) {
-                *buffer_size = msg->arg_buf_size;
+                *buffer_size = mapped_size;
             }
 
             return msg->cookie;
@@ -266,14 +524,10 @@ uint64_t ipc_channel_recv(uint64_t cookie, uint64_t *tag, size_t *buffer_size, v
                 *tag = msg->tag;
             }
 
-            if (buffer && msg->arg_buf_phys && msg->arg_buf_size) {
-                vmm_map_page((uintptr_t)buffer, msg->arg_buf_phys, PG_USER | PG_READ | PG_WRITE | PG_PRESENT);
-            } else {
-                msg->arg_buf_phys = 0;
-            }
+            const size_t mapped_size = map_message_buffer(msg, buffer, buffer_size ? *buffer_size : 0);
 
             if (buffer_size) {
-                *buffer_size = msg->arg_buf_size;
+                *buffer_size = mapped_size;
             }
 
             return msg->cookie;
@@ -286,10 +540,99 @@ uint64_t ipc_channel_recv(uint64_t cookie, uint64_t *tag, size_t *buffer_size, v
     return 0;
 }
 
-static bool init_message(IpcMessage *message, uint64_t tag, size_t size, void *buffer, Task *current_task) {
+/*
+ * Gather the physical pages behind a multi-page send buffer. They all
+ * have to be there already - we're not going to fault them in for
+ * the sender.
+ */
+static IpcBufferPages *gather_buffer_pages(const uintptr_t buffer, const size_t size) {
+    IpcBufferPages *buf_pages = fba_alloc_block();
 
-    if (size > VM_PAGE_SIZE) {
-        size = VM_PAGE_SIZE;
+    if (!buf_pages) {
+        return NULL;
+    }
+
+    buf_pages->receiver = NULL;
+    buf_pages->recv_vaddr = 0;
+    buf_pages->mapped_pages = 0;
+    buf_pages->page_count = round_up_to_page_size(size) >> VM_PAGE_LINEAR_SHIFT;
+
+    for (uint64_t i = 0; i < buf_pages->page_count; i++) {
+        const uintptr_t phys = vmm_virt_to_phys_page(buffer + i * VM_PAGE_SIZE);
+
+        if (!phys) {
+            fba_free(buf_pages);
+            return NULL;
+        }
+
+        buf_pages->pages[i] = phys;
+    }
+
+    return buf_pages;
+}
+
+/*
+ * Async senders don't wait for the reply, so are free to unmap or reuse
+ * their buffer as soon as the send returns. Rather than lend the receiver
+ * the sender's pages, copy them into pages the message owns.
+ *
+ * These are always tracked as IpcBufferPages (even if there's only one
+ * page) so they can all be unmapped from the receiver again on reply.
+ */
+static IpcBufferPages *copy_buffer_pages(const uintptr_t buffer, const size_t size) {
+    IpcBufferPages *buf_pages = gather_buffer_pages(buffer, size);
+
+    if (!buf_pages) {
+        return NULL;
+    }
+
+    for (uint64_t i = 0; i < buf_pages->page_count; i++) {
+        const uintptr_t copy = page_alloc(physical_region);
+
+        if (copy & 0xff) {
+            for (uint64_t j = 0; j < i; j++) {
+                page_free(physical_region, buf_pages->pages[j]);
+            }
+
+            fba_free(buf_pages);
+            return NULL;
+        }
+
+        // Whole pages, straight from the physical side - the sender's
+        // mapping could be gone by the time it'd fault...
+        memcpy(vmm_phys_to_virt_ptr(copy), vmm_phys_to_virt_ptr(buf_pages->pages[i]), VM_PAGE_SIZE);
+        buf_pages->pages[i] = copy;
+    }
+
+    return buf_pages;
+}
+
+static bool init_message(IpcMessage *message, uint64_t tag, size_t size, void *buffer, Task *current_task,
+                         bool async) {
+    message->owns_pages = false;
+
+    if (async && buffer && size) {
+        IpcBufferPages *buf_pages = copy_buffer_pages((uintptr_t)buffer, size);
+
+        if (!buf_pages) {
+            return false;
+        }
+
+        message->arg_buf_phys = (uintptr_t)buf_pages;
+        message->multi_page = true;
+        message->owns_pages = true;
+    } else if (size > VM_PAGE_SIZE) {
+        IpcBufferPages *buf_pages = gather_buffer_pages((uintptr_t)buffer, size);
+
+        if (!buf_pages) {
+            return false;
+        }
+
+        message->arg_buf_phys = (uintptr_t)buf_pages;
+        message->multi_page = true;
+    } else {
+        message->arg_buf_phys = vmm_virt_to_phys_page((uintptr_t)buffer);
+        message->multi_page = false;
     }
 
     uint64_t cookie = capability_cookie_generate();
@@ -298,22 +641,33 @@ static bool init_message(IpcMessage *message, uint64_t tag, size_t size, void *b
     message->tag = tag;
     message->cookie = cookie;
     message->arg_buf_size = size;
-    message->arg_buf_phys = vmm_virt_to_phys_page((uintptr_t)buffer);
     message->waiter = current_task;
     message->reply = 0;
     message->handled = false;
+    message->async = async;
 
     return true;
 }
 
+static void enqueue_message(IpcChannel *channel, IpcMessage *message) {
+    spinlock_lock(channel->queue_lock);
+
+    if (channel->queue) {
+        list_add((ListNode *)channel->queue, (ListNode *)message);
+    } else {
+        channel->queue = message;
+    }
+
+    spinlock_unlock(channel->queue_lock);
+}
+
 uint64_t ipc_channel_send(uint64_t channel_cookie, uint64_t tag, size_t size, void *buffer) {
     if ((uintptr_t)buffer & PAGE_RELATIVE_MASK) {
         // buffer must be page aligned
         return 0;
     }
 
-    if (size > VM_PAGE_SIZE) {
-        // Buffer can only be one page for now
+    if (size > ARG_BUF_MAX) {
         return 0;
     }
 
@@ -327,37 +681,33 @@ uint64_t ipc_channel_send(uint64_t channel_cookie, uint64_t tag, size_t size, vo
             return 0;
         }
 
-        if (!init_message(message, tag, size, buffer, current_task)) {
+        if (!init_message(message, tag, size, buffer, current_task, false)) {
+            slab_free(message);
             return 0;
         }
 
-        spinlock_lock(channel->queue_lock);
-
-        if (channel->queue) {
-            list_add((ListNode *)channel->queue, (ListNode *)message);
-        } else {
-            channel->queue = message;
-        }
-
-        spinlock_unlock(channel->queue_lock);
+        enqueue_message(channel, message);
 
         spinlock_lock(channel->receivers_lock);
         const uint64_t lock_flags = sched_lock_this_cpu();
-        if (channel->receivers) {
-            // unblock first receiver
-            Task *receiver = channel->receivers;
+
+        Task *receiver = channel->receivers;
+        if (receiver) {
             channel->receivers = (Task *)receiver->this.next;
+        }
 
-            // Do this now so we're not holding it while we requeue the receiver...
-            spinlock_unlock(channel->receivers_lock);
-            sched_unblock(receiver);
+        // Don't hold this while we switch...
+        spinlock_unlock(channel->receivers_lock);
+
+        sched_block(current_task);
+
+        if (receiver) {
+            // Receiver is blocked waiting, it'll pick the message up when it wakes
+            wake_and_switch_to(receiver);
         } else {
-            // ... or just do this (in else, since we did it in the branch above too)
-            spinlock_unlock(channel->receivers_lock);
+            sched_schedule();
         }
 
-        sched_block(current_task);
-        sched_schedule();
         sched_unlock_this_cpu(lock_flags);
 
         const uint64_t result = message->reply;
@@ -375,15 +725,16 @@ uint64_t ipc_channel_send(uint64_t channel_cookie, uint64_t tag, size_t size, vo
         }
 #endif
 
-        if (message->arg_buf_phys) {
+        if (message->arg_buf_phys && !message->multi_page) {
             // TODO Not sure why I'm doing this, I suspect it's a bug.
             // why would the phys be mapped virtual?
             //
             // I _think_ I'm wanting to unmap in the _receiving_ process,
-            // which means this would need to (somehow) be done in reply, below...
+            // which means this would need to (somehow) be done in reply, below
+            // (which is where multi-page buffers do get unmapped)...
             vmm_unmap_page(message->arg_buf_phys);
         }
-        slab_free(message);
+        free_message(message);
         return result;
     }
 
@@ -399,12 +750,174 @@ uint64_t ipc_channel_reply(uint64_t message_cookie, uint64_t result) {
 
     hash_table_remove(in_flight_message_hash, message_cookie);
 
+    if (msg->multi_page) {
+        IpcBufferPages *buf_pages = (IpcBufferPages *)msg->arg_buf_phys;
+
+        // First page stays, like a single-page buffer would (see map_buffer_pages),
+        // unless it's a copy that'll be freed along with the message
+        const uint64_t kept_pages = msg->owns_pages ? 0 : 1;
+
+        if (buf_pages->mapped_pages > kept_pages) {
+            vmm_shootdown_unmap_pages_in_process(buf_pages->receiver,
+                                                 buf_pages->recv_vaddr + kept_pages * VM_PAGE_SIZE,
+                                                 buf_pages->mapped_pages - kept_pages);
+        }
+
+        buf_pages->mapped_pages = 0;
+    }
+
     msg->reply = result;
 
+    if (msg->async) {
+        // Nobody's waiting on this specifically, it just goes back to the sender's process
+        msg->handled = true;
+        complete_async_message(msg);
+        return message_cookie;
+    }
+
     uint64_t lock_flags = sched_lock_this_cpu();
-    sched_unblock(msg->waiter);
-    sched_schedule();
+    wake_and_switch_to(msg->waiter);
     sched_unlock_this_cpu(lock_flags);
 
     return message_cookie;
 }
+
+uint64_t ipc_channel_send_async(uint64_t channel_cookie, uint64_t tag, size_t size, void *buffer) {
+    if ((uintptr_t)buffer & PAGE_RELATIVE_MASK) {
+        // buffer must be page aligned
+        return 0;
+    }
+
+    if (size > ARG_BUF_MAX) {
+        return 0;
+    }
+
+    IpcChannel *channel = hash_table_lookup(channel_hash, channel_cookie);
+
+    if (!channel) {
+        return 0;
+    }
+
+    Task *current_task = task_current();
+    IpcCompletions *completions = get_completions(current_task->owner);
+
+    if (!completions) {
+        return 0;
+    }
+
+    spinlock_lock(completions->lock);
+
+    if (completions->outstanding >= ASYNC_MAX_OUTSTANDING) {
+        spinlock_unlock(completions->lock);
+        return 0;
+    }
+
+    completions->outstanding++;
+    spinlock_unlock(completions->lock);
+
+    IpcMessage *message = slab_alloc_block();
+
+    if (!message || !init_message(message, tag, size, buffer, current_task, true)) {
+        if (message) {
+            slab_free(message);
+        }
+
+        spinlock_lock(completions->lock);
+        completions->outstanding--;
+        spinlock_unlock(completions->lock);
+        return 0;
+    }
+
+    message->completions = completions;
+
+    // Once it's queued it could be replied to and collected before we're done here...
+    const uint64_t message_cookie = message->cookie;
+
+    enqueue_message(channel, message);
+
+    spinlock_lock(channel->receivers_lock);
+
+    Task *receiver = channel->receivers;
+    if (receiver) {
+        channel->receivers = (Task *)receiver->this.next;
+    }
+
+    spinlock_unlock(channel->receivers_lock);
+
+    if (receiver) {
+        // We're not blocking, so no handoff - receiver just gets to run when it's its turn
+        const uint64_t lock_flags = sched_lock_this_cpu();
+        sched_unblock(receiver);
+        sched_unlock_this_cpu(lock_flags);
+    }
+
+    return message_cookie;
+}
+
+uint64_t ipc_channel_wait_reply(uint64_t message_cookie, uint64_t *reply, bool *handled) {
+    Task *current_task = task_current();
+    IpcCompletions *completions = __atomic_load_n(&current_task->owner->ipc_completions, __ATOMIC_ACQUIRE);
+
+    if (!completions) {
+        // Never sent anything async
+        return 0;
+    }
+
+    while (true) {
+        spinlock_lock(completions->lock);
+
+        IpcMessage *prev = NULL;
+        IpcMessage *msg = completions->head;
+        uint32_t completed_count = 0;
+
+        while (msg && message_cookie && msg->cookie != message_cookie) {
+            prev = msg;
+            msg = (IpcMessage *)msg->this.next;
+            completed_count++;
+        }
+
+        if (msg) {
+            if (prev) {
+                prev->this.next = msg->this.next;
+            } else {
+                completions->head = (IpcMessage *)msg->this.next;
+            }
+
+            if (completions->tail == msg) {
+                completions->tail = prev;
+            }
+
+            completions->outstanding--;
+            spinlock_unlock(completions->lock);
+
+            const uint64_t result = msg->cookie;
+
+            if (reply) {
+                *reply = msg->reply;
+            }
+
+            if (handled) {
+                *handled = msg->handled;
+            }
+
+            free_message(msg);
+            return result;
+        }
+
+        if (completed_count == completions->outstanding) {
+            // Nothing left to complete, so nothing to wait for
+            spinlock_unlock(completions->lock);
+            return 0;
+        }
+
+        current_task->this.next = (ListNode *)completions->waiters;
+        completions->waiters = current_task;
+
+        // Block before we let go, so a completion can't slip in and find us still running here
+        const uint64_t lock_flags = sched_lock_this_cpu();
+        sched_block(current_task);
+        spinlock_unlock(completions->lock);
+        sched_schedule();
+        sched_unlock_this_cpu(lock_flags);
+    }
+}
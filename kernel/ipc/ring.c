@@ -0,0 +1,370 @@
+/*
+ * stage3 - Shared-memory IPC rings
+ * anos - An Operating System
+ *
+ * Copyright (c) 2025 Ross Bamford
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "capabilities/cookies.h"
+#include "fba/alloc.h"
+#include "managed_resources/resources.h"
+#include "once.h"
+#include "panic.h"
+#include "pmm/pagealloc.h"
+#include "process.h"
+#include "sched.h"
+#include "slab/alloc.h"
+#include "spinlock.h"
+#include "std/string.h"
+#include "structs/hash.h"
+#include "task.h"
+#include "vmm/vmmapper.h"
+
+#include "ipc/ring.h"
+#include "ipc/ring_internal.h"
+
+#define INITIAL_RING_HASH_PAGE_COUNT ((1))
+#define RING_PAGE_FLAGS ((PG_USER | PG_READ | PG_WRITE | PG_PRESENT))
+
+#ifdef UNIT_TESTS
+#define STATIC_EXCEPT_TESTS
+#else
+#define STATIC_EXCEPT_TESTS static
+#endif
+
+static_assert(IPC_RING_PAGE_SIZE == VM_PAGE_SIZE, "IPC ring page size doesn't match VM page size");
+static_assert_sizeof(IpcRingSlot, ==, 64);
+static_assert_sizeof(IpcRingShared, <=, IPC_RING_PAGE_SIZE);
+static_assert_sizeof(IpcRing, <=, VM_PAGE_SIZE);
+
+extern MemoryRegion *physical_region;
+
+STATIC_EXCEPT_TESTS HashTable *ring_hash;
+
+// Held across lookup until the ring is locked, and around the final removal
+static SpinLock ring_hash_lock;
+
+void ipc_ring_init(void) {
+    kernel_guard_once();
+
+    spinlock_init(&ring_hash_lock);
+    ring_hash = hash_table_create(INITIAL_RING_HASH_PAGE_COUNT);
+
+    if (!ring_hash) {
+        panic("Failed to initialise IPC ring hash");
+    }
+}
+
+static void free_ring(IpcRing *ring) {
+    for (int i = 0; i < ring->total_pages; i++) {
+        page_free(physical_region, ring->pages[i]);
+    }
+
+    fba_free(ring);
+}
+
+/*
+ * Called when one end's process is destroyed. The other end is woken
+ * (it'll find the ring closed), and the last one out frees it.
+ */
+static void release_ring_end(ManagedResource *resource) {
+    IpcRing *ring = resource->resource_ptr;
+    const uint8_t end = resource->data[0];
+    slab_free(resource);
+
+    spinlock_lock(&ring_hash_lock);
+    spinlock_lock(&ring->lock);
+
+    ring->ends[end] = NULL;
+    ring->waiters[end] = NULL;
+    ring->closed = true;
+
+    Task *peer_waiter = ring->waiters[1 - end];
+    ring->waiters[1 - end] = NULL;
+
+    const bool done = --ring->refs == 0;
+
+    if (done) {
+        hash_table_remove(ring_hash, ring->cookie);
+    }
+
+    spinlock_unlock(&ring->lock);
+    spinlock_unlock(&ring_hash_lock);
+
+    if (peer_waiter) {
+        const uint64_t lock_flags = sched_lock_this_cpu();
+        sched_unblock(peer_waiter);
+        sched_unlock_this_cpu(lock_flags);
+    }
+
+    if (done) {
+        free_ring(ring);
+    }
+}
+
+/*
+ * Find a ring and lock it. Without a ref, the ring could be freed by
+ * its last end going away between the lookup and the lock - holding the
+ * hash lock until we have the ring's lock stops that (release_ring_end
+ * takes the hash lock first).
+ */
+static IpcRing *lookup_and_lock_ring(const uint64_t cookie) {
+    spinlock_lock(&ring_hash_lock);
+
+    IpcRing *ring = hash_table_lookup(ring_hash, cookie);
+
+    if (ring) {
+        spinlock_lock(&ring->lock);
+    }
+
+    spinlock_unlock(&ring_hash_lock);
+
+    return ring;
+}
+
+static ManagedResource *add_ring_end(IpcRing *ring, Process *process, const uint8_t end) {
+    ManagedResource *resource = slab_alloc_block();
+
+    if (!resource) {
+        return NULL;
+    }
+
+    resource->free_func = release_ring_end;
+    resource->resource_ptr = ring;
+    resource->data[0] = end;
+
+    if (!process_add_managed_resource(process, resource)) {
+        slab_free(resource);
+        return NULL;
+    }
+
+    // Only once there's something to release it again
+    ring->ends[end] = process;
+    ring->refs++;
+
+    return resource;
+}
+
+// Undo add_ring_end, for a ring nobody else can have found yet
+static void remove_ring_end(IpcRing *ring, ManagedResource *resource) {
+    const uint8_t end = resource->data[0];
+
+    process_remove_managed_resource(ring->ends[end], resource);
+    slab_free(resource);
+
+    ring->ends[end] = NULL;
+    ring->refs--;
+}
+
+/*
+ * Map the ring's pages at `vaddr` in the current process. Won't map
+ * over anything that's already there.
+ */
+static bool map_ring_pages(const IpcRing *ring, const uintptr_t vaddr) {
+    for (int i = 0; i < ring->total_pages; i++) {
+        const uintptr_t target = vaddr + i * VM_PAGE_SIZE;
+
+        if (!IS_USER_ADDRESS(target) || vmm_virt_to_phys_page(target)) {
+            return false;
+        }
+    }
+
+    for (int i = 0; i < ring->total_pages; i++) {
+        vmm_map_page(vaddr + i * VM_PAGE_SIZE, ring->pages[i], RING_PAGE_FLAGS);
+    }
+
+    return true;
+}
+
+uint64_t ipc_ring_create(const uint32_t ring_pages, const uintptr_t vaddr) {
+    if (ring_pages == 0 || ring_pages > IPC_RING_MAX_PAGES || (ring_pages & (ring_pages - 1))) {
+        // Slot count needs to be a power of two
+        return 0;
+    }
+
+    if (vaddr & PAGE_RELATIVE_MASK) {
+        return 0;
+    }
+
+    IpcRing *ring = fba_alloc_block();
+
+    if (!ring) {
+        return 0;
+    }
+
+    memset(ring, 0, sizeof(IpcRing));
+    spinlock_init(&ring->lock);
+
+    for (int i = 0; i < 1 + 2 * ring_pages; i++) {
+        const uintptr_t page = page_alloc(physical_region);
+
+        if (page & 0xff) {
+            // Out of memory
+            free_ring(ring);
+            return 0;
+        }
+
+        ring->pages[ring->total_pages++] = page;
+    }
+
+    if (!map_ring_pages(ring, vaddr)) {
+        free_ring(ring);
+        return 0;
+    }
+
+    IpcRingShared *shared = (IpcRingShared *)vaddr;
+    memset(shared, 0, ring->total_pages * VM_PAGE_SIZE);
+    shared->slot_count = ring_pages * (VM_PAGE_SIZE / sizeof(IpcRingSlot));
+    shared->ring_pages = ring_pages;
+
+    Process *owner = task_current()->owner;
+    ManagedResource *resource = add_ring_end(ring, owner, 0);
+
+    if (!resource) {
+        vmm_unmap_pages(vaddr, ring->total_pages);
+        free_ring(ring);
+        return 0;
+    }
+
+    ring->cookie = capability_cookie_generate();
+
+    if (!hash_table_insert(ring_hash, ring->cookie, ring)) {
+        // Nothing can find it, so the end has to go now - the process would free it otherwise
+        remove_ring_end(ring, resource);
+        vmm_unmap_pages(vaddr, ring->total_pages);
+        free_ring(ring);
+        return 0;
+    }
+
+    return ring->cookie;
+}
+
+size_t ipc_ring_attach(const uint64_t cookie, const uintptr_t vaddr) {
+    if (vaddr & PAGE_RELATIVE_MASK) {
+        return 0;
+    }
+
+    IpcRing *ring = lookup_and_lock_ring(cookie);
+
+    if (!ring) {
+        return 0;
+    }
+
+    Process *owner = task_current()->owner;
+
+    if (ring->closed || ring->ends[1] || ring->ends[0] == owner) {
+        // Already attached, or on the way out
+        spinlock_unlock(&ring->lock);
+        return 0;
+    }
+
+    if (!map_ring_pages(ring, vaddr)) {
+        spinlock_unlock(&ring->lock);
+        return 0;
+    }
+
+    if (!add_ring_end(ring, owner, 1)) {
+        vmm_unmap_pages(vaddr, ring->total_pages);
+        spinlock_unlock(&ring->lock);
+        return 0;
+    }
+
+    spinlock_unlock(&ring->lock);
+
+    return ring->total_pages * VM_PAGE_SIZE;
+}
+
+static inline int find_end(const IpcRing *ring, const Process *process) {
+    if (ring->ends[0] == process) {
+        return 0;
+    }
+
+    if (ring->ends[1] == process) {
+        return 1;
+    }
+
+    return -1;
+}
+
+bool ipc_ring_wait(const uint64_t cookie) {
+    IpcRing *ring = lookup_and_lock_ring(cookie);
+
+    if (!ring) {
+        return false;
+    }
+
+    Task *current_task = task_current();
+
+    const int end = find_end(ring, current_task->owner);
+
+    if (end < 0 || ring->waiters[end]) {
+        // Not ours, or someone else is already consuming at this end
+        spinlock_unlock(&ring->lock);
+        return false;
+    }
+
+    if (ring->pending[end]) {
+        ring->pending[end] = false;
+        spinlock_unlock(&ring->lock);
+        return true;
+    }
+
+    if (ring->closed) {
+        spinlock_unlock(&ring->lock);
+        return false;
+    }
+
+    ring->waiters[end] = current_task;
+
+    // Block before we let go, so a notify can't slip in and find us still running here
+    const uint64_t lock_flags = sched_lock_this_cpu();
+    sched_block(current_task);
+    spinlock_unlock(&ring->lock);
+    sched_schedule();
+    sched_unlock_this_cpu(lock_flags);
+
+    // We still hold our end, so the ring is still here
+    spinlock_lock(&ring->lock);
+    const bool result = !ring->closed;
+    spinlock_unlock(&ring->lock);
+
+    return result;
+}
+
+bool ipc_ring_notify(const uint64_t cookie) {
+    IpcRing *ring = lookup_and_lock_ring(cookie);
+
+    if (!ring) {
+        return false;
+    }
+
+    const int end = find_end(ring, task_current()->owner);
+
+    if (end < 0 || ring->closed) {
+        spinlock_unlock(&ring->lock);
+        return false;
+    }
+
+    const int peer = 1 - end;
+    Task *waiter = ring->waiters[peer];
+
+    if (waiter) {
+        ring->waiters[peer] = NULL;
+    } else {
+        ring->pending[peer] = true;
+    }
+
+    spinlock_unlock(&ring->lock);
+
+    if (waiter) {
+        const uint64_t lock_flags = sched_lock_this_cpu();
+        sched_unblock(waiter);
+        sched_unlock_this_cpu(lock_flags);
+    }
+
+    return true;
+}
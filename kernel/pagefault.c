@@ -11,9 +11,10 @@
 #include "machine.h"
 #include "panic.h"
 #include "pmm/pagealloc.h"
+#include "pmm/pfndb.h"
+#include "process/memory.h"
 #include "smp/state.h"
 #include "std/string.h"
-#include "structs/ref_count_map.h"
 #include "structs/region_tree.h"
 #include "vmm/vmmapper.h"
 #include "vmm/vmregion.h"
@@ -60,6 +61,7 @@
 
 extern MemoryRegion *physical_region;
 extern uintptr_t kernel_zero_page;
+extern uintptr_t kernel_zero_large_page;
 
 // Handle page faults before we have SMP and tasking up...
 void early_page_fault_handler(const uint64_t code, const uint64_t fault_addr, const uint64_t origin_addr,
@@ -80,6 +82,38 @@ static uintptr_t alloc_phys_appropriately(Process *current_process) {
     return phys;
 }
 
+// A page that's known to be zero - straight from the zero pool if there's
+// one there, otherwise a fresh one zeroed through the direct map
+static uintptr_t alloc_zeroed_phys_appropriately(Process *current_process) {
+    uintptr_t phys;
+    uint64_t zeroed = 0;
+
+    if (current_process) {
+        if (!process_pages_alloc(current_process, physical_region, &phys, 1, &zeroed)) {
+            return 0xff;
+        }
+    } else {
+        phys = page_alloc_zeroed(physical_region);
+
+        if (phys & 0xff) {
+            phys = page_alloc(physical_region);
+        } else {
+            zeroed = 1;
+        }
+    }
+
+    if (!zeroed && !(phys & 0xff)) {
+        memclr_page(vmm_phys_to_virt_ptr(phys));
+    }
+
+    return phys;
+}
+
+// Lazily-allocated large pages map (pages in) the large zero page
+static inline bool is_zero_page(const uintptr_t phys) {
+    return phys == kernel_zero_page || (kernel_zero_large_page && phys - kernel_zero_large_page < MEGA_PAGE_SIZE);
+}
+
 static void copy_page_safely(const uintptr_t src_virt_page, const uintptr_t dest_phys_page) {
     vdebugf("SAFE COPY PAGE\n");
     const uint64_t int_flags = save_disable_interrupts();
@@ -95,7 +129,7 @@ static void copy_page_safely(const uintptr_t src_virt_page, const uintptr_t dest
 
     vdebugf("    * Mapped SRC @ 0x%016lx : DEST @ 0x%016lx\n", (uintptr_t)src_page, (uintptr_t)dest_page);
 
-    memcpy(dest_page, src_page, VM_PAGE_SIZE);
+    memcpy_page(dest_page, src_page);
 
     vdebugf("    * Safe memcpy done\n");
 
@@ -111,7 +145,8 @@ void page_fault_handler(const uint64_t code, const uint64_t fault_addr, const ui
     tdbgx64(fault_addr);
     tdebug("\n");
 
-    const uint64_t pte = vmm_virt_to_pt_entry(fault_addr);
+    PagetableLevel level = PT_LEVEL_PT;
+    const uint64_t pte = vmm_virt_to_pt_entry_and_level(fault_addr, &level);
     const uintptr_t fault_addr_page = fault_addr & PAGE_ALIGN_MASK;
     const uintptr_t current_phys_addr = vmm_table_entry_to_phys(pte);
 
@@ -139,11 +174,22 @@ void page_fault_handler(const uint64_t code, const uint64_t fault_addr, const ui
             if (code & PG_WRITE) {
                 vdebug("  --> IS WRITE\n");
 
+#ifndef NO_LARGE_PAGES
+                // First write to a lazily-allocated large page - give it a real one,
+                // or if we can't, the 4KiB path below will split it and copy.
+                if (level == PT_LEVEL_PD && is_zero_page(current_phys_addr) &&
+                    vm_region_map_new_large_page(
+                            current_process, fault_addr & ~(MEGA_PAGE_SIZE - 1),
+                            (vmm_table_entry_to_page_flags(pte) & ~(PG_COPY_ON_WRITE)) | PG_WRITE)) {
+                    return;
+                }
+#endif
+
                 // This is a write to a COW page...
                 // Can we just remap the page as write?
-                if (current_phys_addr != kernel_zero_page) {
+                if (!is_zero_page(current_phys_addr)) {
                     // It's not the zero page...
-                    if (refcount_map_decrement(current_phys_addr) == 0) {
+                    if (pfndb_ref_decrement(current_phys_addr) == 0) {
                         // ... and nobody else is referencing this page, assume
                         // other referees are gone. So we can just make it
                         // writeable, no need to copy.
@@ -158,7 +204,11 @@ void page_fault_handler(const uint64_t code, const uint64_t fault_addr, const ui
                 // This is the zero page, or there are still references to this
                 // page elsewhere, so we need to copy it...
                 //
-                const uintptr_t phys = alloc_phys_appropriately(current_process);
+                // (copying the zero page is just zeroing, and that may well
+                // have been done already in the background)
+                const bool from_zero = is_zero_page(current_phys_addr);
+                const uintptr_t phys = from_zero ? alloc_zeroed_phys_appropriately(current_process)
+                                                 : alloc_phys_appropriately(current_process);
 
                 if (phys & 0xff) {
                     // phys alloc failed - panic anyway
@@ -166,7 +216,9 @@ void page_fault_handler(const uint64_t code, const uint64_t fault_addr, const ui
                 }
                 vdebugf("Allocated page 0x%016lx for COW destination\n", phys);
 
-                copy_page_safely(fault_addr_page, phys);
+                if (!from_zero) {
+                    copy_page_safely(fault_addr_page, phys);
+                }
 
                 vmm_map_page(fault_addr_page, phys,
                              (vmm_table_entry_to_page_flags(pte) & ~(PG_COPY_ON_WRITE)) | PG_WRITE);
@@ -180,7 +232,7 @@ void page_fault_handler(const uint64_t code, const uint64_t fault_addr, const ui
     vdebug("CHECK REGION\n");
     if (current_process) {
 
-        const Region *region = vm_region_find_in_process(current_process, fault_addr);
+        Region *region = vm_region_find_in_process(current_process, fault_addr);
 
 #ifdef VERY_NOISY_PAGEFAULT
         if (!region) {
@@ -191,22 +243,35 @@ void page_fault_handler(const uint64_t code, const uint64_t fault_addr, const ui
         if (region && region->flags & VM_REGION_AUTOMAP) {
             vdebug("PAGE IN REGION\n");
 
+#ifndef NO_LARGE_PAGES
+            // If the whole large page around the fault is ours and untouched,
+            // fault it in all at once - same as below, just bigger.
+            const uintptr_t large_base = fault_addr & ~(MEGA_PAGE_SIZE - 1);
+
+            if (vm_region_large_page_fits(region, large_base)) {
+                if (code & PG_WRITE) {
+                    if (vm_region_map_new_large_page(current_process, large_base,
+                                                     PG_USER | PG_READ | PG_WRITE | PG_PRESENT)) {
+                        return;
+                    }
+                } else if (kernel_zero_large_page &&
+                           vmm_map_large_page_in(vmm_find_pml4()->entries, large_base, kernel_zero_large_page,
+                                                 PG_USER | PG_READ | PG_PRESENT | PG_COPY_ON_WRITE, PT_LEVEL_PD)) {
+                    return;
+                }
+            }
+#endif
+
             if (code & PG_WRITE) {
                 // First access to an automap region, it's a write, so just
-                // allocate a page and zero it.
+                // allocate zeroed pages - maybe a few, if it looks like
+                // it's being filled in sequentially.
                 //
-                const uintptr_t phys = alloc_phys_appropriately(current_process);
-
-                if (phys & 0xff) {
+                if (!vm_region_fault_around(current_process, region, fault_addr_page)) {
                     // phys alloc failed - panic anyway
                     panic_page_fault(origin_addr, fault_addr, code, stack_frame->registers.rbp);
                 }
 
-                vmm_map_page(fault_addr_page, phys, PG_USER | PG_READ | PG_WRITE | PG_PRESENT);
-                uint64_t *mapped_page = (uint64_t *)fault_addr_page;
-
-                memclr(mapped_page, VM_PAGE_SIZE);
-
                 return;
             }
 
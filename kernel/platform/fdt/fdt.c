@@ -0,0 +1,181 @@
+/*
+ * stage3 - Flattened Device Tree (FDT) routines
+ * anos - An Operating System
+ *
+ * Copyright (c) 2025 Ross Bamford
+ *
+ * This is just enough of an FDT reader to pull the odd property out of
+ * the blob the bootloader hands us - it doesn't build any kind of tree,
+ * it just walks the structure block looking for what it's been asked for.
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "platform/fdt/fdt.h"
+
+// FDT is big-endian, and nothing in the blob is guaranteed to be aligned
+// for anything wider than a cell, so just read bytes...
+static inline uint32_t read_be32(const void *ptr) {
+    const uint8_t *bytes = ptr;
+    return ((uint32_t)bytes[0] << 24) | ((uint32_t)bytes[1] << 16) | ((uint32_t)bytes[2] << 8) | bytes[3];
+}
+
+static inline uint32_t align_cell(const uint32_t offset) { return (offset + 3) & ~3U; }
+
+static size_t bounded_strlen(const char *str, const size_t max) {
+    size_t len = 0;
+
+    while (len < max && str[len]) {
+        len++;
+    }
+
+    return len;
+}
+
+static bool node_name_matches(const char *node_name, const char *component, const size_t component_len) {
+    for (size_t i = 0; i < component_len; i++) {
+        if (node_name[i] != component[i]) {
+            return false;
+        }
+    }
+
+    // Allow "cpu" to match "cpu@0", unless the path gave a unit address
+    return node_name[component_len] == '\0' || node_name[component_len] == '@';
+}
+
+static bool prop_name_matches(const char *prop_name, const char *name, const size_t max) {
+    size_t i = 0;
+
+    while (i < max && prop_name[i] && prop_name[i] == name[i]) {
+        i++;
+    }
+
+    return i < max && prop_name[i] == name[i];
+}
+
+const void *fdt_find_property(const void *fdt, const char *path, const char *name, uint32_t *len) {
+    if (!fdt || !path || !name || *path != '/') {
+        return NULL;
+    }
+
+    const FDT_Header *header = fdt;
+    const uint8_t *base = fdt;
+
+    if (read_be32(&header->magic) != FDT_MAGIC) {
+        return NULL;
+    }
+
+    const uint32_t total_size = read_be32(&header->totalsize);
+    const uint32_t strings_offset = read_be32(&header->off_dt_strings);
+    uint32_t offset = read_be32(&header->off_dt_struct);
+
+    if (offset >= total_size || strings_offset >= total_size) {
+        return NULL;
+    }
+
+    const char *component = path + 1; // Next path component still to match
+    uint32_t depth = 0;               // Current node depth (root is 1)
+    uint32_t matched_depth = 0;       // Depth of the deepest node on our path
+
+    while (offset + 4 <= total_size) {
+        const uint32_t token = read_be32(base + offset);
+        offset += 4;
+
+        switch (token) {
+        case FDT_BEGIN_NODE: {
+            const char *node_name = (const char *)base + offset;
+            const size_t name_len = bounded_strlen(node_name, total_size - offset);
+
+            if (name_len == total_size - offset) {
+                return NULL;
+            }
+
+            offset = align_cell(offset + name_len + 1);
+            depth++;
+
+            if (depth == 1) {
+                matched_depth = 1;
+            } else if (depth == matched_depth + 1 && *component) {
+                size_t component_len = 0;
+                while (component[component_len] && component[component_len] != '/') {
+                    component_len++;
+                }
+
+                if (node_name_matches(node_name, component, component_len)) {
+                    matched_depth = depth;
+                    component += component_len;
+
+                    if (*component == '/') {
+                        component++;
+                    }
+                }
+            }
+
+            break;
+        }
+        case FDT_END_NODE:
+            // Leaving a node on our path means what we want isn't there
+            if (depth == 0 || depth == matched_depth) {
+                return NULL;
+            }
+
+            depth--;
+            break;
+        case FDT_PROP: {
+            if (total_size - offset < 8) {
+                return NULL;
+            }
+
+            const uint32_t prop_len = read_be32(base + offset);
+            const uint32_t name_offset = read_be32(base + offset + 4);
+            offset += 8;
+
+            if (prop_len > total_size - offset) {
+                return NULL;
+            }
+
+            if (depth == matched_depth && !*component && name_offset < total_size - strings_offset &&
+                prop_name_matches((const char *)base + strings_offset + name_offset, name,
+                                  total_size - strings_offset - name_offset)) {
+                if (len) {
+                    *len = prop_len;
+                }
+
+                return base + offset;
+            }
+
+            offset = align_cell(offset + prop_len);
+            break;
+        }
+        case FDT_NOP:
+            break;
+        default:
+            // FDT_END, or something we don't understand...
+            return NULL;
+        }
+    }
+
+    return NULL;
+}
+
+bool fdt_read_u64(const void *fdt, const char *path, const char *name, uint64_t *value) {
+    uint32_t len;
+    const uint8_t *prop = fdt_find_property(fdt, path, name, &len);
+
+    if (!prop || !value) {
+        return false;
+    }
+
+    switch (len) {
+    case 4:
+        *value = read_be32(prop);
+        return true;
+    case 8:
+        *value = ((uint64_t)read_be32(prop) << 32) | read_be32(prop + 4);
+        return true;
+    default:
+        return false;
+    }
+}
@@ -0,0 +1,192 @@
+/*
+ * stage3 - Buddy allocator for physical pages
+ * anos - An Operating System
+ *
+ * Copyright (c) 2025 Ross Bamford
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "pmm/buddy.h"
+#include "vmm/vmconfig.h"
+
+#define MAX_BLOCK_PAGES ((1ULL << BUDDY_MAX_ORDER))
+#define MAX_BLOCK_BYTES ((MAX_BLOCK_PAGES << VM_PAGE_LINEAR_SHIFT))
+
+#define BITMAP_WORDS(bits) ((((bits) + 63) >> 6))
+
+static inline uint64_t order_blocks(const uint64_t span_pages, const uint8_t order) { return span_pages >> order; }
+
+static inline uint64_t order_summary_words(const BuddyAllocator *buddy, const uint8_t order) {
+    return BITMAP_WORDS(BITMAP_WORDS(order_blocks(buddy->span_pages, order)));
+}
+
+static inline uint64_t span_pages_for(const uintptr_t start, const uintptr_t end) {
+    const uintptr_t base = start & ~(MAX_BLOCK_BYTES - 1);
+    const uintptr_t top = (end + MAX_BLOCK_BYTES - 1) & ~(MAX_BLOCK_BYTES - 1);
+
+    return (top - base) >> VM_PAGE_LINEAR_SHIFT;
+}
+
+size_t buddy_metadata_size(const uintptr_t start, const uintptr_t end) {
+    const uint64_t span_pages = span_pages_for(start, end);
+    size_t words = 0;
+
+    for (int order = 0; order < BUDDY_ORDER_COUNT; order++) {
+        const uint64_t bitmap_words = BITMAP_WORDS(order_blocks(span_pages, order));
+        words += bitmap_words + BITMAP_WORDS(bitmap_words);
+    }
+
+    return words * sizeof(uint64_t);
+}
+
+void buddy_init(BuddyAllocator *buddy, const uintptr_t start, const uintptr_t end, void *metadata) {
+    buddy->base = start & ~(MAX_BLOCK_BYTES - 1);
+    buddy->span_pages = span_pages_for(start, end);
+
+    uint64_t *next = metadata;
+
+    for (int order = 0; order < BUDDY_ORDER_COUNT; order++) {
+        const uint64_t bitmap_words = BITMAP_WORDS(order_blocks(buddy->span_pages, order));
+
+        buddy->free_blocks[order] = 0;
+        buddy->hints[order] = 0;
+        buddy->bitmaps[order] = next;
+        next += bitmap_words;
+        buddy->summaries[order] = next;
+        next += BITMAP_WORDS(bitmap_words);
+    }
+}
+
+uint8_t buddy_order_for(const uint64_t count) {
+    uint8_t order = 0;
+
+    while ((1ULL << order) < count) {
+        order++;
+    }
+
+    return order;
+}
+
+static inline bool is_free(const BuddyAllocator *buddy, const uint8_t order, const uint64_t block) {
+    return buddy->bitmaps[order][block >> 6] & (1ULL << (block & 63));
+}
+
+static inline void set_free(BuddyAllocator *buddy, const uint8_t order, const uint64_t block) {
+    const uint64_t word = block >> 6;
+    const uint64_t summary_word = word >> 6;
+
+    buddy->bitmaps[order][word] |= 1ULL << (block & 63);
+    buddy->summaries[order][summary_word] |= 1ULL << (word & 63);
+    buddy->free_blocks[order]++;
+
+    if (summary_word < buddy->hints[order]) {
+        buddy->hints[order] = summary_word;
+    }
+}
+
+static inline void clear_free(BuddyAllocator *buddy, const uint8_t order, const uint64_t block) {
+    const uint64_t word = block >> 6;
+
+    buddy->bitmaps[order][word] &= ~(1ULL << (block & 63));
+
+    if (!buddy->bitmaps[order][word]) {
+        buddy->summaries[order][word >> 6] &= ~(1ULL << (word & 63));
+    }
+
+    buddy->free_blocks[order]--;
+}
+
+// Caller must know there's at least one free block at this order
+static inline uint64_t find_free(BuddyAllocator *buddy, const uint8_t order) {
+    const uint64_t summary_words = order_summary_words(buddy, order);
+
+    for (uint64_t i = buddy->hints[order]; i < summary_words; i++) {
+        const uint64_t summary = buddy->summaries[order][i];
+
+        if (summary) {
+            const uint64_t word = (i << 6) + __builtin_ctzll(summary);
+            buddy->hints[order] = i;
+            return (word << 6) + __builtin_ctzll(buddy->bitmaps[order][word]);
+        }
+    }
+
+    // Not reached if free_blocks is right
+    return 0;
+}
+
+uintptr_t buddy_alloc(BuddyAllocator *buddy, const uint8_t order) {
+    if (order > BUDDY_MAX_ORDER) {
+        return 0xFF;
+    }
+
+    uint8_t found = order;
+
+    while (found <= BUDDY_MAX_ORDER && buddy->free_blocks[found] == 0) {
+        found++;
+    }
+
+    if (found > BUDDY_MAX_ORDER) {
+        return 0xFF;
+    }
+
+    uint64_t block = find_free(buddy, found);
+    clear_free(buddy, found, block);
+
+    // Split down to size, the upper halves stay free
+    while (found > order) {
+        found--;
+        block <<= 1;
+        set_free(buddy, found, block + 1);
+    }
+
+    return buddy->base + (block << (order + VM_PAGE_LINEAR_SHIFT));
+}
+
+void buddy_free(BuddyAllocator *buddy, const uintptr_t addr, uint8_t order) {
+    if (addr < buddy->base || order > BUDDY_MAX_ORDER) {
+        return;
+    }
+
+    const uint64_t page = (addr - buddy->base) >> VM_PAGE_LINEAR_SHIFT;
+
+    if (page >= buddy->span_pages) {
+        return;
+    }
+
+    uint64_t block = page >> order;
+
+    while (order < BUDDY_MAX_ORDER && is_free(buddy, order, block ^ 1)) {
+        clear_free(buddy, order, block ^ 1);
+        block >>= 1;
+        order++;
+    }
+
+    set_free(buddy, order, block);
+}
+
+void buddy_free_range(BuddyAllocator *buddy, const uintptr_t addr, uint64_t count) {
+    uintptr_t current = addr;
+
+    while (count) {
+        const uint64_t page = (current - buddy->base) >> VM_PAGE_LINEAR_SHIFT;
+
+        // Biggest block that's aligned here and doesn't overrun
+        uint8_t order = page ? __builtin_ctzll(page) : BUDDY_MAX_ORDER;
+
+        if (order > BUDDY_MAX_ORDER) {
+            order = BUDDY_MAX_ORDER;
+        }
+
+        while ((1ULL << order) > count) {
+            order--;
+        }
+
+        buddy_free(buddy, current, order);
+
+        current += (1ULL << order) << VM_PAGE_LINEAR_SHIFT;
+        count -= 1ULL << order;
+    }
+}
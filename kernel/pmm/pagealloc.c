@@ -6,9 +6,12 @@
  */
 
 #include <stdbool.h>
+#include <stdint.h>
 
+#include "anos_assert.h"
 #include "machine.h"
 #include "pmm/pagealloc.h"
+#include "smp/state.h"
 #include "spinlock.h"
 #include "vmm/vmconfig.h"
 
@@ -49,6 +52,241 @@
 #define V_PRINTDEC(...)
 #endif
 
+/*
+ * Work out what part (if any) of a memory map entry we should manage,
+ * as page-aligned [start, end).
+ */
+static bool usable_range(const Limine_MemMapEntry *entry, const uint64_t managed_base, const bool reclaim_exec_mods,
+                         uint64_t *out_start, uint64_t *out_end) {
+    if (entry->length == 0) {
+        C_DEBUGSTR(" ====> Skipping unavailable region ");
+        C_PRINTHEX64(entry->base, debugchar);
+        C_DEBUGSTR(" of length ");
+        C_PRINTDEC(entry->length, debugchar);
+        C_DEBUGSTR(" [type ");
+        C_PRINTDEC(entry->type, debugchar);
+        C_DEBUGSTR("]\n");
+        return false;
+    }
+
+    switch (entry->type) {
+    case LIMINE_MEMMAP_USABLE:
+    case LIMINE_MEMMAP_EXECUTABLE_AND_MODULES:
+
+    // TODO make sure this is actually safe,
+    // i.e. ACPI tables are in ACPI_RESERVED?
+    case LIMINE_MEMMAP_BOOTLOADER_RECLAIMABLE:
+        break;
+    default:
+        return false;
+    }
+
+    if (!reclaim_exec_mods && entry->type == LIMINE_MEMMAP_EXECUTABLE_AND_MODULES) {
+        C_DEBUGSTR(" ====> IGNORED available region ");
+        C_PRINTHEX64(entry->base, debugchar);
+        C_DEBUGSTR(" of length ");
+        C_PRINTDEC(entry->length, debugchar);
+        C_DEBUGSTR(" [type ");
+        C_PRINTDEC(entry->type, debugchar);
+        C_DEBUGSTR("] - EXECUTABLE_AND_MODULES reclaim disabled "
+                   "on " ARCH_STR "\n");
+        return false;
+    }
+
+    C_DEBUGSTR(" ====> Mapping available region ");
+    C_PRINTHEX64(entry->base, debugchar);
+    C_DEBUGSTR(" of length ");
+    C_PRINTDEC(entry->length, debugchar);
+    C_DEBUGSTR(" [type ");
+    C_PRINTDEC(entry->type, debugchar);
+    C_DEBUGSTR("]\n");
+
+    // Ensure start is page aligned - Limine _does_ guarantee alignment
+    // for USABLE and BOOTLOADER_RECLAIMABLE, but we want to reclaim
+    // the EXECUTABLE_AND_MODULES memory as well for which there's no
+    // such guarantee...
+    uint64_t start = entry->base & 0xFFFFFFFFFFFFF000;
+
+    // Grab end, and align that too
+    const uint64_t end = (entry->base + entry->length) & 0xFFFFFFFFFFFFF000;
+
+    // Is the aligned base below the actual base for this block?
+    if (entry->base > start) {
+        // Round up to next page boundary if so...
+        start += VM_PAGE_SIZE;
+    }
+
+    // Cut off any memory below the supplied managed base.
+    if (start < managed_base) {
+        if (end <= managed_base) {
+            // This block is entirely below the managed base, just skip
+            // it
+            C_DEBUGSTR(" ==== ----> Ignoring, entirely below base\n");
+            return false;
+        } else {
+            // This block extends beyond the managed base, so adjust the
+            // start
+            C_DEBUGSTR(" ==== ----> Adjusting, partially below "
+                       "base\n");
+            start = managed_base;
+        }
+    }
+
+    // Just in case we get a block < 4KiB
+    if (end <= start) {
+        return false;
+    }
+
+    *out_start = start;
+    *out_end = end;
+
+    return true;
+}
+
+#ifdef PMM_BUDDY
+static_assert_sizeof(MemoryRegion, <=, VM_PAGE_SIZE);
+
+MemoryRegion *page_alloc_init_limine(Limine_MemMap *memmap, uint64_t managed_base, void *buffer,
+                                     bool reclaim_exec_mods) {
+    MemoryRegion *region = (MemoryRegion *)buffer;
+    spinlock_init(&region->lock);
+
+    region->size = region->free = 0;
+    region->flags = 0;
+
+    C_DEBUGSTR("PMM Managed base: ");
+    C_PRINTDEC(managed_base, debugchar);
+    C_DEBUGSTR("\n");
+
+    // First, find the span we need to cover...
+    uint64_t span_start = UINT64_MAX;
+    uint64_t span_end = 0;
+
+    for (int i = 0; i < memmap->entry_count; i++) {
+        uint64_t start, end;
+
+        if (usable_range(memmap->entries[i], managed_base, reclaim_exec_mods, &start, &end)) {
+            span_start = start < span_start ? start : span_start;
+            span_end = end > span_end ? end : span_end;
+        }
+    }
+
+    if (span_end == 0) {
+        buddy_init(&region->buddy, 0, 0, NULL);
+        return region;
+    }
+
+    // ... trimming the top off if the metadata won't fit ...
+    while (buddy_metadata_size(span_start, span_end) > PMM_BUDDY_MAX_METADATA) {
+        span_end -= (VM_PAGE_SIZE << BUDDY_MAX_ORDER);
+        C_DEBUGSTR("!!! WARN: PMM metadata limit reached, ignoring memory above ");
+        C_PRINTHEX64(span_end, debugchar);
+        C_DEBUGSTR("\n");
+    }
+
+    // ... and take the pages for the metadata from the first block that's big enough
+    const uint64_t metadata_pages = (buddy_metadata_size(span_start, span_end) + VM_PAGE_SIZE - 1) >>
+                                    VM_PAGE_LINEAR_SHIFT;
+    uint64_t metadata_phys = 0;
+
+    for (int i = 0; i < memmap->entry_count && !metadata_phys; i++) {
+        uint64_t start, end;
+
+        if (usable_range(memmap->entries[i], managed_base, reclaim_exec_mods, &start, &end) && end <= span_end &&
+            ((end - start) >> VM_PAGE_LINEAR_SHIFT) >= metadata_pages) {
+            metadata_phys = start;
+        }
+    }
+
+    if (!metadata_phys) {
+        C_DEBUGSTR("!!! WARN: No room for PMM metadata, no memory will be available\n");
+        buddy_init(&region->buddy, 0, 0, NULL);
+        return region;
+    }
+
+    uint8_t *metadata = (uint8_t *)(region) + VM_PAGE_SIZE;
+
+    for (int i = 0; i < metadata_pages; i++) {
+        if (!arch_pmm_map_metadata_page((uintptr_t)metadata + (i << VM_PAGE_LINEAR_SHIFT),
+                                        metadata_phys + (i << VM_PAGE_LINEAR_SHIFT))) {
+            C_DEBUGSTR("!!! WARN: Failed to map PMM metadata, no memory will be available\n");
+            buddy_init(&region->buddy, 0, 0, NULL);
+            return region;
+        }
+    }
+
+    for (int i = 0; i < metadata_pages << VM_PAGE_LINEAR_SHIFT; i++) {
+        metadata[i] = 0;
+    }
+
+    buddy_init(&region->buddy, span_start, span_end, metadata);
+
+    for (int i = 0; i < memmap->entry_count; i++) {
+        uint64_t start, end;
+
+        if (!usable_range(memmap->entries[i], managed_base, reclaim_exec_mods, &start, &end) || start >= span_end) {
+            continue;
+        }
+
+        end = end > span_end ? span_end : end;
+        region->size += end - start;
+
+        if (start == metadata_phys) {
+            // Metadata pages are never free
+            start += metadata_pages << VM_PAGE_LINEAR_SHIFT;
+        }
+
+        if (end > start) {
+            region->free += end - start;
+            buddy_free_range(&region->buddy, start, (end - start) >> VM_PAGE_LINEAR_SHIFT);
+        }
+    }
+
+    return region;
+}
+
+uintptr_t page_alloc_m(MemoryRegion *region, uint64_t count) {
+    if (count == 0) {
+        return 0xFF;
+    }
+
+    const uint8_t order = buddy_order_for(count);
+    uint64_t lock_flags = spinlock_lock_irqsave(&region->lock);
+
+    const uintptr_t base = buddy_alloc(&region->buddy, order);
+
+    if ((base & 0xFFF) == 0) {
+        const uint64_t excess = (1ULL << order) - count;
+
+        if (excess) {
+            // Don't need all of it, give the tail back
+            buddy_free_range(&region->buddy, base + (count << VM_PAGE_LINEAR_SHIFT), excess);
+        }
+
+        region->free -= count << VM_PAGE_LINEAR_SHIFT;
+    }
+
+    spinlock_unlock_irqrestore(&region->lock, lock_flags);
+    return base;
+}
+
+// Caller must hold the region lock
+static inline uintptr_t alloc_page_locked(MemoryRegion *region) {
+    const uintptr_t page = buddy_alloc(&region->buddy, 0);
+
+    if ((page & 0xFFF) == 0) {
+        region->free -= VM_PAGE_SIZE;
+    }
+
+    return page;
+}
+
+// Caller must hold the region lock
+static inline void free_page_locked(MemoryRegion *region, uintptr_t page) {
+    region->free += VM_PAGE_SIZE;
+    buddy_free(&region->buddy, page, 0);
+}
+#else
 MemoryRegion *page_alloc_init_limine(Limine_MemMap *memmap, uint64_t managed_base, void *buffer,
                                      bool reclaim_exec_mods) {
     MemoryRegion *region = (MemoryRegion *)buffer;
@@ -57,101 +295,28 @@ MemoryRegion *page_alloc_init_limine(Limine_MemMap *memmap, uint64_t managed_bas
     region->sp--; // Start below bottom of stack
 
     region->size = region->free = 0;
+    region->flags = 0;
 
     C_DEBUGSTR("PMM Managed base: ");
     C_PRINTDEC(managed_base, debugchar);
     C_DEBUGSTR("\n");
 
     for (int i = 0; i < memmap->entry_count; i++) {
-        Limine_MemMapEntry *entry = memmap->entries[i];
-
-        if (entry->length > 0) {
-            switch (entry->type) {
-            case LIMINE_MEMMAP_USABLE:
-            case LIMINE_MEMMAP_EXECUTABLE_AND_MODULES:
-
-            // TODO make sure this is actually safe,
-            // i.e. ACPI tables are in ACPI_RESERVED?
-            case LIMINE_MEMMAP_BOOTLOADER_RECLAIMABLE:
-
-                if (!reclaim_exec_mods && entry->type == LIMINE_MEMMAP_EXECUTABLE_AND_MODULES) {
-                    C_DEBUGSTR(" ====> IGNORED available region ");
-                    C_PRINTHEX64(entry->base, debugchar);
-                    C_DEBUGSTR(" of length ");
-                    C_PRINTDEC(entry->length, debugchar);
-                    C_DEBUGSTR(" [type ");
-                    C_PRINTDEC(entry->type, debugchar);
-                    C_DEBUGSTR("] - EXECUTABLE_AND_MODULES reclaim disabled "
-                               "on " ARCH_STR "\n");
-                    break;
-                }
-
-                C_DEBUGSTR(" ====> Mapping available region ");
-                C_PRINTHEX64(entry->base, debugchar);
-                C_DEBUGSTR(" of length ");
-                C_PRINTDEC(entry->length, debugchar);
-                C_DEBUGSTR(" [type ");
-                C_PRINTDEC(entry->type, debugchar);
-                C_DEBUGSTR("]\n");
-
-                // Ensure start is page aligned - Limine _does_ guarantee alignment
-                // for USABLE and BOOTLOADER_RECLAIMABLE, but we want to reclaim
-                // the EXECUTABLE_AND_MODULES memory as well for which there's no
-                // such guarantee...
-                uint64_t start = entry->base & 0xFFFFFFFFFFFFF000;
-
-                // Grab end, and align that too
-                uint64_t end = (entry->base + entry->length) & 0xFFFFFFFFFFFFF000;
-
-                // Is the aligned base below the actual base for this block?
-                if (entry->base > start) {
-                    // Round up to next page boundary if so...
-                    start += VM_PAGE_SIZE;
-                }
-
-                // Cut off any memory below the supplied managed base.
-                if (start < managed_base) {
-                    if (end <= managed_base) {
-                        // This block is entirely below the managed base, just skip
-                        // it
-                        C_DEBUGSTR(" ==== ----> Ignoring, entirely below base\n");
-                        continue;
-                    } else {
-                        // This block extends beyond the managed base, so adjust the
-                        // start
-                        C_DEBUGSTR(" ==== ----> Adjusting, partially below "
-                                   "base\n");
-                        start = managed_base;
-                    }
-                }
-
-                // Calculate number of bytes remaining...
-                uint64_t total_bytes = end - start;
-
-                // Just in case we get a block < 4KiB
-                if (total_bytes == 0) {
-                    continue;
-                }
-
-                region->size += total_bytes;
-                region->free += total_bytes;
-
-                // Stack this block
-                region->sp++;
-                region->sp->base = start;
-                region->sp->size = total_bytes >> VM_PAGE_LINEAR_SHIFT; // size is pages, not bytes...
-
-                break;
-            }
-        } else {
-            C_DEBUGSTR(" ====> Skipping unavailable region ");
-            C_PRINTHEX64(entry->base, debugchar);
-            C_DEBUGSTR(" of length ");
-            C_PRINTDEC(entry->length, debugchar);
-            C_DEBUGSTR(" [type ");
-            C_PRINTDEC(entry->type, debugchar);
-            C_DEBUGSTR("]\n");
+        uint64_t start, end;
+
+        if (!usable_range(memmap->entries[i], managed_base, reclaim_exec_mods, &start, &end)) {
+            continue;
         }
+
+        const uint64_t total_bytes = end - start;
+
+        region->size += total_bytes;
+        region->free += total_bytes;
+
+        // Stack this block
+        region->sp++;
+        region->sp->base = start;
+        region->sp->size = total_bytes >> VM_PAGE_LINEAR_SHIFT; // size is pages, not bytes...
     }
 
     return region;
@@ -177,7 +342,7 @@ uintptr_t page_alloc_m(MemoryRegion *region, uint64_t count) {
             uint64_t page = ptr->base;
 
             hprintf("  Split block and allocate 0x%016x\n", page);
-            ptr->base += VM_PAGE_SIZE;
+            ptr->base += (count << VM_PAGE_LINEAR_SHIFT);
             ptr->size -= count;
 
             region->free -= (count << VM_PAGE_LINEAR_SHIFT);
@@ -213,11 +378,9 @@ uintptr_t page_alloc_m(MemoryRegion *region, uint64_t count) {
     return 0xFF;
 }
 
-uintptr_t page_alloc(MemoryRegion *region) {
-    uint64_t lock_flags = spinlock_lock_irqsave(&region->lock);
-
+// Caller must hold the region lock
+static inline uintptr_t alloc_page_locked(MemoryRegion *region) {
     if (stack_empty(region)) {
-        spinlock_unlock_irqrestore(&region->lock, lock_flags);
         return 0xFF;
     }
 
@@ -229,25 +392,18 @@ uintptr_t page_alloc(MemoryRegion *region) {
         region->sp->base += VM_PAGE_SIZE;
         region->sp->size--;
 
-        spinlock_unlock_irqrestore(&region->lock, lock_flags);
         return page;
     } else {
         // Must be exactly one page in this block - just pop and return
         uint64_t page = region->sp->base;
         region->sp--;
 
-        spinlock_unlock_irqrestore(&region->lock, lock_flags);
         return page;
     }
 }
 
-void page_free(MemoryRegion *region, uintptr_t page) {
-    // No-op unaligned addresses...
-    if (page & 0xFFF) {
-        return;
-    }
-
-    uint64_t lock_flags = spinlock_lock_irqsave(&region->lock);
+// Caller must hold the region lock
+static inline void free_page_locked(MemoryRegion *region, uintptr_t page) {
     region->free += VM_PAGE_SIZE;
 
 #ifndef NO_PMM_FREE_COALESCE_ADJACENT
@@ -256,14 +412,10 @@ void page_free(MemoryRegion *region, uintptr_t page) {
             // Freeing page below current stack top, so just rebase and resize
             region->sp->base = page;
             region->sp->size += 1;
-
-            spinlock_unlock_irqrestore(&region->lock, lock_flags);
             return;
         } else if (region->sp->base == page - VM_PAGE_SIZE) {
             // Freeing page above current stack top, so just resize
             region->sp->size += 1;
-
-            spinlock_unlock_irqrestore(&region->lock, lock_flags);
             return;
         }
     }
@@ -273,5 +425,319 @@ void page_free(MemoryRegion *region, uintptr_t page) {
     region->sp++;
     region->sp->base = page;
     region->sp->size = 1;
+}
+#endif
+
+static inline bool cpu_caches_enabled(MemoryRegion *region) {
+    return __atomic_load_n(&region->flags, __ATOMIC_RELAXED) & PMM_REGION_FLAG_CPU_CACHES;
+}
+
+// Interrupts must be disabled, and the cache locked
+static inline void cache_refill(MemoryRegion *region, PerCPUPageCache *cache) {
+    spinlock_lock(&region->lock);
+
+    while (cache->count < PMM_CPU_CACHE_BATCH) {
+        const uintptr_t page = alloc_page_locked(region);
+
+        if (page & 0xFFF) {
+            break;
+        }
+
+        cache->pages[cache->count++] = page;
+    }
+
+    spinlock_unlock(&region->lock);
+}
+
+// Interrupts must be disabled, and the cache locked
+static inline void cache_drain(MemoryRegion *region, PerCPUPageCache *cache) {
+    spinlock_lock(&region->lock);
+
+    // Give back the oldest, they're least likely to still be in cache
+    for (int i = 0; i < PMM_CPU_CACHE_BATCH; i++) {
+        free_page_locked(region, cache->pages[i]);
+    }
+
+    for (int i = PMM_CPU_CACHE_BATCH; i < cache->count; i++) {
+        cache->pages[i - PMM_CPU_CACHE_BATCH] = cache->pages[i];
+    }
+
+    cache->count -= PMM_CPU_CACHE_BATCH;
+
+    spinlock_unlock(&region->lock);
+}
+
+// Interrupts must be disabled
+static inline uintptr_t cache_alloc(MemoryRegion *region, PerCPUPageCache *cache) {
+    spinlock_lock(&cache->lock);
+
+    if (cache->count) {
+        cache->alloc_hits++;
+    } else {
+        cache->alloc_misses++;
+        cache_refill(region, cache);
+    }
+
+    const uintptr_t page = cache->count ? cache->pages[--cache->count] : 0xFF;
+
+    spinlock_unlock(&cache->lock);
+
+    return page;
+}
+
+// Interrupts must be disabled
+static inline uint64_t cache_take(PerCPUPageCache *cache, uintptr_t *pages, const uint64_t count) {
+    uint64_t got = 0;
+
+    spinlock_lock(&cache->lock);
+
+    while (got < count && cache->count) {
+        pages[got++] = cache->pages[--cache->count];
+    }
+
+    spinlock_unlock(&cache->lock);
+
+    return got;
+}
+
+// Interrupts must be disabled, and this CPU's cache not locked. Once this
+// CPU's cache and the region are empty, takes free pages from everyone
+// else's caches, so they can't get stranded there while allocations fail.
+static uint64_t cache_take_any(uintptr_t *pages, const uint64_t count) {
+    const PerCPUPageCache *own = &state_get_for_this_cpu()->page_cache;
+    uint64_t got = 0;
+
+    for (int i = 0; got < count && i < state_get_cpu_count(); i++) {
+        PerCPUPageCache *cache = &state_get_for_any_cpu(i)->page_cache;
+
+        // Don't bother with the lock for the ones that are obviously empty
+        if (cache != own && __atomic_load_n(&cache->count, __ATOMIC_RELAXED)) {
+            got += cache_take(cache, pages + got, count - got);
+        }
+    }
+
+    return got;
+}
+
+// Interrupts must be disabled
+static inline uint64_t pool_take(PerCPUZeroPool *pool, uintptr_t *pages, const uint64_t count) {
+    uint64_t got = 0;
+
+    spinlock_lock(&pool->lock);
+
+    while (got < count && pool->count) {
+        pages[got++] = pool->pages[--pool->count];
+    }
+
+    spinlock_unlock(&pool->lock);
+
+    return got;
+}
+
+// Interrupts must be disabled. Last resort once the cache and region are
+// empty - takes zeroed pages from this CPU's pool, then anyone else's, so
+// pages can't get stranded in pools while allocations fail.
+static uint64_t pool_take_any(uintptr_t *pages, const uint64_t count) {
+    PerCPUZeroPool *own = &state_get_for_this_cpu()->zero_pool;
+    uint64_t got = pool_take(own, pages, count);
+
+    for (int i = 0; got < count && i < state_get_cpu_count(); i++) {
+        PerCPUZeroPool *pool = &state_get_for_any_cpu(i)->zero_pool;
+
+        // Don't bother with the lock for the ones that are obviously empty
+        if (pool != own && __atomic_load_n(&pool->count, __ATOMIC_RELAXED)) {
+            got += pool_take(pool, pages + got, count - got);
+        }
+    }
+
+    return got;
+}
+
+uintptr_t page_alloc(MemoryRegion *region) {
+    if (cpu_caches_enabled(region)) {
+        const uint64_t intr_flags = save_disable_interrupts();
+        uintptr_t page = cache_alloc(region, &state_get_for_this_cpu()->page_cache);
+
+        // Plain free pages stuck elsewhere before ones that have already been zeroed
+        if ((page & 0xFF) && !cache_take_any(&page, 1)) {
+            pool_take_any(&page, 1);
+        }
+
+        restore_saved_interrupts(intr_flags);
+        return page;
+    }
+
+    uint64_t lock_flags = spinlock_lock_irqsave(&region->lock);
+    const uintptr_t page = alloc_page_locked(region);
+    spinlock_unlock_irqrestore(&region->lock, lock_flags);
+
+    return page;
+}
+
+uintptr_t page_alloc_for_zeroing(MemoryRegion *region) {
+    if (!cpu_caches_enabled(region)) {
+        // No pools yet, so nothing to avoid
+        return page_alloc(region);
+    }
+
+    const uint64_t intr_flags = save_disable_interrupts();
+    const uintptr_t page = cache_alloc(region, &state_get_for_this_cpu()->page_cache);
+    restore_saved_interrupts(intr_flags);
+
+    return page;
+}
+
+uint64_t page_alloc_batch(MemoryRegion *region, uintptr_t *pages, const uint64_t count) {
+    uint64_t got = 0;
+
+    if (cpu_caches_enabled(region)) {
+        const uint64_t intr_flags = save_disable_interrupts();
+        PerCPUPageCache *cache = &state_get_for_this_cpu()->page_cache;
+
+        spinlock_lock(&cache->lock);
+
+        while (got < count && cache->count) {
+            pages[got++] = cache->pages[--cache->count];
+        }
+
+        cache->alloc_hits += got;
+
+        if (got < count) {
+            cache->alloc_misses++;
+        }
+
+        spinlock_unlock(&cache->lock);
+        restore_saved_interrupts(intr_flags);
+
+        if (got == count) {
+            return got;
+        }
+    }
+
+    // Whatever the cache couldn't cover comes straight from the region
+    const uint64_t lock_flags = spinlock_lock_irqsave(&region->lock);
+
+    while (got < count) {
+        const uintptr_t page = alloc_page_locked(region);
+
+        if (page & 0xFFF) {
+            break;
+        }
+
+        pages[got++] = page;
+    }
+
     spinlock_unlock_irqrestore(&region->lock, lock_flags);
-}
\ No newline at end of file
+
+    if (got < count && cpu_caches_enabled(region)) {
+        const uint64_t intr_flags = save_disable_interrupts();
+        got += cache_take_any(pages + got, count - got);
+
+        if (got < count) {
+            got += pool_take_any(pages + got, count - got);
+        }
+
+        restore_saved_interrupts(intr_flags);
+    }
+
+    return got;
+}
+
+void page_free(MemoryRegion *region, uintptr_t page) {
+    // No-op unaligned addresses...
+    if (page & 0xFFF) {
+        return;
+    }
+
+    if (cpu_caches_enabled(region)) {
+        const uint64_t intr_flags = save_disable_interrupts();
+        PerCPUPageCache *cache = &state_get_for_this_cpu()->page_cache;
+
+        spinlock_lock(&cache->lock);
+
+        if (cache->count < PMM_CPU_CACHE_SIZE) {
+            cache->free_hits++;
+        } else {
+            cache->free_misses++;
+            cache_drain(region, cache);
+        }
+
+        cache->pages[cache->count++] = page;
+
+        spinlock_unlock(&cache->lock);
+        restore_saved_interrupts(intr_flags);
+        return;
+    }
+
+    uint64_t lock_flags = spinlock_lock_irqsave(&region->lock);
+    free_page_locked(region, page);
+    spinlock_unlock_irqrestore(&region->lock, lock_flags);
+}
+
+uint64_t page_alloc_zeroed_batch(MemoryRegion *region, uintptr_t *pages, const uint64_t count) {
+    if (!cpu_caches_enabled(region)) {
+        return 0;
+    }
+
+    const uint64_t intr_flags = save_disable_interrupts();
+    PerCPUZeroPool *pool = &state_get_for_this_cpu()->zero_pool;
+    const uint64_t got = pool_take(pool, pages, count);
+
+    pool->hits += got;
+    pool->misses += count - got;
+
+    restore_saved_interrupts(intr_flags);
+    return got;
+}
+
+uintptr_t page_alloc_zeroed(MemoryRegion *region) {
+    uintptr_t page;
+    return page_alloc_zeroed_batch(region, &page, 1) ? page : 0xFF;
+}
+
+bool page_free_zeroed(MemoryRegion *region, const uintptr_t page) {
+    if (!cpu_caches_enabled(region) || (page & 0xFFF)) {
+        return false;
+    }
+
+    const uint64_t intr_flags = save_disable_interrupts();
+    PerCPUZeroPool *pool = &state_get_for_this_cpu()->zero_pool;
+
+    spinlock_lock(&pool->lock);
+    const bool room = pool->count < PMM_ZERO_POOL_SIZE;
+
+    if (room) {
+        pool->pages[pool->count++] = page;
+        pool->zeroed++;
+    }
+    spinlock_unlock(&pool->lock);
+
+    restore_saved_interrupts(intr_flags);
+    return room;
+}
+
+bool page_zero_pool_full(MemoryRegion *region) {
+    if (!cpu_caches_enabled(region)) {
+        return true;
+    }
+
+    // Only this CPU adds to it, so no need for the lock just to look
+    return __atomic_load_n(&state_get_for_this_cpu()->zero_pool.count, __ATOMIC_RELAXED) == PMM_ZERO_POOL_SIZE;
+}
+
+void page_alloc_notify_smp_started(MemoryRegion *region) {
+    __atomic_or_fetch(&region->flags, PMM_REGION_FLAG_CPU_CACHES, __ATOMIC_RELEASE);
+}
+
+uint64_t page_alloc_free_bytes(MemoryRegion *region) {
+    uint64_t free = region->free;
+
+    if (cpu_caches_enabled(region)) {
+        for (int i = 0; i < state_get_cpu_count(); i++) {
+            const PerCPUState *state = state_get_for_any_cpu(i);
+            free += (state->page_cache.count + state->zero_pool.count) << VM_PAGE_LINEAR_SHIFT;
+        }
+    }
+
+    return free;
+}
@@ -0,0 +1,158 @@
+/*
+ * stage3 - Physical frame database
+ * anos - An Operating System
+ *
+ * Copyright (c) 2025 Ross Bamford
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "pmm/pagealloc.h"
+#include "pmm/pfndb.h"
+#include "vmm/vmconfig.h"
+#include "vmm/vmmapper.h"
+
+#ifndef NULL
+#define NULL (((void *)0))
+#endif
+
+// Set once at boot, read-only after that
+static PageFrame *frames;
+static uint64_t frame_count;
+
+extern MemoryRegion *physical_region;
+
+#ifdef UNIT_TESTS
+void test_pfndb_reset(void) {
+    frames = NULL;
+    frame_count = 0;
+}
+#endif
+
+static inline bool is_ram(const Limine_MemMapEntry *entry) {
+    switch (entry->type) {
+    case LIMINE_MEMMAP_USABLE:
+    case LIMINE_MEMMAP_ACPI_RECLAIMABLE:
+    case LIMINE_MEMMAP_BOOTLOADER_RECLAIMABLE:
+    case LIMINE_MEMMAP_EXECUTABLE_AND_MODULES:
+        return entry->length > 0;
+    default:
+        return false;
+    }
+}
+
+bool pfndb_init(uint64_t *pml4, const uintptr_t begin, const Limine_MemMap *memmap) {
+    if (begin & 0xfff) {
+        return false;
+    }
+
+    uint64_t top = 0;
+
+    for (int i = 0; i < memmap->entry_count; i++) {
+        const Limine_MemMapEntry *entry = memmap->entries[i];
+
+        if (is_ram(entry) && entry->base + entry->length > top) {
+            top = entry->base + entry->length;
+        }
+    }
+
+    const uint64_t count = (top + VM_PAGE_SIZE - 1) >> VM_PAGE_LINEAR_SHIFT;
+    const uint64_t bytes = count * sizeof(PageFrame);
+
+    if (bytes > PFNDB_SIZE) {
+        return false;
+    }
+
+    const uint64_t pages = (bytes + VM_PAGE_SIZE - 1) >> VM_PAGE_LINEAR_SHIFT;
+
+    for (uint64_t i = 0; i < pages; i++) {
+        const uintptr_t phys = page_alloc(physical_region);
+
+        if (phys & 0xfff) {
+            // As with the FBA, we expect a panic if this fails, so not freeing what we already have...
+            return false;
+        }
+
+        if (!vmm_map_page_in(pml4, begin + (i << VM_PAGE_LINEAR_SHIFT), phys, PG_PRESENT | PG_READ | PG_WRITE)) {
+            return false;
+        }
+    }
+
+    uint64_t *ptr = (uint64_t *)begin;
+
+    for (uint64_t i = 0; i < (pages << VM_PAGE_LINEAR_SHIFT) / sizeof(uint64_t); i++) {
+        *ptr++ = 0;
+    }
+
+    PageFrame *db = (PageFrame *)begin;
+
+    for (int i = 0; i < memmap->entry_count; i++) {
+        const Limine_MemMapEntry *entry = memmap->entries[i];
+
+        if (!is_ram(entry)) {
+            continue;
+        }
+
+        const uint64_t first = entry->base >> VM_PAGE_LINEAR_SHIFT;
+        const uint64_t last = (entry->base + entry->length + VM_PAGE_SIZE - 1) >> VM_PAGE_LINEAR_SHIFT;
+
+        for (uint64_t pfn = first; pfn < last; pfn++) {
+            db[pfn].flags = PAGE_FRAME_FLAG_RAM;
+        }
+    }
+
+    frames = db;
+    frame_count = count;
+
+    return true;
+}
+
+uint64_t pfndb_frame_count(void) { return frame_count; }
+
+PageFrame *pfndb_lookup(const uintptr_t phys) {
+    const uint64_t pfn = phys >> VM_PAGE_LINEAR_SHIFT;
+
+    if (pfn >= frame_count) {
+        return NULL;
+    }
+
+    return &frames[pfn];
+}
+
+uint32_t pfndb_ref_increment(const uintptr_t phys) {
+    PageFrame *frame = pfndb_lookup(phys);
+
+    if (!frame) {
+        return 0;
+    }
+
+    return __atomic_add_fetch(&frame->refcount, 1, __ATOMIC_ACQ_REL);
+}
+
+uint32_t pfndb_ref_decrement(const uintptr_t phys) {
+    PageFrame *frame = pfndb_lookup(phys);
+
+    if (!frame) {
+        return 0;
+    }
+
+    uint32_t current = __atomic_load_n(&frame->refcount, __ATOMIC_RELAXED);
+
+    do {
+        if (current == 0) {
+            return 0;
+        }
+    } while (!__atomic_compare_exchange_n(&frame->refcount, &current, current - 1, false, __ATOMIC_ACQ_REL,
+                                          __ATOMIC_RELAXED));
+
+    return current;
+}
+
+void pfndb_set_owner(const uintptr_t phys, const uint64_t pid) {
+    PageFrame *frame = pfndb_lookup(phys);
+
+    if (frame) {
+        __atomic_store_n(&frame->owner, pid, __ATOMIC_RELEASE);
+    }
+}
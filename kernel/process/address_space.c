@@ -8,12 +8,12 @@
 #include <stdbool.h>
 #include <stdint.h>
 
+#include "machine.h"
 #include "pmm/pagealloc.h"
+#include "pmm/pfndb.h"
 #include "process/address_space.h"
 #include "sched.h"
 #include "smp/state.h"
-#include "spinlock.h"
-#include "structs/ref_count_map.h"
 #include "vmm/vmmapper.h"
 
 #ifdef DEBUG_ADDR_SPACE
@@ -45,8 +45,6 @@
 
 #define KERNEL_BEGIN_ENTRY FIRST_KERNEL_PML4E
 
-static SpinLock address_space_lock;
-
 extern MemoryRegion *physical_region;
 
 bool address_space_init(void) {
@@ -79,6 +77,35 @@ bool address_space_init(void) {
     return true;
 }
 
+// Enough pages at the top of a new stack for its initial values, and at least one
+static inline size_t init_stack_committed_pages(const size_t init_stack_len, const int stack_value_count) {
+    const size_t value_pages = (stack_value_count * sizeof(uintptr_t) + VM_PAGE_SIZE - 1) >> VM_PAGE_LINEAR_SHIFT;
+    const size_t stack_pages = init_stack_len >> VM_PAGE_LINEAR_SHIFT;
+    const size_t pages = value_pages ? value_pages : 1;
+
+    return pages < stack_pages ? pages : stack_pages;
+}
+
+bool address_space_init_stack_region(uintptr_t init_stack_vaddr, const size_t init_stack_len,
+                                     const int stack_value_count, uintptr_t *region_start, uintptr_t *region_end) {
+    init_stack_vaddr &= ~(0xfff);
+
+    const size_t committed = init_stack_committed_pages(init_stack_len, stack_value_count);
+
+    // The bottom page stays unmapped (and out of the region), so running off
+    // the end of the stack faults rather than scribbling on whatever's below
+    const uintptr_t start = init_stack_vaddr + VM_PAGE_SIZE;
+    const uintptr_t end = init_stack_vaddr + (init_stack_len & ~(0xfff)) - (committed << VM_PAGE_LINEAR_SHIFT);
+
+    if (end <= start) {
+        return false;
+    }
+
+    *region_start = start;
+    *region_end = end;
+    return true;
+}
+
 uintptr_t address_space_create(uintptr_t init_stack_vaddr, const size_t init_stack_len, const int region_count,
                                AddressSpaceRegion regions[], const int stack_value_count,
                                const uint64_t *stack_values) {
@@ -133,7 +160,8 @@ uintptr_t address_space_create(uintptr_t init_stack_vaddr, const size_t init_sta
         return 0;
     }
 
-    const uint64_t lock_flags = spinlock_lock_irqsave(&address_space_lock);
+    // Nothing else can see the new tables until we return them, so there's
+    // no locking to do here - the mapper locks them as it goes...
 
     // Find current pml4
     const PageTable *current_pml4 = vmm_find_pml4();
@@ -184,7 +212,7 @@ uintptr_t address_space_create(uintptr_t init_stack_vaddr, const size_t init_sta
 
                 // TODO pmm_free_shareable(page) needs implementing to check this and handle appropriately...
                 //
-                refcount_map_increment(shared_phys);
+                pfndb_ref_increment(shared_phys);
 
                 debugstr("    Copied a page mapping as COW...\n");
             } else {
@@ -202,15 +230,16 @@ uintptr_t address_space_create(uintptr_t init_stack_vaddr, const size_t init_sta
     //
     uint64_t top_phys_stack_pages[INIT_STACK_ARG_PAGES_COUNT];
 
-    // sort out the requested initial stack, we allocate it in reverse so
-    // that the ARG_PAGES pages we store in the top_phys_stack_pages array will
-    // actually be the ones at the top of the stack...
-    //
-    // TODO should only allocate one here, and let #PF handler sort the rest...
+    // Only the pages the initial values go in are allocated now, top down so
+    // they're in order in top_phys_stack_pages. The rest of the stack is an
+    // automap region (see address_space_init_stack_region) and comes in as
+    // it's used.
     if (init_stack_len) {
+        const size_t committed = init_stack_committed_pages(init_stack_len, stack_value_count);
         uint8_t current_top_phys_page_idx = 0;
 
-        for (uintptr_t ptr = init_stack_end - VM_PAGE_SIZE; ptr >= init_stack_vaddr; ptr -= VM_PAGE_SIZE) {
+        for (size_t page = 1; page <= committed; page++) {
+            const uintptr_t ptr = init_stack_end - (page << VM_PAGE_LINEAR_SHIFT);
 
             const uintptr_t stack_page = page_alloc(physical_region);
 
@@ -229,7 +258,6 @@ uintptr_t address_space_create(uintptr_t init_stack_vaddr, const size_t init_sta
                 // have yet, so we'll just fail and leak the memory for now...
 
                 cpu_invalidate_tlb_addr((uintptr_t)new_pml4_virt);
-                spinlock_unlock_irqrestore(&address_space_lock, lock_flags);
 
                 return 0;
             }
@@ -249,27 +277,24 @@ uintptr_t address_space_create(uintptr_t init_stack_vaddr, const size_t init_sta
     // Copy in the requested initial stack values to the bottom
     // stack page. We'll need to temporarily map it.
 
-    // TODO potential race condition here, if we get rescheduled onto
-    // a different CPU, and this CPU then goes on to do stuff that
-    // needs the temp mapping, this will go wrong.
-    //
-    // Could be done with locking or a crititcal section of some
-    // sort, but I dislike the whole per-CPU temp mapping idea tbh, need
-    // to come up with something better...
+    // We mustn't get rescheduled (onto another CPU, or in favour of
+    // something else that wants this CPU's temp page) while using it,
+    // so interrupts stay off until we're done with it.
     //
-    // (it's actually worse than that - all it needs is for us to get
-    // interrupted by some other thread in this process that also uses the temp
-    // mapping page, and we're done - it's global (to the address space) state.
+    // I dislike the whole per-CPU temp mapping idea tbh, need to come
+    // up with something better...
+    const uint64_t intr_flags = save_disable_interrupts();
 
     const PerCPUState *state = state_get_for_this_cpu();
     const uintptr_t per_cpu_temp_page = vmm_per_cpu_temp_page_addr(state->cpu_id);
 
     uint64_t volatile *temp_stack_bottom = (uint64_t *)per_cpu_temp_page;
+    uint8_t next_top_phys_page_idx = 0;
 
     for (int i = stack_value_count - 1; i >= 0; i--) {
         if (temp_stack_bottom == (uint64_t *)per_cpu_temp_page) {
-            // reached bottom of temp page, need to map the next one
-            const uintptr_t phys = top_phys_stack_pages[i >> 9];
+            // reached bottom of temp page, need to map the next one down
+            const uintptr_t phys = top_phys_stack_pages[next_top_phys_page_idx++];
             vmm_map_page(per_cpu_temp_page, phys, PG_READ | PG_WRITE | PG_PRESENT);
             temp_stack_bottom = (uint64_t *)(per_cpu_temp_page + VM_PAGE_SIZE);
         }
@@ -278,9 +303,9 @@ uintptr_t address_space_create(uintptr_t init_stack_vaddr, const size_t init_sta
     }
 
     vmm_unmap_page(per_cpu_temp_page);
+    restore_saved_interrupts(intr_flags);
 
     cpu_invalidate_tlb_addr((uintptr_t)new_pml4_virt);
-    spinlock_unlock_irqrestore(&address_space_lock, lock_flags);
 
     return new_pml4_phys;
 }
\ No newline at end of file
@@ -11,9 +11,10 @@
 
 #include "fba/alloc.h"
 #include "pmm/pagealloc.h"
+#include "pmm/pfndb.h"
 #include "process.h"
 #include "process/memory.h"
-#include "structs/ref_count_map.h"
+#include "vmm/vmconfig.h"
 
 #if (__STDC_VERSION__ < 202000)
 // TODO Apple clang doesn't support nullptr yet - May 2025
@@ -44,7 +45,7 @@ bool process_add_owned_page(Process *proc, MemoryRegion *region, uintptr_t phys_
         proc->meminfo->pages->head = nullptr;
     }
 
-    if (shared && refcount_map_increment(phys_addr) == 0) {
+    if (shared && pfndb_ref_increment(phys_addr) == 0) {
         spinlock_unlock_irqrestore(proc->meminfo->pages_lock, flags);
         return false;
     }
@@ -65,6 +66,11 @@ bool process_add_owned_page(Process *proc, MemoryRegion *region, uintptr_t phys_
     }
 
     blk->pages[blk->count++] = (ProcessPageEntry){.region = region, .addr = phys_addr};
+
+    if (!shared) {
+        pfndb_set_owner(phys_addr, proc->pid);
+    }
+
     spinlock_unlock_irqrestore(proc->meminfo->pages_lock, flags);
     return true;
 }
@@ -81,9 +87,10 @@ bool process_remove_owned_page(Process *proc, uintptr_t phys_addr) {
     while (blk) {
         for (uint16_t i = 0; i < blk->count; ++i) {
             if (blk->pages[i].addr == phys_addr) {
-                uint32_t prev_ref = refcount_map_decrement(phys_addr);
+                uint32_t prev_ref = pfndb_ref_decrement(phys_addr);
 
                 if (prev_ref <= 1) {
+                    pfndb_set_owner(phys_addr, 0);
                     page_free(blk->pages[i].region, phys_addr);
                 }
 
@@ -124,9 +131,10 @@ void process_release_owned_pages(Process *proc) {
             uint64_t addr = blk->pages[i].addr;
             void *region = blk->pages[i].region;
 
-            uint32_t prev = refcount_map_decrement(addr);
+            uint32_t prev = pfndb_ref_decrement(addr);
 
             if (prev <= 1) {
+                pfndb_set_owner(addr, 0);
                 page_free(region, addr);
             }
         }
@@ -161,6 +169,74 @@ uintptr_t process_page_alloc(Process *proc, MemoryRegion *region) {
     return addr;
 }
 
+uint64_t process_pages_alloc(Process *proc, MemoryRegion *region, uintptr_t *pages, const uint64_t count,
+                             uint64_t *zeroed) {
+    if (!proc) {
+        return 0;
+    }
+
+    uint64_t got = 0;
+
+    if (zeroed) {
+        got = *zeroed = page_alloc_zeroed_batch(region, pages, count);
+    }
+
+    got += page_alloc_batch(region, pages + got, count - got);
+
+    for (uint64_t i = 0; i < got; i++) {
+        if (!process_add_owned_page(proc, region, pages[i], false)) {
+            // Keep the ones we managed to own, give the rest back
+            for (uint64_t j = i; j < got; j++) {
+                page_free(region, pages[j]);
+            }
+
+            if (zeroed && *zeroed > i) {
+                *zeroed = i;
+            }
+
+            return i;
+        }
+    }
+
+    return got;
+}
+
+uintptr_t process_page_alloc_large(Process *proc, MemoryRegion *region) {
+#ifdef PMM_BUDDY
+    if (!proc) {
+        return 0xff;
+    }
+
+    const uint64_t count = MEGA_PAGE_SIZE >> VM_PAGE_LINEAR_SHIFT;
+    const uintptr_t addr = page_alloc_m(region, count);
+
+    if ((addr & 0xff)) {
+        return addr;
+    }
+
+    for (uint64_t i = 0; i < count; i++) {
+        if (!process_add_owned_page(proc, region, addr + (i << VM_PAGE_LINEAR_SHIFT), false)) {
+            // Owned ones get freed as they're removed, the rest we free directly
+            for (uint64_t j = 0; j < count; j++) {
+                const uintptr_t page = addr + (j << VM_PAGE_LINEAR_SHIFT);
+
+                if (j < i) {
+                    process_remove_owned_page(proc, page);
+                } else {
+                    page_free(region, page);
+                }
+            }
+
+            return 0xff;
+        }
+    }
+
+    return addr;
+#else
+    return 0xff;
+#endif
+}
+
 bool process_page_free(Process *proc, uintptr_t phys_addr) {
     if (!proc) {
         return false;
@@ -82,9 +82,23 @@ Process *process_create(uintptr_t pml4) {
         return nullptr;
     }
 
+    ProcessCpus *cpus = slab_alloc_block();
+
+    if (!cpus) {
+        slab_free(lock);
+        slab_free(meminfo);
+        slab_free(process);
+        return nullptr;
+    }
+
     process->pid = next_pid++;
     process->pml4 = cpu_make_pagetable_register_value(pml4);
     process->cap_failures = 0;
+    process->ipc_completions = nullptr;
+    process->reserved = 0;
+
+    cpu_mask_clear_all(&cpus->cpu_mask);
+    cpu_mask_clear_all(&cpus->tlb_stale_mask);
 
     meminfo->pages = nullptr;
     meminfo->pages_lock = lock;
@@ -92,6 +106,7 @@ Process *process_create(uintptr_t pml4) {
     meminfo->regions = nullptr;
 
     process->meminfo = meminfo;
+    process->cpus = cpus;
 
     return process;
 }
@@ -125,6 +140,7 @@ void process_destroy(Process *process) {
     region_tree_free_all(&process->meminfo->regions);
     slab_free(process->meminfo->pages_lock);
     slab_free(process->meminfo);
+    slab_free(process->cpus);
     slab_free(process);
 }
 
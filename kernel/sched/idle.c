@@ -10,15 +10,61 @@
  * 
  * It cannot exit, sleep, send messages or otherwise block.
  * 
+ * While it's here anyway, it keeps this CPU's pool of pre-zeroed
+ * pages topped up (unless NO_ZERO_POOL) so faults don't have to
+ * zero them - one page at a time, with interrupts on, so anything
+ * that becomes runnable meanwhile doesn't have to wait long.
+ * 
  * The scheduler itself is responsible for setting this up...
  */
 
+#include <stdbool.h>
+#include <stdint.h>
 #include <stdnoreturn.h>
 
 #include "machine.h"
+#include "pmm/pagealloc.h"
+#include "std/string.h"
+#include "vmm/vmconfig.h"
+#include "vmm/vmmapper.h"
+
+extern MemoryRegion *physical_region;
+
+#ifndef NO_ZERO_POOL
+static bool zero_one_page(void) {
+    if (page_zero_pool_full(physical_region)) {
+        return false;
+    }
+
+    // Never takes already-zeroed pages, so this stops once memory's that
+    // tight rather than going round and round (or robbing other CPUs)
+    const uintptr_t page = page_alloc_for_zeroing(physical_region);
+
+    if (page & 0xff) {
+        return false;
+    }
+
+    // Nobody will look at it till it comes out of the pool, so no sense
+    // evicting anything else from the cache for it
+    memclr_page_nt(vmm_phys_to_virt_ptr(page));
+
+    if (!page_free_zeroed(physical_region, page)) {
+        page_free(physical_region, page);
+        return false;
+    }
+
+    return true;
+}
+#endif
 
 noreturn void sched_idle_thread(void) {
     while (1) {
+#ifndef NO_ZERO_POOL
+        if (zero_one_page()) {
+            continue;
+        }
+#endif
+
         wait_for_interrupt();
     }
 }
@@ -6,13 +6,19 @@
  */
 
 #include "anos_assert.h"
+#include "config.h"
 #include "debugprint.h"
 #include "fba/alloc.h"
+#include "machine.h"
 #include "printhex.h"
 #include "process.h"
+#include "sched.h"
 #include "slab/alloc.h"
+#include "sleep_queue.h"
+#include "smp/ipwi.h"
 #include "smp/state.h"
-#include "structs/pq.h"
+#include "spinlock.h"
+#include "structs/runqueue.h"
 #include "task.h"
 #include "vmm/vmmapper.h"
 
@@ -37,13 +43,39 @@
 #endif
 
 typedef per_cpu struct {
-    TaskPriorityQueue realtime_head;
-    TaskPriorityQueue high_head;
-    TaskPriorityQueue normal_head;
-    TaskPriorityQueue idle_head;
+    TaskRunQueue realtime_head;
+    TaskRunQueue high_head;
+    TaskRunQueue normal_head;
+    TaskRunQueue idle_head;
     uint64_t all_queue_total;
+    uint64_t busy_queue_total; // Queued tasks that aren't TASK_CLASS_IDLE
+    uint64_t load_tick;
+    uint64_t next_balance_tick;
+    SchedBalanceStats balance;
+    uint64_t slice_start;    // Nanos the running timeslice was last charged at (tickless only)
+    uint64_t timer_deadline; // Nanos the one-shot timer is armed for (tickless only)
+    TaskClass running_class; // Class of the task this CPU last switched to
+    Task *deferred_wakeups;  // Pushed by CPUs that couldn't take our lock, taken under it
 } PerCPUSchedState;
 
+// One page of level lists for each class queue
+#define SCHED_RUN_QUEUE_COUNT ((4))
+
+// Load average decays by 1/8th of the difference each tick
+#define SCHED_LOAD_DECAY_SHIFT ((3))
+
+// Busy CPUs only look for work to pull this often (in ticks)
+#define SCHED_BALANCE_INTERVAL ((16))
+
+// How far (in queued tasks) a busy CPU must be behind before it pulls
+#define SCHED_BALANCE_IMBALANCE ((2))
+
+// Tasks that were running within this many ticks are considered
+// cache-hot, and left where they are.
+#define SCHED_MIGRATION_COST_TICKS ((2))
+
+static_assert(TASK_RQ_LEVELS_BYTES == VM_PAGE_SIZE, "Run queue levels must be exactly one page");
+
 static_assert_sizeof(PerCPUSchedState, <=, STATE_SCHED_DATA_MAX);
 
 #ifdef DEBUG_TASK_SWITCH
@@ -79,26 +111,37 @@ static inline PerCPUSchedState *get_this_cpu_sched_state(void) {
     return (PerCPUSchedState *)cpu_state->sched_data;
 }
 
-static inline PerCPUSchedState *get_any_cpu_sched_state(uint8_t cpu_num) {
+static inline PerCPUSchedState *get_any_cpu_sched_state(uint16_t cpu_num) {
     PerCPUState *cpu_state = state_get_for_any_cpu(cpu_num);
     return (PerCPUSchedState *)cpu_state->sched_data;
 }
 
-static inline PerCPUSchedState *init_this_cpu_sched_state(void) {
-    PerCPUSchedState *state = get_this_cpu_sched_state();
+static inline bool sched_state_initialized(PerCPUSchedState *state) { return state->realtime_head.levels != NULL; }
 
-    task_pq_init(&state->realtime_head);
-    task_pq_init(&state->high_head);
-    task_pq_init(&state->normal_head);
-    task_pq_init(&state->idle_head);
+static bool init_cpu_sched_state(PerCPUSchedState *state) {
+    if (sched_state_initialized(state)) {
+        return true;
+    }
+
+    TaskRunList *levels = fba_alloc_blocks(SCHED_RUN_QUEUE_COUNT);
+
+    if (levels == NULL) {
+        return false;
+    }
+
+    task_rq_init(&state->realtime_head, levels);
+    task_rq_init(&state->high_head, levels + TASK_RQ_LEVELS);
+    task_rq_init(&state->normal_head, levels + TASK_RQ_LEVELS * 2);
+    task_rq_init(&state->idle_head, levels + TASK_RQ_LEVELS * 3);
 
     state->all_queue_total = 0;
+    state->busy_queue_total = 0;
 
-    return state;
+    return true;
 }
 
 static bool sched_enqueue_on(Task *task, PerCPUSchedState *cpu) {
-    TaskPriorityQueue *candidate_queue = NULL;
+    TaskRunQueue *candidate_queue = NULL;
 
     printf("REQUEUE\n");
 
@@ -125,7 +168,12 @@ static bool sched_enqueue_on(Task *task, PerCPUSchedState *cpu) {
     }
 
     cpu->all_queue_total++;
-    task_pq_push(candidate_queue, task);
+
+    if (candidate_queue != &cpu->idle_head) {
+        cpu->busy_queue_total++;
+    }
+
+    task_rq_push(candidate_queue, task);
     return true;
 }
 
@@ -134,49 +182,66 @@ static bool sched_enqueue(Task *task) { return sched_enqueue_on(task, get_this_c
 #ifdef UNIT_TESTS
 // TODO there's too much test code leaking into prod code...
 //
-Task *test_sched_prr_get_runnable_head(TaskClass level) {
+static TaskRunQueue *test_sched_prr_get_queue(TaskClass level) {
     switch (level) {
     case TASK_CLASS_REALTIME:
-        return task_pq_peek(&get_this_cpu_sched_state()->realtime_head);
+        return &get_this_cpu_sched_state()->realtime_head;
     case TASK_CLASS_HIGH:
-        return task_pq_peek(&get_this_cpu_sched_state()->high_head);
+        return &get_this_cpu_sched_state()->high_head;
     case TASK_CLASS_NORMAL:
-        return task_pq_peek(&get_this_cpu_sched_state()->normal_head);
+        return &get_this_cpu_sched_state()->normal_head;
     case TASK_CLASS_IDLE:
-        return task_pq_peek(&get_this_cpu_sched_state()->idle_head);
+        return &get_this_cpu_sched_state()->idle_head;
+    default:
+        return NULL;
     }
+}
 
-    return NULL;
+Task *test_sched_prr_get_runnable_head(TaskClass level) {
+    TaskRunQueue *queue = test_sched_prr_get_queue(level);
+
+    if (!queue || !sched_state_initialized(get_this_cpu_sched_state())) {
+        return NULL;
+    }
+
+    return task_rq_peek(queue);
 }
 
+Task *test_sched_prr_pop_runnable_head(TaskClass level) {
+    TaskRunQueue *queue = test_sched_prr_get_queue(level);
+
+    if (!queue || !sched_state_initialized(get_this_cpu_sched_state())) {
+        return NULL;
+    }
+
+    return task_rq_pop(queue);
+}
+
+// Passing NULL empties the queue for the given level, otherwise
+// the task is placed at the front of its priority level.
 Task *test_sched_prr_set_runnable_head(TaskClass level, Task *task) {
-    TaskPriorityQueue *queue;
+    TaskRunQueue *queue = test_sched_prr_get_queue(level);
 
-    switch (level) {
-    case TASK_CLASS_REALTIME:
-        queue = &get_this_cpu_sched_state()->realtime_head;
-        break;
-    case TASK_CLASS_HIGH:
-        queue = &get_this_cpu_sched_state()->high_head;
-        break;
-    case TASK_CLASS_NORMAL:
-        queue = &get_this_cpu_sched_state()->normal_head;
-        break;
-    case TASK_CLASS_IDLE:
-        queue = &get_this_cpu_sched_state()->idle_head;
-        break;
-    default:
+    if (!queue) {
         return NULL;
     }
 
-    Task *old = queue->head;
+    Task *old = task_rq_peek(queue);
+
     if (task) {
-        task->this.next = (ListNode *)old;
+        task_rq_push_front(queue, task);
+    } else {
+        task_rq_init(queue, queue->levels);
     }
-    queue->head = task;
 
     return old;
 }
+
+void test_sched_prr_set_load(uint16_t cpu_num, uint64_t load) { get_any_cpu_sched_state(cpu_num)->balance.load = load; }
+
+void test_sched_prr_set_running_class(uint16_t cpu_num, TaskClass class) {
+    get_any_cpu_sched_state(cpu_num)->running_class = class;
+}
 #endif
 
 // This should only be called on the BSP
@@ -200,6 +265,16 @@ bool sched_init(uintptr_t sys_sp, uintptr_t sys_ssp, uintptr_t start_func, uintp
 
     Task *new_task = task_create_new(new_process, sys_sp, sys_ssp, bootstrap_func, start_func, task_class);
 
+    // All CPUs are registered by now, so set up all their queues here
+    // rather than waiting for the APs - we might want to schedule
+    // onto them before they get around to it themselves.
+    for (int i = 0; i < state_get_cpu_count(); i++) {
+        if (!init_cpu_sched_state(get_any_cpu_sched_state(i))) {
+            process_destroy(new_process);
+            return false;
+        }
+    }
+
     // During init it's just us, no need to lock / unlock
     if (!sched_enqueue(new_task)) {
         process_destroy(new_process);
@@ -219,6 +294,11 @@ bool sched_init_idle(uintptr_t sp, uintptr_t sys_ssp, uintptr_t bootstrap_func)
 
     PerCPUSchedState *state = get_this_cpu_sched_state();
 
+    // Usually already done by sched_init, unless this CPU was late to the party...
+    if (!init_cpu_sched_state(state)) {
+        return false;
+    }
+
     Task *idle_task =
             task_create_new(system_process, sp, sys_ssp, bootstrap_func, (uintptr_t)sched_idle_thread, TASK_CLASS_IDLE);
 
@@ -236,27 +316,261 @@ static inline bool thread_to_be_killed(Task *task) {
     return (task->sched->status_flags & TASK_SCHED_FLAG_KILLED) && !(task->sched->status_flags & TASK_SCHED_FLAG_DYING);
 }
 
+static inline void sched_update_load(PerCPUSchedState *state, uint64_t now) {
+    if (state->load_tick == now) {
+        return;
+    }
+
+    state->load_tick = now;
+
+    const uint64_t sample = state->busy_queue_total << SCHED_LOAD_SHIFT;
+
+    if (sample >= state->balance.load) {
+        state->balance.load += (sample - state->balance.load) >> SCHED_LOAD_DECAY_SHIFT;
+    } else {
+        state->balance.load -= (state->balance.load - sample) >> SCHED_LOAD_DECAY_SHIFT;
+    }
+}
+
+#ifndef NO_SCHED_BALANCE
+static inline bool task_is_cache_hot(Task *task, uint64_t now) {
+    return now - task->sched->last_run < SCHED_MIGRATION_COST_TICKS;
+}
+
+// Idle tasks are never candidates - every CPU has its own.
+static Task *sched_dequeue_migratable(PerCPUSchedState *victim, PerCPUSchedState *state, uint64_t now) {
+    TaskRunQueue *queues[] = {&victim->realtime_head, &victim->high_head, &victim->normal_head};
+
+    for (int i = 0; i < sizeof(queues) / sizeof(queues[0]); i++) {
+        Task *candidate = task_rq_peek(queues[i]);
+
+        if (candidate == NULL) {
+            continue;
+        }
+
+        if (task_is_cache_hot(candidate, now)) {
+            state->balance.hot_skips++;
+            continue;
+        }
+
+        task_rq_pop(queues[i]);
+        victim->all_queue_total--;
+        victim->busy_queue_total--;
+        return candidate;
+    }
+
+    return NULL;
+}
+
+static PerCPUState *sched_find_busiest_cpu(PerCPUSchedState *state, bool idle) {
+    PerCPUState *busiest = NULL;
+    uint64_t busiest_load = 0;
+
+    // Unlocked reads - these are only estimates, and the pull
+    // rechecks everything under the victim's lock.
+    for (int i = 0; i < state_get_cpu_count(); i++) {
+        PerCPUState *candidate = state_get_for_any_cpu(i);
+        PerCPUSchedState *candidate_sched = (PerCPUSchedState *)candidate->sched_data;
+
+        if (candidate_sched == state || !sched_state_initialized(candidate_sched)) {
+            continue;
+        }
+
+        // Idle CPUs will take work from anyone that has some queued right
+        // now, busy ones only from a CPU that's been consistently busier.
+        const uint64_t load = idle ? candidate_sched->busy_queue_total : candidate_sched->balance.load;
+
+        if (load > busiest_load) {
+            busiest = candidate;
+            busiest_load = load;
+        }
+    }
+
+    if (busiest == NULL || idle) {
+        return busiest;
+    }
+
+    PerCPUSchedState *busiest_sched = (PerCPUSchedState *)busiest->sched_data;
+
+    if (busiest_sched->busy_queue_total < SCHED_BALANCE_IMBALANCE ||
+        busiest_load < state->balance.load + (SCHED_BALANCE_IMBALANCE << SCHED_LOAD_SHIFT)) {
+        return NULL;
+    }
+
+    return busiest;
+}
+
+/*
+ * Pull (at most) one task onto this CPU from the busiest sibling.
+ *
+ * We already hold our own sched lock here, so the victim's is only
+ * ever try-locked - two CPUs pulling from each other must never
+ * wait on one another.
+ */
+static void sched_balance(PerCPUSchedState *state, Task *current, uint64_t now) {
+    const bool idle = state->busy_queue_total == 0 &&
+                      (current == NULL || current->sched->class == TASK_CLASS_IDLE ||
+                       current->sched->state != TASK_STATE_RUNNING);
+
+    if (!idle) {
+        if (now < state->next_balance_tick) {
+            return;
+        }
+
+        state->next_balance_tick = now + SCHED_BALANCE_INTERVAL;
+    }
+
+    PerCPUState *victim_cpu = sched_find_busiest_cpu(state, idle);
+
+    if (victim_cpu == NULL) {
+        return;
+    }
+
+    if (!spinlock_try_lock(&victim_cpu->sched_lock_this_cpu)) {
+        state->balance.contended++;
+        return;
+    }
+
+    Task *task = sched_dequeue_migratable((PerCPUSchedState *)victim_cpu->sched_data, state, now);
+
+    spinlock_unlock(&victim_cpu->sched_lock_this_cpu);
+
+    if (task == NULL) {
+        return;
+    }
+
+    tdebug("BALANCE: Pulled ");
+    tdbgx64((uintptr_t)task);
+    tdebug(" from CPU #");
+    tdbgx8(victim_cpu->cpu_id);
+    tdebug("\n");
+
+    if (idle) {
+        state->balance.steals++;
+    } else {
+        state->balance.migrations++;
+    }
+
+    sched_enqueue_on(task, state);
+}
+#else
+static inline void sched_balance(PerCPUSchedState *state, Task *current, uint64_t now) {}
+#endif
+
+#ifdef EXPERIMENTAL_TICKLESS
+/*
+ * There's no periodic tick to count timeslices down, so charge
+ * the running task for the whole ticks that have actually passed
+ * since we last did.
+ */
+static inline void sched_charge_timeslice(PerCPUSchedState *state, Task *current) {
+    const uint64_t elapsed = (get_kernel_nanos() - state->slice_start) / NANOS_PER_TICK;
+
+    state->slice_start += elapsed * NANOS_PER_TICK;
+
+    if (elapsed < current->sched->ts_remain) {
+        current->sched->ts_remain -= elapsed;
+    } else {
+        current->sched->ts_remain = 0;
+    }
+}
+
+// When (in kernel nanos) `running` next needs preempting, or UINT64_MAX for never.
+static uint64_t sched_preempt_deadline(PerCPUSchedState *state, Task *running) {
+    Task *waiting = task_rq_peek(&state->realtime_head);
+
+    if (waiting == NULL) {
+        waiting = task_rq_peek(&state->high_head);
+    }
+
+    if (waiting == NULL) {
+        waiting = task_rq_peek(&state->normal_head);
+    }
+
+    if (waiting == NULL) {
+        // Nothing but idle waiting, so nothing to preempt for
+        return UINT64_MAX;
+    }
+
+    if (running == NULL || running->sched->state != TASK_STATE_RUNNING ||
+        waiting->sched->class > running->sched->class) {
+        return 0;
+    }
+
+    return state->slice_start + running->sched->ts_remain * NANOS_PER_TICK;
+}
+
+/*
+ * Program this CPU's one-shot timer for whichever comes first - the
+ * next sleeper's deadline, the end of the running timeslice (if
+ * anything is waiting for it), or the idle cap.
+ */
+static void sched_rearm_timer(PerCPUSchedState *state, Task *running) {
+    const uint64_t now = get_kernel_nanos();
+    const uint64_t next_wake = sleep_queue_next_deadline(&state_get_for_this_cpu()->sleep_queue);
+    const uint64_t next_preempt = sched_preempt_deadline(state, running);
+
+    uint64_t deadline = now + TICKLESS_MAX_IDLE_NANOS;
+
+    if (next_wake < deadline) {
+        deadline = next_wake;
+    }
+
+    if (next_preempt < deadline) {
+        deadline = next_preempt;
+    }
+
+    state->timer_deadline = deadline;
+    kernel_timer_oneshot(deadline > now ? deadline - now : 0);
+}
+#else
+static inline void sched_charge_timeslice(PerCPUSchedState *state, Task *current) {
+    if (current->sched->ts_remain > 0) {
+        --current->sched->ts_remain;
+    }
+}
+
+static inline void sched_rearm_timer(PerCPUSchedState *state, Task *running) {}
+#endif
+
+// Queue anything other CPUs woke for us while they couldn't get our lock
+static void sched_take_deferred_wakeups(PerCPUSchedState *state) {
+    Task *task = __atomic_exchange_n(&state->deferred_wakeups, NULL, __ATOMIC_ACQUIRE);
+
+    while (task) {
+        Task *next = task->sched->deferred_next;
+        sched_unblock_on(task, state_get_for_this_cpu());
+        task = next;
+    }
+}
+
 void sched_schedule(void) {
     PerCPUSchedState *state = get_this_cpu_sched_state();
 
     Task *current = task_current();
     Task *candidate_next = NULL;
-    TaskPriorityQueue *candidate_queue = NULL;
+    TaskRunQueue *candidate_queue = NULL;
+
+    sched_take_deferred_wakeups(state);
+
+    const uint64_t now = get_kernel_upticks();
+    sched_update_load(state, now);
+    sched_balance(state, current, now);
 
     vdebug("Switching tasks : current is ");
     vdbgx64((uintptr_t)current);
     vdebug("\n");
 
-    if ((candidate_next = task_pq_peek(&state->realtime_head))) {
+    if ((candidate_next = task_rq_peek(&state->realtime_head))) {
         printf("Have a realtime candidate\n");
         candidate_queue = &state->realtime_head;
-    } else if ((candidate_next = task_pq_peek(&state->high_head))) {
+    } else if ((candidate_next = task_rq_peek(&state->high_head))) {
         printf("Have a high candidate\n");
         candidate_queue = &state->high_head;
-    } else if ((candidate_next = task_pq_peek(&state->normal_head))) {
+    } else if ((candidate_next = task_rq_peek(&state->normal_head))) {
         printf("Have a normal candidate\n");
         candidate_queue = &state->normal_head;
-    } else if ((candidate_next = task_pq_peek(&state->idle_head))) {
+    } else if ((candidate_next = task_rq_peek(&state->idle_head))) {
         printf("Have an idle candidate\n");
         candidate_queue = &state->idle_head;
     }
@@ -267,6 +581,7 @@ void sched_schedule(void) {
         // no more tasks, just carry on
         // not allocating another timeslice, so we'll still switch as soon as something else comes up...
         vdebug("No more tasks; Switch aborted\n");
+        sched_rearm_timer(state, current);
         return;
     }
 
@@ -278,9 +593,7 @@ void sched_schedule(void) {
         }
 #endif
 
-        if (current->sched->ts_remain > 0) {
-            --current->sched->ts_remain;
-        }
+        sched_charge_timeslice(state, current);
 
         if (thread_to_be_killed(current)) {
             // This task has been killed, but has not started dying yet.
@@ -307,27 +620,88 @@ void sched_schedule(void) {
             vdebug(" still has ");
             vdbgx64((uint64_t)current->sched->ts_remain);
             vdebug(" ticks left to run...\n");
+            sched_rearm_timer(state, current);
             return;
         }
     }
 
     // Now we know we're going to switch, we can actually dequeue
-    Task *next = task_pq_pop(candidate_queue);
+    Task *next = task_rq_pop(candidate_queue);
     state->all_queue_total -= 1;
 
+    if (candidate_queue != &state->idle_head) {
+        state->busy_queue_total -= 1;
+    }
+
     vdebug("Switch to ");
     vdbgx64((uintptr_t)next);
     vdebug(" [TID = ");
     vdbgx64((uint64_t)next->sched->tid);
     vdebug("]\n");
 
-    if (current && current->sched->state == TASK_STATE_RUNNING) {
+    if (current) {
+        current->sched->last_run = now;
+
+        if (current->sched->state == TASK_STATE_RUNNING) {
+            current->sched->state = TASK_STATE_READY;
+            sched_enqueue(current);
+        }
+    }
+
+    next->sched->ts_remain = DEFAULT_TIMESLICE;
+    next->sched->state = TASK_STATE_RUNNING;
+    state->running_class = next->sched->class;
+
+#ifdef EXPERIMENTAL_TICKLESS
+    state->slice_start = get_kernel_nanos();
+#endif
+    sched_rearm_timer(state, next);
+
+    task_switch(next);
+}
+
+// Whether anything queued here is of a higher class than `class`
+static inline bool sched_queued_outranks(PerCPUSchedState *state, const TaskClass class) {
+    return (class < TASK_CLASS_REALTIME && task_rq_peek(&state->realtime_head)) ||
+           (class < TASK_CLASS_HIGH && task_rq_peek(&state->high_head)) ||
+           (class < TASK_CLASS_NORMAL && task_rq_peek(&state->normal_head));
+}
+
+void sched_handoff(Task *next) {
+    PerCPUSchedState *state = get_this_cpu_sched_state();
+    Task *current = task_current();
+
+#ifdef EXPERIMENTAL_TICKLESS
+    if (current) {
+        sched_charge_timeslice(state, current);
+    }
+#endif
+
+    if (current == NULL || next->sched->state != TASK_STATE_BLOCKED || current->sched->ts_remain == 0 ||
+        thread_to_be_killed(current) || sched_queued_outranks(state, next->sched->class)) {
+        // Not something we can just hand over to, so do it the long way
+        sched_unblock(next);
+        sched_schedule();
+        return;
+    }
+
+    vdebug("Handoff to ");
+    vdbgx64((uintptr_t)next);
+    vdebug("\n");
+
+    current->sched->last_run = get_kernel_upticks();
+
+    if (current->sched->state == TASK_STATE_RUNNING) {
         current->sched->state = TASK_STATE_READY;
         sched_enqueue(current);
     }
 
-    next->sched->ts_remain = DEFAULT_TIMESLICE;
+    // Next gets the rest of our slice, so we don't reset slice_start either
+    next->sched->ts_remain = current->sched->ts_remain;
     next->sched->state = TASK_STATE_RUNNING;
+    state->running_class = next->sched->class;
+
+    sched_rearm_timer(state, next);
 
     task_switch(next);
 }
@@ -359,6 +733,11 @@ PerCPUState *sched_find_target_cpu() {
         }
 #endif
 
+        if (!sched_state_initialized(candidate_sched)) {
+            // CPU has registered, but has no queues yet
+            continue;
+        }
+
 #ifdef TARGET_CPU_CONSIDER_SLEEPERS
         if ((candidate_sched->all_queue_total + candidate->sleep_queue.count) == 1) {
 #else
@@ -407,9 +786,49 @@ PerCPUState *sched_find_target_cpu() {
     return target;
 }
 
+bool sched_get_balance_stats(uint16_t cpu_num, SchedBalanceStats *stats) {
+    if (stats == NULL || cpu_num >= state_get_cpu_count()) {
+        return false;
+    }
+
+    PerCPUSchedState *state = get_any_cpu_sched_state(cpu_num);
+
+    if (!sched_state_initialized(state)) {
+        return false;
+    }
+
+    *stats = state->balance;
+    return true;
+}
+
+#ifndef NO_RESCHEDULE_IPI
+/*
+ * Whether a task just queued on another CPU is worth interrupting
+ * it for, rather than waiting for it to notice by itself.
+ */
+static inline bool sched_should_kick(PerCPUSchedState *target, Task *task, bool was_uncontended) {
+    if (task->sched->class > target->running_class) {
+        // It'll preempt whatever's running there (including idle)
+        return true;
+    }
+
+#ifdef EXPERIMENTAL_TICKLESS
+    // Nothing was waiting there before, so its timer won't be set for the end of the running slice
+    return was_uncontended && task->sched->class != TASK_CLASS_IDLE;
+#else
+    return false;
+#endif
+}
+#endif
+
 void sched_unblock_on(Task *task, PerCPUState *target_cpu_state) {
+    PerCPUSchedState *target_sched = (PerCPUSchedState *)target_cpu_state->sched_data;
+#ifndef NO_RESCHEDULE_IPI
+    const bool was_uncontended = target_sched->busy_queue_total == 0;
+#endif
+
     task->sched->state = TASK_STATE_READY;
-    bool result = sched_enqueue_on(task, ((PerCPUSchedState *)target_cpu_state->sched_data));
+    bool result = sched_enqueue_on(task, target_sched);
 
 #ifdef CONSERVATIVE_BUILD
     if (!result) {
@@ -421,6 +840,43 @@ void sched_unblock_on(Task *task, PerCPUState *target_cpu_state) {
 #endif
     }
 #endif
+
+    if (target_cpu_state == state_get_for_this_cpu()) {
+#ifdef EXPERIMENTAL_TICKLESS
+        // If this wants to preempt us sooner than the timer's set for, bring the timer in.
+        Task *current = task_current();
+
+        if (sched_preempt_deadline(target_sched, current) < target_sched->timer_deadline) {
+            sched_rearm_timer(target_sched, current);
+        }
+#endif
+        return;
+    }
+
+#ifndef NO_RESCHEDULE_IPI
+    if (result && sched_should_kick(target_sched, task, was_uncontended)) {
+        ipwi_notify_reschedule(target_cpu_state->cpu_id);
+    }
+#endif
+}
+
+void sched_unblock_remote(Task *task, PerCPUState *target) {
+    // Waiting for their lock while holding ours deadlocks if they're doing the same to us
+    if (spinlock_try_lock(&target->sched_lock_this_cpu)) {
+        sched_unblock_on(task, target);
+        spinlock_unlock(&target->sched_lock_this_cpu);
+        return;
+    }
+
+    PerCPUSchedState *target_sched = (PerCPUSchedState *)target->sched_data;
+    Task *head = __atomic_load_n(&target_sched->deferred_wakeups, __ATOMIC_RELAXED);
+
+    do {
+        task->sched->deferred_next = head;
+    } while (!__atomic_compare_exchange_n(&target_sched->deferred_wakeups, &head, task, true, __ATOMIC_RELEASE,
+                                          __ATOMIC_RELAXED));
+
+    ipwi_notify_reschedule(target->cpu_id);
 }
 
 void sched_unblock(Task *task) { sched_unblock_on(task, state_get_for_this_cpu()); }
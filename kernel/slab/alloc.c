@@ -7,13 +7,14 @@
 
 #include "slab/alloc.h"
 #include "fba/alloc.h"
+#include "machine.h"
+#include "smp/state.h"
 #include "spinlock.h"
 #include "structs/bitmap.h"
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 
-#define NULL (((void *)0))
-
 #ifdef CONSERVATIVE_BUILD
 #include "panic.h"
 #ifdef CONSERVATIVE_PANICKY
@@ -24,10 +25,30 @@
 #endif
 #endif
 
-static ListNode *partial;
-static ListNode *full;
+typedef struct {
+    SpinLock lock;
+    ListNode *partial;
+    ListNode *full;
+    uint16_t block_size;
+    uint8_t block_shift;
+    uint8_t header_blocks;
+    uint8_t bitmap_words;
+} SlabCache;
+
+#define SLAB_CLASS_32 ((0))
+#define SLAB_CLASS_64 ((1))
 
-static SpinLock slab_lock;
+// The header is always 64 bytes, except the 32-byte class needs
+// 512 bits of bitmap, which carry on into the 32 bytes after it.
+static SlabCache caches[SLAB_CLASS_COUNT] = {
+        {.block_size = 32, .block_shift = 5, .header_blocks = 3, .bitmap_words = 8},
+        {.block_size = 64, .block_shift = 6, .header_blocks = 1, .bitmap_words = 4},
+        {.block_size = 128, .block_shift = 7, .header_blocks = 1, .bitmap_words = 2},
+        {.block_size = 256, .block_shift = 8, .header_blocks = 1, .bitmap_words = 1},
+        {.block_size = 512, .block_shift = 9, .header_blocks = 1, .bitmap_words = 1},
+};
+
+static bool magazines_enabled;
 
 static const uint8_t FBA_BLOCKS_PER_SLAB = BYTES_PER_SLAB / VM_PAGE_SIZE;
 
@@ -50,63 +71,205 @@ static inline uint8_t first_set_bit_64(uint64_t nonzero_uint64) {
 #endif
 }
 
-void *slab_alloc_block() {
-    Slab *target = NULL;
+static inline void slab_list_push(ListNode **head, Slab *slab) {
+    slab->this.next = *head;
+    slab->prev = NULL;
+
+    if (*head) {
+        ((Slab *)*head)->prev = slab;
+    }
+
+    *head = (ListNode *)slab;
+}
+
+static inline void slab_list_remove(ListNode **head, Slab *slab) {
+    Slab *next = (Slab *)slab->this.next;
+
+    if (slab->prev) {
+        slab->prev->this.next = (ListNode *)next;
+    } else {
+        *head = (ListNode *)next;
+    }
+
+    if (next) {
+        next->prev = slab->prev;
+    }
+}
+
+static Slab *new_slab(const uint8_t size_class) {
+    const SlabCache *cache = &caches[size_class];
+    Slab *slab = (Slab *)fba_alloc_blocks_aligned(FBA_BLOCKS_PER_SLAB, FBA_BLOCKS_PER_SLAB);
+
+    if (slab == NULL) {
+        return NULL;
+    }
+
+    const uint16_t blocks = BYTES_PER_SLAB >> cache->block_shift;
+    uint64_t *bitmap = &slab->bitmap0;
+
+    for (int i = 0; i < cache->bitmap_words; i++) {
+        bitmap[i] = 0;
+    }
+
+    // Header blocks are always allocated...
+    for (int i = 0; i < cache->header_blocks; i++) {
+        bitmap_set(bitmap, i);
+    }
+
+    // ... as are the bits past the end, if the slab doesn't fill a word
+    if (blocks < 64) {
+        bitmap[0] |= ~((1ULL << blocks) - 1);
+    }
 
-    const uint64_t lock_flags = spinlock_lock_irqsave(&slab_lock);
+    slab->this.next = NULL;
+    slab->prev = NULL;
+    slab->block_size = cache->block_size;
+    slab->free_blocks = blocks - cache->header_blocks;
+    slab->size_class = size_class;
 
-    if (partial == NULL) {
+    return slab;
+}
+
+// Cache lock must be held
+static void *alloc_locked(const uint8_t size_class) {
+    SlabCache *cache = &caches[size_class];
+    Slab *target;
+
+    if (cache->partial == NULL) {
         // No partial slabs - allocate a new one.
-        target = (Slab *)fba_alloc_blocks_aligned(FBA_BLOCKS_PER_SLAB, FBA_BLOCKS_PER_SLAB);
+        target = new_slab(size_class);
 
         if (target == NULL) {
-            // alloc failed
-            spinlock_unlock_irqrestore(&slab_lock, lock_flags);
             return NULL;
         }
 
-        // zero out header
-        target->this.next = NULL;
-        target->bitmap0 = 1; // first block always allocated
-        target->bitmap1 = 0;
-        target->bitmap2 = 0;
-        target->bitmap3 = 0;
-
-        partial = list_insert_after(NULL, (ListNode *)target);
+        slab_list_push(&cache->partial, target);
     } else {
         // Use the first partial slab...
-        target = (Slab *)partial;
+        target = (Slab *)cache->partial;
     }
 
     // find free block
-    int free_block = 0;
-    if (target->bitmap0 != 0xffffffffffffffff) {
-        free_block = first_set_bit_64(~(target->bitmap0));
-    } else if (target->bitmap1 != 0xffffffffffffffff) {
-        free_block = first_set_bit_64(~(target->bitmap1)) + 64;
-    } else if (target->bitmap2 != 0xffffffffffffffff) {
-        free_block = first_set_bit_64(~(target->bitmap2)) + 128;
-    } else if (target->bitmap3 != 0xffffffffffffffff) {
-        free_block = first_set_bit_64(~(target->bitmap3)) + 192;
-    } else {
+    uint64_t *bitmap = &target->bitmap0;
+    int free_block = -1;
+
+    for (int i = 0; i < cache->bitmap_words; i++) {
+        if (bitmap[i] != 0xffffffffffffffff) {
+            free_block = first_set_bit_64(~(bitmap[i])) + (i << 6);
+            break;
+        }
+    }
+
+    if (free_block < 0) {
         // TODO warn about this, full block in partial list...
         // (or maybe just panic, since we're going to be in an indeterminite state now anyway...)
-        spinlock_unlock_irqrestore(&slab_lock, lock_flags);
         return NULL;
     }
 
-    bitmap_set(&target->bitmap0, free_block);
+    bitmap_set(bitmap, free_block);
+
+    if (--target->free_blocks == 0) {
+        slab_list_remove(&cache->partial, target);
+        slab_list_push(&cache->full, target);
+    }
+
+    return (void *)((uintptr_t)target + ((uintptr_t)free_block << cache->block_shift));
+}
+
+// Cache lock must be held
+static void free_locked(Slab *slab, const uint64_t block_num) {
+    SlabCache *cache = &caches[slab->size_class];
+
+    if (slab->free_blocks == 0) {
+        // Was full, it's partial again now
+        slab_list_remove(&cache->full, slab);
+        slab_list_push(&cache->partial, slab);
+    }
+
+    bitmap_clear(&slab->bitmap0, block_num);
+    slab->free_blocks++;
+}
+
+// Interrupts must be disabled
+static inline void magazine_refill(const uint8_t size_class, SlabMagazine *magazine) {
+    SlabCache *cache = &caches[size_class];
+
+    spinlock_lock(&cache->lock);
+
+    for (int i = 0; i < SLAB_MAGAZINE_BATCH; i++) {
+        void *block = alloc_locked(size_class);
+
+        if (block == NULL) {
+            break;
+        }
 
-    if (target->bitmap0 == 0xffffffffffffffff && target->bitmap1 == 0xffffffffffffffff &&
-        target->bitmap2 == 0xffffffffffffffff && target->bitmap3 == 0xffffffffffffffff) {
-        // TODO probably ought to just implement push / pop (front) in list.c...
-        partial = target->this.next;
-        target->this.next = full;
-        full = (ListNode *)target;
+        magazine->blocks[magazine->count++] = block;
     }
 
-    spinlock_unlock_irqrestore(&slab_lock, lock_flags);
-    return (void *)(target + free_block);
+    spinlock_unlock(&cache->lock);
+}
+
+// Interrupts must be disabled
+static inline void magazine_drain(const uint8_t size_class, SlabMagazine *magazine) {
+    SlabCache *cache = &caches[size_class];
+
+    spinlock_lock(&cache->lock);
+
+    // Give back the oldest, they're least likely to still be in cache
+    for (int i = 0; i < SLAB_MAGAZINE_BATCH; i++) {
+        Slab *slab = slab_base(magazine->blocks[i]);
+        free_locked(slab, ((uintptr_t)magazine->blocks[i] - (uintptr_t)slab) >> cache->block_shift);
+    }
+
+    for (int i = SLAB_MAGAZINE_BATCH; i < magazine->count; i++) {
+        magazine->blocks[i - SLAB_MAGAZINE_BATCH] = magazine->blocks[i];
+    }
+
+    magazine->count -= SLAB_MAGAZINE_BATCH;
+
+    spinlock_unlock(&cache->lock);
+}
+
+static inline bool use_magazines(void) { return __atomic_load_n(&magazines_enabled, __ATOMIC_RELAXED); }
+
+static void *alloc_from(const uint8_t size_class) {
+    if (use_magazines()) {
+        const uint64_t intr_flags = save_disable_interrupts();
+        SlabMagazine *magazine = &state_get_for_this_cpu()->slab_cache.magazines[size_class];
+
+        if (!magazine->count) {
+            magazine_refill(size_class, magazine);
+        }
+
+        void *block = magazine->count ? magazine->blocks[--magazine->count] : NULL;
+
+        restore_saved_interrupts(intr_flags);
+        return block;
+    }
+
+    SlabCache *cache = &caches[size_class];
+
+    const uint64_t lock_flags = spinlock_lock_irqsave(&cache->lock);
+    void *block = alloc_locked(size_class);
+    spinlock_unlock_irqrestore(&cache->lock, lock_flags);
+
+    return block;
+}
+
+void *slab_alloc_block() { return alloc_from(SLAB_CLASS_64); }
+
+void *slab_alloc(const uint64_t size) {
+    if (size == 0 || size > SLAB_MAX_BLOCK_SIZE) {
+        return NULL;
+    }
+
+    uint8_t size_class = SLAB_CLASS_32;
+
+    while (caches[size_class].block_size < size) {
+        size_class++;
+    }
+
+    return alloc_from(size_class);
 }
 
 void slab_free(void *block) {
@@ -119,7 +282,7 @@ void slab_free(void *block) {
 
     Slab *slab = slab_base(block);
 
-    if (!slab) {
+    if (!slab || slab->size_class >= SLAB_CLASS_COUNT) {
         // Not in FBA, so not a slab.
 #ifdef CONSERVATIVE_BUILD
         konservative("WARN: slab_free on non-slab");
@@ -127,51 +290,62 @@ void slab_free(void *block) {
         return;
     }
 
-    const uint64_t block_num = ((Slab *)block) - slab;
+    const uint8_t size_class = slab->size_class;
+    const SlabCache *cache = &caches[size_class];
+    const uintptr_t offset = (uintptr_t)block - (uintptr_t)slab;
 
-    if (block_num == 0) {
-        // we can't free the bitmap!
+    if (offset & (cache->block_size - 1)) {
+#ifdef CONSERVATIVE_BUILD
+        konservative("WARN: slab_free on misaligned block");
+#endif
         return;
     }
 
-    const uint64_t lock_flags = spinlock_lock_irqsave(&slab_lock);
+    const uint64_t block_num = offset >> cache->block_shift;
 
-    if (slab->bitmap0 == 0xffffffffffffffff && slab->bitmap1 == 0xffffffffffffffff &&
-        slab->bitmap2 == 0xffffffffffffffff && slab->bitmap3 == 0xffffffffffffffff) {
+    if (block_num < cache->header_blocks) {
+        // we can't free the bitmap!
+        return;
+    }
 
-        // This slab is in the full list, we need to find it and remove it
-        // TODO this is stupid inefficient in the worst case if the lists get big...
+    // Only we should be changing this bit, so no need for the lock to check it.
+    // Blocks sitting in a magazine still look allocated though, so this only
+    // catches double frees of blocks that have made it back to their slab.
+    if (!(__atomic_load_n(&(&slab->bitmap0)[block_num >> 6], __ATOMIC_RELAXED) & (1ULL << (block_num & 0x3f)))) {
+#ifdef CONSERVATIVE_BUILD
+        konservative("WARN: slab_free on block that isn't allocated");
+#endif
+        return;
+    }
 
-        if (full == (ListNode *)slab) {
-            // simple case - just popping head and add to partial list
-            full = slab->this.next;
-            slab->this.next = partial;
-            partial = (ListNode *)slab;
-        } else {
-            // this is the inefficient bit... I don't especially want to
-            // go doubly-linked though...
-            ListNode *prev = NULL;
-            ListNode *test = full;
+    if (use_magazines()) {
+        const uint64_t intr_flags = save_disable_interrupts();
+        SlabMagazine *magazine = &state_get_for_this_cpu()->slab_cache.magazines[size_class];
 
-            while (test) {
-                if (test->next == (ListNode *)slab) {
-                    prev = test;
-                    break;
-                }
-                test = test->next;
+#ifdef CONSERVATIVE_BUILD
+        // Catches it if it's still in this CPU's magazine - other CPUs' are theirs alone
+        for (int i = 0; i < magazine->count; i++) {
+            if (magazine->blocks[i] == block) {
+                restore_saved_interrupts(intr_flags);
+                konservative("WARN: slab_free on block that's already in the magazine");
+                return;
             }
+        }
+#endif
 
-            if (prev) {
-                prev->next = test->next;
-                test->next = partial;
-                partial = test;
-            } else {
-                // TODO warn about this, full slab wasn't in the full list!
-                // (or maybe just panic, since we're going to be in an indeterminite state now anyway...)
-            }
+        if (magazine->count == SLAB_MAGAZINE_SIZE) {
+            magazine_drain(size_class, magazine);
         }
+
+        magazine->blocks[magazine->count++] = block;
+
+        restore_saved_interrupts(intr_flags);
+        return;
     }
 
-    bitmap_clear(&slab->bitmap0, block_num);
-    spinlock_unlock_irqrestore(&slab_lock, lock_flags);
+    const uint64_t lock_flags = spinlock_lock_irqsave(&caches[size_class].lock);
+    free_locked(slab, block_num);
+    spinlock_unlock_irqrestore(&caches[size_class].lock, lock_flags);
 }
+
+void slab_notify_smp_started(void) { __atomic_store_n(&magazines_enabled, true, __ATOMIC_RELEASE); }
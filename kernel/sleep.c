@@ -11,6 +11,7 @@
 #include <stdint.h>
 
 #include "config.h"
+#include "machine.h"
 #include "sched.h"
 #include "sleep_queue.h"
 #include "smp/state.h"
@@ -25,8 +26,6 @@
 #define NULL (((void *)0))
 #endif
 
-uint64_t get_kernel_upticks(void);
-
 void sleep_init(void) {
     PerCPUState *cpu_state = state_get_for_this_cpu();
     sleep_queue_init(&cpu_state->sleep_queue);
@@ -37,13 +36,14 @@ void sleep_task(Task *task, uint64_t nanos) {
     if (task != NULL) {
         PerCPUState *cpu_state = state_get_for_this_cpu();
 
-        uint64_t wake_tick = get_kernel_upticks() + (nanos / NANOS_PER_TICK);
-        sleep_queue_enqueue(&cpu_state->sleep_queue, task, wake_tick);
+        const uint64_t now = get_kernel_nanos();
+        const uint64_t wake_at = now + nanos;
+        sleep_queue_enqueue(&cpu_state->sleep_queue, task, wake_at);
 
 #ifdef DEBUG_SLEEP
-        kprintf("Sleep 0x%016lx\n    => Ticks now is 0x%016lx - Will wake at "
+        kprintf("Sleep 0x%016lx\n    => Nanos now is 0x%016lx - Will wake at "
                 "0x%016lx\n",
-                (uintptr_t)task, get_kernel_upticks(), wake_tick);
+                (uintptr_t)task, now, wake_at);
 #endif
         sched_block(task);
         sched_schedule();
@@ -61,7 +61,7 @@ void check_sleepers() {
 #endif
 
     PerCPUState *cpu_state = state_get_for_this_cpu();
-    Task *waker = sleep_queue_dequeue(&cpu_state->sleep_queue, get_kernel_upticks());
+    Task *waker = sleep_queue_dequeue(&cpu_state->sleep_queue, get_kernel_nanos());
 
     while (waker) {
         Task *next = (Task *)waker->this.next;
@@ -75,9 +75,7 @@ void check_sleepers() {
                 target_cpu->cpu_id);
 #endif
         if (target_cpu != cpu_state) {
-            uint64_t lock_flags = sched_lock_any_cpu(target_cpu);
-            sched_unblock_on(waker, target_cpu);
-            sched_unlock_any_cpu(target_cpu, lock_flags);
+            sched_unblock_remote(waker, target_cpu);
         } else {
             // Scheduler already locked on this CPU...
             sched_unblock_on(waker, target_cpu);
@@ -112,4 +112,12 @@ Task *sleep_queue_dequeue(SleepQueue *queue, uint64_t deadline) {
     }
 
     return task_list;
-}
\ No newline at end of file
+}
+
+uint64_t sleep_queue_next_deadline(SleepQueue *queue) {
+    if (!queue || !queue->head) {
+        return UINT64_MAX;
+    }
+
+    return queue->head->wake_at;
+}
@@ -7,17 +7,21 @@
 
 #include <stdbool.h>
 
-#include "spinlock.h"
+#include "machine.h"
+#include "sched.h"
 
 #include "smp/ipwi.h"
 
 #include "smp/state.h"
 #include "std/string.h"
 
+#include "vmm/asid.h"
 #include "vmm/vmconfig.h"
 #include "vmm/vmmapper.h"
 
 void arch_ipwi_notify_all_except_current(void);
+void arch_ipwi_notify(PerCPUState *target_state);
+void arch_ipwi_notify_reschedule(PerCPUState *target_state);
 
 bool ipwi_init(void) {
     PerCPUState *cpu_state = state_get_for_this_cpu();
@@ -26,17 +30,22 @@ bool ipwi_init(void) {
         return false;
     }
 
-    spinlock_init(&cpu_state->ipwi_queue_lock_this_cpu);
+    cpu_state->ipwi_head = 0;
+    cpu_state->ipwi_flush_requested = 0;
+    cpu_state->ipwi_flush_done = 0;
 
-    if (!shift_array_init(&cpu_state->ipwi_queue, sizeof(IpwiWorkItem), 16)) {
-        return false;
+    // Each slot's sequence says which position it's free for (== pos) or full at (== pos + 1)
+    for (int i = 0; i < IPWI_MAILBOX_SIZE; i++) {
+        cpu_state->ipwi_seq[i] = i;
     }
 
+    __atomic_store_n(&cpu_state->ipwi_tail, 0, __ATOMIC_RELEASE);
+
     return true;
 }
 
-bool ipwi_enqueue(const IpwiWorkItem *item, const uint8_t cpu_num) {
-    if (cpu_num > state_get_cpu_count()) {
+bool ipwi_enqueue(const IpwiWorkItem *item, const uint16_t cpu_num) {
+    if (cpu_num >= state_get_cpu_count()) {
         return false;
     }
 
@@ -46,10 +55,34 @@ bool ipwi_enqueue(const IpwiWorkItem *item, const uint8_t cpu_num) {
         return false;
     }
 
-    spinlock_lock(&target_state->ipwi_queue_lock_this_cpu);
-    shift_array_insert_tail(&target_state->ipwi_queue, item);
-    spinlock_unlock(&target_state->ipwi_queue_lock_this_cpu);
+    // Not for locking - just so we can't be held up between claiming a slot
+    // and filling it, which would stall the target's handler at that slot.
+    const uint64_t intr_flags = save_disable_interrupts();
+    uint64_t pos = __atomic_load_n(&target_state->ipwi_tail, __ATOMIC_RELAXED);
+
+    for (;;) {
+        const uint32_t seq = __atomic_load_n(&target_state->ipwi_seq[pos & IPWI_MAILBOX_MASK], __ATOMIC_ACQUIRE);
+        const int32_t diff = (int32_t)(seq - (uint32_t)pos);
+
+        if (diff == 0) {
+            if (__atomic_compare_exchange_n(&target_state->ipwi_tail, &pos, pos + 1, true, __ATOMIC_RELAXED,
+                                            __ATOMIC_RELAXED)) {
+                break;
+            }
+        } else if (diff < 0) {
+            // Full - the target hasn't got round to this slot since last time
+            restore_saved_interrupts(intr_flags);
+            return false;
+        } else {
+            // Someone else claimed it first
+            pos = __atomic_load_n(&target_state->ipwi_tail, __ATOMIC_RELAXED);
+        }
+    }
+
+    memcpy(&target_state->ipwi_mailbox[pos & IPWI_MAILBOX_MASK], item, sizeof(IpwiWorkItem));
+    __atomic_store_n(&target_state->ipwi_seq[pos & IPWI_MAILBOX_MASK], (uint32_t)(pos + 1), __ATOMIC_RELEASE);
 
+    restore_saved_interrupts(intr_flags);
     return true;
 }
 
@@ -69,50 +102,157 @@ bool ipwi_enqueue_all_except_current(IpwiWorkItem *item) {
 
 void ipwi_notify_all_except_current(void) { arch_ipwi_notify_all_except_current(); }
 
+bool ipwi_notify(const uint16_t cpu_num) {
+    if (cpu_num >= state_get_cpu_count()) {
+        return false;
+    }
+
+    PerCPUState *target_state = state_get_for_any_cpu(cpu_num);
+
+    if (!target_state) {
+        return false;
+    }
+
+    arch_ipwi_notify(target_state);
+    return true;
+}
+
+bool ipwi_notify_reschedule(const uint16_t cpu_num) {
+    if (cpu_num >= state_get_cpu_count()) {
+        return false;
+    }
+
+    PerCPUState *target_state = state_get_for_any_cpu(cpu_num);
+
+    if (!target_state) {
+        return false;
+    }
+
+    // If one's already on its way, the scheduler it runs will see whatever we just did
+    if (__atomic_exchange_n(&target_state->ipwi_reschedule_pending, 1, __ATOMIC_ACQ_REL)) {
+        return false;
+    }
+
+    arch_ipwi_notify_reschedule(target_state);
+    return true;
+}
+
+void ipwi_reschedule_handler(void) {
+    PerCPUState *this_state = state_get_for_this_cpu();
+
+    // Clear before scheduling, so anything queued from here on gets its own IPI
+    __atomic_store_n(&this_state->ipwi_reschedule_pending, 0, __ATOMIC_RELEASE);
+
+    const uint64_t lock_flags = sched_lock_this_cpu();
+    sched_schedule();
+    sched_unlock_this_cpu(lock_flags);
+}
+
 bool ipwi_dequeue_this_cpu(IpwiWorkItem *out_item) {
     PerCPUState *this_state = state_get_for_this_cpu();
-    bool result = false;
 
     if (!this_state) {
-        return result;
+        return false;
+    }
+
+    const uint64_t pos = this_state->ipwi_head;
+    const uint32_t seq = __atomic_load_n(&this_state->ipwi_seq[pos & IPWI_MAILBOX_MASK], __ATOMIC_ACQUIRE);
+
+    if ((int32_t)(seq - (uint32_t)(pos + 1)) < 0) {
+        // Empty, or the sender hasn't finished filling it yet
+        return false;
+    }
+
+    memcpy(out_item, &this_state->ipwi_mailbox[pos & IPWI_MAILBOX_MASK], sizeof(IpwiWorkItem));
+
+    // Free for the sender that comes round to it next lap
+    __atomic_store_n(&this_state->ipwi_seq[pos & IPWI_MAILBOX_MASK], (uint32_t)(pos + IPWI_MAILBOX_SIZE),
+                     __ATOMIC_RELEASE);
+    this_state->ipwi_head = pos + 1;
+
+    return true;
+}
+
+uint64_t ipwi_request_tlb_flush(const uint16_t cpu_num) {
+    if (cpu_num >= state_get_cpu_count()) {
+        return 0;
+    }
+
+    PerCPUState *target_state = state_get_for_any_cpu(cpu_num);
+
+    if (!target_state) {
+        return 0;
     }
 
-    const uint64_t flags = spinlock_lock_irqsave(&this_state->ipwi_queue_lock_this_cpu);
-    const IpwiWorkItem *item = shift_array_get_head(&this_state->ipwi_queue);
+    return __atomic_add_fetch(&target_state->ipwi_flush_requested, 1, __ATOMIC_ACQ_REL);
+}
 
-    if (item) {
-        result = true;
-        memcpy(out_item, item, sizeof(*out_item));
+bool ipwi_tlb_flush_done(const uint16_t cpu_num, const uint64_t ticket) {
+    if (cpu_num >= state_get_cpu_count()) {
+        return true;
     }
 
-    shift_array_remove_head(&this_state->ipwi_queue);
-    spinlock_unlock_irqrestore(&this_state->ipwi_queue_lock_this_cpu, flags);
+    const PerCPUState *target_state = state_get_for_any_cpu(cpu_num);
 
-    return result;
+    return !target_state || __atomic_load_n(&target_state->ipwi_flush_done, __ATOMIC_ACQUIRE) >= ticket;
 }
 
 #include "kprintf.h"
 
+static void handle_tlb_shootdown(const IpwiPayloadTLBShootdown *payload) {
+    const Task *current = task_current();
+    const bool kernel = payload->start_vaddr >= VM_KERNEL_SPACE_START;
+
+    // A process that isn't loaded here has nothing to do - the sender marked it
+    // stale, so its ASID gets flushed before it runs here again. A bare PML4 is
+    // checked against what's actually loaded, whichever task is current. Kernel
+    // pages are global, so they're here whatever's loaded.
+    const bool loaded = kernel || (payload->target_pml4 ? payload->target_pml4 == vmm_get_pagetable_root_phys()
+                                                        : current && payload->target_pid == current->owner->pid);
+
+    if (loaded) {
+        if (payload->page_count > IPWI_TLB_SHOOTDOWN_FULL_FLUSH_PAGES) {
+            if (kernel) {
+                // Reloading the tables would leave global pages where they are
+                asid_flush_all_this_cpu();
+            } else {
+                vmm_invalidate_all();
+            }
+        } else {
+            const uintptr_t page_limit = payload->start_vaddr + (payload->page_count * VM_PAGE_SIZE);
+
+            for (uintptr_t addr = payload->start_vaddr; addr < page_limit; addr += VM_PAGE_SIZE) {
+                vmm_invalidate_page(addr);
+            }
+        }
+    } else if (payload->target_pml4) {
+        // Without a process there's no telling which ASID it had here, so they all go
+        asid_forget_this_cpu();
+    }
+
+    if (payload->ack_count) {
+        __atomic_fetch_sub(payload->ack_count, 1, __ATOMIC_RELEASE);
+    }
+}
+
 void ipwi_ipi_handler(void) {
+    PerCPUState *this_state = state_get_for_this_cpu();
     IpwiWorkItem item;
 
-    while (ipwi_dequeue_this_cpu(&item)) {
-        const IpwiPayloadTLBShootdown *payload;
+    // Anything that couldn't get into the mailbox gets a full flush
+    const uint64_t flush_requested = __atomic_load_n(&this_state->ipwi_flush_requested, __ATOMIC_ACQUIRE);
 
+    if (flush_requested != this_state->ipwi_flush_done) {
+        // It might have been for some other PML4, or for global kernel pages
+        asid_flush_all_this_cpu();
+        __atomic_store_n(&this_state->ipwi_flush_done, flush_requested, __ATOMIC_RELEASE);
+    }
+
+    while (ipwi_dequeue_this_cpu(&item)) {
         // we have an item!
         switch (item.type) {
         case IPWI_TYPE_TLB_SHOOTDOWN:
-            payload = (IpwiPayloadTLBShootdown *)&item.payload;
-
-            if (payload->target_pid == task_current()->owner->pid ||
-                payload->target_pml4 == task_current()->owner->pml4) {
-                const uintptr_t page_limit = payload->start_vaddr + (payload->page_count * VM_PAGE_SIZE);
-
-                for (uintptr_t addr = payload->start_vaddr; addr < page_limit; addr += VM_PAGE_SIZE) {
-                    vmm_invalidate_page(addr);
-                }
-            }
-
+            handle_tlb_shootdown((IpwiPayloadTLBShootdown *)&item.payload);
             break;
         case IPWI_TYPE_REMOTE_EXEC:
             // TODO not yet implemented
@@ -7,6 +7,7 @@
 
 #include "smp/state.h"
 #include "cpu.h"
+#include "fba/alloc.h"
 
 #ifdef CONSERVATIVE_KERNEL
 #include "debugstr.h"
@@ -17,10 +18,37 @@
 #define NULL (((void *)0))
 #endif
 
-static PerCPUState *cpu_states[MAX_CPU_COUNT];
-static uint8_t cpu_count;
+// Sized at boot for the CPUs we actually have (see state_init)
+static PerCPUState **cpu_states;
+static uint16_t cpu_capacity;
+static uint16_t cpu_count;
+
+bool state_init(const uint16_t max_cpus) {
+    const uint16_t capacity = max_cpus > MAX_CPU_COUNT ? MAX_CPU_COUNT : max_cpus ? max_cpus : 1;
+    const uint32_t blocks =
+            (capacity * sizeof(PerCPUState *) + KERNEL_FBA_BLOCK_SIZE - 1) / KERNEL_FBA_BLOCK_SIZE;
+
+    PerCPUState **states = fba_alloc_blocks(blocks);
+
+    if (!states) {
+        return false;
+    }
+
+    for (int i = 0; i < capacity; i++) {
+        states[i] = NULL;
+    }
+
+    cpu_states = states;
+    cpu_capacity = capacity;
+
+    return true;
+}
+
+bool state_register_cpu(const uint16_t cpu_num, PerCPUState *state) {
+    if (cpu_num >= cpu_capacity) {
+        return false;
+    }
 
-void state_register_cpu(uint8_t cpu_num, PerCPUState *state) {
 #ifdef CONSERVATIVE_KERNEL
     if (state == NULL) {
 #ifdef CONSERVATIVE_PANICKY
@@ -32,17 +60,6 @@ void state_register_cpu(uint8_t cpu_num, PerCPUState *state) {
 #endif
     }
 
-    if (cpu_num >= MAX_CPU_COUNT) {
-#ifdef CONSERVATIVE_PANICKY
-        panic("[BUG] Attempted to register CPU >= MAX_CPU_COUNT");
-#else
-        debugstr("!!! WARN: [BUG] Registering CPU #");
-        printdec(cpu_num);
-        debugstr(" which is above MAX_CPU_COUNT");
-        debugstr("; This is unlikely to end well...\n");
-#endif
-    }
-
     if (cpu_states[cpu_num] != 0) {
 #ifdef CONSERVATIVE_PANICKY
         panic("[BUG] Per-CPU state block reused");
@@ -55,13 +72,18 @@ void state_register_cpu(uint8_t cpu_num, PerCPUState *state) {
     }
 #endif
 
+    // APs come up together, so they can all be registering at once...
     cpu_states[cpu_num] = state;
-    cpu_count++;
+    __atomic_add_fetch(&cpu_count, 1, __ATOMIC_RELEASE);
+
+    return true;
 }
 
-uint8_t state_get_cpu_count(void) { return cpu_count; }
+uint16_t state_get_cpu_capacity(void) { return cpu_capacity; }
+
+uint16_t state_get_cpu_count(void) { return cpu_count; }
 
-PerCPUState *state_get_for_any_cpu(uint8_t cpu_num) {
+PerCPUState *state_get_for_any_cpu(const uint16_t cpu_num) {
 #ifdef CONSERVATIVE_KERNEL
     if (cpu_num >= cpu_count) {
 #ifdef CONSERVATIVE_PANICKY
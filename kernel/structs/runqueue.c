@@ -0,0 +1,113 @@
+/*
+ * stage3 - Constant-time run queue for tasks (in scheduler)
+ * anos - An Operating System
+ *
+ * Copyright (c) 2025 Ross Bamford
+ *
+ * Note that none of these routines allocate any memory or
+ * copy anything - that's all on the caller.
+ *
+ * O(1) enqueue, peek and dequeue. The level lists are only
+ * ever read for levels that have their occupancy bit set, so
+ * the caller doesn't need to zero them.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "structs/bitmap.h"
+#include "structs/runqueue.h"
+#include "task.h"
+
+#ifndef NULL
+#define NULL (((void *)0))
+#endif
+
+static inline int first_occupied_level(TaskRunQueue *rq) {
+    for (int i = 0; i < TASK_RQ_BITMAP_WORDS; i++) {
+        if (rq->occupied[i]) {
+            return (i << 6) + __builtin_ctzll(rq->occupied[i]);
+        }
+    }
+
+    return -1;
+}
+
+void task_rq_init(TaskRunQueue *rq, TaskRunList *levels) {
+    for (int i = 0; i < TASK_RQ_BITMAP_WORDS; i++) {
+        rq->occupied[i] = 0;
+    }
+
+    rq->levels = levels;
+}
+
+void task_rq_push(TaskRunQueue *rq, Task *task) {
+    if (!task) {
+        return;
+    }
+
+    const uint8_t prio = task->sched->prio;
+    TaskRunList *level = &rq->levels[prio];
+
+    task->this.next = NULL;
+
+    if (bitmap_check(rq->occupied, prio)) {
+        level->tail->this.next = (ListNode *)task;
+    } else {
+        level->head = task;
+        bitmap_set(rq->occupied, prio);
+    }
+
+    level->tail = task;
+}
+
+void task_rq_push_front(TaskRunQueue *rq, Task *task) {
+    if (!task) {
+        return;
+    }
+
+    const uint8_t prio = task->sched->prio;
+    TaskRunList *level = &rq->levels[prio];
+
+    if (bitmap_check(rq->occupied, prio)) {
+        task->this.next = (ListNode *)level->head;
+    } else {
+        task->this.next = NULL;
+        level->tail = task;
+        bitmap_set(rq->occupied, prio);
+    }
+
+    level->head = task;
+}
+
+Task *task_rq_pop(TaskRunQueue *rq) {
+    const int prio = first_occupied_level(rq);
+
+    if (prio < 0) {
+        return NULL;
+    }
+
+    TaskRunList *level = &rq->levels[prio];
+    Task *task = level->head;
+
+    level->head = (Task *)task->this.next;
+
+    if (level->head == NULL) {
+        bitmap_clear(rq->occupied, prio);
+    }
+
+    task->this.next = NULL; // Detach from list
+    return task;
+}
+
+Task *task_rq_peek(TaskRunQueue *rq) {
+    const int prio = first_occupied_level(rq);
+
+    if (prio < 0) {
+        return NULL;
+    }
+
+    return rq->levels[prio].head;
+}
+
+bool task_rq_empty(TaskRunQueue *rq) { return first_occupied_level(rq) < 0; }
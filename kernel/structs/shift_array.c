@@ -100,8 +100,26 @@ bool shift_array_resize(ShiftToMiddleArray *arr) {
     return true;
 }
 
+// If we've just drifted to one end (e.g. used as a queue) recentre in place, only grow if it's actually full-ish
+static bool make_room(ShiftToMiddleArray *arr) {
+    const uint64_t count = arr->tail - arr->head;
+    const uint64_t new_head = (arr->capacity - count) / 2;
+
+    if (count * 2 >= arr->capacity || new_head == 0 || new_head + count >= arr->capacity) {
+        return shift_array_resize(arr);
+    }
+
+    memmove((char *)arr->data + new_head * arr->elem_size, (char *)arr->data + arr->head * arr->elem_size,
+            count * arr->elem_size);
+
+    arr->head = new_head;
+    arr->tail = new_head + count;
+
+    return true;
+}
+
 bool shift_array_insert_head(ShiftToMiddleArray *arr, const void *value) {
-    if (arr->head == 0 && !shift_array_resize(arr)) {
+    if (arr->head == 0 && !make_room(arr)) {
         return false;
     }
 
@@ -112,7 +130,7 @@ bool shift_array_insert_head(ShiftToMiddleArray *arr, const void *value) {
 }
 
 bool shift_array_insert_tail(ShiftToMiddleArray *arr, const void *value) {
-    if (arr->tail == arr->capacity && !shift_array_resize(arr)) {
+    if (arr->tail == arr->capacity && !make_room(arr)) {
         return false;
     }
 
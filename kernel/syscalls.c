@@ -18,6 +18,7 @@
 #include "framebuffer.h"
 #include "ipc/channel.h"
 #include "ipc/named.h"
+#include "ipc/ring.h"
 #include "klog.h"
 #include "kprintf.h"
 #include "pmm/pagealloc.h"
@@ -38,6 +39,7 @@
 #include "throttle.h"
 #include "vmm/vmconfig.h"
 #include "vmm/vmmapper.h"
+#include "vmm/vmregion.h"
 
 #ifdef DEBUG_ACPI
 #define acpi_debugf(...) kprintf(__VA_ARGS__)
@@ -103,6 +105,7 @@ typedef void (*ThreadFunc)(void);
 
 extern MemoryRegion *physical_region;
 extern uintptr_t kernel_zero_page;
+extern uintptr_t kernel_zero_large_page;
 
 #define SYSCALL_ARGS SyscallArg arg0, SyscallArg arg1, SyscallArg arg2, SyscallArg arg3, SyscallArg arg4
 #define SYSCALL_NAME(name) handle_##name
@@ -153,13 +156,64 @@ SYSCALL_HANDLER(create_thread) {
 
 SYSCALL_HANDLER(memstats) {
     AnosMemInfo *mem_info = (AnosMemInfo *)arg0;
+    AnosCpuMemStats *cpu_stats = (AnosCpuMemStats *)arg1;
+    const uint64_t cpu_stats_count = (uint64_t)arg2;
 
     if (IS_USER_ADDRESS(mem_info)) {
         mem_info->physical_total = physical_region->size;
-        mem_info->physical_avail = physical_region->free;
+        mem_info->physical_avail = page_alloc_free_bytes(physical_region);
+    }
+
+    const uint16_t cpu_count = state_get_cpu_count();
+
+    // Per-CPU stats are optional
+    if (cpu_stats && cpu_stats_count && cpu_stats_count <= MAX_CPU_COUNT && IS_USER_ADDRESS(cpu_stats) &&
+        IS_USER_ADDRESS(cpu_stats + cpu_stats_count)) {
+        for (int i = 0; i < cpu_count && i < cpu_stats_count; i++) {
+            const PerCPUPageCache *cache = &state_get_for_any_cpu(i)->page_cache;
+            const PerCPUZeroPool *zero_pool = &state_get_for_any_cpu(i)->zero_pool;
+
+            cpu_stats[i].page_cache_alloc_hits = cache->alloc_hits;
+            cpu_stats[i].page_cache_alloc_misses = cache->alloc_misses;
+            cpu_stats[i].page_cache_free_hits = cache->free_hits;
+            cpu_stats[i].page_cache_free_misses = cache->free_misses;
+            cpu_stats[i].page_cache_pages = cache->count;
+            cpu_stats[i].zero_pool_hits = zero_pool->hits;
+            cpu_stats[i].zero_pool_misses = zero_pool->misses;
+            cpu_stats[i].zero_pool_zeroed = zero_pool->zeroed;
+            cpu_stats[i].zero_pool_pages = zero_pool->count;
+        }
     }
 
-    return RESULT_OK();
+    return RESULT_OK_VAL(cpu_count);
+}
+
+SYSCALL_HANDLER(sched_stats) {
+    AnosCpuSchedStats *cpu_stats = (AnosCpuSchedStats *)arg0;
+    const uint64_t cpu_stats_count = (uint64_t)arg1;
+
+    if (!cpu_stats || !cpu_stats_count || cpu_stats_count > MAX_CPU_COUNT || !IS_USER_ADDRESS(cpu_stats) ||
+        !IS_USER_ADDRESS(cpu_stats + cpu_stats_count)) {
+        return RESULT_BADARGS();
+    }
+
+    const uint16_t cpu_count = state_get_cpu_count();
+
+    for (int i = 0; i < cpu_count && i < cpu_stats_count; i++) {
+        SchedBalanceStats balance;
+
+        if (!sched_get_balance_stats(i, &balance)) {
+            balance = (SchedBalanceStats){0};
+        }
+
+        cpu_stats[i].load = balance.load;
+        cpu_stats[i].steals = balance.steals;
+        cpu_stats[i].migrations = balance.migrations;
+        cpu_stats[i].contended = balance.contended;
+        cpu_stats[i].hot_skips = balance.hot_skips;
+    }
+
+    return RESULT_OK_VAL(cpu_count);
 }
 
 SYSCALL_HANDLER(sleep) {
@@ -172,6 +226,25 @@ SYSCALL_HANDLER(sleep) {
     return RESULT_OK();
 }
 
+static Region *insert_new_region(Process *proc, const uintptr_t start, const uintptr_t end, const uint64_t flags) {
+    Region *region = slab_alloc_block();
+    if (!region) {
+        return nullptr;
+    }
+
+    *region = (Region){
+            .start = start,
+            .end = end,
+            .flags = flags,
+            .left = nullptr,
+            .right = nullptr,
+            .height = 1,
+    };
+
+    proc->meminfo->regions = region_tree_insert(proc->meminfo->regions, region);
+    return region;
+}
+
 SYSCALL_HANDLER(create_process) {
     ProcessCreateParams *process_create_params = (ProcessCreateParams *)arg0;
 
@@ -203,6 +276,7 @@ SYSCALL_HANDLER(create_process) {
     }
 
     AddressSpaceRegion ad_regions[process_create_params->region_count];
+    const uintptr_t stack_end = process_create_params->stack_base + process_create_params->stack_size;
 
     for (int i = 0; i < process_create_params->region_count; i++) {
         ProcessMemoryRegion *src_ptr = &process_create_params->regions[i];
@@ -225,6 +299,12 @@ SYSCALL_HANDLER(create_process) {
             return RESULT_BADARGS();
         }
 
+        // The stack gets its own (automap) region, so regions can't overlap it
+        if (src_ptr->len_bytes && src_ptr->start < stack_end &&
+            src_ptr->start + src_ptr->len_bytes > process_create_params->stack_base) {
+            return RESULT_BADARGS();
+        }
+
         dst_ptr->start = src_ptr->start;
         dst_ptr->len_bytes = src_ptr->len_bytes;
     }
@@ -246,6 +326,19 @@ SYSCALL_HANDLER(create_process) {
         return RESULT_FAILURE();
     }
 
+    // Only the top of the stack is there so far, the rest comes in as it's used
+    uintptr_t stack_region_start, stack_region_end;
+
+    if (address_space_init_stack_region(process_create_params->stack_base, process_create_params->stack_size,
+                                        process_create_params->stack_value_count, &stack_region_start,
+                                        &stack_region_end) &&
+        !insert_new_region(new_process, stack_region_start, stack_region_end, VM_REGION_AUTOMAP)) {
+        // TODO LEAK address_space_destroy!
+        debugstr("Failed to create stack region\n");
+        process_destroy(new_process);
+        return RESULT_FAILURE();
+    }
+
     Task *new_task =
             task_create_user(new_process,
                              process_create_params->stack_base + process_create_params->stack_size -
@@ -315,6 +408,41 @@ static inline void undo_partial_map(const uintptr_t virtual_base, const uintptr_
 }
 #endif
 
+#ifndef NO_LARGE_PAGES
+// Map a whole (aligned) large page for map_virtual in one go, if nothing's
+// mapped there yet and we can get one - otherwise it gets small pages.
+static bool map_virtual_large_page(const uintptr_t addr, const uint64_t vmm_flags) {
+    uint64_t *pml4 = vmm_find_pml4()->entries;
+
+    if (!vmm_can_map_large_page_in(pml4, addr, PT_LEVEL_PD)) {
+        return false;
+    }
+
+#ifdef MAP_VIRT_SYSCALL_STATIC
+    Process *owner = task_current()->owner;
+    const uintptr_t phys = process_page_alloc_large(owner, physical_region);
+
+    if (phys & 0xff) {
+        return false;
+    }
+
+    if (!vmm_map_large_page_in(pml4, addr, phys, vmm_flags, PT_LEVEL_PD)) {
+        for (uintptr_t page = phys; page < phys + MEGA_PAGE_SIZE; page += VM_PAGE_SIZE) {
+            process_page_free(owner, page);
+        }
+
+        return false;
+    }
+
+    return true;
+#else
+    // Until it's written, anyway - the pagefault handler takes it from there
+    return kernel_zero_large_page &&
+           vmm_map_large_page_in(pml4, addr, kernel_zero_large_page, vmm_flags, PT_LEVEL_PD);
+#endif
+}
+#endif
+
 SYSCALL_HANDLER(map_virtual) {
     size_t size = (size_t)arg0;
     uintptr_t virtual_base = (uintptr_t)arg1;
@@ -338,38 +466,46 @@ SYSCALL_HANDLER(map_virtual) {
         return RESULT_BADARGS();
     }
 
-    // Let's try to map it in, just using small pages for now...
+    uint64_t vmm_flags = PG_PRESENT | PG_USER;
+    if (flags & ANOS_MAP_VIRTUAL_FLAG_READ) {
+        vmm_flags |= PG_READ;
+    }
+
+    if (flags & ANOS_MAP_VIRTUAL_FLAG_WRITE) {
+#ifdef MAP_VIRT_SYSCALL_STATIC
+        vmm_flags |= PG_WRITE;
+#else
+        // TODO need to figure out if already mapped and writeable,
+        //      what to do about COW and other flags...
+        vmm_flags |= PG_COPY_ON_WRITE;
+#endif
+    }
+
+    if (flags & ANOS_MAP_VIRTUAL_FLAG_EXEC) {
+        vmm_flags |= PG_EXEC;
+    }
+
+    // Let's try to map it in, using large pages where they fit...
     const uintptr_t virtual_end = virtual_base + size;
     for (uintptr_t addr = virtual_base; addr < virtual_end; addr += VM_PAGE_SIZE) {
 
+#ifndef NO_LARGE_PAGES
+        if ((addr & (MEGA_PAGE_SIZE - 1)) == 0 && addr + MEGA_PAGE_SIZE <= virtual_end &&
+            map_virtual_large_page(addr, vmm_flags)) {
+            addr += MEGA_PAGE_SIZE - VM_PAGE_SIZE;
+            continue;
+        }
+#endif
+
 #ifdef MAP_VIRT_SYSCALL_STATIC
         const uintptr_t new_page = process_page_alloc(task_current()->owner, physical_region);
 
         if (new_page & 0xff || vmm_virt_to_phys_page(addr)) {
             undo_partial_map(virtual_base, addr, new_page);
-            return 0;
+            return RESULT_TYPE(SYSCALL_FAILURE);
         }
 #endif
 
-        uint64_t vmm_flags = PG_PRESENT | PG_USER;
-        if (flags & ANOS_MAP_VIRTUAL_FLAG_READ) {
-            vmm_flags |= PG_READ;
-        }
-
-        if (flags & ANOS_MAP_VIRTUAL_FLAG_WRITE) {
-#ifdef MAP_VIRT_SYSCALL_STATIC
-            vmm_flags |= PG_WRITE;
-#else
-            // TODO need to figure out if already mapped and writeable,
-            //      what to do about COW and other flags...
-            vmm_flags |= PG_COPY_ON_WRITE;
-#endif
-        }
-
-        if (flags & ANOS_MAP_VIRTUAL_FLAG_EXEC) {
-            vmm_flags |= PG_EXEC;
-        }
-
 #ifdef MAP_VIRT_SYSCALL_STATIC
         if (!vmm_map_page(addr, new_page, vmm_flags)) {
             undo_partial_map(virtual_base, addr, new_page);
@@ -379,9 +515,7 @@ SYSCALL_HANDLER(map_virtual) {
             //      mapped. so don't unmap pages that were fine before if
             //      we fail here...
 
-            for (uintptr_t unmap_addr = virtual_base; unmap_addr < addr; unmap_addr += VM_PAGE_SIZE) {
-                vmm_unmap_page(addr);
-            }
+            vmm_unmap_pages(virtual_base, (addr - virtual_base) >> VM_PAGE_LINEAR_SHIFT);
 #endif
             return RESULT_TYPE(SYSCALL_FAILURE);
         }
@@ -409,12 +543,8 @@ SYSCALL_HANDLER(unmap_virtual) {
         return RESULT_BADARGS();
     }
 
-    while (size > 0) {
-        vmm_unmap_page(virtual_base);
-
-        virtual_base += VM_PAGE_SIZE;
-        size -= VM_PAGE_SIZE;
-    }
+    // Large pages wholly inside the range go in one go
+    vmm_unmap_pages(virtual_base, size >> VM_PAGE_LINEAR_SHIFT);
 
     return RESULT_OK();
 }
@@ -429,7 +559,7 @@ SYSCALL_HANDLER(send_message) {
     const size_t size = (size_t)arg2;
     void *buffer = (void *)arg3;
 
-    if (IS_USER_ADDRESS(buffer) && IS_PAGE_ALIGNED(buffer)) {
+    if (IS_USER_ADDRESS(buffer) && IS_USER_ADDRESS((uintptr_t)buffer + size) && IS_PAGE_ALIGNED(buffer)) {
         const uint64_t result = ipc_channel_send(channel_cookie, tag, size, buffer);
 
         if (result) {
@@ -474,6 +604,98 @@ SYSCALL_HANDLER(reply_message) {
     return RESULT_FAILURE();
 }
 
+SYSCALL_HANDLER(send_message_async) {
+    const uint64_t channel_cookie = (uint64_t)arg0;
+    const uint64_t tag = (uint64_t)arg1;
+    const size_t size = (size_t)arg2;
+    void *buffer = (void *)arg3;
+
+    if (IS_USER_ADDRESS(buffer) && IS_USER_ADDRESS((uintptr_t)buffer + size) && IS_PAGE_ALIGNED(buffer)) {
+        const uint64_t result = ipc_channel_send_async(channel_cookie, tag, size, buffer);
+
+        if (result) {
+            return RESULT_OK_VAL(result);
+        }
+
+        return RESULT_FAILURE();
+    }
+
+    return RESULT_BADARGS();
+}
+
+SYSCALL_HANDLER(wait_reply) {
+    const uint64_t message_cookie = (uint64_t)arg0;
+    uint64_t *reply = (uint64_t *)arg1;
+
+    if (!IS_USER_ADDRESS(reply)) {
+        return RESULT_BADARGS();
+    }
+
+    bool handled = false;
+    const uint64_t result = ipc_channel_wait_reply(message_cookie, reply, &handled);
+
+    if (result && handled) {
+        return RESULT_OK_VAL(result);
+    }
+
+    // Value is still the message cookie if the channel went away before it was handled
+    return RESULT_TYPE_VALUE(SYSCALL_FAILURE, result);
+}
+
+SYSCALL_HANDLER(create_ring) {
+    const uint32_t ring_pages = (uint32_t)arg0;
+    const uintptr_t vaddr = (uintptr_t)arg1;
+
+    if (!IS_USER_ADDRESS(vaddr) || !IS_PAGE_ALIGNED(vaddr)) {
+        return RESULT_BADARGS();
+    }
+
+    const uint64_t cookie = ipc_ring_create(ring_pages, vaddr);
+
+    if (cookie) {
+        return RESULT_OK_VAL(cookie);
+    }
+
+    return RESULT_FAILURE();
+}
+
+SYSCALL_HANDLER(attach_ring) {
+    const uint64_t cookie = (uint64_t)arg0;
+    const uintptr_t vaddr = (uintptr_t)arg1;
+
+    if (!IS_USER_ADDRESS(vaddr) || !IS_PAGE_ALIGNED(vaddr)) {
+        return RESULT_BADARGS();
+    }
+
+    const size_t size = ipc_ring_attach(cookie, vaddr);
+
+    if (size) {
+        return RESULT_OK_VAL(size);
+    }
+
+    return RESULT_FAILURE();
+}
+
+SYSCALL_HANDLER(ring_wait) {
+    const uint64_t cookie = (uint64_t)arg0;
+
+    if (ipc_ring_wait(cookie)) {
+        return RESULT_OK();
+    }
+
+    return RESULT_FAILURE();
+}
+
+SYSCALL_HANDLER(ring_notify) {
+    const uint64_t cookie = (uint64_t)arg0;
+
+    if (ipc_ring_notify(cookie)) {
+        return RESULT_OK();
+    }
+
+    return RESULT_FAILURE();
+}
+
 SYSCALL_HANDLER(create_channel) {
     const uint64_t cookie = ipc_channel_create();
 
@@ -590,6 +812,22 @@ static bool region_tree_overlaps(const Region *node, const uintptr_t start, cons
     return false;
 }
 
+// With VM_REGION_POPULATE, fault in the new part of the region now rather than
+// as it's touched. If that runs out of memory the region's still there, and
+// the rest faults in as usual - but the caller gets to know.
+static SyscallResult populate_new_region(Process *proc, const Region *region, const uintptr_t start,
+                                         const uintptr_t end) {
+    if ((region->flags & (VM_REGION_AUTOMAP | VM_REGION_POPULATE)) != (VM_REGION_AUTOMAP | VM_REGION_POPULATE)) {
+        return RESULT_OK();
+    }
+
+    if (!vm_region_populate(proc, region, start, end)) {
+        return RESULT_FAILURE();
+    }
+
+    return RESULT_OK();
+}
+
 SYSCALL_HANDLER(create_region) {
     const uintptr_t start = (uintptr_t)arg0;
     const uintptr_t end = (uintptr_t)arg1;
@@ -607,7 +845,7 @@ SYSCALL_HANDLER(create_region) {
         return RESULT_BADARGS();
     }
 
-    const Process *proc = task_current()->owner;
+    Process *proc = task_current()->owner;
 
     // Try coalescing with an adjacent region if one exists
     // TODO this is probably dangerous
@@ -618,7 +856,7 @@ SYSCALL_HANDLER(create_region) {
         } else if (start == adj->end) {
             adj->end = end;
         }
-        return RESULT_OK();
+        return populate_new_region(proc, adj, start, end);
     }
 
     if (region_tree_overlaps(proc->meminfo->regions, start, end)) {
@@ -627,27 +865,16 @@ SYSCALL_HANDLER(create_region) {
         return RESULT_OK();
     }
 
-    Region *region = slab_alloc_block();
+    Region *region = insert_new_region(proc, start, end, flags);
     if (!region) {
         return RESULT_FAILURE();
     }
 
-    *region = (Region){
-            .start = start,
-            .end = end,
-            .flags = flags,
-            .left = nullptr,
-            .right = nullptr,
-            .height = 1,
-    };
-
-    proc->meminfo->regions = region_tree_insert(proc->meminfo->regions, region);
-
 #ifdef DEBUG_REGION_SYSCALLS
     debugstr("CREATE REGION OK!\n");
 #endif
 
-    return RESULT_OK();
+    return populate_new_region(proc, region, start, end);
 }
 
 SYSCALL_HANDLER(destroy_region) {
@@ -1068,6 +1295,13 @@ uint64_t *syscall_init_capabilities(uint64_t *stack) {
     stack_syscall_capability_cookie(SYSCALL_ID_WAIT_INTERRUPT, SYSCALL_NAME(wait_interrupt));
     stack_syscall_capability_cookie(SYSCALL_ID_READ_KERNEL_LOG, SYSCALL_NAME(read_kernel_log));
     stack_syscall_capability_cookie(SYSCALL_ID_GET_FRAMEBUFFER_PHYS, SYSCALL_NAME(get_framebuffer_phys));
+    stack_syscall_capability_cookie(SYSCALL_ID_SEND_MESSAGE_ASYNC, SYSCALL_NAME(send_message_async));
+    stack_syscall_capability_cookie(SYSCALL_ID_WAIT_REPLY, SYSCALL_NAME(wait_reply));
+    stack_syscall_capability_cookie(SYSCALL_ID_CREATE_RING, SYSCALL_NAME(create_ring));
+    stack_syscall_capability_cookie(SYSCALL_ID_ATTACH_RING, SYSCALL_NAME(attach_ring));
+    stack_syscall_capability_cookie(SYSCALL_ID_RING_WAIT, SYSCALL_NAME(ring_wait));
+    stack_syscall_capability_cookie(SYSCALL_ID_RING_NOTIFY, SYSCALL_NAME(ring_notify));
+    stack_syscall_capability_cookie(SYSCALL_ID_SCHED_STATS, SYSCALL_NAME(sched_stats));
 
     // Stack dummy argc/argv for now
     // TODO this needs refactoring, syscall init shouldn't be responsible
@@ -8,12 +8,12 @@
 #include <stdint.h>
 #include <stdnoreturn.h>
 
-#include "anos_assert.h"
 #include "fba/alloc.h"
 #include "klog.h"
 #include "panic.h"
 #include "pmm/pagealloc.h"
 #include "sched.h"
+#include "smp/state.h"
 #include "syscalls.h"
 #include "vmm/vmconfig.h"
 #include "vmm/vmmapper.h"
@@ -36,15 +36,6 @@
 #define IDLE_STACKS_PER_BLOCK ((4))
 #endif
 
-#define IDLE_STACK_BLOCKS (((MAX_CPU_COUNT / IDLE_STACKS_PER_BLOCK)))
-
-#if IDLE_STACK_BLOCKS < 1
-#undef IDLE_STACK_BLOCKS
-#define IDLE_STACK_BLOCKS 1
-#endif
-
-static_assert(IDLE_STACK_BLOCKS > 0, "Must allocate at least one block for idle stacks");
-
 #define IDLE_STACK_CPU_OFFSET (((KERNEL_FBA_BLOCK_SIZE / IDLE_STACKS_PER_BLOCK)))
 
 extern MemoryRegion *physical_region;
@@ -57,6 +48,7 @@ extern uintptr_t _system_bin_start_phys;
 
 static void *idle_sstack_page;
 static void *idle_ustack_page;
+static uint16_t idle_stack_count;
 
 extern volatile bool ap_startup_wait;
 
@@ -65,13 +57,17 @@ void kernel_thread_entrypoint(void);
 
 static void init_idle_stacks(void) {
     // Set up pages for idle stacks ('user' and 'kernel' (really run, and interrupt...))
-    //      (MAX_CPU_COUNT stacks of FBA_BLOCK_SIZE / 4 bytes each)
+    //      (one stack of FBA_BLOCK_SIZE / 4 bytes for each CPU we found at boot)
     // currently this means 1KiB stack per CPU, which should be
     // plenty (too much, even) for idle...
     //
     // TODO these could probably come straight from the PMM, no need to waste FBA space on them?
-    idle_ustack_page = fba_alloc_blocks(IDLE_STACK_BLOCKS);
-    idle_sstack_page = fba_alloc_blocks(IDLE_STACK_BLOCKS);
+    idle_stack_count = state_get_cpu_capacity();
+
+    const uint32_t blocks = (idle_stack_count + IDLE_STACKS_PER_BLOCK - 1) / IDLE_STACKS_PER_BLOCK;
+
+    idle_ustack_page = fba_alloc_blocks(blocks);
+    idle_sstack_page = fba_alloc_blocks(blocks);
 
     if (!(idle_ustack_page && idle_sstack_page)) {
         panic("Failed to allocate idle stacks");
@@ -80,15 +76,15 @@ static void init_idle_stacks(void) {
 
 void prepare_system(void) { init_idle_stacks(); }
 
-static inline uintptr_t idle_stack_top(uint8_t cpu_id) {
+static inline uintptr_t idle_stack_top(uint16_t cpu_id) {
     return IDLE_STACK_CPU_OFFSET * cpu_id + IDLE_STACK_CPU_OFFSET;
 }
 
-noreturn void start_system_ap(uint8_t cpu_id) {
+noreturn void start_system_ap(uint16_t cpu_id) {
 #ifdef CONSERVATIVE_BUILD
     // invariant checks...
-    if (cpu_id >= MAX_CPU_COUNT) {
-        panic("start_system_ap cpu_id beyond MAX_CPU_COUNT");
+    if (cpu_id >= idle_stack_count) {
+        panic("start_system_ap cpu_id beyond CPUs found at boot");
     }
     if (!idle_sstack_page) {
         panic("start_system_ap called before start_system");
@@ -15,10 +15,15 @@
 #include "slab/alloc.h"
 #include "smp/state.h"
 #include "task.h"
+#include "vmm/asid.h"
 
 #include "printdec.h"
 #include "std/string.h"
 
+#ifdef ARCH_X86_64
+#include "x86_64/fpu.h"
+#endif
+
 #ifdef DEBUG_TASK_SWITCH
 #include "debugprint.h"
 #include "kprintf.h"
@@ -115,11 +120,30 @@ void task_init(void *tss) {
 
 Task *task_current() { return get_cpu_task_state()->task_current_ptr; }
 
+// Keep each process' cpu_mask to just the CPUs that have its PML4 loaded, so
+// shootdowns only need to go to those. Other CPUs are marked stale instead, and
+// flush its ASID when they switch back to it (see vmm/asid.h).
+static inline void update_cpu_masks(const Task *prev, const Task *next) {
+    const uint16_t cpu = state_get_for_this_cpu()->cpu_id;
+
+    if (next->owner && !cpu_mask_test(&next->owner->cpus->cpu_mask, cpu, __ATOMIC_RELAXED)) {
+        // Must be visible before we load CR3, pairs with the fence in shootdown
+        cpu_mask_set(&next->owner->cpus->cpu_mask, cpu, __ATOMIC_SEQ_CST);
+    }
+
+    // Clearing before the switch is fine - we don't touch user mappings from here until the new tables load
+    if (prev && prev->owner && prev->pml4 != next->pml4) {
+        cpu_mask_clear(&prev->owner->cpus->cpu_mask, cpu, __ATOMIC_RELEASE);
+    }
+}
+
 void task_switch(Task *next) {
     vdebug("Switching task: ");
     vdbgx64((uint64_t)next);
     vdebug("\n");
 
+    update_cpu_masks(task_current(), next);
+    asid_switch_to(next->owner, next->pml4);
     task_do_switch(next);
 }
 
@@ -138,6 +162,10 @@ Task *task_create_new(Process *owner, const uintptr_t sp, const uintptr_t sys_ss
     task->data = &task->sdata;
     task->sched = &task->ssched;
 
+#ifdef ARCH_X86_64
+    fpu_init_task_state(task->data);
+#endif
+
     tdebugf("sdata @ 0x%016lx; ssched @ 0x%016lx\n", (uintptr_t)&task->sdata, (uintptr_t)&task->sched);
 
     task->sched->tid = next_tid++;
@@ -98,6 +98,10 @@ void cpu_invalidate_tlb_addr(uintptr_t virt_addr) {
     // Mock implementation - just record that invalidation was called
 }
 
+void cpu_invalidate_tlb_all(void) {
+    // Mock implementation - nothing to do
+}
+
 // Mock spinlock functions
 uint64_t spinlock_lock_irqsave(SpinLock *lock) {
     return 0x42; // Mock flags
@@ -115,6 +119,8 @@ uintptr_t page_alloc(MemoryRegion *region) {
     return page;
 }
 
+uintptr_t page_alloc_zeroed(MemoryRegion *region) { return 0xff; }
+
 // Helper to convert from virt to phys and vice versa
 static inline uintptr_t vmm_phys_to_virt(uintptr_t phys_addr) { return DIRECT_MAP_BASE + phys_addr; }
 
@@ -88,6 +88,8 @@ uintptr_t page_alloc(MemoryRegion *region) {
     return page;
 }
 
+uintptr_t page_alloc_zeroed(MemoryRegion *region) { return 0xff; }
+
 // Helper to convert from virt to phys and vice versa
 static inline uintptr_t vmm_phys_to_virt(uintptr_t phys_addr) { return DIRECT_MAP_BASE + phys_addr; }
 
@@ -0,0 +1,193 @@
+/*
+ * Microbenchmark - x86_64 task switch FPU / register state
+ * anos - An Operating System
+ *
+ * Copyright (c) 2025 Ross Bamford
+ *
+ * What task_do_switch pays to save the outgoing task's state and
+ * restore the incoming one's, ping-ponging between two task data
+ * areas just like two tasks would:
+ *
+ *   fxsave_*     - fxsave64 / fxrstor64 (the old way, no AVX state)
+ *   xsave_*      - xsave64 / xrstor64
+ *   xsaveopt_*   - xsaveopt64 / xrstor64, which skips components that
+ *                  are in init state or haven't changed since restore
+ *
+ * with each task either leaving SIMD state alone ("clean"), or dirtying
+ * the AVX (and AVX-512, where there is any) registers before every
+ * switch ("avx"). XSAVES is the same again with a compacted area, but
+ * it's privileged so can't be run from here.
+ *
+ *   regs_*       - push / pop of the old 15 register set vs the 8
+ *                  callee-saved ones we keep now.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "bench.h"
+#include "task.h"
+#include "x86_64/fpu.h"
+
+#define SWITCHES ((4000000))
+
+#define CPUID_1_ECX_OSXSAVE ((1 << 27))
+#define CPUID_D_1_EAX_XSAVEOPT ((1 << 0))
+
+#define FPU_FCW_DEFAULT ((0x37F))
+#define FPU_MXCSR_DEFAULT ((0x1F80))
+
+typedef enum {
+    MODE_FXSAVE,
+    MODE_XSAVE,
+    MODE_XSAVEOPT,
+} BenchMode;
+
+static uint8_t areas[2][TASK_DATA_SIZE] __attribute__((aligned(64)));
+static uint32_t rfbm_lo, rfbm_hi;
+static bool has_avx512;
+
+static inline void cpuid_sub(const uint32_t leaf, const uint32_t sub, uint32_t *eax, uint32_t *ebx, uint32_t *ecx,
+                             uint32_t *edx) {
+    __asm__ volatile("cpuid" : "=a"(*eax), "=b"(*ebx), "=c"(*ecx), "=d"(*edx) : "a"(leaf), "c"(sub));
+}
+
+// Both areas start out as the init state, like a new task's would
+static void reset_areas(void) {
+    for (int i = 0; i < 2; i++) {
+        for (int j = 0; j < TASK_DATA_SIZE; j++) {
+            areas[i][j] = 0;
+        }
+
+        *(uint16_t *)&areas[i][0] = FPU_FCW_DEFAULT;
+        *(uint32_t *)&areas[i][24] = FPU_MXCSR_DEFAULT;
+    }
+}
+
+// No clobbers - nothing else in the loop touches SIMD registers, and
+// naming zmm16 would need AVX-512 enabled for the whole file
+static inline void dirty_simd(void) {
+    __asm__ volatile("vpcmpeqd %ymm15, %ymm15, %ymm15");
+
+    if (has_avx512) {
+        __asm__ volatile("vpternlogd $0xff, %zmm16, %zmm16, %zmm16");
+    }
+}
+
+static inline void save(const BenchMode mode, uint8_t *area) {
+    switch (mode) {
+    case MODE_FXSAVE:
+        __asm__ volatile("fxsave64 (%0)" : : "r"(area) : "memory");
+        break;
+    case MODE_XSAVE:
+        __asm__ volatile("xsave64 (%0)" : : "r"(area), "a"(rfbm_lo), "d"(rfbm_hi) : "memory");
+        break;
+    case MODE_XSAVEOPT:
+        __asm__ volatile("xsaveopt64 (%0)" : : "r"(area), "a"(rfbm_lo), "d"(rfbm_hi) : "memory");
+        break;
+    }
+}
+
+static inline void restore(const BenchMode mode, uint8_t *area) {
+    if (mode == MODE_FXSAVE) {
+        __asm__ volatile("fxrstor64 (%0)" : : "r"(area) : "memory");
+    } else {
+        __asm__ volatile("xrstor64 (%0)" : : "r"(area), "a"(rfbm_lo), "d"(rfbm_hi) : "memory");
+    }
+}
+
+static void bench_switch(const char *name, const BenchMode mode, const bool dirty) {
+    reset_areas();
+    restore(mode, areas[0]);
+
+    const uint64_t start = bench_now_ns();
+
+    for (int i = 0; i < SWITCHES; i++) {
+        if (dirty) {
+            dirty_simd();
+        }
+
+        save(mode, areas[i & 1]);
+        restore(mode, areas[(i + 1) & 1]);
+    }
+
+    const uint64_t elapsed = bench_now_ns() - start;
+
+    // Don't leave the rest of the program running with dirty upper state
+    reset_areas();
+    restore(mode, areas[0]);
+
+    const uint64_t xcr0 = mode == MODE_FXSAVE ? 0 : ((uint64_t)rfbm_hi << 32) | rfbm_lo;
+    bench_report("fpu", name, "xcr0", xcr0, SWITCHES, elapsed);
+}
+
+static void bench_regs(void) {
+    uint64_t start = bench_now_ns();
+
+    for (int i = 0; i < SWITCHES; i++) {
+        __asm__ volatile("sub $128, %%rsp\n\t" // Stay clear of the red zone
+                         "push %%rax\n\tpush %%rbx\n\tpush %%rcx\n\tpush %%rdx\n\tpush %%rbp\n\t"
+                         "push %%r8\n\tpush %%r9\n\tpush %%r10\n\tpush %%r11\n\tpush %%r12\n\t"
+                         "push %%r13\n\tpush %%r14\n\tpush %%r15\n\tpush %%rsi\n\tpush %%rdi\n\t"
+                         "pop %%rdi\n\tpop %%rsi\n\tpop %%r15\n\tpop %%r14\n\tpop %%r13\n\t"
+                         "pop %%r12\n\tpop %%r11\n\tpop %%r10\n\tpop %%r9\n\tpop %%r8\n\t"
+                         "pop %%rbp\n\tpop %%rdx\n\tpop %%rcx\n\tpop %%rbx\n\tpop %%rax\n\tadd $128, %%rsp" ::
+                                 : "memory");
+    }
+
+    bench_report("fpu", "regs_all", "count", 15, SWITCHES, bench_now_ns() - start);
+
+    start = bench_now_ns();
+
+    for (int i = 0; i < SWITCHES; i++) {
+        __asm__ volatile("sub $128, %%rsp\n\t"
+                         "push %%rbx\n\tpush %%rbp\n\tpush %%r12\n\tpush %%r13\n\t"
+                         "push %%r14\n\tpush %%r15\n\tpush %%rsi\n\tpush %%rdi\n\t"
+                         "pop %%rdi\n\tpop %%rsi\n\tpop %%r15\n\tpop %%r14\n\t"
+                         "pop %%r13\n\tpop %%r12\n\tpop %%rbp\n\tpop %%rbx\n\tadd $128, %%rsp" ::
+                                 : "memory");
+    }
+
+    bench_report("fpu", "regs_callee", "count", 8, SWITCHES, bench_now_ns() - start);
+}
+
+int main(void) {
+    uint32_t eax, ebx, ecx, edx;
+
+    bench_regs();
+    bench_switch("fxsave_clean", MODE_FXSAVE, false);
+
+    cpuid_sub(1, 0, &eax, &ebx, &ecx, &edx);
+
+    if (!(ecx & CPUID_1_ECX_OSXSAVE)) {
+        printf("fpu: no XSAVE on this host, skipping the rest\n");
+        return 0;
+    }
+
+    __asm__ volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+    const uint64_t xcr0 =
+            (((uint64_t)edx << 32) | eax) & (FPU_XCR0_X87 | FPU_XCR0_SSE | FPU_XCR0_AVX | FPU_XCR0_AVX512);
+
+    rfbm_lo = (uint32_t)xcr0;
+    rfbm_hi = (uint32_t)(xcr0 >> 32);
+    has_avx512 = (xcr0 & FPU_XCR0_AVX512) == FPU_XCR0_AVX512;
+
+    if (!(xcr0 & FPU_XCR0_AVX)) {
+        printf("fpu: no AVX on this host, skipping the rest\n");
+        return 0;
+    }
+
+    bench_switch("fxsave_avx", MODE_FXSAVE, true);
+    bench_switch("xsave_clean", MODE_XSAVE, false);
+    bench_switch("xsave_avx", MODE_XSAVE, true);
+
+    cpuid_sub(0xd, 1, &eax, &ebx, &ecx, &edx);
+
+    if (eax & CPUID_D_1_EAX_XSAVEOPT) {
+        bench_switch("xsaveopt_clean", MODE_XSAVEOPT, false);
+        bench_switch("xsaveopt_avx", MODE_XSAVEOPT, true);
+    }
+
+    return 0;
+}
@@ -11,17 +11,50 @@
 #include "munit.h"
 
 #include "x86_64/kdrivers/cpu.h"
+#include "x86_64/std_routines.h"
 
 // just reimplement CPUID in a basic way - our ASM one is a PITA to build hosted
 // (e.g. 32-bit relocs on macho64)
 void init_cpuid(void) { /* nothing */ }
 
+static bool cpuid_fails = false;
+
 bool cpuid(uint32_t leaf, uint32_t *eax, uint32_t *ebx, uint32_t *ecx, uint32_t *edx) {
+    if (cpuid_fails) {
+        return false;
+    }
+
     __asm__ volatile("cpuid" : "=a"(*eax), "=b"(*ebx), "=c"(*ecx), "=d"(*edx) : "a"(leaf), "c"(0));
 
     return true;
 }
 
+static uint32_t std_features = 0xffffffff;
+
+void std_routines_set_features(uint32_t features) { std_features = features; }
+
+static MunitResult test_init_std_routines(const MunitParameter params[], void *data) {
+    uint32_t eax, ebx, ecx, edx;
+    cpuid(7, &eax, &ebx, &ecx, &edx);
+
+    munit_assert_true(cpu_init_this());
+
+    // Bit 9 of EBX: ERMS, bit 4 of EDX: FSRM
+    munit_assert_uint32(!!(std_features & STD_ROUTINES_FEATURE_ERMS), ==, !!(ebx & (1 << 9)));
+    munit_assert_uint32(!!(std_features & STD_ROUTINES_FEATURE_FSRM), ==, !!(edx & (1 << 4)));
+
+    return MUNIT_OK;
+}
+
+static MunitResult test_read_local_apic_id_no_cpuid(const MunitParameter params[], void *data) {
+    // Whatever's lying around in the registers, never garbage
+    cpuid_fails = true;
+    munit_assert_uint64(cpu_read_local_apic_id(), ==, 0);
+    cpuid_fails = false;
+
+    return MUNIT_OK;
+}
+
 static MunitResult test_rdseed64(const MunitParameter params[], void *data) {
     uint64_t val1 = 0, val2 = 0;
 
@@ -62,17 +95,28 @@ static MunitResult test_rdrand32(const MunitParameter params[], void *data) {
     return MUNIT_OK;
 }
 
-static MunitTest tests_all[] = {{"/rdseed64", test_rdseed64, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL},
+static MunitTest tests_all[] = {{"/init_std_routines", test_init_std_routines, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL},
+                                {"/read_local_apic_id_no_cpuid", test_read_local_apic_id_no_cpuid, NULL, NULL,
+                                 MUNIT_TEST_OPTION_NONE, NULL},
+                                {"/rdseed64", test_rdseed64, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL},
                                 {"/rdseed32", test_rdseed32, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL},
                                 {"/rdrand64", test_rdrand64, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL},
                                 {"/rdrand32", test_rdrand32, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL},
                                 {NULL, NULL, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL}};
 
-static MunitTest tests_rdseed_only[] = {{"/rdseed64", test_rdseed64, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL},
+static MunitTest tests_rdseed_only[] = {{"/init_std_routines", test_init_std_routines, NULL, NULL,
+                                         MUNIT_TEST_OPTION_NONE, NULL},
+                                        {"/read_local_apic_id_no_cpuid", test_read_local_apic_id_no_cpuid, NULL,
+                                         NULL, MUNIT_TEST_OPTION_NONE, NULL},
+                                        {"/rdseed64", test_rdseed64, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL},
                                         {"/rdseed32", test_rdseed32, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL},
                                         {NULL, NULL, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL}};
 
-static MunitTest tests_rdrand_only[] = {{"/rdrand64", test_rdrand64, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL},
+static MunitTest tests_rdrand_only[] = {{"/init_std_routines", test_init_std_routines, NULL, NULL,
+                                         MUNIT_TEST_OPTION_NONE, NULL},
+                                        {"/read_local_apic_id_no_cpuid", test_read_local_apic_id_no_cpuid, NULL,
+                                         NULL, MUNIT_TEST_OPTION_NONE, NULL},
+                                        {"/rdrand64", test_rdrand64, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL},
                                         {"/rdrand32", test_rdrand32, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL},
                                         {NULL, NULL, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL}};
 
@@ -40,7 +40,7 @@ void cpu_tsc_udelay(int n) {
 // Buffer must have space for 49 characters!
 void cpu_get_brand_str(char *buffer) { strncpy(buffer, brand, 49); }
 
-void cpu_debug_info(uint8_t cpu_num) {
+void cpu_debug_info(uint16_t cpu_num) {
     // noop
 }
 
@@ -74,6 +74,10 @@ inline void cpu_store_idtr(IDTR *idtr) {
 
 inline void cpu_invalidate_tlb_addr(uintptr_t virt_addr) { mock_invlpg_count++; }
 
+inline void cpu_invalidate_tlb_all(void) {
+    // noop
+}
+
 inline void cpu_swapgs(void) {
     // noop
 }
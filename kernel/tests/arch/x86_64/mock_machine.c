@@ -36,6 +36,11 @@ static uint32_t max_intr_disable_level;
 
 static bool waited_for_interrupt;
 
+static uint64_t upticks;
+static uint64_t nanos;
+static uint64_t last_oneshot_nanos;
+static uint32_t oneshot_count;
+
 void mock_machine_reset(void) {
     for (int i = 0; i < 65536; i++) {
         in_buffer_read_ptr[i] = 0;
@@ -47,6 +52,10 @@ void mock_machine_reset(void) {
     intr_disable_level = 0;
     max_intr_disable_level = 0;
     waited_for_interrupt = false;
+    upticks = 0;
+    nanos = 0;
+    last_oneshot_nanos = 0;
+    oneshot_count = 0;
 }
 
 inline bool mock_machine_outl_avail(uint16_t port) { return out_buffer_read_ptr[port] != out_buffer_write_ptr[port]; }
@@ -151,6 +160,23 @@ void restore_saved_interrupts(uint64_t state) {
     --intr_disable_level;
 }
 
+void mock_machine_set_upticks(uint64_t ticks) { upticks = ticks; }
+
+uint64_t get_kernel_upticks(void) { return upticks; }
+
+void mock_machine_set_nanos(uint64_t value) { nanos = value; }
+
+uint64_t get_kernel_nanos(void) { return nanos; }
+
+void kernel_timer_oneshot(uint64_t value) {
+    last_oneshot_nanos = value;
+    oneshot_count++;
+}
+
+uint64_t mock_machine_last_oneshot_nanos(void) { return last_oneshot_nanos; }
+
+uint32_t mock_machine_oneshot_count(void) { return oneshot_count; }
+
 uint32_t mock_machine_intr_disable_level() { return intr_disable_level; }
 
 uint32_t mock_machine_max_intr_disable_level() { return max_intr_disable_level; }
@@ -41,6 +41,25 @@ static MunitResult test_spinlock_lock_unlock(const MunitParameter params[], void
     return MUNIT_OK;
 }
 
+static MunitResult test_spinlock_try_lock(const MunitParameter params[], void *param) {
+    SpinLock lock = {0x0, 0x0};
+
+    munit_assert_true(spinlock_try_lock(&lock));
+    munit_assert_int64(lock.lock, ==, 1);
+
+    // Already held, must not wait
+    munit_assert_false(spinlock_try_lock(&lock));
+    munit_assert_int64(lock.lock, ==, 1);
+
+    spinlock_unlock(&lock);
+    munit_assert_int64(lock.lock, ==, 0);
+
+    munit_assert_true(spinlock_try_lock(&lock));
+    spinlock_unlock(&lock);
+
+    return MUNIT_OK;
+}
+
 static void *spinlock_thread_func(void *arg) {
     SpinLock *lock = (SpinLock *)arg;
     uint64_t thread_id = (uint64_t)pthread_self();
@@ -163,6 +182,7 @@ static MunitResult test_reentrant_multithreaded(const MunitParameter params[], v
 static MunitTest test_suite_tests[] = {
         {(char *)"/init", test_spinlock_init, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL},
         {(char *)"/lock_unlock", test_spinlock_lock_unlock, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL},
+        {(char *)"/try_lock", test_spinlock_try_lock, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL},
         {(char *)"/spinlock_multithreaded", test_spinlock_multithreaded, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL},
 
         {(char *)"/reentrant_init", test_spinlock_reentrant_init, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL},
@@ -1,8 +1,10 @@
 #include <stdint.h>
+#include <stdlib.h>
 #include <string.h>
 
 #include "munit.h"
 #include "std/string.h"
+#include "x86_64/std_routines.h"
 
 void *anos_std_memcpy(void *restrict dest, const void *restrict src, size_t count);
 void *anos_std_memmove(void *dest, const void *src, size_t count);
@@ -81,10 +83,182 @@ static MunitResult test_memset(const MunitParameter params[], void *data) {
     return MUNIT_OK;
 }
 
+// Every path - plain loops, rep movsb / stosb, and the short rep movsb
+static const uint32_t feature_sets[] = {0, STD_ROUTINES_FEATURE_ERMS,
+                                        STD_ROUTINES_FEATURE_ERMS | STD_ROUTINES_FEATURE_FSRM};
+
+#define FEATURE_SET_COUNT ((sizeof(feature_sets) / sizeof(feature_sets[0])))
+#define SWEEP_MAX ((600))
+#define GUARD ((0xEE))
+
+static void fill_pattern(uint8_t *buffer, const size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        buffer[i] = (uint8_t)(i * 7 + 3);
+    }
+}
+
+static MunitResult test_memcpy_sweep(const MunitParameter params[], void *data) {
+    static uint8_t src[SWEEP_MAX + 16];
+    static uint8_t dest[SWEEP_MAX + 32];
+
+    fill_pattern(src, sizeof(src));
+
+    for (int f = 0; f < FEATURE_SET_COUNT; f++) {
+        std_routines_set_features(feature_sets[f]);
+
+        for (size_t count = 0; count <= SWEEP_MAX; count += (count < 300 ? 1 : 37)) {
+            for (int src_off = 0; src_off < 8; src_off++) {
+                for (int dest_off = 0; dest_off < 8; dest_off++) {
+                    memset(dest, GUARD, sizeof(dest));
+
+                    munit_assert_ptr_equal(anos_std_memcpy(dest + 8 + dest_off, src + src_off, count),
+                                           dest + 8 + dest_off);
+                    munit_assert_memory_equal(count, dest + 8 + dest_off, src + src_off);
+
+                    // Nothing outside the range touched
+                    munit_assert_uint8(dest[7 + dest_off], ==, GUARD);
+                    munit_assert_uint8(dest[8 + dest_off + count], ==, GUARD);
+                }
+            }
+        }
+    }
+
+    std_routines_set_features(0);
+    return MUNIT_OK;
+}
+
+static MunitResult test_memmove_sweep(const MunitParameter params[], void *data) {
+    static uint8_t buffer[SWEEP_MAX * 2];
+    static uint8_t expected[SWEEP_MAX * 2];
+
+    for (int f = 0; f < FEATURE_SET_COUNT; f++) {
+        std_routines_set_features(feature_sets[f]);
+
+        for (size_t count = 1; count <= SWEEP_MAX; count += (count < 300 ? 1 : 37)) {
+            // Overlapping both ways, by a little and by a lot
+            const int shifts[] = {-65, -9, -1, 1, 9, 65};
+
+            for (int i = 0; i < sizeof(shifts) / sizeof(shifts[0]); i++) {
+                const size_t from = SWEEP_MAX / 2;
+                const size_t to = from + shifts[i];
+
+                fill_pattern(buffer, sizeof(buffer));
+                fill_pattern(expected, sizeof(expected));
+                memmove(expected + to, expected + from, count);
+
+                munit_assert_ptr_equal(anos_std_memmove(buffer + to, buffer + from, count), buffer + to);
+                munit_assert_memory_equal(sizeof(buffer), buffer, expected);
+            }
+        }
+    }
+
+    std_routines_set_features(0);
+    return MUNIT_OK;
+}
+
+static MunitResult test_memset_sweep(const MunitParameter params[], void *data) {
+    static uint8_t dest[SWEEP_MAX + 32];
+    static uint8_t expected[SWEEP_MAX];
+
+    for (int f = 0; f < FEATURE_SET_COUNT; f++) {
+        std_routines_set_features(feature_sets[f]);
+
+        for (size_t count = 0; count <= SWEEP_MAX; count += (count < 300 ? 1 : 37)) {
+            for (int off = 0; off < 8; off++) {
+                memset(dest, GUARD, sizeof(dest));
+                memset(expected, 0x5A, count);
+
+                munit_assert_ptr_equal(anos_std_memset(dest + 8 + off, 0x5A, count), dest + 8 + off);
+                munit_assert_memory_equal(count, dest + 8 + off, expected);
+                munit_assert_uint8(dest[7 + off], ==, GUARD);
+                munit_assert_uint8(dest[8 + off + count], ==, GUARD);
+            }
+        }
+    }
+
+    std_routines_set_features(0);
+    return MUNIT_OK;
+}
+
+static MunitResult test_page_routines(const MunitParameter params[], void *data) {
+    uint8_t *pages = aligned_alloc(4096, 3 * 4096);
+    munit_assert_not_null(pages);
+
+    for (int f = 0; f < FEATURE_SET_COUNT; f++) {
+        std_routines_set_features(feature_sets[f]);
+
+        // Copy the middle page, leaving the pages either side alone
+        fill_pattern(pages, 4096);
+        memset(pages + 4096, GUARD, 2 * 4096);
+
+        munit_assert_ptr_equal(memcpy_page(pages + 4096, pages), pages + 4096);
+        munit_assert_memory_equal(4096, pages + 4096, pages);
+        munit_assert_uint8(pages[2 * 4096], ==, GUARD);
+
+        // And clear it, both ways
+        munit_assert_ptr_equal(memclr_page(pages + 4096), pages + 4096);
+        for (int i = 0; i < 4096; i++) {
+            munit_assert_uint8(pages[4096 + i], ==, 0);
+        }
+        munit_assert_uint8(pages[4095], !=, 0);
+        munit_assert_uint8(pages[2 * 4096], ==, GUARD);
+
+        memset(pages + 4096, GUARD, 4096);
+        munit_assert_ptr_equal(memclr_page_nt(pages + 4096), pages + 4096);
+        for (int i = 0; i < 4096; i++) {
+            munit_assert_uint8(pages[4096 + i], ==, 0);
+        }
+        munit_assert_uint8(pages[2 * 4096], ==, GUARD);
+    }
+
+    std_routines_set_features(0);
+    free(pages);
+    return MUNIT_OK;
+}
+
+static MunitResult test_large_routines(const MunitParameter params[], void *data) {
+    // Big enough for the non-temporal paths, with odd ends
+    const size_t count = 300 * 1024 + 13;
+    uint8_t *src = malloc(count + 64);
+    uint8_t *dest = malloc(count + 64);
+    munit_assert_not_null(src);
+    munit_assert_not_null(dest);
+
+    for (int f = 0; f < FEATURE_SET_COUNT; f++) {
+        std_routines_set_features(feature_sets[f]);
+
+        fill_pattern(src, count + 64);
+        memset(dest, GUARD, count + 64);
+        anos_std_memcpy(dest + 3, src + 5, count);
+        munit_assert_memory_equal(count, dest + 3, src + 5);
+        munit_assert_uint8(dest[count + 3], ==, GUARD);
+
+        anos_std_memmove(src, src + 7, count);
+        munit_assert_memory_equal(count - 2, src, dest + 3 + 2);
+
+        anos_std_memset(dest + 1, 0x3C, count);
+        for (size_t i = 0; i < count; i++) {
+            munit_assert_uint8(dest[1 + i], ==, 0x3C);
+        }
+        munit_assert_uint8(dest[0], ==, GUARD);
+        munit_assert_uint8(dest[count + 1], !=, 0x3C);
+    }
+
+    std_routines_set_features(0);
+    free(src);
+    free(dest);
+    return MUNIT_OK;
+}
+
 static MunitTest tests[] = {{"/mem/cpy", test_memcpy, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL},
                             {"/mem/move", test_memmove, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL},
                             {"/mem/clr", test_memclr, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL},
                             {"/mem/set", test_memset, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL},
+                            {"/mem/cpy_sweep", test_memcpy_sweep, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL},
+                            {"/mem/move_sweep", test_memmove_sweep, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL},
+                            {"/mem/set_sweep", test_memset_sweep, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL},
+                            {"/mem/large", test_large_routines, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL},
+                            {"/mem/page", test_page_routines, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL},
                             {NULL, NULL, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL}};
 
 static const MunitSuite suite = {"/std_routines", tests, NULL, 1, MUNIT_SUITE_OPTION_NONE};
@@ -0,0 +1,172 @@
+/*
+ * Microbenchmark - x86_64 std routines
+ * anos - An Operating System
+ *
+ * Copyright (c) 2025 Ross Bamford
+ *
+ * The kernel's memcpy / memset with each set of CPU features the
+ * dispatch knows about, against the host libc for reference:
+ *
+ *   memcpy_*     - ns per copy of the given size
+ *   memset_*     - ns per fill of the given size
+ *   page_copy_*  - ns per 4KiB page copied (memcpy, or memcpy_page)
+ *   page_clear_* - ns per 4KiB page zeroed (memclr, memclr_page, or
+ *                  memclr_page_nt). The non-temporal one only looks
+ *                  good once the working set is bigger than the cache,
+ *                  it's for the zero pool rather than speed as such.
+ *
+ * "plain" has no features (the 8-byte / non-temporal loops), "erms"
+ * uses rep movsb / stosb from 128 bytes, "fsrm" from 16.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bench.h"
+#include "std/string.h"
+#include "x86_64/std_routines.h"
+
+#define BUFFER_SIZE ((1 << 20))
+#define TOTAL_BYTES ((256ULL << 20))
+
+void *anos_std_memcpy(void *restrict dest, const void *restrict src, size_t count);
+void *anos_std_memset(void *dest, int val, size_t count);
+
+static const struct {
+    const char *name;
+    uint32_t features;
+} modes[] = {
+        {"plain", 0},
+        {"erms", STD_ROUTINES_FEATURE_ERMS},
+        {"fsrm", STD_ROUTINES_FEATURE_ERMS | STD_ROUTINES_FEATURE_FSRM},
+};
+
+#define MODE_COUNT ((sizeof(modes) / sizeof(modes[0])))
+
+static const uint64_t sizes[] = {16, 64, 200, 1024, 4096, 65536};
+
+static uint8_t *src;
+static uint8_t *dest;
+
+static void bench_memcpy(const char *mode, const uint64_t size, const bool libc) {
+    const uint64_t iters = TOTAL_BYTES / size;
+    const uint64_t start = bench_now_ns();
+
+    // Walk through the buffer, so bigger sizes aren't all in L1
+    for (uint64_t i = 0, off = 0; i < iters; i++, off = (off + size) % (BUFFER_SIZE - size)) {
+        if (libc) {
+            bench_consume(memcpy(dest + off, src + off, size));
+        } else {
+            bench_consume(anos_std_memcpy(dest + off, src + off, size));
+        }
+    }
+
+    char name[32];
+    snprintf(name, sizeof(name), "memcpy_%s", mode);
+    bench_report("std_routines", name, "bytes", size, iters, bench_now_ns() - start);
+}
+
+static void bench_memset(const char *mode, const uint64_t size, const bool libc) {
+    const uint64_t iters = TOTAL_BYTES / size;
+    const uint64_t start = bench_now_ns();
+
+    for (uint64_t i = 0, off = 0; i < iters; i++, off = (off + size) % (BUFFER_SIZE - size)) {
+        if (libc) {
+            bench_consume(memset(dest + off, (int)i, size));
+        } else {
+            bench_consume(anos_std_memset(dest + off, (int)i, size));
+        }
+    }
+
+    char name[32];
+    snprintf(name, sizeof(name), "memset_%s", mode);
+    bench_report("std_routines", name, "bytes", size, iters, bench_now_ns() - start);
+}
+
+typedef enum {
+    PAGE_MEMCPY,
+    PAGE_MEMCPY_PAGE,
+    PAGE_MEMCLR,
+    PAGE_MEMCLR_PAGE,
+    PAGE_MEMCLR_PAGE_NT,
+} PageOp;
+
+static void bench_pages(const char *name, const PageOp op) {
+    const uint64_t pages = TOTAL_BYTES >> 12;
+    const uint64_t start = bench_now_ns();
+
+    for (uint64_t i = 0; i < pages; i++) {
+        const uint64_t off = (i << 12) % BUFFER_SIZE;
+
+        switch (op) {
+        case PAGE_MEMCPY:
+            bench_consume(anos_std_memcpy(dest + off, src + off, 4096));
+            break;
+        case PAGE_MEMCPY_PAGE:
+            bench_consume(memcpy_page(dest + off, src + off));
+            break;
+        case PAGE_MEMCLR:
+            bench_consume(memclr(dest + off, 4096));
+            break;
+        case PAGE_MEMCLR_PAGE:
+            bench_consume(memclr_page(dest + off));
+            break;
+        case PAGE_MEMCLR_PAGE_NT:
+            bench_consume(memclr_page_nt(dest + off));
+            break;
+        }
+    }
+
+    bench_report("std_routines", name, "pages", pages, pages, bench_now_ns() - start);
+}
+
+int main(void) {
+    src = aligned_alloc(4096, BUFFER_SIZE);
+    dest = aligned_alloc(4096, BUFFER_SIZE);
+
+    if (!src || !dest) {
+        fprintf(stderr, "Failed to allocate buffers\n");
+        return 1;
+    }
+
+    memset(src, 0xA5, BUFFER_SIZE);
+    memset(dest, 0, BUFFER_SIZE);
+
+    for (int s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+        for (int m = 0; m < MODE_COUNT; m++) {
+            std_routines_set_features(modes[m].features);
+            bench_memcpy(modes[m].name, sizes[s], false);
+        }
+        bench_memcpy("libc", sizes[s], true);
+    }
+
+    for (int s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+        for (int m = 0; m < MODE_COUNT; m++) {
+            std_routines_set_features(modes[m].features);
+            bench_memset(modes[m].name, sizes[s], false);
+        }
+        bench_memset("libc", sizes[s], true);
+    }
+
+    char name[32];
+    for (int m = 0; m < MODE_COUNT; m++) {
+        std_routines_set_features(modes[m].features);
+
+        snprintf(name, sizeof(name), "page_copy_memcpy_%s", modes[m].name);
+        bench_pages(name, PAGE_MEMCPY);
+        snprintf(name, sizeof(name), "page_copy_page_%s", modes[m].name);
+        bench_pages(name, PAGE_MEMCPY_PAGE);
+        snprintf(name, sizeof(name), "page_clear_memclr_%s", modes[m].name);
+        bench_pages(name, PAGE_MEMCLR);
+        snprintf(name, sizeof(name), "page_clear_page_%s", modes[m].name);
+        bench_pages(name, PAGE_MEMCLR_PAGE);
+    }
+
+    bench_pages("page_clear_page_nt", PAGE_MEMCLR_PAGE_NT);
+
+    free(src);
+    free(dest);
+    return 0;
+}
@@ -0,0 +1,169 @@
+/*
+ * Microbenchmark - Page fault storms in the VMM
+ * anos - An Operating System
+ *
+ * Copyright (c) 2025 Ross Bamford
+ *
+ * T threads (each its own "CPU") mapping pages one at a time, as the
+ * page fault handler does, into an area of their own - then unmapping
+ * it and starting again - with the real x86_64 mapper:
+ *
+ *   one_space   - every thread in the same address space, as threads of
+ *                 one process would be (and as every thread in the
+ *                 system was, back when there was one lock for it all)
+ *   own_space   - every thread in an address space of its own, as
+ *                 unrelated processes would be
+ *
+ * The same total work is split between the threads, so ns per fault
+ * should fall as threads are added where they don't contend.
+ *
+ * Spinlocks are real (if simple) here, since contention is the point.
+ */
+
+#define _GNU_SOURCE
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "bench.h"
+#include "pmm/pagealloc.h"
+#include "spinlock.h"
+#include "std/string.h"
+#include "vmm/vmmapper.h"
+
+#define FAULTS 4000000
+#define AREA_PAGES 512
+#define AREA_BASE ((0x40000000))
+#define AREA_STRIDE ((0x40000000))
+#define MAX_THREADS 4
+#define MAX_TABLES 256
+
+MemoryRegion *physical_region;
+
+static uint8_t *tables;
+static uint64_t tables_used;
+
+typedef struct {
+    int cpu;
+    uint64_t *pml4;
+    uint64_t faults;
+} BenchThread;
+
+uintptr_t page_alloc(MemoryRegion *region) {
+    const uint64_t table = __atomic_fetch_add(&tables_used, 1, __ATOMIC_RELAXED);
+
+    if (table >= MAX_TABLES) {
+        return 0xff;
+    }
+
+    return (uintptr_t)(tables + (table * VM_PAGE_SIZE));
+}
+
+uintptr_t page_alloc_zeroed(MemoryRegion *region) { return 0xff; }
+
+void spinlock_lock(SpinLock *lock) {
+    while (__atomic_exchange_n(&lock->lock, 1, __ATOMIC_ACQUIRE)) {
+        while (__atomic_load_n(&lock->lock, __ATOMIC_RELAXED)) {
+            __builtin_ia32_pause();
+        }
+    }
+}
+
+void spinlock_unlock(SpinLock *lock) { __atomic_store_n(&lock->lock, 0, __ATOMIC_RELEASE); }
+
+uint64_t spinlock_lock_irqsave(SpinLock *lock) {
+    spinlock_lock(lock);
+    return 0;
+}
+
+void restore_saved_interrupts(uint64_t flags) {}
+
+void cpu_invalidate_tlb_addr(uintptr_t virt_addr) {}
+void cpu_invalidate_tlb_all(void) {}
+uintptr_t cpu_read_cr3(void) { return 0; }
+
+void asid_invalidate_mapping(uintptr_t virt_addr) {}
+bool asid_take_kernel_pages(uintptr_t *virt_addr, size_t *num_pages) { return false; }
+void vmm_shootdown_kernel_pages(uintptr_t virt_addr, size_t num_pages) {}
+
+static const int thread_counts[] = {1, 2, 4};
+
+static void pin_to_cpu(const int cpu) {
+#ifdef __linux__
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+#endif
+}
+
+static uint64_t *new_address_space(void) {
+    uint64_t *pml4 = (uint64_t *)page_alloc(physical_region);
+    memclr_page(pml4);
+    return pml4;
+}
+
+static void *storm_thread(void *arg) {
+    const BenchThread *thread = arg;
+    const uintptr_t area = AREA_BASE + thread->cpu * AREA_STRIDE;
+
+    pin_to_cpu(thread->cpu);
+
+    for (uint64_t fault = 0; fault < thread->faults; fault += AREA_PAGES) {
+        for (int i = 0; i < AREA_PAGES; i++) {
+            bench_consume(vmm_map_page_in(thread->pml4, area + i * VM_PAGE_SIZE, 0x80000000 + i * VM_PAGE_SIZE,
+                                          PG_PRESENT | PG_WRITE | PG_USER));
+        }
+
+        bench_consume(vmm_unmap_pages_in(thread->pml4, area, AREA_PAGES));
+    }
+
+    return NULL;
+}
+
+static void bench_storm(const char *name, const int threads, const bool own_space) {
+    pthread_t ids[MAX_THREADS];
+    BenchThread args[MAX_THREADS];
+
+    tables_used = 0;
+    uint64_t *shared = new_address_space();
+
+    for (int i = 0; i < threads; i++) {
+        args[i].cpu = i;
+        args[i].pml4 = own_space ? new_address_space() : shared;
+        args[i].faults = FAULTS / threads;
+    }
+
+    const uint64_t start = bench_now_ns();
+
+    for (int i = 0; i < threads; i++) {
+        pthread_create(&ids[i], NULL, storm_thread, &args[i]);
+    }
+
+    for (int i = 0; i < threads; i++) {
+        pthread_join(ids[i], NULL);
+    }
+
+    const uint64_t elapsed = bench_now_ns() - start;
+
+    bench_report("faultstorm", name, "threads", threads, FAULTS, elapsed);
+}
+
+int main(void) {
+    if (posix_memalign((void **)&tables, VM_PAGE_SIZE, MAX_TABLES * VM_PAGE_SIZE)) {
+        fprintf(stderr, "Failed to allocate page tables\n");
+        return 1;
+    }
+
+    for (int i = 0; i < sizeof(thread_counts) / sizeof(thread_counts[0]); i++) {
+        bench_storm("one_space", thread_counts[i], false);
+        bench_storm("own_space", thread_counts[i], true);
+    }
+
+    free(tables);
+    return 0;
+}
@@ -0,0 +1,119 @@
+/*
+ * Microbenchmark - Large pages in the VMM
+ * anos - An Operating System
+ *
+ * Copyright (c) 2025 Ross Bamford
+ *
+ * Maps, walks and unmaps an area with the real x86_64 mapper, once
+ * where the physical side is misaligned (so it has to use 4KiB pages)
+ * and once where it's aligned (so it gets 2MiB ones):
+ *
+ *   map_*    - ns per 4KiB page to map the whole area
+ *   walk_*   - ns per translation of a random address in the area. This
+ *              is the table walk a TLB miss pays for, and it touches far
+ *              fewer (and fewer levels of) tables with large pages.
+ *   unmap_*  - ns per 4KiB page to unmap the whole area
+ *
+ * There's nothing to measure the TLB itself from here, of course - but
+ * one 2MiB entry covers what 512 4KiB ones would, so misses drop by up
+ * to that factor on top of each miss being cheaper.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "bench.h"
+#include "pmm/pagealloc.h"
+#include "spinlock.h"
+#include "std/string.h"
+#include "vmm/vmmapper.h"
+
+#define ROUNDS 16
+#define WALKS 1000000
+#define MAX_TABLES 1024
+#define AREA_BASE ((0x40000000))
+
+MemoryRegion *physical_region;
+
+static uint8_t *tables;
+static size_t tables_used;
+static PageTable *pml4;
+
+uintptr_t page_alloc(MemoryRegion *region) {
+    if (tables_used == MAX_TABLES) {
+        return 0xff;
+    }
+
+    return (uintptr_t)(tables + (tables_used++ * VM_PAGE_SIZE));
+}
+
+uintptr_t page_alloc_zeroed(MemoryRegion *region) { return 0xff; }
+
+uint64_t spinlock_lock_irqsave(SpinLock *lock) { return 0; }
+void spinlock_unlock(SpinLock *lock) {}
+void restore_saved_interrupts(uint64_t flags) {}
+
+void cpu_invalidate_tlb_addr(uintptr_t virt_addr) {}
+void cpu_invalidate_tlb_all(void) {}
+uintptr_t cpu_read_cr3(void) { return (uintptr_t)pml4; }
+
+void asid_invalidate_mapping(uintptr_t virt_addr) {}
+bool asid_take_kernel_pages(uintptr_t *virt_addr, size_t *num_pages) { return false; }
+void vmm_shootdown_kernel_pages(uintptr_t virt_addr, size_t num_pages) {}
+
+static void reset_tables(void) {
+    tables_used = 0;
+    pml4 = (PageTable *)page_alloc(physical_region);
+    memclr(pml4, VM_PAGE_SIZE);
+}
+
+static const uint64_t area_mibs[] = {2, 64, 1024};
+
+static void bench_area(const char *kind, const uint64_t mib, const uintptr_t phys_base) {
+    const size_t pages = (mib << 20) >> VM_PAGE_LINEAR_SHIFT;
+    uint64_t map_ns = 0, walk_ns = 0, unmap_ns = 0;
+
+    for (int round = 0; round < ROUNDS; round++) {
+        reset_tables();
+
+        uint64_t start = bench_now_ns();
+        bench_consume(vmm_map_pages_in(pml4->entries, AREA_BASE, phys_base, PG_PRESENT | PG_WRITE, pages));
+        map_ns += bench_now_ns() - start;
+
+        uint64_t seed = 0x2545f4914f6cdd1dULL;
+        start = bench_now_ns();
+        for (int i = 0; i < WALKS / ROUNDS; i++) {
+            seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+            bench_consume(vmm_virt_to_pt_entry(AREA_BASE + ((seed >> 20) % pages) * VM_PAGE_SIZE));
+        }
+        walk_ns += bench_now_ns() - start;
+
+        start = bench_now_ns();
+        bench_consume(vmm_unmap_pages_in(pml4->entries, AREA_BASE, pages));
+        unmap_ns += bench_now_ns() - start;
+    }
+
+    char name[32];
+    snprintf(name, sizeof(name), "map_%s", kind);
+    bench_report("largepage", name, "mib", mib, ROUNDS * pages, map_ns);
+    snprintf(name, sizeof(name), "walk_%s", kind);
+    bench_report("largepage", name, "mib", mib, (WALKS / ROUNDS) * ROUNDS, walk_ns);
+    snprintf(name, sizeof(name), "unmap_%s", kind);
+    bench_report("largepage", name, "mib", mib, ROUNDS * pages, unmap_ns);
+}
+
+int main(void) {
+    if (posix_memalign((void **)&tables, VM_PAGE_SIZE, MAX_TABLES * VM_PAGE_SIZE)) {
+        fprintf(stderr, "Failed to allocate page tables\n");
+        return 1;
+    }
+
+    for (int i = 0; i < sizeof(area_mibs) / sizeof(area_mibs[0]); i++) {
+        bench_area("small", area_mibs[i], 0x80001000);
+        bench_area("large", area_mibs[i], 0x80000000);
+    }
+
+    free(tables);
+    return 0;
+}
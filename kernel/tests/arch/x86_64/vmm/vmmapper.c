@@ -7,11 +7,55 @@
 
 #include "vmm/vmmapper.h"
 #include "mock_pmm.h"
+#include "mock_spinlock.h"
 #include "munit.h"
 
 // must include after munit.h!
 #include "mock_pagetables.h"
 
+static int asid_invalidate_count;
+static uintptr_t asid_invalidate_addr;
+
+static size_t kernel_pending_pages;
+static uintptr_t kernel_pending_addr;
+static int kernel_shootdown_count;
+static uintptr_t kernel_shootdown_addr;
+static size_t kernel_shootdown_pages;
+static bool kernel_shootdown_locked;
+
+void asid_invalidate_mapping(const uintptr_t virt_addr) {
+    asid_invalidate_count++;
+    asid_invalidate_addr = virt_addr;
+
+    if (virt_addr >= VM_KERNEL_SPACE_START) {
+        if (!kernel_pending_pages) {
+            kernel_pending_addr = virt_addr;
+        }
+        kernel_pending_pages++;
+    }
+}
+
+bool asid_take_kernel_pages(uintptr_t *virt_addr, size_t *num_pages) {
+    if (!kernel_pending_pages) {
+        return false;
+    }
+
+    *virt_addr = kernel_pending_addr;
+    *num_pages = kernel_pending_pages;
+    kernel_pending_pages = 0;
+
+    return true;
+}
+
+void vmm_shootdown_kernel_pages(const uintptr_t virt_addr, const size_t num_pages) {
+    kernel_shootdown_count++;
+    kernel_shootdown_addr = virt_addr;
+    kernel_shootdown_pages = num_pages;
+    kernel_shootdown_locked = mock_spinlock_is_locked();
+}
+
+void restore_saved_interrupts(uint64_t flags) {}
+
 static MunitResult test_map_page_empty_pml4_0(const MunitParameter params[], void *param) {
 
     currently_active_pml4 = &empty_pml4;
@@ -323,6 +367,343 @@ static MunitResult test_unmap_page_complete_pml4_2M(const MunitParameter params[
     return MUNIT_OK;
 }
 
+#define LARGE_FLAGS ((PG_PRESENT | PG_WRITE | PG_USER))
+
+static uint64_t *test_pd_for(PageTable *pml4, const uintptr_t virt_addr) {
+    const uint64_t *pdpt = (uint64_t *)(pml4->entries[vmm_virt_to_pml4_index(virt_addr)] & 0xFFFFFFFFFFFFF000);
+    return (uint64_t *)(pdpt[vmm_virt_to_pdpt_index(virt_addr)] & 0xFFFFFFFFFFFFF000);
+}
+
+static MunitResult test_map_large_page_2M(const MunitParameter params[], void *param) {
+    munit_assert_true(vmm_map_large_page_in(empty_pml4.entries, 0x200000, 0x400000, LARGE_FLAGS, PT_LEVEL_PD));
+
+    const uint64_t *pd = test_pd_for(&empty_pml4, 0x200000);
+
+    munit_assert_uint64(pd[0], ==, 0);
+    munit_assert_uint64(pd[1], ==, 0x400000 | LARGE_FLAGS | PG_PAGESIZE);
+
+    // Only the PDPT and PD were needed
+    munit_assert_uint8(mock_pmm_get_total_page_allocs(), ==, 2);
+
+    return MUNIT_OK;
+}
+
+static MunitResult test_map_large_page_misaligned(const MunitParameter params[], void *param) {
+    munit_assert_false(vmm_map_large_page_in(empty_pml4.entries, 0x201000, 0x400000, LARGE_FLAGS, PT_LEVEL_PD));
+    munit_assert_false(vmm_map_large_page_in(empty_pml4.entries, 0x200000, 0x401000, LARGE_FLAGS, PT_LEVEL_PD));
+    munit_assert_false(vmm_map_large_page_in(empty_pml4.entries, 0x200000, 0x400000, LARGE_FLAGS, PT_LEVEL_PT));
+
+    munit_assert_uint64(empty_pml4.entries[0], ==, 0);
+
+    return MUNIT_OK;
+}
+
+static MunitResult test_map_large_page_over_small(const MunitParameter params[], void *param) {
+    vmm_map_page_in(empty_pml4.entries, 0x203000, 0x1000, LARGE_FLAGS);
+
+    munit_assert_false(vmm_can_map_large_page_in(empty_pml4.entries, 0x200000, PT_LEVEL_PD));
+    munit_assert_true(vmm_can_map_large_page_in(empty_pml4.entries, 0x400000, PT_LEVEL_PD));
+    munit_assert_false(vmm_map_large_page_in(empty_pml4.entries, 0x200000, 0x400000, LARGE_FLAGS, PT_LEVEL_PD));
+
+    // Small page is left alone
+    const uint64_t *pd = test_pd_for(&empty_pml4, 0x200000);
+    const uint64_t *pt = (uint64_t *)(pd[1] & 0xFFFFFFFFFFFFF000);
+    munit_assert_uint64(pt[3], ==, 0x1000 | LARGE_FLAGS);
+
+    return MUNIT_OK;
+}
+
+static MunitResult test_map_large_page_pat(const MunitParameter params[], void *param) {
+    munit_assert_true(
+            vmm_map_large_page_in(empty_pml4.entries, 0x200000, 0x400000, LARGE_FLAGS | PG_PAT_PTE, PT_LEVEL_PD));
+
+    uint64_t *pd = test_pd_for(&empty_pml4, 0x200000);
+    munit_assert_uint64(pd[1], ==, 0x400000 | LARGE_FLAGS | PG_PAGESIZE | PG_PAT_LARGE);
+
+    // Splitting moves it back
+    vmm_unmap_page_in(empty_pml4.entries, 0x200000);
+
+    const uint64_t *pt = (uint64_t *)(pd[1] & 0xFFFFFFFFFFFFF000);
+    munit_assert_uint64(pt[1], ==, 0x401000 | LARGE_FLAGS | PG_PAT_PTE);
+
+    return MUNIT_OK;
+}
+
+static MunitResult test_map_pages_uses_large(const MunitParameter params[], void *param) {
+    // Starts small to reach alignment, one large page, then small for the tail
+    munit_assert_true(vmm_map_pages_in(empty_pml4.entries, 0x1ff000, 0x3ff000, LARGE_FLAGS, 514));
+
+    const uint64_t *pd = test_pd_for(&empty_pml4, 0x200000);
+    const uint64_t *pt0 = (uint64_t *)(pd[0] & 0xFFFFFFFFFFFFF000);
+    const uint64_t *pt2 = (uint64_t *)(pd[2] & 0xFFFFFFFFFFFFF000);
+
+    munit_assert_uint64(pt0[511], ==, 0x3ff000 | LARGE_FLAGS);
+    munit_assert_uint64(pd[1], ==, 0x400000 | LARGE_FLAGS | PG_PAGESIZE);
+    munit_assert_uint64(pt2[0], ==, 0x600000 | LARGE_FLAGS);
+    munit_assert_uint64(pt2[1], ==, 0);
+
+    return MUNIT_OK;
+}
+
+static MunitResult test_map_pages_uses_gigapage(const MunitParameter params[], void *param) {
+    munit_assert_true(vmm_map_pages_in(empty_pml4.entries, 0x40000000, 0x80000000, LARGE_FLAGS, 0x40000));
+
+    const uint64_t *pdpt = (uint64_t *)(empty_pml4.entries[0] & 0xFFFFFFFFFFFFF000);
+    munit_assert_uint64(pdpt[1], ==, 0x80000000 | LARGE_FLAGS | PG_PAGESIZE);
+
+    // Only the PDPT was needed
+    munit_assert_uint8(mock_pmm_get_total_page_allocs(), ==, 1);
+
+    return MUNIT_OK;
+}
+
+static MunitResult test_map_page_in_large_splits(const MunitParameter params[], void *param) {
+    vmm_map_large_page_in(empty_pml4.entries, 0x200000, 0x400000, LARGE_FLAGS, PT_LEVEL_PD);
+    munit_assert_true(vmm_map_page_in(empty_pml4.entries, 0x203000, 0x1000, PG_PRESENT));
+
+    const uint64_t *pd = test_pd_for(&empty_pml4, 0x200000);
+    munit_assert_false(pd[1] & PG_PAGESIZE);
+
+    // Just the one page changed, the rest is as it was
+    const uint64_t *pt = (uint64_t *)(pd[1] & 0xFFFFFFFFFFFFF000);
+    munit_assert_uint64(pt[0], ==, 0x400000 | LARGE_FLAGS);
+    munit_assert_uint64(pt[3], ==, 0x1000 | PG_PRESENT);
+    munit_assert_uint64(pt[511], ==, 0x5ff000 | LARGE_FLAGS);
+
+    return MUNIT_OK;
+}
+
+static MunitResult test_map_fill_skips_mapped(const MunitParameter params[], void *param) {
+    vmm_map_page_in(empty_pml4.entries, 0x201000, 0x9000, PG_PRESENT);
+
+    uintptr_t pages[3] = {0x1000, 0x2000, 0x3000};
+    munit_assert_uint64(vmm_fill_pages_in(empty_pml4.entries, 0x200000, pages, PG_PRESENT | PG_WRITE, 3), ==, 2);
+
+    const uint64_t *pd = test_pd_for(&empty_pml4, 0x200000);
+    const uint64_t *pt = (uint64_t *)(pd[1] & 0xFFFFFFFFFFFFF000);
+
+    // Mapped in order around the existing page, which is left alone
+    munit_assert_uint64(pt[0], ==, 0x1000 | PG_PRESENT | PG_WRITE);
+    munit_assert_uint64(pt[1], ==, 0x9000 | PG_PRESENT);
+    munit_assert_uint64(pt[2], ==, 0x3000 | PG_PRESENT | PG_WRITE);
+
+    // Only the unused page is left for the caller
+    munit_assert_uint64(pages[0], ==, 0);
+    munit_assert_uint64(pages[1], ==, 0x2000);
+    munit_assert_uint64(pages[2], ==, 0);
+
+    return MUNIT_OK;
+}
+
+static MunitResult test_map_fill_skips_large(const MunitParameter params[], void *param) {
+    vmm_map_large_page_in(empty_pml4.entries, 0x200000, 0x400000, LARGE_FLAGS, PT_LEVEL_PD);
+
+    uintptr_t pages[2] = {0x1000, 0x2000};
+    munit_assert_uint64(vmm_fill_pages_in(empty_pml4.entries, 0x1ff000, pages, PG_PRESENT, 2), ==, 1);
+
+    // The large page wasn't split to fit the second one in
+    const uint64_t *pd = test_pd_for(&empty_pml4, 0x200000);
+    munit_assert_uint64(pd[1], ==, 0x400000 | LARGE_FLAGS | PG_PAGESIZE);
+    munit_assert_uint64(pages[0], ==, 0);
+    munit_assert_uint64(pages[1], ==, 0x2000);
+
+    return MUNIT_OK;
+}
+
+static MunitResult test_unmap_large_whole(const MunitParameter params[], void *param) {
+    vmm_map_large_page_in(empty_pml4.entries, 0x200000, 0x400000, LARGE_FLAGS, PT_LEVEL_PD);
+
+    munit_assert_uint64(vmm_unmap_pages_in(empty_pml4.entries, 0x200000, 512), ==, 0x400000);
+
+    const uint64_t *pd = test_pd_for(&empty_pml4, 0x200000);
+    munit_assert_uint64(pd[1], ==, 0);
+
+    // No split needed
+    munit_assert_uint8(mock_pmm_get_total_page_allocs(), ==, 2);
+
+    return MUNIT_OK;
+}
+
+static MunitResult test_unmap_large_partial(const MunitParameter params[], void *param) {
+    vmm_map_large_page_in(empty_pml4.entries, 0x200000, 0x400000, LARGE_FLAGS, PT_LEVEL_PD);
+
+    munit_assert_uint64(vmm_unmap_pages_in(empty_pml4.entries, 0x201000, 2), ==, 0x401000);
+
+    const uint64_t *pd = test_pd_for(&empty_pml4, 0x200000);
+    munit_assert_false(pd[1] & PG_PAGESIZE);
+
+    const uint64_t *pt = (uint64_t *)(pd[1] & 0xFFFFFFFFFFFFF000);
+    munit_assert_uint64(pt[0], ==, 0x400000 | LARGE_FLAGS);
+    munit_assert_uint64(pt[1], ==, 0);
+    munit_assert_uint64(pt[2], ==, 0);
+    munit_assert_uint64(pt[3], ==, 0x403000 | LARGE_FLAGS);
+
+    return MUNIT_OK;
+}
+
+static MunitResult test_unmap_gigapage_partial(const MunitParameter params[], void *param) {
+    vmm_map_large_page_in(empty_pml4.entries, 0x40000000, 0x80000000, LARGE_FLAGS, PT_LEVEL_PDPT);
+
+    munit_assert_uint64(vmm_unmap_page_in(empty_pml4.entries, 0x40201000), ==, 0x80201000);
+
+    // Split into megapages, then the one with the page in it into pages
+    const uint64_t *pd = test_pd_for(&empty_pml4, 0x40000000);
+    munit_assert_uint64(pd[0], ==, 0x80000000 | LARGE_FLAGS | PG_PAGESIZE);
+    munit_assert_uint64(pd[511], ==, 0xbfe00000 | LARGE_FLAGS | PG_PAGESIZE);
+
+    const uint64_t *pt = (uint64_t *)(pd[1] & 0xFFFFFFFFFFFFF000);
+    munit_assert_uint64(pt[0], ==, 0x80200000 | LARGE_FLAGS);
+    munit_assert_uint64(pt[1], ==, 0);
+
+    return MUNIT_OK;
+}
+
+static MunitResult test_unmap_pages_skips_missing(const MunitParameter params[], void *param) {
+    vmm_map_page_in(empty_pml4.entries, 0x600000, 0x1000, LARGE_FLAGS);
+
+    // Nothing at the start, but we still find the page at the end
+    munit_assert_uint64(vmm_unmap_pages_in(empty_pml4.entries, 0x0, 0x601), ==, 0);
+
+    const uint64_t *pd = test_pd_for(&empty_pml4, 0x600000);
+    const uint64_t *pt = (uint64_t *)(pd[3] & 0xFFFFFFFFFFFFF000);
+    munit_assert_uint64(pt[0], ==, 0);
+
+    return MUNIT_OK;
+}
+
+static MunitResult test_map_kernel_page_global(const MunitParameter params[], void *param) {
+    const uintptr_t kernel_addr = 0xFFFFFFFF80400000;
+
+    munit_assert_true(vmm_map_page_in(empty_pml4.entries, kernel_addr, 0x1000, PG_PRESENT | PG_WRITE));
+    munit_assert_true(vmm_map_page_in(empty_pml4.entries, 0x1000, 0x2000, PG_PRESENT | PG_WRITE));
+
+    // Kernel pages are in every address space, so they survive switches - user ones don't
+    const uint64_t *pd = test_pd_for(&empty_pml4, kernel_addr);
+    const uint64_t *pt = (uint64_t *)(pd[vmm_virt_to_pd_index(kernel_addr)] & 0xFFFFFFFFFFFFF000);
+    munit_assert_uint64(pt[0], ==, 0x1000 | PG_PRESENT | PG_WRITE | PG_GLOBAL);
+
+    pd = test_pd_for(&empty_pml4, 0x1000);
+    pt = (uint64_t *)(pd[0] & 0xFFFFFFFFFFFFF000);
+    munit_assert_uint64(pt[1], ==, 0x2000 | PG_PRESENT | PG_WRITE);
+
+    return MUNIT_OK;
+}
+
+static MunitResult test_map_large_kernel_page_global(const MunitParameter params[], void *param) {
+    const uintptr_t kernel_addr = 0xFFFFFFFF80400000;
+
+    munit_assert_true(vmm_map_large_page_in(empty_pml4.entries, kernel_addr, 0x400000, LARGE_FLAGS, PT_LEVEL_PD));
+
+    const uint64_t *pd = test_pd_for(&empty_pml4, kernel_addr);
+    munit_assert_uint64(pd[vmm_virt_to_pd_index(kernel_addr)], ==, 0x400000 | LARGE_FLAGS | PG_PAGESIZE | PG_GLOBAL);
+
+    return MUNIT_OK;
+}
+
+static MunitResult test_map_replace_invalidates_asid(const MunitParameter params[], void *param) {
+    asid_invalidate_count = 0;
+
+    vmm_map_page_in(empty_pml4.entries, 0x3000, 0x1000, PG_PRESENT);
+    munit_assert_int(asid_invalidate_count, ==, 0);
+
+    // Something might have the old one cached under another ASID now
+    vmm_map_page_in(empty_pml4.entries, 0x3000, 0x2000, PG_PRESENT);
+    munit_assert_int(asid_invalidate_count, ==, 1);
+    munit_assert_uint64(asid_invalidate_addr, ==, 0x3000);
+
+    return MUNIT_OK;
+}
+
+static MunitResult test_unmap_invalidates_asid(const MunitParameter params[], void *param) {
+    vmm_map_page_in(empty_pml4.entries, 0x3000, 0x1000, PG_PRESENT);
+    vmm_map_large_page_in(empty_pml4.entries, 0x200000, 0x400000, LARGE_FLAGS, PT_LEVEL_PD);
+    asid_invalidate_count = 0;
+
+    vmm_unmap_page_in(empty_pml4.entries, 0x5000);
+    munit_assert_int(asid_invalidate_count, ==, 0);
+
+    vmm_unmap_page_in(empty_pml4.entries, 0x3000);
+    munit_assert_int(asid_invalidate_count, ==, 1);
+    munit_assert_uint64(asid_invalidate_addr, ==, 0x3000);
+
+    vmm_unmap_pages_in(empty_pml4.entries, 0x200000, 0x200);
+    munit_assert_int(asid_invalidate_count, ==, 2);
+    munit_assert_uint64(asid_invalidate_addr, ==, 0x200000);
+
+    return MUNIT_OK;
+}
+
+static MunitResult test_unmap_kernel_shoots_down(const MunitParameter params[], void *param) {
+    const uintptr_t kernel_addr = 0xFFFFFFFF80400000;
+
+    // Nothing was there before, so there's nothing for anyone else to drop
+    vmm_map_page_in(empty_pml4.entries, kernel_addr, 0x1000, PG_PRESENT);
+    vmm_map_page_in(empty_pml4.entries, kernel_addr + 0x1000, 0x2000, PG_PRESENT);
+    vmm_map_page_in(empty_pml4.entries, 0x3000, 0x3000, PG_PRESENT);
+    munit_assert_int(kernel_shootdown_count, ==, 0);
+
+    vmm_unmap_page_in(empty_pml4.entries, 0x3000);
+    munit_assert_int(kernel_shootdown_count, ==, 0);
+
+    // Kernel pages are global, so every other CPU gets them - once the tables are unlocked
+    vmm_unmap_pages_in(empty_pml4.entries, kernel_addr, 2);
+    munit_assert_int(kernel_shootdown_count, ==, 1);
+    munit_assert_uint64(kernel_shootdown_addr, ==, kernel_addr);
+    munit_assert_size(kernel_shootdown_pages, ==, 2);
+    munit_assert_false(kernel_shootdown_locked);
+
+    return MUNIT_OK;
+}
+
+static MunitResult test_lock_per_address_space(const MunitParameter params[], void *param) {
+    static PageTable spaces[8] __attribute__((aligned(0x1000)));
+    SpinLock *locks[8];
+
+    memset(spaces, 0, sizeof(spaces));
+
+    for (int i = 0; i < 8; i++) {
+        vmm_unmap_page_in(spaces[i].entries, 0x1000);
+        locks[i] = mock_spinlock_get_last_locked();
+    }
+
+    // Neighbouring tables don't share
+    for (int i = 0; i < 8; i++) {
+        for (int j = i + 1; j < 8; j++) {
+            munit_assert_ptr_not_equal(locks[i], locks[j]);
+        }
+    }
+
+    // ... but the same one always gets the same lock, whatever the address or operation
+    vmm_map_page_in(spaces[3].entries, 0x7fff00000000, 0x1000, PG_PRESENT);
+    munit_assert_ptr_equal(mock_spinlock_get_last_locked(), locks[3]);
+
+    vmm_unmap_pages_in(spaces[3].entries, 0x200000, 4);
+    munit_assert_ptr_equal(mock_spinlock_get_last_locked(), locks[3]);
+
+    munit_assert_uint32(mock_spinlock_get_lock_count(), ==, mock_spinlock_get_unlock_count());
+
+    return MUNIT_OK;
+}
+
+static MunitResult test_lock_kernel_space_shared(const MunitParameter params[], void *param) {
+    static PageTable other_pml4 __attribute__((aligned(0x1000)));
+    const uintptr_t kernel_addr = 0xFFFFFFFF80400000;
+
+    memset(&other_pml4, 0, sizeof(other_pml4));
+
+    vmm_unmap_page_in(empty_pml4.entries, kernel_addr);
+    SpinLock *kernel_lock = mock_spinlock_get_last_locked();
+
+    // Kernel tables are shared between address spaces, so their lock is too
+    vmm_unmap_page_in(other_pml4.entries, kernel_addr);
+    munit_assert_ptr_equal(mock_spinlock_get_last_locked(), kernel_lock);
+
+    vmm_unmap_page_in(empty_pml4.entries, 0x1000);
+    munit_assert_ptr_not_equal(mock_spinlock_get_last_locked(), kernel_lock);
+
+    return MUNIT_OK;
+}
+
 static void *setup(const MunitParameter params[], void *user_data) {
     memset(&empty_pml4, 0, 0x1000);
 
@@ -340,7 +721,12 @@ static void *setup(const MunitParameter params[], void *user_data) {
     return currently_active_pml4;
 }
 
-static void teardown(void *param) { mock_pmm_reset(); }
+static void teardown(void *param) {
+    kernel_pending_pages = 0;
+    kernel_shootdown_count = 0;
+    mock_pmm_reset();
+    mock_spinlock_reset();
+}
 
 static MunitTest test_suite_tests[] = {
         {(char *)"/map/empty_pml4_0M", test_map_page_empty_pml4_0, setup, teardown, MUNIT_TEST_OPTION_NONE, NULL},
@@ -362,6 +748,40 @@ static MunitTest test_suite_tests[] = {
         {(char *)"/unmap/complete_pml4_0M_np", test_unmap_page_complete_pml4_0_np, setup, teardown,
          MUNIT_TEST_OPTION_NONE, NULL},
 
+        {(char *)"/map/large_2M", test_map_large_page_2M, setup, teardown, MUNIT_TEST_OPTION_NONE, NULL},
+        {(char *)"/map/large_misaligned", test_map_large_page_misaligned, setup, teardown, MUNIT_TEST_OPTION_NONE,
+         NULL},
+        {(char *)"/map/large_over_small", test_map_large_page_over_small, setup, teardown, MUNIT_TEST_OPTION_NONE,
+         NULL},
+        {(char *)"/map/large_pat", test_map_large_page_pat, setup, teardown, MUNIT_TEST_OPTION_NONE, NULL},
+        {(char *)"/map/pages_uses_large", test_map_pages_uses_large, setup, teardown, MUNIT_TEST_OPTION_NONE, NULL},
+        {(char *)"/map/pages_uses_gigapage", test_map_pages_uses_gigapage, setup, teardown, MUNIT_TEST_OPTION_NONE,
+         NULL},
+        {(char *)"/map/page_in_large_splits", test_map_page_in_large_splits, setup, teardown, MUNIT_TEST_OPTION_NONE,
+         NULL},
+        {(char *)"/map/fill_skips_mapped", test_map_fill_skips_mapped, setup, teardown, MUNIT_TEST_OPTION_NONE, NULL},
+        {(char *)"/map/fill_skips_large", test_map_fill_skips_large, setup, teardown, MUNIT_TEST_OPTION_NONE, NULL},
+        {(char *)"/unmap/large_whole", test_unmap_large_whole, setup, teardown, MUNIT_TEST_OPTION_NONE, NULL},
+        {(char *)"/unmap/large_partial", test_unmap_large_partial, setup, teardown, MUNIT_TEST_OPTION_NONE, NULL},
+        {(char *)"/unmap/gigapage_partial", test_unmap_gigapage_partial, setup, teardown, MUNIT_TEST_OPTION_NONE,
+         NULL},
+        {(char *)"/unmap/pages_skips_missing", test_unmap_pages_skips_missing, setup, teardown,
+         MUNIT_TEST_OPTION_NONE, NULL},
+        {(char *)"/map/kernel_page_global", test_map_kernel_page_global, setup, teardown, MUNIT_TEST_OPTION_NONE,
+         NULL},
+        {(char *)"/map/large_kernel_page_global", test_map_large_kernel_page_global, setup, teardown,
+         MUNIT_TEST_OPTION_NONE, NULL},
+        {(char *)"/map/replace_invalidates_asid", test_map_replace_invalidates_asid, setup, teardown,
+         MUNIT_TEST_OPTION_NONE, NULL},
+        {(char *)"/unmap/invalidates_asid", test_unmap_invalidates_asid, setup, teardown, MUNIT_TEST_OPTION_NONE,
+         NULL},
+        {(char *)"/unmap/kernel_shoots_down", test_unmap_kernel_shoots_down, setup, teardown,
+         MUNIT_TEST_OPTION_NONE, NULL},
+        {(char *)"/lock/per_address_space", test_lock_per_address_space, setup, teardown, MUNIT_TEST_OPTION_NONE,
+         NULL},
+        {(char *)"/lock/kernel_space_shared", test_lock_kernel_space_shared, setup, teardown, MUNIT_TEST_OPTION_NONE,
+         NULL},
+
         /* TODO fix this test
         {(char *)"/unmap/complete_pml4_2M", test_unmap_page_complete_pml4_2M,
          setup, teardown, MUNIT_TEST_OPTION_NONE, NULL},
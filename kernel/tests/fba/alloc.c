@@ -29,6 +29,8 @@ uintptr_t test_fba_check_begin();
 uintptr_t test_fba_check_size();
 uint64_t *test_fba_bitmap();
 uint64_t *test_fba_bitmap_end();
+uint64_t *test_fba_summary(uint8_t order);
+uint64_t test_fba_summary_top(uint8_t order);
 
 static void *test_setup(const MunitParameter params[], void *user_data) {
     void *page_area_ptr;
@@ -502,12 +504,101 @@ static MunitResult test_fba_free_invalid_address(const MunitParameter params[],
     return MUNIT_OK;
 }
 
+static MunitResult test_fba_init_too_big(const MunitParameter params[], void *test_page_area) {
+    munit_assert_false(fba_init(TEST_PML4_ADDR, (uintptr_t)test_page_area, KERNEL_FBA_SIZE_BLOCKS + 32768));
+
+    return MUNIT_OK;
+}
+
+static MunitResult test_fba_init_summary(const MunitParameter params[], void *test_page_area) {
+    bool result = fba_init(TEST_PML4_ADDR, (uintptr_t)test_page_area, 65536);
+    munit_assert_true(result);
+
+    // 1024 quads, all with free blocks (including the one with the bitmap in)
+    for (int i = 0; i < 16; i++) {
+        munit_assert_uint64(test_fba_summary(0)[i], ==, 0xffffffffffffffff);
+    }
+
+    munit_assert_uint64(test_fba_summary(0)[16], ==, 0);
+    munit_assert_uint64(test_fba_summary_top(0), ==, 0xffff);
+
+    return MUNIT_OK;
+}
+
+static MunitResult test_fba_alloc_summary_tracks_full(const MunitParameter params[], void *test_page_area) {
+    bool result = fba_init(TEST_PML4_ADDR, (uintptr_t)test_page_area, 32768);
+    munit_assert_true(result);
+
+    // Fill the first quad (one block is the bitmap)
+    for (int i = 0; i < 63; i++) {
+        fba_alloc_block();
+    }
+
+    munit_assert_uint64(test_fba_bitmap()[0], ==, 0xffffffffffffffff);
+    munit_assert_uint64(test_fba_summary(0)[0], ==, 0xfffffffffffffffe);
+
+    // Freeing puts it back, and it's the next one found
+    fba_free((void *)((uint64_t)test_page_area + 0x8000));
+    munit_assert_uint64(test_fba_summary(0)[0], ==, 0xffffffffffffffff);
+    munit_assert_ptr_equal(fba_alloc_block(), (uint64_t *)((uint64_t)test_page_area + 0x8000));
+
+    return MUNIT_OK;
+}
+
+static MunitResult test_fba_alloc_skips_full_summary(const MunitParameter params[], void *test_page_area) {
+    bool result = fba_init(TEST_PML4_ADDR, (uintptr_t)test_page_area, 32768);
+    munit_assert_true(result);
+
+    // Fill a whole summary quad's worth (64 x 64 blocks)
+    munit_assert_ptr_not_null(fba_alloc_blocks(4095));
+
+    munit_assert_uint64(test_fba_summary(0)[0], ==, 0);
+    munit_assert_uint64(test_fba_summary_top(0), ==, 0xfe);
+
+    munit_assert_ptr_equal(fba_alloc_block(), (uint64_t *)((uint64_t)test_page_area + 0x1000000));
+    munit_assert_ptr_equal(fba_alloc_blocks_aligned(4, 4), (uint64_t *)((uint64_t)test_page_area + 0x1004000));
+
+    return MUNIT_OK;
+}
+
+static MunitResult test_fba_alloc_blocks_uses_first_fit_hole(const MunitParameter params[], void *test_page_area) {
+    bool result = fba_init(TEST_PML4_ADDR, (uintptr_t)test_page_area, 32768);
+    munit_assert_true(result);
+
+    // Blocks 1 - 200 used, then make a 3-block hole at 61 - 63, and a 5-block one at 70 - 74
+    munit_assert_ptr_not_null(fba_alloc_blocks(200));
+    fba_free_blocks((void *)((uint64_t)test_page_area + 61 * 0x1000), 3);
+    fba_free_blocks((void *)((uint64_t)test_page_area + 70 * 0x1000), 5);
+
+    // Neither hole has four free on a four boundary
+    munit_assert_uint64(test_fba_summary(0)[0], ==, 0xfffffffffffffffb);
+    munit_assert_uint64(test_fba_summary(2)[0], ==, 0xfffffffffffffff8);
+
+    // Four don't fit in the first hole, and two aligned to four only fit at 72 in the second
+    munit_assert_ptr_equal(fba_alloc_blocks(4), (uint64_t *)((uint64_t)test_page_area + 70 * 0x1000));
+    fba_free_blocks((void *)((uint64_t)test_page_area + 70 * 0x1000), 4);
+    munit_assert_ptr_equal(fba_alloc_blocks_aligned(2, 4), (uint64_t *)((uint64_t)test_page_area + 72 * 0x1000));
+
+    // Three fit in the first
+    munit_assert_ptr_equal(fba_alloc_blocks(3), (uint64_t *)((uint64_t)test_page_area + 61 * 0x1000));
+
+    // Size-aligned goes straight past both
+    munit_assert_ptr_equal(fba_alloc_blocks_aligned(4, 4), (uint64_t *)((uint64_t)test_page_area + 204 * 0x1000));
+
+    // And bigger than a quad goes after everything
+    munit_assert_ptr_equal(fba_alloc_blocks(65), (uint64_t *)((uint64_t)test_page_area + 208 * 0x1000));
+
+    return MUNIT_OK;
+}
+
 static MunitTest test_suite_tests[] = {
         {(char *)"/init/zero", test_fba_init_zero, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL},
         {(char *)"/init/unaligned_begin", test_fba_init_unaligned_begin, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL},
         {(char *)"/init/size_not_multiple", test_fba_init_size_not_multiple, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL},
         {(char *)"/init/32768_ok", test_fba_init_32768_ok, test_setup, test_teardown, MUNIT_TEST_OPTION_NONE, NULL},
         {(char *)"/init/65536_ok", test_fba_init_65536_ok, test_setup, test_teardown, MUNIT_TEST_OPTION_NONE, NULL},
+        {(char *)"/init/too_big", test_fba_init_too_big, test_setup, test_teardown, MUNIT_TEST_OPTION_NONE, NULL},
+        {(char *)"/init/summary", test_fba_init_summary, test_setup, test_teardown, MUNIT_TEST_OPTION_NONE, NULL},
 
         {(char *)"/alloc/block_nospace_zero", test_fba_alloc_block_nospace_zero, test_setup, test_teardown,
          MUNIT_TEST_OPTION_NONE, NULL},
@@ -541,6 +632,12 @@ static MunitTest test_suite_tests[] = {
          MUNIT_TEST_OPTION_NONE, NULL},
         {(char *)"/alloc/blocks_aligned_invalid", test_fba_alloc_blocks_aligned_invalid, test_setup, test_teardown,
          MUNIT_TEST_OPTION_NONE, NULL},
+        {(char *)"/alloc/summary_tracks_full", test_fba_alloc_summary_tracks_full, test_setup, test_teardown,
+         MUNIT_TEST_OPTION_NONE, NULL},
+        {(char *)"/alloc/skips_full_summary", test_fba_alloc_skips_full_summary, test_setup, test_teardown,
+         MUNIT_TEST_OPTION_NONE, NULL},
+        {(char *)"/alloc/blocks_first_fit_hole", test_fba_alloc_blocks_uses_first_fit_hole, test_setup, test_teardown,
+         MUNIT_TEST_OPTION_NONE, NULL},
 
         {(char *)"/free/single_block", test_fba_free_single_block, test_setup, test_teardown, MUNIT_TEST_OPTION_NONE,
          NULL},
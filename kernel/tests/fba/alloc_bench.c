@@ -0,0 +1,118 @@
+/*
+ * Microbenchmark - Fixed-block allocator
+ * anos - An Operating System
+ *
+ * Copyright (c) 2025 Ross Bamford
+ *
+ * Latency against fill level, over a full-size (1GiB, 262144 block)
+ * FBA. Only the bitmap needs real memory - blocks are "mapped" by
+ * stubs that do nothing:
+ *
+ *   block        - alloc / free one block with the bottom N% in use
+ *   slab         - alloc / free four blocks aligned to four (as the slab
+ *                  allocator does) with the bottom N% in use, apart from
+ *                  a single free block every 16 - so plenty of holes,
+ *                  none of them big enough
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "bench.h"
+#include "fba/alloc.h"
+#include "pmm/pagealloc.h"
+#include "spinlock.h"
+#include "vmm/vmconfig.h"
+
+#define BITMAP_PAGES ((KERNEL_FBA_SIZE_BLOCKS >> 15))
+#define OPS 200000
+
+MemoryRegion *physical_region;
+
+void spinlock_init(SpinLock *lock) {}
+void spinlock_lock(SpinLock *lock) {}
+void spinlock_unlock(SpinLock *lock) {}
+uint64_t spinlock_lock_irqsave(SpinLock *lock) { return 0; }
+void spinlock_unlock_irqrestore(SpinLock *lock, uint64_t flags) {}
+
+uintptr_t page_alloc(MemoryRegion *region) { return 0x1000; }
+void page_free(MemoryRegion *region, uintptr_t page) {}
+
+bool vmm_map_page_in(uint64_t *pml4, uintptr_t virt_addr, uint64_t page, uint16_t flags) { return true; }
+uintptr_t vmm_unmap_page_in(uint64_t *pml4, uintptr_t virt_addr) { return 0x1000; }
+
+static void *bitmap_area;
+
+static const uint64_t fill_permille[] = {0, 500, 900, 990, 999};
+
+static void fill(const uint64_t permille, const bool holes) {
+    fba_init(NULL, (uintptr_t)bitmap_area, KERNEL_FBA_SIZE_BLOCKS);
+
+    const uint64_t blocks = (KERNEL_FBA_SIZE_BLOCKS - BITMAP_PAGES) * permille / 1000;
+    uint8_t *first = blocks ? fba_alloc_blocks(blocks) : NULL;
+
+    if (blocks && !first) {
+        fprintf(stderr, "fba: failed to fill to %llu permille\n", (unsigned long long)permille);
+        exit(1);
+    }
+
+    if (holes) {
+        for (uint64_t i = 0; i < blocks; i += 16) {
+            fba_free(first + i * VM_PAGE_SIZE);
+        }
+    }
+}
+
+static void bench_block(const uint64_t permille) {
+    fill(permille, false);
+
+    const uint64_t start = bench_now_ns();
+
+    for (int op = 0; op < OPS; op++) {
+        void *block = fba_alloc_block();
+        bench_consume(block);
+        fba_free(block);
+    }
+
+    const uint64_t elapsed = bench_now_ns() - start;
+
+    bench_report("fba", "block", "permille", permille, OPS * 2, elapsed);
+}
+
+static void bench_slab(const uint64_t permille) {
+    fill(permille, true);
+
+    const uint64_t start = bench_now_ns();
+
+    for (int op = 0; op < OPS; op++) {
+        void *block = fba_alloc_blocks_aligned(4, 4);
+        bench_consume(block);
+        fba_free_blocks(block, 4);
+    }
+
+    const uint64_t elapsed = bench_now_ns() - start;
+
+    bench_report("fba", "slab", "permille", permille, OPS * 2, elapsed);
+}
+
+int main(void) {
+    bitmap_area = aligned_alloc(0x40000, BITMAP_PAGES * VM_PAGE_SIZE);
+
+    if (!bitmap_area) {
+        fprintf(stderr, "Failed to allocate bitmap area\n");
+        return 1;
+    }
+
+    for (int i = 0; i < sizeof(fill_permille) / sizeof(fill_permille[0]); i++) {
+        bench_block(fill_permille[i]);
+    }
+
+    for (int i = 0; i < sizeof(fill_permille) / sizeof(fill_permille[0]); i++) {
+        bench_slab(fill_permille[i]);
+    }
+
+    free(bitmap_area);
+    return 0;
+}
@@ -9,6 +9,7 @@ CLEAN_ARTIFACTS+=kernel/tests/*.o kernel/tests/pmm/*.o kernel/tests/vmm/*.o 		\
 				kernel/tests/smp/*.o												\
 				kernel/tests/platform/pci/*.o										\
 				kernel/tests/platform/acpi/*.o										\
+				kernel/tests/platform/fdt/*.o										\
 				kernel/tests/arch/x86_64/*.o										\
 				kernel/tests/arch/x86_64/sched/*.o									\
 				kernel/tests/arch/x86_64/kdrivers/*.o								\
@@ -31,6 +32,7 @@ CLEAN_ARTIFACTS+=kernel/tests/*.o kernel/tests/pmm/*.o kernel/tests/vmm/*.o 		\
 				kernel/tests/smp/*.gcda												\
 				kernel/tests/platform/pci/*.gcda									\
 				kernel/tests/platform/acpi/*.gcda									\
+				kernel/tests/platform/fdt/*.gcda									\
 				kernel/tests/arch/x86_64/*.gcda										\
 				kernel/tests/arch/x86_64/sched/*.gcda								\
 				kernel/tests/arch/x86_64/kdrivers/*.gcda							\
@@ -53,6 +55,7 @@ CLEAN_ARTIFACTS+=kernel/tests/*.o kernel/tests/pmm/*.o kernel/tests/vmm/*.o 		\
 				kernel/tests/smp/*.gcno												\
 				kernel/tests/platform/pci/*.gcno									\
 				kernel/tests/platform/acpi/*.gcno									\
+				kernel/tests/platform/fdt/*.gcno									\
 				kernel/tests/arch/x86_64/*.gcno										\
 				kernel/tests/arch/x86_64/sched/*.gcno								\
 				kernel/tests/arch/x86_64/kdrivers/*.gcno							\
@@ -94,6 +97,7 @@ TEST_BUILD_DIRS=kernel/tests/build kernel/tests/build/pmm kernel/tests/build/vmm
 				kernel/tests/build/capabilities										\
 				kernel/tests/build/smp												\
 				kernel/tests/build/platform/acpi									\
+				kernel/tests/build/platform/fdt										\
 				kernel/tests/build/platform/pci										\
 				kernel/tests/build/arch/x86_64										\
 				kernel/tests/build/arch/x86_64/sched								\
@@ -162,6 +166,9 @@ kernel/tests/build/platform/bare:
 kernel/tests/build/platform/acpi:
 	mkdir -p kernel/tests/build/platform/acpi
 
+kernel/tests/build/platform/fdt:
+	mkdir -p kernel/tests/build/platform/fdt
+
 kernel/tests/build/arch/x86_64:
 	mkdir -p kernel/tests/build/arch/x86_64
 
@@ -230,10 +237,27 @@ kernel/tests/build/interrupts: kernel/tests/munit.o kernel/tests/arch/x86_64/int
 kernel/tests/build/structs/bitmap: kernel/tests/munit.o kernel/tests/structs/bitmap.o
 	$(CC) $(KERNEL_TEST_CFLAGS) -o $@ $^
 
-kernel/tests/build/pmm/pagealloc: kernel/tests/munit.o kernel/tests/pmm/pagealloc.o kernel/tests/build/pmm/pagealloc.o kernel/tests/mock_spinlock.o
+kernel/tests/build/pmm/pagealloc: kernel/tests/munit.o kernel/tests/pmm/pagealloc.o kernel/tests/build/pmm/pagealloc.o kernel/tests/mock_spinlock.o kernel/tests/arch/x86_64/mock_machine.o
+	$(CC) $(KERNEL_TEST_CFLAGS) -o $@ $^
+
+kernel/tests/build/pmm/pagealloc_limine: kernel/tests/munit.o kernel/tests/pmm/pagealloc_limine.o kernel/tests/build/pmm/pagealloc.o kernel/tests/mock_spinlock.o kernel/tests/arch/x86_64/mock_machine.o
+	$(CC) $(KERNEL_TEST_CFLAGS) -o $@ $^
+
+kernel/tests/build/pmm/buddy: kernel/tests/munit.o kernel/tests/pmm/buddy.o kernel/tests/build/pmm/buddy.o
+	$(CC) $(KERNEL_TEST_CFLAGS) -o $@ $^
+
+# The buddy backend is a build option, so the page allocator (and its test) get their own build
+kernel/tests/build/pmm_buddy/%.o: kernel/%.c $(TEST_BUILD_DIRS)
+	mkdir -p $(@D)
+	$(CC) -DUNIT_TESTS -DPMM_BUDDY $(KERNEL_TEST_CFLAGS) -c -o $@ $<
+
+kernel/tests/pmm/pagealloc_buddy.o: kernel/tests/pmm/pagealloc_buddy.c kernel/tests/munit.h
+	$(CC) -DUNIT_TESTS -DPMM_BUDDY $(KERNEL_TEST_CFLAGS) -Ikernel/tests -c -o $@ $<
+
+kernel/tests/build/pmm/pagealloc_buddy: kernel/tests/munit.o kernel/tests/pmm/pagealloc_buddy.o kernel/tests/build/pmm_buddy/pmm/pagealloc.o kernel/tests/build/pmm/buddy.o kernel/tests/mock_spinlock.o kernel/tests/arch/x86_64/mock_machine.o
 	$(CC) $(KERNEL_TEST_CFLAGS) -o $@ $^
 
-kernel/tests/build/pmm/pagealloc_limine: kernel/tests/munit.o kernel/tests/pmm/pagealloc_limine.o kernel/tests/build/pmm/pagealloc.o kernel/tests/mock_spinlock.o
+kernel/tests/build/pmm/pfndb: kernel/tests/munit.o kernel/tests/pmm/pfndb.o kernel/tests/build/pmm/pfndb.o kernel/tests/mock_pmm_noalloc.o kernel/tests/mock_vmm.o
 	$(CC) $(KERNEL_TEST_CFLAGS) -o $@ $^
 
 kernel/tests/build/vmm/vmalloc_linkedlist: kernel/tests/munit.o kernel/tests/vmm/vmalloc_linkedlist.o kernel/tests/build/vmm/vmalloc_linkedlist.o kernel/tests/mock_spinlock.o
@@ -245,43 +269,58 @@ kernel/tests/build/debugprint: kernel/tests/munit.o kernel/tests/debugprint.o ke
 kernel/tests/build/structs/pq: kernel/tests/munit.o kernel/tests/structs/pq.o kernel/tests/build/structs/pq.o
 	$(CC) $(KERNEL_TEST_CFLAGS) -o $@ $^
 
+kernel/tests/build/structs/runqueue: kernel/tests/munit.o kernel/tests/structs/runqueue.o kernel/tests/build/structs/runqueue.o
+	$(CC) $(KERNEL_TEST_CFLAGS) -o $@ $^
+
 kernel/tests/build/gdt: kernel/tests/munit.o kernel/tests/arch/x86_64/gdt.o kernel/tests/build/arch/x86_64/gdt.o kernel/tests/arch/x86_64/mock_cpu.o
 	$(CC) $(KERNEL_TEST_CFLAGS) -o $@ $^
 
 kernel/tests/build/fba/alloc: kernel/tests/munit.o kernel/tests/fba/alloc.o kernel/tests/build/fba/alloc.o kernel/tests/mock_pmm_noalloc.o kernel/tests/mock_vmm.o kernel/tests/mock_spinlock.o
 	$(CC) $(KERNEL_TEST_CFLAGS) -o $@ $^
 
-kernel/tests/build/slab/alloc: kernel/tests/munit.o kernel/tests/slab/alloc.o kernel/tests/build/slab/alloc.o kernel/tests/build/fba/alloc.o kernel/tests/build/arch/x86_64/structs/list.o kernel/tests/mock_pmm_noalloc.o kernel/tests/mock_vmm.o kernel/tests/mock_spinlock.o
+kernel/tests/build/slab/alloc: kernel/tests/munit.o kernel/tests/slab/alloc.o kernel/tests/build/slab/alloc.o kernel/tests/build/fba/alloc.o kernel/tests/build/arch/x86_64/structs/list.o kernel/tests/mock_pmm_noalloc.o kernel/tests/mock_vmm.o kernel/tests/mock_spinlock.o kernel/tests/arch/x86_64/mock_machine.o
 	$(CC) $(KERNEL_TEST_CFLAGS) -o $@ $^
 
-kernel/tests/build/task: kernel/tests/munit.o kernel/tests/task.o kernel/tests/build/task.o kernel/tests/build/arch/x86_64/structs/list.o kernel/tests/build/slab/alloc.o kernel/tests/build/fba/alloc.o kernel/tests/mock_pmm_noalloc.o kernel/tests/mock_vmm.o kernel/tests/mock_user_entrypoint.o kernel/tests/mock_kernel_entrypoint.o kernel/tests/mock_spinlock.o
+kernel/tests/build/task: kernel/tests/munit.o kernel/tests/task.o kernel/tests/build/task.o kernel/tests/build/arch/x86_64/structs/list.o kernel/tests/build/slab/alloc.o kernel/tests/build/fba/alloc.o kernel/tests/mock_pmm_noalloc.o kernel/tests/mock_vmm.o kernel/tests/mock_user_entrypoint.o kernel/tests/mock_kernel_entrypoint.o kernel/tests/mock_spinlock.o kernel/tests/arch/x86_64/mock_machine.o
 	$(CC) $(KERNEL_TEST_CFLAGS) -o $@ $^
 
 kernel/tests/build/sched/prr: kernel/tests/munit.o kernel/tests/sched/prr.o kernel/tests/build/sched/prr.o				\
 		kernel/tests/build/slab/alloc.o kernel/tests/build/fba/alloc.o kernel/tests/build/arch/x86_64/structs/list.o	\
-		kernel/tests/build/structs/pq.o kernel/tests/build/sched/idle.o kernel/tests/build/process/process.o			\
-		kernel/tests/build/managed_resources/resources.o kernel/tests/build/structs/region_tree.o						\
+		kernel/tests/build/structs/runqueue.o kernel/tests/build/sched/idle.o kernel/tests/build/sched/lock.o			\
+		kernel/tests/build/process/process.o kernel/tests/build/managed_resources/resources.o								\
+		kernel/tests/build/structs/region_tree.o																		\
 		kernel/tests/mock_user_entrypoint.o kernel/tests/mock_kernel_entrypoint.o kernel/tests/mock_pmm_noalloc.o		\
-		kernel/tests/mock_vmm.o kernel/tests/mock_task.o kernel/tests/mock_spinlock.o									\
+		kernel/tests/mock_vmm.o kernel/tests/mock_task.o kernel/tests/mock_spinlock.o kernel/tests/mock_ipwi.o				\
 		kernel/tests/arch/x86_64/mock_machine.o
 	$(CC) $(KERNEL_TEST_CFLAGS) -o $@ $^
 
-kernel/tests/build/sched/lock: kernel/tests/munit.o kernel/tests/sched/lock.o kernel/tests/build/sched/lock.o kernel/tests/mock_spinlock.o kernel/tests/arch/x86_64/mock_machine.o
+# Tickless scheduling is a build option, so it gets its own build of the scheduler
+kernel/tests/build/tickless/%.o: kernel/%.c $(TEST_BUILD_DIRS)
+	mkdir -p $(@D)
+	$(CC) -DUNIT_TESTS -DEXPERIMENTAL_TICKLESS $(KERNEL_TEST_CFLAGS) -c -o $@ $<
+
+kernel/tests/build/sched/prr_tickless: kernel/tests/munit.o kernel/tests/sched/prr_tickless.o kernel/tests/build/tickless/sched/prr.o	\
+		kernel/tests/build/sleep_queue.o kernel/tests/build/slab/alloc.o kernel/tests/build/fba/alloc.o					\
+		kernel/tests/build/arch/x86_64/structs/list.o kernel/tests/build/structs/runqueue.o kernel/tests/build/sched/idle.o	\
+		kernel/tests/build/sched/lock.o kernel/tests/build/process/process.o kernel/tests/build/managed_resources/resources.o							\
+		kernel/tests/build/structs/region_tree.o kernel/tests/mock_user_entrypoint.o kernel/tests/mock_kernel_entrypoint.o	\
+		kernel/tests/mock_pmm_noalloc.o kernel/tests/mock_vmm.o kernel/tests/mock_task.o kernel/tests/mock_spinlock.o		\
+		kernel/tests/mock_ipwi.o kernel/tests/arch/x86_64/mock_machine.o
 	$(CC) $(KERNEL_TEST_CFLAGS) -o $@ $^
 
-kernel/tests/build/kdrivers/drivers: kernel/tests/munit.o kernel/tests/kdrivers/drivers.o kernel/tests/build/kdrivers/drivers.o kernel/tests/mock_kernel_drivers.o
+kernel/tests/build/sched/lock: kernel/tests/munit.o kernel/tests/sched/lock.o kernel/tests/build/sched/lock.o kernel/tests/mock_spinlock.o kernel/tests/arch/x86_64/mock_machine.o
 	$(CC) $(KERNEL_TEST_CFLAGS) -o $@ $^
 
-kernel/tests/build/sleep_queue: kernel/tests/munit.o kernel/tests/sleep_queue.o kernel/tests/build/sleep_queue.o kernel/tests/build/slab/alloc.o kernel/tests/build/fba/alloc.o kernel/tests/build/arch/x86_64/structs/list.o kernel/tests/mock_pmm_noalloc.o kernel/tests/mock_vmm.o kernel/tests/mock_spinlock.o
+kernel/tests/build/kdrivers/drivers: kernel/tests/munit.o kernel/tests/kdrivers/drivers.o kernel/tests/build/kdrivers/drivers.o kernel/tests/mock_kernel_drivers.o
 	$(CC) $(KERNEL_TEST_CFLAGS) -o $@ $^
 
-kernel/tests/build/structs/ref_count_map: kernel/tests/munit.o kernel/tests/structs/ref_count_map.o kernel/tests/build/structs/ref_count_map.o kernel/tests/mock_fba_malloc.o kernel/tests/mock_slab_malloc.o kernel/tests/mock_spinlock.o kernel/tests/arch/x86_64/mock_machine.o
+kernel/tests/build/sleep_queue: kernel/tests/munit.o kernel/tests/sleep_queue.o kernel/tests/build/sleep_queue.o kernel/tests/build/slab/alloc.o kernel/tests/build/fba/alloc.o kernel/tests/build/arch/x86_64/structs/list.o kernel/tests/mock_pmm_noalloc.o kernel/tests/mock_vmm.o kernel/tests/mock_spinlock.o kernel/tests/arch/x86_64/mock_machine.o
 	$(CC) $(KERNEL_TEST_CFLAGS) -o $@ $^
 
 kernel/tests/build/structs/hash: kernel/tests/munit.o kernel/tests/structs/hash.o kernel/tests/build/structs/hash.o kernel/tests/build/arch/x86_64/spinlock.o
 	$(CC) $(KERNEL_TEST_CFLAGS) -o $@ $^
 
-kernel/tests/build/ipc/channel: kernel/tests/munit.o kernel/tests/ipc/channel.o kernel/tests/build/ipc/channel.o kernel/tests/build/structs/hash.o kernel/tests/mock_fba_malloc.o kernel/tests/mock_vmm.o
+kernel/tests/build/ipc/channel: kernel/tests/munit.o kernel/tests/ipc/channel.o kernel/tests/build/ipc/channel.o kernel/tests/build/structs/hash.o kernel/tests/mock_fba_malloc.o kernel/tests/mock_pmm_malloc.o kernel/tests/mock_vmm.o
 	$(CC) $(KERNEL_TEST_CFLAGS) -o $@ $^
 
 kernel/tests/build/structs/strhash: kernel/tests/munit.o kernel/tests/structs/strhash.o $(TEST_BUILD_DIRS)
@@ -290,6 +329,9 @@ kernel/tests/build/structs/strhash: kernel/tests/munit.o kernel/tests/structs/st
 kernel/tests/build/ipc/named: kernel/tests/munit.o kernel/tests/ipc/named.o kernel/tests/build/ipc/named.o kernel/tests/build/structs/hash.o kernel/tests/mock_fba_malloc.o
 	$(CC) $(KERNEL_TEST_CFLAGS) -o $@ $^
 
+kernel/tests/build/ipc/ring: kernel/tests/munit.o kernel/tests/ipc/ring.o kernel/tests/build/ipc/ring.o kernel/tests/build/structs/hash.o kernel/tests/mock_fba_malloc.o kernel/tests/mock_pmm_malloc.o kernel/tests/mock_vmm.o
+	$(CC) $(KERNEL_TEST_CFLAGS) -o $@ $^
+
 kernel/tests/build/structs/shift_array: kernel/tests/munit.o kernel/tests/structs/shift_array.o kernel/tests/build/structs/shift_array.o
 	$(CC) $(KERNEL_TEST_CFLAGS) -o $@ $^
 
@@ -311,12 +353,24 @@ kernel/tests/build/structs/region_tree: kernel/tests/munit.o kernel/tests/struct
 kernel/tests/build/smp/ipwi: kernel/tests/munit.o kernel/tests/smp/ipwi.o kernel/tests/build/smp/ipwi.o
 	$(CC) $(KERNEL_TEST_CFLAGS) -o $@ $^
 
+kernel/tests/build/smp/cpumask: kernel/tests/munit.o kernel/tests/smp/cpumask.o
+	$(CC) $(KERNEL_TEST_CFLAGS) -o $@ $^
+
 kernel/tests/build/vmm/vmm_shootdown: kernel/tests/munit.o kernel/tests/vmm/vmm_shootdown.o kernel/tests/build/vmm/vmm_shootdown.o
 	$(CC) $(KERNEL_TEST_CFLAGS) -o $@ $^
 
+kernel/tests/build/vmm/asid: kernel/tests/munit.o kernel/tests/vmm/asid.o kernel/tests/build/vmm/asid.o kernel/tests/mock_fba_malloc.o
+	$(CC) $(KERNEL_TEST_CFLAGS) -o $@ $^
+
+kernel/tests/build/vmm/vmregion: kernel/tests/munit.o kernel/tests/vmm/vmregion.o kernel/tests/build/vmm/vmregion.o
+	$(CC) $(KERNEL_TEST_CFLAGS) -o $@ $^
+
 kernel/tests/build/platform/acpi/acpitables: kernel/tests/munit.o kernel/tests/platform/acpi/acpitables.o kernel/tests/build/platform/acpi/acpitables.o kernel/tests/mock_vmm.o kernel/tests/arch/x86_64/mock_machine.o
 	$(CC) $(KERNEL_TEST_CFLAGS) -o $@ $^
 
+kernel/tests/build/platform/fdt/fdt: kernel/tests/munit.o kernel/tests/platform/fdt/fdt.o kernel/tests/build/platform/fdt/fdt.o
+	$(CC) $(KERNEL_TEST_CFLAGS) -o $@ $^
+
 kernel/tests/build/sched/mutex: kernel/tests/munit.o kernel/tests/sched/mutex.o kernel/tests/build/sched/mutex.o kernel/tests/build/structs/pq.o
 	$(CC) $(KERNEL_TEST_CFLAGS) -o $@ $^
 
@@ -357,7 +411,7 @@ ifeq ($(HOST_ARCH),riscv64)
 kernel/tests/build/capabilities/cookies: kernel/tests/munit.o kernel/tests/build/arch/riscv64/capabilities/cookies.o kernel/tests/capabilities/cookies.o kernel/tests/build/arch/riscv64/kdrivers/cpu.o
 	$(CC) $(KERNEL_TEST_CFLAGS) -o $@ $^
 else
-kernel/tests/build/capabilities/cookies: kernel/tests/munit.o kernel/tests/build/arch/x86_64/capabilities/cookies.o kernel/tests/capabilities/cookies.o kernel/tests/build/arch/x86_64/kdrivers/cpu.o
+kernel/tests/build/capabilities/cookies: kernel/tests/munit.o kernel/tests/build/arch/x86_64/capabilities/cookies.o kernel/tests/capabilities/cookies.o kernel/tests/build/arch/x86_64/kdrivers/cpu.o kernel/tests/build/arch/x86_64/std_routines.o
 	$(CC) $(KERNEL_TEST_CFLAGS) -o $@ $^
 endif
 
@@ -365,21 +419,26 @@ ALL_TESTS=kernel/tests/build/interrupts 										\
 			kernel/tests/build/structs/bitmap									\
 			kernel/tests/build/pmm/pagealloc									\
 			kernel/tests/build/pmm/pagealloc_limine								\
+			kernel/tests/build/pmm/buddy										\
+			kernel/tests/build/pmm/pagealloc_buddy								\
+			kernel/tests/build/pmm/pfndb										\
 			kernel/tests/build/vmm/vmalloc_linkedlist							\
 			kernel/tests/build/structs/pq										\
+			kernel/tests/build/structs/runqueue									\
 			kernel/tests/build/gdt												\
 			kernel/tests/build/fba/alloc										\
 			kernel/tests/build/slab/alloc										\
 			kernel/tests/build/sched/lock										\
 			kernel/tests/build/task												\
 			kernel/tests/build/sched/prr										\
+			kernel/tests/build/sched/prr_tickless								\
 			kernel/tests/build/kdrivers/drivers									\
 			kernel/tests/build/sleep_queue										\
-			kernel/tests/build/structs/ref_count_map							\
 			kernel/tests/build/structs/hash										\
 			kernel/tests/build/ipc/channel										\
 			kernel/tests/build/structs/strhash									\
 			kernel/tests/build/ipc/named										\
+			kernel/tests/build/ipc/ring										\
 			kernel/tests/build/structs/shift_array								\
 			kernel/tests/build/process/process									\
 			kernel/tests/build/process/memory									\
@@ -387,8 +446,12 @@ ALL_TESTS=kernel/tests/build/interrupts 										\
 			kernel/tests/build/managed_resources/resources						\
 			kernel/tests/build/structs/region_tree								\
 			kernel/tests/build/smp/ipwi											\
+			kernel/tests/build/smp/cpumask										\
 			kernel/tests/build/vmm/vmm_shootdown								\
+			kernel/tests/build/vmm/asid											\
+			kernel/tests/build/vmm/vmregion										\
 			kernel/tests/build/platform/acpi/acpitables							\
+			kernel/tests/build/platform/fdt/fdt									\
 			kernel/tests/build/sched/mutex
 
 ifeq ($(HOST_ARCH),i386)	# macOS
@@ -440,6 +503,103 @@ PHONY: test-kernel
 test-kernel: $(ALL_TESTS)
 	sh -c 'for test in $^; do $$test || exit 1; done'
 
+# Microbenchmarks are built without sanitizers, coverage or CONSERVATIVE_BUILD
+# (all of which would swamp what we're trying to measure), into their own
+# build tree so they never share objects with the tests.
+KERNEL_BENCH_CFLAGS=-g 																\
+	-DARCH=$(ARCH) -DARCH_$(shell echo '$(ARCH)' | tr '[:lower:]' '[:upper:]')		\
+	-Ikernel/include 																\
+	-Ikernel/arch/$(ARCH)/include 													\
+	-Ikernel/tests/include 															\
+	-Ikernel/tests/arch/$(ARCH)/include 											\
+	-O$(OPTIMIZE)
+
+ifeq ($(HOST_ARCH),arm)
+KERNEL_BENCH_CFLAGS+=-arch x86_64
+endif
+
+kernel/tests/build/bench/%.o: kernel/%.c
+	mkdir -p $(@D)
+	$(CC) -DUNIT_TESTS $(KERNEL_BENCH_CFLAGS) -c -o $@ $<
+
+kernel/tests/build/bench/sched/runqueue: kernel/tests/build/bench/tests/sched/runqueue_bench.o kernel/tests/build/bench/structs/runqueue.o kernel/tests/build/bench/structs/pq.o
+	mkdir -p $(@D)
+	$(CC) $(KERNEL_BENCH_CFLAGS) -o $@ $^
+
+# This one needs the host's pthread.h, which pulls in <sched.h> - so it can
+# only have the kernel headers on the quoted include path.
+kernel/tests/build/bench/ipc/ring: kernel/tests/ipc/ring_bench.c
+	mkdir -p $(@D)
+	$(CC) -g -iquote kernel/include -iquote kernel/tests/include -O$(OPTIMIZE) -o $@ $^ -lpthread
+
+# The page allocator benchmark runs against each backend
+kernel/tests/build/bench/pmm_buddy/%.o: kernel/%.c
+	mkdir -p $(@D)
+	$(CC) -DUNIT_TESTS -DPMM_BUDDY $(KERNEL_BENCH_CFLAGS) -c -o $@ $<
+
+kernel/tests/build/bench/pmm/pagealloc_stack: kernel/tests/build/bench/tests/pmm/pagealloc_bench.o kernel/tests/build/bench/pmm/pagealloc.o
+	mkdir -p $(@D)
+	$(CC) $(KERNEL_BENCH_CFLAGS) -o $@ $^
+
+kernel/tests/build/bench/pmm/pagealloc_buddy: kernel/tests/build/bench/pmm_buddy/tests/pmm/pagealloc_bench.o kernel/tests/build/bench/pmm_buddy/pmm/pagealloc.o kernel/tests/build/bench/pmm/buddy.o
+	mkdir -p $(@D)
+	$(CC) $(KERNEL_BENCH_CFLAGS) -o $@ $^
+
+# Threaded as well, so the same quoted-includes-only deal as the ring benchmark
+kernel/tests/build/bench/slab/alloc: kernel/tests/slab/alloc_bench.c kernel/slab/alloc.c
+	mkdir -p $(@D)
+	$(CC) -g -DUNIT_TESTS -DARCH=$(ARCH) -DARCH_$(shell echo '$(ARCH)' | tr '[:lower:]' '[:upper:]')			\
+		-iquote kernel/include -iquote kernel/arch/$(ARCH)/include -iquote kernel/tests/include				\
+		-O$(OPTIMIZE) -o $@ $^ -lpthread
+
+kernel/tests/build/bench/fba/alloc: kernel/tests/build/bench/tests/fba/alloc_bench.o kernel/tests/build/bench/fba/alloc.o
+	mkdir -p $(@D)
+	$(CC) $(KERNEL_BENCH_CFLAGS) -o $@ $^
+
+kernel/tests/build/bench/vmm/shootdown: kernel/tests/build/bench/tests/vmm/shootdown_bench.o kernel/tests/build/bench/vmm/vmm_shootdown.o kernel/tests/build/bench/smp/ipwi.o
+	mkdir -p $(@D)
+	$(CC) $(KERNEL_BENCH_CFLAGS) -o $@ $^
+
+kernel/tests/build/bench/vmm/asid: kernel/tests/build/bench/tests/vmm/asid_bench.o kernel/tests/build/bench/vmm/asid.o
+	mkdir -p $(@D)
+	$(CC) $(KERNEL_BENCH_CFLAGS) -o $@ $^
+
+kernel/tests/build/bench/arch/x86_64/vmm/largepage: kernel/tests/build/bench/tests/arch/x86_64/vmm/largepage_bench.o kernel/tests/build/bench/arch/x86_64/vmm/vmmapper.o kernel/tests/build/bench/arch/x86_64/std_routines.o
+	mkdir -p $(@D)
+	$(CC) $(KERNEL_BENCH_CFLAGS) -o $@ $^
+
+# Threaded as well, so the same quoted-includes-only deal as the ring benchmark
+kernel/tests/build/bench/arch/x86_64/vmm/faultstorm: kernel/tests/arch/x86_64/vmm/faultstorm_bench.c kernel/arch/x86_64/vmm/vmmapper.c kernel/tests/build/bench/arch/x86_64/std_routines.o
+	mkdir -p $(@D)
+	$(CC) -g -DUNIT_TESTS -DARCH=$(ARCH) -DARCH_$(shell echo '$(ARCH)' | tr '[:lower:]' '[:upper:]')			\
+		-iquote kernel/include -iquote kernel/arch/$(ARCH)/include -iquote kernel/tests/include				\
+		-iquote kernel/tests/arch/$(ARCH)/include -O$(OPTIMIZE) -o $@ $^ -lpthread
+
+kernel/tests/build/bench/arch/x86_64/std_routines: kernel/tests/build/bench/tests/arch/x86_64/std_routines_bench.o kernel/tests/build/bench/arch/x86_64/std_routines.o
+	mkdir -p $(@D)
+	$(CC) $(KERNEL_BENCH_CFLAGS) -o $@ $^
+
+kernel/tests/build/bench/arch/x86_64/fpu: kernel/tests/build/bench/tests/arch/x86_64/fpu_bench.o
+	mkdir -p $(@D)
+	$(CC) $(KERNEL_BENCH_CFLAGS) -o $@ $^
+
+ALL_BENCHES=kernel/tests/build/bench/sched/runqueue 										\
+			kernel/tests/build/bench/ipc/ring												\
+			kernel/tests/build/bench/pmm/pagealloc_stack									\
+			kernel/tests/build/bench/pmm/pagealloc_buddy									\
+			kernel/tests/build/bench/slab/alloc												\
+			kernel/tests/build/bench/fba/alloc												\
+			kernel/tests/build/bench/vmm/shootdown											\
+			kernel/tests/build/bench/vmm/asid												\
+			kernel/tests/build/bench/arch/x86_64/vmm/largepage								\
+			kernel/tests/build/bench/arch/x86_64/vmm/faultstorm								\
+			kernel/tests/build/bench/arch/x86_64/std_routines								\
+			kernel/tests/build/bench/arch/x86_64/fpu
+
+PHONY: bench-kernel
+bench-kernel: $(ALL_BENCHES)
+	sh -c 'for bench in $^; do $$bench || exit 1; done'
+
 ifeq (, $(shell which lcov))
 coverage-kernel:
 	@echo "LCOV not installed, coverage cannot be generated"
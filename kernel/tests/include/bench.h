@@ -0,0 +1,41 @@
+/*
+ * Helpers for hosted kernel microbenchmarks
+ * anos - An Operating System
+ *
+ * Copyright (c) 2025 Ross Bamford
+ *
+ * These are deliberately minimal - benchmarks are plain
+ * programs that print one line per measurement, so results
+ * can be diffed between runs / branches. They're built
+ * without sanitizers or CONSERVATIVE_BUILD (see the
+ * bench-kernel target).
+ */
+
+// clang-format Language: C
+
+#ifndef __ANOS_TESTS_BENCH_H
+#define __ANOS_TESTS_BENCH_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+
+static inline uint64_t bench_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+// Stops the optimizer from eliding work whose result is otherwise unused
+#define bench_consume(value) __asm__ volatile("" : : "r"(value) : "memory")
+
+static inline void bench_report(const char *suite, const char *name, const char *param_name, uint64_t param,
+                                uint64_t ops, uint64_t elapsed_ns) {
+    const double ns_per_op = ops ? (double)elapsed_ns / (double)ops : 0.0;
+    const double mops = elapsed_ns ? ((double)ops * 1000.0) / (double)elapsed_ns : 0.0;
+
+    printf("%-16s %-28s %10s=%-8llu %10.2f ns/op %10.2f Mops/s\n", suite, name, param_name,
+           (unsigned long long)param, ns_per_op, mops);
+}
+
+#endif //__ANOS_TESTS_BENCH_H
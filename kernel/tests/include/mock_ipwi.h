@@ -0,0 +1,19 @@
+/*
+ * Mock implementation of the IPWI notifications for hosted tests
+ * anos - An Operating System
+ *
+ * Copyright (c) 2025 Ross Bamford
+ */
+
+// clang-format Language: C
+
+#ifndef __ANOS_TESTS_TEST_IPWI_H
+#define __ANOS_TESTS_TEST_IPWI_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+void mock_ipwi_reset(void);
+uint32_t mock_ipwi_get_reschedule_count(uint16_t cpu_num);
+
+#endif //__ANOS_TESTS_TEST_IPWI_H
@@ -24,5 +24,9 @@ uint32_t mock_machine_read_inl_buffer(uint16_t port);
 bool mock_machine_write_inl_buffer(uint16_t port, uint32_t value);
 uint32_t mock_machine_intr_disable_level();
 uint32_t mock_machine_max_intr_disable_level();
+void mock_machine_set_upticks(uint64_t ticks);
+void mock_machine_set_nanos(uint64_t nanos);
+uint64_t mock_machine_last_oneshot_nanos(void);
+uint32_t mock_machine_oneshot_count(void);
 
 #endif //__ANOS_TESTS_TEST_MACHINE_H
\ No newline at end of file
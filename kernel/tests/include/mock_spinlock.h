@@ -10,11 +10,16 @@
 #ifndef __ANOS_TESTS_TEST_SPINLOCK_H
 #define __ANOS_TESTS_TEST_SPINLOCK_H
 
+#include <stdbool.h>
 #include <stdint.h>
 
+#include "spinlock.h"
+
 void mock_spinlock_reset(void);
 bool mock_spinlock_is_locked(void);
 uint32_t mock_spinlock_get_lock_count(void);
 uint32_t mock_spinlock_get_unlock_count(void);
+void mock_spinlock_set_try_lock_fails(bool fails);
+SpinLock *mock_spinlock_get_last_locked(void);
 
 #endif //__ANOS_TESTS_TEST_SPINLOCK_H
\ No newline at end of file
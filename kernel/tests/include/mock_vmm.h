@@ -19,11 +19,15 @@ uint32_t mock_vmm_get_total_page_unmaps();
 uint64_t mock_vmm_get_last_page_map_pml4();
 uint64_t mock_vmm_get_last_page_map_paddr();
 uint64_t mock_vmm_get_last_page_map_vaddr();
-uint64_t mock_vmm_get_last_page_map_flags();
+uint16_t mock_vmm_get_last_page_map_flags();
 
 uintptr_t mock_vmm_get_last_page_unmap_pml4();
 uintptr_t mock_vmm_get_last_page_unmap_virt();
 
 void mock_vmm_reset();
 
+// Mapping seen by vmm_virt_to_phys_page (everything unmapped by default)
+typedef uintptr_t (*MockVirtToPhys)(uintptr_t virt_addr);
+void mock_vmm_set_virt_to_phys_page(MockVirtToPhys func);
+
 #endif //__ANOS_TESTS_TEST_VMM_H
\ No newline at end of file
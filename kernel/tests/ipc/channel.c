@@ -9,13 +9,19 @@
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "munit.h"
 
+#include "mock_fba.h"
 #include "mock_pagetables.h"
+#include "mock_pmm.h"
 #include "mock_vmm.h"
 
+#include "fba/alloc.h"
 #include "ipc/channel.h"
+#include "managed_resources/resources.h"
+#include "process.h"
 #include "ipc/channel_internal.h"
 #include "smp/state.h"
 #include "structs/hash.h"
@@ -24,8 +30,9 @@
 /* Dummy panic that aborts the test on failure */
 void panic_sloc(const char *msg, const char *filename, const uint64_t line) { munit_errorf("%s", msg); }
 
-/* Dummy capability cookie gen */
-uint64_t capability_cookie_generate(void) { return 0x1234567812345678; }
+/* Dummy capability cookie gen - distinct, so async replies can be told apart */
+static uint64_t next_cookie = 0x1234567812345678;
+uint64_t capability_cookie_generate(void) { return next_cookie++; }
 
 /* Dummy implementation of kernel_guard_once */
 void kernel_guard_once(void) { /* no-op for tests */ }
@@ -67,9 +74,19 @@ static Task *current_task_ptr = NULL;
 Task *task_current(void) { return current_task_ptr; }
 
 /* Dummy tasks for simulation */
+static Process sender_process;
+static Process receiver_process;
 static Task sender_task;
 static Task receiver_task;
 
+/* --- Process Mocks --- */
+static ManagedResource *last_managed_resource = NULL;
+
+bool process_add_managed_resource(Process *process, ManagedResource *managed_resource) {
+    last_managed_resource = managed_resource;
+    return true;
+}
+
 /* Dummy scheduler functions */
 PerCPUState *sched_find_target_cpu(void) {
     static PerCPUState cpu;
@@ -84,17 +101,98 @@ void sched_unlock_any_cpu(PerCPUState *cpu, uint64_t flags) {
     (void)flags;
 }
 
-/* In these mocks the block/unblock/schedule functions are no-ops */
+static int schedule_count = 0;
+static Task *last_handoff_task = NULL;
+static Task *last_unblocked_task = NULL;
+
+/* In these mocks the block/unblock/schedule functions are (mostly) no-ops */
 void sched_block(Task *task) { (void)task; }
-void sched_unblock(Task *task) { (void)task; }
+void sched_unblock(Task *task) { last_unblocked_task = task; }
+/* Like the real thing, this puts the task on a run queue - which takes over its list node */
+static Task *unblocked_on_tasks[4];
+static int unblocked_on_count = 0;
+
 void sched_unblock_on(Task *task, PerCPUState *cpu) {
-    (void)task;
     (void)cpu;
+
+    if (unblocked_on_count < 4) {
+        unblocked_on_tasks[unblocked_on_count] = task;
+    }
+
+    unblocked_on_count++;
+    task->this.next = NULL;
 }
-void sched_schedule(void) { /* no-op */ }
+void sched_schedule(void) { schedule_count++; }
+
+/* Handoff just records who we'd have switched to */
+void sched_handoff(Task *task) { last_handoff_task = task; }
 uint64_t sched_lock_this_cpu(void) { return 0; }
 void sched_unlock_this_cpu(uint64_t flags) { (void)flags; }
 
+/* --- Shootdown Mocks --- */
+static int shootdown_count = 0;
+static const Process *last_shootdown_process = NULL;
+static uintptr_t last_shootdown_vaddr = 0;
+static size_t last_shootdown_pages = 0;
+
+uintptr_t vmm_shootdown_unmap_pages_in_process(const Process *process, uintptr_t virt_addr, size_t num_pages) {
+    shootdown_count++;
+    last_shootdown_process = process;
+    last_shootdown_vaddr = virt_addr;
+    last_shootdown_pages = num_pages;
+    return 0;
+}
+
+/* --- Multi-page buffer layout ---
+ * Sender has a four page buffer at SEND_BUF, in two physical runs.
+ * Receiver has an unmapped window at RECV_BUF, except for
+ * whatever recv_mapped_page is set to.
+ */
+#define SEND_BUF ((0x100000))
+#define RECV_BUF ((0x400000))
+#define SEND_PAGES ((4))
+
+static uintptr_t recv_mapped_page = 0;
+
+/* Receiver has a region covering this page, that's not been faulted in yet */
+static uintptr_t recv_region_page = 0;
+static Region recv_region;
+static ProcessMemoryInfo receiver_meminfo;
+
+Region *region_tree_lookup(Region *node, uintptr_t addr) {
+    (void)node;
+    return recv_region_page && addr == recv_region_page ? &recv_region : NULL;
+}
+
+/* What's in the sender's (fake) physical pages, for async sends to copy */
+static uint8_t __attribute__((aligned(0x1000))) send_page_data[SEND_PAGES][VM_PAGE_SIZE];
+
+void *vmm_phys_to_virt_ptr(const uintptr_t phys_addr) {
+    if (phys_addr >= 0x800000 && phys_addr < 0x802000) {
+        return send_page_data[(phys_addr - 0x800000) / VM_PAGE_SIZE];
+    }
+
+    if (phys_addr >= 0x900000 && phys_addr < 0x902000) {
+        return send_page_data[2 + (phys_addr - 0x900000) / VM_PAGE_SIZE];
+    }
+
+    /* Anything else came from the mock PMM, which just mallocs */
+    return (void *)phys_addr;
+}
+
+static uintptr_t test_virt_to_phys_page(uintptr_t virt_addr) {
+    if (virt_addr >= SEND_BUF && virt_addr < SEND_BUF + SEND_PAGES * VM_PAGE_SIZE) {
+        const uintptr_t page = (virt_addr - SEND_BUF) / VM_PAGE_SIZE;
+        return page < 2 ? 0x800000 + page * VM_PAGE_SIZE : 0x900000 + (page - 2) * VM_PAGE_SIZE;
+    }
+
+    if (recv_mapped_page && virt_addr == recv_mapped_page) {
+        return 0xa00000;
+    }
+
+    return 0;
+}
+
 /* --- End Mocks and Stubs --- */
 
 /* Extern declarations for globals used in the IPC channel module */
@@ -105,6 +203,25 @@ static void *test_setup(const MunitParameter params[], void *user_data) {
     ipc_channel_init();
 
     current_task_ptr = NULL;
+    schedule_count = 0;
+    last_handoff_task = NULL;
+    last_unblocked_task = NULL;
+    last_managed_resource = NULL;
+
+    sender_process.ipc_completions = NULL;
+    sender_task.owner = &sender_process;
+    receiver_task.owner = &receiver_process;
+    receiver_process.meminfo = &receiver_meminfo;
+
+    shootdown_count = 0;
+    last_shootdown_process = NULL;
+    last_shootdown_vaddr = 0;
+    last_shootdown_pages = 0;
+    recv_mapped_page = 0;
+    recv_region_page = 0;
+
+    mock_vmm_reset();
+    mock_vmm_set_virt_to_phys_page(test_virt_to_phys_page);
     return NULL;
 }
 
@@ -153,6 +270,8 @@ static MunitResult test_recv_with_queued_message(const MunitParameter params[],
     msg->waiter = task_current();
     msg->reply = 0;
     msg->handled = false;
+    msg->async = false;
+    msg->multi_page = false;
 
     /* Manually insert the message into the channel's queue */
     spinlock_lock(channel->queue_lock);
@@ -199,6 +318,8 @@ static MunitResult test_reply(const MunitParameter params[], void *data) {
     msg->waiter = task_current();
     msg->reply = 0;
     msg->handled = false;
+    msg->async = false;
+    msg->multi_page = false;
 
     /* Insert the message into the in-flight message hash table */
     hash_table_insert(in_flight_message_hash, msg->cookie, msg);
@@ -207,6 +328,10 @@ static MunitResult test_reply(const MunitParameter params[], void *data) {
     munit_assert_int(ret, ==, 54321);
     munit_assert_int(msg->reply, ==, 999);
 
+    /* Should switch straight back to the sender */
+    munit_assert_ptr_equal(last_handoff_task, msg->waiter);
+    munit_assert_int(schedule_count, ==, 0);
+
     /* Verify the message has been removed from the hash table */
     IpcMessage *lookup_msg = hash_table_lookup(in_flight_message_hash, msg->cookie);
     munit_assert_null(lookup_msg);
@@ -256,10 +381,562 @@ static MunitResult test_send_when_receiver_waiting(const MunitParameter params[]
     munit_assert_int(ret, ==, 0);
     munit_assert_null(channel->receivers);
 
+    /* Receiver was waiting, so we should have switched straight to it */
+    munit_assert_ptr_equal(last_handoff_task, &receiver_task);
+    munit_assert_int(schedule_count, ==, 0);
+
+    ipc_channel_destroy(channel_cookie);
+    return MUNIT_OK;
+}
+
+/* With nobody waiting, the message is just queued and the sender
+    blocks in the usual way, to be picked up by a later recv. */
+static MunitResult test_send_when_no_receiver(const MunitParameter params[], void *data) {
+    uint64_t channel_cookie = ipc_channel_create();
+    munit_assert_int(channel_cookie, !=, 0);
+
+    current_task_ptr = &sender_task;
+
+    uint64_t ret = ipc_channel_send(channel_cookie, 10, 20, (void *)0x1000);
+
+    munit_assert_int(ret, ==, 0);
+    munit_assert_null(last_handoff_task);
+    munit_assert_int(schedule_count, ==, 1);
+
+    ipc_channel_destroy(channel_cookie);
+    return MUNIT_OK;
+}
+
+/* Sends an async message, then plays the receiver and replies to it */
+static uint64_t send_async_and_reply(uint64_t channel_cookie, uint64_t tag, uint64_t reply) {
+    current_task_ptr = &sender_task;
+    const uint64_t msg_cookie = ipc_channel_send_async(channel_cookie, tag, 0, NULL);
+    munit_assert_uint64(msg_cookie, !=, 0);
+
+    current_task_ptr = &receiver_task;
+    uint64_t recv_tag;
+    size_t size;
+    munit_assert_uint64(ipc_channel_recv(channel_cookie, &recv_tag, &size, &buf), ==, msg_cookie);
+    munit_assert_uint64(recv_tag, ==, tag);
+    munit_assert_uint64(ipc_channel_reply(msg_cookie, reply), ==, msg_cookie);
+
+    current_task_ptr = &sender_task;
+    return msg_cookie;
+}
+
+/* Async send just queues the message and returns its cookie */
+static MunitResult test_send_async_queues(const MunitParameter params[], void *data) {
+    uint64_t channel_cookie = ipc_channel_create();
+    IpcChannel *channel = hash_table_lookup(channel_hash, channel_cookie);
+
+    current_task_ptr = &sender_task;
+
+    uint64_t ret = ipc_channel_send_async(channel_cookie, 10, 20, (void *)SEND_BUF);
+    munit_assert_uint64(ret, !=, 0);
+
+    munit_assert_not_null(channel->queue);
+    munit_assert_uint64(channel->queue->cookie, ==, ret);
+    munit_assert_true(channel->queue->async);
+
+    /* Sender never blocked */
+    munit_assert_int(schedule_count, ==, 0);
+    munit_assert_null(last_handoff_task);
+
+    /* Completions were set up for the process, and will go with it */
+    IpcCompletions *completions = sender_process.ipc_completions;
+    munit_assert_not_null(completions);
+    munit_assert_uint32(completions->outstanding, ==, 1);
+    munit_assert_not_null(last_managed_resource);
+    munit_assert_ptr_equal(last_managed_resource->resource_ptr, completions);
+
+    return MUNIT_OK;
+}
+
+static MunitResult test_send_async_wakes_receiver(const MunitParameter params[], void *data) {
+    uint64_t channel_cookie = ipc_channel_create();
+    IpcChannel *channel = hash_table_lookup(channel_hash, channel_cookie);
+
+    channel->receivers = &receiver_task;
+    receiver_task.this.next = NULL;
+    current_task_ptr = &sender_task;
+
+    munit_assert_uint64(ipc_channel_send_async(channel_cookie, 10, 0, NULL), !=, 0);
+
+    /* Receiver is woken, but we don't switch to it */
+    munit_assert_null(channel->receivers);
+    munit_assert_ptr_equal(last_unblocked_task, &receiver_task);
+    munit_assert_null(last_handoff_task);
+    munit_assert_int(schedule_count, ==, 0);
+
+    return MUNIT_OK;
+}
+
+static MunitResult test_send_async_invalid_channel(const MunitParameter params[], void *data) {
+    current_task_ptr = &sender_task;
+    munit_assert_uint64(ipc_channel_send_async(99999, 1, 0, NULL), ==, 0);
+    return MUNIT_OK;
+}
+
+static MunitResult test_send_async_limit(const MunitParameter params[], void *data) {
+    uint64_t channel_cookie = ipc_channel_create();
+    current_task_ptr = &sender_task;
+
+    for (int i = 0; i < 64; i++) {
+        munit_assert_uint64(ipc_channel_send_async(channel_cookie, i, 0, NULL), !=, 0);
+    }
+
+    munit_assert_uint64(ipc_channel_send_async(channel_cookie, 64, 0, NULL), ==, 0);
+
+    return MUNIT_OK;
+}
+
+static MunitResult test_async_reply_completes(const MunitParameter params[], void *data) {
+    uint64_t channel_cookie = ipc_channel_create();
+
+    uint64_t msg_cookie = send_async_and_reply(channel_cookie, 10, 42);
+
+    /* Replying to an async message doesn't switch anywhere */
+    munit_assert_null(last_handoff_task);
+
+    uint64_t reply = 0;
+    bool handled = false;
+    munit_assert_uint64(ipc_channel_wait_reply(0, &reply, &handled), ==, msg_cookie);
+    munit_assert_uint64(reply, ==, 42);
+    munit_assert_true(handled);
+
+    IpcCompletions *completions = sender_process.ipc_completions;
+    munit_assert_uint32(completions->outstanding, ==, 0);
+    munit_assert_null(completions->head);
+    munit_assert_null(completions->tail);
+
+    return MUNIT_OK;
+}
+
+static MunitResult test_wait_reply_by_cookie(const MunitParameter params[], void *data) {
+    uint64_t channel_cookie = ipc_channel_create();
+
+    uint64_t first = send_async_and_reply(channel_cookie, 1, 100);
+    uint64_t second = send_async_and_reply(channel_cookie, 2, 200);
+
+    uint64_t reply = 0;
+    bool handled = false;
+
+    /* Can pick a specific one out... */
+    munit_assert_uint64(ipc_channel_wait_reply(second, &reply, &handled), ==, second);
+    munit_assert_uint64(reply, ==, 200);
+
+    /* ... and the rest come out in order */
+    munit_assert_uint64(ipc_channel_wait_reply(0, &reply, &handled), ==, first);
+    munit_assert_uint64(reply, ==, 100);
+
+    return MUNIT_OK;
+}
+
+static MunitResult test_wait_reply_nothing_outstanding(const MunitParameter params[], void *data) {
+    uint64_t reply = 0;
+    bool handled = false;
+
+    current_task_ptr = &sender_task;
+
+    /* Never sent anything */
+    munit_assert_uint64(ipc_channel_wait_reply(0, &reply, &handled), ==, 0);
+
+    /* Sent and collected everything */
+    uint64_t channel_cookie = ipc_channel_create();
+    uint64_t msg_cookie = send_async_and_reply(channel_cookie, 1, 100);
+    munit_assert_uint64(ipc_channel_wait_reply(msg_cookie, &reply, &handled), ==, msg_cookie);
+    munit_assert_uint64(ipc_channel_wait_reply(0, &reply, &handled), ==, 0);
+
+    return MUNIT_OK;
+}
+
+static MunitResult test_destroy_completes_async_unhandled(const MunitParameter params[], void *data) {
+    uint64_t channel_cookie = ipc_channel_create();
+    current_task_ptr = &sender_task;
+
+    uint64_t msg_cookie = ipc_channel_send_async(channel_cookie, 10, 0, NULL);
+    ipc_channel_destroy(channel_cookie);
+
+    uint64_t reply = 99;
+    bool handled = true;
+    munit_assert_uint64(ipc_channel_wait_reply(0, &reply, &handled), ==, msg_cookie);
+    munit_assert_false(handled);
+    munit_assert_uint64(reply, ==, 0);
+
+    return MUNIT_OK;
+}
+
+static MunitResult test_destroy_wakes_all_receivers(const MunitParameter params[], void *data) {
+    static Task other_receiver_task;
+
+    uint64_t channel_cookie = ipc_channel_create();
+    IpcChannel *channel = hash_table_lookup(channel_hash, channel_cookie);
+    munit_assert_not_null(channel);
+
+    /* Two receivers blocked waiting */
+    channel->receivers = &receiver_task;
+    receiver_task.this.next = (ListNode *)&other_receiver_task;
+    other_receiver_task.this.next = NULL;
+
+    unblocked_on_count = 0;
+    ipc_channel_destroy(channel_cookie);
+
+    /* Both woken, even though waking the first one reused its list node */
+    munit_assert_int(unblocked_on_count, ==, 2);
+    munit_assert_ptr_equal(unblocked_on_tasks[0], &receiver_task);
+    munit_assert_ptr_equal(unblocked_on_tasks[1], &other_receiver_task);
+
+    return MUNIT_OK;
+}
+
+static MunitResult test_process_exit_orphans_completions(const MunitParameter params[], void *data) {
+    uint64_t channel_cookie = ipc_channel_create();
+    current_task_ptr = &sender_task;
+
+    uint64_t msg_cookie = ipc_channel_send_async(channel_cookie, 10, 0, NULL);
+    IpcCompletions *completions = sender_process.ipc_completions;
+
+    /* Process goes away with the message still queued */
+    last_managed_resource->free_func(last_managed_resource);
+    munit_assert_true(completions->orphaned);
+    munit_assert_uint32(completions->outstanding, ==, 1);
+
+    /* Handling it later is fine, and frees everything (sanitizers will tell if not) */
+    current_task_ptr = &receiver_task;
+    uint64_t tag;
+    size_t size;
+    munit_assert_uint64(ipc_channel_recv(channel_cookie, &tag, &size, &buf), ==, msg_cookie);
+    munit_assert_uint64(ipc_channel_reply(msg_cookie, 1), ==, msg_cookie);
+
+    return MUNIT_OK;
+}
+
+static MunitResult test_send_multi_page_too_big(const MunitParameter params[], void *data) {
+    uint64_t channel_cookie = ipc_channel_create();
+    current_task_ptr = &sender_task;
+
+    munit_assert_uint64(ipc_channel_send(channel_cookie, 1, 256 * VM_PAGE_SIZE + 1, (void *)SEND_BUF), ==, 0);
+    munit_assert_uint64(ipc_channel_send_async(channel_cookie, 1, 256 * VM_PAGE_SIZE + 1, (void *)SEND_BUF), ==, 0);
+
+    return MUNIT_OK;
+}
+
+static MunitResult test_send_multi_page_unmapped(const MunitParameter params[], void *data) {
+    uint64_t channel_cookie = ipc_channel_create();
+    IpcChannel *channel = hash_table_lookup(channel_hash, channel_cookie);
+    current_task_ptr = &sender_task;
+
+    const uint64_t fba_allocs = mock_fba_get_alloc_count();
+    const uint64_t fba_frees = mock_fba_get_free_count();
+
+    /* Last page of the buffer isn't there */
+    munit_assert_uint64(ipc_channel_send(channel_cookie, 1, 5 * VM_PAGE_SIZE, (void *)SEND_BUF), ==, 0);
+    munit_assert_uint64(ipc_channel_send_async(channel_cookie, 1, 5 * VM_PAGE_SIZE, (void *)SEND_BUF), ==, 0);
+
+    /* Nothing queued, nothing leaked */
+    munit_assert_null(channel->queue);
+    munit_assert_uint32(sender_process.ipc_completions->outstanding, ==, 0);
+    munit_assert_uint64(mock_fba_get_alloc_count() - fba_allocs, ==, mock_fba_get_free_count() - fba_frees);
+
+    return MUNIT_OK;
+}
+
+static MunitResult test_send_multi_page_frees_pages(const MunitParameter params[], void *data) {
+    uint64_t channel_cookie = ipc_channel_create();
+    current_task_ptr = &sender_task;
+
+    const uint64_t fba_allocs = mock_fba_get_alloc_count();
+    const uint64_t fba_frees = mock_fba_get_free_count();
+
+    munit_assert_uint64(ipc_channel_send(channel_cookie, 1, SEND_PAGES * VM_PAGE_SIZE, (void *)SEND_BUF), ==, 0);
+
+    munit_assert_uint64(mock_fba_get_alloc_count() - fba_allocs, ==, 1);
+    munit_assert_uint64(mock_fba_get_free_count() - fba_frees, ==, 1);
+
+    /* Never mapped anywhere, so nothing to unmap */
+    munit_assert_uint32(mock_vmm_get_total_page_unmaps(), ==, 0);
+    munit_assert_int(shootdown_count, ==, 0);
+
     ipc_channel_destroy(channel_cookie);
     return MUNIT_OK;
 }
 
+/*
+ * Queue a message lending the sender's multi-page buffer, as a synchronous
+ * send would (the mock scheduler doesn't block, so a real one would be over
+ * before the receiver got to it), then receive it at `recv_buf`.
+ */
+static IpcMessage *queue_and_recv_multi_page(uint64_t channel_cookie, size_t send_size, void *recv_buf,
+                                             size_t *size) {
+    IpcChannel *channel = hash_table_lookup(channel_hash, channel_cookie);
+
+    IpcBufferPages *buf_pages = fba_alloc_block();
+    munit_assert_not_null(buf_pages);
+    buf_pages->receiver = NULL;
+    buf_pages->recv_vaddr = 0;
+    buf_pages->mapped_pages = 0;
+    buf_pages->page_count = (send_size + VM_PAGE_SIZE - 1) / VM_PAGE_SIZE;
+
+    for (uint64_t i = 0; i < buf_pages->page_count; i++) {
+        buf_pages->pages[i] = test_virt_to_phys_page(SEND_BUF + i * VM_PAGE_SIZE);
+    }
+
+    IpcMessage *msg = slab_alloc_block();
+    munit_assert_not_null(msg);
+    msg->this.next = NULL;
+    msg->cookie = 0x5e4d;
+    msg->tag = 10;
+    msg->arg_buf_size = send_size;
+    msg->arg_buf_phys = (uintptr_t)buf_pages;
+    msg->waiter = &sender_task;
+    msg->reply = 0;
+    msg->handled = false;
+    msg->async = false;
+    msg->multi_page = true;
+    msg->owns_pages = false;
+
+    channel->queue = msg;
+
+    current_task_ptr = &receiver_task;
+    uint64_t tag;
+    munit_assert_uint64(ipc_channel_recv(channel_cookie, &tag, size, recv_buf), ==, msg->cookie);
+    munit_assert_uint64(tag, ==, 10);
+
+    return msg;
+}
+
+/* The synchronous sender would do this once it was woken */
+static void free_multi_page(IpcMessage *msg) {
+    fba_free((void *)msg->arg_buf_phys);
+    slab_free(msg);
+}
+
+static MunitResult test_recv_multi_page_maps_runs(const MunitParameter params[], void *data) {
+    uint64_t channel_cookie = ipc_channel_create();
+
+    size_t size = SEND_PAGES * VM_PAGE_SIZE;
+    IpcMessage *msg =
+            queue_and_recv_multi_page(channel_cookie, SEND_PAGES * VM_PAGE_SIZE - 100, (void *)RECV_BUF, &size);
+    const uint64_t msg_cookie = msg->cookie;
+
+    /* Whole thing mapped, contiguously, with the physical runs in order */
+    munit_assert_size(size, ==, SEND_PAGES * VM_PAGE_SIZE - 100);
+    munit_assert_uint32(mock_vmm_get_total_page_maps(), ==, SEND_PAGES);
+    munit_assert_uint64(mock_vmm_get_last_page_map_vaddr(), ==, RECV_BUF + 3 * VM_PAGE_SIZE);
+    munit_assert_uint64(mock_vmm_get_last_page_map_paddr(), ==, 0x901000);
+
+    /* Reply takes it back out of the receiver (except the first page, as for single-page buffers) */
+    munit_assert_uint64(ipc_channel_reply(msg_cookie, 1), ==, msg_cookie);
+    munit_assert_int(shootdown_count, ==, 1);
+    munit_assert_ptr_equal(last_shootdown_process, &receiver_process);
+    munit_assert_uint64(last_shootdown_vaddr, ==, RECV_BUF + VM_PAGE_SIZE);
+    munit_assert_size(last_shootdown_pages, ==, SEND_PAGES - 1);
+
+    /* Sender gets switched straight back to */
+    munit_assert_ptr_equal(last_handoff_task, &sender_task);
+
+    free_multi_page(msg);
+    return MUNIT_OK;
+}
+
+static MunitResult test_recv_multi_page_truncates(const MunitParameter params[], void *data) {
+    uint64_t channel_cookie = ipc_channel_create();
+
+    /* Receiver only has room for two pages */
+    recv_mapped_page = RECV_BUF + 2 * VM_PAGE_SIZE;
+
+    size_t size = SEND_PAGES * VM_PAGE_SIZE;
+    IpcMessage *msg = queue_and_recv_multi_page(channel_cookie, SEND_PAGES * VM_PAGE_SIZE, (void *)RECV_BUF, &size);
+
+    munit_assert_size(size, ==, 2 * VM_PAGE_SIZE);
+    munit_assert_uint32(mock_vmm_get_total_page_maps(), ==, 2);
+    munit_assert_uint64(mock_vmm_get_last_page_map_vaddr(), ==, RECV_BUF + VM_PAGE_SIZE);
+    munit_assert_uint64(mock_vmm_get_last_page_map_paddr(), ==, 0x801000);
+
+    munit_assert_uint64(ipc_channel_reply(msg->cookie, 1), ==, msg->cookie);
+    munit_assert_uint64(last_shootdown_vaddr, ==, RECV_BUF + VM_PAGE_SIZE);
+    munit_assert_size(last_shootdown_pages, ==, 1);
+
+    free_multi_page(msg);
+    return MUNIT_OK;
+}
+
+static MunitResult test_recv_multi_page_first_mapped(const MunitParameter params[], void *data) {
+    uint64_t channel_cookie = ipc_channel_create();
+
+    /* First page is mapped over, as for single-page buffers (e.g. left from the last message) */
+    recv_mapped_page = RECV_BUF;
+
+    size_t size = SEND_PAGES * VM_PAGE_SIZE;
+    IpcMessage *msg = queue_and_recv_multi_page(channel_cookie, SEND_PAGES * VM_PAGE_SIZE, (void *)RECV_BUF, &size);
+
+    munit_assert_size(size, ==, SEND_PAGES * VM_PAGE_SIZE);
+    munit_assert_uint32(mock_vmm_get_total_page_maps(), ==, SEND_PAGES);
+
+    munit_assert_uint64(ipc_channel_reply(msg->cookie, 1), ==, msg->cookie);
+    free_multi_page(msg);
+    return MUNIT_OK;
+}
+
+static MunitResult test_recv_multi_page_no_room(const MunitParameter params[], void *data) {
+    uint64_t channel_cookie = ipc_channel_create();
+
+    /* Only room for the first page */
+    recv_mapped_page = RECV_BUF + VM_PAGE_SIZE;
+
+    size_t size = SEND_PAGES * VM_PAGE_SIZE;
+    IpcMessage *msg = queue_and_recv_multi_page(channel_cookie, SEND_PAGES * VM_PAGE_SIZE, (void *)RECV_BUF, &size);
+
+    munit_assert_size(size, ==, VM_PAGE_SIZE);
+    munit_assert_uint32(mock_vmm_get_total_page_maps(), ==, 1);
+    munit_assert_uint64(mock_vmm_get_last_page_map_vaddr(), ==, RECV_BUF);
+    munit_assert_uint64(mock_vmm_get_last_page_map_paddr(), ==, 0x800000);
+
+    /* Nothing that needs taking back out */
+    munit_assert_uint64(ipc_channel_reply(msg->cookie, 1), ==, msg->cookie);
+    munit_assert_int(shootdown_count, ==, 0);
+
+    free_multi_page(msg);
+    return MUNIT_OK;
+}
+
+static MunitResult test_recv_multi_page_bounded_by_size(const MunitParameter params[], void *data) {
+    uint64_t channel_cookie = ipc_channel_create();
+
+    /* Receiver only has room for a page and a bit, plenty of unmapped space after that notwithstanding */
+    size_t size = VM_PAGE_SIZE + 1;
+    IpcMessage *msg = queue_and_recv_multi_page(channel_cookie, SEND_PAGES * VM_PAGE_SIZE, (void *)RECV_BUF, &size);
+
+    /* Both pages are mapped, but the size is never more than it asked for */
+    munit_assert_size(size, ==, VM_PAGE_SIZE + 1);
+    munit_assert_uint32(mock_vmm_get_total_page_maps(), ==, 2);
+    munit_assert_uint64(mock_vmm_get_last_page_map_vaddr(), ==, RECV_BUF + VM_PAGE_SIZE);
+
+    munit_assert_uint64(ipc_channel_reply(msg->cookie, 1), ==, msg->cookie);
+    free_multi_page(msg);
+    return MUNIT_OK;
+}
+
+static MunitResult test_recv_multi_page_no_size(const MunitParameter params[], void *data) {
+    uint64_t channel_cookie = ipc_channel_create();
+
+    /* Not saying means only the first page */
+    size_t size = 0;
+    IpcMessage *msg = queue_and_recv_multi_page(channel_cookie, SEND_PAGES * VM_PAGE_SIZE, (void *)RECV_BUF, &size);
+
+    munit_assert_size(size, ==, VM_PAGE_SIZE);
+    munit_assert_uint32(mock_vmm_get_total_page_maps(), ==, 1);
+
+    munit_assert_uint64(ipc_channel_reply(msg->cookie, 1), ==, msg->cookie);
+    free_multi_page(msg);
+    return MUNIT_OK;
+}
+
+static MunitResult test_recv_multi_page_stops_at_region(const MunitParameter params[], void *data) {
+    uint64_t channel_cookie = ipc_channel_create();
+
+    /* Third page is unmapped, but belongs to a region */
+    recv_region_page = RECV_BUF + 2 * VM_PAGE_SIZE;
+
+    size_t size = SEND_PAGES * VM_PAGE_SIZE;
+    IpcMessage *msg = queue_and_recv_multi_page(channel_cookie, SEND_PAGES * VM_PAGE_SIZE, (void *)RECV_BUF, &size);
+
+    munit_assert_size(size, ==, 2 * VM_PAGE_SIZE);
+    munit_assert_uint32(mock_vmm_get_total_page_maps(), ==, 2);
+    munit_assert_uint64(mock_vmm_get_last_page_map_vaddr(), ==, RECV_BUF + VM_PAGE_SIZE);
+
+    munit_assert_uint64(ipc_channel_reply(msg->cookie, 1), ==, msg->cookie);
+    free_multi_page(msg);
+    return MUNIT_OK;
+}
+
+static MunitResult test_send_async_copies_buffer(const MunitParameter params[], void *data) {
+    uint64_t channel_cookie = ipc_channel_create();
+
+    const uint64_t fba_allocs = mock_fba_get_alloc_count();
+    const uint64_t fba_frees = mock_fba_get_free_count();
+    const uint32_t page_allocs = mock_pmm_get_total_page_allocs();
+    const uint32_t page_frees = mock_pmm_get_total_page_frees();
+
+    memset(send_page_data, 0xa5, sizeof(send_page_data));
+
+    current_task_ptr = &sender_task;
+    const uint64_t msg_cookie =
+            ipc_channel_send_async(channel_cookie, 10, SEND_PAGES * VM_PAGE_SIZE - 100, (void *)SEND_BUF);
+    munit_assert_uint64(msg_cookie, !=, 0);
+    munit_assert_uint32(mock_pmm_get_total_page_allocs() - page_allocs, ==, SEND_PAGES);
+
+    /* Sender is free to reuse its buffer straight away */
+    memset(send_page_data, 0, sizeof(send_page_data));
+
+    current_task_ptr = &receiver_task;
+    uint64_t tag;
+    size_t size = SEND_PAGES * VM_PAGE_SIZE;
+    munit_assert_uint64(ipc_channel_recv(channel_cookie, &tag, &size, (void *)RECV_BUF), ==, msg_cookie);
+
+    /* Receiver gets the copy, as it was at send */
+    munit_assert_size(size, ==, SEND_PAGES * VM_PAGE_SIZE - 100);
+    munit_assert_uint32(mock_vmm_get_total_page_maps(), ==, SEND_PAGES);
+    munit_assert_uint64(mock_vmm_get_last_page_map_vaddr(), ==, RECV_BUF + 3 * VM_PAGE_SIZE);
+
+    const uintptr_t copy = mock_vmm_get_last_page_map_paddr();
+    munit_assert_uint64(copy, !=, 0x901000);
+    munit_assert_uint8(((uint8_t *)vmm_phys_to_virt_ptr(copy))[VM_PAGE_SIZE - 1], ==, 0xa5);
+
+    /* The copy goes with the message, so none of it can stay mapped */
+    munit_assert_uint64(ipc_channel_reply(msg_cookie, 1), ==, msg_cookie);
+    munit_assert_int(shootdown_count, ==, 1);
+    munit_assert_ptr_equal(last_shootdown_process, &receiver_process);
+    munit_assert_uint64(last_shootdown_vaddr, ==, RECV_BUF);
+    munit_assert_size(last_shootdown_pages, ==, SEND_PAGES);
+
+    current_task_ptr = &sender_task;
+    munit_assert_uint64(ipc_channel_wait_reply(msg_cookie, NULL, NULL), ==, msg_cookie);
+    munit_assert_uint32(mock_pmm_get_total_page_frees() - page_frees, ==, SEND_PAGES);
+    munit_assert_uint64(mock_fba_get_alloc_count() - fba_allocs, ==, mock_fba_get_free_count() - fba_frees);
+
+    return MUNIT_OK;
+}
+
+static MunitResult test_send_async_single_page_copied(const MunitParameter params[], void *data) {
+    uint64_t channel_cookie = ipc_channel_create();
+
+    current_task_ptr = &sender_task;
+    const uint64_t msg_cookie = ipc_channel_send_async(channel_cookie, 10, 20, (void *)SEND_BUF);
+    munit_assert_uint64(msg_cookie, !=, 0);
+
+    current_task_ptr = &receiver_task;
+    uint64_t tag;
+    size_t size = 0;
+    munit_assert_uint64(ipc_channel_recv(channel_cookie, &tag, &size, &buf), ==, msg_cookie);
+
+    munit_assert_size(size, ==, 20);
+    munit_assert_uint32(mock_vmm_get_total_page_maps(), ==, 1);
+    munit_assert_uint64(mock_vmm_get_last_page_map_paddr(), !=, 0x800000);
+
+    munit_assert_uint64(ipc_channel_reply(msg_cookie, 1), ==, msg_cookie);
+    munit_assert_uint64(last_shootdown_vaddr, ==, (uintptr_t)&buf);
+    munit_assert_size(last_shootdown_pages, ==, 1);
+
+    return MUNIT_OK;
+}
+
+static MunitResult test_send_async_unmapped_buffer(const MunitParameter params[], void *data) {
+    uint64_t channel_cookie = ipc_channel_create();
+    IpcChannel *channel = hash_table_lookup(channel_hash, channel_cookie);
+    current_task_ptr = &sender_task;
+
+    const uint32_t page_allocs = mock_pmm_get_total_page_allocs();
+
+    /* Nothing to copy from */
+    munit_assert_uint64(ipc_channel_send_async(channel_cookie, 1, 20, (void *)0x1000), ==, 0);
+
+    munit_assert_null(channel->queue);
+    munit_assert_uint32(mock_pmm_get_total_page_allocs(), ==, page_allocs);
+
+    return MUNIT_OK;
+}
+
 /* --- Test Suite Registration --- */
 static MunitTest test_suite_tests[] = {
         {"/create_destroy", test_channel_create_destroy, test_setup, NULL, MUNIT_TEST_OPTION_NONE, NULL},
@@ -268,6 +945,41 @@ static MunitTest test_suite_tests[] = {
         {"/send_invalid_channel", test_send_invalid_channel, test_setup, NULL, MUNIT_TEST_OPTION_NONE, NULL},
         {"/recv_invalid_channel", test_recv_invalid_channel, test_setup, NULL, MUNIT_TEST_OPTION_NONE, NULL},
         {"/send_receiver_waiting", test_send_when_receiver_waiting, test_setup, NULL, MUNIT_TEST_OPTION_NONE, NULL},
+        {"/send_no_receiver", test_send_when_no_receiver, test_setup, NULL, MUNIT_TEST_OPTION_NONE, NULL},
+        {"/send_async_queues", test_send_async_queues, test_setup, NULL, MUNIT_TEST_OPTION_NONE, NULL},
+        {"/send_async_wakes_receiver", test_send_async_wakes_receiver, test_setup, NULL, MUNIT_TEST_OPTION_NONE, NULL},
+        {"/send_async_invalid_channel", test_send_async_invalid_channel, test_setup, NULL, MUNIT_TEST_OPTION_NONE,
+         NULL},
+        {"/send_async_limit", test_send_async_limit, test_setup, NULL, MUNIT_TEST_OPTION_NONE, NULL},
+        {"/async_reply_completes", test_async_reply_completes, test_setup, NULL, MUNIT_TEST_OPTION_NONE, NULL},
+        {"/wait_reply_by_cookie", test_wait_reply_by_cookie, test_setup, NULL, MUNIT_TEST_OPTION_NONE, NULL},
+        {"/wait_reply_nothing_outstanding", test_wait_reply_nothing_outstanding, test_setup, NULL,
+         MUNIT_TEST_OPTION_NONE, NULL},
+        {"/destroy_completes_async_unhandled", test_destroy_completes_async_unhandled, test_setup, NULL,
+         MUNIT_TEST_OPTION_NONE, NULL},
+        {"/destroy_wakes_all_receivers", test_destroy_wakes_all_receivers, test_setup, NULL, MUNIT_TEST_OPTION_NONE,
+         NULL},
+        {"/process_exit_orphans_completions", test_process_exit_orphans_completions, test_setup, NULL,
+         MUNIT_TEST_OPTION_NONE, NULL},
+        {"/send_multi_page_too_big", test_send_multi_page_too_big, test_setup, NULL, MUNIT_TEST_OPTION_NONE, NULL},
+        {"/send_multi_page_unmapped", test_send_multi_page_unmapped, test_setup, NULL, MUNIT_TEST_OPTION_NONE, NULL},
+        {"/send_multi_page_frees_pages", test_send_multi_page_frees_pages, test_setup, NULL, MUNIT_TEST_OPTION_NONE,
+         NULL},
+        {"/recv_multi_page_maps_runs", test_recv_multi_page_maps_runs, test_setup, NULL, MUNIT_TEST_OPTION_NONE, NULL},
+        {"/recv_multi_page_truncates", test_recv_multi_page_truncates, test_setup, NULL, MUNIT_TEST_OPTION_NONE, NULL},
+        {"/recv_multi_page_first_mapped", test_recv_multi_page_first_mapped, test_setup, NULL, MUNIT_TEST_OPTION_NONE,
+         NULL},
+        {"/recv_multi_page_no_room", test_recv_multi_page_no_room, test_setup, NULL, MUNIT_TEST_OPTION_NONE, NULL},
+        {"/recv_multi_page_bounded_by_size", test_recv_multi_page_bounded_by_size, test_setup, NULL,
+         MUNIT_TEST_OPTION_NONE, NULL},
+        {"/recv_multi_page_no_size", test_recv_multi_page_no_size, test_setup, NULL, MUNIT_TEST_OPTION_NONE, NULL},
+        {"/recv_multi_page_stops_at_region", test_recv_multi_page_stops_at_region, test_setup, NULL,
+         MUNIT_TEST_OPTION_NONE, NULL},
+        {"/send_async_copies_buffer", test_send_async_copies_buffer, test_setup, NULL, MUNIT_TEST_OPTION_NONE, NULL},
+        {"/send_async_single_page_copied", test_send_async_single_page_copied, test_setup, NULL,
+         MUNIT_TEST_OPTION_NONE, NULL},
+        {"/send_async_unmapped_buffer", test_send_async_unmapped_buffer, test_setup, NULL, MUNIT_TEST_OPTION_NONE,
+         NULL},
         {NULL, NULL, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL}};
 
 static const MunitSuite test_suite = {"/ipc/channel", test_suite_tests, NULL, /* no suite-level setup */
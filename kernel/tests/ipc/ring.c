@@ -0,0 +1,455 @@
+/*
+ * stage3 - Tests for shared-memory IPC rings
+ * anos - An Operating System
+ *
+ * Copyright (c) 2025 Ross Bamford
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "munit.h"
+
+#include "mock_fba.h"
+#include "mock_pagetables.h"
+#include "mock_pmm.h"
+#include "mock_vmm.h"
+
+#include "ipc/ring.h"
+#include "ipc/ring_internal.h"
+#include "ipc/ring_shared.h"
+#include "managed_resources/resources.h"
+#include "process.h"
+#include "structs/hash.h"
+
+#define RING_PAGES ((2))
+#define TOTAL_PAGES ((1 + 2 * RING_PAGES))
+
+void panic_sloc(const char *msg, const char *filename, const uint64_t line) { munit_errorf("%s", msg); }
+
+static uint64_t next_cookie = 0x1234567812345678;
+uint64_t capability_cookie_generate(void) { return next_cookie++; }
+
+void kernel_guard_once(void) { /* no-op for tests */ }
+
+/* Just enough locking to check the ring's lock is only ever taken under another (the hash lock) */
+static int locks_held = 0;
+static int nested_ring_locks = 0;
+static const SpinLock *watched_ring_lock = NULL;
+
+void spinlock_init(SpinLock *lock) { (void)lock; }
+
+void spinlock_lock(SpinLock *lock) {
+    if (lock == watched_ring_lock && locks_held) {
+        nested_ring_locks++;
+    }
+
+    locks_held++;
+}
+
+void spinlock_unlock(SpinLock *lock) { locks_held--; }
+
+static int slab_free_count = 0;
+
+void *slab_alloc_block(void) { return malloc(64); }
+
+void slab_free(void *ptr) {
+    slab_free_count++;
+    free(ptr);
+}
+
+static Task *current_task_ptr = NULL;
+Task *task_current(void) { return current_task_ptr; }
+
+static Process creator_process;
+static Process attacher_process;
+static Task creator_task;
+static Task attacher_task;
+
+static ManagedResource *resources[2];
+static int resource_count = 0;
+static bool fail_add_resource = false;
+
+bool process_add_managed_resource(Process *process, ManagedResource *managed_resource) {
+    if (fail_add_resource) {
+        return false;
+    }
+
+    resources[resource_count++] = managed_resource;
+    return true;
+}
+
+bool process_remove_managed_resource(Process *process, ManagedResource *managed_resource) {
+    for (int i = 0; i < resource_count; i++) {
+        if (resources[i] == managed_resource) {
+            resources[i] = resources[--resource_count];
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static int schedule_count = 0;
+static int block_count = 0;
+static Task *last_unblocked_task = NULL;
+
+void sched_block(Task *task) { block_count++; }
+void sched_unblock(Task *task) { last_unblocked_task = task; }
+void sched_schedule(void) { schedule_count++; }
+uint64_t sched_lock_this_cpu(void) { return 0; }
+void sched_unlock_this_cpu(uint64_t flags) { (void)flags; }
+
+extern HashTable *ring_hash;
+
+static void *creator_mem;
+
+static void *test_setup(const MunitParameter params[], void *user_data) {
+    ipc_ring_init();
+
+    mock_vmm_reset();
+    mock_pmm_reset();
+
+    creator_task.owner = &creator_process;
+    attacher_task.owner = &attacher_process;
+    current_task_ptr = &creator_task;
+
+    resource_count = 0;
+    fail_add_resource = false;
+    slab_free_count = 0;
+    locks_held = 0;
+    nested_ring_locks = 0;
+    watched_ring_lock = NULL;
+    schedule_count = 0;
+    block_count = 0;
+    last_unblocked_task = NULL;
+
+    // The mock VMM doesn't really map anything, so give the creator real memory to work in
+    creator_mem = aligned_alloc(0x1000, TOTAL_PAGES * 0x1000);
+
+    return NULL;
+}
+
+static void test_teardown(void *fixture) { free(creator_mem); }
+
+static uint64_t create_and_attach(void) {
+    current_task_ptr = &creator_task;
+    const uint64_t cookie = ipc_ring_create(RING_PAGES, (uintptr_t)creator_mem);
+    munit_assert_uint64(cookie, !=, 0);
+
+    current_task_ptr = &attacher_task;
+    munit_assert_size(ipc_ring_attach(cookie, 0x400000), ==, TOTAL_PAGES * 0x1000);
+
+    return cookie;
+}
+
+static MunitResult test_create_bad_args(const MunitParameter params[], void *data) {
+    munit_assert_uint64(ipc_ring_create(0, (uintptr_t)creator_mem), ==, 0);
+    munit_assert_uint64(ipc_ring_create(3, (uintptr_t)creator_mem), ==, 0);
+    munit_assert_uint64(ipc_ring_create(IPC_RING_MAX_PAGES * 2, (uintptr_t)creator_mem), ==, 0);
+    munit_assert_uint64(ipc_ring_create(RING_PAGES, (uintptr_t)creator_mem + 8), ==, 0);
+
+    munit_assert_uint32(mock_vmm_get_total_page_maps(), ==, 0);
+    munit_assert_int(resource_count, ==, 0);
+
+    return MUNIT_OK;
+}
+
+static MunitResult test_create(const MunitParameter params[], void *data) {
+    const uint64_t cookie = ipc_ring_create(RING_PAGES, (uintptr_t)creator_mem);
+    munit_assert_uint64(cookie, !=, 0);
+
+    IpcRing *ring = hash_table_lookup(ring_hash, cookie);
+    munit_assert_not_null(ring);
+    munit_assert_ptr_equal(ring->ends[0], &creator_process);
+    munit_assert_null(ring->ends[1]);
+    munit_assert_uint32(ring->total_pages, ==, TOTAL_PAGES);
+
+    munit_assert_uint32(mock_pmm_get_total_page_allocs(), ==, TOTAL_PAGES);
+    munit_assert_uint32(mock_vmm_get_total_page_maps(), ==, TOTAL_PAGES);
+    munit_assert_uint64(mock_vmm_get_last_page_map_vaddr(), ==, (uintptr_t)creator_mem + (TOTAL_PAGES - 1) * 0x1000);
+
+    const IpcRingShared *shared = creator_mem;
+    munit_assert_uint32(shared->slot_count, ==, RING_PAGES * 0x1000 / sizeof(IpcRingSlot));
+    munit_assert_uint32(shared->ring_pages, ==, RING_PAGES);
+    munit_assert_uint32(shared->rings[0].head, ==, 0);
+    munit_assert_uint32(shared->rings[1].tail, ==, 0);
+
+    munit_assert_int(resource_count, ==, 1);
+    munit_assert_ptr_equal(resources[0]->resource_ptr, ring);
+
+    return MUNIT_OK;
+}
+
+static uintptr_t mapped_target = 0;
+static uintptr_t one_page_mapped(uintptr_t virt_addr) { return virt_addr == mapped_target ? 0x1000 : 0; }
+
+static MunitResult test_create_target_mapped(const MunitParameter params[], void *data) {
+    mapped_target = (uintptr_t)creator_mem + 0x1000;
+    mock_vmm_set_virt_to_phys_page(one_page_mapped);
+
+    munit_assert_uint64(ipc_ring_create(RING_PAGES, (uintptr_t)creator_mem), ==, 0);
+
+    munit_assert_uint32(mock_vmm_get_total_page_maps(), ==, 0);
+    munit_assert_uint32(mock_pmm_get_total_page_frees(), ==, mock_pmm_get_total_page_allocs());
+    munit_assert_int(resource_count, ==, 0);
+
+    return MUNIT_OK;
+}
+
+static MunitResult test_attach(const MunitParameter params[], void *data) {
+    const uint64_t cookie = create_and_attach();
+
+    IpcRing *ring = hash_table_lookup(ring_hash, cookie);
+    munit_assert_ptr_equal(ring->ends[1], &attacher_process);
+    munit_assert_uint8(ring->refs, ==, 2);
+    munit_assert_uint64(mock_vmm_get_last_page_map_vaddr(), ==, 0x400000 + (TOTAL_PAGES - 1) * 0x1000);
+    munit_assert_uint64(mock_vmm_get_last_page_map_paddr(), ==, ring->pages[TOTAL_PAGES - 1]);
+    munit_assert_int(resource_count, ==, 2);
+
+    /* Only one other end */
+    munit_assert_size(ipc_ring_attach(cookie, 0x800000), ==, 0);
+    current_task_ptr = &creator_task;
+    munit_assert_size(ipc_ring_attach(cookie, 0x800000), ==, 0);
+
+    munit_assert_size(ipc_ring_attach(99999, 0x800000), ==, 0);
+
+    return MUNIT_OK;
+}
+
+static MunitResult test_create_resource_fails(const MunitParameter params[], void *data) {
+    fail_add_resource = true;
+
+    munit_assert_uint64(ipc_ring_create(RING_PAGES, (uintptr_t)creator_mem), ==, 0);
+
+    // Resource went back, and everything was unmapped again
+    munit_assert_int(slab_free_count, ==, 1);
+    munit_assert_uint32(mock_vmm_get_total_page_unmaps(), ==, TOTAL_PAGES);
+
+    return MUNIT_OK;
+}
+
+static MunitResult test_create_insert_fails(const MunitParameter params[], void *data) {
+    static uint8_t other_mem[TOTAL_PAGES * 0x1000] __attribute__((aligned(0x1000)));
+
+    const uint64_t cookie = ipc_ring_create(RING_PAGES, (uintptr_t)creator_mem);
+    IpcRing *ring = hash_table_lookup(ring_hash, cookie);
+    const uint32_t unmaps = mock_vmm_get_total_page_unmaps();
+
+    // Same cookie again, so the second ring can't go in the hash
+    next_cookie = cookie;
+    munit_assert_uint64(ipc_ring_create(RING_PAGES, (uintptr_t)other_mem), ==, 0);
+
+    // Its end went back, so nothing will try to release it later - and everything else went too
+    munit_assert_int(resource_count, ==, 1);
+    munit_assert_ptr_equal(resources[0]->resource_ptr, ring);
+    munit_assert_int(slab_free_count, ==, 1);
+    munit_assert_uint32(mock_vmm_get_total_page_unmaps(), ==, unmaps + TOTAL_PAGES);
+    munit_assert_uint32(mock_pmm_get_total_page_frees(), ==, TOTAL_PAGES);
+
+    // The first is untouched
+    munit_assert_ptr_equal(hash_table_lookup(ring_hash, cookie), ring);
+    munit_assert_uint8(ring->refs, ==, 1);
+
+    return MUNIT_OK;
+}
+
+static MunitResult test_attach_resource_fails(const MunitParameter params[], void *data) {
+    current_task_ptr = &creator_task;
+    const uint64_t cookie = ipc_ring_create(RING_PAGES, (uintptr_t)creator_mem);
+    IpcRing *ring = hash_table_lookup(ring_hash, cookie);
+
+    fail_add_resource = true;
+    current_task_ptr = &attacher_task;
+    munit_assert_size(ipc_ring_attach(cookie, 0x400000), ==, 0);
+
+    // Not left half-attached - nothing would ever release that end
+    munit_assert_null(ring->ends[1]);
+    munit_assert_uint8(ring->refs, ==, 1);
+    munit_assert_int(slab_free_count, ==, 1);
+
+    // So it can still be attached once that works
+    fail_add_resource = false;
+    munit_assert_size(ipc_ring_attach(cookie, 0x400000), ==, TOTAL_PAGES * 0x1000);
+    munit_assert_ptr_equal(ring->ends[1], &attacher_process);
+    munit_assert_uint8(ring->refs, ==, 2);
+
+    return MUNIT_OK;
+}
+
+static MunitResult test_produce_consume(const MunitParameter params[], void *data) {
+    ipc_ring_create(RING_PAGES, (uintptr_t)creator_mem);
+    IpcRingShared *shared = creator_mem;
+
+    IpcRingSlot slot = {.tag = 1};
+    bool notify = false;
+
+    munit_assert_true(ipc_ring_is_empty(shared, 0));
+
+    /* First one onto an empty ring wants a doorbell, the next doesn't */
+    munit_assert_true(ipc_ring_produce(shared, 0, &slot, &notify));
+    munit_assert_true(notify);
+    slot.tag = 2;
+    munit_assert_true(ipc_ring_produce(shared, 0, &slot, &notify));
+    munit_assert_false(notify);
+
+    /* Other ring is independent */
+    munit_assert_true(ipc_ring_is_empty(shared, 1));
+
+    IpcRingSlot out;
+    munit_assert_true(ipc_ring_consume(shared, 0, &out));
+    munit_assert_uint64(out.tag, ==, 1);
+    munit_assert_true(ipc_ring_consume(shared, 0, &out));
+    munit_assert_uint64(out.tag, ==, 2);
+    munit_assert_false(ipc_ring_consume(shared, 0, &out));
+    munit_assert_true(ipc_ring_is_empty(shared, 0));
+
+    /* Drained, so it wants one again */
+    munit_assert_true(ipc_ring_produce(shared, 0, &slot, &notify));
+    munit_assert_true(notify);
+
+    return MUNIT_OK;
+}
+
+static MunitResult test_produce_full(const MunitParameter params[], void *data) {
+    ipc_ring_create(RING_PAGES, (uintptr_t)creator_mem);
+    IpcRingShared *shared = creator_mem;
+
+    IpcRingSlot slot = {0};
+    bool notify;
+
+    for (int i = 0; i < shared->slot_count; i++) {
+        slot.tag = i;
+        munit_assert_true(ipc_ring_produce(shared, 1, &slot, &notify));
+    }
+
+    munit_assert_false(ipc_ring_produce(shared, 1, &slot, &notify));
+
+    /* Wraps around once there's room */
+    IpcRingSlot out;
+    munit_assert_true(ipc_ring_consume(shared, 1, &out));
+    munit_assert_uint64(out.tag, ==, 0);
+    slot.tag = 999;
+    munit_assert_true(ipc_ring_produce(shared, 1, &slot, &notify));
+    munit_assert_uint64(ipc_ring_slots(shared, 1)[0].tag, ==, 999);
+
+    return MUNIT_OK;
+}
+
+static MunitResult test_notify_before_wait(const MunitParameter params[], void *data) {
+    const uint64_t cookie = create_and_attach();
+
+    /* Attacher rings the creator's doorbell with nobody waiting... */
+    munit_assert_true(ipc_ring_notify(cookie));
+    munit_assert_null(last_unblocked_task);
+
+    /* ... so the creator's next wait doesn't block */
+    current_task_ptr = &creator_task;
+    munit_assert_true(ipc_ring_wait(cookie));
+    munit_assert_int(block_count, ==, 0);
+    munit_assert_int(schedule_count, ==, 0);
+
+    return MUNIT_OK;
+}
+
+static MunitResult test_wait_then_notify(const MunitParameter params[], void *data) {
+    const uint64_t cookie = create_and_attach();
+    IpcRing *ring = hash_table_lookup(ring_hash, cookie);
+
+    /* Attacher waits (the mock scheduler doesn't really block) */
+    munit_assert_true(ipc_ring_wait(cookie));
+    munit_assert_int(block_count, ==, 1);
+    munit_assert_ptr_equal(ring->waiters[1], &attacher_task);
+
+    /* Creator rings, waking it directly rather than leaving it pending */
+    current_task_ptr = &creator_task;
+    munit_assert_true(ipc_ring_notify(cookie));
+    munit_assert_ptr_equal(last_unblocked_task, &attacher_task);
+    munit_assert_null(ring->waiters[1]);
+    munit_assert_false(ring->pending[1]);
+
+    return MUNIT_OK;
+}
+
+static MunitResult test_not_an_end(const MunitParameter params[], void *data) {
+    current_task_ptr = &creator_task;
+    const uint64_t cookie = ipc_ring_create(RING_PAGES, (uintptr_t)creator_mem);
+
+    current_task_ptr = &attacher_task;
+    munit_assert_false(ipc_ring_wait(cookie));
+    munit_assert_false(ipc_ring_notify(cookie));
+    munit_assert_false(ipc_ring_wait(99999));
+    munit_assert_false(ipc_ring_notify(99999));
+
+    return MUNIT_OK;
+}
+
+static MunitResult test_release(const MunitParameter params[], void *data) {
+    const uint64_t cookie = create_and_attach();
+    IpcRing *ring = hash_table_lookup(ring_hash, cookie);
+
+    /* Attacher is waiting when the creator goes away */
+    ipc_ring_wait(cookie);
+    resources[0]->free_func(resources[0]);
+
+    munit_assert_true(ring->closed);
+    munit_assert_ptr_equal(last_unblocked_task, &attacher_task);
+    munit_assert_uint32(mock_pmm_get_total_page_frees(), ==, 0);
+
+    /* Nothing more to wait for, or to tell */
+    munit_assert_false(ipc_ring_wait(cookie));
+    munit_assert_false(ipc_ring_notify(cookie));
+
+    /* Last one out frees it */
+    resources[1]->free_func(resources[1]);
+    munit_assert_uint32(mock_pmm_get_total_page_frees(), ==, TOTAL_PAGES);
+    munit_assert_null(hash_table_lookup(ring_hash, cookie));
+
+    return MUNIT_OK;
+}
+
+static MunitResult test_locked_under_hash_lock(const MunitParameter params[], void *data) {
+    const uint64_t cookie = create_and_attach();
+    IpcRing *ring = hash_table_lookup(ring_hash, cookie);
+    watched_ring_lock = &ring->lock;
+
+    /* Lookups keep hold of the hash until they have the ring... */
+    munit_assert_true(ipc_ring_notify(cookie));
+    munit_assert_true(ipc_ring_wait(cookie));
+    munit_assert_int(nested_ring_locks, ==, 2);
+
+    /* ... and the ends going away take it first, so can't free it under them */
+    resources[0]->free_func(resources[0]);
+    munit_assert_int(nested_ring_locks, ==, 3);
+    resources[1]->free_func(resources[1]);
+    munit_assert_int(nested_ring_locks, ==, 4);
+
+    munit_assert_int(locks_held, ==, 0);
+
+    return MUNIT_OK;
+}
+
+static MunitTest test_suite_tests[] = {
+        {"/create_bad_args", test_create_bad_args, test_setup, test_teardown, MUNIT_TEST_OPTION_NONE, NULL},
+        {"/create", test_create, test_setup, test_teardown, MUNIT_TEST_OPTION_NONE, NULL},
+        {"/create_target_mapped", test_create_target_mapped, test_setup, test_teardown, MUNIT_TEST_OPTION_NONE, NULL},
+        {"/attach", test_attach, test_setup, test_teardown, MUNIT_TEST_OPTION_NONE, NULL},
+        {"/create_resource_fails", test_create_resource_fails, test_setup, test_teardown, MUNIT_TEST_OPTION_NONE,
+         NULL},
+        {"/create_insert_fails", test_create_insert_fails, test_setup, test_teardown, MUNIT_TEST_OPTION_NONE, NULL},
+        {"/attach_resource_fails", test_attach_resource_fails, test_setup, test_teardown, MUNIT_TEST_OPTION_NONE,
+         NULL},
+        {"/produce_consume", test_produce_consume, test_setup, test_teardown, MUNIT_TEST_OPTION_NONE, NULL},
+        {"/produce_full", test_produce_full, test_setup, test_teardown, MUNIT_TEST_OPTION_NONE, NULL},
+        {"/notify_before_wait", test_notify_before_wait, test_setup, test_teardown, MUNIT_TEST_OPTION_NONE, NULL},
+        {"/wait_then_notify", test_wait_then_notify, test_setup, test_teardown, MUNIT_TEST_OPTION_NONE, NULL},
+        {"/not_an_end", test_not_an_end, test_setup, test_teardown, MUNIT_TEST_OPTION_NONE, NULL},
+        {"/release", test_release, test_setup, test_teardown, MUNIT_TEST_OPTION_NONE, NULL},
+        {"/locked_under_hash_lock", test_locked_under_hash_lock, test_setup, test_teardown, MUNIT_TEST_OPTION_NONE,
+         NULL},
+        {NULL, NULL, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL}};
+
+static const MunitSuite test_suite = {"/ipc/ring", test_suite_tests, NULL, 1, MUNIT_SUITE_OPTION_NONE};
+
+int main(int argc, char *argv[]) { return munit_suite_main(&test_suite, NULL, argc, argv); }
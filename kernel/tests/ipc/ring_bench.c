@@ -0,0 +1,219 @@
+/*
+ * Microbenchmark - Shared-memory IPC rings
+ * anos - An Operating System
+ *
+ * Copyright (c) 2025 Ross Bamford
+ *
+ * Runs the producer and consumer sides of ipc/ring_shared.h on
+ * two host threads (on different CPUs where we can ask for that):
+ *
+ *   stream     - one-way messages as fast as the consumer drains them
+ *   ping_pong  - request on ring 0, response on ring 1, one at a time
+ *
+ * Nobody blocks here (the doorbell is the kernel's business), but
+ * stream also counts how often a real producer would have had to
+ * ring it.
+ */
+
+#define _GNU_SOURCE
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "bench.h"
+#include "ipc/ring_shared.h"
+
+#define STREAM_OPS 10000000
+#define PING_PONG_OPS 200000
+#define SPIN_LIMIT 0x3ff
+
+static const uint32_t ring_pages[] = {1, 4, 16};
+
+typedef struct {
+    IpcRingShared *shared;
+    uint64_t ops;
+    uint64_t notifies;
+    int cpu;
+} BenchThread;
+
+static void pin_to_cpu(const int cpu) {
+#ifdef __linux__
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+#endif
+}
+
+// Spin briefly, then give the CPU up in case the other side needs it to make progress
+static inline void spin_wait(uint32_t *spins) {
+    if (++*spins & SPIN_LIMIT) {
+        __builtin_ia32_pause();
+    } else {
+        sched_yield();
+    }
+}
+
+static IpcRingShared *alloc_shared(const uint32_t pages) {
+    const size_t size = (1 + 2 * pages) * IPC_RING_PAGE_SIZE;
+    IpcRingShared *shared = aligned_alloc(IPC_RING_PAGE_SIZE, size);
+
+    if (!shared) {
+        fprintf(stderr, "Failed to allocate %zu bytes for ring\n", size);
+        exit(1);
+    }
+
+    for (size_t i = 0; i < size; i++) {
+        ((uint8_t *)shared)[i] = 0;
+    }
+
+    shared->slot_count = pages * (IPC_RING_PAGE_SIZE / sizeof(IpcRingSlot));
+    shared->ring_pages = pages;
+
+    return shared;
+}
+
+static void *stream_consumer(void *arg) {
+    BenchThread *thread = arg;
+    uint32_t spins = 0;
+    IpcRingSlot slot;
+    uint64_t sum = 0;
+
+    pin_to_cpu(thread->cpu);
+
+    for (uint64_t i = 0; i < thread->ops; i++) {
+        while (!ipc_ring_consume(thread->shared, 0, &slot)) {
+            spin_wait(&spins);
+        }
+
+        sum += slot.tag;
+    }
+
+    bench_consume(sum);
+    return NULL;
+}
+
+static void *stream_producer(void *arg) {
+    BenchThread *thread = arg;
+    uint32_t spins = 0;
+    IpcRingSlot slot = {0};
+    bool notify;
+
+    pin_to_cpu(thread->cpu);
+
+    for (uint64_t i = 0; i < thread->ops; i++) {
+        slot.tag = i;
+
+        while (!ipc_ring_produce(thread->shared, 0, &slot, &notify)) {
+            spin_wait(&spins);
+        }
+
+        thread->notifies += notify;
+    }
+
+    return NULL;
+}
+
+static void *ping_pong_server(void *arg) {
+    BenchThread *thread = arg;
+    uint32_t spins = 0;
+    IpcRingSlot slot;
+    bool notify;
+
+    pin_to_cpu(thread->cpu);
+
+    for (uint64_t i = 0; i < thread->ops; i++) {
+        while (!ipc_ring_consume(thread->shared, 0, &slot)) {
+            spin_wait(&spins);
+        }
+
+        slot.tag++;
+
+        while (!ipc_ring_produce(thread->shared, 1, &slot, &notify)) {
+            spin_wait(&spins);
+        }
+    }
+
+    return NULL;
+}
+
+static void *ping_pong_client(void *arg) {
+    BenchThread *thread = arg;
+    uint32_t spins = 0;
+    IpcRingSlot slot = {0};
+    bool notify;
+
+    pin_to_cpu(thread->cpu);
+
+    for (uint64_t i = 0; i < thread->ops; i++) {
+        slot.tag = i;
+
+        while (!ipc_ring_produce(thread->shared, 0, &slot, &notify)) {
+            spin_wait(&spins);
+        }
+
+        while (!ipc_ring_consume(thread->shared, 1, &slot)) {
+            spin_wait(&spins);
+        }
+    }
+
+    bench_consume(slot.tag);
+    return NULL;
+}
+
+static uint64_t run_pair(void *(*producer)(void *), void *(*consumer)(void *), BenchThread *producer_thread,
+                         BenchThread *consumer_thread) {
+    pthread_t consumer_id, producer_id;
+
+    const uint64_t start = bench_now_ns();
+
+    pthread_create(&consumer_id, NULL, consumer, consumer_thread);
+    pthread_create(&producer_id, NULL, producer, producer_thread);
+    pthread_join(producer_id, NULL);
+    pthread_join(consumer_id, NULL);
+
+    return bench_now_ns() - start;
+}
+
+static void bench_stream(const uint32_t pages) {
+    IpcRingShared *shared = alloc_shared(pages);
+
+    BenchThread producer = {.shared = shared, .ops = STREAM_OPS, .cpu = 0};
+    BenchThread consumer = {.shared = shared, .ops = STREAM_OPS, .cpu = 1};
+
+    const uint64_t elapsed = run_pair(stream_producer, stream_consumer, &producer, &consumer);
+
+    bench_report("ipc/ring", "stream", "pages", pages, STREAM_OPS, elapsed);
+    bench_report("ipc/ring", "stream_doorbells", "pages", pages, producer.notifies, elapsed);
+
+    free(shared);
+}
+
+static void bench_ping_pong(const uint32_t pages) {
+    IpcRingShared *shared = alloc_shared(pages);
+
+    BenchThread client = {.shared = shared, .ops = PING_PONG_OPS, .cpu = 0};
+    BenchThread server = {.shared = shared, .ops = PING_PONG_OPS, .cpu = 1};
+
+    const uint64_t elapsed = run_pair(ping_pong_client, ping_pong_server, &client, &server);
+
+    bench_report("ipc/ring", "ping_pong", "pages", pages, PING_PONG_OPS, elapsed);
+
+    free(shared);
+}
+
+int main(void) {
+    for (int i = 0; i < sizeof(ring_pages) / sizeof(ring_pages[0]); i++) {
+        bench_stream(ring_pages[i]);
+    }
+
+    for (int i = 0; i < sizeof(ring_pages) / sizeof(ring_pages[0]); i++) {
+        bench_ping_pong(ring_pages[i]);
+    }
+
+    return 0;
+}
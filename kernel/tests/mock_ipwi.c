@@ -0,0 +1,33 @@
+/*
+ * Mock implementation of the IPWI notifications for hosted tests
+ * anos - An Operating System
+ *
+ * Copyright (c) 2025 Ross Bamford
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "mock_ipwi.h"
+
+#define MOCK_IPWI_MAX_CPUS ((16))
+
+static uint32_t reschedule_counts[MOCK_IPWI_MAX_CPUS];
+
+void mock_ipwi_reset(void) {
+    for (int i = 0; i < MOCK_IPWI_MAX_CPUS; i++) {
+        reschedule_counts[i] = 0;
+    }
+}
+
+uint32_t mock_ipwi_get_reschedule_count(const uint16_t cpu_num) {
+    return cpu_num < MOCK_IPWI_MAX_CPUS ? reschedule_counts[cpu_num] : 0;
+}
+
+bool ipwi_notify_reschedule(const uint16_t cpu_num) {
+    if (cpu_num < MOCK_IPWI_MAX_CPUS) {
+        reschedule_counts[cpu_num]++;
+    }
+
+    return true;
+}
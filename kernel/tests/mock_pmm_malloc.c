@@ -47,3 +47,6 @@ void page_free(MemoryRegion *region, uintptr_t page) {
 
     // don't bother freeing for now...
 }
+
+// No pre-zeroed pages here, everything gets allocated (and zeroed) as usual
+uintptr_t page_alloc_zeroed(MemoryRegion *region) { return 0xff; }
@@ -36,3 +36,11 @@ uintptr_t page_alloc(MemoryRegion *region) {
 }
 
 void page_free(MemoryRegion *region, uintptr_t page) { total_page_frees++; }
+
+uintptr_t page_alloc_for_zeroing(MemoryRegion *region) { return 0xff; }
+
+uintptr_t page_alloc_zeroed(MemoryRegion *region) { return 0xff; }
+
+bool page_free_zeroed(MemoryRegion *region, uintptr_t page) { return false; }
+
+bool page_zero_pool_full(MemoryRegion *region) { return true; }
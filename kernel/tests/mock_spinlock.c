@@ -13,27 +13,48 @@
 static uint32_t init_count;
 static uint32_t lock_count;
 static uint32_t unlock_count;
+static bool try_lock_fails;
+static SpinLock *last_locked;
 
 void mock_spinlock_reset() {
     init_count = 0;
     lock_count = 0;
     unlock_count = 0;
+    try_lock_fails = false;
+    last_locked = 0;
 }
 
+void mock_spinlock_set_try_lock_fails(bool fails) { try_lock_fails = fails; }
+
 bool mock_spinlock_is_locked(void) { return lock_count > unlock_count; }
 
 uint32_t mock_spinlock_get_lock_count() { return lock_count; }
 
 uint32_t mock_spinlock_get_unlock_count() { return unlock_count; }
 
+SpinLock *mock_spinlock_get_last_locked(void) { return last_locked; }
+
 void spinlock_init(SpinLock *lock) { init_count++; }
 
-void spinlock_lock(SpinLock *lock) { ++lock_count; }
+void spinlock_lock(SpinLock *lock) {
+    ++lock_count;
+    last_locked = lock;
+}
 
 void spinlock_unlock(SpinLock *lock) { ++unlock_count; }
 
+bool spinlock_try_lock(SpinLock *lock) {
+    if (try_lock_fails) {
+        return false;
+    }
+
+    ++lock_count;
+    return true;
+}
+
 uint64_t spinlock_lock_irqsave(SpinLock *lock) {
     ++lock_count;
+    last_locked = lock;
     return 1234;
 }
 
@@ -10,6 +10,7 @@
 #include <stdlib.h>
 
 #include "mock_pagetables.h"
+#include "mock_vmm.h"
 #include "vmm/vmmapper.h"
 
 static uint32_t total_page_maps = 0;
@@ -23,11 +24,16 @@ static uint64_t last_page_map_pml4 = 0;
 static uintptr_t last_page_unmap_pml4 = 0;
 static uintptr_t last_page_unmap_virt = 0;
 
+static MockVirtToPhys virt_to_phys_page = NULL;
+
 void mock_vmm_reset() {
     total_page_maps = 0;
     total_page_unmaps = 0;
+    virt_to_phys_page = NULL;
 }
 
+void mock_vmm_set_virt_to_phys_page(const MockVirtToPhys func) { virt_to_phys_page = func; }
+
 uint64_t mock_vmm_get_last_page_map_paddr() { return last_page_map_paddr; }
 
 uint64_t mock_vmm_get_last_page_map_vaddr() { return last_page_map_vaddr; }
@@ -59,6 +65,14 @@ bool vmm_map_page(const uintptr_t virt_addr, const uint64_t page, const uint16_t
     return vmm_map_page_in((uint64_t *)vmm_find_pml4(), virt_addr, page, flags);
 }
 
+bool vmm_map_pages(const uintptr_t virt_addr, const uint64_t page, const uint16_t flags, const size_t num_pages) {
+    for (size_t i = 0; i < num_pages; i++) {
+        vmm_map_page(virt_addr + i * VM_PAGE_SIZE, page + i * VM_PAGE_SIZE, flags);
+    }
+
+    return true;
+}
+
 uintptr_t vmm_unmap_page_in(uint64_t *pml4, const uintptr_t virt_addr) {
     last_page_unmap_pml4 = (uintptr_t)pml4;
     last_page_unmap_virt = virt_addr;
@@ -76,6 +90,16 @@ uintptr_t vmm_unmap_page(const uintptr_t virt_addr) {
     return vmm_unmap_page_in((uint64_t *)vmm_find_pml4(), virt_addr);
 }
 
+uintptr_t vmm_unmap_pages(const uintptr_t virt_addr, const size_t num_pages) {
+    uintptr_t result = 0;
+
+    for (size_t i = 0; i < num_pages; i++) {
+        result = vmm_unmap_page(virt_addr + i * VM_PAGE_SIZE);
+    }
+
+    return result;
+}
+
 PageTable *vmm_find_pml4() { return &complete_pml4; }
 
 uint64_t *vmm_virt_to_pte(uintptr_t virt_addr) {
@@ -120,7 +144,7 @@ uint16_t vmm_virt_to_pd_index(uintptr_t virt_addr) { return 0; }
 
 uint16_t vmm_virt_to_pt_index(uintptr_t virt_addr) { return 0; }
 
-uintptr_t vmm_virt_to_phys_page(uintptr_t virt_addr) { return 0; }
+uintptr_t vmm_virt_to_phys_page(uintptr_t virt_addr) { return virt_to_phys_page ? virt_to_phys_page(virt_addr) : 0; }
 
 uintptr_t vmm_virt_to_phys(uintptr_t virt_addr) { return 0; }
 
@@ -130,6 +154,6 @@ uintptr_t vmm_phys_to_virt(const uintptr_t phys_addr) { return (uintptr_t)scratc
 
 static uint8_t scratch_stack[8][4096];
 
-uintptr_t vmm_per_cpu_temp_page_addr(const uint8_t cpu) { return (uintptr_t)scratch_stack[cpu]; }
+uintptr_t vmm_per_cpu_temp_page_addr(const uint16_t cpu) { return (uintptr_t)scratch_stack[cpu]; }
 
 uintptr_t vmm_get_pagetable_root_phys() { return 0x1234; }
@@ -0,0 +1,374 @@
+/*
+ * Tests for the minimal FDT reader
+ * anos - An Operating System
+ *
+ * Copyright (c) 2025 Ross Bamford
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+#include "munit.h"
+
+#include "platform/fdt/fdt.h"
+
+#define BLOB_SIZE 1024
+#define STRUCT_OFFSET ((sizeof(FDT_Header) + 7) & ~7)
+
+static uint8_t blob[BLOB_SIZE] __attribute__((aligned(8)));
+static char strings[256];
+static uint32_t blob_pos;
+static uint32_t strings_pos;
+
+static void put_be32(uint8_t *ptr, const uint32_t val) {
+    ptr[0] = val >> 24;
+    ptr[1] = val >> 16;
+    ptr[2] = val >> 8;
+    ptr[3] = val;
+}
+
+static void emit_cell(const uint32_t val) {
+    put_be32(blob + blob_pos, val);
+    blob_pos += 4;
+}
+
+static void emit_bytes(const void *data, const uint32_t len) {
+    memcpy(blob + blob_pos, data, len);
+    blob_pos = (blob_pos + len + 3) & ~3U;
+}
+
+static void begin_node(const char *name) {
+    emit_cell(FDT_BEGIN_NODE);
+    emit_bytes(name, strlen(name) + 1);
+}
+
+static void end_node(void) { emit_cell(FDT_END_NODE); }
+
+static void prop(const char *name, const void *value, const uint32_t len) {
+    emit_cell(FDT_PROP);
+    emit_cell(len);
+    emit_cell(strings_pos);
+    emit_bytes(value, len);
+
+    strcpy(strings + strings_pos, name);
+    strings_pos += strlen(name) + 1;
+}
+
+static void prop_u32(const char *name, const uint32_t val) {
+    uint8_t cell[4];
+    put_be32(cell, val);
+    prop(name, cell, 4);
+}
+
+static void prop_u64(const char *name, const uint64_t val) {
+    uint8_t cells[8];
+    put_be32(cells, val >> 32);
+    put_be32(cells + 4, val);
+    prop(name, cells, 8);
+}
+
+static void finish_blob(void) {
+    emit_cell(FDT_END);
+
+    const uint32_t strings_offset = blob_pos;
+    memcpy(blob + strings_offset, strings, strings_pos);
+
+    FDT_Header *header = (FDT_Header *)blob;
+    put_be32((uint8_t *)&header->magic, FDT_MAGIC);
+    put_be32((uint8_t *)&header->totalsize, strings_offset + strings_pos);
+    put_be32((uint8_t *)&header->off_dt_struct, STRUCT_OFFSET);
+    put_be32((uint8_t *)&header->off_dt_strings, strings_offset);
+    put_be32((uint8_t *)&header->version, 17);
+    put_be32((uint8_t *)&header->last_comp_version, 16);
+    put_be32((uint8_t *)&header->size_dt_strings, strings_pos);
+    put_be32((uint8_t *)&header->size_dt_struct, strings_offset - STRUCT_OFFSET);
+}
+
+static void *test_setup(const MunitParameter params[], void *user_data) {
+    memset(blob, 0, BLOB_SIZE);
+    memset(strings, 0, sizeof(strings));
+    blob_pos = STRUCT_OFFSET;
+    strings_pos = 0;
+
+    begin_node("");
+    prop("model", "anos,test", 10);
+    emit_cell(FDT_NOP);
+
+    begin_node("memory@80000000");
+    prop_u64("reg", 0x80000000);
+    end_node();
+
+    begin_node("cpus");
+    prop_u32("#address-cells", 1);
+    prop_u32("timebase-frequency", 10000000);
+
+    begin_node("cpu@0");
+    prop_u32("reg", 0);
+    prop_u64("clock-frequency", 0x123456789);
+    end_node();
+
+    end_node();
+
+    begin_node("soc");
+    prop("timebase-frequency", "abc", 3);
+    end_node();
+
+    end_node();
+    finish_blob();
+
+    return NULL;
+}
+
+static MunitResult test_find_null(const MunitParameter params[], void *param) {
+    munit_assert_null(fdt_find_property(NULL, "/cpus", "timebase-frequency", NULL));
+    munit_assert_null(fdt_find_property(blob, NULL, "timebase-frequency", NULL));
+    munit_assert_null(fdt_find_property(blob, "/cpus", NULL, NULL));
+
+    return MUNIT_OK;
+}
+
+static MunitResult test_find_bad_magic(const MunitParameter params[], void *param) {
+    blob[0] = 0;
+
+    munit_assert_null(fdt_find_property(blob, "/cpus", "timebase-frequency", NULL));
+
+    return MUNIT_OK;
+}
+
+static MunitResult test_find_relative_path(const MunitParameter params[], void *param) {
+    munit_assert_null(fdt_find_property(blob, "cpus", "timebase-frequency", NULL));
+
+    return MUNIT_OK;
+}
+
+static MunitResult test_find_root_prop(const MunitParameter params[], void *param) {
+    uint32_t len = 0;
+    const char *model = fdt_find_property(blob, "/", "model", &len);
+
+    munit_assert_not_null(model);
+    munit_assert_uint32(len, ==, 10);
+    munit_assert_string_equal(model, "anos,test");
+
+    return MUNIT_OK;
+}
+
+static MunitResult test_find_missing_prop(const MunitParameter params[], void *param) {
+    munit_assert_null(fdt_find_property(blob, "/cpus", "nonexistent", NULL));
+
+    return MUNIT_OK;
+}
+
+static MunitResult test_find_missing_node(const MunitParameter params[], void *param) {
+    munit_assert_null(fdt_find_property(blob, "/nonexistent", "reg", NULL));
+    munit_assert_null(fdt_find_property(blob, "/cpus/nonexistent", "reg", NULL));
+
+    return MUNIT_OK;
+}
+
+static MunitResult test_find_not_in_child(const MunitParameter params[], void *param) {
+    // cpu@0 has clock-frequency, but cpus doesn't
+    munit_assert_null(fdt_find_property(blob, "/cpus", "clock-frequency", NULL));
+
+    return MUNIT_OK;
+}
+
+static MunitResult test_find_not_in_parent(const MunitParameter params[], void *param) {
+    // cpus has timebase-frequency, but cpu@0 doesn't
+    munit_assert_null(fdt_find_property(blob, "/cpus/cpu@0", "timebase-frequency", NULL));
+
+    return MUNIT_OK;
+}
+
+static MunitResult test_find_prefix_name(const MunitParameter params[], void *param) {
+    munit_assert_null(fdt_find_property(blob, "/cpu", "timebase-frequency", NULL));
+    munit_assert_null(fdt_find_property(blob, "/cpus", "timebase", NULL));
+
+    return MUNIT_OK;
+}
+
+static MunitResult test_find_unit_address(const MunitParameter params[], void *param) {
+    munit_assert_not_null(fdt_find_property(blob, "/cpus/cpu", "reg", NULL));
+    munit_assert_not_null(fdt_find_property(blob, "/cpus/cpu@0", "reg", NULL));
+    munit_assert_null(fdt_find_property(blob, "/cpus/cpu@1", "reg", NULL));
+
+    return MUNIT_OK;
+}
+
+static MunitResult test_read_u64_one_cell(const MunitParameter params[], void *param) {
+    uint64_t value = 0;
+
+    munit_assert_true(fdt_read_u64(blob, "/cpus", "timebase-frequency", &value));
+    munit_assert_uint64(value, ==, 10000000);
+
+    return MUNIT_OK;
+}
+
+static MunitResult test_read_u64_two_cells(const MunitParameter params[], void *param) {
+    uint64_t value = 0;
+
+    munit_assert_true(fdt_read_u64(blob, "/cpus/cpu@0", "clock-frequency", &value));
+    munit_assert_uint64(value, ==, 0x123456789);
+
+    munit_assert_true(fdt_read_u64(blob, "/memory", "reg", &value));
+    munit_assert_uint64(value, ==, 0x80000000);
+
+    return MUNIT_OK;
+}
+
+static MunitResult test_read_u64_bad_size(const MunitParameter params[], void *param) {
+    uint64_t value = 42;
+
+    munit_assert_false(fdt_read_u64(blob, "/soc", "timebase-frequency", &value));
+    munit_assert_uint64(value, ==, 42);
+
+    return MUNIT_OK;
+}
+
+static MunitResult test_read_u64_missing(const MunitParameter params[], void *param) {
+    uint64_t value = 42;
+
+    munit_assert_false(fdt_read_u64(blob, "/cpus", "nonexistent", &value));
+    munit_assert_uint64(value, ==, 42);
+
+    return MUNIT_OK;
+}
+
+static MunitResult test_truncated(const MunitParameter params[], void *param) {
+    FDT_Header *header = (FDT_Header *)blob;
+    put_be32((uint8_t *)&header->totalsize, STRUCT_OFFSET + 12);
+
+    munit_assert_null(fdt_find_property(blob, "/", "model", NULL));
+
+    return MUNIT_OK;
+}
+
+static MunitTest test_suite_tests[] = {
+        {
+                (char *)"/fdt/find_null",
+                test_find_null,
+                test_setup,
+                NULL,
+                MUNIT_TEST_OPTION_NONE,
+                NULL,
+        },
+        {
+                (char *)"/fdt/find_bad_magic",
+                test_find_bad_magic,
+                test_setup,
+                NULL,
+                MUNIT_TEST_OPTION_NONE,
+                NULL,
+        },
+        {
+                (char *)"/fdt/find_relative_path",
+                test_find_relative_path,
+                test_setup,
+                NULL,
+                MUNIT_TEST_OPTION_NONE,
+                NULL,
+        },
+        {
+                (char *)"/fdt/find_root_prop",
+                test_find_root_prop,
+                test_setup,
+                NULL,
+                MUNIT_TEST_OPTION_NONE,
+                NULL,
+        },
+        {
+                (char *)"/fdt/find_missing_prop",
+                test_find_missing_prop,
+                test_setup,
+                NULL,
+                MUNIT_TEST_OPTION_NONE,
+                NULL,
+        },
+        {
+                (char *)"/fdt/find_missing_node",
+                test_find_missing_node,
+                test_setup,
+                NULL,
+                MUNIT_TEST_OPTION_NONE,
+                NULL,
+        },
+        {
+                (char *)"/fdt/find_not_in_child",
+                test_find_not_in_child,
+                test_setup,
+                NULL,
+                MUNIT_TEST_OPTION_NONE,
+                NULL,
+        },
+        {
+                (char *)"/fdt/find_not_in_parent",
+                test_find_not_in_parent,
+                test_setup,
+                NULL,
+                MUNIT_TEST_OPTION_NONE,
+                NULL,
+        },
+        {
+                (char *)"/fdt/find_prefix_name",
+                test_find_prefix_name,
+                test_setup,
+                NULL,
+                MUNIT_TEST_OPTION_NONE,
+                NULL,
+        },
+        {
+                (char *)"/fdt/find_unit_address",
+                test_find_unit_address,
+                test_setup,
+                NULL,
+                MUNIT_TEST_OPTION_NONE,
+                NULL,
+        },
+        {
+                (char *)"/fdt/read_u64_one_cell",
+                test_read_u64_one_cell,
+                test_setup,
+                NULL,
+                MUNIT_TEST_OPTION_NONE,
+                NULL,
+        },
+        {
+                (char *)"/fdt/read_u64_two_cells",
+                test_read_u64_two_cells,
+                test_setup,
+                NULL,
+                MUNIT_TEST_OPTION_NONE,
+                NULL,
+        },
+        {
+                (char *)"/fdt/read_u64_bad_size",
+                test_read_u64_bad_size,
+                test_setup,
+                NULL,
+                MUNIT_TEST_OPTION_NONE,
+                NULL,
+        },
+        {
+                (char *)"/fdt/read_u64_missing",
+                test_read_u64_missing,
+                test_setup,
+                NULL,
+                MUNIT_TEST_OPTION_NONE,
+                NULL,
+        },
+        {
+                (char *)"/fdt/truncated",
+                test_truncated,
+                test_setup,
+                NULL,
+                MUNIT_TEST_OPTION_NONE,
+                NULL,
+        },
+
+        {NULL, NULL, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL},
+};
+
+static const MunitSuite test_suite = {(char *)"", test_suite_tests, NULL, 1, MUNIT_SUITE_OPTION_NONE};
+
+int main(int argc, char *argv[MUNIT_ARRAY_PARAM(argc + 1)]) {
+    return munit_suite_main(&test_suite, (void *)"µnit", argc, argv);
+}
@@ -0,0 +1,259 @@
+/*
+ * Tests for the buddy allocator
+ * anos - An Operating System
+ *
+ * Copyright (c) 2025 Ross Bamford
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "munit.h"
+#include "pmm/buddy.h"
+
+#define BLOCK_4M ((0x400000ULL))
+#define BASE ((0x40000000ULL))
+
+static BuddyAllocator buddy;
+static void *metadata;
+
+static void init_buddy(const uintptr_t start, const uintptr_t end) {
+    metadata = calloc(1, buddy_metadata_size(start, end));
+    buddy_init(&buddy, start, end, metadata);
+}
+
+static void *setup(const MunitParameter params[], void *user_data) {
+    metadata = NULL;
+    return NULL;
+}
+
+static void teardown(void *param) { free(metadata); }
+
+static MunitResult test_metadata_size(const MunitParameter params[], void *param) {
+    // One max-size block: 16 + 8 + 4 + 2 + 7 bitmap words, plus a summary word per order
+    const size_t one_block = buddy_metadata_size(BASE, BASE + BLOCK_4M);
+    munit_assert_size(one_block, ==, 48 * sizeof(uint64_t));
+
+    // Anything inside the same block is the same size
+    munit_assert_size(buddy_metadata_size(BASE + 0x1000, BASE + 0x2000), ==, one_block);
+
+    // Roughly two bits per page once it's bigger
+    const size_t one_gig = buddy_metadata_size(BASE, BASE + 0x40000000);
+    munit_assert_size(one_gig, >=, 0x10000);
+    munit_assert_size(one_gig, <, 0x12000);
+
+    return MUNIT_OK;
+}
+
+static MunitResult test_order_for(const MunitParameter params[], void *param) {
+    munit_assert_uint8(buddy_order_for(1), ==, 0);
+    munit_assert_uint8(buddy_order_for(2), ==, 1);
+    munit_assert_uint8(buddy_order_for(3), ==, 2);
+    munit_assert_uint8(buddy_order_for(512), ==, 9);
+    munit_assert_uint8(buddy_order_for(513), ==, 10);
+
+    return MUNIT_OK;
+}
+
+static MunitResult test_init_all_allocated(const MunitParameter params[], void *param) {
+    init_buddy(BASE, BASE + BLOCK_4M);
+
+    munit_assert_uint64(buddy.base, ==, BASE);
+    munit_assert_uint64(buddy.span_pages, ==, 1024);
+    munit_assert_uint64(buddy_alloc(&buddy, 0) & 0xFF, ==, 0xFF);
+
+    return MUNIT_OK;
+}
+
+static MunitResult test_free_range_aligned(const MunitParameter params[], void *param) {
+    init_buddy(BASE, BASE + BLOCK_4M);
+    buddy_free_range(&buddy, BASE, 1024);
+
+    // One big block
+    munit_assert_uint64(buddy.free_blocks[BUDDY_MAX_ORDER], ==, 1);
+
+    for (int i = 0; i < BUDDY_MAX_ORDER; i++) {
+        munit_assert_uint64(buddy.free_blocks[i], ==, 0);
+    }
+
+    return MUNIT_OK;
+}
+
+static MunitResult test_free_range_unaligned(const MunitParameter params[], void *param) {
+    init_buddy(BASE, BASE + BLOCK_4M);
+
+    // Pages 1 - 6: 1, 2-3, 4-5, 6
+    buddy_free_range(&buddy, BASE + 0x1000, 6);
+
+    munit_assert_uint64(buddy.free_blocks[0], ==, 2);
+    munit_assert_uint64(buddy.free_blocks[1], ==, 2);
+    munit_assert_uint64(buddy.free_blocks[2], ==, 0);
+
+    // Fill the gaps, and it all comes together
+    buddy_free_range(&buddy, BASE, 1);
+    buddy_free_range(&buddy, BASE + 0x7000, 1);
+
+    munit_assert_uint64(buddy.free_blocks[0], ==, 0);
+    munit_assert_uint64(buddy.free_blocks[1], ==, 0);
+    munit_assert_uint64(buddy.free_blocks[3], ==, 1);
+
+    return MUNIT_OK;
+}
+
+static MunitResult test_alloc_pages(const MunitParameter params[], void *param) {
+    init_buddy(BASE, BASE + BLOCK_4M);
+    buddy_free_range(&buddy, BASE, 4);
+
+    uintptr_t pages[4];
+
+    for (int i = 0; i < 4; i++) {
+        pages[i] = buddy_alloc(&buddy, 0);
+        munit_assert_uint64(pages[i] & 0xFFF, ==, 0);
+        munit_assert_uint64(pages[i], >=, BASE);
+        munit_assert_uint64(pages[i], <, BASE + 0x4000);
+
+        for (int j = 0; j < i; j++) {
+            munit_assert_uint64(pages[i], !=, pages[j]);
+        }
+    }
+
+    munit_assert_uint64(buddy_alloc(&buddy, 0) & 0xFF, ==, 0xFF);
+
+    return MUNIT_OK;
+}
+
+static MunitResult test_alloc_aligned(const MunitParameter params[], void *param) {
+    init_buddy(BASE, BASE + 2 * BLOCK_4M);
+    buddy_free_range(&buddy, BASE, 2048);
+
+    // Knock a page out first, so the bigger ones have to be split off elsewhere
+    munit_assert_uint64(buddy_alloc(&buddy, 0), ==, BASE);
+
+    for (uint8_t order = 1; order <= BUDDY_MAX_ORDER; order++) {
+        const uintptr_t block = buddy_alloc(&buddy, order);
+
+        if (order == BUDDY_MAX_ORDER) {
+            munit_assert_uint64(block, ==, BASE + BLOCK_4M);
+        } else {
+            munit_assert_uint64(block & 0xFFF, ==, 0);
+            munit_assert_uint64(block & ((0x1000ULL << order) - 1), ==, 0);
+        }
+    }
+
+    // Too big
+    munit_assert_uint64(buddy_alloc(&buddy, BUDDY_MAX_ORDER + 1) & 0xFF, ==, 0xFF);
+
+    return MUNIT_OK;
+}
+
+static MunitResult test_free_coalesces(const MunitParameter params[], void *param) {
+    init_buddy(BASE, BASE + BLOCK_4M);
+    buddy_free_range(&buddy, BASE, 1024);
+
+    // Take it all as single pages...
+    for (int i = 0; i < 1024; i++) {
+        munit_assert_uint64(buddy_alloc(&buddy, 0) & 0xFFF, ==, 0);
+    }
+
+    munit_assert_uint64(buddy_alloc(&buddy, 0) & 0xFF, ==, 0xFF);
+
+    // ... and give it back in a different order
+    for (int i = 1023; i >= 0; i -= 2) {
+        buddy_free(&buddy, BASE + i * 0x1000, 0);
+    }
+
+    for (int i = 0; i < 1024; i += 2) {
+        buddy_free(&buddy, BASE + i * 0x1000, 0);
+    }
+
+    munit_assert_uint64(buddy.free_blocks[BUDDY_MAX_ORDER], ==, 1);
+    munit_assert_uint64(buddy_alloc(&buddy, BUDDY_MAX_ORDER), ==, BASE);
+
+    return MUNIT_OK;
+}
+
+static MunitResult test_free_part_of_block(const MunitParameter params[], void *param) {
+    init_buddy(BASE, BASE + BLOCK_4M);
+    buddy_free_range(&buddy, BASE, 1024);
+
+    const uintptr_t block = buddy_alloc(&buddy, 4);
+
+    // Pages of a bigger block can go back one at a time
+    for (int i = 0; i < 16; i++) {
+        buddy_free(&buddy, block + i * 0x1000, 0);
+    }
+
+    munit_assert_uint64(buddy.free_blocks[BUDDY_MAX_ORDER], ==, 1);
+
+    return MUNIT_OK;
+}
+
+static MunitResult test_fragmented(const MunitParameter params[], void *param) {
+    init_buddy(BASE, BASE + BLOCK_4M);
+
+    // Every other page free - plenty of pages, but no pairs
+    for (int i = 0; i < 1024; i += 2) {
+        buddy_free(&buddy, BASE + i * 0x1000, 0);
+    }
+
+    munit_assert_uint64(buddy_alloc(&buddy, 1) & 0xFF, ==, 0xFF);
+    munit_assert_uint64(buddy_alloc(&buddy, 0) & 0xFFF, ==, 0);
+
+    return MUNIT_OK;
+}
+
+static MunitResult test_free_out_of_range(const MunitParameter params[], void *param) {
+    init_buddy(BASE, BASE + BLOCK_4M);
+
+    buddy_free(&buddy, BASE - 0x1000, 0);
+    buddy_free(&buddy, BASE + BLOCK_4M, 0);
+
+    for (int i = 0; i < BUDDY_ORDER_COUNT; i++) {
+        munit_assert_uint64(buddy.free_blocks[i], ==, 0);
+    }
+
+    return MUNIT_OK;
+}
+
+static MunitResult test_reuse_after_free(const MunitParameter params[], void *param) {
+    init_buddy(BASE, BASE + 4 * BLOCK_4M);
+    buddy_free_range(&buddy, BASE, 4096);
+
+    // Drain the low blocks, then free one near the bottom - it should be found again
+    uintptr_t first = 0;
+
+    for (int i = 0; i < 3; i++) {
+        const uintptr_t block = buddy_alloc(&buddy, BUDDY_MAX_ORDER);
+        first = first ? first : block;
+    }
+
+    buddy_free(&buddy, first, BUDDY_MAX_ORDER);
+
+    munit_assert_uint64(buddy_alloc(&buddy, BUDDY_MAX_ORDER), ==, first);
+    munit_assert_uint64(buddy_alloc(&buddy, BUDDY_MAX_ORDER) & 0xFFF, ==, 0);
+    munit_assert_uint64(buddy_alloc(&buddy, BUDDY_MAX_ORDER) & 0xFF, ==, 0xFF);
+
+    return MUNIT_OK;
+}
+
+static MunitTest test_suite_tests[] = {
+        {(char *)"/metadata_size", test_metadata_size, setup, teardown, MUNIT_TEST_OPTION_NONE, NULL},
+        {(char *)"/order_for", test_order_for, setup, teardown, MUNIT_TEST_OPTION_NONE, NULL},
+        {(char *)"/init_all_allocated", test_init_all_allocated, setup, teardown, MUNIT_TEST_OPTION_NONE, NULL},
+        {(char *)"/free_range_aligned", test_free_range_aligned, setup, teardown, MUNIT_TEST_OPTION_NONE, NULL},
+        {(char *)"/free_range_unaligned", test_free_range_unaligned, setup, teardown, MUNIT_TEST_OPTION_NONE, NULL},
+        {(char *)"/alloc_pages", test_alloc_pages, setup, teardown, MUNIT_TEST_OPTION_NONE, NULL},
+        {(char *)"/alloc_aligned", test_alloc_aligned, setup, teardown, MUNIT_TEST_OPTION_NONE, NULL},
+        {(char *)"/free_coalesces", test_free_coalesces, setup, teardown, MUNIT_TEST_OPTION_NONE, NULL},
+        {(char *)"/free_part_of_block", test_free_part_of_block, setup, teardown, MUNIT_TEST_OPTION_NONE, NULL},
+        {(char *)"/fragmented", test_fragmented, setup, teardown, MUNIT_TEST_OPTION_NONE, NULL},
+        {(char *)"/free_out_of_range", test_free_out_of_range, setup, teardown, MUNIT_TEST_OPTION_NONE, NULL},
+        {(char *)"/reuse_after_free", test_reuse_after_free, setup, teardown, MUNIT_TEST_OPTION_NONE, NULL},
+        {NULL, NULL, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL},
+};
+
+static const MunitSuite test_suite = {(char *)"/pmm/buddy", test_suite_tests, NULL, 1, MUNIT_SUITE_OPTION_NONE};
+
+int main(int argc, char *argv[MUNIT_ARRAY_PARAM(argc + 1)]) {
+    return munit_suite_main(&test_suite, (void *)"µnit", argc, argv);
+}
@@ -5,9 +5,13 @@
  * Copyright (c) 2023 Ross Bamford
  */
 
+#include <string.h>
+
 #include "pmm/pagealloc.h"
 #include "munit.h"
 
+#include "smp/state.h"
+
 static void *region_buffer;
 
 static Limine_MemMap *create_mem_map(int num_entries) {
@@ -686,7 +690,7 @@ static MunitResult test_alloc_page_m_not_top_split(const MunitParameter params[]
     munit_assert_uint64(region->sp->size, ==, 0x1);
 
     // Alloc came from second entry, and split the remainder so one left
-    munit_assert_uint64((region->sp - 1)->base, ==, 0x9000);
+    munit_assert_uint64((region->sp - 1)->base, ==, 0xa000);
     munit_assert_uint64((region->sp - 1)->size, ==, 0x1);
 
     // Third entry is still at 0, still one page
@@ -940,8 +944,399 @@ static MunitResult test_free_contig_pages_backward(const MunitParameter params[]
     return MUNIT_OK;
 }
 
+static MunitResult test_alloc_batch(const MunitParameter params[], void *param) {
+    Limine_MemMapEntry entry0 = {
+            .type = LIMINE_MEMMAP_USABLE, .base = 0x0000000000000000, .length = 0x0000000000002000};
+    Limine_MemMap *map = create_mem_map(1);
+    map->entries[0] = &entry0;
+
+    MemoryRegion *region = page_alloc_init_limine(map, 0, region_buffer, false);
+    uintptr_t pages[3] = {0};
+
+    // Only gets what there is
+    munit_assert_uint64(page_alloc_batch(region, pages, 3), ==, 2);
+    munit_assert_uint64(pages[0], ==, 0);
+    munit_assert_uint64(pages[1], ==, 0x1000);
+    munit_assert_uint64(pages[2], ==, 0);
+
+    munit_assert_uint64(region->free, ==, 0);
+    munit_assert_ptr_equal(region->sp, stack_base(region));
+
+    // And nothing once it's gone
+    munit_assert_uint64(page_alloc_batch(region, pages, 3), ==, 0);
+
+    free_mem_map(map);
+    return MUNIT_OK;
+}
+
+static MemoryRegion *init_cached_region(Limine_MemMap *map, Limine_MemMapEntry *entry, uint64_t pages) {
+    entry->type = LIMINE_MEMMAP_USABLE;
+    entry->base = 0x100000;
+    entry->length = pages << 12;
+    map->entries[0] = entry;
+
+    MemoryRegion *region = page_alloc_init_limine(map, 0, region_buffer, false);
+    page_alloc_notify_smp_started(region);
+
+    return region;
+}
+
+static MunitResult test_cache_alloc_refill(const MunitParameter params[], void *param) {
+    Limine_MemMapEntry entry0;
+    Limine_MemMap *map = create_mem_map(1);
+    MemoryRegion *region = init_cached_region(map, &entry0, 0x100);
+    PerCPUPageCache *cache = &__test_cpu_state[0].page_cache;
+
+    // First one misses, and takes a batch from the region
+    uint64_t page = page_alloc(region);
+    munit_assert_uint64(page & 0xFFF, ==, 0);
+    munit_assert_uint64(cache->alloc_misses, ==, 1);
+    munit_assert_uint64(cache->alloc_hits, ==, 0);
+    munit_assert_uint64(cache->count, ==, PMM_CPU_CACHE_BATCH - 1);
+    munit_assert_uint64(region->free, ==, (0x100 - PMM_CPU_CACHE_BATCH) << 12);
+    munit_assert_uint64(page_alloc_free_bytes(region), ==, 0xff << 12);
+
+    // Next comes straight from the cache
+    uint64_t page2 = page_alloc(region);
+    munit_assert_uint64(page2 & 0xFFF, ==, 0);
+    munit_assert_uint64(page2, !=, page);
+    munit_assert_uint64(cache->alloc_hits, ==, 1);
+    munit_assert_uint64(cache->count, ==, PMM_CPU_CACHE_BATCH - 2);
+    munit_assert_uint64(page_alloc_free_bytes(region), ==, 0xfe << 12);
+
+    free_mem_map(map);
+    return MUNIT_OK;
+}
+
+static MunitResult test_cache_alloc_exhausted(const MunitParameter params[], void *param) {
+    Limine_MemMapEntry entry0;
+    Limine_MemMap *map = create_mem_map(1);
+    MemoryRegion *region = init_cached_region(map, &entry0, 4);
+    PerCPUPageCache *cache = &__test_cpu_state[0].page_cache;
+
+    // Refill takes what there is...
+    for (int i = 0; i < 4; i++) {
+        munit_assert_uint64(page_alloc(region) & 0xFFF, ==, 0);
+    }
+
+    munit_assert_uint64(cache->alloc_misses, ==, 1);
+
+    // ... and fails once it's all gone
+    munit_assert_uint64(page_alloc(region) & 0xFF, ==, 0xFF);
+    munit_assert_uint64(cache->alloc_misses, ==, 2);
+    munit_assert_uint64(page_alloc_free_bytes(region), ==, 0);
+
+    free_mem_map(map);
+    return MUNIT_OK;
+}
+
+static MunitResult test_cache_free_drain(const MunitParameter params[], void *param) {
+    Limine_MemMapEntry entry0;
+    Limine_MemMap *map = create_mem_map(1);
+    MemoryRegion *region = init_cached_region(map, &entry0, 0x80);
+    PerCPUPageCache *cache = &__test_cpu_state[0].page_cache;
+    uintptr_t pages[PMM_CPU_CACHE_SIZE + 1];
+
+    for (int i = 0; i < PMM_CPU_CACHE_SIZE + 1; i++) {
+        pages[i] = page_alloc(region);
+        munit_assert_uint64(pages[i] & 0xFFF, ==, 0);
+    }
+
+    // As many batches as it took to get there
+    const uint64_t batches = (PMM_CPU_CACHE_SIZE + PMM_CPU_CACHE_BATCH) / PMM_CPU_CACHE_BATCH;
+    munit_assert_uint64(cache->alloc_misses, ==, batches);
+    munit_assert_uint64(cache->count, ==, batches * PMM_CPU_CACHE_BATCH - PMM_CPU_CACHE_SIZE - 1);
+
+    for (int i = 0; i < PMM_CPU_CACHE_SIZE + 1; i++) {
+        page_free(region, pages[i]);
+    }
+
+    // Filled up once along the way, and gave a batch back
+    const uint64_t cached = batches * PMM_CPU_CACHE_BATCH - PMM_CPU_CACHE_BATCH;
+    munit_assert_uint64(cache->free_misses, ==, 1);
+    munit_assert_uint64(cache->free_hits, ==, PMM_CPU_CACHE_SIZE);
+    munit_assert_uint64(cache->count, ==, cached);
+    munit_assert_uint64(region->free, ==, (0x80 - cached) << 12);
+    munit_assert_uint64(page_alloc_free_bytes(region), ==, 0x80 << 12);
+
+    // Unaligned still ignored
+    page_free(region, 0x1234);
+    munit_assert_uint64(cache->count, ==, cached);
+    munit_assert_uint64(cache->free_misses, ==, 1);
+
+    free_mem_map(map);
+    return MUNIT_OK;
+}
+
+static MunitResult test_cache_alloc_batch(const MunitParameter params[], void *param) {
+    Limine_MemMapEntry entry0;
+    Limine_MemMap *map = create_mem_map(1);
+    MemoryRegion *region = init_cached_region(map, &entry0, 0x100);
+    PerCPUPageCache *cache = &__test_cpu_state[0].page_cache;
+    uintptr_t pages[PMM_CPU_CACHE_BATCH + 8];
+
+    // Fill the cache with a batch, less the one we take
+    page_alloc(region);
+
+    // The cache covers what it can, the region the rest
+    munit_assert_uint64(page_alloc_batch(region, pages, PMM_CPU_CACHE_BATCH + 8), ==, PMM_CPU_CACHE_BATCH + 8);
+    munit_assert_uint64(cache->count, ==, 0);
+    munit_assert_uint64(cache->alloc_hits, ==, PMM_CPU_CACHE_BATCH - 1);
+    munit_assert_uint64(cache->alloc_misses, ==, 2);
+    munit_assert_uint64(page_alloc_free_bytes(region), ==, (0x100 - PMM_CPU_CACHE_BATCH - 9) << 12);
+
+    for (int i = 0; i < PMM_CPU_CACHE_BATCH + 8; i++) {
+        munit_assert_uint64(pages[i] & 0xFFF, ==, 0);
+
+        for (int j = 0; j < i; j++) {
+            munit_assert_uint64(pages[i], !=, pages[j]);
+        }
+    }
+
+    // Straight from the cache doesn't count as a miss
+    page_free(region, pages[0]);
+    page_free(region, pages[1]);
+    munit_assert_uint64(page_alloc_batch(region, pages, 2), ==, 2);
+    munit_assert_uint64(cache->alloc_misses, ==, 2);
+
+    free_mem_map(map);
+    return MUNIT_OK;
+}
+
+static MunitResult test_cache_steal(const MunitParameter params[], void *param) {
+    Limine_MemMapEntry entry0;
+    Limine_MemMap *map = create_mem_map(1);
+    MemoryRegion *region = init_cached_region(map, &entry0, 4);
+    PerCPUPageCache *other = &__test_cpu_state[1].page_cache;
+
+    // Some other CPU takes the whole region into its cache, and frees one back there
+    __test_this_cpu = 1;
+    const uintptr_t page = page_alloc(region);
+    munit_assert_uint64(page & 0xFFF, ==, 0);
+    page_free(region, page);
+    __test_this_cpu = 0;
+
+    munit_assert_uint64(other->count, ==, 4);
+    munit_assert_uint64(region->free, ==, 0);
+
+    // ... but they don't get stranded there once we run out
+    for (int i = 0; i < 4; i++) {
+        munit_assert_uint64(page_alloc(region) & 0xFFF, ==, 0);
+    }
+
+    munit_assert_uint64(other->count, ==, 0);
+    munit_assert_uint64(page_alloc(region) & 0xFF, ==, 0xFF);
+
+    free_mem_map(map);
+    return MUNIT_OK;
+}
+
+static MunitResult test_cache_steal_before_zero_pool(const MunitParameter params[], void *param) {
+    Limine_MemMapEntry entry0;
+    Limine_MemMap *map = create_mem_map(1);
+    MemoryRegion *region = init_cached_region(map, &entry0, 8);
+
+    uintptr_t pages[8];
+    munit_assert_uint64(page_alloc_batch(region, pages, 8), ==, 8);
+
+    munit_assert_true(page_free_zeroed(region, pages[0]));
+
+    __test_this_cpu = 3;
+    page_free(region, pages[1]);
+    page_free(region, pages[2]);
+    __test_this_cpu = 0;
+
+    // Other caches' plain pages first, then the zeroed ones
+    uintptr_t got[4];
+    munit_assert_uint64(page_alloc_batch(region, got, 4), ==, 3);
+    munit_assert_uint64(got[0], ==, pages[2]);
+    munit_assert_uint64(got[1], ==, pages[1]);
+    munit_assert_uint64(got[2], ==, pages[0]);
+    munit_assert_uint64(page_alloc_free_bytes(region), ==, 0);
+
+    free_mem_map(map);
+    return MUNIT_OK;
+}
+
+static MunitResult test_zero_pool_before_smp(const MunitParameter params[], void *param) {
+    Limine_MemMapEntry entry0;
+    Limine_MemMap *map = create_mem_map(1);
+    entry0.type = LIMINE_MEMMAP_USABLE;
+    entry0.base = 0x100000;
+    entry0.length = 0x10000;
+    map->entries[0] = &entry0;
+
+    MemoryRegion *region = page_alloc_init_limine(map, 0, region_buffer, false);
+    uintptr_t page = page_alloc(region);
+
+    // No per-CPU state yet, so no pool - nothing to fill, nothing to take
+    munit_assert_true(page_zero_pool_full(region));
+    munit_assert_false(page_free_zeroed(region, page));
+    munit_assert_uint64(page_alloc_zeroed(region), ==, 0xFF);
+    munit_assert_uint64(__test_cpu_state[0].zero_pool.misses, ==, 0);
+
+    free_mem_map(map);
+    return MUNIT_OK;
+}
+
+static MunitResult test_zero_pool_fill_and_take(const MunitParameter params[], void *param) {
+    Limine_MemMapEntry entry0;
+    Limine_MemMap *map = create_mem_map(1);
+    MemoryRegion *region = init_cached_region(map, &entry0, 0x100);
+    PerCPUZeroPool *pool = &__test_cpu_state[0].zero_pool;
+
+    // Empty to start with - a miss
+    munit_assert_false(page_zero_pool_full(region));
+    munit_assert_uint64(page_alloc_zeroed(region), ==, 0xFF);
+    munit_assert_uint64(pool->misses, ==, 1);
+
+    // Fill it up (as the idle thread would)...
+    for (int i = 0; i < PMM_ZERO_POOL_SIZE; i++) {
+        munit_assert_true(page_free_zeroed(region, page_alloc(region)));
+    }
+
+    munit_assert_true(page_zero_pool_full(region));
+    munit_assert_uint64(pool->zeroed, ==, PMM_ZERO_POOL_SIZE);
+
+    // ... and no more once it is, the page stays with the caller
+    const uintptr_t extra = page_alloc(region);
+    munit_assert_false(page_free_zeroed(region, extra));
+    munit_assert_uint64(pool->count, ==, PMM_ZERO_POOL_SIZE);
+
+    // Pooled pages are still free memory
+    munit_assert_uint64(page_alloc_free_bytes(region), ==, (0x100 - 1) << 12);
+
+    // Batches take what's there, and count the rest as misses
+    uintptr_t pages[PMM_ZERO_POOL_SIZE + 4];
+    munit_assert_uint64(page_alloc_zeroed_batch(region, pages, 4), ==, 4);
+    munit_assert_uint64(page_alloc_zeroed(region) & 0xFFF, ==, 0);
+    munit_assert_uint64(pool->hits, ==, 5);
+
+    munit_assert_uint64(page_alloc_zeroed_batch(region, pages, PMM_ZERO_POOL_SIZE), ==, PMM_ZERO_POOL_SIZE - 5);
+    munit_assert_uint64(pool->hits, ==, PMM_ZERO_POOL_SIZE);
+    munit_assert_uint64(pool->misses, ==, 6);
+    munit_assert_uint64(pool->count, ==, 0);
+
+    // Unaligned is never accepted
+    munit_assert_false(page_free_zeroed(region, 0x1234));
+
+    free_mem_map(map);
+    return MUNIT_OK;
+}
+
+static MunitResult test_zero_pool_last_resort(const MunitParameter params[], void *param) {
+    Limine_MemMapEntry entry0;
+    Limine_MemMap *map = create_mem_map(1);
+    MemoryRegion *region = init_cached_region(map, &entry0, 4);
+    PerCPUZeroPool *pool = &__test_cpu_state[0].zero_pool;
+
+    uintptr_t pages[4];
+    for (int i = 0; i < 4; i++) {
+        pages[i] = page_alloc(region);
+    }
+
+    munit_assert_true(page_free_zeroed(region, pages[0]));
+    munit_assert_true(page_free_zeroed(region, pages[1]));
+
+    // Cache and region are empty, so ordinary allocations come from the pool
+    munit_assert_uint64(page_alloc(region), ==, pages[1]);
+    munit_assert_uint64(page_alloc(region), ==, pages[0]);
+    munit_assert_uint64(pool->count, ==, 0);
+    munit_assert_uint64(page_alloc(region) & 0xFF, ==, 0xFF);
+
+    free_mem_map(map);
+    return MUNIT_OK;
+}
+
+static MunitResult test_zero_pool_steal(const MunitParameter params[], void *param) {
+    Limine_MemMapEntry entry0;
+    Limine_MemMap *map = create_mem_map(1);
+    MemoryRegion *region = init_cached_region(map, &entry0, 4);
+    PerCPUZeroPool *other = &__test_cpu_state[2].zero_pool;
+
+    uintptr_t pages[4];
+    for (int i = 0; i < 4; i++) {
+        pages[i] = page_alloc(region);
+    }
+
+    // Some other CPU's idle thread pooled a couple...
+    __test_this_cpu = 2;
+    munit_assert_true(page_free_zeroed(region, pages[0]));
+    munit_assert_true(page_free_zeroed(region, pages[1]));
+    __test_this_cpu = 0;
+
+    // ... and they don't get stranded there once we run out
+    munit_assert_uint64(page_alloc(region), ==, pages[1]);
+    munit_assert_uint64(page_alloc(region), ==, pages[0]);
+    munit_assert_uint64(other->count, ==, 0);
+    munit_assert_uint64(page_alloc(region) & 0xFF, ==, 0xFF);
+
+    free_mem_map(map);
+    return MUNIT_OK;
+}
+
+static MunitResult test_zero_pool_steal_batch(const MunitParameter params[], void *param) {
+    Limine_MemMapEntry entry0;
+    Limine_MemMap *map = create_mem_map(1);
+    MemoryRegion *region = init_cached_region(map, &entry0, 8);
+
+    uintptr_t pages[8];
+    munit_assert_uint64(page_alloc_batch(region, pages, 8), ==, 8);
+
+    munit_assert_true(page_free_zeroed(region, pages[0]));
+
+    __test_this_cpu = 3;
+    munit_assert_true(page_free_zeroed(region, pages[1]));
+    munit_assert_true(page_free_zeroed(region, pages[2]));
+    __test_this_cpu = 0;
+
+    // Ours first, then whatever the others have
+    uintptr_t got[4];
+    munit_assert_uint64(page_alloc_batch(region, got, 4), ==, 3);
+    munit_assert_uint64(got[0], ==, pages[0]);
+    munit_assert_uint64(got[1], ==, pages[2]);
+    munit_assert_uint64(got[2], ==, pages[1]);
+
+    free_mem_map(map);
+    return MUNIT_OK;
+}
+
+static MunitResult test_zero_pool_alloc_for_zeroing(const MunitParameter params[], void *param) {
+    Limine_MemMapEntry entry0;
+    Limine_MemMap *map = create_mem_map(1);
+    MemoryRegion *region = init_cached_region(map, &entry0, 2);
+    PerCPUZeroPool *pool = &__test_cpu_state[0].zero_pool;
+
+    for (int i = 0; i < 2; i++) {
+        const uintptr_t page = page_alloc_for_zeroing(region);
+        munit_assert_uint64(page & 0xFFF, ==, 0);
+        munit_assert_true(page_free_zeroed(region, page));
+    }
+
+    // Nothing left that isn't already zeroed, so nothing to zero...
+    munit_assert_uint64(page_alloc_for_zeroing(region) & 0xFF, ==, 0xFF);
+    munit_assert_uint64(pool->count, ==, 2);
+    munit_assert_uint64(pool->zeroed, ==, 2);
+
+    // ... and other CPUs don't take ours just to zero them again
+    __test_this_cpu = 1;
+    munit_assert_uint64(page_alloc_for_zeroing(region) & 0xFF, ==, 0xFF);
+    __test_this_cpu = 0;
+
+    munit_assert_uint64(pool->count, ==, 2);
+
+    free_mem_map(map);
+    return MUNIT_OK;
+}
+
 static void *setup(const MunitParameter params[], void *user_data) {
     region_buffer = malloc(0x100000);
+
+    for (int i = 0; i < 4; i++) {
+        memset(&__test_cpu_state[i].page_cache, 0, sizeof(PerCPUPageCache));
+        memset(&__test_cpu_state[i].zero_pool, 0, sizeof(PerCPUZeroPool));
+    }
+
     return NULL;
 }
 
@@ -973,6 +1368,7 @@ static MunitTest test_suite_tests[] = {
         {(char *)"/alloc_page", test_alloc_page, setup, teardown, MUNIT_TEST_OPTION_NONE, NULL},
         {(char *)"/alloc_two_pages", test_alloc_two_pages, setup, teardown, MUNIT_TEST_OPTION_NONE, NULL},
         {(char *)"/alloc_from_two_blocks", test_alloc_two_blocks, setup, teardown, MUNIT_TEST_OPTION_NONE, NULL},
+        {(char *)"/alloc_batch", test_alloc_batch, setup, teardown, MUNIT_TEST_OPTION_NONE, NULL},
 
         {(char *)"/alloc_m_empty_one", test_alloc_page_m_empty_one, setup, teardown, MUNIT_TEST_OPTION_NONE, NULL},
         {(char *)"/alloc_m_empty_two", test_alloc_page_m_empty_two, setup, teardown, MUNIT_TEST_OPTION_NONE, NULL},
@@ -994,6 +1390,23 @@ static MunitTest test_suite_tests[] = {
         {(char *)"/free_contig_fwd", test_free_contig_pages_forward, setup, teardown, MUNIT_TEST_OPTION_NONE, NULL},
         {(char *)"/free_contig_bwd", test_free_contig_pages_backward, setup, teardown, MUNIT_TEST_OPTION_NONE, NULL},
 
+        {(char *)"/cache_alloc_refill", test_cache_alloc_refill, setup, teardown, MUNIT_TEST_OPTION_NONE, NULL},
+        {(char *)"/cache_alloc_exhausted", test_cache_alloc_exhausted, setup, teardown, MUNIT_TEST_OPTION_NONE, NULL},
+        {(char *)"/cache_free_drain", test_cache_free_drain, setup, teardown, MUNIT_TEST_OPTION_NONE, NULL},
+        {(char *)"/cache_alloc_batch", test_cache_alloc_batch, setup, teardown, MUNIT_TEST_OPTION_NONE, NULL},
+        {(char *)"/cache_steal", test_cache_steal, setup, teardown, MUNIT_TEST_OPTION_NONE, NULL},
+        {(char *)"/cache_steal_before_zero_pool", test_cache_steal_before_zero_pool, setup, teardown,
+         MUNIT_TEST_OPTION_NONE, NULL},
+
+        {(char *)"/zero_pool_before_smp", test_zero_pool_before_smp, setup, teardown, MUNIT_TEST_OPTION_NONE, NULL},
+        {(char *)"/zero_pool_fill_and_take", test_zero_pool_fill_and_take, setup, teardown, MUNIT_TEST_OPTION_NONE,
+         NULL},
+        {(char *)"/zero_pool_last_resort", test_zero_pool_last_resort, setup, teardown, MUNIT_TEST_OPTION_NONE, NULL},
+        {(char *)"/zero_pool_steal", test_zero_pool_steal, setup, teardown, MUNIT_TEST_OPTION_NONE, NULL},
+        {(char *)"/zero_pool_steal_batch", test_zero_pool_steal_batch, setup, teardown, MUNIT_TEST_OPTION_NONE, NULL},
+        {(char *)"/zero_pool_alloc_for_zeroing", test_zero_pool_alloc_for_zeroing, setup, teardown,
+         MUNIT_TEST_OPTION_NONE, NULL},
+
         {NULL, NULL, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL},
 };
 
@@ -0,0 +1,185 @@
+/*
+ * Microbenchmark - Physical page allocator
+ * anos - An Operating System
+ *
+ * Copyright (c) 2025 Ross Bamford
+ *
+ * Built twice, once for each backend (stack, and buddy with PMM_BUDDY),
+ * over the same fake 256MiB of physical memory (the allocator never
+ * touches the memory it manages, so it doesn't need to exist):
+ *
+ *   burst          - allocate N single pages, then free them all
+ *   alloc_m        - allocate N contiguous pages, free them a page at a time
+ *   fragmentation  - with a random half of memory allocated, how many
+ *                    N-page contiguous allocations still succeed
+ *
+ * Locks and per-CPU caches are stubbed out, so this is just the backend.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "bench.h"
+#include "pmm/pagealloc.h"
+#include "smp/state.h"
+#include "spinlock.h"
+
+#ifdef PMM_BUDDY
+#define BACKEND "pmm/buddy"
+#else
+#define BACKEND "pmm/stack"
+#endif
+
+#define MEMORY_BASE ((0x100000ULL))
+#define MEMORY_SIZE ((0x10000000ULL))
+#define MEMORY_PAGES ((MEMORY_SIZE >> VM_PAGE_LINEAR_SHIFT))
+
+// Needs room for the stack at its most fragmented, or the buddy metadata
+#define REGION_BUFFER_SIZE ((MEMORY_PAGES * sizeof(MemoryBlock) + 0x10000))
+
+#define BURST_ROUNDS 2000
+#define ALLOC_M_OPS 200000
+
+PerCPUState __test_cpu_state[4];
+uint16_t __test_cpu_count = 1;
+_Thread_local uint8_t __test_this_cpu;
+
+void spinlock_init(SpinLock *lock) {}
+void spinlock_lock(SpinLock *lock) {}
+void spinlock_unlock(SpinLock *lock) {}
+uint64_t spinlock_lock_irqsave(SpinLock *lock) { return 0; }
+void spinlock_unlock_irqrestore(SpinLock *lock, uint64_t flags) {}
+
+uint64_t save_disable_interrupts(void) { return 0; }
+void restore_saved_interrupts(uint64_t flags) {}
+
+#ifdef PMM_BUDDY
+// The metadata lives just above the region in the host buffer anyway
+bool arch_pmm_map_metadata_page(uintptr_t vaddr, uintptr_t phys) { return true; }
+#endif
+
+static void *region_buffer;
+static uintptr_t pages[MEMORY_PAGES];
+
+static MemoryRegion *init_region(void) {
+    static Limine_MemMapEntry entry = {.type = LIMINE_MEMMAP_USABLE, .base = MEMORY_BASE, .length = MEMORY_SIZE};
+    static Limine_MemMapEntry *entries[1] = {&entry};
+    static Limine_MemMap map = {.entry_count = 1, .entries = entries};
+
+    return page_alloc_init_limine(&map, 0, region_buffer, false);
+}
+
+static void bench_burst(const uint64_t burst) {
+    MemoryRegion *region = init_region();
+
+    const uint64_t start = bench_now_ns();
+
+    for (int round = 0; round < BURST_ROUNDS; round++) {
+        for (uint64_t i = 0; i < burst; i++) {
+            pages[i] = page_alloc(region);
+        }
+
+        for (uint64_t i = 0; i < burst; i++) {
+            page_free(region, pages[i]);
+        }
+    }
+
+    const uint64_t elapsed = bench_now_ns() - start;
+
+    bench_report(BACKEND, "burst", "pages", burst, BURST_ROUNDS * burst * 2, elapsed);
+}
+
+static void bench_alloc_m(const uint64_t count) {
+    MemoryRegion *region = init_region();
+
+    const uint64_t start = bench_now_ns();
+
+    for (int op = 0; op < ALLOC_M_OPS; op++) {
+        const uintptr_t block = page_alloc_m(region, count);
+
+        if (block & 0xFFF) {
+            fprintf(stderr, "%s: page_alloc_m(%llu) failed\n", BACKEND, (unsigned long long)count);
+            exit(1);
+        }
+
+        // Backwards, so the stack allocator can coalesce as it goes
+        for (uint64_t i = count; i > 0; i--) {
+            page_free(region, block + ((i - 1) << VM_PAGE_LINEAR_SHIFT));
+        }
+    }
+
+    const uint64_t elapsed = bench_now_ns() - start;
+
+    bench_report(BACKEND, "alloc_m", "pages", count, ALLOC_M_OPS, elapsed);
+}
+
+static void bench_fragmentation(const uint64_t count) {
+    MemoryRegion *region = init_region();
+    uint64_t allocated = 0;
+
+    while (true) {
+        const uintptr_t page = page_alloc(region);
+
+        if (page & 0xFFF) {
+            break;
+        }
+
+        pages[allocated++] = page;
+    }
+
+    // Same "random" half every time, so runs are comparable
+    uint64_t seed = 0x2545F4914F6CDD1DULL;
+
+    for (uint64_t i = allocated - 1; i > 0; i--) {
+        seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+        const uint64_t j = (seed >> 33) % (i + 1);
+        const uintptr_t tmp = pages[i];
+        pages[i] = pages[j];
+        pages[j] = tmp;
+    }
+
+    for (uint64_t i = 0; i < allocated / 2; i++) {
+        page_free(region, pages[i]);
+    }
+
+    uint64_t successes = 0;
+
+    while ((page_alloc_m(region, count) & 0xFFF) == 0) {
+        successes++;
+    }
+
+    printf("%-16s %-28s %10s=%-8llu %10llu allocs %8.2f%% of free\n", BACKEND, "fragmentation", "pages",
+           (unsigned long long)count, (unsigned long long)successes,
+           (100.0 * successes * count) / (double)(allocated / 2));
+}
+
+int main(void) {
+    region_buffer = aligned_alloc(VM_PAGE_SIZE, REGION_BUFFER_SIZE);
+
+    if (!region_buffer) {
+        fprintf(stderr, "Failed to allocate region buffer\n");
+        return 1;
+    }
+
+    static const uint64_t bursts[] = {1, 64, 1024};
+    static const uint64_t counts[] = {2, 8, 64, 512};
+
+    for (int i = 0; i < sizeof(bursts) / sizeof(bursts[0]); i++) {
+        bench_burst(bursts[i]);
+    }
+
+    for (int i = 0; i < sizeof(counts) / sizeof(counts[0]); i++) {
+        bench_alloc_m(counts[i]);
+    }
+
+    bench_fragmentation(1);
+
+    for (int i = 0; i < sizeof(counts) / sizeof(counts[0]); i++) {
+        bench_fragmentation(counts[i]);
+    }
+
+    free(region_buffer);
+    return 0;
+}
@@ -0,0 +1,228 @@
+/*
+ * Tests for the page allocator with the buddy backend (PMM_BUDDY)
+ * anos - An Operating System
+ *
+ * Copyright (c) 2025 Ross Bamford
+ */
+
+#include <string.h>
+
+#include "munit.h"
+#include "pmm/pagealloc.h"
+
+#include "smp/state.h"
+
+#ifndef PMM_BUDDY
+#error This test must be built with PMM_BUDDY
+#endif
+
+static void *region_buffer;
+
+static int map_calls;
+static uintptr_t first_map_vaddr;
+static uintptr_t first_map_phys;
+static bool map_fails;
+
+bool arch_pmm_map_metadata_page(uintptr_t vaddr, uintptr_t phys) {
+    if (map_calls++ == 0) {
+        first_map_vaddr = vaddr;
+        first_map_phys = phys;
+    }
+
+    return !map_fails;
+}
+
+static MemoryRegion *init_one(const uint64_t base, const uint64_t length) {
+    static Limine_MemMapEntry entry;
+    static Limine_MemMapEntry *entries[1] = {&entry};
+    static Limine_MemMap map = {.entry_count = 1, .entries = entries};
+
+    entry.type = LIMINE_MEMMAP_USABLE;
+    entry.base = base;
+    entry.length = length;
+
+    return page_alloc_init_limine(&map, 0, region_buffer, false);
+}
+
+static MunitResult test_init_empty(const MunitParameter params[], void *param) {
+    Limine_MemMap map = {.entry_count = 0};
+
+    MemoryRegion *region = page_alloc_init_limine(&map, 0, region_buffer, false);
+
+    munit_assert_uint64(region->size, ==, 0);
+    munit_assert_uint64(region->free, ==, 0);
+    munit_assert_int(map_calls, ==, 0);
+    munit_assert_uint64(page_alloc(region) & 0xFF, ==, 0xFF);
+
+    return MUNIT_OK;
+}
+
+static MunitResult test_init_metadata(const MunitParameter params[], void *param) {
+    MemoryRegion *region = init_one(0x100000, 0x400000);
+
+    // Metadata for the span is a single page, mapped just above the region and taken from the first usable page
+    munit_assert_int(map_calls, ==, 1);
+    munit_assert_uint64(first_map_vaddr, ==, (uintptr_t)region_buffer + VM_PAGE_SIZE);
+    munit_assert_uint64(first_map_phys, ==, 0x100000);
+
+    munit_assert_uint64(region->size, ==, 0x400000);
+    munit_assert_uint64(region->free, ==, 0x3ff000);
+    munit_assert_uint64(page_alloc_free_bytes(region), ==, 0x3ff000);
+
+    return MUNIT_OK;
+}
+
+static MunitResult test_init_metadata_later_block(const MunitParameter params[], void *param) {
+    Limine_MemMapEntry small = {.type = LIMINE_MEMMAP_USABLE, .base = 0x1000, .length = 0x1000};
+    Limine_MemMapEntry big = {.type = LIMINE_MEMMAP_USABLE, .base = 0x40000000, .length = 0x40000000};
+    Limine_MemMapEntry *entries[2] = {&small, &big};
+    Limine_MemMap map = {.entry_count = 2, .entries = entries};
+
+    MemoryRegion *region = page_alloc_init_limine(&map, 0, region_buffer, false);
+
+    const uint64_t metadata_pages = (buddy_metadata_size(0x1000, 0x80000000) + VM_PAGE_SIZE - 1) / VM_PAGE_SIZE;
+
+    // First block is too small for it all
+    munit_assert_uint64(metadata_pages, >, 1);
+    munit_assert_int(map_calls, ==, metadata_pages);
+    munit_assert_uint64(first_map_phys, ==, 0x40000000);
+
+    munit_assert_uint64(region->size, ==, 0x40001000);
+    munit_assert_uint64(region->free, ==, 0x40001000 - metadata_pages * VM_PAGE_SIZE);
+
+    // Small block is still usable
+    munit_assert_uint64(page_alloc(region), ==, 0x1000);
+
+    return MUNIT_OK;
+}
+
+static MunitResult test_init_map_fails(const MunitParameter params[], void *param) {
+    map_fails = true;
+
+    MemoryRegion *region = init_one(0x400000, 0x400000);
+
+    munit_assert_uint64(region->free, ==, 0);
+    munit_assert_uint64(page_alloc(region) & 0xFF, ==, 0xFF);
+
+    return MUNIT_OK;
+}
+
+static MunitResult test_alloc_all(const MunitParameter params[], void *param) {
+    MemoryRegion *region = init_one(0x400000, 0x400000);
+
+    for (int i = 0; i < 1023; i++) {
+        const uintptr_t page = page_alloc(region);
+
+        munit_assert_uint64(page & 0xFFF, ==, 0);
+        munit_assert_uint64(page, >, 0x400000);
+        munit_assert_uint64(page, <, 0x800000);
+    }
+
+    munit_assert_uint64(region->free, ==, 0);
+    munit_assert_uint64(page_alloc(region) & 0xFF, ==, 0xFF);
+
+    return MUNIT_OK;
+}
+
+static MunitResult test_alloc_m_aligned(const MunitParameter params[], void *param) {
+    MemoryRegion *region = init_one(0x400000, 0x400000);
+
+    // First page is metadata, so the first 8-page block is the second one
+    const uintptr_t block = page_alloc_m(region, 8);
+
+    munit_assert_uint64(block, ==, 0x408000);
+    munit_assert_uint64(region->free, ==, 0x3ff000 - 0x8000);
+
+    return MUNIT_OK;
+}
+
+static MunitResult test_alloc_m_returns_tail(const MunitParameter params[], void *param) {
+    MemoryRegion *region = init_one(0x400000, 0x400000);
+
+    const uintptr_t block = page_alloc_m(region, 3);
+
+    munit_assert_uint64(block, ==, 0x404000);
+    munit_assert_uint64(region->free, ==, 0x3ff000 - 0x3000);
+
+    // The fourth page went back, alongside the one next to the metadata
+    munit_assert_uint64(region->buddy.free_blocks[0], ==, 2);
+
+    return MUNIT_OK;
+}
+
+static MunitResult test_alloc_m_too_big(const MunitParameter params[], void *param) {
+    MemoryRegion *region = init_one(0x400000, 0x800000);
+
+    munit_assert_uint64(page_alloc_m(region, 0) & 0xFF, ==, 0xFF);
+    munit_assert_uint64(page_alloc_m(region, 1025) & 0xFF, ==, 0xFF);
+    munit_assert_uint64(page_alloc_m(region, 1024), ==, 0x800000);
+
+    return MUNIT_OK;
+}
+
+static MunitResult test_free_coalesces(const MunitParameter params[], void *param) {
+    MemoryRegion *region = init_one(0x400000, 0x800000);
+
+    const uintptr_t block = page_alloc_m(region, 1024);
+    munit_assert_uint64(block, ==, 0x800000);
+    munit_assert_uint64(page_alloc_m(region, 1024) & 0xFF, ==, 0xFF);
+
+    // Give it back a page at a time
+    for (int i = 0; i < 1024; i++) {
+        page_free(region, block + i * VM_PAGE_SIZE);
+    }
+
+    munit_assert_uint64(region->free, ==, 0x7ff000);
+    munit_assert_uint64(page_alloc_m(region, 1024), ==, 0x800000);
+
+    return MUNIT_OK;
+}
+
+static MunitResult test_free_unaligned(const MunitParameter params[], void *param) {
+    MemoryRegion *region = init_one(0x400000, 0x400000);
+
+    const uintptr_t page = page_alloc(region);
+    page_free(region, page + 0x10);
+
+    // Ignored
+    munit_assert_uint64(region->free, ==, 0x3ff000 - 0x1000);
+    munit_assert_uint64(page_alloc(region), !=, page);
+
+    return MUNIT_OK;
+}
+
+static void *setup(const MunitParameter params[], void *user_data) {
+    region_buffer = malloc(0x100000);
+    memset(&__test_cpu_state[0].page_cache, 0, sizeof(PerCPUPageCache));
+    memset(&__test_cpu_state[0].zero_pool, 0, sizeof(PerCPUZeroPool));
+
+    map_calls = 0;
+    first_map_vaddr = first_map_phys = 0;
+    map_fails = false;
+
+    return NULL;
+}
+
+static void teardown(void *param) { free(region_buffer); }
+
+static MunitTest test_suite_tests[] = {
+        {(char *)"/init_empty", test_init_empty, setup, teardown, MUNIT_TEST_OPTION_NONE, NULL},
+        {(char *)"/init_metadata", test_init_metadata, setup, teardown, MUNIT_TEST_OPTION_NONE, NULL},
+        {(char *)"/init_metadata_later_block", test_init_metadata_later_block, setup, teardown,
+         MUNIT_TEST_OPTION_NONE, NULL},
+        {(char *)"/init_map_fails", test_init_map_fails, setup, teardown, MUNIT_TEST_OPTION_NONE, NULL},
+        {(char *)"/alloc_all", test_alloc_all, setup, teardown, MUNIT_TEST_OPTION_NONE, NULL},
+        {(char *)"/alloc_m_aligned", test_alloc_m_aligned, setup, teardown, MUNIT_TEST_OPTION_NONE, NULL},
+        {(char *)"/alloc_m_returns_tail", test_alloc_m_returns_tail, setup, teardown, MUNIT_TEST_OPTION_NONE, NULL},
+        {(char *)"/alloc_m_too_big", test_alloc_m_too_big, setup, teardown, MUNIT_TEST_OPTION_NONE, NULL},
+        {(char *)"/free_coalesces", test_free_coalesces, setup, teardown, MUNIT_TEST_OPTION_NONE, NULL},
+        {(char *)"/free_unaligned", test_free_unaligned, setup, teardown, MUNIT_TEST_OPTION_NONE, NULL},
+        {NULL, NULL, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL},
+};
+
+static const MunitSuite test_suite = {(char *)"/pmm/buddy_region", test_suite_tests, NULL, 1,
+                                      MUNIT_SUITE_OPTION_NONE};
+
+int main(int argc, char *argv[MUNIT_ARRAY_PARAM(argc + 1)]) {
+    return munit_suite_main(&test_suite, (void *)"µnit", argc, argv);
+}
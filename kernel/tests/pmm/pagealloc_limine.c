@@ -8,6 +8,8 @@
 #include "munit.h"
 #include "pmm/pagealloc.h"
 
+#include "smp/state.h"
+
 static void *region_buffer;
 
 static Limine_MemMap *create_mem_map(int entry_count) {
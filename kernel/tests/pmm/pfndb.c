@@ -0,0 +1,212 @@
+/*
+ * Tests for the physical frame database
+ * anos - An Operating System
+ *
+ * Copyright (c) 2025 Ross Bamford
+ */
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "munit.h"
+
+#include "mock_pagetables.h"
+#include "mock_pmm.h"
+#include "mock_vmm.h"
+#include "pmm/pfndb.h"
+#include "vmm/vmmapper.h"
+
+#define TEST_PML4_ADDR (((uint64_t *)0x100000))
+#define TEST_PAGE_COUNT ((16))
+#define TEST_THREADS ((4))
+#define TEST_INCREMENTS_PER_THREAD ((10000))
+
+void test_pfndb_reset(void);
+
+static Limine_MemMapEntry low = {.base = 0x0, .length = 0x9f000, .type = LIMINE_MEMMAP_USABLE};
+static Limine_MemMapEntry bios = {.base = 0x9f000, .length = 0x61000, .type = LIMINE_MEMMAP_RESERVED};
+static Limine_MemMapEntry high = {.base = 0x100000, .length = 0xf00000, .type = LIMINE_MEMMAP_USABLE};
+static Limine_MemMapEntry fb = {.base = 0xfd000000, .length = 0x800000, .type = LIMINE_MEMMAP_FRAMEBUFFER};
+
+// 16MiB of RAM, so 4096 frames in 16 pages
+static Limine_MemMapEntry *entries[] = {&low, &bios, &high, &fb};
+static Limine_MemMap memmap = {.entry_count = 4, .entries = entries};
+
+static void *setup(const MunitParameter params[], void *user_data) {
+    void *page_area_ptr;
+    posix_memalign(&page_area_ptr, 0x1000, TEST_PAGE_COUNT << 12);
+
+    // Make sure init clears it
+    memset(page_area_ptr, 0xa5, TEST_PAGE_COUNT << 12);
+
+    return page_area_ptr;
+}
+
+static void teardown(void *page_area_ptr) {
+    free(page_area_ptr);
+    test_pfndb_reset();
+    mock_pmm_reset();
+    mock_vmm_reset();
+}
+
+static MunitResult test_init_unaligned(const MunitParameter params[], void *page_area_ptr) {
+    munit_assert_false(pfndb_init(TEST_PML4_ADDR, (uintptr_t)page_area_ptr + 0x10, &memmap));
+
+    munit_assert_uint32(mock_pmm_get_total_page_allocs(), ==, 0);
+    munit_assert_uint64(pfndb_frame_count(), ==, 0);
+
+    return MUNIT_OK;
+}
+
+static MunitResult test_init_empty(const MunitParameter params[], void *page_area_ptr) {
+    Limine_MemMap empty = {.entry_count = 0};
+
+    munit_assert_true(pfndb_init(TEST_PML4_ADDR, (uintptr_t)page_area_ptr, &empty));
+
+    munit_assert_uint32(mock_pmm_get_total_page_allocs(), ==, 0);
+    munit_assert_uint64(pfndb_frame_count(), ==, 0);
+    munit_assert_null(pfndb_lookup(0));
+    munit_assert_uint32(pfndb_ref_increment(0), ==, 0);
+
+    return MUNIT_OK;
+}
+
+static MunitResult test_init(const MunitParameter params[], void *page_area_ptr) {
+    munit_assert_true(pfndb_init(TEST_PML4_ADDR, (uintptr_t)page_area_ptr, &memmap));
+
+    // Framebuffer isn't RAM, so doesn't count
+    munit_assert_uint64(pfndb_frame_count(), ==, 4096);
+
+    munit_assert_uint32(mock_pmm_get_total_page_allocs(), ==, TEST_PAGE_COUNT);
+    munit_assert_uint32(mock_vmm_get_total_page_maps(), ==, TEST_PAGE_COUNT);
+    munit_assert_uint64(mock_vmm_get_last_page_map_pml4(), ==, (uint64_t)TEST_PML4_ADDR);
+    munit_assert_uint64(mock_vmm_get_last_page_map_vaddr(), ==, (uintptr_t)page_area_ptr + 0xf000);
+    munit_assert_uint16(mock_vmm_get_last_page_map_flags(), ==, PG_PRESENT | PG_READ | PG_WRITE);
+
+    // Index by PFN, straight into the array
+    munit_assert_ptr_equal(pfndb_lookup(0x0), page_area_ptr);
+    munit_assert_ptr_equal(pfndb_lookup(0x1234), (PageFrame *)page_area_ptr + 1);
+    munit_assert_null(pfndb_lookup(0x1000000));
+
+    return MUNIT_OK;
+}
+
+static MunitResult test_init_flags(const MunitParameter params[], void *page_area_ptr) {
+    munit_assert_true(pfndb_init(TEST_PML4_ADDR, (uintptr_t)page_area_ptr, &memmap));
+
+    munit_assert_uint16(pfndb_lookup(0x0)->flags, ==, PAGE_FRAME_FLAG_RAM);
+    munit_assert_uint16(pfndb_lookup(0x9e000)->flags, ==, PAGE_FRAME_FLAG_RAM);
+    munit_assert_uint16(pfndb_lookup(0x9f000)->flags, ==, 0);
+    munit_assert_uint16(pfndb_lookup(0xff000)->flags, ==, 0);
+    munit_assert_uint16(pfndb_lookup(0x100000)->flags, ==, PAGE_FRAME_FLAG_RAM);
+    munit_assert_uint16(pfndb_lookup(0xfff000)->flags, ==, PAGE_FRAME_FLAG_RAM);
+
+    // Everything else starts zeroed
+    for (uintptr_t phys = 0; phys < 0x1000000; phys += 0x1000) {
+        munit_assert_uint32(pfndb_lookup(phys)->refcount, ==, 0);
+        munit_assert_uint64(pfndb_lookup(phys)->owner, ==, 0);
+    }
+
+    return MUNIT_OK;
+}
+
+static MunitResult test_refcount(const MunitParameter params[], void *page_area_ptr) {
+    munit_assert_true(pfndb_init(TEST_PML4_ADDR, (uintptr_t)page_area_ptr, &memmap));
+
+    // Not referenced yet
+    munit_assert_uint32(pfndb_ref_decrement(0x200000), ==, 0);
+
+    munit_assert_uint32(pfndb_ref_increment(0x200000), ==, 1);
+    munit_assert_uint32(pfndb_ref_increment(0x200000), ==, 2);
+
+    // Any address in the frame is the same frame
+    munit_assert_uint32(pfndb_ref_increment(0x200fff), ==, 3);
+
+    // Neighbours untouched
+    munit_assert_uint32(pfndb_lookup(0x1ff000)->refcount, ==, 0);
+    munit_assert_uint32(pfndb_lookup(0x201000)->refcount, ==, 0);
+
+    // Decrement returns the previous count
+    munit_assert_uint32(pfndb_ref_decrement(0x200000), ==, 3);
+    munit_assert_uint32(pfndb_ref_decrement(0x200000), ==, 2);
+    munit_assert_uint32(pfndb_ref_decrement(0x200000), ==, 1);
+    munit_assert_uint32(pfndb_ref_decrement(0x200000), ==, 0);
+    munit_assert_uint32(pfndb_lookup(0x200000)->refcount, ==, 0);
+
+    return MUNIT_OK;
+}
+
+static MunitResult test_refcount_out_of_range(const MunitParameter params[], void *page_area_ptr) {
+    munit_assert_true(pfndb_init(TEST_PML4_ADDR, (uintptr_t)page_area_ptr, &memmap));
+
+    munit_assert_uint32(pfndb_ref_increment(0x1000000), ==, 0);
+    munit_assert_uint32(pfndb_ref_decrement(0x1000000), ==, 0);
+    munit_assert_uint32(pfndb_ref_increment(0xfd000000), ==, 0);
+
+    return MUNIT_OK;
+}
+
+static MunitResult test_owner(const MunitParameter params[], void *page_area_ptr) {
+    munit_assert_true(pfndb_init(TEST_PML4_ADDR, (uintptr_t)page_area_ptr, &memmap));
+
+    pfndb_set_owner(0x300000, 42);
+    munit_assert_uint64(pfndb_lookup(0x300000)->owner, ==, 42);
+
+    pfndb_set_owner(0x300000, 0);
+    munit_assert_uint64(pfndb_lookup(0x300000)->owner, ==, 0);
+
+    // Ignored
+    pfndb_set_owner(0x1000000, 42);
+
+    return MUNIT_OK;
+}
+
+static void *increment_thread(void *arg) {
+    for (int i = 0; i < TEST_INCREMENTS_PER_THREAD; i++) {
+        pfndb_ref_increment(0x400000);
+        pfndb_ref_increment(0x401000);
+        pfndb_ref_decrement(0x401000);
+    }
+
+    return NULL;
+}
+
+static MunitResult test_refcount_concurrent(const MunitParameter params[], void *page_area_ptr) {
+    munit_assert_true(pfndb_init(TEST_PML4_ADDR, (uintptr_t)page_area_ptr, &memmap));
+
+    pthread_t threads[TEST_THREADS];
+
+    for (int i = 0; i < TEST_THREADS; i++) {
+        pthread_create(&threads[i], NULL, increment_thread, NULL);
+    }
+
+    for (int i = 0; i < TEST_THREADS; i++) {
+        pthread_join(threads[i], NULL);
+    }
+
+    munit_assert_uint32(pfndb_lookup(0x400000)->refcount, ==, TEST_THREADS * TEST_INCREMENTS_PER_THREAD);
+    munit_assert_uint32(pfndb_lookup(0x401000)->refcount, ==, 0);
+
+    return MUNIT_OK;
+}
+
+static MunitTest test_suite_tests[] = {
+        {(char *)"/init_unaligned", test_init_unaligned, setup, teardown, MUNIT_TEST_OPTION_NONE, NULL},
+        {(char *)"/init_empty", test_init_empty, setup, teardown, MUNIT_TEST_OPTION_NONE, NULL},
+        {(char *)"/init", test_init, setup, teardown, MUNIT_TEST_OPTION_NONE, NULL},
+        {(char *)"/init_flags", test_init_flags, setup, teardown, MUNIT_TEST_OPTION_NONE, NULL},
+        {(char *)"/refcount", test_refcount, setup, teardown, MUNIT_TEST_OPTION_NONE, NULL},
+        {(char *)"/refcount_out_of_range", test_refcount_out_of_range, setup, teardown, MUNIT_TEST_OPTION_NONE,
+         NULL},
+        {(char *)"/refcount_concurrent", test_refcount_concurrent, setup, teardown, MUNIT_TEST_OPTION_NONE, NULL},
+        {(char *)"/owner", test_owner, setup, teardown, MUNIT_TEST_OPTION_NONE, NULL},
+        {NULL, NULL, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL},
+};
+
+static const MunitSuite test_suite = {(char *)"/pmm/pfndb", test_suite_tests, NULL, 1, MUNIT_SUITE_OPTION_NONE};
+
+int main(int argc, char *argv[MUNIT_ARRAY_PARAM(argc + 1)]) {
+    return munit_suite_main(&test_suite, (void *)"µnit", argc, argv);
+}
@@ -13,6 +13,7 @@
 #include "mock_machine.h"
 #include "mock_pagetables.h"
 #include "mock_pmm.h"
+#include "mock_vmm.h"
 #include "pmm/pagealloc.h"
 #include "spinlock.h"
 #include "vmm/vmmapper.h"
@@ -24,7 +25,7 @@ extern MemoryRegion *physical_region;
 
 #define TEST_PAGE_COUNT ((32768))
 
-uint32_t refcount_map_increment(uintptr_t addr) { return 1; }
+uint32_t pfndb_ref_increment(uintptr_t addr) { return 1; }
 
 uint64_t vmm_phys_and_flags_to_table_entry(uintptr_t phys, uint64_t flags) { return ((phys & ~0xFFF) >> 2) | flags; }
 
@@ -46,6 +47,8 @@ static void *test_setup(const MunitParameter params[], void *user_data) {
 static void test_teardown(void *page_area_ptr) {
     free(page_area_ptr);
     mock_pmm_reset();
+    mock_machine_reset();
+    mock_vmm_reset();
 }
 
 static MunitResult test_create_success(const MunitParameter params[], void *fixture) {
@@ -157,6 +160,65 @@ static MunitResult test_stack_values_copied(const MunitParameter params[], void
     munit_assert_uint64(mock_stacked_page[509], ==, 0xBEEF);
     munit_assert_uint64(mock_stacked_page[508], ==, 0xDEAD);
 
+    // Can't be moved off this CPU while using its temp page, but can afterwards
+    munit_assert_uint32(mock_machine_max_intr_disable_level(), >, 0);
+    munit_assert_uint32(mock_machine_intr_disable_level(), ==, 0);
+
+    return MUNIT_OK;
+}
+
+static MunitResult test_stack_committed_lazily(const MunitParameter params[], void *data) {
+    const uintptr_t result = address_space_create(0x100000, 0x200000, 0, NULL, 0, NULL);
+
+    munit_assert_not_null((void *)result);
+
+    // Just the top page, the rest is faulted in
+    munit_assert_uint32(mock_vmm_get_total_page_maps(), ==, 1);
+    munit_assert_uint64(mock_vmm_get_last_page_map_vaddr(), ==, 0x2ff000);
+
+    return MUNIT_OK;
+}
+
+static MunitResult test_stack_commits_value_pages(const MunitParameter params[], void *data) {
+    static uint64_t values[600];
+    const uintptr_t result = address_space_create(0x100000, 0x200000, 0, NULL, 600, values);
+
+    munit_assert_not_null((void *)result);
+
+    // Two pages of values, each mapped in the stack and then in the temp page
+    munit_assert_uint32(mock_vmm_get_total_page_maps(), ==, 4);
+
+    return MUNIT_OK;
+}
+
+static MunitResult test_stack_region(const MunitParameter params[], void *data) {
+    uintptr_t start = 0, end = 0;
+
+    munit_assert_true(address_space_init_stack_region(0x100000, 0x200000, 0, &start, &end));
+
+    // Guard page at the bottom, committed page at the top
+    munit_assert_uint64(start, ==, 0x101000);
+    munit_assert_uint64(end, ==, 0x2ff000);
+
+    munit_assert_true(address_space_init_stack_region(0x100000, 0x200000, 600, &start, &end));
+
+    munit_assert_uint64(start, ==, 0x101000);
+    munit_assert_uint64(end, ==, 0x2fe000);
+
+    return MUNIT_OK;
+}
+
+static MunitResult test_stack_region_none(const MunitParameter params[], void *data) {
+    uintptr_t start = 0, end = 0;
+
+    // Guard and value page are all there is
+    munit_assert_false(address_space_init_stack_region(0x100000, 0x2000, 4, &start, &end));
+    munit_assert_false(address_space_init_stack_region(0x100000, 0x1000, 4, &start, &end));
+    munit_assert_false(address_space_init_stack_region(0x100000, 0, 0, &start, &end));
+
+    munit_assert_uint64(start, ==, 0);
+    munit_assert_uint64(end, ==, 0);
+
     return MUNIT_OK;
 }
 
@@ -177,6 +239,13 @@ static MunitTest test_suite_tests[] = {
          MUNIT_TEST_OPTION_NONE, NULL},
         {"/address_space/stack_values_copied", test_stack_values_copied, test_setup, test_teardown,
          MUNIT_TEST_OPTION_NONE, NULL},
+        {"/address_space/stack_committed_lazily", test_stack_committed_lazily, test_setup, test_teardown,
+         MUNIT_TEST_OPTION_NONE, NULL},
+        {"/address_space/stack_commits_value_pages", test_stack_commits_value_pages, test_setup, test_teardown,
+         MUNIT_TEST_OPTION_NONE, NULL},
+        {"/address_space/stack_region", test_stack_region, test_setup, test_teardown, MUNIT_TEST_OPTION_NONE, NULL},
+        {"/address_space/stack_region_none", test_stack_region_none, test_setup, test_teardown,
+         MUNIT_TEST_OPTION_NONE, NULL},
         {NULL, NULL, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL},
 };
 
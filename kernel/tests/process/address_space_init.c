@@ -15,7 +15,7 @@
 #include "process/address_space.h"
 #include "smp/state.h"
 
-uint32_t refcount_map_increment(uintptr_t addr) { return 1; }
+uint32_t pfndb_ref_increment(uintptr_t addr) { return 1; }
 
 uint64_t vmm_phys_and_flags_to_table_entry(uintptr_t phys, uint64_t flags) { return ((phys & ~0xFFF) >> 2) | flags; }
 
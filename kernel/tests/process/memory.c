@@ -35,6 +35,8 @@ typedef struct {
 static uint64_t fake_pages[MAX_FAKE_PAGES];
 static bool fake_page_allocated[MAX_FAKE_PAGES];
 static uint32_t fake_refcount[MAX_FAKE_PAGES];
+static uint64_t fake_owner[MAX_FAKE_PAGES];
+static uint64_t fake_zeroed_available;
 static pthread_mutex_t alloc_lock = PTHREAD_MUTEX_INITIALIZER;
 
 static MemoryRegion dummy_region;
@@ -44,7 +46,10 @@ static void reset_fakes(void) {
         fake_pages[i] = 0x1000 * (i + 1);
         fake_page_allocated[i] = false;
         fake_refcount[i] = 0;
+        fake_owner[i] = 0;
     }
+
+    fake_zeroed_available = 0;
 }
 
 void *fba_alloc_block(void) { return calloc(1, 4096); }
@@ -101,7 +106,40 @@ void page_free(MemoryRegion *region, uintptr_t addr) {
     pthread_mutex_unlock(&alloc_lock);
 }
 
-uint32_t refcount_map_increment(uintptr_t addr) {
+uint64_t page_alloc_batch(MemoryRegion *region, uintptr_t *pages, uint64_t count) {
+    uint64_t got = 0;
+
+    while (got < count) {
+        const uintptr_t page = page_alloc(region);
+
+        if (page & 0xFFF) {
+            break;
+        }
+
+        pages[got++] = page;
+    }
+
+    return got;
+}
+
+uint64_t page_alloc_zeroed_batch(MemoryRegion *region, uintptr_t *pages, uint64_t count) {
+    uint64_t got = 0;
+
+    while (got < count && fake_zeroed_available) {
+        const uintptr_t page = page_alloc(region);
+
+        if (page & 0xFFF) {
+            break;
+        }
+
+        pages[got++] = page;
+        fake_zeroed_available--;
+    }
+
+    return got;
+}
+
+uint32_t pfndb_ref_increment(uintptr_t addr) {
     for (int i = 0; i < MAX_FAKE_PAGES; i++) {
         if (fake_pages[i] == addr) {
             return ++fake_refcount[i];
@@ -110,7 +148,7 @@ uint32_t refcount_map_increment(uintptr_t addr) {
     return 0;
 }
 
-uint32_t refcount_map_decrement(uintptr_t addr) {
+uint32_t pfndb_ref_decrement(uintptr_t addr) {
     for (int i = 0; i < MAX_FAKE_PAGES; i++) {
         if (fake_pages[i] == addr) {
             if (fake_refcount[i] == 0)
@@ -121,6 +159,15 @@ uint32_t refcount_map_decrement(uintptr_t addr) {
     return 0;
 }
 
+void pfndb_set_owner(uintptr_t addr, uint64_t pid) {
+    for (int i = 0; i < MAX_FAKE_PAGES; i++) {
+        if (fake_pages[i] == addr) {
+            fake_owner[i] = pid;
+            return;
+        }
+    }
+}
+
 uint64_t spinlock_lock_irqsave(SpinLock *lock) {
     while (atomic_exchange_explicit(&lock->lock, 1, memory_order_acquire)) {
         __asm__ volatile("pause");
@@ -175,10 +222,20 @@ static MunitResult test_ownership_tracking(const MunitParameter params[], void *
     uint64_t addr1 = process_page_alloc(&proc, &dummy_region);
     uint64_t addr2 = process_page_alloc(&proc, &dummy_region);
 
+    // Frame owners are recorded...
+    munit_assert_uint64(fake_owner[0], ==, 2);
+    munit_assert_uint64(fake_owner[1], ==, 2);
+
     munit_assert_true(process_remove_owned_page(&proc, addr1));
     munit_assert_false(process_remove_owned_page(&proc, 0xdeadbeef));
 
+    // ... and cleared when the page is freed
+    munit_assert_uint64(fake_owner[0], ==, 0);
+    munit_assert_uint64(fake_owner[1], ==, 2);
+
     process_release_owned_pages(&proc);
+    munit_assert_uint64(fake_owner[1], ==, 0);
+
     return MUNIT_OK;
 }
 
@@ -231,6 +288,9 @@ static MunitResult test_shared_pages_refcounting(const MunitParameter params[],
     munit_assert_true(process_add_owned_page(&proc, &dummy_region, addr, true));
     munit_assert_int(fake_refcount[0], ==, 1);
 
+    // Shared pages don't change owner
+    munit_assert_uint64(fake_owner[0], ==, 0);
+
     munit_assert_true(process_remove_owned_page(&proc, addr));
     munit_assert_int(fake_refcount[0], ==, 0);
 
@@ -386,6 +446,81 @@ static MunitResult test_stress_concurrent_alloc_and_release(const MunitParameter
     return MUNIT_OK;
 }
 
+static MunitResult test_pages_alloc_batch(const MunitParameter params[], void *data) {
+    (void)params;
+    (void)data;
+    reset_fakes();
+
+    SpinLock lock = {0};
+    ProcessMemoryInfo memory_info = {
+            .pages_lock = &lock,
+            .pages = NULL,
+    };
+    Process proc = {
+            .pid = 3,
+            .meminfo = &memory_info,
+    };
+
+    // Leave only four pages free
+    for (int i = 4; i < MAX_FAKE_PAGES; i++) {
+        fake_page_allocated[i] = true;
+    }
+
+    uintptr_t pages[8];
+    munit_assert_uint64(process_pages_alloc(&proc, &dummy_region, pages, 8, NULL), ==, 4);
+
+    // All owned, and individually freeable
+    for (int i = 0; i < 4; i++) {
+        munit_assert_uint64(fake_owner[i], ==, 3);
+    }
+
+    munit_assert_true(process_page_free(&proc, pages[2]));
+    munit_assert_false(fake_page_allocated[2]);
+
+    process_release_owned_pages(&proc);
+
+    for (int i = 0; i < 4; i++) {
+        munit_assert_false(fake_page_allocated[i]);
+    }
+
+    munit_assert_uint64(process_pages_alloc(NULL, &dummy_region, pages, 8, NULL), ==, 0);
+
+    return MUNIT_OK;
+}
+
+static MunitResult test_pages_alloc_zeroed_first(const MunitParameter params[], void *data) {
+    (void)params;
+    (void)data;
+    reset_fakes();
+
+    SpinLock lock = {0};
+    ProcessMemoryInfo memory_info = {
+            .pages_lock = &lock,
+            .pages = NULL,
+    };
+    Process proc = {
+            .pid = 4,
+            .meminfo = &memory_info,
+    };
+
+    fake_zeroed_available = 3;
+
+    uintptr_t pages[8];
+    uint64_t zeroed = 0;
+    munit_assert_uint64(process_pages_alloc(&proc, &dummy_region, pages, 8, &zeroed), ==, 8);
+
+    // Zeroed ones first, then the rest as usual - all owned
+    munit_assert_uint64(zeroed, ==, 3);
+    munit_assert_uint64(fake_zeroed_available, ==, 0);
+
+    for (int i = 0; i < 8; i++) {
+        munit_assert_uint64(fake_owner[i], ==, 4);
+    }
+
+    process_release_owned_pages(&proc);
+    return MUNIT_OK;
+}
+
 static MunitTest tests[] = {
         {"/alloc_free", test_process_page_alloc_free, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL},
         {"/ownership_tracking", test_ownership_tracking, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL},
@@ -393,6 +528,8 @@ static MunitTest tests[] = {
         {"/shared_refcount", test_shared_pages_refcounting, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL},
         {"/double_free", test_double_free_is_safe, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL},
         {"/alloc_failure", test_alloc_failure_handling, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL},
+        {"/pages_alloc_batch", test_pages_alloc_batch, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL},
+        {"/pages_alloc_zeroed_first", test_pages_alloc_zeroed_first, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL},
         {"/block_expansion", test_block_expansion, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL},
         {"/concurrent_allocs", test_concurrent_allocs, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL},
         {"/stress_concurrent_alloc_release", test_stress_concurrent_alloc_and_release, NULL, NULL,
@@ -56,12 +56,16 @@ static MunitResult test_process_init_and_create(const MunitParameter params[], v
     munit_assert_uint64(p->pml4, ==, 0x12345000);
     munit_assert_ptr_null(p->meminfo->res_head);
     munit_assert_ptr_null(p->meminfo->res_tail);
+    munit_assert_ptr_not_null(p->cpus);
+    munit_assert_int(cpu_mask_count(&p->cpus->cpu_mask), ==, 0);
+    munit_assert_int(cpu_mask_count(&p->cpus->tlb_stale_mask), ==, 0);
 
-    // 1 for Process, one for ProcessMemoryInfo, one for lock
-    munit_assert_int(mock_slab_get_alloc_count(), ==, 3);
+    // 1 for Process, one for ProcessMemoryInfo, one for lock, one for ProcessCpus
+    munit_assert_int(mock_slab_get_alloc_count(), ==, 4);
 
     slab_free(p->meminfo->pages_lock);
     slab_free(p->meminfo);
+    slab_free(p->cpus);
     slab_free((void *)p);
 
     return MUNIT_OK;
@@ -100,7 +104,7 @@ static MunitResult test_process_destroy(const MunitParameter params[], void *dat
     // Check that resources were freed
     munit_assert_ptr_equal(freed_resources_head, resources);
     munit_assert_int(mock_slab_get_free_count(), ==,
-                     3); // 1 for process, 1 for meminfo 1 for task
+                     4); // 1 for process, 1 for meminfo, 1 for lock, 1 for cpus
 
     return MUNIT_OK;
 }
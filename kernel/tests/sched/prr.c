@@ -10,8 +10,11 @@
 #include "munit.h"
 
 #include "fba/alloc.h"
+#include "mock_ipwi.h"
+#include "mock_machine.h"
 #include "mock_pagetables.h"
 #include "mock_pmm.h"
+#include "mock_spinlock.h"
 #include "mock_task.h"
 #include "sched.h"
 #include "slab/alloc.h"
@@ -22,6 +25,10 @@
 
 static const int PAGES_PER_SLAB = BYTES_PER_SLAB / VM_PAGE_SIZE;
 
+// sched_init sets up one page of run queue levels for each of the four
+// classes, for every CPU
+static const int RUN_QUEUE_PAGES = 4 * (sizeof(__test_cpu_state) / sizeof(__test_cpu_state[0]));
+
 static const uintptr_t TEST_PAGETABLE_ROOT = 0x1234567887654321;
 static const uintptr_t TEST_SYS_SP = 0xc0c010c0a1b2c3d4;
 static const uintptr_t TEST_SYS_FUNC = 0x2bad3bad4badf00d;
@@ -32,6 +39,9 @@ void kernel_thread_entrypoint(void);
 
 Task *test_sched_prr_get_runnable_head(TaskClass level);
 Task *test_sched_prr_set_runnable_head(TaskClass level, Task *task);
+Task *test_sched_prr_pop_runnable_head(TaskClass level);
+void test_sched_prr_set_load(uint16_t cpu_num, uint64_t load);
+void test_sched_prr_set_running_class(uint16_t cpu_num, TaskClass class);
 
 uintptr_t get_pagetable_root() { return TEST_PAGETABLE_ROOT; }
 noreturn void task_current_exitpoint(void) {
@@ -48,6 +58,10 @@ static char *mock_tss[256];
 void panic_sloc(char *msg) { /* nothing */ }
 void process_release_owned_pages(Process *process) { /* nothing */ }
 
+// The idle thread zeroes pages for the pool, but there never is one here
+void *vmm_phys_to_virt_ptr(uintptr_t phys_addr) { return (void *)phys_addr; }
+void *memclr_page_nt(void *dest) { return dest; }
+
 static inline void *slab_area_base(void *page_area_ptr) {
     // skip one page used by FBA, and three unused by slab alignment
     return (void *)((uint64_t)page_area_ptr + 0x4000);
@@ -87,8 +101,9 @@ static MunitResult test_sched_init_with_ssp(const MunitParameter params[], void
     munit_assert_not_null(task);
     munit_assert_null(task->this.next);
 
-    // We should have allocated overhead (FBA + Slab), plus a slab for the blocks we needed
-    munit_assert_uint32(mock_pmm_get_total_page_allocs(), ==, PAGES_PER_SLAB + 2);
+    // We should have allocated overhead (FBA + Slab), plus a slab for the blocks we needed,
+    // plus the run queues for each CPU
+    munit_assert_uint32(mock_pmm_get_total_page_allocs(), ==, PAGES_PER_SLAB + 2 + RUN_QUEUE_PAGES);
 
     // Process is at the base of the slab area, plus 192 bytes (Slab* is at the
     // base, then spinlock, then ProcessMemoryInfo)
@@ -131,8 +146,9 @@ static MunitResult test_sched_init_with_all(const MunitParameter params[], void
     munit_assert_not_null(task);
     munit_assert_null(task->this.next);
 
-    // We should have allocated overhead (FBA + Slab), plus a slab for the blocks we needed
-    munit_assert_uint32(mock_pmm_get_total_page_allocs(), ==, PAGES_PER_SLAB + 2);
+    // We should have allocated overhead (FBA + Slab), plus a slab for the blocks we needed,
+    // plus the run queues for each CPU
+    munit_assert_uint32(mock_pmm_get_total_page_allocs(), ==, PAGES_PER_SLAB + 2 + RUN_QUEUE_PAGES);
 
     // Process is at the base of the slab area, plus 192 bytes (Slab* is at the
     // base, then spinlock, then ProcessMemoryInfo)
@@ -173,8 +189,9 @@ static MunitResult test_sched_init_with_realtime_prio(const MunitParameter param
     munit_assert_not_null(task);
     munit_assert_null(task->this.next);
 
-    // We should have allocated overhead (FBA + Slab), plus a slab for the blocks we needed
-    munit_assert_uint32(mock_pmm_get_total_page_allocs(), ==, PAGES_PER_SLAB + 2);
+    // We should have allocated overhead (FBA + Slab), plus a slab for the blocks we needed,
+    // plus the run queues for each CPU
+    munit_assert_uint32(mock_pmm_get_total_page_allocs(), ==, PAGES_PER_SLAB + 2 + RUN_QUEUE_PAGES);
 
     // Process is at the base of the slab area, plus 192 bytes (Slab* is at the
     // base, then spinlock, then ProcessMemoryInfo)
@@ -215,8 +232,9 @@ static MunitResult test_sched_init_with_high_prio(const MunitParameter params[],
     munit_assert_not_null(task);
     munit_assert_null(task->this.next);
 
-    // We should have allocated overhead (FBA + Slab), plus a slab for the blocks we needed
-    munit_assert_uint32(mock_pmm_get_total_page_allocs(), ==, PAGES_PER_SLAB + 2);
+    // We should have allocated overhead (FBA + Slab), plus a slab for the blocks we needed,
+    // plus the run queues for each CPU
+    munit_assert_uint32(mock_pmm_get_total_page_allocs(), ==, PAGES_PER_SLAB + 2 + RUN_QUEUE_PAGES);
 
     // Process is at the base of the slab area, plus 192 bytes (Slab* is at the
     // base, then spinlock, then ProcessMemoryInfo)
@@ -256,8 +274,9 @@ static MunitResult test_sched_init_with_idle_prio(const MunitParameter params[],
     munit_assert_not_null(task);
     munit_assert_null(task->this.next);
 
-    // We should have allocated overhead (FBA + Slab), plus a slab for the blocks we needed
-    munit_assert_uint32(mock_pmm_get_total_page_allocs(), ==, PAGES_PER_SLAB + 2);
+    // We should have allocated overhead (FBA + Slab), plus a slab for the blocks we needed,
+    // plus the run queues for each CPU
+    munit_assert_uint32(mock_pmm_get_total_page_allocs(), ==, PAGES_PER_SLAB + 2 + RUN_QUEUE_PAGES);
 
     // Process is at the base of the slab area, plus 192 bytes (Slab* is at the
     // base, then spinlock, then ProcessMemoryInfo)
@@ -323,6 +342,7 @@ static void init_task_for_test(Task *task, TaskSched *sched, TaskClass class, ui
     sched->ts_remain = ts_remain;
     sched->class = class;
     sched->prio = priority;
+    sched->status_flags = 0;
     task->sched = sched;
 }
 
@@ -491,7 +511,9 @@ static MunitResult test_sched_schedule_with_running_norm_current_and_two_queued(
     // And the original task is now queued at the end, after the norm task that was already there
     munit_assert_ptr_equal(test_sched_prr_get_runnable_head(TASK_CLASS_NORMAL), norm_queued_task);
 
-    munit_assert_ptr_equal(test_sched_prr_get_runnable_head(TASK_CLASS_NORMAL)->this.next, &original_task);
+    munit_assert_ptr_equal(test_sched_prr_pop_runnable_head(TASK_CLASS_NORMAL), norm_queued_task);
+    munit_assert_ptr_equal(test_sched_prr_pop_runnable_head(TASK_CLASS_NORMAL), &original_task);
+    munit_assert_null(test_sched_prr_get_runnable_head(TASK_CLASS_NORMAL));
 
     return MUNIT_OK;
 }
@@ -507,10 +529,12 @@ static MunitResult test_sched_schedule_with_running_norm_current_and_two_queued_
     bool result = sched_init(TEST_SYS_SP, sys_stack, TEST_SYS_FUNC, TEST_BOOT_FUNC, TEST_TASK_CLASS);
     munit_assert_true(result);
 
-    // Given we have one task in the NORMAL queue...
+    // Given we have one task in the NORMAL queue, requeued at its new priority...
     Task *norm_queued_task = test_sched_prr_get_runnable_head(TASK_CLASS_NORMAL);
+    test_sched_prr_set_runnable_head(TASK_CLASS_NORMAL, NULL);
     norm_queued_task->sched = &norm_sched;
     norm_queued_task->sched->prio = 127;
+    test_sched_prr_set_runnable_head(TASK_CLASS_NORMAL, norm_queued_task);
 
     // And one in the HIGH queue
     TaskSched high_queued_sched;
@@ -530,7 +554,8 @@ static MunitResult test_sched_schedule_with_running_norm_current_and_two_queued_
 
     // And the original task is now queued before the task with higher prio value
     munit_assert_ptr_equal(test_sched_prr_get_runnable_head(TASK_CLASS_NORMAL), &original_task);
-    munit_assert_ptr_equal(test_sched_prr_get_runnable_head(TASK_CLASS_NORMAL)->this.next, norm_queued_task);
+    munit_assert_ptr_equal(test_sched_prr_pop_runnable_head(TASK_CLASS_NORMAL), &original_task);
+    munit_assert_ptr_equal(test_sched_prr_pop_runnable_head(TASK_CLASS_NORMAL), norm_queued_task);
 
     return MUNIT_OK;
 }
@@ -649,6 +674,365 @@ static MunitResult test_sched_schedule_with_blocked_norm_current_and_one_idle_qu
     return MUNIT_OK;
 }
 
+static void init_idle_cpu_with_busy_sibling(Task *idle_task, TaskSched *idle_sched, Task *busy_tasks,
+                                            TaskSched *busy_scheds, int busy_count, uint64_t last_run) {
+    uintptr_t sys_stack = (uintptr_t)fba_alloc_block();
+
+    // This CPU has only an idle task queued, and one running...
+    bool result = sched_init(TEST_SYS_SP, sys_stack, TEST_SYS_FUNC, TEST_BOOT_FUNC, TASK_CLASS_IDLE);
+    munit_assert_true(result);
+
+    init_task_for_test(idle_task, idle_sched, TASK_CLASS_IDLE, 0, TASK_STATE_RUNNING, 100);
+    mock_task_set_curent(idle_task);
+
+    // ... while CPU #1 has a queue of normal tasks
+    for (int i = 0; i < busy_count; i++) {
+        init_task_for_test(&busy_tasks[i], &busy_scheds[i], TASK_CLASS_NORMAL, 0, TASK_STATE_READY, 0);
+        busy_scheds[i].last_run = last_run;
+        sched_unblock_on(&busy_tasks[i], &__test_cpu_state[1]);
+    }
+
+    mock_machine_set_upticks(100);
+}
+
+static MunitResult test_sched_balance_idle_steals(const MunitParameter params[], void *page_area_ptr) {
+    TaskSched idle_sched, busy_scheds[3];
+    Task idle_task, busy_tasks[3];
+
+    init_idle_cpu_with_busy_sibling(&idle_task, &idle_sched, busy_tasks, busy_scheds, 3, 0);
+
+    sched_schedule();
+
+    // The oldest queued task on the busy CPU was pulled over, and is now running here
+    munit_assert_ptr_equal(task_current(), &busy_tasks[0]);
+
+    SchedBalanceStats stats;
+    munit_assert_true(sched_get_balance_stats(0, &stats));
+    munit_assert_uint64(stats.steals, ==, 1);
+    munit_assert_uint64(stats.migrations, ==, 0);
+    munit_assert_uint64(stats.contended, ==, 0);
+
+    // Only ever one at a time
+    munit_assert_null(test_sched_prr_get_runnable_head(TASK_CLASS_NORMAL));
+
+    return MUNIT_OK;
+}
+
+static MunitResult test_sched_balance_idle_leaves_cache_hot(const MunitParameter params[], void *page_area_ptr) {
+    TaskSched idle_sched, busy_scheds[3];
+    Task idle_task, busy_tasks[3];
+
+    // Busy tasks ran on their CPU last tick
+    init_idle_cpu_with_busy_sibling(&idle_task, &idle_sched, busy_tasks, busy_scheds, 3, 99);
+
+    sched_schedule();
+
+    munit_assert_ptr_equal(task_current(), &idle_task);
+
+    SchedBalanceStats stats;
+    munit_assert_true(sched_get_balance_stats(0, &stats));
+    munit_assert_uint64(stats.steals, ==, 0);
+    munit_assert_uint64(stats.hot_skips, ==, 1);
+
+    // Once they've cooled off, they're fair game
+    mock_machine_set_upticks(200);
+    sched_schedule();
+
+    munit_assert_ptr_equal(task_current(), &busy_tasks[0]);
+
+    munit_assert_true(sched_get_balance_stats(0, &stats));
+    munit_assert_uint64(stats.steals, ==, 1);
+
+    return MUNIT_OK;
+}
+
+static MunitResult test_sched_balance_idle_contended(const MunitParameter params[], void *page_area_ptr) {
+    TaskSched idle_sched, busy_scheds[3];
+    Task idle_task, busy_tasks[3];
+
+    init_idle_cpu_with_busy_sibling(&idle_task, &idle_sched, busy_tasks, busy_scheds, 3, 0);
+
+    // Busy CPU is holding its lock, we mustn't wait for it
+    mock_spinlock_set_try_lock_fails(true);
+
+    sched_schedule();
+
+    munit_assert_ptr_equal(task_current(), &idle_task);
+
+    SchedBalanceStats stats;
+    munit_assert_true(sched_get_balance_stats(0, &stats));
+    munit_assert_uint64(stats.steals, ==, 0);
+    munit_assert_uint64(stats.contended, ==, 1);
+
+    mock_spinlock_set_try_lock_fails(false);
+
+    return MUNIT_OK;
+}
+
+static MunitResult test_sched_balance_busy_migrates(const MunitParameter params[], void *page_area_ptr) {
+    uintptr_t sys_stack = (uintptr_t)fba_alloc_block();
+
+    TaskSched current_sched, busy_scheds[4];
+    Task current_task, busy_tasks[4];
+
+    bool result = sched_init(TEST_SYS_SP, sys_stack, TEST_SYS_FUNC, TEST_BOOT_FUNC, TASK_CLASS_NORMAL);
+    munit_assert_true(result);
+
+    // This CPU is running a NORMAL task, and has the init task queued
+    init_task_for_test(&current_task, &current_sched, TASK_CLASS_NORMAL, 0, TASK_STATE_RUNNING, 100);
+    mock_task_set_curent(&current_task);
+
+    for (int i = 0; i < 4; i++) {
+        init_task_for_test(&busy_tasks[i], &busy_scheds[i], TASK_CLASS_NORMAL, 0, TASK_STATE_READY, 0);
+        sched_unblock_on(&busy_tasks[i], &__test_cpu_state[1]);
+    }
+
+    mock_machine_set_upticks(100);
+
+    // Sibling hasn't been busy for long enough yet
+    sched_schedule();
+
+    SchedBalanceStats stats;
+    munit_assert_true(sched_get_balance_stats(0, &stats));
+    munit_assert_uint64(stats.migrations, ==, 0);
+
+    // Now it has
+    test_sched_prr_set_load(1, 4 << SCHED_LOAD_SHIFT);
+    mock_machine_set_upticks(200);
+    sched_schedule();
+
+    munit_assert_true(sched_get_balance_stats(0, &stats));
+    munit_assert_uint64(stats.migrations, ==, 1);
+    munit_assert_uint64(stats.steals, ==, 0);
+
+    // We're not idle, so current keeps running and the pulled task queues behind init
+    munit_assert_ptr_equal(task_current(), &current_task);
+    test_sched_prr_pop_runnable_head(TASK_CLASS_NORMAL);
+    munit_assert_ptr_equal(test_sched_prr_get_runnable_head(TASK_CLASS_NORMAL), &busy_tasks[0]);
+
+    // And we don't look again until the balance interval is up
+    sched_schedule();
+
+    munit_assert_true(sched_get_balance_stats(0, &stats));
+    munit_assert_uint64(stats.migrations, ==, 1);
+
+    return MUNIT_OK;
+}
+
+static MunitResult test_sched_balance_stats_bad_cpu(const MunitParameter params[], void *page_area_ptr) {
+    SchedBalanceStats stats;
+
+    // Not initialized yet
+    munit_assert_false(sched_get_balance_stats(0, &stats));
+
+    uintptr_t sys_stack = (uintptr_t)fba_alloc_block();
+    munit_assert_true(sched_init(TEST_SYS_SP, sys_stack, TEST_SYS_FUNC, TEST_BOOT_FUNC, TASK_CLASS_NORMAL));
+
+    munit_assert_true(sched_get_balance_stats(3, &stats));
+    munit_assert_false(sched_get_balance_stats(4, &stats));
+    munit_assert_false(sched_get_balance_stats(0, NULL));
+
+    return MUNIT_OK;
+}
+
+static void init_for_remote_unblock(void) {
+    uintptr_t sys_stack = (uintptr_t)fba_alloc_block();
+    munit_assert_true(sched_init(TEST_SYS_SP, sys_stack, TEST_SYS_FUNC, TEST_BOOT_FUNC, TASK_CLASS_NORMAL));
+
+    for (int i = 0; i < 4; i++) {
+        __test_cpu_state[i].cpu_id = i;
+    }
+}
+
+static MunitResult test_sched_unblock_remote_kicks_idle(const MunitParameter params[], void *page_area_ptr) {
+    TaskSched sched;
+    Task task;
+
+    init_for_remote_unblock();
+    test_sched_prr_set_running_class(1, TASK_CLASS_IDLE);
+
+    init_task_for_test(&task, &sched, TASK_CLASS_NORMAL, 0, TASK_STATE_BLOCKED, 0);
+    sched_unblock_on(&task, &__test_cpu_state[1]);
+
+    munit_assert_uint32(mock_ipwi_get_reschedule_count(1), ==, 1);
+
+    return MUNIT_OK;
+}
+
+static MunitResult test_sched_unblock_remote_kicks_lower_class(const MunitParameter params[], void *page_area_ptr) {
+    TaskSched sched;
+    Task task;
+
+    init_for_remote_unblock();
+    test_sched_prr_set_running_class(2, TASK_CLASS_NORMAL);
+
+    init_task_for_test(&task, &sched, TASK_CLASS_REALTIME, 0, TASK_STATE_BLOCKED, 0);
+    sched_unblock_on(&task, &__test_cpu_state[2]);
+
+    munit_assert_uint32(mock_ipwi_get_reschedule_count(2), ==, 1);
+
+    return MUNIT_OK;
+}
+
+static MunitResult test_sched_unblock_remote_same_class_no_kick(const MunitParameter params[], void *page_area_ptr) {
+    TaskSched sched;
+    Task task;
+
+    init_for_remote_unblock();
+    test_sched_prr_set_running_class(1, TASK_CLASS_HIGH);
+
+    // Won't preempt, so it can wait for the next tick there
+    init_task_for_test(&task, &sched, TASK_CLASS_HIGH, 0, TASK_STATE_BLOCKED, 0);
+    sched_unblock_on(&task, &__test_cpu_state[1]);
+
+    munit_assert_uint32(mock_ipwi_get_reschedule_count(1), ==, 0);
+
+    return MUNIT_OK;
+}
+
+static MunitResult test_sched_unblock_local_no_kick(const MunitParameter params[], void *page_area_ptr) {
+    TaskSched sched;
+    Task task;
+
+    init_for_remote_unblock();
+
+    init_task_for_test(&task, &sched, TASK_CLASS_REALTIME, 0, TASK_STATE_BLOCKED, 0);
+    sched_unblock(&task);
+
+    for (int i = 0; i < 4; i++) {
+        munit_assert_uint32(mock_ipwi_get_reschedule_count(i), ==, 0);
+    }
+
+    return MUNIT_OK;
+}
+
+static MunitResult test_sched_unblock_remote_contended_deferred(const MunitParameter params[],
+                                                               void *page_area_ptr) {
+    TaskSched sched;
+    Task task;
+
+    init_for_remote_unblock();
+
+    init_task_for_test(&task, &sched, TASK_CLASS_NORMAL, 0, TASK_STATE_BLOCKED, 0);
+
+    // Woken from CPU 1 while CPU 0 holds its lock - mustn't wait for it
+    mock_spinlock_set_try_lock_fails(true);
+    __test_this_cpu = 1;
+    sched_unblock_remote(&task, &__test_cpu_state[0]);
+    __test_this_cpu = 0;
+    mock_spinlock_set_try_lock_fails(false);
+
+    // Left for CPU 0, which is kicked to come and get it
+    munit_assert_uint8(sched.state, ==, TASK_STATE_BLOCKED);
+    munit_assert_uint32(mock_ipwi_get_reschedule_count(0), ==, 1);
+
+    sched_schedule();
+
+    munit_assert_uint8(sched.state, !=, TASK_STATE_BLOCKED);
+    munit_assert_true(task_current() == &task || test_sched_prr_get_runnable_head(TASK_CLASS_NORMAL) == &task);
+
+    return MUNIT_OK;
+}
+
+static Task *init_for_handoff(void) {
+    uintptr_t sys_stack = (uintptr_t)fba_alloc_block();
+    munit_assert_true(sched_init(TEST_SYS_SP, sys_stack, TEST_SYS_FUNC, TEST_BOOT_FUNC, TASK_CLASS_NORMAL));
+
+    // The init task is left queued as NORMAL, to check handoff doesn't go through the queues
+    return test_sched_prr_get_runnable_head(TASK_CLASS_NORMAL);
+}
+
+static MunitResult test_sched_handoff_switches_directly(const MunitParameter params[], void *page_area_ptr) {
+    TaskSched sender_sched, receiver_sched;
+    Task sender, receiver;
+
+    Task *queued = init_for_handoff();
+
+    // Sender has blocked for its reply, receiver is waiting for it
+    init_task_for_test(&sender, &sender_sched, TASK_CLASS_NORMAL, 0, TASK_STATE_BLOCKED, 7);
+    init_task_for_test(&receiver, &receiver_sched, TASK_CLASS_NORMAL, 0, TASK_STATE_BLOCKED, 0);
+    mock_task_set_curent(&sender);
+
+    sched_handoff(&receiver);
+
+    munit_assert_ptr_equal(task_current(), &receiver);
+    munit_assert_uint8(receiver_sched.state, ==, TASK_STATE_RUNNING);
+
+    // Receiver runs on what was left of the sender's slice
+    munit_assert_uint16(receiver_sched.ts_remain, ==, 7);
+
+    // Queue is untouched, and the sender isn't on it
+    munit_assert_ptr_equal(test_sched_prr_pop_runnable_head(TASK_CLASS_NORMAL), queued);
+    munit_assert_null(test_sched_prr_get_runnable_head(TASK_CLASS_NORMAL));
+
+    return MUNIT_OK;
+}
+
+static MunitResult test_sched_handoff_requeues_running(const MunitParameter params[], void *page_area_ptr) {
+    TaskSched replier_sched, waiter_sched;
+    Task replier, waiter;
+
+    Task *queued = init_for_handoff();
+
+    // Replier keeps running after the reply, waiter gets the CPU
+    init_task_for_test(&replier, &replier_sched, TASK_CLASS_NORMAL, 0, TASK_STATE_RUNNING, 5);
+    init_task_for_test(&waiter, &waiter_sched, TASK_CLASS_NORMAL, 0, TASK_STATE_BLOCKED, 0);
+    mock_task_set_curent(&replier);
+
+    sched_handoff(&waiter);
+
+    munit_assert_ptr_equal(task_current(), &waiter);
+    munit_assert_uint16(waiter_sched.ts_remain, ==, 5);
+    munit_assert_uint8(replier_sched.state, ==, TASK_STATE_READY);
+
+    munit_assert_ptr_equal(test_sched_prr_pop_runnable_head(TASK_CLASS_NORMAL), queued);
+    munit_assert_ptr_equal(test_sched_prr_pop_runnable_head(TASK_CLASS_NORMAL), &replier);
+
+    return MUNIT_OK;
+}
+
+static MunitResult test_sched_handoff_higher_class_queued(const MunitParameter params[], void *page_area_ptr) {
+    TaskSched sender_sched, receiver_sched, high_sched;
+    Task sender, receiver, high_task;
+
+    init_for_handoff();
+
+    init_task_for_test(&high_task, &high_sched, TASK_CLASS_HIGH, 0, TASK_STATE_READY, 0);
+    test_sched_prr_set_runnable_head(TASK_CLASS_HIGH, &high_task);
+
+    init_task_for_test(&sender, &sender_sched, TASK_CLASS_NORMAL, 0, TASK_STATE_BLOCKED, 7);
+    init_task_for_test(&receiver, &receiver_sched, TASK_CLASS_NORMAL, 0, TASK_STATE_BLOCKED, 0);
+    mock_task_set_curent(&sender);
+
+    sched_handoff(&receiver);
+
+    // Receiver has to wait its turn like anyone else
+    munit_assert_ptr_equal(task_current(), &high_task);
+    munit_assert_uint8(receiver_sched.state, ==, TASK_STATE_READY);
+
+    return MUNIT_OK;
+}
+
+static MunitResult test_sched_handoff_slice_expired(const MunitParameter params[], void *page_area_ptr) {
+    TaskSched sender_sched, receiver_sched;
+    Task sender, receiver;
+
+    Task *queued = init_for_handoff();
+
+    init_task_for_test(&sender, &sender_sched, TASK_CLASS_NORMAL, 0, TASK_STATE_BLOCKED, 0);
+    init_task_for_test(&receiver, &receiver_sched, TASK_CLASS_NORMAL, 0, TASK_STATE_BLOCKED, 0);
+    mock_task_set_curent(&sender);
+
+    sched_handoff(&receiver);
+
+    // Nothing to donate, so it's a regular schedule - receiver goes behind what's queued
+    munit_assert_ptr_equal(task_current(), queued);
+    munit_assert_uint8(receiver_sched.state, ==, TASK_STATE_READY);
+    munit_assert_ptr_equal(test_sched_prr_get_runnable_head(TASK_CLASS_NORMAL), &receiver);
+
+    return MUNIT_OK;
+}
+
 #define TEST_PML4_ADDR (((uint64_t *)0x100000))
 #define TEST_PAGE_COUNT ((32768))
 
@@ -662,6 +1046,9 @@ static void *test_setup(const MunitParameter params[], void *user_data) {
 static void test_teardown(void *page_area_ptr) {
     free(page_area_ptr);
     mock_pmm_reset();
+    mock_spinlock_reset();
+    mock_machine_reset();
+    mock_ipwi_reset();
 }
 
 static MunitTest test_suite_tests[] = {
@@ -710,6 +1097,40 @@ static MunitTest test_suite_tests[] = {
          test_sched_schedule_with_running_norm_current_and_two_queued_diff_prio, test_setup, test_teardown,
          MUNIT_TEST_OPTION_NONE, NULL},
 
+        // Load balancing
+        {(char *)"/balance_idle_steals", test_sched_balance_idle_steals, test_setup, test_teardown,
+         MUNIT_TEST_OPTION_NONE, NULL},
+        {(char *)"/balance_idle_leaves_cache_hot", test_sched_balance_idle_leaves_cache_hot, test_setup, test_teardown,
+         MUNIT_TEST_OPTION_NONE, NULL},
+        {(char *)"/balance_idle_contended", test_sched_balance_idle_contended, test_setup, test_teardown,
+         MUNIT_TEST_OPTION_NONE, NULL},
+        {(char *)"/balance_busy_migrates", test_sched_balance_busy_migrates, test_setup, test_teardown,
+         MUNIT_TEST_OPTION_NONE, NULL},
+        {(char *)"/balance_stats_bad_cpu", test_sched_balance_stats_bad_cpu, test_setup, test_teardown,
+         MUNIT_TEST_OPTION_NONE, NULL},
+
+        // Remote wakeups
+        {(char *)"/unblock_remote_kicks_idle", test_sched_unblock_remote_kicks_idle, test_setup, test_teardown,
+         MUNIT_TEST_OPTION_NONE, NULL},
+        {(char *)"/unblock_remote_kicks_lower_class", test_sched_unblock_remote_kicks_lower_class, test_setup,
+         test_teardown, MUNIT_TEST_OPTION_NONE, NULL},
+        {(char *)"/unblock_remote_same_class_no_kick", test_sched_unblock_remote_same_class_no_kick, test_setup,
+         test_teardown, MUNIT_TEST_OPTION_NONE, NULL},
+        {(char *)"/unblock_local_no_kick", test_sched_unblock_local_no_kick, test_setup, test_teardown,
+         MUNIT_TEST_OPTION_NONE, NULL},
+        {(char *)"/unblock_remote_contended_deferred", test_sched_unblock_remote_contended_deferred, test_setup,
+         test_teardown, MUNIT_TEST_OPTION_NONE, NULL},
+
+        // IPC handoff
+        {(char *)"/handoff_switches_directly", test_sched_handoff_switches_directly, test_setup, test_teardown,
+         MUNIT_TEST_OPTION_NONE, NULL},
+        {(char *)"/handoff_requeues_running", test_sched_handoff_requeues_running, test_setup, test_teardown,
+         MUNIT_TEST_OPTION_NONE, NULL},
+        {(char *)"/handoff_higher_class_queued", test_sched_handoff_higher_class_queued, test_setup, test_teardown,
+         MUNIT_TEST_OPTION_NONE, NULL},
+        {(char *)"/handoff_slice_expired", test_sched_handoff_slice_expired, test_setup, test_teardown,
+         MUNIT_TEST_OPTION_NONE, NULL},
+
         {NULL, NULL, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL},
 };
 
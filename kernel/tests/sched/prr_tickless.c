@@ -0,0 +1,341 @@
+/*
+ * Tests for prioritised round-robin scheduler, with EXPERIMENTAL_TICKLESS
+ * anos - An Operating System
+ *
+ * Copyright (c) 2025 Ross Bamford
+ */
+
+#include <stdbool.h>
+
+#include "munit.h"
+
+#include "config.h"
+#include "fba/alloc.h"
+#include "mock_ipwi.h"
+#include "mock_machine.h"
+#include "mock_pagetables.h"
+#include "mock_pmm.h"
+#include "mock_spinlock.h"
+#include "mock_task.h"
+#include "sched.h"
+#include "sleep_queue.h"
+#include "smp/state.h"
+#include "task.h"
+
+#define TEST_PML4_ADDR (((uint64_t *)0x100000))
+#define TEST_PAGE_COUNT ((32768))
+
+#define TEST_NOW ((1000))
+#define SLICE_NANOS (((uint64_t)DEFAULT_TIMESLICE * NANOS_PER_TICK))
+
+static const uintptr_t TEST_PAGETABLE_ROOT = 0x1234567887654321;
+static const uintptr_t TEST_SYS_SP = 0xc0c010c0a1b2c3d4;
+static const uintptr_t TEST_SYS_FUNC = 0x2bad3bad4badf00d;
+static const uintptr_t TEST_BOOT_FUNC = 0x1010101020101020;
+
+Task *test_sched_prr_get_runnable_head(TaskClass level);
+void test_sched_prr_set_running_class(uint16_t cpu_num, TaskClass class);
+
+uintptr_t get_pagetable_root() { return TEST_PAGETABLE_ROOT; }
+noreturn void task_current_exitpoint(void) {
+    while (1)
+        ;
+}
+
+void platform_cleanup_process(uint64_t pid) {
+    // nothing
+}
+
+void panic_sloc(char *msg) { /* nothing */ }
+void process_release_owned_pages(Process *process) { /* nothing */ }
+
+// The idle thread zeroes pages for the pool, but there never is one here
+void *vmm_phys_to_virt_ptr(uintptr_t phys_addr) { return (void *)phys_addr; }
+void *memclr_page_nt(void *dest) { return dest; }
+
+static void init_task_for_test(Task *task, TaskSched *sched, TaskClass class, TaskState state, uint16_t ts_remain) {
+    sched->state = state;
+    sched->ts_remain = ts_remain;
+    sched->class = class;
+    sched->prio = 0;
+    sched->status_flags = 0;
+    task->sched = sched;
+}
+
+// Leaves `queued` running, with a fresh slice that started at TEST_NOW, and `running` queued behind it
+static Task *init_two_normal_tasks(Task *running, TaskSched *running_sched, TaskSched *queued_sched) {
+    uintptr_t sys_stack = (uintptr_t)fba_alloc_block();
+
+    munit_assert_true(sched_init(TEST_SYS_SP, sys_stack, TEST_SYS_FUNC, TEST_BOOT_FUNC, TASK_CLASS_NORMAL));
+
+    Task *queued = test_sched_prr_get_runnable_head(TASK_CLASS_NORMAL);
+    queued->sched = queued_sched;
+    queued->sched->class = TASK_CLASS_NORMAL;
+
+    init_task_for_test(running, running_sched, TASK_CLASS_NORMAL, TASK_STATE_RUNNING, 0);
+    mock_task_set_curent(running);
+    mock_machine_set_nanos(TEST_NOW);
+
+    sched_schedule();
+    munit_assert_ptr_equal(task_current(), queued);
+
+    return queued;
+}
+
+static MunitResult test_idle_is_capped(const MunitParameter params[], void *page_area_ptr) {
+    uintptr_t sys_stack = (uintptr_t)fba_alloc_block();
+    TaskSched idle_sched;
+    Task idle_task;
+
+    munit_assert_true(sched_init(TEST_SYS_SP, sys_stack, TEST_SYS_FUNC, TEST_BOOT_FUNC, TASK_CLASS_IDLE));
+
+    init_task_for_test(&idle_task, &idle_sched, TASK_CLASS_IDLE, TASK_STATE_RUNNING, DEFAULT_TIMESLICE);
+    mock_task_set_curent(&idle_task);
+    mock_machine_set_nanos(TEST_NOW);
+
+    sched_schedule();
+
+    // Nothing to wake or preempt for, so we only hear from the timer at the idle cap
+    munit_assert_ptr_equal(task_current(), &idle_task);
+    munit_assert_uint32(mock_machine_oneshot_count(), ==, 1);
+    munit_assert_uint64(mock_machine_last_oneshot_nanos(), ==, TICKLESS_MAX_IDLE_NANOS);
+
+    return MUNIT_OK;
+}
+
+static MunitResult test_idle_wakes_for_sleeper(const MunitParameter params[], void *page_area_ptr) {
+    uintptr_t sys_stack = (uintptr_t)fba_alloc_block();
+    TaskSched idle_sched;
+    Task idle_task, sleeper;
+
+    munit_assert_true(sched_init(TEST_SYS_SP, sys_stack, TEST_SYS_FUNC, TEST_BOOT_FUNC, TASK_CLASS_IDLE));
+
+    init_task_for_test(&idle_task, &idle_sched, TASK_CLASS_IDLE, TASK_STATE_RUNNING, DEFAULT_TIMESLICE);
+    mock_task_set_curent(&idle_task);
+    mock_machine_set_nanos(TEST_NOW);
+
+    // Well under a tick away
+    munit_assert_true(sleep_queue_enqueue(&__test_cpu_state[0].sleep_queue, &sleeper, TEST_NOW + 250000));
+
+    sched_schedule();
+
+    munit_assert_uint32(mock_machine_oneshot_count(), ==, 1);
+    munit_assert_uint64(mock_machine_last_oneshot_nanos(), ==, 250000);
+
+    return MUNIT_OK;
+}
+
+static MunitResult test_overdue_sleeper_fires_now(const MunitParameter params[], void *page_area_ptr) {
+    uintptr_t sys_stack = (uintptr_t)fba_alloc_block();
+    TaskSched idle_sched;
+    Task idle_task, sleeper;
+
+    munit_assert_true(sched_init(TEST_SYS_SP, sys_stack, TEST_SYS_FUNC, TEST_BOOT_FUNC, TASK_CLASS_IDLE));
+
+    init_task_for_test(&idle_task, &idle_sched, TASK_CLASS_IDLE, TASK_STATE_RUNNING, DEFAULT_TIMESLICE);
+    mock_task_set_curent(&idle_task);
+    mock_machine_set_nanos(TEST_NOW);
+
+    munit_assert_true(sleep_queue_enqueue(&__test_cpu_state[0].sleep_queue, &sleeper, TEST_NOW - 1));
+
+    sched_schedule();
+
+    munit_assert_uint64(mock_machine_last_oneshot_nanos(), ==, 0);
+
+    return MUNIT_OK;
+}
+
+static MunitResult test_contended_fires_at_slice_end(const MunitParameter params[], void *page_area_ptr) {
+    TaskSched running_sched, queued_sched;
+    Task running;
+
+    init_two_normal_tasks(&running, &running_sched, &queued_sched);
+
+    // Someone is waiting for the new task's slice, so the timer is set for the end of it
+    munit_assert_uint32(mock_machine_oneshot_count(), ==, 1);
+    munit_assert_uint64(mock_machine_last_oneshot_nanos(), ==, SLICE_NANOS);
+
+    return MUNIT_OK;
+}
+
+static MunitResult test_uncontended_is_capped(const MunitParameter params[], void *page_area_ptr) {
+    uintptr_t sys_stack = (uintptr_t)fba_alloc_block();
+    TaskSched running_sched, queued_sched;
+    Task running;
+
+    munit_assert_true(sched_init(TEST_SYS_SP, sys_stack, TEST_SYS_FUNC, TEST_BOOT_FUNC, TASK_CLASS_NORMAL));
+
+    Task *queued = test_sched_prr_get_runnable_head(TASK_CLASS_NORMAL);
+    queued->sched = &queued_sched;
+    queued->sched->class = TASK_CLASS_NORMAL;
+
+    // The current task blocks, so only the new one is left to run
+    init_task_for_test(&running, &running_sched, TASK_CLASS_NORMAL, TASK_STATE_BLOCKED, 0);
+    mock_task_set_curent(&running);
+    mock_machine_set_nanos(TEST_NOW);
+
+    sched_schedule();
+
+    munit_assert_ptr_equal(task_current(), queued);
+    munit_assert_uint64(mock_machine_last_oneshot_nanos(), ==, TICKLESS_MAX_IDLE_NANOS);
+
+    return MUNIT_OK;
+}
+
+static MunitResult test_slice_charged_by_elapsed_time(const MunitParameter params[], void *page_area_ptr) {
+    TaskSched running_sched, queued_sched;
+    Task running;
+
+    Task *queued = init_two_normal_tasks(&running, &running_sched, &queued_sched);
+
+    // An early interrupt (some other reason) two-and-a-bit ticks in...
+    mock_machine_set_nanos(TEST_NOW + 2 * NANOS_PER_TICK + 5);
+    sched_schedule();
+
+    // ... charges two ticks, and re-arms for the (unchanged) end of the slice
+    munit_assert_ptr_equal(task_current(), queued);
+    munit_assert_uint16(queued_sched.ts_remain, ==, DEFAULT_TIMESLICE - 2);
+    munit_assert_uint64(mock_machine_last_oneshot_nanos(), ==, SLICE_NANOS - 2 * NANOS_PER_TICK - 5);
+
+    // And when that fires, the slice is used up
+    mock_machine_set_nanos(TEST_NOW + SLICE_NANOS);
+    sched_schedule();
+
+    munit_assert_ptr_equal(task_current(), &running);
+    munit_assert_ptr_equal(test_sched_prr_get_runnable_head(TASK_CLASS_NORMAL), queued);
+
+    return MUNIT_OK;
+}
+
+static MunitResult test_local_unblock_preempts_now(const MunitParameter params[], void *page_area_ptr) {
+    TaskSched running_sched, queued_sched, high_sched;
+    Task running, high_task;
+
+    init_two_normal_tasks(&running, &running_sched, &queued_sched);
+
+    init_task_for_test(&high_task, &high_sched, TASK_CLASS_HIGH, TASK_STATE_BLOCKED, 0);
+    sched_unblock(&high_task);
+
+    // Higher class than what's running, so the timer is brought right in
+    munit_assert_uint32(mock_machine_oneshot_count(), ==, 2);
+    munit_assert_uint64(mock_machine_last_oneshot_nanos(), ==, 0);
+
+    return MUNIT_OK;
+}
+
+static MunitResult test_local_unblock_same_class_leaves_timer(const MunitParameter params[], void *page_area_ptr) {
+    TaskSched running_sched, queued_sched, other_sched;
+    Task running, other_task;
+
+    init_two_normal_tasks(&running, &running_sched, &queued_sched);
+
+    init_task_for_test(&other_task, &other_sched, TASK_CLASS_NORMAL, TASK_STATE_BLOCKED, 0);
+    sched_unblock(&other_task);
+
+    // Just joins the queue for the end of the slice, already armed for that
+    munit_assert_uint32(mock_machine_oneshot_count(), ==, 1);
+
+    return MUNIT_OK;
+}
+
+static MunitResult test_remote_unblock_leaves_timer(const MunitParameter params[], void *page_area_ptr) {
+    TaskSched running_sched, queued_sched, high_sched;
+    Task running, high_task;
+
+    init_two_normal_tasks(&running, &running_sched, &queued_sched);
+
+    init_task_for_test(&high_task, &high_sched, TASK_CLASS_HIGH, TASK_STATE_BLOCKED, 0);
+    sched_unblock_on(&high_task, &__test_cpu_state[1]);
+
+    // Not our timer to program...
+    munit_assert_uint32(mock_machine_oneshot_count(), ==, 1);
+
+    return MUNIT_OK;
+}
+
+static MunitResult test_remote_unblock_kicks_uncontended(const MunitParameter params[], void *page_area_ptr) {
+    TaskSched running_sched, queued_sched, scheds[2];
+    Task running, tasks[2];
+
+    init_two_normal_tasks(&running, &running_sched, &queued_sched);
+    __test_cpu_state[1].cpu_id = 1;
+    test_sched_prr_set_running_class(1, TASK_CLASS_NORMAL);
+
+    // Same class as what's running there, but its timer doesn't know anyone's waiting...
+    init_task_for_test(&tasks[0], &scheds[0], TASK_CLASS_NORMAL, TASK_STATE_BLOCKED, 0);
+    sched_unblock_on(&tasks[0], &__test_cpu_state[1]);
+    munit_assert_uint32(mock_ipwi_get_reschedule_count(1), ==, 1);
+
+    // ... but now there's a queue, its slice deadline already covers this one
+    init_task_for_test(&tasks[1], &scheds[1], TASK_CLASS_NORMAL, TASK_STATE_BLOCKED, 0);
+    sched_unblock_on(&tasks[1], &__test_cpu_state[1]);
+    munit_assert_uint32(mock_ipwi_get_reschedule_count(1), ==, 1);
+
+    return MUNIT_OK;
+}
+
+static MunitResult test_handoff_keeps_slice_deadline(const MunitParameter params[], void *page_area_ptr) {
+    TaskSched running_sched, queued_sched, receiver_sched;
+    Task running, receiver;
+
+    Task *sender = init_two_normal_tasks(&running, &running_sched, &queued_sched);
+
+    // Three ticks into its slice, the sender blocks and hands off
+    mock_machine_set_nanos(TEST_NOW + 3 * NANOS_PER_TICK);
+    sched_block(sender);
+
+    init_task_for_test(&receiver, &receiver_sched, TASK_CLASS_NORMAL, TASK_STATE_BLOCKED, 0);
+    sched_handoff(&receiver);
+
+    // Receiver only gets what was left, and the timer still fires at the original slice end
+    munit_assert_ptr_equal(task_current(), &receiver);
+    munit_assert_uint16(receiver_sched.ts_remain, ==, DEFAULT_TIMESLICE - 3);
+    munit_assert_uint32(mock_machine_oneshot_count(), ==, 2);
+    munit_assert_uint64(mock_machine_last_oneshot_nanos(), ==, SLICE_NANOS - 3 * NANOS_PER_TICK);
+
+    return MUNIT_OK;
+}
+
+static void *test_setup(const MunitParameter params[], void *user_data) {
+    void *page_area_ptr;
+    posix_memalign(&page_area_ptr, 0x40000, TEST_PAGE_COUNT << 12);
+    fba_init(TEST_PML4_ADDR, (uintptr_t)page_area_ptr, 32768);
+    return page_area_ptr;
+}
+
+static void test_teardown(void *page_area_ptr) {
+    free(page_area_ptr);
+    mock_pmm_reset();
+    mock_spinlock_reset();
+    mock_machine_reset();
+    mock_ipwi_reset();
+}
+
+static MunitTest test_suite_tests[] = {
+        {(char *)"/idle_is_capped", test_idle_is_capped, test_setup, test_teardown, MUNIT_TEST_OPTION_NONE, NULL},
+        {(char *)"/idle_wakes_for_sleeper", test_idle_wakes_for_sleeper, test_setup, test_teardown,
+         MUNIT_TEST_OPTION_NONE, NULL},
+        {(char *)"/overdue_sleeper_fires_now", test_overdue_sleeper_fires_now, test_setup, test_teardown,
+         MUNIT_TEST_OPTION_NONE, NULL},
+        {(char *)"/contended_fires_at_slice_end", test_contended_fires_at_slice_end, test_setup, test_teardown,
+         MUNIT_TEST_OPTION_NONE, NULL},
+        {(char *)"/uncontended_is_capped", test_uncontended_is_capped, test_setup, test_teardown,
+         MUNIT_TEST_OPTION_NONE, NULL},
+        {(char *)"/slice_charged_by_elapsed_time", test_slice_charged_by_elapsed_time, test_setup, test_teardown,
+         MUNIT_TEST_OPTION_NONE, NULL},
+        {(char *)"/local_unblock_preempts_now", test_local_unblock_preempts_now, test_setup, test_teardown,
+         MUNIT_TEST_OPTION_NONE, NULL},
+        {(char *)"/local_unblock_same_class_leaves_timer", test_local_unblock_same_class_leaves_timer, test_setup,
+         test_teardown, MUNIT_TEST_OPTION_NONE, NULL},
+        {(char *)"/remote_unblock_leaves_timer", test_remote_unblock_leaves_timer, test_setup, test_teardown,
+         MUNIT_TEST_OPTION_NONE, NULL},
+        {(char *)"/handoff_keeps_slice_deadline", test_handoff_keeps_slice_deadline, test_setup, test_teardown,
+         MUNIT_TEST_OPTION_NONE, NULL},
+        {(char *)"/remote_unblock_kicks_uncontended", test_remote_unblock_kicks_uncontended, test_setup, test_teardown,
+         MUNIT_TEST_OPTION_NONE, NULL},
+        {NULL, NULL, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL}};
+
+static const MunitSuite test_suite = {(char *)"/sched/prr_tickless", test_suite_tests, NULL, 1,
+                                      MUNIT_SUITE_OPTION_NONE};
+
+int main(int argc, char *argv[]) { return munit_suite_main(&test_suite, NULL, argc, argv); }
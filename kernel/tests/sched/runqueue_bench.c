@@ -0,0 +1,147 @@
+/*
+ * Microbenchmark - TaskRunQueue vs TaskPriorityQueue
+ * anos - An Operating System
+ *
+ * Copyright (c) 2025 Ross Bamford
+ *
+ * Models the two things the scheduler does with its queues
+ * while holding the per-CPU sched lock:
+ *
+ *   requeue    - pop the next task, push the previous one back
+ *                (every tick where a timeslice expires)
+ *   fill_drain - a burst of wakeups followed by running them all
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "bench.h"
+#include "structs/pq.h"
+#include "structs/runqueue.h"
+
+#define MAX_TASKS 1024
+#define REQUEUE_OPS 2000000
+#define FILL_DRAIN_OPS 2000000
+
+static Task tasks[MAX_TASKS];
+static TaskSched scheds[MAX_TASKS];
+static TaskRunList levels[TASK_RQ_LEVELS];
+
+static const uint32_t task_counts[] = {8, 64, 256, 1024};
+
+static uint32_t rand_state = 0x2badf00d;
+
+static inline uint32_t next_rand(void) {
+    // xorshift32 - we just need something repeatable
+    rand_state ^= rand_state << 13;
+    rand_state ^= rand_state >> 17;
+    rand_state ^= rand_state << 5;
+    return rand_state;
+}
+
+static void init_tasks(uint32_t count) {
+    rand_state = 0x2badf00d;
+
+    for (int i = 0; i < count; i++) {
+        // Most tasks clustered around a few "typical" priorities, like real loads
+        scheds[i].prio = (next_rand() & 3) ? (next_rand() & 0x7) : (next_rand() & 0xff);
+        tasks[i].sched = &scheds[i];
+        tasks[i].this.next = NULL;
+    }
+}
+
+static void bench_pq_requeue(uint32_t count) {
+    TaskPriorityQueue pq;
+    task_pq_init(&pq);
+    init_tasks(count);
+
+    for (int i = 0; i < count; i++) {
+        task_pq_push(&pq, &tasks[i]);
+    }
+
+    const uint64_t start = bench_now_ns();
+    for (int i = 0; i < REQUEUE_OPS; i++) {
+        Task *task = task_pq_pop(&pq);
+        task_pq_push(&pq, task);
+    }
+    const uint64_t end = bench_now_ns();
+
+    bench_consume(task_pq_peek(&pq));
+    bench_report("sched/runqueue", "pq_requeue", "tasks", count, REQUEUE_OPS, end - start);
+}
+
+static void bench_rq_requeue(uint32_t count) {
+    TaskRunQueue rq;
+    task_rq_init(&rq, levels);
+    init_tasks(count);
+
+    for (int i = 0; i < count; i++) {
+        task_rq_push(&rq, &tasks[i]);
+    }
+
+    const uint64_t start = bench_now_ns();
+    for (int i = 0; i < REQUEUE_OPS; i++) {
+        Task *task = task_rq_pop(&rq);
+        task_rq_push(&rq, task);
+    }
+    const uint64_t end = bench_now_ns();
+
+    bench_consume(task_rq_peek(&rq));
+    bench_report("sched/runqueue", "rq_requeue", "tasks", count, REQUEUE_OPS, end - start);
+}
+
+static void bench_pq_fill_drain(uint32_t count) {
+    TaskPriorityQueue pq;
+    task_pq_init(&pq);
+    init_tasks(count);
+
+    const uint32_t rounds = FILL_DRAIN_OPS / (count * 2);
+
+    const uint64_t start = bench_now_ns();
+    for (int r = 0; r < rounds; r++) {
+        for (int i = 0; i < count; i++) {
+            task_pq_push(&pq, &tasks[i]);
+        }
+        for (int i = 0; i < count; i++) {
+            bench_consume(task_pq_pop(&pq));
+        }
+    }
+    const uint64_t end = bench_now_ns();
+
+    bench_report("sched/runqueue", "pq_fill_drain", "tasks", count, (uint64_t)rounds * count * 2, end - start);
+}
+
+static void bench_rq_fill_drain(uint32_t count) {
+    TaskRunQueue rq;
+    task_rq_init(&rq, levels);
+    init_tasks(count);
+
+    const uint32_t rounds = FILL_DRAIN_OPS / (count * 2);
+
+    const uint64_t start = bench_now_ns();
+    for (int r = 0; r < rounds; r++) {
+        for (int i = 0; i < count; i++) {
+            task_rq_push(&rq, &tasks[i]);
+        }
+        for (int i = 0; i < count; i++) {
+            bench_consume(task_rq_pop(&rq));
+        }
+    }
+    const uint64_t end = bench_now_ns();
+
+    bench_report("sched/runqueue", "rq_fill_drain", "tasks", count, (uint64_t)rounds * count * 2, end - start);
+}
+
+int main(int argc, char **argv) {
+    for (int i = 0; i < sizeof(task_counts) / sizeof(task_counts[0]); i++) {
+        bench_pq_requeue(task_counts[i]);
+        bench_rq_requeue(task_counts[i]);
+    }
+
+    for (int i = 0; i < sizeof(task_counts) / sizeof(task_counts[0]); i++) {
+        bench_pq_fill_drain(task_counts[i]);
+        bench_rq_fill_drain(task_counts[i]);
+    }
+
+    return 0;
+}
@@ -7,6 +7,7 @@
 
 #include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "munit.h"
 
@@ -15,6 +16,7 @@
 #include "mock_pmm.h"
 #include "mock_vmm.h"
 #include "slab/alloc.h"
+#include "smp/state.h"
 #include "vmm/vmconfig.h"
 
 #define TEST_PML4_ADDR (((uint64_t *)0x100000))
@@ -26,6 +28,7 @@ static void *test_setup(const MunitParameter params[], void *user_data) {
     void *page_area_ptr;
     posix_memalign(&page_area_ptr, 0x40000, TEST_PAGE_COUNT << 12);
     bool result = fba_init(TEST_PML4_ADDR, (uintptr_t)page_area_ptr, 32768);
+    memset(&__test_cpu_state[0].slab_cache, 0, sizeof(PerCPUSlabCache));
     return page_area_ptr;
 }
 
@@ -452,6 +455,235 @@ static MunitResult test_slab_free_from_full(const MunitParameter params[], void
     return MUNIT_OK;
 }
 
+static MunitResult test_slab_alloc_size_classes(const MunitParameter params[], void *page_area_ptr) {
+    munit_assert_null(slab_alloc(0));
+    munit_assert_null(slab_alloc(SLAB_MAX_BLOCK_SIZE + 1));
+
+    // Header takes the first three 32-byte blocks (64 bytes + 32 more bytes of bitmap)
+    void *block_32 = slab_alloc(1);
+    Slab *slab_32 = slab_base(block_32);
+
+    munit_assert_ptr_equal(block_32, (uint8_t *)slab_32 + 96);
+    munit_assert_uint16(slab_32->block_size, ==, 32);
+    munit_assert_uint16(slab_32->free_blocks, ==, 508);
+    munit_assert_uint64(slab_32->bitmap0, ==, 0x000000000000000f);
+
+    // 64-byte is the same as slab_alloc_block
+    void *block_64 = slab_alloc(33);
+    Slab *slab_64 = slab_base(block_64);
+
+    munit_assert_ptr_equal(block_64, slab_64 + 1);
+    munit_assert_uint16(slab_64->block_size, ==, 64);
+    munit_assert_ptr_equal(slab_alloc_block(), slab_64 + 2);
+
+    void *block_128 = slab_alloc(65);
+    Slab *slab_128 = slab_base(block_128);
+
+    munit_assert_ptr_equal(block_128, (uint8_t *)slab_128 + 128);
+    munit_assert_uint16(slab_128->block_size, ==, 128);
+    munit_assert_uint16(slab_128->free_blocks, ==, 126);
+
+    void *block_256 = slab_alloc(256);
+    Slab *slab_256 = slab_base(block_256);
+
+    munit_assert_ptr_equal(block_256, (uint8_t *)slab_256 + 256);
+    munit_assert_uint16(slab_256->block_size, ==, 256);
+
+    // Only 32 blocks, so the rest of the word is never free
+    void *block_512 = slab_alloc(SLAB_MAX_BLOCK_SIZE);
+    Slab *slab_512 = slab_base(block_512);
+
+    munit_assert_ptr_equal(block_512, (uint8_t *)slab_512 + 512);
+    munit_assert_uint16(slab_512->block_size, ==, 512);
+    munit_assert_uint16(slab_512->free_blocks, ==, 30);
+    munit_assert_uint64(slab_512->bitmap0, ==, 0xffffffff00000003);
+
+    // A slab each
+    munit_assert_uint32(mock_pmm_get_total_page_allocs(), ==, (PAGES_PER_SLAB * 5) + 1);
+
+    return MUNIT_OK;
+}
+
+static MunitResult test_slab_alloc_class_32_fill(const MunitParameter params[], void *page_area_ptr) {
+    void *results[510];
+
+    for (int i = 0; i < 510; i++) {
+        results[i] = slab_alloc(32);
+    }
+
+    Slab *first_slab = slab_base(results[0]);
+
+    for (int i = 0; i < 509; i++) {
+        munit_assert_ptr_equal(results[i], (uint8_t *)first_slab + (i + 3) * 32);
+    }
+
+    // Whole 512-bit bitmap is used
+    uint64_t *bitmap = &first_slab->bitmap0;
+
+    for (int i = 0; i < 8; i++) {
+        munit_assert_uint64(bitmap[i], ==, 0xffffffffffffffff);
+    }
+
+    munit_assert_uint16(first_slab->free_blocks, ==, 0);
+
+    Slab *second_slab = slab_base(results[509]);
+    munit_assert_ptr_not_equal(second_slab, first_slab);
+    munit_assert_ptr_equal(results[509], (uint8_t *)second_slab + 96);
+
+    // Free from the end of the overflow bitmap
+    slab_free(results[508]);
+    munit_assert_uint64(bitmap[7], ==, 0x7fffffffffffffff);
+    munit_assert_ptr_equal(slab_alloc(32), results[508]);
+
+    return MUNIT_OK;
+}
+
+static MunitResult test_slab_free_size_classes(const MunitParameter params[], void *page_area_ptr) {
+    void *block_a = slab_alloc(128);
+    void *block_b = slab_alloc(128);
+    Slab *slab = slab_base(block_a);
+
+    munit_assert_uint64(slab->bitmap0, ==, 0x0000000000000007);
+    munit_assert_uint16(slab->free_blocks, ==, 125);
+
+    // Not on a block boundary, ignored
+    slab_free((uint8_t *)block_a + 64);
+    munit_assert_uint64(slab->bitmap0, ==, 0x0000000000000007);
+
+    slab_free(block_a);
+    munit_assert_uint64(slab->bitmap0, ==, 0x0000000000000005);
+    munit_assert_uint16(slab->free_blocks, ==, 126);
+
+    // Double free, ignored
+    slab_free(block_a);
+    munit_assert_uint64(slab->bitmap0, ==, 0x0000000000000005);
+    munit_assert_uint16(slab->free_blocks, ==, 126);
+
+    slab_free(block_b);
+    munit_assert_uint64(slab->bitmap0, ==, 0x0000000000000001);
+    munit_assert_uint16(slab->free_blocks, ==, 127);
+
+    return MUNIT_OK;
+}
+
+static MunitResult test_slab_free_from_middle_of_full(const MunitParameter params[], void *page_area_ptr) {
+    void *results[765];
+
+    for (int i = 0; i < 765; i++) {
+        results[i] = slab_alloc_block();
+    }
+
+    Slab *first_slab = slab_base(results[0]);
+    Slab *second_slab = slab_base(results[255]);
+    Slab *third_slab = slab_base(results[510]);
+
+    // All full, newest at the head
+    munit_assert_ptr_equal(third_slab->this.next, second_slab);
+    munit_assert_ptr_equal(second_slab->this.next, first_slab);
+    munit_assert_ptr_equal(first_slab->prev, second_slab);
+
+    // Freeing into the one in the middle moves it straight to partial...
+    slab_free(results[300]);
+
+    munit_assert_ptr_equal(third_slab->this.next, first_slab);
+    munit_assert_ptr_equal(first_slab->prev, third_slab);
+    munit_assert_null(third_slab->prev);
+
+    munit_assert_null(second_slab->this.next);
+    munit_assert_null(second_slab->prev);
+    munit_assert_uint16(second_slab->free_blocks, ==, 1);
+
+    // ... so that's where the next one comes from
+    munit_assert_ptr_equal(slab_alloc_block(), results[300]);
+    munit_assert_ptr_equal(second_slab->this.next, third_slab);
+    munit_assert_ptr_equal(third_slab->prev, second_slab);
+
+    return MUNIT_OK;
+}
+
+static MunitResult test_slab_magazine_alloc_refills(const MunitParameter params[], void *page_area_ptr) {
+    slab_notify_smp_started();
+
+    void *block = slab_alloc_block();
+    Slab *slab = slab_base(block);
+    SlabMagazine *magazine = &__test_cpu_state[0].slab_cache.magazines[1];
+
+    // Took a batch, handed out the last one
+    munit_assert_uint64(magazine->count, ==, SLAB_MAGAZINE_BATCH - 1);
+    munit_assert_ptr_equal(block, slab + SLAB_MAGAZINE_BATCH);
+    munit_assert_uint64(slab->bitmap0, ==, 0x00000000000001ff);
+
+    // Next one comes from the magazine, nothing changes in the slab
+    munit_assert_ptr_equal(slab_alloc_block(), slab + SLAB_MAGAZINE_BATCH - 1);
+    munit_assert_uint64(magazine->count, ==, SLAB_MAGAZINE_BATCH - 2);
+    munit_assert_uint64(slab->bitmap0, ==, 0x00000000000001ff);
+
+    // Other classes have their own
+    munit_assert_uint64(__test_cpu_state[0].slab_cache.magazines[0].count, ==, 0);
+    slab_alloc(32);
+    munit_assert_uint64(__test_cpu_state[0].slab_cache.magazines[0].count, ==, SLAB_MAGAZINE_BATCH - 1);
+
+    return MUNIT_OK;
+}
+
+static MunitResult test_slab_magazine_double_free(const MunitParameter params[], void *page_area_ptr) {
+    slab_notify_smp_started();
+
+    void *first = slab_alloc_block();
+    void *second = slab_alloc_block();
+
+    SlabMagazine *magazine = &__test_cpu_state[0].slab_cache.magazines[1];
+    const uint64_t count = magazine->count;
+
+    slab_free(first);
+    slab_free(second);
+    munit_assert_uint64(magazine->count, ==, count + 2);
+
+    // Still looks allocated in the bitmap, but it's caught in the magazine
+    slab_free(first);
+    munit_assert_uint64(magazine->count, ==, count + 2);
+
+    // So it only comes back out once
+    munit_assert_ptr_equal(slab_alloc_block(), second);
+    munit_assert_ptr_equal(slab_alloc_block(), first);
+    munit_assert_ptr_not_equal(slab_alloc_block(), first);
+
+    return MUNIT_OK;
+}
+
+static MunitResult test_slab_magazine_free_drains(const MunitParameter params[], void *page_area_ptr) {
+    slab_notify_smp_started();
+
+    void *results[SLAB_MAGAZINE_BATCH * 3];
+
+    for (int i = 0; i < SLAB_MAGAZINE_BATCH * 3; i++) {
+        results[i] = slab_alloc_block();
+    }
+
+    Slab *slab = slab_base(results[0]);
+    SlabMagazine *magazine = &__test_cpu_state[0].slab_cache.magazines[1];
+
+    munit_assert_uint64(magazine->count, ==, 0);
+    munit_assert_uint64(slab->bitmap0, ==, 0x0000000001ffffff);
+
+    // Frees stay in the magazine until it's full...
+    for (int i = 0; i < SLAB_MAGAZINE_SIZE; i++) {
+        slab_free(results[i]);
+    }
+
+    munit_assert_uint64(magazine->count, ==, SLAB_MAGAZINE_SIZE);
+    munit_assert_uint64(slab->bitmap0, ==, 0x0000000001ffffff);
+
+    // ... then the oldest batch goes back (that's the first refill, blocks 1 - 8)
+    slab_free(results[SLAB_MAGAZINE_SIZE]);
+
+    munit_assert_uint64(magazine->count, ==, SLAB_MAGAZINE_SIZE - SLAB_MAGAZINE_BATCH + 1);
+    munit_assert_uint64(slab->bitmap0, ==, 0x0000000001fffe01);
+    munit_assert_ptr_equal(magazine->blocks[magazine->count - 1], results[SLAB_MAGAZINE_SIZE]);
+
+    return MUNIT_OK;
+}
+
 static MunitTest test_suite_tests[] = {
         {(char *)"/init", test_slab_init, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL},
 
@@ -476,6 +708,22 @@ static MunitTest test_suite_tests[] = {
         {(char *)"/alloc/free_two", test_slab_free_two, test_setup, test_teardown, MUNIT_TEST_OPTION_NONE, NULL},
         {(char *)"/alloc/free_two", test_slab_free_from_full, test_setup, test_teardown, MUNIT_TEST_OPTION_NONE, NULL},
 
+        {(char *)"/alloc/size_classes", test_slab_alloc_size_classes, test_setup, test_teardown,
+         MUNIT_TEST_OPTION_NONE, NULL},
+        {(char *)"/alloc/class_32_fill", test_slab_alloc_class_32_fill, test_setup, test_teardown,
+         MUNIT_TEST_OPTION_NONE, NULL},
+        {(char *)"/alloc/free_size_classes", test_slab_free_size_classes, test_setup, test_teardown,
+         MUNIT_TEST_OPTION_NONE, NULL},
+        {(char *)"/alloc/free_from_middle_of_full", test_slab_free_from_middle_of_full, test_setup, test_teardown,
+         MUNIT_TEST_OPTION_NONE, NULL},
+
+        {(char *)"/magazine/alloc_refills", test_slab_magazine_alloc_refills, test_setup, test_teardown,
+         MUNIT_TEST_OPTION_NONE, NULL},
+        {(char *)"/magazine/free_drains", test_slab_magazine_free_drains, test_setup, test_teardown,
+         MUNIT_TEST_OPTION_NONE, NULL},
+        {(char *)"/magazine/double_free", test_slab_magazine_double_free, test_setup, test_teardown,
+         MUNIT_TEST_OPTION_NONE, NULL},
+
         {NULL, NULL, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL},
 };
 
@@ -0,0 +1,171 @@
+/*
+ * Microbenchmark - Slab allocator
+ * anos - An Operating System
+ *
+ * Copyright (c) 2025 Ross Bamford
+ *
+ * Runs the real slab allocator over host memory, first with just the
+ * per-class locks and then with the per-CPU magazines switched on
+ * (there's no switching them back off, so that order is fixed):
+ *
+ *   burst       - allocate N blocks of one size class, then free them all
+ *   contention  - T threads (each its own "CPU") allocating and freeing
+ *                 64-byte blocks in bursts of 16 as fast as they can
+ *
+ * Spinlocks are real (if simple) here, since contention is the point.
+ */
+
+#define _GNU_SOURCE
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "bench.h"
+#include "slab/alloc.h"
+#include "smp/state.h"
+#include "spinlock.h"
+
+#define BURST_ROUNDS 20000
+#define CONTENTION_OPS 2000000
+#define CONTENTION_BURST 16
+#define MAX_THREADS 4
+
+PerCPUState __test_cpu_state[MAX_THREADS];
+uint16_t __test_cpu_count = MAX_THREADS;
+_Thread_local uint8_t __test_this_cpu;
+
+void spinlock_init(SpinLock *lock) { lock->lock = 0; }
+
+void spinlock_lock(SpinLock *lock) {
+    while (__atomic_exchange_n(&lock->lock, 1, __ATOMIC_ACQUIRE)) {
+        while (__atomic_load_n(&lock->lock, __ATOMIC_RELAXED)) {
+            __builtin_ia32_pause();
+        }
+    }
+}
+
+void spinlock_unlock(SpinLock *lock) { __atomic_store_n(&lock->lock, 0, __ATOMIC_RELEASE); }
+
+uint64_t spinlock_lock_irqsave(SpinLock *lock) {
+    spinlock_lock(lock);
+    return 0;
+}
+
+void spinlock_unlock_irqrestore(SpinLock *lock, uint64_t flags) { spinlock_unlock(lock); }
+
+uint64_t save_disable_interrupts(void) { return 0; }
+void restore_saved_interrupts(uint64_t flags) {}
+
+// Slabs never go back to the FBA, so these are never freed either
+void *fba_alloc_blocks_aligned(uint32_t count, uint8_t page_align) {
+    return aligned_alloc(page_align * VM_PAGE_SIZE, count * VM_PAGE_SIZE);
+}
+
+static const uint64_t sizes[] = {32, 64, 128, 256, 512};
+static const uint64_t bursts[] = {1, 64, 1024};
+static const int thread_counts[] = {1, 2, 4};
+
+static void *blocks[1024];
+
+typedef struct {
+    int cpu;
+    uint64_t ops;
+} BenchThread;
+
+static void pin_to_cpu(const int cpu) {
+#ifdef __linux__
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+#endif
+}
+
+static void bench_burst(const char *suite, const uint64_t size, const uint64_t burst) {
+    const uint64_t start = bench_now_ns();
+
+    for (int round = 0; round < BURST_ROUNDS; round++) {
+        for (uint64_t i = 0; i < burst; i++) {
+            blocks[i] = slab_alloc(size);
+        }
+
+        bench_consume((uintptr_t)blocks[burst - 1]);
+
+        for (uint64_t i = 0; i < burst; i++) {
+            slab_free(blocks[i]);
+        }
+    }
+
+    const uint64_t elapsed = bench_now_ns() - start;
+
+    char name[32];
+    snprintf(name, sizeof(name), "burst_%llu", (unsigned long long)size);
+    bench_report(suite, name, "blocks", burst, BURST_ROUNDS * burst * 2, elapsed);
+}
+
+static void *contention_thread(void *arg) {
+    BenchThread *thread = arg;
+    void *mine[CONTENTION_BURST];
+
+    __test_this_cpu = thread->cpu;
+    pin_to_cpu(thread->cpu);
+
+    for (uint64_t op = 0; op < thread->ops; op += CONTENTION_BURST * 2) {
+        for (int i = 0; i < CONTENTION_BURST; i++) {
+            mine[i] = slab_alloc_block();
+        }
+
+        for (int i = 0; i < CONTENTION_BURST; i++) {
+            slab_free(mine[i]);
+        }
+    }
+
+    return NULL;
+}
+
+static void bench_contention(const char *suite, const int threads) {
+    pthread_t ids[MAX_THREADS];
+    BenchThread args[MAX_THREADS];
+
+    const uint64_t start = bench_now_ns();
+
+    for (int i = 0; i < threads; i++) {
+        args[i].cpu = i;
+        args[i].ops = CONTENTION_OPS / threads;
+        pthread_create(&ids[i], NULL, contention_thread, &args[i]);
+    }
+
+    for (int i = 0; i < threads; i++) {
+        pthread_join(ids[i], NULL);
+    }
+
+    const uint64_t elapsed = bench_now_ns() - start;
+
+    bench_report(suite, "contention", "threads", threads, CONTENTION_OPS, elapsed);
+}
+
+static void run_all(const char *suite) {
+    for (int i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+        for (int j = 0; j < sizeof(bursts) / sizeof(bursts[0]); j++) {
+            bench_burst(suite, sizes[i], bursts[j]);
+        }
+    }
+
+    for (int i = 0; i < sizeof(thread_counts) / sizeof(thread_counts[0]); i++) {
+        bench_contention(suite, thread_counts[i]);
+    }
+}
+
+int main(void) {
+    run_all("slab/locked");
+
+    slab_notify_smp_started();
+
+    run_all("slab/magazine");
+
+    return 0;
+}
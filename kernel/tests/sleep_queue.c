@@ -14,6 +14,7 @@
 
 #include "fba/alloc.h"
 #include "slab/alloc.h"
+#include "smp/state.h"
 #include "vmm/vmalloc.h"
 
 #define TEST_PML4_ADDR (((uint64_t *)0x100000))
@@ -315,6 +316,38 @@ static MunitResult test_dequeue_empty_queue(const MunitParameter params[], void
     return MUNIT_OK;
 }
 
+static MunitResult test_next_deadline_empty(const MunitParameter params[], void *fixture_v) {
+    Fixture *fixture = (Fixture *)fixture_v;
+    SleepQueue *queue = (SleepQueue *)fixture->queue;
+
+    munit_assert_uint64(sleep_queue_next_deadline(queue), ==, UINT64_MAX);
+    munit_assert_uint64(sleep_queue_next_deadline(NULL), ==, UINT64_MAX);
+
+    return MUNIT_OK;
+}
+
+static MunitResult test_next_deadline(const MunitParameter params[], void *fixture_v) {
+    Fixture *fixture = (Fixture *)fixture_v;
+    SleepQueue *queue = (SleepQueue *)fixture->queue;
+
+    Task task1 = {0}, task2 = {0}, task3 = {0};
+
+    sleep_queue_enqueue(queue, &task1, 300);
+    munit_assert_uint64(sleep_queue_next_deadline(queue), ==, 300);
+
+    sleep_queue_enqueue(queue, &task2, 100);
+    sleep_queue_enqueue(queue, &task3, 200);
+    munit_assert_uint64(sleep_queue_next_deadline(queue), ==, 100);
+
+    sleep_queue_dequeue(queue, 150);
+    munit_assert_uint64(sleep_queue_next_deadline(queue), ==, 200);
+
+    sleep_queue_dequeue(queue, 300);
+    munit_assert_uint64(sleep_queue_next_deadline(queue), ==, UINT64_MAX);
+
+    return MUNIT_OK;
+}
+
 static MunitTest sleep_queue_tests[] = {
         {"/enqueue_one", test_enqueue_single, test_setup, test_teardown, MUNIT_TEST_OPTION_NONE, NULL},
         {"/enqueue_mult_ordered", test_enqueue_multiple_ordered, test_setup, test_teardown, MUNIT_TEST_OPTION_NONE,
@@ -331,6 +364,8 @@ static MunitTest sleep_queue_tests[] = {
         {"/dequeue_multiple", test_dequeue_multiple, test_setup, test_teardown, MUNIT_TEST_OPTION_NONE, NULL},
         {"/dequeue_mult_all", test_dequeue_mult_all, test_setup, test_teardown, MUNIT_TEST_OPTION_NONE, NULL},
         {"/dequeue_empty_queue", test_dequeue_empty_queue, test_setup, test_teardown, MUNIT_TEST_OPTION_NONE, NULL},
+        {"/next_deadline_empty", test_next_deadline_empty, test_setup, test_teardown, MUNIT_TEST_OPTION_NONE, NULL},
+        {"/next_deadline", test_next_deadline, test_setup, test_teardown, MUNIT_TEST_OPTION_NONE, NULL},
         {NULL, NULL, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL}};
 
 static const MunitSuite sleep_queue_suite = {"/sleep_queue", sleep_queue_tests, NULL, 1, MUNIT_SUITE_OPTION_NONE};
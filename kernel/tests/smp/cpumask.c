@@ -0,0 +1,160 @@
+/*
+ * Tests for CPU masks
+ * anos - An Operating System
+ *
+ * Copyright (c) 2025 Ross Bamford
+ */
+
+#include "munit.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "smp/cpumask.h"
+
+static CpuMask mask;
+
+static void *setup(const MunitParameter params[], void *user_data) {
+    cpu_mask_clear_all(&mask);
+    return NULL;
+}
+
+static MunitResult test_max_cpus_fit(const MunitParameter params[], void *param) {
+    munit_assert_size(sizeof(CpuMask) * 8, >=, MAX_CPU_COUNT);
+    munit_assert_size(sizeof(CpuMask) * 8, <, MAX_CPU_COUNT + 64);
+
+    return MUNIT_OK;
+}
+
+static MunitResult test_set_clear(const MunitParameter params[], void *param) {
+    const uint16_t last = MAX_CPU_COUNT - 1;
+
+    cpu_mask_set(&mask, 0, __ATOMIC_RELAXED);
+    cpu_mask_set(&mask, last, __ATOMIC_RELAXED);
+
+    munit_assert_true(cpu_mask_test(&mask, 0, __ATOMIC_RELAXED));
+    munit_assert_true(cpu_mask_test(&mask, last, __ATOMIC_RELAXED));
+    munit_assert_int(cpu_mask_count(&mask), ==, last ? 2 : 1);
+
+    cpu_mask_clear(&mask, 0, __ATOMIC_RELAXED);
+
+    munit_assert_false(cpu_mask_test(&mask, 0, __ATOMIC_RELAXED));
+    munit_assert_int(cpu_mask_count(&mask), ==, last ? 1 : 0);
+
+    return MUNIT_OK;
+}
+
+static MunitResult test_set_second_word(const MunitParameter params[], void *param) {
+    if (CPU_MASK_WORDS < 2) {
+        return MUNIT_SKIP;
+    }
+
+    cpu_mask_set(&mask, 65, __ATOMIC_RELAXED);
+
+    munit_assert_uint64(mask.words[0], ==, 0);
+    munit_assert_uint64(mask.words[1], ==, 0x2);
+    munit_assert_false(cpu_mask_test(&mask, 1, __ATOMIC_RELAXED));
+    munit_assert_true(cpu_mask_test(&mask, 65, __ATOMIC_RELAXED));
+
+    return MUNIT_OK;
+}
+
+static MunitResult test_set_first(const MunitParameter params[], void *param) {
+    cpu_mask_set_first(&mask, 0);
+    munit_assert_int(cpu_mask_count(&mask), ==, 0);
+
+    cpu_mask_set_first(&mask, 1);
+    munit_assert_int(cpu_mask_count(&mask), ==, 1);
+    munit_assert_uint64(mask.words[0], ==, 0x1);
+
+    cpu_mask_set_first(&mask, MAX_CPU_COUNT);
+    munit_assert_int(cpu_mask_count(&mask), ==, MAX_CPU_COUNT);
+
+    if (CPU_MASK_WORDS < 2) {
+        return MUNIT_OK;
+    }
+
+    cpu_mask_set_first(&mask, 64);
+    munit_assert_uint64(mask.words[0], ==, ~0ULL);
+    munit_assert_uint64(mask.words[1], ==, 0);
+
+    cpu_mask_set_first(&mask, 70);
+    munit_assert_uint64(mask.words[0], ==, ~0ULL);
+    munit_assert_uint64(mask.words[1], ==, 0x3f);
+    munit_assert_int(cpu_mask_count(&mask), ==, 70);
+
+    return MUNIT_OK;
+}
+
+static MunitResult test_set_all_except(const MunitParameter params[], void *param) {
+    const uint16_t cpu = MAX_CPU_COUNT / 2;
+
+    cpu_mask_set_all_except(&mask, cpu, __ATOMIC_RELAXED);
+
+    munit_assert_false(cpu_mask_test(&mask, cpu, __ATOMIC_RELAXED));
+    munit_assert_true(cpu_mask_test(&mask, MAX_CPU_COUNT - 1, __ATOMIC_RELAXED) || cpu == MAX_CPU_COUNT - 1);
+    munit_assert_int(cpu_mask_count(&mask), ==, CPU_MASK_WORDS * 64 - 1);
+
+    return MUNIT_OK;
+}
+
+static MunitResult test_set_all_except_keeps_own_bit(const MunitParameter params[], void *param) {
+    cpu_mask_set(&mask, 0, __ATOMIC_RELAXED);
+    cpu_mask_set_all_except(&mask, 0, __ATOMIC_RELAXED);
+
+    // Only ever adds CPUs
+    munit_assert_int(cpu_mask_count(&mask), ==, CPU_MASK_WORDS * 64);
+
+    return MUNIT_OK;
+}
+
+static MunitResult test_first_next_empty(const MunitParameter params[], void *param) {
+    munit_assert_int(cpu_mask_first(&mask), ==, -1);
+    munit_assert_int(cpu_mask_next(&mask, 0), ==, -1);
+    munit_assert_int(cpu_mask_next(&mask, CPU_MASK_WORDS * 64 - 1), ==, -1);
+
+    return MUNIT_OK;
+}
+
+static MunitResult test_for_each(const MunitParameter params[], void *param) {
+    const uint16_t cpus[] = {0, 3, 63, 64, 127, 200, 255};
+    int expected_count = 0;
+
+    for (int i = 0; i < sizeof(cpus) / sizeof(cpus[0]); i++) {
+        if (cpus[i] < MAX_CPU_COUNT) {
+            cpu_mask_set(&mask, cpus[i], __ATOMIC_RELAXED);
+            expected_count++;
+        }
+    }
+
+    int seen = 0;
+    cpu_mask_for_each(cpu, &mask) {
+        munit_assert_int(seen, <, expected_count);
+        munit_assert_int(cpu, ==, cpus[seen]);
+        seen++;
+    }
+
+    munit_assert_int(seen, ==, expected_count);
+    munit_assert_int(cpu_mask_count(&mask), ==, expected_count);
+
+    return MUNIT_OK;
+}
+
+static MunitTest test_suite_tests[] = {
+        {(char *)"/max_cpus_fit", test_max_cpus_fit, setup, NULL, MUNIT_TEST_OPTION_NONE, NULL},
+        {(char *)"/set_clear", test_set_clear, setup, NULL, MUNIT_TEST_OPTION_NONE, NULL},
+        {(char *)"/set_second_word", test_set_second_word, setup, NULL, MUNIT_TEST_OPTION_NONE, NULL},
+        {(char *)"/set_first", test_set_first, setup, NULL, MUNIT_TEST_OPTION_NONE, NULL},
+        {(char *)"/set_all_except", test_set_all_except, setup, NULL, MUNIT_TEST_OPTION_NONE, NULL},
+        {(char *)"/set_all_except_keeps_own", test_set_all_except_keeps_own_bit, setup, NULL, MUNIT_TEST_OPTION_NONE,
+         NULL},
+        {(char *)"/first_next_empty", test_first_next_empty, setup, NULL, MUNIT_TEST_OPTION_NONE, NULL},
+        {(char *)"/for_each", test_for_each, setup, NULL, MUNIT_TEST_OPTION_NONE, NULL},
+        {NULL, NULL, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL},
+};
+
+static const MunitSuite test_suite = {(char *)"/smp/cpumask", test_suite_tests, NULL, 1, MUNIT_SUITE_OPTION_NONE};
+
+int main(int argc, char *argv[MUNIT_ARRAY_PARAM(argc + 1)]) {
+    return munit_suite_main(&test_suite, (void *)"µnit", argc, argv);
+}
@@ -6,28 +6,35 @@
 */
 
 #include "munit.h"
+#include <pthread.h>
 #include <stdbool.h>
 #include <stdint.h>
 #include <string.h>
 
 #include "smp/ipwi.h"
 #include "smp/state.h"
-#include "spinlock.h"
-#include "structs/shift_array.h"
+
+#define TEST_PRODUCERS ((3))
+#define TEST_ITEMS_PER_PRODUCER ((10000))
 
 // === Mocks ===
 
 Task mock_task;
 Process mock_owner;
 
-static PerCPUState mock_states[4];
 static int last_halt_called = 0;
-static int shift_array_init_should_fail = 0;
-static int enqueue_fail_cpu = -1;
-static int dequeue_has_item = 0;
 static IpwiWorkItem mocked_item;
 static int invalidate_page_called = 0;
+static int invalidate_all_called = 0;
+static int notify_count = 0;
+static PerCPUState *notify_target = NULL;
 static uintptr_t invalidate_page_addrs[16];
+static int reschedule_notify_count = 0;
+static PerCPUState *reschedule_notify_target = NULL;
+static int schedule_called = 0;
+static int asid_forget_called = 0;
+static int asid_flush_all_called = 0;
+static uintptr_t mock_loaded_root = 0;
 
 Task *task_current(void) { return &mock_task; }
 
@@ -35,55 +42,80 @@ void arch_ipwi_notify_all_except_current(void) {
     // Called from notify test
 }
 
+void arch_ipwi_notify(PerCPUState *target_state) {
+    notify_count++;
+    notify_target = target_state;
+}
+
+void arch_ipwi_notify_reschedule(PerCPUState *target_state) {
+    reschedule_notify_count++;
+    reschedule_notify_target = target_state;
+}
+
+uint64_t sched_lock_this_cpu(void) { return 0x42; }
+void sched_unlock_this_cpu(uint64_t lock_flags) {}
+void sched_schedule(void) { schedule_called++; }
+
 void vmm_invalidate_page(const uintptr_t addr) {
     if (invalidate_page_called < 16) {
         invalidate_page_addrs[invalidate_page_called++] = addr;
     }
 }
 
-void halt_and_catch_fire(void) { last_halt_called++; }
+void vmm_invalidate_all(void) { invalidate_all_called++; }
 
-bool shift_array_init(ShiftToMiddleArray *arr, size_t elem_size, int initial_capacity) {
-    return shift_array_init_should_fail ? false : true;
-}
+void asid_forget_this_cpu(void) { asid_forget_called++; }
 
-bool shift_array_insert_tail(ShiftToMiddleArray *arr, const void *item) {
-    memcpy(&mocked_item, item, sizeof(IpwiWorkItem));
-    return true;
-}
+void asid_flush_all_this_cpu(void) { asid_flush_all_called++; }
 
-void *shift_array_get_head(const ShiftToMiddleArray *arr) { return dequeue_has_item ? &mocked_item : NULL; }
+uintptr_t vmm_get_pagetable_root_phys(void) { return mock_loaded_root; }
 
-void shift_array_remove_head(ShiftToMiddleArray *arr) { dequeue_has_item = 0; }
+void halt_and_catch_fire(void) { last_halt_called++; }
 
-void spinlock_init(SpinLock *lock) {}
-void spinlock_lock(SpinLock *lock) {}
-void spinlock_unlock(SpinLock *lock) {}
-uint64_t spinlock_lock_irqsave(SpinLock *lock) { return 0x42; }
-void spinlock_unlock_irqrestore(SpinLock *lock, uint64_t flags) {}
+uint64_t save_disable_interrupts(void) { return 0x42; }
+void restore_saved_interrupts(uint64_t flags) {}
 
 void ipwi_ipi_handler(void);
 
+static void *setup(const MunitParameter params[], void *user_data) {
+    for (int i = 0; i < 4; i++) {
+        __test_this_cpu = i;
+        __test_cpu_state[i].cpu_id = i;
+        ipwi_init();
+    }
+
+    __test_this_cpu = 0;
+    return NULL;
+}
+
+// Post an item to this CPU's own mailbox, for the handler to find
+static void post_to_self(const IpwiWorkItem *item) { munit_assert_true(ipwi_enqueue(item, 0)); }
+
 // === Tests ===
 
 static MunitResult test_ipwi_init_success(const MunitParameter params[], void *data) {
-    shift_array_init_should_fail = 0;
+    __test_cpu_state[0].ipwi_head = 99;
+    __test_cpu_state[0].ipwi_tail = 99;
+
     munit_assert_true(ipwi_init());
-    return MUNIT_OK;
-}
 
-static MunitResult test_ipwi_init_fail_on_shift_array(const MunitParameter params[], void *data) {
-    shift_array_init_should_fail = 1;
-    munit_assert_false(ipwi_init());
+    munit_assert_uint64(__test_cpu_state[0].ipwi_head, ==, 0);
+    munit_assert_uint64(__test_cpu_state[0].ipwi_tail, ==, 0);
+
+    for (int i = 0; i < IPWI_MAILBOX_SIZE; i++) {
+        munit_assert_uint32(__test_cpu_state[0].ipwi_seq[i], ==, i);
+    }
+
     return MUNIT_OK;
 }
 
 static MunitResult test_ipwi_enqueue_success(const MunitParameter params[], void *data) {
-    __test_cpu_count = 2;
+    __test_cpu_count = 3;
 
     IpwiWorkItem item = {.type = IPWI_TYPE_REMOTE_EXEC};
     munit_assert_true(ipwi_enqueue(&item, 2));
-    munit_assert_int(mocked_item.type, ==, IPWI_TYPE_REMOTE_EXEC);
+    munit_assert_int(__test_cpu_state[2].ipwi_mailbox[0].type, ==, IPWI_TYPE_REMOTE_EXEC);
+    munit_assert_uint64(__test_cpu_state[2].ipwi_tail, ==, 1);
 
     __test_cpu_count = 1;
     return MUNIT_OK;
@@ -92,32 +124,130 @@ static MunitResult test_ipwi_enqueue_success(const MunitParameter params[], void
 static MunitResult test_ipwi_enqueue_fail_invalid_cpu(const MunitParameter params[], void *data) {
     IpwiWorkItem item = {.type = IPWI_TYPE_REMOTE_EXEC};
     munit_assert_false(ipwi_enqueue(&item, 99));
+    munit_assert_false(ipwi_enqueue(&item, 4));
+    return MUNIT_OK;
+}
+
+static MunitResult test_ipwi_enqueue_full(const MunitParameter params[], void *data) {
+    IpwiWorkItem item = {.type = IPWI_TYPE_REMOTE_EXEC};
+
+    for (int i = 0; i < IPWI_MAILBOX_SIZE; i++) {
+        munit_assert_true(ipwi_enqueue(&item, 1));
+    }
+
+    // Full, and nothing allocated to make room
+    munit_assert_false(ipwi_enqueue(&item, 1));
+    munit_assert_uint64(__test_cpu_state[1].ipwi_tail, ==, IPWI_MAILBOX_SIZE);
+
+    // Once one's taken out, there's room again
+    IpwiWorkItem out;
+    __test_this_cpu = 1;
+    munit_assert_true(ipwi_dequeue_this_cpu(&out));
+    __test_this_cpu = 0;
+
+    munit_assert_true(ipwi_enqueue(&item, 1));
+    munit_assert_false(ipwi_enqueue(&item, 1));
+
     return MUNIT_OK;
 }
 
 static MunitResult test_ipwi_enqueue_all_except_current(const MunitParameter params[], void *data) {
     IpwiWorkItem item = {.type = IPWI_TYPE_TLB_SHOOTDOWN};
-    enqueue_fail_cpu = -1;
     munit_assert_true(ipwi_enqueue_all_except_current(&item));
+
+    munit_assert_uint64(__test_cpu_state[0].ipwi_tail, ==, 0);
+    munit_assert_uint64(__test_cpu_state[1].ipwi_tail, ==, 1);
+    munit_assert_uint64(__test_cpu_state[2].ipwi_tail, ==, 1);
+    munit_assert_uint64(__test_cpu_state[3].ipwi_tail, ==, 1);
     return MUNIT_OK;
 }
 
 static MunitResult test_ipwi_dequeue_success(const MunitParameter params[], void *data) {
-    dequeue_has_item = 1;
-    mocked_item.type = IPWI_TYPE_REMOTE_EXEC;
+    IpwiWorkItem item = {.type = IPWI_TYPE_REMOTE_EXEC};
+    post_to_self(&item);
+
     IpwiWorkItem out;
     munit_assert_true(ipwi_dequeue_this_cpu(&out));
     munit_assert_int(out.type, ==, IPWI_TYPE_REMOTE_EXEC);
+    munit_assert_false(ipwi_dequeue_this_cpu(&out));
     return MUNIT_OK;
 }
 
 static MunitResult test_ipwi_dequeue_empty(const MunitParameter params[], void *data) {
-    dequeue_has_item = 0;
     IpwiWorkItem out;
     munit_assert_false(ipwi_dequeue_this_cpu(&out));
     return MUNIT_OK;
 }
 
+static MunitResult test_ipwi_dequeue_unpublished(const MunitParameter params[], void *data) {
+    // A sender has claimed the slot, but not filled it yet
+    __test_cpu_state[0].ipwi_tail = 1;
+
+    IpwiWorkItem out;
+    munit_assert_false(ipwi_dequeue_this_cpu(&out));
+    munit_assert_uint64(__test_cpu_state[0].ipwi_head, ==, 0);
+    return MUNIT_OK;
+}
+
+static MunitResult test_ipwi_wraparound(const MunitParameter params[], void *data) {
+    IpwiWorkItem item = {.type = IPWI_TYPE_REMOTE_EXEC};
+    IpwiWorkItem out;
+
+    for (uint32_t i = 0; i < IPWI_MAILBOX_SIZE * 10; i++) {
+        item.flags = i;
+        post_to_self(&item);
+        post_to_self(&item);
+
+        munit_assert_true(ipwi_dequeue_this_cpu(&out));
+        munit_assert_uint32(out.flags, ==, i);
+        munit_assert_true(ipwi_dequeue_this_cpu(&out));
+        munit_assert_uint32(out.flags, ==, i);
+    }
+
+    munit_assert_false(ipwi_dequeue_this_cpu(&out));
+    return MUNIT_OK;
+}
+
+static void *producer_thread(void *arg) {
+    IpwiWorkItem item = {.type = IPWI_TYPE_REMOTE_EXEC, .flags = (uint32_t)(uintptr_t)arg};
+
+    for (int i = 0; i < TEST_ITEMS_PER_PRODUCER; i++) {
+        ((uint64_t *)item.payload)[0] = i;
+
+        while (!ipwi_enqueue(&item, 0)) {
+            // full, wait for the consumer
+        }
+    }
+
+    return NULL;
+}
+
+static MunitResult test_ipwi_concurrent_producers(const MunitParameter params[], void *data) {
+    pthread_t threads[TEST_PRODUCERS];
+    uint64_t next_expected[TEST_PRODUCERS] = {0};
+    IpwiWorkItem out;
+
+    for (uintptr_t i = 0; i < TEST_PRODUCERS; i++) {
+        pthread_create(&threads[i], NULL, producer_thread, (void *)i);
+    }
+
+    // Everything arrives exactly once, in order per producer
+    for (int received = 0; received < TEST_PRODUCERS * TEST_ITEMS_PER_PRODUCER;) {
+        if (ipwi_dequeue_this_cpu(&out)) {
+            munit_assert_uint32(out.flags, <, TEST_PRODUCERS);
+            munit_assert_uint64(((uint64_t *)out.payload)[0], ==, next_expected[out.flags]++);
+            received++;
+        }
+    }
+
+    for (int i = 0; i < TEST_PRODUCERS; i++) {
+        pthread_join(threads[i], NULL);
+    }
+
+    munit_assert_false(ipwi_dequeue_this_cpu(&out));
+    return MUNIT_OK;
+}
+
 static MunitResult test_ipwi_notify_calls_arch(const MunitParameter params[], void *data) {
     // Just a smoke test for now
     ipwi_notify_all_except_current();
@@ -125,8 +255,8 @@ static MunitResult test_ipwi_notify_calls_arch(const MunitParameter params[], vo
 }
 
 static MunitResult test_ipwi_ipi_handler_panic(const MunitParameter params[], void *data) {
-    dequeue_has_item = 1;
     mocked_item.type = IPWI_TYPE_PANIC_HALT;
+    post_to_self(&mocked_item);
     last_halt_called = 0;
     ipwi_ipi_handler();
     munit_assert_int(last_halt_called, ==, 1);
@@ -144,7 +274,7 @@ static MunitResult test_ipwi_ipi_handler_tlb_shootdown(const MunitParameter para
     mock_task.owner = &mock_owner;
 
     invalidate_page_called = 0;
-    dequeue_has_item = 1;
+    post_to_self(&mocked_item);
 
     ipwi_ipi_handler();
 
@@ -155,18 +285,318 @@ static MunitResult test_ipwi_ipi_handler_tlb_shootdown(const MunitParameter para
     return MUNIT_OK;
 }
 
+static MunitResult test_ipwi_ipi_handler_tlb_shootdown_full_flush(const MunitParameter params[], void *data) {
+    IpwiPayloadTLBShootdown *payload = (IpwiPayloadTLBShootdown *)&mocked_item.payload;
+    mocked_item.type = IPWI_TYPE_TLB_SHOOTDOWN;
+    payload->start_vaddr = 0x4000;
+    payload->page_count = IPWI_TLB_SHOOTDOWN_FULL_FLUSH_PAGES + 1;
+    payload->target_pid = 42;
+
+    mock_owner.pid = 42;
+    mock_task.owner = &mock_owner;
+
+    post_to_self(&mocked_item);
+
+    ipwi_ipi_handler();
+
+    munit_assert_int(invalidate_all_called, ==, 1);
+    munit_assert_int(invalidate_page_called, ==, 0);
+    return MUNIT_OK;
+}
+
+static MunitResult test_ipwi_ipi_handler_tlb_shootdown_ack(const MunitParameter params[], void *data) {
+    uint64_t pending = 2;
+
+    IpwiPayloadTLBShootdown *payload = (IpwiPayloadTLBShootdown *)&mocked_item.payload;
+    mocked_item.type = IPWI_TYPE_TLB_SHOOTDOWN;
+    payload->ack_count = &pending;
+    payload->start_vaddr = 0x4000;
+    payload->page_count = 1;
+    payload->target_pid = 42;
+
+    mock_owner.pid = 42;
+    mock_task.owner = &mock_owner;
+
+    post_to_self(&mocked_item);
+
+    ipwi_ipi_handler();
+
+    munit_assert_int(invalidate_page_called, ==, 1);
+    munit_assert_uint64(pending, ==, 1);
+    return MUNIT_OK;
+}
+
+static MunitResult test_ipwi_ipi_handler_tlb_shootdown_other_process(const MunitParameter params[], void *data) {
+    uint64_t pending = 1;
+
+    IpwiPayloadTLBShootdown *payload = (IpwiPayloadTLBShootdown *)&mocked_item.payload;
+    mocked_item.type = IPWI_TYPE_TLB_SHOOTDOWN;
+    payload->ack_count = &pending;
+    payload->start_vaddr = 0x4000;
+    payload->page_count = 1;
+    payload->target_pid = 42;
+
+    mock_owner.pid = 43;
+    mock_owner.pml4 = 0x1000;
+    mock_task.owner = &mock_owner;
+
+    post_to_self(&mocked_item);
+
+    ipwi_ipi_handler();
+
+    // Nothing to flush (it's marked stale), but still acknowledged
+    munit_assert_int(invalidate_page_called, ==, 0);
+    munit_assert_int(asid_forget_called, ==, 0);
+    munit_assert_uint64(pending, ==, 0);
+    return MUNIT_OK;
+}
+
+static MunitResult test_ipwi_ipi_handler_tlb_shootdown_other_pml4(const MunitParameter params[], void *data) {
+    uint64_t pending = 1;
+
+    IpwiPayloadTLBShootdown *payload = (IpwiPayloadTLBShootdown *)&mocked_item.payload;
+    mocked_item.type = IPWI_TYPE_TLB_SHOOTDOWN;
+    payload->ack_count = &pending;
+    payload->start_vaddr = 0x4000;
+    payload->page_count = 1;
+    payload->target_pid = 0;
+    payload->target_pml4 = 0x2000;
+
+    mock_owner.pid = 43;
+    mock_owner.pml4 = 0x1000;
+    mock_task.owner = &mock_owner;
+
+    invalidate_page_called = 0;
+    asid_forget_called = 0;
+    post_to_self(&mocked_item);
+
+    ipwi_ipi_handler();
+
+    // Not loaded, but no telling which ASID it might be cached under
+    munit_assert_int(invalidate_page_called, ==, 0);
+    munit_assert_int(asid_forget_called, ==, 1);
+    munit_assert_uint64(pending, ==, 0);
+
+    payload->target_pml4 = 0;
+    return MUNIT_OK;
+}
+
+static MunitResult test_ipwi_ipi_handler_tlb_shootdown_loaded_pml4(const MunitParameter params[], void *data) {
+    uint64_t pending = 1;
+
+    IpwiPayloadTLBShootdown *payload = (IpwiPayloadTLBShootdown *)&mocked_item.payload;
+    mocked_item.type = IPWI_TYPE_TLB_SHOOTDOWN;
+    payload->ack_count = &pending;
+    payload->start_vaddr = 0x4000;
+    payload->page_count = 1;
+    payload->target_pid = 0;
+    payload->target_pml4 = 0x2000;
+
+    // Current task's process has different tables, but the target's are loaded
+    mock_owner.pid = 43;
+    mock_owner.pml4 = 0x1000;
+    mock_task.owner = &mock_owner;
+    mock_loaded_root = 0x2000;
+
+    invalidate_page_called = 0;
+    asid_forget_called = 0;
+    post_to_self(&mocked_item);
+
+    ipwi_ipi_handler();
+
+    munit_assert_int(invalidate_page_called, ==, 1);
+    munit_assert_uint64(invalidate_page_addrs[0], ==, 0x4000);
+    munit_assert_int(asid_forget_called, ==, 0);
+    munit_assert_uint64(pending, ==, 0);
+
+    payload->target_pml4 = 0;
+    mock_loaded_root = 0;
+    return MUNIT_OK;
+}
+
+static MunitResult test_ipwi_ipi_handler_tlb_shootdown_kernel(const MunitParameter params[], void *data) {
+    uint64_t pending = 1;
+
+    IpwiPayloadTLBShootdown *payload = (IpwiPayloadTLBShootdown *)&mocked_item.payload;
+    mocked_item.type = IPWI_TYPE_TLB_SHOOTDOWN;
+    payload->ack_count = &pending;
+    payload->start_vaddr = 0xFFFFFFFF80400000;
+    payload->page_count = 2;
+    payload->target_pid = 0;
+    payload->target_pml4 = 0;
+
+    // Kernel pages are global, so whatever's loaded has them
+    mock_owner.pid = 43;
+    mock_owner.pml4 = 0x1000;
+    mock_task.owner = &mock_owner;
+    mock_loaded_root = 0x1000;
+
+    invalidate_page_called = 0;
+    post_to_self(&mocked_item);
+
+    ipwi_ipi_handler();
+
+    munit_assert_int(invalidate_page_called, ==, 2);
+    munit_assert_uint64(invalidate_page_addrs[0], ==, 0xFFFFFFFF80400000);
+    munit_assert_uint64(invalidate_page_addrs[1], ==, 0xFFFFFFFF80401000);
+    munit_assert_int(asid_forget_called, ==, 0);
+    munit_assert_int(asid_flush_all_called, ==, 0);
+    munit_assert_uint64(pending, ==, 0);
+
+    mock_loaded_root = 0;
+    return MUNIT_OK;
+}
+
+static MunitResult test_ipwi_ipi_handler_tlb_shootdown_kernel_full_flush(const MunitParameter params[],
+                                                                          void *data) {
+    IpwiPayloadTLBShootdown *payload = (IpwiPayloadTLBShootdown *)&mocked_item.payload;
+    mocked_item.type = IPWI_TYPE_TLB_SHOOTDOWN;
+    payload->ack_count = NULL;
+    payload->start_vaddr = 0xFFFFFFFF80400000;
+    payload->page_count = IPWI_TLB_SHOOTDOWN_FULL_FLUSH_PAGES + 1;
+    payload->target_pid = 0;
+    payload->target_pml4 = 0;
+
+    mock_owner.pid = 43;
+    mock_task.owner = &mock_owner;
+
+    invalidate_page_called = 0;
+    post_to_self(&mocked_item);
+
+    ipwi_ipi_handler();
+
+    // Reloading the tables would leave global pages behind
+    munit_assert_int(asid_flush_all_called, ==, 1);
+    munit_assert_int(invalidate_all_called, ==, 0);
+    munit_assert_int(invalidate_page_called, ==, 0);
+    return MUNIT_OK;
+}
+
+static MunitResult test_ipwi_ipi_handler_flush_request(const MunitParameter params[], void *data) {
+    const uint64_t ticket = ipwi_request_tlb_flush(0);
+
+    munit_assert_uint64(ticket, ==, 1);
+    munit_assert_false(ipwi_tlb_flush_done(0, ticket));
+
+    // Two more before the handler runs still only need one flush
+    munit_assert_uint64(ipwi_request_tlb_flush(0), ==, 2);
+    munit_assert_uint64(ipwi_request_tlb_flush(0), ==, 3);
+
+    ipwi_ipi_handler();
+
+    // Might have been for any address space, or global kernel pages - so everything goes
+    munit_assert_int(asid_flush_all_called, ==, 1);
+    munit_assert_int(invalidate_all_called, ==, 0);
+    munit_assert_int(asid_forget_called, ==, 0);
+    munit_assert_true(ipwi_tlb_flush_done(0, ticket));
+    munit_assert_true(ipwi_tlb_flush_done(0, 3));
+
+    // Nothing new asked for, nothing done
+    ipwi_ipi_handler();
+    munit_assert_int(asid_flush_all_called, ==, 1);
+
+    return MUNIT_OK;
+}
+
+static MunitResult test_ipwi_request_tlb_flush_invalid_cpu(const MunitParameter params[], void *data) {
+    munit_assert_uint64(ipwi_request_tlb_flush(99), ==, 0);
+    munit_assert_true(ipwi_tlb_flush_done(99, 1));
+    return MUNIT_OK;
+}
+
+static MunitResult test_ipwi_notify_one(const MunitParameter params[], void *data) {
+    munit_assert_true(ipwi_notify(3));
+    munit_assert_int(notify_count, ==, 1);
+    munit_assert_ptr_equal(notify_target, &__test_cpu_state[3]);
+
+    munit_assert_false(ipwi_notify(4));
+    munit_assert_int(notify_count, ==, 1);
+    return MUNIT_OK;
+}
+
+static MunitResult test_ipwi_notify_reschedule(const MunitParameter params[], void *data) {
+    __test_cpu_state[2].ipwi_reschedule_pending = 0;
+
+    munit_assert_true(ipwi_notify_reschedule(2));
+    munit_assert_int(reschedule_notify_count, ==, 1);
+    munit_assert_ptr_equal(reschedule_notify_target, &__test_cpu_state[2]);
+    munit_assert_uint64(__test_cpu_state[2].ipwi_reschedule_pending, ==, 1);
+
+    return MUNIT_OK;
+}
+
+static MunitResult test_ipwi_notify_reschedule_coalesces(const MunitParameter params[], void *data) {
+    __test_cpu_state[2].ipwi_reschedule_pending = 0;
+
+    munit_assert_true(ipwi_notify_reschedule(2));
+    munit_assert_false(ipwi_notify_reschedule(2));
+
+    // Second one rides on the first
+    munit_assert_int(reschedule_notify_count, ==, 1);
+
+    return MUNIT_OK;
+}
+
+static MunitResult test_ipwi_notify_reschedule_invalid_cpu(const MunitParameter params[], void *data) {
+    munit_assert_false(ipwi_notify_reschedule(99));
+    munit_assert_int(reschedule_notify_count, ==, 0);
+    return MUNIT_OK;
+}
+
+static MunitResult test_ipwi_reschedule_handler(const MunitParameter params[], void *data) {
+    __test_cpu_state[0].ipwi_reschedule_pending = 1;
+
+    ipwi_reschedule_handler();
+
+    munit_assert_int(schedule_called, ==, 1);
+    munit_assert_uint64(__test_cpu_state[0].ipwi_reschedule_pending, ==, 0);
+
+    // Now pending is cleared, the next one goes out
+    munit_assert_true(ipwi_notify_reschedule(0));
+    munit_assert_int(reschedule_notify_count, ==, 1);
+
+    return MUNIT_OK;
+}
+
 static MunitTest ipwi_tests[] = {
-        {"/init_success", test_ipwi_init_success, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL},
-        {"/init_fail", test_ipwi_init_fail_on_shift_array, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL},
-        {"/enqueue_success", test_ipwi_enqueue_success, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL},
-        {"/enqueue_invalid", test_ipwi_enqueue_fail_invalid_cpu, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL},
-        {"/enqueue_all", test_ipwi_enqueue_all_except_current, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL},
-        {"/dequeue_success", test_ipwi_dequeue_success, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL},
-        {"/dequeue_empty", test_ipwi_dequeue_empty, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL},
-        {"/notify", test_ipwi_notify_calls_arch, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL},
-        {"/ipi_handler_panic", test_ipwi_ipi_handler_panic, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL},
-        {"/ipi_handler_tlb_shootdown", test_ipwi_ipi_handler_tlb_shootdown, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL},
-        {NULL, NULL, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL}};
+        {"/init_success", test_ipwi_init_success, setup, NULL, MUNIT_TEST_OPTION_NONE, NULL},
+        {"/enqueue_success", test_ipwi_enqueue_success, setup, NULL, MUNIT_TEST_OPTION_NONE, NULL},
+        {"/enqueue_invalid", test_ipwi_enqueue_fail_invalid_cpu, setup, NULL, MUNIT_TEST_OPTION_NONE, NULL},
+        {"/enqueue_full", test_ipwi_enqueue_full, setup, NULL, MUNIT_TEST_OPTION_NONE, NULL},
+        {"/enqueue_all", test_ipwi_enqueue_all_except_current, setup, NULL, MUNIT_TEST_OPTION_NONE, NULL},
+        {"/dequeue_success", test_ipwi_dequeue_success, setup, NULL, MUNIT_TEST_OPTION_NONE, NULL},
+        {"/dequeue_empty", test_ipwi_dequeue_empty, setup, NULL, MUNIT_TEST_OPTION_NONE, NULL},
+        {"/dequeue_unpublished", test_ipwi_dequeue_unpublished, setup, NULL, MUNIT_TEST_OPTION_NONE, NULL},
+        {"/wraparound", test_ipwi_wraparound, setup, NULL, MUNIT_TEST_OPTION_NONE, NULL},
+        {"/concurrent_producers", test_ipwi_concurrent_producers, setup, NULL, MUNIT_TEST_OPTION_NONE, NULL},
+        {"/notify", test_ipwi_notify_calls_arch, setup, NULL, MUNIT_TEST_OPTION_NONE, NULL},
+        {"/ipi_handler_panic", test_ipwi_ipi_handler_panic, setup, NULL, MUNIT_TEST_OPTION_NONE, NULL},
+        {"/ipi_handler_tlb_shootdown", test_ipwi_ipi_handler_tlb_shootdown, setup, NULL, MUNIT_TEST_OPTION_NONE, NULL},
+        {"/ipi_handler_tlb_shootdown_full_flush", test_ipwi_ipi_handler_tlb_shootdown_full_flush, NULL, NULL,
+         MUNIT_TEST_OPTION_NONE, NULL},
+        {"/ipi_handler_tlb_shootdown_ack", test_ipwi_ipi_handler_tlb_shootdown_ack, setup, NULL, MUNIT_TEST_OPTION_NONE,
+         NULL},
+        {"/ipi_handler_tlb_shootdown_other_process", test_ipwi_ipi_handler_tlb_shootdown_other_process, NULL, NULL,
+         MUNIT_TEST_OPTION_NONE, NULL},
+        {"/ipi_handler_tlb_shootdown_other_pml4", test_ipwi_ipi_handler_tlb_shootdown_other_pml4, setup, NULL,
+         MUNIT_TEST_OPTION_NONE, NULL},
+        {"/ipi_handler_tlb_shootdown_loaded_pml4", test_ipwi_ipi_handler_tlb_shootdown_loaded_pml4, setup, NULL,
+         MUNIT_TEST_OPTION_NONE, NULL},
+        {"/ipi_handler_tlb_shootdown_kernel", test_ipwi_ipi_handler_tlb_shootdown_kernel, setup, NULL,
+         MUNIT_TEST_OPTION_NONE, NULL},
+        {"/ipi_handler_tlb_shootdown_kernel_full_flush", test_ipwi_ipi_handler_tlb_shootdown_kernel_full_flush, setup,
+         NULL, MUNIT_TEST_OPTION_NONE, NULL},
+        {"/ipi_handler_flush_request", test_ipwi_ipi_handler_flush_request, setup, NULL, MUNIT_TEST_OPTION_NONE, NULL},
+        {"/request_tlb_flush_invalid", test_ipwi_request_tlb_flush_invalid_cpu, setup, NULL, MUNIT_TEST_OPTION_NONE,
+         NULL},
+        {"/notify_one", test_ipwi_notify_one, setup, NULL, MUNIT_TEST_OPTION_NONE, NULL},
+        {"/notify_reschedule", test_ipwi_notify_reschedule, setup, NULL, MUNIT_TEST_OPTION_NONE, NULL},
+        {"/notify_reschedule_coalesces", test_ipwi_notify_reschedule_coalesces, setup, NULL, MUNIT_TEST_OPTION_NONE,
+         NULL},
+        {"/notify_reschedule_invalid", test_ipwi_notify_reschedule_invalid_cpu, setup, NULL, MUNIT_TEST_OPTION_NONE,
+         NULL},
+        {"/reschedule_handler", test_ipwi_reschedule_handler, setup, NULL, MUNIT_TEST_OPTION_NONE, NULL},
+        {NULL, NULL, setup, NULL, MUNIT_TEST_OPTION_NONE, NULL}};
 
 static const MunitSuite ipwi_test_suite = {"/ipwi", ipwi_tests, NULL, 1, MUNIT_SUITE_OPTION_NONE};
 
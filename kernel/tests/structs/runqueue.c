@@ -0,0 +1,269 @@
+/*
+ * stage3 - Tests for constant-time task run queue
+ * anos - An Operating System
+ *
+ * Copyright (c) 2025 Ross Bamford
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+#include "munit.h"
+#include "structs/runqueue.h"
+
+typedef struct {
+    TaskRunQueue rq;
+    TaskRunList levels[TASK_RQ_LEVELS];
+    Task nodes[10]; // Pre-allocated nodes for testing
+    TaskSched scheds[10];
+} RQFixture;
+
+static void *rq_setup(const MunitParameter params[], void *user_data) {
+    RQFixture *fixture = munit_new(RQFixture);
+
+    // Deliberately dirty the level lists - they should never be read
+    // unless the occupancy bitmap says they're valid...
+    memset(fixture->levels, 0xa5, sizeof(fixture->levels));
+
+    task_rq_init(&fixture->rq, fixture->levels);
+
+    for (int i = 0; i < 10; i++) {
+        fixture->nodes[i].sched = &fixture->scheds[i];
+        fixture->nodes[i].sched->prio = 0;
+        fixture->nodes[i].this.next = NULL;
+    }
+    return fixture;
+}
+
+static void rq_tear_down(void *fixture) { free(fixture); }
+
+static MunitResult test_empty_queue(const MunitParameter params[], void *fixture) {
+    RQFixture *f = (RQFixture *)fixture;
+
+    munit_assert_true(task_rq_empty(&f->rq));
+    munit_assert_null(task_rq_peek(&f->rq));
+    munit_assert_null(task_rq_pop(&f->rq));
+
+    return MUNIT_OK;
+}
+
+static MunitResult test_single_element(const MunitParameter params[], void *fixture) {
+    RQFixture *f = (RQFixture *)fixture;
+
+    f->nodes[0].sched->prio = 5;
+    task_rq_push(&f->rq, &f->nodes[0]);
+
+    munit_assert_false(task_rq_empty(&f->rq));
+    munit_assert_ptr_equal(task_rq_peek(&f->rq), &f->nodes[0]);
+    munit_assert_null(f->nodes[0].this.next);
+
+    Task *popped = task_rq_pop(&f->rq);
+    munit_assert_ptr_equal(popped, &f->nodes[0]);
+    munit_assert_true(task_rq_empty(&f->rq));
+
+    return MUNIT_OK;
+}
+
+static MunitResult test_priority_ordering(const MunitParameter params[], void *fixture) {
+    RQFixture *f = (RQFixture *)fixture;
+
+    f->nodes[0].sched->prio = 5;
+    f->nodes[1].sched->prio = 3;
+    f->nodes[2].sched->prio = 7;
+    f->nodes[3].sched->prio = 1;
+
+    task_rq_push(&f->rq, &f->nodes[0]); // 5
+    task_rq_push(&f->rq, &f->nodes[1]); // 3
+    task_rq_push(&f->rq, &f->nodes[2]); // 7
+    task_rq_push(&f->rq, &f->nodes[3]); // 1
+
+    munit_assert_int(task_rq_pop(&f->rq)->sched->prio, ==, 1);
+    munit_assert_int(task_rq_pop(&f->rq)->sched->prio, ==, 3);
+    munit_assert_int(task_rq_pop(&f->rq)->sched->prio, ==, 5);
+    munit_assert_int(task_rq_pop(&f->rq)->sched->prio, ==, 7);
+    munit_assert_true(task_rq_empty(&f->rq));
+
+    return MUNIT_OK;
+}
+
+static MunitResult test_fifo_within_priority(const MunitParameter params[], void *fixture) {
+    RQFixture *f = (RQFixture *)fixture;
+
+    f->nodes[0].sched->prio = 5;
+    f->nodes[1].sched->prio = 5;
+    f->nodes[2].sched->prio = 3;
+    f->nodes[3].sched->prio = 3;
+
+    task_rq_push(&f->rq, &f->nodes[0]);
+    task_rq_push(&f->rq, &f->nodes[1]);
+    task_rq_push(&f->rq, &f->nodes[2]);
+    task_rq_push(&f->rq, &f->nodes[3]);
+
+    munit_assert_ptr_equal(task_rq_pop(&f->rq), &f->nodes[2]);
+    munit_assert_ptr_equal(task_rq_pop(&f->rq), &f->nodes[3]);
+    munit_assert_ptr_equal(task_rq_pop(&f->rq), &f->nodes[0]);
+    munit_assert_ptr_equal(task_rq_pop(&f->rq), &f->nodes[1]);
+    munit_assert_true(task_rq_empty(&f->rq));
+
+    return MUNIT_OK;
+}
+
+static MunitResult test_push_front(const MunitParameter params[], void *fixture) {
+    RQFixture *f = (RQFixture *)fixture;
+
+    f->nodes[0].sched->prio = 5;
+    f->nodes[1].sched->prio = 5;
+    f->nodes[2].sched->prio = 9;
+
+    task_rq_push(&f->rq, &f->nodes[0]);
+    task_rq_push_front(&f->rq, &f->nodes[1]);
+    task_rq_push_front(&f->rq, &f->nodes[2]);
+
+    // Front of its own level, but not ahead of higher priority levels
+    munit_assert_ptr_equal(task_rq_pop(&f->rq), &f->nodes[1]);
+    munit_assert_ptr_equal(task_rq_pop(&f->rq), &f->nodes[0]);
+    munit_assert_ptr_equal(task_rq_pop(&f->rq), &f->nodes[2]);
+    munit_assert_true(task_rq_empty(&f->rq));
+
+    return MUNIT_OK;
+}
+
+static MunitResult test_push_front_then_back(const MunitParameter params[], void *fixture) {
+    RQFixture *f = (RQFixture *)fixture;
+
+    f->nodes[0].sched->prio = 42;
+    f->nodes[1].sched->prio = 42;
+
+    // push_front into an empty level must set the tail too
+    task_rq_push_front(&f->rq, &f->nodes[0]);
+    task_rq_push(&f->rq, &f->nodes[1]);
+
+    munit_assert_ptr_equal(task_rq_pop(&f->rq), &f->nodes[0]);
+    munit_assert_ptr_equal(task_rq_pop(&f->rq), &f->nodes[1]);
+    munit_assert_true(task_rq_empty(&f->rq));
+
+    return MUNIT_OK;
+}
+
+static MunitResult test_null_node(const MunitParameter params[], void *fixture) {
+    RQFixture *f = (RQFixture *)fixture;
+
+    task_rq_push(&f->rq, NULL);
+    task_rq_push_front(&f->rq, NULL);
+    munit_assert_true(task_rq_empty(&f->rq));
+
+    return MUNIT_OK;
+}
+
+static MunitResult test_reused_node(const MunitParameter params[], void *fixture) {
+    RQFixture *f = (RQFixture *)fixture;
+
+    f->nodes[0].sched->prio = 5;
+    task_rq_push(&f->rq, &f->nodes[0]);
+
+    Task *popped = task_rq_pop(&f->rq);
+    munit_assert_ptr_equal(popped, &f->nodes[0]);
+    munit_assert_null(popped->this.next);
+
+    popped->sched->prio = 3;
+    task_rq_push(&f->rq, popped);
+
+    Task *repopped = task_rq_pop(&f->rq);
+    munit_assert_ptr_equal(repopped, &f->nodes[0]);
+    munit_assert_int(repopped->sched->prio, ==, 3);
+    munit_assert_true(task_rq_empty(&f->rq));
+
+    return MUNIT_OK;
+}
+
+static MunitResult test_extreme_priorities(const MunitParameter params[], void *fixture) {
+    RQFixture *f = (RQFixture *)fixture;
+
+    f->nodes[0].sched->prio = UINT8_MAX;
+    f->nodes[1].sched->prio = 0;
+    f->nodes[2].sched->prio = 63;
+    f->nodes[3].sched->prio = 64;
+    f->nodes[4].sched->prio = 191;
+    f->nodes[5].sched->prio = 192;
+
+    task_rq_push(&f->rq, &f->nodes[0]);
+    task_rq_push(&f->rq, &f->nodes[5]);
+    task_rq_push(&f->rq, &f->nodes[3]);
+    task_rq_push(&f->rq, &f->nodes[1]);
+    task_rq_push(&f->rq, &f->nodes[4]);
+    task_rq_push(&f->rq, &f->nodes[2]);
+
+    // Check every bitmap word boundary
+    munit_assert_int(task_rq_pop(&f->rq)->sched->prio, ==, 0);
+    munit_assert_int(task_rq_pop(&f->rq)->sched->prio, ==, 63);
+    munit_assert_int(task_rq_pop(&f->rq)->sched->prio, ==, 64);
+    munit_assert_int(task_rq_pop(&f->rq)->sched->prio, ==, 191);
+    munit_assert_int(task_rq_pop(&f->rq)->sched->prio, ==, 192);
+    munit_assert_int(task_rq_pop(&f->rq)->sched->prio, ==, UINT8_MAX);
+    munit_assert_true(task_rq_empty(&f->rq));
+
+    return MUNIT_OK;
+}
+
+static MunitResult test_alternating_priorities(const MunitParameter params[], void *fixture) {
+    RQFixture *f = (RQFixture *)fixture;
+
+    for (int i = 0; i < 8; i++) {
+        f->nodes[i].sched->prio = (i % 2 == 0) ? 100 : 1;
+    }
+
+    for (int i = 0; i < 8; i++) {
+        task_rq_push(&f->rq, &f->nodes[i]);
+    }
+
+    // Grouped by priority, FIFO within each group
+    for (int i = 1; i < 8; i += 2) {
+        munit_assert_ptr_equal(task_rq_pop(&f->rq), &f->nodes[i]);
+    }
+    for (int i = 0; i < 8; i += 2) {
+        munit_assert_ptr_equal(task_rq_pop(&f->rq), &f->nodes[i]);
+    }
+
+    munit_assert_true(task_rq_empty(&f->rq));
+
+    return MUNIT_OK;
+}
+
+static MunitResult test_empty_refill(const MunitParameter params[], void *fixture) {
+    RQFixture *f = (RQFixture *)fixture;
+
+    for (int cycle = 0; cycle < 3; cycle++) {
+        munit_assert_true(task_rq_empty(&f->rq));
+
+        f->nodes[0].sched->prio = 3;
+        f->nodes[1].sched->prio = 1;
+        task_rq_push(&f->rq, &f->nodes[0]);
+        task_rq_push(&f->rq, &f->nodes[1]);
+
+        munit_assert_false(task_rq_empty(&f->rq));
+
+        munit_assert_int(task_rq_pop(&f->rq)->sched->prio, ==, 1);
+        munit_assert_int(task_rq_pop(&f->rq)->sched->prio, ==, 3);
+    }
+
+    return MUNIT_OK;
+}
+
+static MunitTest tests[] = {
+        {"/empty_queue", test_empty_queue, rq_setup, rq_tear_down, MUNIT_TEST_OPTION_NONE, NULL},
+        {"/single_element", test_single_element, rq_setup, rq_tear_down, MUNIT_TEST_OPTION_NONE, NULL},
+        {"/priority_ordering", test_priority_ordering, rq_setup, rq_tear_down, MUNIT_TEST_OPTION_NONE, NULL},
+        {"/fifo_within_priority", test_fifo_within_priority, rq_setup, rq_tear_down, MUNIT_TEST_OPTION_NONE, NULL},
+        {"/push_front", test_push_front, rq_setup, rq_tear_down, MUNIT_TEST_OPTION_NONE, NULL},
+        {"/push_front_then_back", test_push_front_then_back, rq_setup, rq_tear_down, MUNIT_TEST_OPTION_NONE, NULL},
+        {"/null_node", test_null_node, rq_setup, rq_tear_down, MUNIT_TEST_OPTION_NONE, NULL},
+        {"/reused_node", test_reused_node, rq_setup, rq_tear_down, MUNIT_TEST_OPTION_NONE, NULL},
+        {"/extreme_priorities", test_extreme_priorities, rq_setup, rq_tear_down, MUNIT_TEST_OPTION_NONE, NULL},
+        {"/alternating_priorities", test_alternating_priorities, rq_setup, rq_tear_down, MUNIT_TEST_OPTION_NONE, NULL},
+        {"/empty_refill", test_empty_refill, rq_setup, rq_tear_down, MUNIT_TEST_OPTION_NONE, NULL},
+
+        {NULL, NULL, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL}};
+
+static const MunitSuite suite = {"/runqueue", tests, NULL, 1, MUNIT_SUITE_OPTION_NONE};
+
+int main(int argc, char *argv[]) { return munit_suite_main(&suite, NULL, argc, argv); }
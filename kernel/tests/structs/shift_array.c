@@ -96,10 +96,40 @@ static MunitResult test_remove_behavior(const MunitParameter params[], void *dat
     return MUNIT_OK;
 }
 
+static MunitResult test_queue_recentres(const MunitParameter params[], void *data) {
+    ShiftToMiddleArray arr;
+    munit_assert_true(shift_array_init(&arr, sizeof(int), 8));
+
+    // Steady queue use never has more than two in it, so shouldn't keep growing
+    for (int i = 0; i < 1000; i++) {
+        munit_assert_true(shift_array_insert_tail(&arr, &i));
+        munit_assert_true(shift_array_insert_tail(&arr, &i));
+
+        munit_assert_int(*(int *)shift_array_get_head(&arr), ==, i);
+        shift_array_remove_head(&arr);
+        shift_array_remove_head(&arr);
+    }
+
+    munit_assert_uint64(arr.capacity, ==, 8);
+
+    // Same the other way
+    for (int i = 0; i < 1000; i++) {
+        munit_assert_true(shift_array_insert_head(&arr, &i));
+        munit_assert_int(*(int *)shift_array_get_tail(&arr), ==, i);
+        shift_array_remove_tail(&arr);
+    }
+
+    munit_assert_uint64(arr.capacity, ==, 8);
+
+    shift_array_free(&arr);
+    return MUNIT_OK;
+}
+
 static MunitTest tests[] = {{"/insert_head", test_insert_head, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL},
                             {"/insert_tail", test_insert_tail, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL},
                             {"/head_tail_access", test_head_tail_access, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL},
                             {"/remove_behavior", test_remove_behavior, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL},
+                            {"/queue_recentres", test_queue_recentres, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL},
                             {NULL, NULL, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL}};
 
 static const MunitSuite suite = {"/shift_array", tests, NULL, 1, MUNIT_SUITE_OPTION_NONE};
@@ -14,6 +14,7 @@
 #include "mock_pagetables.h"
 #include "mock_pmm.h"
 #include "smp/state.h"
+#include "x86_64/fpu.h"
 
 static const int PAGES_PER_SLAB = BYTES_PER_SLAB / VM_PAGE_SIZE;
 
@@ -26,9 +27,13 @@ static const void *TEST_TASK_TSS = (void *)0x9090404080803030;
 
 static uintptr_t sys_stack;
 static Process mock_owner;
+static ProcessCpus mock_owner_cpus;
 
 static char last_konservative_msg[128];
 static bool panic_called = false;
+static void *last_fpu_init_area;
+static const Process *last_asid_process;
+static uintptr_t last_asid_root;
 
 void mock_kprintf(const char *msg) { strncpy(last_konservative_msg, msg, sizeof(last_konservative_msg)); }
 
@@ -38,6 +43,12 @@ void user_thread_entrypoint(void);
 void panic_sloc(char *msg) { panic_called = true; }
 void process_destroy(Process *process) { /* nothing*/ }
 void sched_schedule(void) { /* nothing*/ }
+void fpu_init_task_state(void *area) { last_fpu_init_area = area; }
+
+void asid_switch_to(const Process *process, const uintptr_t pagetable_root) {
+    last_asid_process = process;
+    last_asid_root = pagetable_root;
+}
 
 static inline void *slab_area_base(void *page_area_ptr) {
     // skip one page used by FBA, and three unused by slab alignment
@@ -60,6 +71,9 @@ static MunitResult test_task_create_new(const MunitParameter params[], void *pag
     // Task data is actually the sdata member in the 4KiB task struct...
     munit_assert_ptr_equal(task->data, &task->sdata);
 
+    // ... and it starts out with the initial FPU state
+    munit_assert_ptr_equal(last_fpu_init_area, task->data);
+
     // Check basic details
     munit_assert_ptr_equal(task->owner, &mock_owner);
 
@@ -70,11 +84,11 @@ static MunitResult test_task_create_new(const MunitParameter params[], void *pag
     munit_assert_uint8(task->sched->state, ==, TASK_STATE_READY);
     munit_assert_uint8(task->sched->status_flags, ==, 0);
 
-    // -128 because reg space was reserved, and func was pushed
-    munit_assert_uint64(task->ssp, ==, sys_stack - 128);
+    // -72 because reg space was reserved, and func was pushed
+    munit_assert_uint64(task->ssp, ==, sys_stack - 72);
 
     // func addr is "valid" and was pushed after reserved register space...
-    munit_assert_uint64(*(uint64_t *)(task->ssp + 120), ==, (uint64_t)TEST_BOOT_FUNC);
+    munit_assert_uint64(*(uint64_t *)(task->ssp + 64), ==, (uint64_t)TEST_BOOT_FUNC);
 
     // r15 register slot on stack has user function entrypoint
     munit_assert_uint64(*(uint64_t *)(task->ssp), ==, TEST_SYS_FUNC);
@@ -113,11 +127,11 @@ static MunitResult test_task_create_kernel(const MunitParameter params[], void *
     munit_assert_uint8(task->sched->state, ==, TASK_STATE_READY);
     munit_assert_uint8(task->sched->status_flags, ==, 0);
 
-    // -128 because reg space was reserved, and func was pushed
-    munit_assert_uint64(task->ssp, ==, sys_stack - 128);
+    // -72 because reg space was reserved, and func was pushed
+    munit_assert_uint64(task->ssp, ==, sys_stack - 72);
 
     // func addr is "valid" and was pushed after reserved register space...
-    munit_assert_uint64(*(uint64_t *)(task->ssp + 120), ==, (uint64_t)kernel_thread_entrypoint);
+    munit_assert_uint64(*(uint64_t *)(task->ssp + 64), ==, (uint64_t)kernel_thread_entrypoint);
 
     // r15 register slot on stack has user function entrypoint
     munit_assert_uint64(*(uint64_t *)(task->ssp), ==, TEST_SYS_FUNC);
@@ -156,11 +170,11 @@ static MunitResult test_task_create_user(const MunitParameter params[], void *pa
     munit_assert_uint8(task->sched->state, ==, TASK_STATE_READY);
     munit_assert_uint8(task->sched->status_flags, ==, 0);
 
-    // -128 because reg space was reserved, and func was pushed
-    munit_assert_uint64(task->ssp, ==, sys_stack - 128);
+    // -72 because reg space was reserved, and func was pushed
+    munit_assert_uint64(task->ssp, ==, sys_stack - 72);
 
     // func addr is "valid" and was pushed after reserved register space...
-    munit_assert_uint64(*(uint64_t *)(task->ssp + 120), ==, (uint64_t)user_thread_entrypoint);
+    munit_assert_uint64(*(uint64_t *)(task->ssp + 64), ==, (uint64_t)user_thread_entrypoint);
 
     // r15 register slot on stack has user function entrypoint
     munit_assert_uint64(*(uint64_t *)(task->ssp), ==, TEST_SYS_FUNC);
@@ -271,6 +285,36 @@ static MunitResult test_task_destroy_null_task(const MunitParameter params[], vo
 #endif
 }
 
+static MunitResult test_task_switch_cpu_mask(const MunitParameter params[], void *page_area_ptr) {
+    ProcessCpus other_cpus = {0};
+    Process other_owner = {.pml4 = TEST_PAGETABLE_ROOT + 0x1000, .cpus = &other_cpus};
+    Task *task1 = task_create_kernel(&mock_owner, TEST_SYS_SP, sys_stack, TEST_SYS_FUNC, TASK_CLASS_IDLE);
+    Task *task2 = task_create_kernel(&mock_owner, TEST_SYS_SP, sys_stack, TEST_SYS_FUNC, TASK_CLASS_IDLE);
+    Task *task3 = task_create_kernel(&other_owner, TEST_SYS_SP, sys_stack, TEST_SYS_FUNC, TASK_CLASS_IDLE);
+
+    __test_this_cpu = 2;
+    __test_cpu_state[2].cpu_id = 2;
+    mock_owner_cpus.cpu_mask.words[0] = 0x1;
+
+    task_switch(task1);
+    munit_assert_uint64(mock_owner_cpus.cpu_mask.words[0], ==, 0x5);
+
+    // Same address space, stays loaded
+    task_switch(task2);
+    munit_assert_uint64(mock_owner_cpus.cpu_mask.words[0], ==, 0x5);
+
+    task_switch(task3);
+    munit_assert_uint64(mock_owner_cpus.cpu_mask.words[0], ==, 0x1);
+    munit_assert_uint64(other_cpus.cpu_mask.words[0], ==, 0x4);
+
+    // Page tables are loaded (with the ASID) before the switch proper
+    munit_assert_ptr_equal(last_asid_process, &other_owner);
+    munit_assert_uint64(last_asid_root, ==, TEST_PAGETABLE_ROOT + 0x1000);
+
+    __test_this_cpu = 0;
+    return MUNIT_OK;
+}
+
 #define TEST_PML4_ADDR (((uint64_t *)0x100000))
 #define TEST_PAGE_COUNT ((32768))
 static void *test_setup(const MunitParameter params[], void *user_data) {
@@ -283,6 +327,8 @@ static void *test_setup(const MunitParameter params[], void *user_data) {
     task_init((void *)TEST_TASK_TSS);
 
     mock_owner.pml4 = TEST_PAGETABLE_ROOT;
+    mock_owner.cpus = &mock_owner_cpus;
+    mock_owner_cpus = (ProcessCpus){0};
 
     return page_area_ptr;
 }
@@ -311,6 +357,8 @@ static MunitTest test_suite_tests[] = {
          MUNIT_TEST_OPTION_NONE, NULL},
         {(char *)"/remove_from_process_null", test_task_remove_from_process_null_inputs, test_setup, test_teardown,
          MUNIT_TEST_OPTION_NONE, NULL},
+        {(char *)"/switch_cpu_mask", test_task_switch_cpu_mask, test_setup, test_teardown, MUNIT_TEST_OPTION_NONE,
+         NULL},
 
         {NULL, NULL, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL},
 };
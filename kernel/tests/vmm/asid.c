@@ -0,0 +1,563 @@
+/*
+ * Tests for address space IDs
+ * anos - An Operating System
+ *
+ * Copyright (c) 2025 Ross Bamford
+ */
+
+#include "munit.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "process.h"
+#include "smp/state.h"
+#include "task.h"
+#include "vmm/asid.h"
+
+#define ROOT_A ((0x100000))
+#define ROOT_B ((0x200000))
+#define KERNEL_ROOT ((0x300000))
+
+#define TEMP_PAGE ((0xFFFFFFFF80400000))
+#define KERNEL_PAGE ((0xFFFFFFFF80000000))
+
+#define MANY_PROCESSES ((1000))
+
+static uint16_t mock_asids;
+static uint32_t switch_count;
+static uint32_t flush_count;
+static uint32_t flush_all_count;
+static uintptr_t last_switch_root;
+static uint16_t last_switch_asid;
+static bool last_switch_flush;
+static bool mock_has_invalidate_page;
+static uint32_t invalidate_page_count;
+static uint16_t last_invalidate_asid;
+
+static Process process_a;
+static Process process_b;
+static ProcessCpus cpus_a;
+static ProcessCpus cpus_b;
+static Task task;
+static Task *current_task;
+
+static Process many_processes[MANY_PROCESSES];
+static ProcessCpus many_cpus[MANY_PROCESSES];
+
+void mock_fba_reset(void);
+void mock_fba_set_should_fail(bool should_fail);
+void fba_free(void *ptr);
+
+uint16_t arch_asid_init_this_cpu(bool want_asids) { return want_asids ? mock_asids : 0; }
+
+void arch_asid_switch(uintptr_t pagetable_root, uint16_t asid, bool flush) {
+    switch_count++;
+    flush_count += flush;
+    last_switch_root = pagetable_root;
+    last_switch_asid = asid;
+    last_switch_flush = flush;
+}
+
+bool arch_asid_invalidate_page(uint16_t asid, uintptr_t virt_addr) {
+    if (mock_has_invalidate_page) {
+        invalidate_page_count++;
+        last_invalidate_asid = asid;
+    }
+
+    return mock_has_invalidate_page;
+}
+
+void arch_asid_flush_all(void) { flush_all_count++; }
+
+Task *task_current(void) { return current_task; }
+
+// Tables aren't freed in the kernel, since they're for life
+static void reinit_this_cpu(void) {
+    fba_free(__test_cpu_state[__test_this_cpu].asids.table);
+    asid_init_this_cpu();
+}
+
+static MunitResult test_init(const MunitParameter params[], void *param) {
+    const PerCPUAsidState *asids = &__test_cpu_state[0].asids;
+
+    munit_assert_not_null(asids->table);
+    munit_assert_uint16(asids->max_asid, ==, ASID_MAX);
+    munit_assert_uint16(asids->next_asid, ==, 1);
+    munit_assert_uint16(asids->loaded_asid, ==, 0);
+    munit_assert_uint64(asids->loaded_root, ==, 0);
+    munit_assert_uint32(asids->generation, ==, 0);
+
+    for (int i = 0; i < ASID_TABLE_ENTRIES; i++) {
+        munit_assert_uint64(asids->table->entries[i].pid, ==, 0);
+    }
+
+    return MUNIT_OK;
+}
+
+static MunitResult test_init_few_asids(const MunitParameter params[], void *param) {
+    mock_asids = 2;
+    reinit_this_cpu();
+
+    munit_assert_uint16(__test_cpu_state[0].asids.max_asid, ==, 2);
+
+    return MUNIT_OK;
+}
+
+static MunitResult test_init_too_many_asids(const MunitParameter params[], void *param) {
+    mock_asids = 0xffff;
+    reinit_this_cpu();
+
+    munit_assert_uint16(__test_cpu_state[0].asids.max_asid, ==, ASID_MAX);
+
+    return MUNIT_OK;
+}
+
+static MunitResult test_init_no_table(const MunitParameter params[], void *param) {
+    mock_fba_set_should_fail(true);
+    reinit_this_cpu();
+
+    munit_assert_null(__test_cpu_state[0].asids.table);
+    munit_assert_uint16(__test_cpu_state[0].asids.max_asid, ==, 0);
+
+    // Does without
+    asid_switch_to(&process_a, ROOT_A);
+    munit_assert_uint16(last_switch_asid, ==, 0);
+    munit_assert_true(last_switch_flush);
+
+    return MUNIT_OK;
+}
+
+static MunitResult test_first_switch_no_flush(const MunitParameter params[], void *param) {
+    asid_switch_to(&process_a, ROOT_A);
+
+    // Nothing's ever been under a new ASID
+    munit_assert_uint32(switch_count, ==, 1);
+    munit_assert_uint64(last_switch_root, ==, ROOT_A);
+    munit_assert_uint16(last_switch_asid, ==, 1);
+    munit_assert_false(last_switch_flush);
+
+    return MUNIT_OK;
+}
+
+static MunitResult test_same_process_no_switch(const MunitParameter params[], void *param) {
+    asid_switch_to(&process_a, ROOT_A);
+    asid_switch_to(&process_a, ROOT_A);
+
+    munit_assert_uint32(switch_count, ==, 1);
+
+    return MUNIT_OK;
+}
+
+static MunitResult test_ping_pong_no_flush(const MunitParameter params[], void *param) {
+    asid_switch_to(&process_a, ROOT_A);
+    asid_switch_to(&process_b, ROOT_B);
+
+    munit_assert_uint16(last_switch_asid, ==, 2);
+
+    for (int i = 0; i < 10; i++) {
+        asid_switch_to(&process_a, ROOT_A);
+        munit_assert_uint16(last_switch_asid, ==, 1);
+        munit_assert_false(last_switch_flush);
+
+        asid_switch_to(&process_b, ROOT_B);
+        munit_assert_uint16(last_switch_asid, ==, 2);
+        munit_assert_false(last_switch_flush);
+    }
+
+    munit_assert_uint32(switch_count, ==, 22);
+    munit_assert_uint32(flush_count, ==, 0);
+
+    return MUNIT_OK;
+}
+
+static MunitResult test_many_processes_no_flush(const MunitParameter params[], void *param) {
+    for (int round = 0; round < 3; round++) {
+        for (int i = 0; i < 64; i++) {
+            asid_switch_to(&many_processes[i], ROOT_A + (i << 12));
+
+            // Each keeps the one it got first time round
+            munit_assert_uint16(last_switch_asid, ==, i + 1);
+        }
+    }
+
+    munit_assert_uint32(flush_count, ==, 0);
+    munit_assert_uint32(flush_all_count, ==, 0);
+
+    return MUNIT_OK;
+}
+
+static MunitResult test_more_than_table_no_flush(const MunitParameter params[], void *param) {
+    const PerCPUAsidState *asids = &__test_cpu_state[0].asids;
+
+    for (int round = 0; round < 2; round++) {
+        for (int i = 0; i < MANY_PROCESSES; i++) {
+            asid_switch_to(&many_processes[i], ROOT_A + (i << 12));
+        }
+    }
+
+    // Those that fell out of the table got new ones, none were reused
+    munit_assert_uint16(asids->next_asid, >, MANY_PROCESSES + 1);
+    munit_assert_uint32(asids->generation, ==, 0);
+    munit_assert_uint32(flush_count, ==, 0);
+    munit_assert_uint32(flush_all_count, ==, 0);
+
+    return MUNIT_OK;
+}
+
+static MunitResult test_run_out_flushes_all(const MunitParameter params[], void *param) {
+    const PerCPUAsidState *asids = &__test_cpu_state[0].asids;
+
+    mock_asids = 2;
+    reinit_this_cpu();
+
+    asid_switch_to(&process_a, ROOT_A);
+    asid_switch_to(&process_b, ROOT_B);
+    munit_assert_uint32(flush_all_count, ==, 0);
+
+    // Third one starts a new generation, with everything flushed
+    asid_switch_to(&many_processes[0], ROOT_A + 0x1000);
+    munit_assert_uint16(last_switch_asid, ==, 1);
+    munit_assert_uint32(flush_all_count, ==, 1);
+    munit_assert_uint32(asids->generation, ==, 1);
+
+    // A lost its ASID with the rest, so gets the next one - nothing to flush
+    asid_switch_to(&process_a, ROOT_A);
+    munit_assert_uint16(last_switch_asid, ==, 2);
+    munit_assert_false(last_switch_flush);
+    munit_assert_uint32(flush_all_count, ==, 1);
+
+    asid_switch_to(&many_processes[0], ROOT_A + 0x1000);
+    munit_assert_uint16(last_switch_asid, ==, 1);
+    munit_assert_uint32(flush_all_count, ==, 1);
+
+    return MUNIT_OK;
+}
+
+static MunitResult test_stale_flushes_and_clears(const MunitParameter params[], void *param) {
+    asid_switch_to(&process_a, ROOT_A);
+    asid_switch_to(&process_b, ROOT_B);
+
+    cpus_a.tlb_stale_mask.words[0] = 0x3;
+
+    asid_switch_to(&process_a, ROOT_A);
+    munit_assert_uint16(last_switch_asid, ==, 1);
+    munit_assert_true(last_switch_flush);
+
+    // Only our bit goes
+    munit_assert_uint64(cpus_a.tlb_stale_mask.words[0], ==, 0x2);
+
+    asid_switch_to(&process_b, ROOT_B);
+    asid_switch_to(&process_a, ROOT_A);
+    munit_assert_false(last_switch_flush);
+
+    return MUNIT_OK;
+}
+
+static MunitResult test_stale_loaded_flushes(const MunitParameter params[], void *param) {
+    asid_switch_to(&process_a, ROOT_A);
+
+    cpus_a.tlb_stale_mask.words[0] = 0x1;
+
+    asid_switch_to(&process_a, ROOT_A);
+    munit_assert_uint32(switch_count, ==, 2);
+    munit_assert_true(last_switch_flush);
+    munit_assert_uint64(cpus_a.tlb_stale_mask.words[0], ==, 0);
+
+    return MUNIT_OK;
+}
+
+static MunitResult test_no_process_uses_no_asid(const MunitParameter params[], void *param) {
+    asid_switch_to(&process_a, ROOT_A);
+    asid_switch_to(NULL, KERNEL_ROOT);
+
+    munit_assert_uint32(switch_count, ==, 2);
+    munit_assert_uint64(last_switch_root, ==, KERNEL_ROOT);
+    munit_assert_uint16(last_switch_asid, ==, 0);
+    munit_assert_true(last_switch_flush);
+
+    asid_switch_to(NULL, KERNEL_ROOT);
+    munit_assert_uint32(switch_count, ==, 2);
+
+    // And process A kept its ASID meanwhile
+    asid_switch_to(&process_a, ROOT_A);
+    munit_assert_uint16(last_switch_asid, ==, 1);
+    munit_assert_false(last_switch_flush);
+
+    return MUNIT_OK;
+}
+
+static MunitResult test_no_asids_only_root_changes(const MunitParameter params[], void *param) {
+    mock_asids = 0;
+    reinit_this_cpu();
+
+    asid_switch_to(&process_a, ROOT_A);
+    asid_switch_to(&process_a, ROOT_A);
+    munit_assert_uint32(switch_count, ==, 1);
+
+    asid_switch_to(&process_b, ROOT_B);
+    munit_assert_uint32(switch_count, ==, 2);
+    munit_assert_uint16(last_switch_asid, ==, 0);
+    munit_assert_true(last_switch_flush);
+
+    // Stale still flushes even on the same root
+    cpus_b.tlb_stale_mask.words[0] = 0x1;
+    asid_switch_to(&process_b, ROOT_B);
+    munit_assert_uint32(switch_count, ==, 3);
+
+    return MUNIT_OK;
+}
+
+static MunitResult test_kernel_mapping_kept(const MunitParameter params[], void *param) {
+    uintptr_t virt_addr;
+    size_t num_pages;
+
+    asid_switch_to(&process_a, ROOT_A);
+
+    munit_assert_false(asid_take_kernel_pages(&virt_addr, &num_pages));
+
+    asid_invalidate_mapping(KERNEL_PAGE + 0x2000);
+    asid_invalidate_mapping(KERNEL_PAGE);
+    asid_invalidate_mapping(KERNEL_PAGE + 0x1000);
+
+    // Nothing's flushed at the next switch - the mapper shoots these down instead
+    asid_switch_to(&process_b, ROOT_B);
+    munit_assert_uint32(flush_all_count, ==, 0);
+
+    munit_assert_true(asid_take_kernel_pages(&virt_addr, &num_pages));
+    munit_assert_uint64(virt_addr, ==, KERNEL_PAGE);
+    munit_assert_size(num_pages, ==, 3);
+
+    // ... and only once
+    munit_assert_false(asid_take_kernel_pages(&virt_addr, &num_pages));
+
+    return MUNIT_OK;
+}
+
+static MunitResult test_flush_all_this_cpu(const MunitParameter params[], void *param) {
+    asid_flush_all_this_cpu();
+    munit_assert_uint32(flush_all_count, ==, 1);
+
+    return MUNIT_OK;
+}
+
+static MunitResult test_temp_page_ignored(const MunitParameter params[], void *param) {
+    asid_switch_to(&process_a, ROOT_A);
+
+    asid_invalidate_mapping(TEMP_PAGE);
+    asid_invalidate_mapping(TEMP_PAGE + 0x3000);
+    asid_switch_to(&process_b, ROOT_B);
+
+    uintptr_t virt_addr;
+    size_t num_pages;
+
+    munit_assert_uint32(flush_all_count, ==, 0);
+    munit_assert_false(asid_take_kernel_pages(&virt_addr, &num_pages));
+
+    return MUNIT_OK;
+}
+
+static MunitResult test_user_mapping_marks_current(const MunitParameter params[], void *param) {
+    asid_invalidate_mapping(0x1000);
+    munit_assert_uint64(cpus_a.tlb_stale_mask.words[0], ==, 0);
+
+    current_task = &task;
+    asid_invalidate_mapping(0x1000);
+
+    munit_assert_uint64(cpus_a.tlb_stale_mask.words[0], ==, ~1ULL);
+    munit_assert_int(cpu_mask_count(&cpus_a.tlb_stale_mask), ==, CPU_MASK_WORDS * 64 - 1);
+
+    return MUNIT_OK;
+}
+
+static MunitResult test_invalidate_process_loaded(const MunitParameter params[], void *param) {
+    asid_switch_to(&process_a, ROOT_A);
+
+    asid_invalidate_process(&process_a, 0x1000, 1);
+
+    // Already done here by the caller
+    munit_assert_uint32(invalidate_page_count, ==, 0);
+    munit_assert_uint64(cpus_a.tlb_stale_mask.words[0], ==, ~1ULL);
+
+    return MUNIT_OK;
+}
+
+static MunitResult test_invalidate_process_unloaded(const MunitParameter params[], void *param) {
+    mock_has_invalidate_page = true;
+
+    asid_switch_to(&process_a, ROOT_A);
+    asid_switch_to(&process_b, ROOT_B);
+
+    asid_invalidate_process(&process_a, 0x1000, 4);
+
+    munit_assert_uint32(invalidate_page_count, ==, 4);
+    munit_assert_uint16(last_invalidate_asid, ==, 1);
+    munit_assert_uint64(cpus_a.tlb_stale_mask.words[0], ==, ~1ULL);
+
+    return MUNIT_OK;
+}
+
+static MunitResult test_invalidate_process_unloaded_no_invalidate(const MunitParameter params[], void *param) {
+    asid_switch_to(&process_a, ROOT_A);
+    asid_switch_to(&process_b, ROOT_B);
+
+    asid_invalidate_process(&process_a, 0x1000, 1);
+
+    // Can't do it now, so flush when we next switch to it
+    munit_assert_uint64(cpus_a.tlb_stale_mask.words[0], ==, ~0ULL);
+    munit_assert_int(cpu_mask_count(&cpus_a.tlb_stale_mask), ==, CPU_MASK_WORDS * 64);
+
+    asid_switch_to(&process_a, ROOT_A);
+    munit_assert_true(last_switch_flush);
+
+    return MUNIT_OK;
+}
+
+static MunitResult test_invalidate_process_unloaded_many_pages(const MunitParameter params[], void *param) {
+    mock_has_invalidate_page = true;
+
+    asid_switch_to(&process_a, ROOT_A);
+    asid_switch_to(&process_b, ROOT_B);
+
+    asid_invalidate_process(&process_a, 0x1000, 1000);
+
+    munit_assert_uint32(invalidate_page_count, ==, 0);
+    munit_assert_uint64(cpus_a.tlb_stale_mask.words[0], ==, ~0ULL);
+
+    return MUNIT_OK;
+}
+
+static MunitResult test_invalidate_process_no_asid_here(const MunitParameter params[], void *param) {
+    mock_has_invalidate_page = true;
+
+    asid_switch_to(&process_b, ROOT_B);
+
+    asid_invalidate_process(&process_a, 0x1000, 1);
+
+    munit_assert_uint32(invalidate_page_count, ==, 0);
+    munit_assert_uint64(cpus_a.tlb_stale_mask.words[0], ==, ~1ULL);
+
+    return MUNIT_OK;
+}
+
+static MunitResult test_forget_keeps_loaded(const MunitParameter params[], void *param) {
+    asid_switch_to(&process_a, ROOT_A);
+    asid_switch_to(&process_b, ROOT_B);
+
+    asid_forget_this_cpu();
+
+    // B is still loaded, and stays that way
+    asid_switch_to(&process_b, ROOT_B);
+    munit_assert_uint32(switch_count, ==, 2);
+
+    // A gets a new ASID, never used so nothing to flush. Its old one isn't handed out again.
+    asid_switch_to(&process_a, ROOT_A);
+    munit_assert_uint16(last_switch_asid, ==, 3);
+    munit_assert_false(last_switch_flush);
+    munit_assert_uint32(flush_all_count, ==, 0);
+
+    return MUNIT_OK;
+}
+
+static void *setup(const MunitParameter params[], void *user_data) {
+    memset(__test_cpu_state, 0, sizeof(__test_cpu_state));
+
+    for (int i = 0; i < 4; i++) {
+        __test_cpu_state[i].cpu_id = i;
+    }
+
+    __test_this_cpu = 0;
+
+    mock_fba_reset();
+
+    mock_asids = ASID_MAX;
+    mock_has_invalidate_page = false;
+    current_task = NULL;
+
+    memset(&process_a, 0, sizeof(Process));
+    memset(&process_b, 0, sizeof(Process));
+    process_a.pid = 1;
+    process_a.pml4 = ROOT_A;
+    process_b.pid = 2;
+    process_b.pml4 = ROOT_B;
+    memset(&cpus_a, 0, sizeof(ProcessCpus));
+    memset(&cpus_b, 0, sizeof(ProcessCpus));
+    process_a.cpus = &cpus_a;
+    process_b.cpus = &cpus_b;
+    task.owner = &process_a;
+
+    for (int i = 0; i < MANY_PROCESSES; i++) {
+        memset(&many_processes[i], 0, sizeof(Process));
+        memset(&many_cpus[i], 0, sizeof(ProcessCpus));
+        many_processes[i].pid = 100 + i;
+        many_processes[i].cpus = &many_cpus[i];
+    }
+
+    asid_init_this_cpu();
+
+    switch_count = 0;
+    flush_count = 0;
+    flush_all_count = 0;
+    last_switch_root = 0;
+    last_switch_asid = 0;
+    last_switch_flush = false;
+    invalidate_page_count = 0;
+    last_invalidate_asid = 0;
+
+    return NULL;
+}
+
+static void teardown(void *param) {
+    uintptr_t virt_addr;
+    size_t num_pages;
+
+    asid_take_kernel_pages(&virt_addr, &num_pages);
+
+    for (int i = 0; i < 4; i++) {
+        fba_free(__test_cpu_state[i].asids.table);
+    }
+}
+
+static MunitTest test_suite_tests[] = {
+        {(char *)"/init", test_init, setup, teardown, MUNIT_TEST_OPTION_NONE, NULL},
+        {(char *)"/init_few_asids", test_init_few_asids, setup, teardown, MUNIT_TEST_OPTION_NONE, NULL},
+        {(char *)"/init_too_many_asids", test_init_too_many_asids, setup, teardown, MUNIT_TEST_OPTION_NONE, NULL},
+        {(char *)"/init_no_table", test_init_no_table, setup, teardown, MUNIT_TEST_OPTION_NONE, NULL},
+        {(char *)"/switch/first_no_flush", test_first_switch_no_flush, setup, teardown, MUNIT_TEST_OPTION_NONE, NULL},
+        {(char *)"/switch/same_process", test_same_process_no_switch, setup, teardown, MUNIT_TEST_OPTION_NONE, NULL},
+        {(char *)"/switch/ping_pong_no_flush", test_ping_pong_no_flush, setup, teardown, MUNIT_TEST_OPTION_NONE, NULL},
+        {(char *)"/switch/many_processes_no_flush", test_many_processes_no_flush, setup, teardown,
+         MUNIT_TEST_OPTION_NONE, NULL},
+        {(char *)"/switch/more_than_table_no_flush", test_more_than_table_no_flush, setup, teardown,
+         MUNIT_TEST_OPTION_NONE, NULL},
+        {(char *)"/switch/run_out_flushes_all", test_run_out_flushes_all, setup, teardown, MUNIT_TEST_OPTION_NONE,
+         NULL},
+        {(char *)"/switch/stale_flushes", test_stale_flushes_and_clears, setup, teardown, MUNIT_TEST_OPTION_NONE, NULL},
+        {(char *)"/switch/stale_loaded_flushes", test_stale_loaded_flushes, setup, teardown, MUNIT_TEST_OPTION_NONE,
+         NULL},
+        {(char *)"/switch/no_process", test_no_process_uses_no_asid, setup, teardown, MUNIT_TEST_OPTION_NONE, NULL},
+        {(char *)"/switch/no_asids", test_no_asids_only_root_changes, setup, teardown, MUNIT_TEST_OPTION_NONE, NULL},
+        {(char *)"/mapping/kernel_kept", test_kernel_mapping_kept, setup, teardown, MUNIT_TEST_OPTION_NONE, NULL},
+        {(char *)"/mapping/temp_page_ignored", test_temp_page_ignored, setup, teardown, MUNIT_TEST_OPTION_NONE, NULL},
+        {(char *)"/mapping/user_marks_current", test_user_mapping_marks_current, setup, teardown,
+         MUNIT_TEST_OPTION_NONE, NULL},
+        {(char *)"/process/loaded", test_invalidate_process_loaded, setup, teardown, MUNIT_TEST_OPTION_NONE, NULL},
+        {(char *)"/process/unloaded", test_invalidate_process_unloaded, setup, teardown, MUNIT_TEST_OPTION_NONE, NULL},
+        {(char *)"/process/unloaded_no_invalidate", test_invalidate_process_unloaded_no_invalidate, setup, teardown,
+         MUNIT_TEST_OPTION_NONE, NULL},
+        {(char *)"/process/unloaded_many_pages", test_invalidate_process_unloaded_many_pages, setup, teardown,
+         MUNIT_TEST_OPTION_NONE, NULL},
+        {(char *)"/process/no_asid_here", test_invalidate_process_no_asid_here, setup, teardown, MUNIT_TEST_OPTION_NONE,
+         NULL},
+        {(char *)"/forget_keeps_loaded", test_forget_keeps_loaded, setup, teardown, MUNIT_TEST_OPTION_NONE, NULL},
+        {(char *)"/flush_all_this_cpu", test_flush_all_this_cpu, setup, teardown, MUNIT_TEST_OPTION_NONE, NULL},
+        {NULL, NULL, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL},
+};
+
+static const MunitSuite test_suite = {(char *)"/vmm/asid", test_suite_tests, NULL, 1, MUNIT_SUITE_OPTION_NONE};
+
+int main(int argc, char *argv[MUNIT_ARRAY_PARAM(argc + 1)]) {
+    return munit_suite_main(&test_suite, (void *)"µnit", argc, argv);
+}
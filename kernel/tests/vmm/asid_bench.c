@@ -0,0 +1,119 @@
+/*
+ * Microbenchmark - ASID switching
+ * anos - An Operating System
+ *
+ * Copyright (c) 2025 Ross Bamford
+ *
+ * Address space switches (ns per switch) between N processes taking
+ * turns on one CPU, running the real ASID code with and without ASIDs.
+ * The page table register can't be loaded here, so each switch that
+ * flushes is charged a fixed REFILL_COST_NS to stand in for the TLB
+ * misses that follow it, which is what dominates on real hardware:
+ *
+ *   no_asids  - what we used to do, every switch flushes
+ *   asids     - every process gets an ASID, and keeps it
+ *   stale     - as above, but every switch follows a shootdown of the
+ *               process being switched to, somewhere else
+ *
+ * Each line is followed by the flushes per switch it needed.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "bench.h"
+#include "process.h"
+#include "smp/state.h"
+#include "task.h"
+#include "vmm/asid.h"
+
+#define MAX_CPUS 4
+#define MAX_PROCESSES 64
+#define ROUNDS 100000
+#define REFILL_COST_NS 200
+
+PerCPUState __test_cpu_state[MAX_CPUS];
+uint16_t __test_cpu_count = MAX_CPUS;
+_Thread_local uint8_t __test_this_cpu;
+
+static Process processes[MAX_PROCESSES];
+static ProcessCpus process_cpus[MAX_PROCESSES];
+static uint16_t mock_asids;
+static uint64_t flush_count;
+
+void *fba_alloc_block(void) { return aligned_alloc(4096, 4096); }
+
+uint16_t arch_asid_init_this_cpu(bool want_asids) { return want_asids ? mock_asids : 0; }
+
+static void charge_flush(void) {
+    flush_count++;
+
+    const uint64_t start = bench_now_ns();
+
+    while (bench_now_ns() - start < REFILL_COST_NS)
+        ;
+}
+
+void arch_asid_switch(uintptr_t pagetable_root, uint16_t asid, bool flush) {
+    bench_consume(pagetable_root | asid);
+
+    if (flush) {
+        charge_flush();
+    }
+}
+
+bool arch_asid_invalidate_page(uint16_t asid, uintptr_t virt_addr) { return true; }
+void arch_asid_flush_all(void) { charge_flush(); }
+
+Task *task_current(void) { return NULL; }
+
+static const uint64_t process_counts[] = {2, 4, 6, 8, 16, 64};
+
+static void bench_switch(const char *mode, const uint16_t asids, const uint64_t count, const bool stale) {
+    free(__test_cpu_state[0].asids.table);
+    mock_asids = asids;
+    asid_init_this_cpu();
+    flush_count = 0;
+
+    const uint64_t start = bench_now_ns();
+
+    for (int round = 0; round < ROUNDS; round++) {
+        Process *next = &processes[round % count];
+
+        if (stale) {
+            __test_this_cpu = 1;
+            asid_invalidate_process(next, 0x400000, 1);
+            __test_this_cpu = 0;
+        }
+
+        asid_switch_to(next, next->pml4);
+    }
+
+    const uint64_t elapsed = bench_now_ns() - start;
+
+    bench_report("asid", mode, "procs", count, ROUNDS, elapsed);
+    printf("%-16s %-28s %10s=%-8llu %10.2f flushes/switch\n", "asid", mode, "procs", (unsigned long long)count,
+           (double)flush_count / ROUNDS);
+}
+
+int main(void) {
+    for (int i = 0; i < MAX_CPUS; i++) {
+        __test_cpu_state[i].cpu_id = i;
+    }
+
+    for (int i = 0; i < MAX_PROCESSES; i++) {
+        processes[i].pid = i + 1;
+        processes[i].pml4 = 0x100000 + ((uintptr_t)i << 12);
+        processes[i].cpus = &process_cpus[i];
+    }
+
+    for (int p = 0; p < sizeof(process_counts) / sizeof(process_counts[0]); p++) {
+        bench_switch("no_asids", 0, process_counts[p], false);
+        bench_switch("asids", ASID_MAX, process_counts[p], false);
+        bench_switch("stale", ASID_MAX, process_counts[p], true);
+    }
+
+    return 0;
+}
@@ -0,0 +1,143 @@
+/*
+ * Microbenchmark - TLB shootdown
+ * anos - An Operating System
+ *
+ * Copyright (c) 2025 Ross Bamford
+ *
+ * Unmap throughput (ns per page unmapped) against CPU count, running
+ * the real shootdown and IPWI code. There's only one host thread, so
+ * an "IPI" runs the target's handler inline (as that CPU) - each one
+ * is charged a fixed IPI_COST_NS to stand in for the round trip, which
+ * is what dominates on real hardware:
+ *
+ *   per_page      - unmap N pages one at a time, process loaded on all CPUs
+ *   ranged        - unmap N pages in one go, process loaded on all CPUs
+ *   ranged_masked - unmap N pages in one go, process loaded on this CPU
+ *                   and one other only
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "bench.h"
+#include "process.h"
+#include "smp/ipwi.h"
+#include "smp/state.h"
+#include "task.h"
+#include "vmm/shootdown.h"
+
+#define MAX_CPUS 4
+#define ROUNDS 2000
+#define IPI_COST_NS 1000
+
+PerCPUState __test_cpu_state[MAX_CPUS];
+uint16_t __test_cpu_count = MAX_CPUS;
+_Thread_local uint8_t __test_this_cpu;
+
+static ProcessCpus process_cpus;
+static Process process = {.pid = 42, .pml4 = 0x100000, .cpus = &process_cpus};
+static Task task = {.owner = &process};
+
+void ipwi_ipi_handler(void);
+
+uint64_t save_disable_interrupts(void) { return 0; }
+void restore_saved_interrupts(uint64_t flags) {}
+
+uint64_t sched_lock_this_cpu(void) { return 0; }
+void sched_unlock_this_cpu(uint64_t lock_flags) {}
+void sched_schedule(void) {}
+void halt_and_catch_fire(void) {}
+
+// Every CPU is running our process
+Task *task_current(void) { return &task; }
+
+void vmm_invalidate_page(uintptr_t virt_addr) {}
+void vmm_invalidate_all(void) {}
+uintptr_t vmm_get_pagetable_root_phys(void) { return process.pml4; }
+
+void asid_invalidate_process(const Process *process, uintptr_t virt_addr, size_t num_pages) {}
+void asid_forget_this_cpu(void) {}
+void asid_flush_all_this_cpu(void) {}
+
+void *vmm_phys_to_virt_ptr(uintptr_t phys_addr) { return (void *)phys_addr; }
+uintptr_t vmm_virt_to_phys(uintptr_t virt_addr) { return virt_addr; }
+
+bool vmm_map_page_containing_in(uint64_t *pml4, uintptr_t virt_addr, uint64_t phys_addr, uint16_t flags) {
+    return true;
+}
+
+bool vmm_map_pages_containing_in(uint64_t *pml4, uintptr_t virt_addr, uint64_t phys_addr, uint16_t flags,
+                                 size_t num_pages) {
+    return true;
+}
+
+uintptr_t vmm_unmap_page_in(uint64_t *pml4, uintptr_t virt_addr) { return 0x1000; }
+uintptr_t vmm_unmap_pages_in(uint64_t *pml4, uintptr_t virt_addr, size_t num_pages) { return 0x1000; }
+
+void arch_ipwi_notify_all_except_current(void) {}
+void arch_ipwi_notify_reschedule(PerCPUState *target_state) {}
+
+void arch_ipwi_notify(PerCPUState *target_state) {
+    const uint64_t start = bench_now_ns();
+
+    while (bench_now_ns() - start < IPI_COST_NS)
+        ;
+
+    const uint8_t sender = __test_this_cpu;
+    __test_this_cpu = target_state->cpu_id;
+    ipwi_ipi_handler();
+    __test_this_cpu = sender;
+}
+
+static const uint64_t page_counts[] = {1, 16, 256};
+
+static void bench_unmap(const char *mode, const uint8_t cpus, const uint64_t pages, const bool ranged,
+                        const uint64_t cpu_mask) {
+    __test_cpu_count = cpus;
+    process_cpus.cpu_mask.words[0] = cpu_mask;
+
+    const uint64_t start = bench_now_ns();
+
+    for (int round = 0; round < ROUNDS; round++) {
+        if (ranged) {
+            bench_consume(vmm_shootdown_unmap_pages_in_process(&process, 0x400000, pages));
+        } else {
+            for (uint64_t i = 0; i < pages; i++) {
+                bench_consume(vmm_shootdown_unmap_page_in_process(&process, 0x400000 + i * VM_PAGE_SIZE));
+            }
+        }
+    }
+
+    const uint64_t elapsed = bench_now_ns() - start;
+
+    char name[32];
+    snprintf(name, sizeof(name), "%s_%llu", mode, (unsigned long long)pages);
+    bench_report("shootdown", name, "cpus", cpus, ROUNDS * pages, elapsed);
+}
+
+int main(void) {
+    for (int i = 0; i < MAX_CPUS; i++) {
+        __test_cpu_state[i].cpu_id = i;
+        __test_this_cpu = i;
+
+        if (!ipwi_init()) {
+            fprintf(stderr, "Failed to init IPWI for CPU %d\n", i);
+            return 1;
+        }
+    }
+
+    __test_this_cpu = 0;
+
+    for (int p = 0; p < sizeof(page_counts) / sizeof(page_counts[0]); p++) {
+        for (uint8_t cpus = 1; cpus <= MAX_CPUS; cpus++) {
+            const uint64_t all = (1ULL << cpus) - 1;
+
+            bench_unmap("per_page", cpus, page_counts[p], false, all);
+            bench_unmap("ranged", cpus, page_counts[p], true, all);
+            bench_unmap("ranged_masked", cpus, page_counts[p], true, all & 0x3);
+        }
+    }
+
+    return 0;
+}
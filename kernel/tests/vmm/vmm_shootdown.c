@@ -5,15 +5,19 @@
  * Copyright (c) 2024 Ross Bamford
  */
 
+// munit first - pthread.h pulls in sched.h, which must see MUNIT_H
+#include "munit.h"
+
+#include <pthread.h>
 #include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
 #include <string.h>
-
-#include "munit.h"
+#include <unistd.h>
 
 #include "process.h"
 #include "smp/ipwi.h"
+#include "smp/state.h"
 #include "task.h"
 #include "vmm/shootdown.h"
 
@@ -33,6 +37,20 @@ static uintptr_t last_ipwi_virt_addr = 0;
 static size_t last_ipwi_page_count = 0;
 static uint64_t last_ipwi_target_pid = 0;
 static uintptr_t last_ipwi_target_pml4 = 0;
+static uint64_t *last_ipwi_ack_count = NULL;
+static uint32_t ipwi_enqueue_count = 0;
+static uint64_t ipwi_enqueued_mask = 0;
+static uint64_t ipwi_notified_mask = 0;
+static bool ipwi_ack_late = false;
+static bool ipwi_acked = false;
+static int ipwi_full_cpu = -1;
+static uint64_t ipwi_flush_requested_mask = 0;
+static uint64_t ipwi_flush_tickets = 0;
+static const Process *asid_invalidated_process = NULL;
+static uintptr_t asid_invalidated_virt_addr = 0;
+static size_t asid_invalidated_page_count = 0;
+static uint32_t asid_forget_count = 0;
+static uintptr_t mock_current_root = 0;
 
 bool vmm_map_page_containing_in(uint64_t *pml4, uintptr_t v, uint64_t p, uint16_t f) {
     mock_map_called = true;
@@ -76,9 +94,23 @@ uintptr_t vmm_unmap_pages_in(uint64_t *pml4, const uintptr_t v, const size_t n)
 
 uintptr_t vmm_virt_to_phys(const uintptr_t virt_addr) { return virt_addr ^ 0x12340000; }
 
+uintptr_t vmm_get_pagetable_root_phys(void) { return mock_current_root; }
+
+void asid_invalidate_process(const Process *process, const uintptr_t virt_addr, const size_t num_pages) {
+    asid_invalidated_process = process;
+    asid_invalidated_virt_addr = virt_addr;
+    asid_invalidated_page_count = num_pages;
+}
+
+void asid_forget_this_cpu(void) { asid_forget_count++; }
+
 void *vmm_phys_to_virt_ptr(const uintptr_t phys_addr) { return (void *)(phys_addr | 0x12340000); }
 
-bool ipwi_enqueue_all_except_current(IpwiWorkItem *item) {
+bool ipwi_enqueue(const IpwiWorkItem *item, const uint16_t cpu_num) {
+    if (cpu_num == ipwi_full_cpu) {
+        return false;
+    }
+
     ipi_enqueued = true;
     const IpwiPayloadTLBShootdown *payload = (IpwiPayloadTLBShootdown *)&item->payload;
 
@@ -86,13 +118,59 @@ bool ipwi_enqueue_all_except_current(IpwiWorkItem *item) {
     last_ipwi_virt_addr = payload->start_vaddr;
     last_ipwi_target_pid = payload->target_pid;
     last_ipwi_target_pml4 = payload->target_pml4;
+    last_ipwi_ack_count = payload->ack_count;
+
+    ipwi_enqueue_count++;
+    ipwi_enqueued_mask |= 1ULL << cpu_num;
 
     return true;
 }
 
+static void *late_ack_thread(void *arg) {
+    usleep(20000);
+    ipwi_acked = true;
+    __atomic_fetch_sub((uint64_t *)arg, 1, __ATOMIC_RELEASE);
+    return NULL;
+}
+
+uint64_t ipwi_request_tlb_flush(const uint16_t cpu_num) {
+    ipwi_flush_requested_mask |= 1ULL << cpu_num;
+    return ++ipwi_flush_tickets;
+}
+
+// Flushes are done as soon as the target is notified
+bool ipwi_tlb_flush_done(const uint16_t cpu_num, const uint64_t ticket) {
+    return (ipwi_notified_mask & (1ULL << cpu_num)) != 0;
+}
+
+bool ipwi_notify(const uint16_t cpu_num) {
+    ipwi_notified_mask |= 1ULL << cpu_num;
+
+    if (cpu_num == ipwi_full_cpu) {
+        return true;
+    }
+
+    // Target CPUs just do the work straight away, unless we're testing the wait
+    if (ipwi_ack_late) {
+        pthread_t thread;
+        pthread_create(&thread, NULL, late_ack_thread, last_ipwi_ack_count);
+        pthread_detach(thread);
+    } else {
+        ipwi_acked = true;
+        __atomic_fetch_sub(last_ipwi_ack_count, 1, __ATOMIC_RELEASE);
+    }
+
+    return true;
+}
+
+static ProcessCpus fake_cpus = {
+        .cpu_mask = {.words = {0xf}},
+};
+
 static Process fake_proc = {
         .pid = 42,
         .pml4 = (uintptr_t)0xCAFEB000,
+        .cpus = &fake_cpus,
 };
 
 static Task dummy_task = {
@@ -117,6 +195,18 @@ void restore_saved_interrupts(const uint64_t flags) { (void)flags; }
         last_ipwi_target_pid = 0;                                                                                      \
         last_ipwi_target_pml4 = 0;                                                                                     \
         last_ipwi_virt_addr = 0;                                                                                       \
+        last_ipwi_ack_count = NULL;                                                                                    \
+        ipwi_enqueue_count = 0;                                                                                        \
+        ipwi_enqueued_mask = ipwi_notified_mask = 0;                                                                   \
+        ipwi_ack_late = ipwi_acked = false;                                                                            \
+        cpu_mask_clear_all(&fake_cpus.cpu_mask);                                                                       \
+        fake_cpus.cpu_mask.words[0] = 0xf;                                                                             \
+        ipwi_full_cpu = -1;                                                                                            \
+        ipwi_flush_requested_mask = ipwi_flush_tickets = 0;                                                            \
+        asid_invalidated_process = NULL;                                                                               \
+        asid_invalidated_virt_addr = asid_invalidated_page_count = 0;                                                  \
+        asid_forget_count = 0;                                                                                         \
+        mock_current_root = 0;                                                                                         \
     } while (0)
 
 static MunitResult test_map_page_process(const MunitParameter params[], void *data) {
@@ -149,6 +239,7 @@ static MunitResult test_map_pages_pml4(const MunitParameter params[], void *data
     munit_assert_true(result);
     munit_assert_true(mock_map_called && ipi_enqueued);
     munit_assert_uint64(last_page_count, ==, 3);
+    munit_assert_uint64(last_ipwi_page_count, ==, 3);
     munit_assert_uint64(last_target_pml4, ==, (uintptr_t)pml4);
 
     return MUNIT_OK;
@@ -160,6 +251,7 @@ static MunitResult test_unmap_pages_current(const MunitParameter params[], void
 
     munit_assert_true(mock_unmap_called && ipi_enqueued);
     munit_assert_uint64(last_page_count, ==, 2);
+    munit_assert_uint64(last_ipwi_page_count, ==, 2);
     munit_assert_uint64(r, ==, 0xDEADBEEF + 2);
 
     return MUNIT_OK;
@@ -199,6 +291,164 @@ static MunitResult test_alias_unmap_page(const MunitParameter params[], void *da
     return MUNIT_OK;
 }
 
+static MunitResult test_unmap_pages_batched(const MunitParameter params[], void *data) {
+    RESET_FLAGS();
+    const uintptr_t r = vmm_shootdown_unmap_pages_in_process(&fake_proc, 0x100000, 100);
+
+    munit_assert_uint64(r, ==, 0xDEADBEEF + 100);
+
+    // One item covering the whole range for each other CPU, not one per page
+    munit_assert_uint32(ipwi_enqueue_count, ==, 3);
+    munit_assert_uint64(last_ipwi_virt_addr, ==, 0x100000);
+    munit_assert_uint64(last_ipwi_page_count, ==, 100);
+    munit_assert_uint64(last_ipwi_target_pid, ==, 42);
+    munit_assert_uint64(last_ipwi_target_pml4, ==, 0);
+
+    return MUNIT_OK;
+}
+
+static MunitResult test_targets_cpu_mask(const MunitParameter params[], void *data) {
+    RESET_FLAGS();
+    fake_cpus.cpu_mask.words[0] = 0x5;
+
+    vmm_shootdown_unmap_pages_in_process(&fake_proc, 0x100000, 4);
+
+    // We're CPU 0, so only CPU 2 needs it
+    munit_assert_uint32(ipwi_enqueue_count, ==, 1);
+    munit_assert_uint64(ipwi_enqueued_mask, ==, 0x4);
+    munit_assert_uint64(ipwi_notified_mask, ==, 0x4);
+
+    return MUNIT_OK;
+}
+
+static MunitResult test_not_loaded_elsewhere(const MunitParameter params[], void *data) {
+    RESET_FLAGS();
+    fake_cpus.cpu_mask.words[0] = 0x1;
+
+    const uintptr_t r = vmm_shootdown_unmap_page_in_process(&fake_proc, 0xC000);
+
+    munit_assert_true(mock_unmap_called);
+    munit_assert_false(ipi_enqueued);
+    munit_assert_uint64(ipwi_notified_mask, ==, 0);
+    munit_assert_uint64(r, ==, 0xDEADBEEF);
+
+    return MUNIT_OK;
+}
+
+static MunitResult test_mask_ignores_missing_cpus(const MunitParameter params[], void *data) {
+    RESET_FLAGS();
+    fake_cpus.cpu_mask.words[0] = 0xff0;
+    fake_cpus.cpu_mask.words[CPU_MASK_WORDS - 1] |= 0x8000000000000000ULL;
+
+    vmm_shootdown_unmap_page_in_process(&fake_proc, 0xC000);
+
+    munit_assert_false(ipi_enqueued);
+
+    return MUNIT_OK;
+}
+
+static MunitResult test_pml4_targets_all(const MunitParameter params[], void *data) {
+    RESET_FLAGS();
+    uint64_t *pml4 = (uint64_t *)0x88888000;
+
+    vmm_shootdown_unmap_pages_in_pml4(pml4, 0x7000, 2);
+
+    // No process, so no mask - everyone else gets it
+    munit_assert_uint64(ipwi_enqueued_mask, ==, 0xe);
+    munit_assert_uint64(ipwi_notified_mask, ==, 0xe);
+    munit_assert_uint64(last_ipwi_target_pid, ==, 0);
+    munit_assert_uint64(last_ipwi_target_pml4, ==, (uintptr_t)pml4 ^ 0x12340000);
+
+    return MUNIT_OK;
+}
+
+static MunitResult test_waits_for_ack(const MunitParameter params[], void *data) {
+    RESET_FLAGS();
+    ipwi_ack_late = true;
+
+    vmm_shootdown_unmap_pages_in_process(&fake_proc, 0x100000, 4);
+
+    munit_assert_not_null(last_ipwi_ack_count);
+    munit_assert_true(ipwi_acked);
+
+    return MUNIT_OK;
+}
+
+static MunitResult test_full_mailbox_flushes_all(const MunitParameter params[], void *data) {
+    RESET_FLAGS();
+    ipwi_full_cpu = 2;
+
+    vmm_shootdown_unmap_pages_in_process(&fake_proc, 0x100000, 4);
+
+    // CPU 2 couldn't take it, so gets a full flush instead - the others are as normal
+    munit_assert_uint64(ipwi_enqueued_mask, ==, 0xa);
+    munit_assert_uint64(ipwi_flush_requested_mask, ==, 0x4);
+    munit_assert_uint64(ipwi_notified_mask, ==, 0xe);
+
+    return MUNIT_OK;
+}
+
+static MunitResult test_process_marked_stale(const MunitParameter params[], void *data) {
+    RESET_FLAGS();
+    fake_cpus.cpu_mask.words[0] = 0x1;
+
+    vmm_shootdown_unmap_pages_in_process(&fake_proc, 0x100000, 4);
+
+    // Not loaded anywhere else, but still cached under its ASID maybe
+    munit_assert_false(ipi_enqueued);
+    munit_assert_ptr_equal(asid_invalidated_process, &fake_proc);
+    munit_assert_uint64(asid_invalidated_virt_addr, ==, 0x100000);
+    munit_assert_uint64(asid_invalidated_page_count, ==, 4);
+    munit_assert_uint32(asid_forget_count, ==, 0);
+
+    return MUNIT_OK;
+}
+
+static MunitResult test_pml4_not_loaded_forgets_asids(const MunitParameter params[], void *data) {
+    RESET_FLAGS();
+    uint64_t *pml4 = (uint64_t *)0x88888000;
+    mock_current_root = 0xCAFEB000;
+
+    vmm_shootdown_unmap_pages_in_pml4(pml4, 0x7000, 2);
+
+    munit_assert_null(asid_invalidated_process);
+    munit_assert_uint32(asid_forget_count, ==, 1);
+
+    return MUNIT_OK;
+}
+
+static MunitResult test_pml4_loaded_keeps_asids(const MunitParameter params[], void *data) {
+    RESET_FLAGS();
+    uint64_t *pml4 = (uint64_t *)0x88888000;
+    mock_current_root = (uintptr_t)pml4 ^ 0x12340000;
+
+    vmm_shootdown_unmap_pages_in_pml4(pml4, 0x7000, 2);
+
+    munit_assert_uint32(asid_forget_count, ==, 0);
+
+    return MUNIT_OK;
+}
+
+static MunitResult test_kernel_pages_target_all(const MunitParameter params[], void *data) {
+    RESET_FLAGS();
+    mock_current_root = 0xCAFEB000;
+
+    vmm_shootdown_kernel_pages(0xFFFFFFFF80400000, 3);
+
+    // Global, so everyone else has them whatever's loaded - and no ASID has them to forget
+    munit_assert_false(mock_unmap_called);
+    munit_assert_uint64(ipwi_enqueued_mask, ==, 0xe);
+    munit_assert_uint64(ipwi_notified_mask, ==, 0xe);
+    munit_assert_uint64(last_ipwi_virt_addr, ==, 0xFFFFFFFF80400000);
+    munit_assert_uint64(last_ipwi_page_count, ==, 3);
+    munit_assert_uint64(last_ipwi_target_pid, ==, 0);
+    munit_assert_uint64(last_ipwi_target_pml4, ==, 0);
+    munit_assert_null(asid_invalidated_process);
+    munit_assert_uint32(asid_forget_count, ==, 0);
+
+    return MUNIT_OK;
+}
+
 static MunitTest shootdown_tests[] = {
         {"/map_page_process", test_map_page_process, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL},
         {"/unmap_page_process", test_unmap_page_process, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL},
@@ -207,6 +457,18 @@ static MunitTest shootdown_tests[] = {
         {"/alias_map_page", test_alias_map_page, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL},
         {"/alias_map_pages", test_alias_map_pages, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL},
         {"/alias_unmap_page", test_alias_unmap_page, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL},
+        {"/unmap_pages_batched", test_unmap_pages_batched, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL},
+        {"/targets_cpu_mask", test_targets_cpu_mask, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL},
+        {"/not_loaded_elsewhere", test_not_loaded_elsewhere, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL},
+        {"/mask_ignores_missing_cpus", test_mask_ignores_missing_cpus, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL},
+        {"/pml4_targets_all", test_pml4_targets_all, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL},
+        {"/waits_for_ack", test_waits_for_ack, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL},
+        {"/full_mailbox_flushes_all", test_full_mailbox_flushes_all, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL},
+        {"/process_marked_stale", test_process_marked_stale, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL},
+        {"/pml4_not_loaded_forgets_asids", test_pml4_not_loaded_forgets_asids, NULL, NULL, MUNIT_TEST_OPTION_NONE,
+         NULL},
+        {"/pml4_loaded_keeps_asids", test_pml4_loaded_keeps_asids, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL},
+        {"/kernel_pages_target_all", test_kernel_pages_target_all, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL},
         {NULL, NULL, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL}};
 
 static const MunitSuite shootdown_suite = {"/vmm/shootdown", shootdown_tests, NULL, 1, MUNIT_SUITE_OPTION_NONE};
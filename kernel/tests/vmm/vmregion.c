@@ -0,0 +1,422 @@
+/*
+ * Tests for populating and faulting-around automap regions
+ * anos - An Operating System
+ *
+ * Copyright (c) 2025 Ross Bamford
+ */
+
+#include "munit.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "pmm/pagealloc.h"
+#include "process.h"
+#include "vmm/vmconfig.h"
+#include "vmm/vmmapper.h"
+#include "vmm/vmregion.h"
+
+#define MOCK_VIRT_BASE ((0x40000000))
+#define MOCK_VIRT_PAGES ((2048))
+
+MemoryRegion *physical_region;
+
+static PageTable mock_pml4;
+static bool mock_mapped[MOCK_VIRT_PAGES];
+static uint64_t mock_free_pages;
+static uint64_t mock_free_zeroed_pages;
+static uintptr_t mock_next_phys;
+static uint32_t mock_fill_calls;
+static uint32_t mock_page_frees;
+static uint32_t mock_zeroed_pages;
+static bool mock_large_available;
+static uint32_t mock_large_maps;
+static size_t mock_fill_fail_index;
+
+static Process process;
+
+static inline size_t page_index(const uintptr_t virt) { return (virt - MOCK_VIRT_BASE) >> VM_PAGE_LINEAR_SHIFT; }
+
+static inline uintptr_t page_at(const size_t index) { return MOCK_VIRT_BASE + (index << VM_PAGE_LINEAR_SHIFT); }
+
+static size_t count_mapped(const size_t from, const size_t to) {
+    size_t count = 0;
+
+    for (size_t i = from; i < to; i++) {
+        count += mock_mapped[i];
+    }
+
+    return count;
+}
+
+PageTable *vmm_find_pml4() { return &mock_pml4; }
+
+void *vmm_phys_to_virt_ptr(const uintptr_t phys_addr) { return (void *)phys_addr; }
+
+void *memclr(void *dest, const size_t count) {
+    mock_zeroed_pages += count >> VM_PAGE_LINEAR_SHIFT;
+    return dest;
+}
+
+void *memclr_page(void *dest) {
+    mock_zeroed_pages++;
+    return dest;
+}
+
+bool vmm_can_map_large_page_in(const uint64_t *pml4, const uintptr_t virt_addr, const PagetableLevel level) {
+    if (virt_addr < MOCK_VIRT_BASE || page_index(virt_addr) >= MOCK_VIRT_PAGES) {
+        return true;
+    }
+
+    if (level == PT_LEVEL_PT) {
+        return !mock_mapped[page_index(virt_addr)];
+    }
+
+    const size_t first = page_index(virt_addr & ~(MEGA_PAGE_SIZE - 1));
+    return count_mapped(first, first + (MEGA_PAGE_SIZE >> VM_PAGE_LINEAR_SHIFT)) == 0;
+}
+
+bool vmm_map_large_page_in(uint64_t *pml4, const uintptr_t virt_addr, const uint64_t phys_addr, const uint16_t flags,
+                           const PagetableLevel level) {
+    const size_t first = page_index(virt_addr);
+
+    for (size_t i = first; i < first + (MEGA_PAGE_SIZE >> VM_PAGE_LINEAR_SHIFT); i++) {
+        mock_mapped[i] = true;
+    }
+
+    mock_large_maps++;
+    return true;
+}
+
+size_t vmm_fill_pages_in(uint64_t *pml4, const uintptr_t virt_addr, uintptr_t *pages, const uint16_t flags,
+                         const size_t num_pages) {
+    size_t mapped = 0;
+
+    mock_fill_calls++;
+
+    for (size_t i = 0; i < num_pages; i++) {
+        const size_t index = page_index(virt_addr) + i;
+
+        if (index == mock_fill_fail_index) {
+            break;
+        }
+
+        if (!mock_mapped[index]) {
+            mock_mapped[index] = true;
+            pages[i] = 0;
+            mapped++;
+        }
+    }
+
+    return mapped;
+}
+
+uint64_t process_pages_alloc(Process *proc, MemoryRegion *region, uintptr_t *pages, const uint64_t count,
+                             uint64_t *zeroed) {
+    uint64_t got = 0;
+
+    while (got < count && mock_free_zeroed_pages) {
+        pages[got++] = mock_next_phys;
+        mock_next_phys += VM_PAGE_SIZE;
+        mock_free_zeroed_pages--;
+    }
+
+    *zeroed = got;
+
+    while (got < count && mock_free_pages) {
+        pages[got++] = mock_next_phys;
+        mock_next_phys += VM_PAGE_SIZE;
+        mock_free_pages--;
+    }
+
+    return got;
+}
+
+uintptr_t process_page_alloc_large(Process *proc, MemoryRegion *region) {
+    if (!mock_large_available) {
+        return 0xff;
+    }
+
+    return 0x40000000;
+}
+
+bool process_page_free(Process *proc, uintptr_t phys_addr) {
+    mock_page_frees++;
+    return true;
+}
+
+static Region make_region(const size_t first_page, const size_t num_pages, const uint64_t flags) {
+    return (Region){
+            .start = page_at(first_page),
+            .end = page_at(first_page + num_pages),
+            .flags = VM_REGION_AUTOMAP | flags,
+    };
+}
+
+static MunitResult test_fault_around_first_is_single(const MunitParameter params[], void *param) {
+    Region region = make_region(0, 64, 0);
+
+    munit_assert_true(vm_region_fault_around(&process, &region, page_at(10)));
+
+    munit_assert_size(count_mapped(0, 64), ==, 1);
+    munit_assert_true(mock_mapped[10]);
+    munit_assert_uint64(region.fault_lo, ==, page_at(10));
+    munit_assert_uint64(region.fault_hi, ==, page_at(11));
+    munit_assert_uint32(mock_zeroed_pages, ==, 1);
+
+    return MUNIT_OK;
+}
+
+static MunitResult test_fault_around_sequential_grows(const MunitParameter params[], void *param) {
+    Region region = make_region(0, 128, 0);
+    const size_t expected[] = {1, 2, 4, 8, 16, 16};
+    size_t next = 0;
+
+    for (int i = 0; i < sizeof(expected) / sizeof(expected[0]); i++) {
+        munit_assert_true(vm_region_fault_around(&process, &region, page_at(next)));
+
+        // One batch, one lock hold, each time
+        munit_assert_uint32(mock_fill_calls, ==, i + 1);
+        munit_assert_size(count_mapped(next, 128), ==, expected[i]);
+
+        next += expected[i];
+    }
+
+    return MUNIT_OK;
+}
+
+static MunitResult test_fault_around_downward(const MunitParameter params[], void *param) {
+    Region region = make_region(0, 64, 0);
+
+    // Like a stack, growing down from the top
+    munit_assert_true(vm_region_fault_around(&process, &region, page_at(63)));
+    munit_assert_true(vm_region_fault_around(&process, &region, page_at(62)));
+    munit_assert_true(vm_region_fault_around(&process, &region, page_at(60)));
+
+    munit_assert_size(count_mapped(0, 64), ==, 7);
+    munit_assert_size(count_mapped(57, 64), ==, 7);
+    munit_assert_uint64(region.fault_lo, ==, page_at(57));
+    munit_assert_uint64(region.fault_hi, ==, page_at(61));
+
+    return MUNIT_OK;
+}
+
+static MunitResult test_fault_around_random_resets(const MunitParameter params[], void *param) {
+    Region region = make_region(0, 64, 0);
+
+    vm_region_fault_around(&process, &region, page_at(0));
+    vm_region_fault_around(&process, &region, page_at(1));
+    munit_assert_size(count_mapped(0, 64), ==, 3);
+
+    // Somewhere else entirely - back to a single page
+    vm_region_fault_around(&process, &region, page_at(40));
+    munit_assert_size(count_mapped(0, 64), ==, 4);
+    munit_assert_uint64(region.fault_hi - region.fault_lo, ==, VM_PAGE_SIZE);
+
+    return MUNIT_OK;
+}
+
+static MunitResult test_fault_around_clipped_to_region(const MunitParameter params[], void *param) {
+    Region region = make_region(0, 6, 0);
+
+    vm_region_fault_around(&process, &region, page_at(0));
+    vm_region_fault_around(&process, &region, page_at(1));
+    vm_region_fault_around(&process, &region, page_at(3));
+
+    // Would have been four, but only three are left
+    munit_assert_size(count_mapped(0, 64), ==, 6);
+    munit_assert_uint64(region.fault_hi, ==, region.end);
+
+    return MUNIT_OK;
+}
+
+static MunitResult test_fault_around_stops_at_mapped(const MunitParameter params[], void *param) {
+    Region region = make_region(0, 64, 0);
+    mock_mapped[5] = true;
+
+    vm_region_fault_around(&process, &region, page_at(0));
+    vm_region_fault_around(&process, &region, page_at(1));
+    vm_region_fault_around(&process, &region, page_at(3));
+
+    // Stopped short of the one that was already there
+    munit_assert_size(count_mapped(0, 64), ==, 6);
+    munit_assert_uint64(region.fault_hi, ==, page_at(5));
+
+    // Nothing allocated for the page that was already there
+    munit_assert_uint32(mock_page_frees, ==, 0);
+
+    return MUNIT_OK;
+}
+
+static MunitResult test_fault_around_policy_off(const MunitParameter params[], void *param) {
+    Region region = make_region(0, 64, VM_REGION_FAULT_AROUND_OFF);
+
+    for (int i = 0; i < 4; i++) {
+        vm_region_fault_around(&process, &region, page_at(i));
+        munit_assert_size(count_mapped(0, 64), ==, i + 1);
+    }
+
+    return MUNIT_OK;
+}
+
+static MunitResult test_fault_around_policy_larger(const MunitParameter params[], void *param) {
+    Region region = make_region(0, 512, VM_REGION_FAULT_AROUND(6));
+    size_t next = 0;
+
+    for (size_t window = 1; window <= 64; window *= 2) {
+        vm_region_fault_around(&process, &region, page_at(next));
+        next += window;
+    }
+
+    munit_assert_size(count_mapped(0, 512), ==, 127);
+
+    // The last window took more than one batch
+    mock_fill_calls = 0;
+    vm_region_fault_around(&process, &region, page_at(next));
+    munit_assert_size(count_mapped(0, 512), ==, 191);
+    munit_assert_uint32(mock_fill_calls, ==, 2);
+
+    return MUNIT_OK;
+}
+
+static MunitResult test_fault_around_out_of_memory(const MunitParameter params[], void *param) {
+    Region region = make_region(0, 64, 0);
+    mock_free_pages = 0;
+
+    munit_assert_false(vm_region_fault_around(&process, &region, page_at(0)));
+    munit_assert_size(count_mapped(0, 64), ==, 0);
+
+    return MUNIT_OK;
+}
+
+static MunitResult test_populate_small(const MunitParameter params[], void *param) {
+    Region region = make_region(0, 40, VM_REGION_POPULATE);
+
+    munit_assert_true(vm_region_populate(&process, &region, region.start, region.end));
+
+    munit_assert_size(count_mapped(0, 64), ==, 40);
+    munit_assert_uint32(mock_fill_calls, ==, 2);
+    munit_assert_uint32(mock_zeroed_pages, ==, 40);
+    munit_assert_uint32(mock_large_maps, ==, 0);
+
+    return MUNIT_OK;
+}
+
+static MunitResult test_populate_prefers_zeroed(const MunitParameter params[], void *param) {
+    Region region = make_region(0, 16, VM_REGION_POPULATE);
+    mock_free_zeroed_pages = 10;
+
+    munit_assert_true(vm_region_populate(&process, &region, region.start, region.end));
+
+    // Only the ones that weren't already zeroed needed it
+    munit_assert_size(count_mapped(0, 64), ==, 16);
+    munit_assert_uint32(mock_zeroed_pages, ==, 6);
+    munit_assert_uint64(mock_free_zeroed_pages, ==, 0);
+
+    return MUNIT_OK;
+}
+
+static MunitResult test_populate_skips_mapped(const MunitParameter params[], void *param) {
+    Region region = make_region(0, 8, VM_REGION_POPULATE);
+    mock_mapped[2] = true;
+    mock_mapped[3] = true;
+
+    munit_assert_true(vm_region_populate(&process, &region, region.start, region.end));
+
+    // Pages for what was already there go straight back
+    munit_assert_size(count_mapped(0, 64), ==, 8);
+    munit_assert_uint32(mock_page_frees, ==, 2);
+
+    return MUNIT_OK;
+}
+
+static MunitResult test_populate_large(const MunitParameter params[], void *param) {
+    const size_t large_pages = MEGA_PAGE_SIZE >> VM_PAGE_LINEAR_SHIFT;
+    Region region = make_region(large_pages - 4, large_pages + 8, VM_REGION_POPULATE);
+    mock_large_available = true;
+
+    munit_assert_true(vm_region_populate(&process, &region, region.start, region.end));
+
+    // Small up to the boundary, one large page, then small for the tail
+    munit_assert_size(count_mapped(0, MOCK_VIRT_PAGES), ==, large_pages + 8);
+    munit_assert_uint32(mock_large_maps, ==, 1);
+    munit_assert_uint32(mock_fill_calls, ==, 2);
+
+    return MUNIT_OK;
+}
+
+static MunitResult test_populate_out_of_memory(const MunitParameter params[], void *param) {
+    Region region = make_region(0, 40, VM_REGION_POPULATE);
+    mock_free_pages = 10;
+
+    munit_assert_false(vm_region_populate(&process, &region, region.start, region.end));
+    munit_assert_size(count_mapped(0, 64), ==, 10);
+
+    return MUNIT_OK;
+}
+
+static MunitResult test_populate_fill_stops_early(const MunitParameter params[], void *param) {
+    Region region = make_region(0, 16, VM_REGION_POPULATE);
+    mock_mapped[2] = true;
+    mock_fill_fail_index = 8;
+
+    munit_assert_false(vm_region_populate(&process, &region, region.start, region.end));
+
+    // Pages that didn't get mapped all went back
+    munit_assert_size(count_mapped(0, 64), ==, 8);
+    munit_assert_uint32(mock_page_frees, ==, 9);
+
+    return MUNIT_OK;
+}
+
+static void *setup(const MunitParameter params[], void *user_data) {
+    memset(mock_mapped, 0, sizeof(mock_mapped));
+    mock_free_pages = 4096;
+    mock_free_zeroed_pages = 0;
+    mock_next_phys = 0x100000;
+    mock_fill_calls = 0;
+    mock_page_frees = 0;
+    mock_zeroed_pages = 0;
+    mock_large_available = false;
+    mock_large_maps = 0;
+    mock_fill_fail_index = MOCK_VIRT_PAGES;
+
+    return NULL;
+}
+
+static MunitTest test_suite_tests[] = {
+        {(char *)"/fault_around/first_is_single", test_fault_around_first_is_single, setup, NULL,
+         MUNIT_TEST_OPTION_NONE, NULL},
+        {(char *)"/fault_around/sequential_grows", test_fault_around_sequential_grows, setup, NULL,
+         MUNIT_TEST_OPTION_NONE, NULL},
+        {(char *)"/fault_around/downward", test_fault_around_downward, setup, NULL, MUNIT_TEST_OPTION_NONE, NULL},
+        {(char *)"/fault_around/random_resets", test_fault_around_random_resets, setup, NULL, MUNIT_TEST_OPTION_NONE,
+         NULL},
+        {(char *)"/fault_around/clipped_to_region", test_fault_around_clipped_to_region, setup, NULL,
+         MUNIT_TEST_OPTION_NONE, NULL},
+        {(char *)"/fault_around/stops_at_mapped", test_fault_around_stops_at_mapped, setup, NULL,
+         MUNIT_TEST_OPTION_NONE, NULL},
+        {(char *)"/fault_around/policy_off", test_fault_around_policy_off, setup, NULL, MUNIT_TEST_OPTION_NONE, NULL},
+        {(char *)"/fault_around/policy_larger", test_fault_around_policy_larger, setup, NULL, MUNIT_TEST_OPTION_NONE,
+         NULL},
+        {(char *)"/fault_around/out_of_memory", test_fault_around_out_of_memory, setup, NULL, MUNIT_TEST_OPTION_NONE,
+         NULL},
+        {(char *)"/populate/small", test_populate_small, setup, NULL, MUNIT_TEST_OPTION_NONE, NULL},
+        {(char *)"/populate/prefers_zeroed", test_populate_prefers_zeroed, setup, NULL, MUNIT_TEST_OPTION_NONE,
+         NULL},
+        {(char *)"/populate/skips_mapped", test_populate_skips_mapped, setup, NULL, MUNIT_TEST_OPTION_NONE, NULL},
+        {(char *)"/populate/large", test_populate_large, setup, NULL, MUNIT_TEST_OPTION_NONE, NULL},
+        {(char *)"/populate/out_of_memory", test_populate_out_of_memory, setup, NULL, MUNIT_TEST_OPTION_NONE, NULL},
+        {(char *)"/populate/fill_stops_early", test_populate_fill_stops_early, setup, NULL, MUNIT_TEST_OPTION_NONE,
+         NULL},
+
+        {NULL, NULL, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL},
+};
+
+static const MunitSuite test_suite = {(char *)"/vmm/region", test_suite_tests, NULL, 1, MUNIT_SUITE_OPTION_NONE};
+
+int main(int argc, char *argv[MUNIT_ARRAY_PARAM(argc + 1)]) {
+    return munit_suite_main(&test_suite, (void *)"µnit", argc, argv);
+}
@@ -7,12 +7,19 @@
 
 #include <stdint.h>
 
+#include "config.h"
+#include "machine.h"
 #include "sched.h"
 #include "sleep.h"
 
+#ifdef EXPERIMENTAL_TICKLESS
+// No periodic tick to count, so ticks are just a view of the clock
+uint64_t get_kernel_upticks(void) { return get_kernel_nanos() / NANOS_PER_TICK; }
+#else
 volatile uint64_t lapic_timer_upticks;
 
 uint64_t get_kernel_upticks(void) { return lapic_timer_upticks; }
+#endif
 
 void handle_ap_timer_interrupt(void) {
     kernel_timer_eoe();
@@ -24,7 +31,9 @@ void handle_ap_timer_interrupt(void) {
 }
 
 void handle_bsp_timer_interrupt(void) {
+#ifndef EXPERIMENTAL_TICKLESS
     lapic_timer_upticks += 1;
+#endif
 
     kernel_timer_eoe();
 
@@ -0,0 +1,268 @@
+/*
+ * stage3 - Address space IDs
+ * anos - An Operating System
+ *
+ * Copyright (c) 2025 Ross Bamford
+ *
+ * The arch-independent side of ASIDs - which process gets which one
+ * on each CPU, and when they need flushing. See vmm/asid.h.
+ *
+ * Everything per-CPU here is only ever touched by its own CPU, with
+ * interrupts disabled, so needs no locking. The only shared state is
+ * each process' `tlb_stale_mask` (in its `cpus`), and the kernel pages
+ * waiting for a shootdown (which the kernel table lock looks after).
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "cpu.h"
+#include "fba/alloc.h"
+#include "process.h"
+#include "smp/ipwi.h"
+#include "smp/state.h"
+#include "task.h"
+#include "vmm/asid.h"
+#include "vmm/vmconfig.h"
+#include "vmm/vmmapper.h"
+
+uint16_t arch_asid_init_this_cpu(bool want_asids);
+void arch_asid_switch(uintptr_t pagetable_root, uint16_t asid, bool flush);
+bool arch_asid_invalidate_page(uint16_t asid, uintptr_t virt_addr);
+void arch_asid_flush_all(void);
+
+static bool asid_ready;
+
+// Kernel pages changed since the mapper last took them - same start and end for none
+static uintptr_t kernel_pending_start;
+static uintptr_t kernel_pending_end;
+
+// These are only ever used by their own CPU, so invalidating them there is enough
+static inline bool is_per_cpu_temp_page(const uintptr_t virt_addr) {
+    return virt_addr >= PER_CPU_TEMP_PAGE_BASE &&
+           virt_addr < PER_CPU_TEMP_PAGE_BASE + (MAX_CPU_COUNT << VM_PAGE_LINEAR_SHIFT);
+}
+
+static inline size_t table_home(const uint64_t pid) {
+    return (pid * 0x9e3779b97f4a7c15ULL) >> (64 - __builtin_ctzll(ASID_TABLE_ENTRIES));
+}
+
+static AsidTableEntry *find_entry(PerCPUAsidTable *table, const uint64_t pid) {
+    const size_t home = table_home(pid);
+
+    for (size_t i = 0; i < ASID_TABLE_PROBE; i++) {
+        AsidTableEntry *entry = &table->entries[(home + i) % ASID_TABLE_ENTRIES];
+
+        if (entry->pid == pid) {
+            return entry;
+        }
+    }
+
+    return NULL;
+}
+
+// Somewhere for a process that isn't in the table - if there's no room, whoever's
+// at its home gives theirs up (they'll get a new one if they need it again)
+static AsidTableEntry *claim_entry(PerCPUAsidTable *table, const uint64_t pid) {
+    const size_t home = table_home(pid);
+
+    for (size_t i = 0; i < ASID_TABLE_PROBE; i++) {
+        AsidTableEntry *entry = &table->entries[(home + i) % ASID_TABLE_ENTRIES];
+
+        if (entry->pid == 0) {
+            return entry;
+        }
+    }
+
+    return &table->entries[home];
+}
+
+static void clear_table(PerCPUAsidTable *table) {
+    for (size_t i = 0; i < ASID_TABLE_ENTRIES; i++) {
+        table->entries[i].pid = 0;
+        table->entries[i].asid = 0;
+    }
+}
+
+void asid_init_this_cpu(void) {
+    PerCPUAsidState *asids = &state_get_for_this_cpu()->asids;
+
+#ifdef NO_ASIDS
+    const uint16_t max_asid = arch_asid_init_this_cpu(false);
+#else
+    const uint16_t max_asid = arch_asid_init_this_cpu(true);
+#endif
+
+    asids->table = max_asid ? fba_alloc_block() : NULL;
+
+    if (asids->table) {
+        clear_table(asids->table);
+        asids->max_asid = max_asid < ASID_MAX ? max_asid : ASID_MAX;
+    } else {
+        asids->max_asid = 0;
+    }
+
+    asids->next_asid = 1;
+    asids->loaded_asid = 0;
+    asids->loaded_root = 0;
+    asids->generation = 0;
+
+    asid_ready = true;
+}
+
+void asid_switch_to(const Process *process, const uintptr_t pagetable_root) {
+    PerCPUState *state = state_get_for_this_cpu();
+    PerCPUAsidState *asids = &state->asids;
+    bool stale = false;
+    bool flush_all = false;
+
+    if (process) {
+        CpuMask *stale_mask = &process->cpus->tlb_stale_mask;
+
+        // Our cpu_mask bit is already set, so either this sees the stale bit from
+        // a shootdown, or the shootdown sees our bit and IPIs us once we're loaded
+        if (cpu_mask_test(stale_mask, state->cpu_id, __ATOMIC_SEQ_CST)) {
+            cpu_mask_clear(stale_mask, state->cpu_id, __ATOMIC_SEQ_CST);
+            stale = true;
+        }
+    }
+
+    if (!process || !asids->max_asid) {
+        // No ASID to use - as we always did, only reload (and flush) for different tables
+        if (stale || asids->loaded_asid || pagetable_root != asids->loaded_root) {
+            arch_asid_switch(pagetable_root, 0, true);
+        }
+
+        asids->loaded_root = pagetable_root;
+        asids->loaded_asid = 0;
+        return;
+    }
+
+    AsidTableEntry *entry = find_entry(asids->table, process->pid);
+
+    if (entry && entry->asid == asids->loaded_asid && !stale) {
+        // Already loaded, nothing to do
+        return;
+    }
+
+    if (!entry) {
+        if (asids->next_asid > asids->max_asid) {
+            // Run out - start a new generation. Everything goes once we're off
+            // the old tables, so nothing under the old ASIDs can creep back in.
+            clear_table(asids->table);
+            asids->next_asid = 1;
+            asids->generation++;
+            flush_all = true;
+        }
+
+        // Never used since the last flush, so there's nothing under it
+        entry = claim_entry(asids->table, process->pid);
+        entry->pid = process->pid;
+        entry->asid = asids->next_asid++;
+    }
+
+    arch_asid_switch(pagetable_root, entry->asid, stale);
+
+    if (flush_all) {
+        arch_asid_flush_all();
+    }
+
+    asids->loaded_root = pagetable_root;
+    asids->loaded_asid = entry->asid;
+}
+
+static bool invalidate_pages(const uint16_t asid, const uintptr_t virt_addr, const size_t num_pages) {
+    if (num_pages > IPWI_TLB_SHOOTDOWN_FULL_FLUSH_PAGES) {
+        return false;
+    }
+
+    for (size_t i = 0; i < num_pages; i++) {
+        if (!arch_asid_invalidate_page(asid, virt_addr + (i << VM_PAGE_LINEAR_SHIFT))) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void asid_invalidate_process(const Process *process, const uintptr_t virt_addr, const size_t num_pages) {
+    PerCPUState *state = state_get_for_this_cpu();
+    const PerCPUAsidState *asids = &state->asids;
+    const AsidTableEntry *entry = asids->table ? find_entry(asids->table, process->pid) : NULL;
+
+    cpu_mask_set_all_except(&process->cpus->tlb_stale_mask, state->cpu_id, __ATOMIC_SEQ_CST);
+
+    // The caller only invalidated the loaded ASID here - if the process has another, it's
+    // either done now or flushed when we next switch to it
+    if (entry && entry->asid != asids->loaded_asid && !invalidate_pages(entry->asid, virt_addr, num_pages)) {
+        cpu_mask_set(&process->cpus->tlb_stale_mask, state->cpu_id, __ATOMIC_SEQ_CST);
+    }
+}
+
+void asid_invalidate_mapping(const uintptr_t virt_addr) {
+    if (virt_addr >= VM_KERNEL_SPACE_START) {
+        if (!asid_ready || is_per_cpu_temp_page(virt_addr)) {
+            return;
+        }
+
+        // Kept until the mapper's done with the tables - it usually does a run of them
+        if (kernel_pending_start == kernel_pending_end) {
+            kernel_pending_start = virt_addr;
+            kernel_pending_end = virt_addr + VM_PAGE_SIZE;
+        } else {
+            if (virt_addr < kernel_pending_start) {
+                kernel_pending_start = virt_addr;
+            }
+            if (virt_addr + VM_PAGE_SIZE > kernel_pending_end) {
+                kernel_pending_end = virt_addr + VM_PAGE_SIZE;
+            }
+        }
+
+        return;
+    }
+
+    if (!asid_ready) {
+        return;
+    }
+
+    const Task *current = task_current();
+
+    if (current && current->owner) {
+        cpu_mask_set_all_except(&current->owner->cpus->tlb_stale_mask, state_get_for_this_cpu()->cpu_id,
+                                __ATOMIC_SEQ_CST);
+    }
+}
+
+void asid_forget_this_cpu(void) {
+    PerCPUAsidState *asids = &state_get_for_this_cpu()->asids;
+
+    if (!asids->table) {
+        return;
+    }
+
+    for (size_t i = 0; i < ASID_TABLE_ENTRIES; i++) {
+        AsidTableEntry *entry = &asids->table->entries[i];
+
+        if (entry->pid && entry->asid != asids->loaded_asid) {
+            entry->pid = 0;
+            entry->asid = 0;
+        }
+    }
+}
+
+bool asid_take_kernel_pages(uintptr_t *virt_addr, size_t *num_pages) {
+    if (kernel_pending_start == kernel_pending_end) {
+        return false;
+    }
+
+    *virt_addr = kernel_pending_start;
+    *num_pages = (kernel_pending_end - kernel_pending_start) >> VM_PAGE_LINEAR_SHIFT;
+
+    kernel_pending_start = 0;
+    kernel_pending_end = 0;
+
+    return true;
+}
+
+void asid_flush_all_this_cpu(void) { arch_asid_flush_all(); }
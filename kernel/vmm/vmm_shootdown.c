@@ -10,13 +10,103 @@
  * Shootdowns are **expensive**! Only use these routines when
  * it's actually necessary, use the lower-level functions
  * directly if at all possible.
+ *
+ * Each one sends a single work item covering the whole range, and
+ * only to CPUs that have the process' PML4 loaded right now - any
+ * others are marked to flush its ASID when they next load it (see
+ * vmm/asid.h). Kernel pages are in every address space, so those go
+ * to every other CPU. It doesn't return until they've all acknowledged,
+ * so once it does the old pages are safe to free.
  */
 
+#include <stddef.h>
+
 #include "process.h"
+#include "smp/cpumask.h"
 #include "smp/ipwi.h"
+#include "smp/state.h"
 #include "task.h"
+#include "vmm/asid.h"
 #include "vmm/vmmapper.h"
 
+static inline void shootdown_relax(void) {
+#if defined(__x86_64__)
+    __builtin_ia32_pause();
+#endif
+}
+
+// Interrupts must be disabled. Without a process (i.e. just a PML4, or kernel pages)
+// we can't know where it's loaded, so every other CPU gets it.
+static void shootdown(const Process *process, const uintptr_t pml4_phys, const uintptr_t virt_addr,
+                      const size_t num_pages) {
+    CpuMask targets;
+    cpu_mask_set_first(&targets, state_get_cpu_count());
+
+    if (process) {
+        asid_invalidate_process(process, virt_addr, num_pages);
+    } else if (virt_addr < VM_KERNEL_SPACE_START && vmm_get_pagetable_root_phys() != pml4_phys) {
+        // Might be cached under any of our ASIDs, and we can't tell which
+        asid_forget_this_cpu();
+    }
+
+    // Pairs with task_switch - either a CPU switching in sees the stale
+    // mark (and the new tables), or we see its bit in the mask here.
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+    if (process) {
+        for (int i = 0; i < CPU_MASK_WORDS; i++) {
+            targets.words[i] &= __atomic_load_n(&process->cpus->cpu_mask.words[i], __ATOMIC_RELAXED);
+        }
+    }
+
+    const uint16_t this_cpu = state_get_for_this_cpu()->cpu_id;
+    *cpu_mask_word(&targets, this_cpu) &= ~cpu_mask_bit(this_cpu);
+
+    uint64_t pending = cpu_mask_count(&targets);
+
+    if (!pending) {
+        return;
+    }
+
+    IpwiWorkItem work_item = {
+            .type = IPWI_TYPE_TLB_SHOOTDOWN,
+            .flags = 0,
+    };
+
+    IpwiPayloadTLBShootdown *payload = (IpwiPayloadTLBShootdown *)&work_item.payload;
+    payload->ack_count = &pending;
+    payload->page_count = num_pages;
+    payload->start_vaddr = virt_addr;
+    payload->target_pid = process ? process->pid : 0;
+    payload->target_pml4 = process ? 0 : pml4_phys;
+
+    cpu_mask_for_each(cpu, &targets) {
+        if (!ipwi_enqueue(&work_item, cpu)) {
+            *cpu_mask_word(&targets, cpu) &= ~cpu_mask_bit(cpu);
+            __atomic_fetch_sub(&pending, 1, __ATOMIC_RELAXED);
+
+            // Mailbox is full, so it'll have to flush everything instead
+            const uint64_t ticket = ipwi_request_tlb_flush(cpu);
+
+            if (ticket) {
+                ipwi_notify(cpu);
+
+                while (!ipwi_tlb_flush_done(cpu, ticket)) {
+                    shootdown_relax();
+                }
+            }
+        }
+    }
+
+    cpu_mask_for_each(cpu, &targets) {
+        ipwi_notify(cpu);
+    }
+
+    while (__atomic_load_n(&pending, __ATOMIC_ACQUIRE)) {
+        shootdown_relax();
+    }
+}
+
 bool vmm_shootdown_map_page_containing_in_process(const Process *process, const uintptr_t virt_addr,
                                                   const uintptr_t phys_addr, const uintptr_t flags) {
     // This is **incredibly slow** on x86_64, so do it before
@@ -34,18 +124,7 @@ bool vmm_shootdown_map_page_containing_in_process(const Process *process, const
 
     const uintptr_t result = vmm_map_page_containing_in(pml4_virt, virt_addr, phys_addr, flags);
 
-    IpwiWorkItem work_item = {
-            .type = IPWI_TYPE_TLB_SHOOTDOWN,
-            .flags = 0,
-    };
-
-    IpwiPayloadTLBShootdown *payload = (IpwiPayloadTLBShootdown *)&work_item.payload;
-    payload->page_count = 1;
-    payload->start_vaddr = virt_addr;
-    payload->target_pid = process->pid;
-    payload->target_pml4 = 0;
-
-    ipwi_enqueue_all_except_current(&work_item);
+    shootdown(process, 0, virt_addr, 1);
     restore_saved_interrupts(intr_flags);
 
     return result;
@@ -57,18 +136,7 @@ bool vmm_shootdown_map_page_containing_in_pml4(uint64_t *pml4_virt, uintptr_t vi
 
     const uintptr_t result = vmm_map_page_containing_in(pml4_virt, virt_addr, phys_addr, flags);
 
-    IpwiWorkItem work_item = {
-            .type = IPWI_TYPE_TLB_SHOOTDOWN,
-            .flags = 0,
-    };
-
-    IpwiPayloadTLBShootdown *payload = (IpwiPayloadTLBShootdown *)&work_item.payload;
-    payload->page_count = 1;
-    payload->start_vaddr = virt_addr;
-    payload->target_pid = 0;
-    payload->target_pml4 = vmm_virt_to_phys((uintptr_t)pml4_virt);
-
-    ipwi_enqueue_all_except_current(&work_item);
+    shootdown(NULL, vmm_virt_to_phys((uintptr_t)pml4_virt), virt_addr, 1);
     restore_saved_interrupts(intr_flags);
 
     return result;
@@ -89,18 +157,7 @@ bool vmm_shootdown_map_pages_containing_in_process(const Process *process, const
 
     const uintptr_t result = vmm_map_pages_containing_in(pml4_virt, virt_addr, phys_addr, flags, num_pages);
 
-    IpwiWorkItem work_item = {
-            .type = IPWI_TYPE_TLB_SHOOTDOWN,
-            .flags = 0,
-    };
-
-    IpwiPayloadTLBShootdown *payload = (IpwiPayloadTLBShootdown *)&work_item.payload;
-    payload->page_count = 1;
-    payload->start_vaddr = virt_addr;
-    payload->target_pid = process->pid;
-    payload->target_pml4 = 0;
-
-    ipwi_enqueue_all_except_current(&work_item);
+    shootdown(process, 0, virt_addr, num_pages);
     restore_saved_interrupts(intr_flags);
 
     return result;
@@ -113,18 +170,7 @@ bool vmm_shootdown_map_pages_containing_in_pml4(uint64_t *pml4_virt, const uintp
 
     const uintptr_t result = vmm_map_pages_containing_in(pml4_virt, virt_addr, phys_addr, flags, num_pages);
 
-    IpwiWorkItem work_item = {
-            .type = IPWI_TYPE_TLB_SHOOTDOWN,
-            .flags = 0,
-    };
-
-    IpwiPayloadTLBShootdown *payload = (IpwiPayloadTLBShootdown *)&work_item.payload;
-    payload->page_count = 1;
-    payload->start_vaddr = virt_addr;
-    payload->target_pid = 0;
-    payload->target_pml4 = vmm_virt_to_phys((uintptr_t)pml4_virt);
-
-    ipwi_enqueue_all_except_current(&work_item);
+    shootdown(NULL, vmm_virt_to_phys((uintptr_t)pml4_virt), virt_addr, num_pages);
     restore_saved_interrupts(intr_flags);
 
     return result;
@@ -161,18 +207,7 @@ uintptr_t vmm_shootdown_unmap_page_in_process(const Process *process, const uint
 
     const uintptr_t result = vmm_unmap_page_in(pml4_virt, virt_addr);
 
-    IpwiWorkItem work_item = {
-            .type = IPWI_TYPE_TLB_SHOOTDOWN,
-            .flags = 0,
-    };
-
-    IpwiPayloadTLBShootdown *payload = (IpwiPayloadTLBShootdown *)&work_item.payload;
-    payload->page_count = 1;
-    payload->start_vaddr = virt_addr;
-    payload->target_pid = process->pid;
-    payload->target_pml4 = 0;
-
-    ipwi_enqueue_all_except_current(&work_item);
+    shootdown(process, 0, virt_addr, 1);
     restore_saved_interrupts(flags);
 
     return result;
@@ -183,18 +218,7 @@ uintptr_t vmm_shootdown_unmap_page_in_pml4(uint64_t *pml4_virt, const uintptr_t
 
     const uintptr_t result = vmm_unmap_page_in(pml4_virt, virt_addr);
 
-    IpwiWorkItem work_item = {
-            .type = IPWI_TYPE_TLB_SHOOTDOWN,
-            .flags = 0,
-    };
-
-    IpwiPayloadTLBShootdown *payload = (IpwiPayloadTLBShootdown *)&work_item.payload;
-    payload->page_count = 1;
-    payload->start_vaddr = virt_addr;
-    payload->target_pid = 0;
-    payload->target_pml4 = vmm_virt_to_phys((uintptr_t)pml4_virt);
-
-    ipwi_enqueue_all_except_current(&work_item);
+    shootdown(NULL, vmm_virt_to_phys((uintptr_t)pml4_virt), virt_addr, 1);
     restore_saved_interrupts(flags);
 
     return result;
@@ -238,18 +262,7 @@ uintptr_t vmm_shootdown_unmap_pages_in_process(const Process *process, const uin
 
     const uintptr_t result = vmm_unmap_pages_in(pml4_virt, virt_addr, num_pages);
 
-    IpwiWorkItem work_item = {
-            .type = IPWI_TYPE_TLB_SHOOTDOWN,
-            .flags = 0,
-    };
-
-    IpwiPayloadTLBShootdown *payload = (IpwiPayloadTLBShootdown *)&work_item.payload;
-    payload->page_count = 1;
-    payload->start_vaddr = virt_addr;
-    payload->target_pid = process->pid;
-    payload->target_pml4 = 0;
-
-    ipwi_enqueue_all_except_current(&work_item);
+    shootdown(process, 0, virt_addr, num_pages);
     restore_saved_interrupts(flags);
 
     return result;
@@ -260,18 +273,7 @@ uintptr_t vmm_shootdown_unmap_pages_in_pml4(uint64_t *pml4_virt, const uintptr_t
 
     const uintptr_t result = vmm_unmap_pages_in(pml4_virt, virt_addr, num_pages);
 
-    IpwiWorkItem work_item = {
-            .type = IPWI_TYPE_TLB_SHOOTDOWN,
-            .flags = 0,
-    };
-
-    IpwiPayloadTLBShootdown *payload = (IpwiPayloadTLBShootdown *)&work_item.payload;
-    payload->page_count = 1;
-    payload->start_vaddr = virt_addr;
-    payload->target_pid = 0;
-    payload->target_pml4 = vmm_virt_to_phys((uintptr_t)pml4_virt);
-
-    ipwi_enqueue_all_except_current(&work_item);
+    shootdown(NULL, vmm_virt_to_phys((uintptr_t)pml4_virt), virt_addr, num_pages);
     restore_saved_interrupts(flags);
 
     return result;
@@ -280,3 +282,7 @@ uintptr_t vmm_shootdown_unmap_pages_in_pml4(uint64_t *pml4_virt, const uintptr_t
 uintptr_t vmm_shootdown_unmap_pages(const uintptr_t virt_addr, const size_t num_pages) {
     return vmm_shootdown_unmap_pages_in_process(task_current()->owner, virt_addr, num_pages);
 }
+
+void vmm_shootdown_kernel_pages(const uintptr_t virt_addr, const size_t num_pages) {
+    shootdown(NULL, 0, virt_addr, num_pages);
+}
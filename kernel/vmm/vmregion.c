@@ -0,0 +1,175 @@
+/*
+ * stage3 - Virtual memory regions
+ * anos - An Operating System
+ *
+ * Copyright (c) 2025 Ross Bamford
+ *
+ * Populating automap regions, either all at once up front or a
+ * window at a time as they're faulted in.
+ *
+ * Either way, pages come from the PMM a batch at a time (pre-zeroed
+ * ones first, if there are any) and each batch is mapped under a
+ * single VMM lock hold. Anything that's already mapped by the time
+ * we get there (another thread may have faulted it in meanwhile) is
+ * left alone, and the page we would have used goes straight back.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "pmm/pagealloc.h"
+#include "process/memory.h"
+#include "std/string.h"
+#include "vmm/vmconfig.h"
+#include "vmm/vmmapper.h"
+#include "vmm/vmregion.h"
+
+// Pages per allocation / lock hold - this lives on the stack, so not too many...
+#define POPULATE_BATCH ((32))
+
+#define AUTOMAP_PAGE_FLAGS ((PG_USER | PG_READ | PG_WRITE | PG_PRESENT))
+
+extern MemoryRegion *physical_region;
+
+static inline bool page_is_mapped(const uint64_t *pml4, const uintptr_t page) {
+    return !vmm_can_map_large_page_in(pml4, page, PT_LEVEL_PT);
+}
+
+#ifndef NO_LARGE_PAGES
+bool vm_region_large_page_fits(const Region *region, const uintptr_t large_base) {
+    return large_base >= region->start && large_base + MEGA_PAGE_SIZE <= region->end &&
+           vmm_can_map_large_page_in(vmm_find_pml4()->entries, large_base, PT_LEVEL_PD);
+}
+
+bool vm_region_map_new_large_page(Process *process, const uintptr_t large_base, const uint16_t flags) {
+    const uintptr_t phys = process_page_alloc_large(process, physical_region);
+
+    if (phys & 0xff) {
+        return false;
+    }
+
+    memclr(vmm_phys_to_virt_ptr(phys), MEGA_PAGE_SIZE);
+
+    if (!vmm_map_large_page_in(vmm_find_pml4()->entries, large_base, phys, flags, PT_LEVEL_PD)) {
+        for (uintptr_t page = phys; page < phys + MEGA_PAGE_SIZE; page += VM_PAGE_SIZE) {
+            process_page_free(process, page);
+        }
+
+        return false;
+    }
+
+    return true;
+}
+#endif
+
+// Back whatever isn't mapped in [start, end) with zeroed small pages
+static bool populate_small(Process *process, uintptr_t start, const uintptr_t end) {
+    uint64_t *pml4 = vmm_find_pml4()->entries;
+    uintptr_t pages[POPULATE_BATCH];
+
+    while (start < end) {
+        const uint64_t remain = (end - start) >> VM_PAGE_LINEAR_SHIFT;
+        const uint64_t want = remain < POPULATE_BATCH ? remain : POPULATE_BATCH;
+        uint64_t zeroed = 0;
+        const uint64_t got = process_pages_alloc(process, physical_region, pages, want, &zeroed);
+
+        // Any that didn't come from the zero pool get zeroed through the
+        // direct map, so they're never visible dirty
+        for (uint64_t i = zeroed; i < got; i++) {
+            memclr_page(vmm_phys_to_virt_ptr(pages[i]));
+        }
+
+        const size_t mapped = vmm_fill_pages_in(pml4, start, pages, AUTOMAP_PAGE_FLAGS, got);
+        bool stopped = false;
+
+        // Leftovers are either for slots that were already mapped, or (if
+        // mapping stopped early, e.g. no memory for a table) for holes
+        for (uint64_t i = 0; i < got; i++) {
+            if (pages[i]) {
+                if (mapped < got &&
+                    vmm_can_map_large_page_in(pml4, start + (i << VM_PAGE_LINEAR_SHIFT), PT_LEVEL_PT)) {
+                    stopped = true;
+                }
+
+                process_page_free(process, pages[i]);
+            }
+        }
+
+        if (stopped || got < want) {
+            return false;
+        }
+
+        start += got << VM_PAGE_LINEAR_SHIFT;
+    }
+
+    return true;
+}
+
+bool vm_region_populate(Process *process, const Region *region, uintptr_t start, const uintptr_t end) {
+    while (start < end) {
+        uintptr_t next = (start & ~(MEGA_PAGE_SIZE - 1)) + MEGA_PAGE_SIZE;
+
+#ifndef NO_LARGE_PAGES
+        if (start == next - MEGA_PAGE_SIZE && next <= end && vm_region_large_page_fits(region, start) &&
+            vm_region_map_new_large_page(process, start, AUTOMAP_PAGE_FLAGS)) {
+            start = next;
+            continue;
+        }
+#endif
+
+        if (next > end) {
+            next = end;
+        }
+
+        if (!populate_small(process, start, next)) {
+            return false;
+        }
+
+        start = next;
+    }
+
+    return true;
+}
+
+static inline size_t fault_around_max_pages(const Region *region) {
+    const uint64_t policy = (region->flags & VM_REGION_FAULT_AROUND_MASK) >> VM_REGION_FAULT_AROUND_SHIFT;
+    const uint64_t shift = policy ? policy - 1 : VM_REGION_FAULT_AROUND_DEFAULT;
+
+    return 1ULL << (shift > VM_REGION_FAULT_AROUND_LIMIT ? VM_REGION_FAULT_AROUND_LIMIT : shift);
+}
+
+bool vm_region_fault_around(Process *process, Region *region, const uintptr_t fault_page) {
+    const uint64_t *pml4 = vmm_find_pml4()->entries;
+    const size_t max_pages = fault_around_max_pages(region);
+    const size_t last_pages = (region->fault_hi - region->fault_lo) >> VM_PAGE_LINEAR_SHIFT;
+    const size_t window = last_pages * 2 < max_pages ? last_pages * 2 : max_pages;
+
+    uintptr_t lo = fault_page;
+    uintptr_t hi = fault_page + VM_PAGE_SIZE;
+
+    if (fault_page == region->fault_hi) {
+        // Carrying on upward from the last window - stop at the region end,
+        // or anything that's already mapped
+        const size_t room = (region->end - fault_page) >> VM_PAGE_LINEAR_SHIFT;
+
+        for (size_t i = 1; i < window && i < room && !page_is_mapped(pml4, hi); i++) {
+            hi += VM_PAGE_SIZE;
+        }
+    } else if (hi == region->fault_lo) {
+        // Carrying on downward (a stack, most likely) - likewise
+        const size_t room = (fault_page - region->start) >> VM_PAGE_LINEAR_SHIFT;
+
+        for (size_t i = 1; i < window && i <= room && !page_is_mapped(pml4, lo - VM_PAGE_SIZE); i++) {
+            lo -= VM_PAGE_SIZE;
+        }
+    }
+
+    // Otherwise it's not sequential, just do the one page and start over
+
+    region->fault_lo = lo;
+    region->fault_hi = hi;
+
+    populate_small(process, lo, hi);
+
+    return page_is_mapped(pml4, fault_page);
+}
@@ -25,6 +25,10 @@
 #define STRVER(xstrver) XSTRVER(xstrver)
 #define VERSION STRVER(VERSTR)
 
+// Room for the largest multi-page IPC buffer (256 pages), so reads of up to 1MiB fit
+#define AHCI_IPC_BUFFER ((void *)0x300000000)
+#define AHCI_IPC_BUFFER_SIZE ((0x100000))
+
 #ifdef DEBUG_AHCI_OPS
 #define ops_debugf(...) printf(__VA_ARGS__)
 #ifdef VERY_NOISY_AHCI_OPS
@@ -193,6 +197,9 @@ static void handle_storage_io_message(const uint64_t msg_cookie, uint64_t tag, v
 
     const StorageIOMessage *io_msg = (StorageIOMessage *)buffer;
 
+    // Whole pages are mapped, however much of them the sender said it was using
+    const size_t buffer_capacity = (buffer_size + 4095) & ~(size_t)4095;
+
     switch (io_msg->msg_type) {
     case STORAGE_MSG_READ_SECTORS: {
         ops_vdebugf("AHCI: Read sectors request - LBA: %lu, Count: %u\n", io_msg->start_sector, io_msg->sector_count);
@@ -212,11 +219,10 @@ static void handle_storage_io_message(const uint64_t msg_cookie, uint64_t tag, v
             return;
         }
 
-        // Check sector count limit (4KB IPC buffer / 512 bytes = 8 sectors max)
-        if (io_msg->sector_count > 8) {
-            ops_debugf("AHCI: Requested %u sectors exceeds maximum of 8 sectors "
-                       "per IPC message\n",
-                       io_msg->sector_count);
+        // Data is read into the message buffer, so it limits the sector count (up to 1MiB / 2048 sectors)
+        if ((size_t)io_msg->sector_count * active_port->sector_size > buffer_capacity) {
+            ops_debugf("AHCI: Requested %u sectors exceeds %lu byte IPC buffer\n", io_msg->sector_count,
+                       buffer_capacity);
             anos_reply_message(msg_cookie, 0);
             return;
         }
@@ -275,11 +281,10 @@ static void handle_storage_io_message(const uint64_t msg_cookie, uint64_t tag, v
             return;
         }
 
-        // Check sector count limit (4KB IPC buffer / 512 bytes = 8 sectors max)
-        if (io_msg->sector_count > 8) {
-            ops_debugf("AHCI: Write request for %u sectors exceeds maximum of 8 "
-                       "sectors per IPC message\n",
-                       io_msg->sector_count);
+        // Data follows the request in the message buffer, so that limits the sector count
+        if (sizeof(StorageIOMessage) + (size_t)io_msg->sector_count * active_port->sector_size > buffer_capacity) {
+            ops_debugf("AHCI: Write request for %u sectors exceeds %lu byte IPC buffer\n", io_msg->sector_count,
+                       buffer_capacity);
             anos_reply_message(msg_cookie, 0);
             return;
         }
@@ -366,8 +371,8 @@ int main(const int argc, char **argv) {
     ops_debugf("AHCI driver ready, entering message loop...\n");
 
     while (1) {
-        void *ipc_buffer = (void *)0x300000000;
-        size_t buffer_size = 4096;
+        void *ipc_buffer = AHCI_IPC_BUFFER;
+        size_t buffer_size = AHCI_IPC_BUFFER_SIZE;
         uint64_t tag = 0;
 
         const SyscallResult recv_result = anos_recv_message(ahci_channel, &tag, &buffer_size, ipc_buffer);
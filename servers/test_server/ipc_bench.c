@@ -0,0 +1,128 @@
+/*
+ * IPC round-trip / wakeup latency benchmark
+ * anos - An Operating System
+ *
+ * Copyright (c) 2025 Ross Bamford
+ *
+ * Run the test server with --ipc-bench to get this. There's no
+ * user-mode clock yet, so results are in raw cycles (TSC on x86_64,
+ * rdtime on RISC-V) - only compare runs on the same machine, e.g.
+ * kernels built with and without NO_RESCHEDULE_IPI.
+ *
+ *   ping_pong  - send / reply round trips, which soon settle into
+ *                handing off on a single CPU
+ *   sleep_wake - how long a 1ms sleep actually takes, the overshoot
+ *                being mostly the time for the woken CPU to notice
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdnoreturn.h>
+
+#include <anos/syscalls.h>
+#include <anos/types.h>
+
+#include "ipc_bench.h"
+
+#define PING_PONG_WARMUP 100
+#define PING_PONG_ROUNDS 10000
+#define SLEEP_WAKE_ROUNDS 200
+#define SLEEP_WAKE_NANOS 1000000
+
+#define PONG_STACK_SIZE 0x4000
+
+static char __attribute__((aligned(0x1000))) pong_thread_stack[PONG_STACK_SIZE];
+static uint64_t bench_channel;
+
+static inline uint64_t read_cycles(void) {
+#ifdef __riscv
+    uint64_t cycles;
+    __asm__ volatile("rdtime %0" : "=r"(cycles));
+    return cycles;
+#else
+    uint32_t lo, hi;
+    __asm__ volatile("rdtsc" : "=a"(lo), "=d"(hi));
+    return ((uint64_t)hi << 32) | lo;
+#endif
+}
+
+static noreturn void pong_thread(void) {
+    while (1) {
+        uint64_t tag;
+        size_t size = 0;
+
+        // Tag-only messages - buffers must be page-aligned, and we only want to time the round trip
+        const SyscallResult recv_result = anos_recv_message(bench_channel, &tag, &size, NULL);
+
+        if (recv_result.result == SYSCALL_OK && recv_result.value) {
+            anos_reply_message(recv_result.value, tag);
+        }
+    }
+}
+
+static void report(const char *name, const uint64_t rounds, const uint64_t total, const uint64_t min,
+                   const uint64_t max) {
+    printf("ipc_bench %-12s rounds=%-6lu avg=%-10lu min=%-10lu max=%-10lu cycles\n", name, rounds, total / rounds, min,
+           max);
+}
+
+static void bench_ping_pong(void) {
+    uint64_t total = 0, min = UINT64_MAX, max = 0;
+
+    for (int i = 0; i < PING_PONG_WARMUP + PING_PONG_ROUNDS; i++) {
+        const uint64_t start = read_cycles();
+        const SyscallResult result = anos_send_message(bench_channel, i, 0, NULL);
+        const uint64_t elapsed = read_cycles() - start;
+
+        if (result.result != SYSCALL_OK || result.value != (uint64_t)i) {
+            printf("ipc_bench: ping_pong failed at round %d\n", i);
+            return;
+        }
+
+        if (i >= PING_PONG_WARMUP) {
+            total += elapsed;
+            min = elapsed < min ? elapsed : min;
+            max = elapsed > max ? elapsed : max;
+        }
+    }
+
+    report("ping_pong", PING_PONG_ROUNDS, total, min, max);
+}
+
+static void bench_sleep_wake(void) {
+    uint64_t total = 0, min = UINT64_MAX, max = 0;
+
+    for (int i = 0; i < SLEEP_WAKE_ROUNDS; i++) {
+        const uint64_t start = read_cycles();
+        anos_task_sleep_current(SLEEP_WAKE_NANOS);
+        const uint64_t elapsed = read_cycles() - start;
+
+        total += elapsed;
+        min = elapsed < min ? elapsed : min;
+        max = elapsed > max ? elapsed : max;
+    }
+
+    report("sleep_wake", SLEEP_WAKE_ROUNDS, total, min, max);
+}
+
+void ipc_bench_run(void) {
+    const SyscallResult channel_result = anos_create_channel();
+
+    if (channel_result.result != SYSCALL_OK || !channel_result.value) {
+        printf("ipc_bench: failed to create channel\n");
+        return;
+    }
+
+    bench_channel = channel_result.value;
+
+    const SyscallResult thread_result = anos_create_thread(
+            pong_thread, (uintptr_t)pong_thread_stack + PONG_STACK_SIZE - 8, TASK_CLASS_NORMAL);
+
+    if (thread_result.result != SYSCALL_OK) {
+        printf("ipc_bench: failed to create pong thread\n");
+        return;
+    }
+
+    bench_ping_pong();
+    bench_sleep_wake();
+}
@@ -0,0 +1,13 @@
+/*
+ * IPC round-trip / wakeup latency benchmark
+ * anos - An Operating System
+ *
+ * Copyright (c) 2025 Ross Bamford
+ */
+
+#ifndef __ANOS_TEST_SERVER_IPC_BENCH_H
+#define __ANOS_TEST_SERVER_IPC_BENCH_H
+
+void ipc_bench_run(void);
+
+#endif //__ANOS_TEST_SERVER_IPC_BENCH_H
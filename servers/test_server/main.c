@@ -6,16 +6,23 @@
  */
 
 #include <stdio.h>
+#include <string.h>
 
 #include <anos/syscalls.h>
 #include <anos/types.h>
 
+#include "ipc_bench.h"
+
 __attribute__((constructor)) void testing_init(void) { anos_kprint("Beep Boop process is up...\n"); }
 
 int main(const int argc, char **argv) {
     for (int i = 0; i < argc; i++) {
         anos_kprint(argv[i]);
         anos_kprint("\n");
+
+        if (strcmp(argv[i], "--ipc-bench") == 0) {
+            ipc_bench_run();
+        }
     }
 
     while (1) {
@@ -62,7 +62,14 @@ static const char *const SYSCALL_IDENTIFIERS[] = {"SYSCALL_DEBUG_PRINT",
                                                   "SYSCALL_ALLOC_INTERRUPT_VECTOR",
                                                   "SYSCALL_WAIT_INTERRUPT",
                                                   "SYSCALL_READ_KERNEL_LOG",
-                                                  "SYSCALL_GET_FRAMEBUFFER_PHYS"};
+                                                  "SYSCALL_GET_FRAMEBUFFER_PHYS",
+                                                  "SYSCALL_SEND_MESSAGE_ASYNC",
+                                                  "SYSCALL_WAIT_REPLY",
+                                                  "SYSCALL_CREATE_RING",
+                                                  "SYSCALL_ATTACH_RING",
+                                                  "SYSCALL_RING_WAIT",
+                                                  "SYSCALL_RING_NOTIFY",
+                                                  "SYSCALL_SCHED_STATS"};
 
 static constexpr int SYSCALL_IDENTIFIER_COUNT = sizeof(SYSCALL_IDENTIFIERS) / sizeof(SYSCALL_IDENTIFIERS[0]);
 
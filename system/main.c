@@ -359,7 +359,7 @@ static void handle_process_spawn_request(const uint64_t message_cookie, const si
 static noreturn void process_manager_thread(void) {
     while (true) {
         uint64_t tag;
-        size_t message_size;
+        size_t message_size = 4096;
         char *message_buffer = (char *)0xc0000000;
 
         const SyscallResult result = anos_recv_message(process_manager_channel, &tag, &message_size, message_buffer);
@@ -394,7 +394,7 @@ static noreturn void process_manager_thread(void) {
 static noreturn void ramfs_driver_thread(void) {
     while (true) {
         uint64_t tag;
-        size_t message_size;
+        size_t message_size = 4096;
         char *message_buffer = (char *)0xb0000000;
 
         const SyscallResult result = anos_recv_message(ramfs_channel, &tag, &message_size, message_buffer);
@@ -667,7 +667,7 @@ static void start_filesystem_drivers(const InitCapability *caps, uint16_t cap_co
 noreturn void vfs_driver_thread(void) {
     while (true) {
         uint64_t tag;
-        size_t message_size;
+        size_t message_size = 4096;
         char *message_buffer = (char *)0xa0000000;
 
         const SyscallResult result = anos_recv_message(vfs_channel, &tag, &message_size, message_buffer);